@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+// Load test of a tf2_ros::Buffer fed over /tf by a TransformListener.
+//
+// Synthetic broadcasters publish a tree of frames with a configurable shape, rate and timing
+// jitter, while lookup threads call lookupTransform() and feeder threads push messages through
+// MessageFilters.  At the end it reports the CPU time the listener spent ingesting /tf, the
+// lookup latency percentiles, the filter admission latency percentiles and the messages the
+// filters dropped.
+//
+// Usage: ros2 run test_tf2 tf2_load_test --ros-args -p frames:=500 -p shape:=tree ...
+//
+// Parameters:
+//   frames         Number of frames below the root frame "load_root" (100)
+//   shape          "chain", "star" or "tree" (tree)
+//   branching      Children per frame of a tree (4)
+//   broadcasters   Broadcaster threads, frames are split evenly between them (1)
+//   rate           Rate in Hz at which every broadcaster publishes all of its frames (100)
+//   jitter         Standard deviation in seconds of the delay added to each publication (0.001)
+//   lookups        Lookup threads (2)
+//   lookup_rate    Lookups per second per thread, 0 to look up as fast as possible (1000)
+//   lookup_delay   Look up this many seconds in the past instead of at the latest time (0)
+//   filters        MessageFilters, each fed by a thread of its own (2)
+//   filter_rate    Messages per second added to each filter (100)
+//   filter_queue   Queue size of each filter (10)
+//   duration       Seconds to run for (10)
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <geometry_msgs/msg/point_stamped.hpp>
+#include <geometry_msgs/msg/transform_stamped.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <tf2/exceptions.h>
+#include <tf2/time.h>
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/create_timer_ros.h>
+#include <tf2_ros/message_filter.h>
+#include <tf2_ros/transform_broadcaster.h>
+#include <tf2_ros/transform_listener.h>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+using PointStamped = geometry_msgs::msg::PointStamped;
+
+const char kRootFrame[] = "load_root";
+
+std::string frameName(size_t i)
+{
+  return i == 0 ? kRootFrame : "load_" + std::to_string(i);
+}
+
+size_t parentIndex(const std::string & shape, size_t branching, size_t i)
+{
+  if (shape == "chain") {
+    return i - 1;
+  }
+  if (shape == "star") {
+    return 0;
+  }
+  return (i - 1) / branching;
+}
+
+/// CPU time used by the calling thread
+std::chrono::nanoseconds threadCpuTime()
+{
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+int64_t nanosecondsSince(Clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+/// Sleep until next, then advance it by period
+void sleepPeriod(Clock::time_point & next, Clock::duration period)
+{
+  if (period == Clock::duration::zero()) {
+    return;
+  }
+  next += period;
+  std::this_thread::sleep_until(next);
+}
+
+void reportLatencies(
+  const rclcpp::Logger & logger, const char * name, std::vector<int64_t> & latencies)
+{
+  if (latencies.empty()) {
+    RCLCPP_INFO(logger, "%s: no samples", name);
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) {
+      const size_t i = static_cast<size_t>(p * static_cast<double>(latencies.size()));
+      return static_cast<double>(latencies[std::min(i, latencies.size() - 1)]) * 1e-3;
+    };
+  RCLCPP_INFO(
+    logger, "%s: %zu samples, p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us",
+    name, latencies.size(), percentile(0.5), percentile(0.9), percentile(0.99),
+    percentile(0.999), static_cast<double>(latencies.back()) * 1e-3);
+}
+
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  rclcpp::init(argc, argv);
+  auto node = rclcpp::Node::make_shared("tf2_load_test");
+  auto broadcaster_node = rclcpp::Node::make_shared("tf2_load_test_broadcaster");
+  const rclcpp::Logger logger = node->get_logger();
+
+  const size_t num_frames = node->declare_parameter("frames", 100);
+  const std::string shape = node->declare_parameter("shape", std::string("tree"));
+  const size_t branching = std::max<int64_t>(1, node->declare_parameter("branching", 4));
+  const size_t num_broadcasters = std::max<int64_t>(1, node->declare_parameter("broadcasters", 1));
+  const double rate = node->declare_parameter("rate", 100.0);
+  const double jitter = node->declare_parameter("jitter", 0.001);
+  const size_t num_lookups = node->declare_parameter("lookups", 2);
+  const double lookup_rate = node->declare_parameter("lookup_rate", 1000.0);
+  const double lookup_delay = node->declare_parameter("lookup_delay", 0.0);
+  const size_t num_filters = node->declare_parameter("filters", 2);
+  const double filter_rate = node->declare_parameter("filter_rate", 100.0);
+  const uint32_t filter_queue = node->declare_parameter("filter_queue", 10);
+  const double duration = node->declare_parameter("duration", 10.0);
+  if (shape != "chain" && shape != "star" && shape != "tree") {
+    RCLCPP_ERROR(logger, "Unknown shape '%s', use chain, star or tree", shape.c_str());
+    rclcpp::shutdown();
+    return 1;
+  }
+  auto period = [](double hz) {
+      return hz > 0.0 ?
+             std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / hz)) :
+             Clock::duration::zero();
+    };
+
+  // The ingestion executor only runs the listener, so the CPU time of its thread is what
+  // receiving /tf and inserting it into the buffer costs.
+  tf2_ros::Buffer buffer(node->get_clock());
+  buffer.setCreateTimerInterface(
+    std::make_shared<tf2_ros::CreateTimerROS>(
+      node->get_node_base_interface(), node->get_node_timers_interface()));
+  tf2_ros::TransformListenerThreadOptions thread_options;
+  thread_options.executor = std::make_shared<rclcpp::executors::SingleThreadedExecutor>();
+  auto listener = std::make_shared<tf2_ros::TransformListener>(buffer, node, thread_options);
+  std::chrono::nanoseconds ingest_cpu(0);
+  std::thread ingest([&]() {
+      const auto start = threadCpuTime();
+      thread_options.executor->spin();
+      ingest_cpu = threadCpuTime() - start;
+    });
+  rclcpp::executors::SingleThreadedExecutor node_executor;
+  node_executor.add_node(node);
+  std::thread timers([&node_executor]() {node_executor.spin();});
+
+  std::atomic<bool> done(false);
+  std::atomic<uint64_t> published(0);
+  std::vector<std::thread> threads;
+  for (size_t b = 0; b < num_broadcasters; ++b) {
+    threads.emplace_back([&, b]() {
+        tf2_ros::TransformBroadcaster broadcaster(broadcaster_node);
+        std::vector<geometry_msgs::msg::TransformStamped> transforms;
+        for (size_t i = b + 1; i <= num_frames; i += num_broadcasters) {
+          geometry_msgs::msg::TransformStamped t;
+          t.header.frame_id = frameName(parentIndex(shape, branching, i));
+          t.child_frame_id = frameName(i);
+          t.transform.translation.x = 0.1;
+          t.transform.rotation.w = 1.0;
+          transforms.push_back(t);
+        }
+        std::mt19937 rng(static_cast<uint32_t>(b));
+        std::normal_distribution<double> skew(0.0, jitter > 0.0 ? jitter : 1.0);
+        auto next = Clock::now();
+        while (!done) {
+          const auto stamp = broadcaster_node->now();
+          for (auto & t : transforms) {
+            t.header.stamp = stamp;
+            t.transform.translation.y = stamp.seconds() * 1e-3;
+          }
+          broadcaster.sendTransform(transforms);
+          published += transforms.size();
+          sleepPeriod(next, period(rate));
+          if (jitter > 0.0) {
+            std::this_thread::sleep_for(
+              std::chrono::duration<double>(std::max(0.0, skew(rng))));
+          }
+        }
+      });
+  }
+
+  // Wait for the whole tree to arrive before measuring.
+  const std::string last_frame = frameName(num_frames);
+  std::string error;
+  while (rclcpp::ok() &&
+    !buffer.canTransform(kRootFrame, last_frame, tf2::TimePointZero, &error))
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  std::vector<std::vector<int64_t>> lookup_latencies(num_lookups);
+  std::atomic<uint64_t> lookup_failures(0);
+  std::chrono::nanoseconds consumer_cpu(0);
+  std::mutex consumer_cpu_mutex;
+  for (size_t l = 0; l < num_lookups; ++l) {
+    threads.emplace_back([&, l]() {
+        const auto cpu_start = threadCpuTime();
+        std::mt19937 rng(static_cast<uint32_t>(1000 + l));
+        std::uniform_int_distribution<size_t> frame(1, num_frames);
+        auto next = Clock::now();
+        while (!done) {
+          const std::string source = frameName(frame(rng));
+          const tf2::TimePoint time = lookup_delay > 0.0 ?
+            tf2_ros::fromRclcpp(node->now()) - tf2::durationFromSec(lookup_delay) :
+            tf2::TimePointZero;
+          const auto start = Clock::now();
+          try {
+            buffer.lookupTransform(kRootFrame, source, time, tf2::durationFromSec(0.0));
+            lookup_latencies[l].push_back(nanosecondsSince(start));
+          } catch (const tf2::TransformException &) {
+            ++lookup_failures;
+          }
+          sleepPeriod(next, period(lookup_rate));
+        }
+        std::lock_guard<std::mutex> lock(consumer_cpu_mutex);
+        consumer_cpu += threadCpuTime() - cpu_start;
+      });
+  }
+
+  using Filter = tf2_ros::MessageFilter<PointStamped>;
+  std::vector<std::unique_ptr<Filter>> filters;
+  std::vector<int64_t> admission_latencies;
+  std::mutex admission_mutex;
+  std::atomic<uint64_t> filter_added(0);
+  std::atomic<uint64_t> filter_failures[tf2_ros::filter_failure_reasons::FilterFailureReasonCount];
+  for (auto & failures : filter_failures) {
+    failures = 0;
+  }
+  for (size_t f = 0; f < num_filters; ++f) {
+    filters.emplace_back(new Filter(buffer, kRootFrame, filter_queue, node));
+    // The messages carry the time they were added in point.x.
+    filters.back()->registerCallback(
+      [&](const PointStamped::ConstSharedPtr & msg) {
+        const int64_t added = static_cast<int64_t>(msg->point.x);
+        const int64_t now = Clock::now().time_since_epoch().count();
+        std::lock_guard<std::mutex> lock(admission_mutex);
+        admission_latencies.push_back(now - added);
+      });
+    filters.back()->registerFailureCallback(
+      [&](const PointStamped::ConstSharedPtr &,
+      tf2_ros::filter_failure_reasons::FilterFailureReason reason) {
+        ++filter_failures[reason];
+      });
+    Filter * filter = filters.back().get();
+    threads.emplace_back([&, f, filter]() {
+        const auto cpu_start = threadCpuTime();
+        std::mt19937 rng(static_cast<uint32_t>(2000 + f));
+        std::uniform_int_distribution<size_t> frame(1, num_frames);
+        auto next = Clock::now();
+        while (!done) {
+          auto msg = std::make_shared<PointStamped>();
+          msg->header.frame_id = frameName(frame(rng));
+          msg->header.stamp = node->now();
+          msg->point.x = static_cast<double>(Clock::now().time_since_epoch().count());
+          filter->add(msg);
+          ++filter_added;
+          sleepPeriod(next, period(filter_rate));
+        }
+        std::lock_guard<std::mutex> lock(consumer_cpu_mutex);
+        consumer_cpu += threadCpuTime() - cpu_start;
+      });
+  }
+
+  RCLCPP_INFO(
+    logger, "Running %s of %zu frames from %zu broadcasters at %.1f Hz for %.1f s", shape.c_str(),
+    num_frames, num_broadcasters, rate, duration);
+  const uint64_t published_start = published;
+  const auto start = Clock::now();
+  std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+  done = true;
+  for (auto & thread : threads) {
+    thread.join();
+  }
+  const double wall = static_cast<double>(nanosecondsSince(start)) * 1e-9;
+  const uint64_t transforms = published - published_start;
+  thread_options.executor->cancel();
+  ingest.join();
+  node_executor.cancel();
+  timers.join();
+
+  RCLCPP_INFO(
+    logger, "Ingestion: %" PRIu64 " transforms published (%.0f/s), %.3f s CPU (%.1f%% of a core), "
+    "%.2f us per transform", transforms, static_cast<double>(transforms) / wall,
+    static_cast<double>(ingest_cpu.count()) * 1e-9,
+    static_cast<double>(ingest_cpu.count()) * 1e-7 / wall,
+    transforms ? static_cast<double>(ingest_cpu.count()) * 1e-3 / static_cast<double>(transforms) :
+    0.0);
+  RCLCPP_INFO(
+    logger, "Consumers: %.3f s CPU in the lookup and feeder threads",
+    static_cast<double>(consumer_cpu.count()) * 1e-9);
+  std::vector<int64_t> lookups;
+  for (const auto & latencies : lookup_latencies) {
+    lookups.insert(lookups.end(), latencies.begin(), latencies.end());
+  }
+  reportLatencies(logger, "Lookup latency", lookups);
+  RCLCPP_INFO(logger, "Lookup failures: %" PRIu64, lookup_failures.load());
+  reportLatencies(logger, "Filter admission latency", admission_latencies);
+  RCLCPP_INFO(
+    logger, "Filter messages: %" PRIu64 " added, %zu admitted, dropped %" PRIu64 " with the queue "
+    "full, %" PRIu64 " out the back, %" PRIu64 " without a transform, %" PRIu64 " unknown",
+    filter_added.load(), admission_latencies.size(),
+    filter_failures[tf2_ros::filter_failure_reasons::QueueFull].load(),
+    filter_failures[tf2_ros::filter_failure_reasons::OutTheBack].load(),
+    filter_failures[tf2_ros::filter_failure_reasons::NoTransformFound].load(),
+    filter_failures[tf2_ros::filter_failure_reasons::Unknown].load());
+
+  filters.clear();
+  listener.reset();
+  rclcpp::shutdown();
+  return 0;
+}
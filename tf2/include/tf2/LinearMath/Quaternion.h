@@ -341,6 +341,23 @@ public:
 		}
 	}
 
+  /**@brief Return the normalized linear interpolation between this and q along the shorter path
+   * @param q The other quaternion to interpolate with
+   * @param t The ratio between this and q to interpolate.  If t = 0 the result is this, if t=1 the result is q.
+   * Much cheaper than slerp, but not constant velocity. For unit quaternions a rotation
+   * angle apart the result is less than 0.005 * angle^3 radians away from slerp's. */
+        TF2_PUBLIC
+	Quaternion nlerp(const Quaternion& q, const tf2Scalar& t) const
+	{
+		tf2Scalar s1 = dot(q) < 0 ? -t : t;
+		tf2Scalar s0 = tf2Scalar(1.0) - t;
+		Quaternion result(m_floats[0] * s0 + q.x() * s1,
+		                  m_floats[1] * s0 + q.y() * s1,
+		                  m_floats[2] * s0 + q.z() * s1,
+		                  m_floats[3] * s0 + q.m_floats[3] * s1);
+		return result.normalize();
+	}
+
         TF2_PUBLIC
 	static const Quaternion&	getIdentity()
 	{
@@ -437,6 +454,16 @@ slerp(const Quaternion& q1, const Quaternion& q2, const tf2Scalar& t)
 	return q1.slerp(q2, t);
 }
 
+/**@brief Return the normalized linear interpolation between two quaternions, see Quaternion::nlerp
+ * @param q1 The first quaternion
+ * @param q2 The second quaternion
+ * @param t The ratio between q1 and q2.  t = 0 return q1, t=1 returns q2 */
+TF2SIMD_FORCE_INLINE Quaternion
+nlerp(const Quaternion& q1, const Quaternion& q2, const tf2Scalar& t)
+{
+	return q1.nlerp(q2, t);
+}
+
 TF2SIMD_FORCE_INLINE Vector3 
 quatRotate(const Quaternion& rotation, const Vector3& v) 
 {
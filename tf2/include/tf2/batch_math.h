@@ -0,0 +1,122 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef TF2__BATCH_MATH_H_
+#define TF2__BATCH_MATH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tf2/LinearMath/Transform.h"
+#include "tf2/visibility_control.h"
+
+namespace tf2
+{
+namespace batch
+{
+
+/** \brief Vectors stored as separate arrays of x, y and z values, all of the same length */
+struct Vector3Array
+{
+  double * x;
+  double * y;
+  double * z;
+};
+
+/** \brief Quaternions stored as separate arrays of x, y, z and w values */
+struct QuaternionArray
+{
+  double * x;
+  double * y;
+  double * z;
+  double * w;
+};
+
+/** \brief Rigid transforms stored as a unit quaternion and a translation array */
+struct TransformArray
+{
+  QuaternionArray rotation;
+  Vector3Array origin;
+};
+
+/** \brief Apply one transform to count points
+ *
+ * Inputs are only read through their pointers, and out may be the same arrays as in.
+ */
+TF2_PUBLIC
+void transformPoints(
+  const tf2::Transform & t, const Vector3Array & in, const Vector3Array & out, size_t count);
+
+/** \brief Compose count pairs of transforms, out[i] = a[i] * b[i]
+ *
+ * The rotations must be unit quaternions. out may be the same arrays as a or b.
+ */
+TF2_PUBLIC
+void composeTransforms(
+  const TransformArray & a, const TransformArray & b, const TransformArray & out, size_t count);
+
+/** \brief Normalize count quaternions in place */
+TF2_PUBLIC
+void normalizeQuaternions(const QuaternionArray & q, size_t count);
+
+/** \brief Spherically interpolate count pairs of quaternions, like tf2::slerp()
+ * \param a The quaternions at ratio 0
+ * \param b The quaternions at ratio 1
+ * \param ratio The interpolation ratio of each pair
+ * \param out The interpolated quaternions, which may be the same arrays as a or b
+ * \param count The number of pairs
+ */
+TF2_PUBLIC
+void slerpQuaternions(
+  const QuaternionArray & a, const QuaternionArray & b, const double * ratio,
+  const QuaternionArray & out, size_t count);
+
+/// Set by checkTransforms() for transforms with a nan in their rotation or origin
+constexpr uint8_t TRANSFORM_HAS_NAN = 1;
+/// Set by checkTransforms() for rotations whose squared norm is not within the tolerance of 1
+constexpr uint8_t TRANSFORM_DENORMALIZED = 2;
+
+/** \brief Check count transforms for the values BufferCore rejects
+ * \param t The transforms, only read through their pointers
+ * \param tolerance How far the squared norm of a rotation may be from 1.  Rotations with a nan
+ *   are never within it.
+ * \param flags Set to a combination of the flags above for each transform, 0 if it is valid
+ * \param count The number of transforms
+ */
+TF2_PUBLIC
+void checkTransforms(const TransformArray & t, double tolerance, uint8_t * flags, size_t count);
+
+/** \brief The name of the kernels picked for this CPU, "avx2", "neon" or "scalar" */
+TF2_PUBLIC
+const char * getKernelName();
+
+}  // namespace batch
+}  // namespace tf2
+
+#endif  // TF2__BATCH_MATH_H_
@@ -33,11 +33,16 @@
 #define TF2__BUFFER_CORE_H_
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstddef>
+#include <deque>
 #include <functional>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -45,8 +50,13 @@
 
 #include "LinearMath/Transform.h"
 #include "geometry_msgs/msg/transform_stamped.hpp"
+#include "geometry_msgs/msg/twist_stamped.hpp"
 #include "tf2/buffer_core_interface.h"
+#include "tf2/buffer_core_metrics.h"
 #include "tf2/exceptions.h"
+#include "tf2/insert_error_log.h"
+#include "tf2/lookup_cache.h"
+#include "tf2/time_cache.h"
 #include "tf2/transform_storage.h"
 #include "tf2/visibility_control.h"
 
@@ -55,6 +65,7 @@ namespace tf2
 
 typedef std::pair<TimePoint, CompactFrameID> P_TimeAndFrameID;
 typedef uint64_t TransformableRequestHandle;
+typedef uint64_t FrameSubscriptionHandle;
 
 class TimeCacheInterface;
 using TimeCacheInterfacePtr = std::shared_ptr<TimeCacheInterface>;
@@ -68,6 +79,222 @@ enum TransformableResult
 //!< The default amount of time to cache data in seconds
 static constexpr Duration BUFFER_CORE_DEFAULT_CACHE_TIME = std::chrono::seconds(10);
 
+/** \brief A frame name resolved by BufferCore::resolveFrame().
+ *
+ * Handles are only meaningful to the BufferCore that resolved them.  A frame keeps its handle
+ * for the lifetime of the buffer, including across clear().
+ */
+class FrameHandle
+{
+public:
+  FrameHandle() = default;
+
+  /** \brief False for a default constructed handle or a frame that could not be resolved */
+  explicit operator bool() const {return id_ != 0;}
+  bool operator==(const FrameHandle & other) const {return id_ == other.id_;}
+  bool operator!=(const FrameHandle & other) const {return id_ != other.id_;}
+
+  /** \brief The CompactFrameID of the frame in the buffer that resolved it */
+  CompactFrameID getId() const {return id_;}
+
+private:
+  friend class BufferCore;
+  friend class FrameTable;
+
+  explicit FrameHandle(CompactFrameID id)
+  : id_(id) {}
+
+  CompactFrameID id_ = 0;
+};
+
+/** \brief The names of all frames of a BufferCore, filled by BufferCore::getFrameTable().
+ *
+ * The table refers to the names interned by the buffer, which stay valid and unchanged for the
+ * lifetime of the buffer, so filling it copies no strings.  Frames are never removed, so
+ * refilling a table only appends the frames added since.  A table must only be filled from one
+ * buffer and not outlive it.
+ */
+class FrameTable
+{
+public:
+  class const_iterator
+  {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef std::string value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const std::string * pointer;
+    typedef const std::string & reference;
+
+    reference operator*() const {return **it_;}
+    pointer operator->() const {return *it_;}
+    const_iterator & operator++() {++it_; return *this;}
+    const_iterator operator++(int) {const_iterator old = *this; ++it_; return old;}
+    bool operator==(const const_iterator & other) const {return it_ == other.it_;}
+    bool operator!=(const const_iterator & other) const {return it_ != other.it_;}
+
+  private:
+    friend class FrameTable;
+
+    explicit const_iterator(std::vector<const std::string *>::const_iterator it)
+    : it_(it) {}
+
+    std::vector<const std::string *>::const_iterator it_;
+  };
+
+  /** \brief BufferCore::getFrameTableVersion() when the table was filled, 0 if never */
+  uint64_t getVersion() const {return version_;}
+
+  size_t size() const {return names_.size();}
+  bool empty() const {return names_.empty();}
+  const std::string & operator[](size_t i) const {return *names_[i];}
+  const_iterator begin() const {return const_iterator(names_.begin());}
+  const_iterator end() const {return const_iterator(names_.end());}
+
+  /** \brief The handle of the i-th frame, the same BufferCore::resolveFrame() returns for it */
+  FrameHandle getHandle(size_t i) const {return FrameHandle(static_cast<CompactFrameID>(i + 1));}
+
+private:
+  friend class BufferCore;
+
+  /// The name of each frame, indexed by its CompactFrameID minus one
+  std::vector<const std::string *> names_;
+  uint64_t version_ = 0;
+};
+
+/** \brief The chain of frames between a target and a source frame, compiled from the tree.
+ *
+ * A FrameChain is obtained from BufferCore::getFrameChain() and can be passed back to it to
+ * repeat lookups between the same two frames without validating the frame names or searching
+ * the tree again.  It stays usable after the tree changes, in which case the buffer recompiles it.
+ *
+ * Latest (TimePointZero) lookups along a chain whose frames all have the same latest stamp, or
+ * are static, are served from the caches' snapshots without taking the buffer's lock.
+ */
+class FrameChain
+{
+public:
+  /** \brief The frame into which the chain transforms */
+  const std::string & getTargetFrame() const {return target_frame_;}
+  /** \brief The frame from which the chain transforms */
+  const std::string & getSourceFrame() const {return source_frame_;}
+
+private:
+  friend class BufferCore;
+
+  /// One frame of the chain, with the parent it had when the chain was compiled
+  struct Link
+  {
+    /// Owned by the chain too, so lookups without the buffer's lock can still read it
+    TimeCacheInterfacePtr cache;
+    CompactFrameID parent;
+    CompactFrameID child;
+    /// If not 0, one past the last link covered by the precomposed static segment of child
+    size_t segment_end;
+    /// cache as a TimeCache if it is one, so walks can call it without virtual dispatch
+    TimeCache * time_cache;
+  };
+
+  CompactFrameID target_id_ = 0;
+  CompactFrameID source_id_ = 0;
+  std::string target_frame_;
+  std::string source_frame_;
+  /// The BufferCore topology version this chain was compiled against
+  uint64_t topology_version_ = 0;
+  /// False if the frames were not connected when compiled
+  bool connected_ = false;
+  /// The frames from the source up to, but excluding, the common parent
+  std::vector<Link> source_links_;
+  /// The frames from the target up to, but excluding, the common parent
+  std::vector<Link> target_links_;
+};
+typedef std::shared_ptr<const FrameChain> FrameChainHandle;
+
+/** \brief Memory used by the transform histories of a BufferCore, see BufferCore::getStats() */
+struct BufferCoreStats
+{
+  /// Frames that have received data
+  size_t frame_count = 0;
+  /// Samples kept by the dynamic frames
+  size_t sample_count = 0;
+  /// Memory taken up by those samples in bytes
+  size_t sample_bytes = 0;
+  /// Memory reserved for samples by the dynamic frames in bytes
+  size_t reserved_bytes = 0;
+  /// The limit set with BufferCore::setMemoryBudget() in bytes, 0 if unlimited
+  size_t memory_budget = 0;
+  /// Samples dropped so far to stay within the memory budget
+  uint64_t evicted_samples = 0;
+};
+
+/** \brief The heap memory of a BufferCore by what it holds, see BufferCore::memoryStats().
+ *
+ * Containers are counted by their capacity.  The nodes and buckets of hash maps are estimated
+ * from their size and bucket count, and the targets of std::function objects are not counted,
+ * so the figures are a close lower bound of what the buffer really takes up.
+ */
+struct BufferCoreMemoryStats
+{
+  /// The samples reserved by the caches of all frames, the sum of FrameGraphEntry::memory_bytes
+  size_t frame_history_bytes = 0;
+  /// The frame names, the map from names to frames and the tables kept for every frame
+  size_t frame_table_bytes = 0;
+  /// The pending transformable requests and their callbacks, the slots kept for later ones and
+  /// their index
+  size_t transformable_request_bytes = 0;
+  /// The subscriptions of subscribeFrame()
+  size_t callback_bytes = 0;
+  /// The lookup cache and the frame chains compiled by lookups
+  size_t lookup_cache_bytes = 0;
+
+  size_t total() const
+  {
+    return frame_history_bytes + frame_table_bytes + transformable_request_bytes +
+           callback_bytes + lookup_cache_bytes;
+  }
+};
+
+/** \brief Storage to set aside up front, see BufferCore::reserve() */
+struct BufferCoreReservation
+{
+  /// Frames, counting the ones that are only ever a parent
+  size_t frames = 0;
+  /// Samples of history per dynamic frame
+  size_t samples_per_frame = 0;
+  /// Transformable requests pending at the same time
+  size_t transformable_requests = 0;
+};
+
+/** \brief One frame of the tree, see BufferCore::getFrameGraph() */
+struct FrameGraphEntry
+{
+  std::string frame_id;
+  /// The parent frame of the latest transform, empty if the frame holds no data
+  std::string parent;
+  /// The authority of the latest transform, empty if none was recorded
+  std::string authority;
+  /// False for frames only known as the parent of others, those have no history of their own
+  bool allocated = false;
+  bool is_static = false;
+  /// The stamps of the oldest and latest samples, zero for static frames
+  TimePoint oldest;
+  TimePoint latest;
+  /// The samples in the history of the frame, 1 for static frames
+  size_t sample_count = 0;
+  /// The memory reserved for the samples of the frame in bytes
+  size_t memory_bytes = 0;
+};
+
+/** \brief One frame of the subtree returned by BufferCore::lookupSubtree() */
+struct SubtreeTransform
+{
+  std::string frame_id;
+  /// The index of the parent frame in the subtree, 0 for the root which is its own parent
+  size_t parent_index = 0;
+  /// The transform from the frame into the root, as lookupTransform(root, frame_id) returns it
+  tf2::Transform transform;
+};
+
 /** \brief A Class which provides coordinate transforms between any two frames in a system.
  *
  * This class provides a simple interface to allow recording and lookup of
@@ -109,6 +336,17 @@ public:
   TF2_PUBLIC
   void clear() override;
 
+  /** \brief Drop the history of all dynamic frames after time jumped back, e.g. on a bag loop
+   * or a simulation reset.
+   * Like clear() this keeps the frames and their ids, the static transforms and the storage of
+   * the caches, so refilling the buffer does not allocate.
+   * \param fail_pending_requests Whether the pending transformable requests, which were made
+   *   on the old timeline, are called back with TransformFailure right away.  Otherwise they stay
+   *   queued and are answered by the new data.
+   */
+  TF2_PUBLIC
+  void resetAfterTimeJump(bool fail_pending_requests);
+
   /** \brief Add transform information to the tf data structure
    * \param transform The transform to store
    * \param authority The source of the information for this transform
@@ -120,6 +358,49 @@ public:
     const geometry_msgs::msg::TransformStamped & transform,
     const std::string & authority, bool is_static = false);
 
+  /** \brief Add transform information that is not held in a message
+   * \param transform The transform from child_frame_id to frame_id
+   * \param frame_id The parent frame of the transform
+   * \param child_frame_id The frame the transform is of
+   * \param stamp The time of the transform
+   * \sa setTransform(const geometry_msgs::msg::TransformStamped&, const std::string&, bool)
+   */
+  TF2_PUBLIC
+  bool setTransform(
+    const tf2::Transform & transform, const std::string & frame_id,
+    const std::string & child_frame_id, TimePoint stamp,
+    const std::string & authority, bool is_static = false);
+
+  /** \brief Add a batch of transforms to the tf data structure
+   * This is equivalent to calling setTransform() for each transform, but the buffer is only
+   * locked once and pending transformable requests are only checked once for the whole batch.
+   * \param transforms The transforms to store, for example all transforms of a TFMessage
+   * \param authority The source of the information for these transforms
+   * \param is_static Record these transforms as static transforms.  They will be good across all time.  (This cannot be changed after the first call.)
+   * \return True unless an error occured for any of the transforms
+   */
+  TF2_PUBLIC
+  bool setTransforms(
+    const std::vector<geometry_msgs::msg::TransformStamped> & transforms,
+    const std::string & authority, bool is_static = false);
+
+  /** \brief Bulk load transforms, for example the /tf of a bag that is processed offline
+   * This is equivalent to setTransforms(), but the frame ids are resolved once per frame, the
+   * samples of each frame are appended to its cache in one go and its history is only pruned
+   * once, skipping the samples that would not survive it.  The transforms are expected to be
+   * sorted by stamp, at least per frame, as they are recorded.  A long recording can be loaded
+   * in consecutive chunks.
+   * \param transforms The transforms to store
+   * \param authority The source of the information for these transforms
+   * \param is_static Record these transforms as static transforms, they are then simply passed
+   *   to setTransforms()
+   * \return True unless an error occured for any of the transforms
+   */
+  TF2_PUBLIC
+  bool loadTransforms(
+    const std::vector<geometry_msgs::msg::TransformStamped> & transforms,
+    const std::string & authority, bool is_static = false);
+
   /*********** Accessors *************/
 
   /** \brief Get the transform between two frames by frame ID.
@@ -156,6 +437,72 @@ public:
     const std::string & source_frame, const TimePoint & source_time,
     const std::string & fixed_frame) const override;
 
+  /** \brief Get the transform between two frames by frame ID without building a message.
+   * \param target_frame The frame to which data should be transformed
+   * \param source_frame The frame where the data originated
+   * \param time The time at which the value of the transform is desired. (0 will get the latest)
+   * \param[out] transform The transform between the frames
+   * \param[out] time_out The time stamp of the transform
+   * \sa lookupTransform(const std::string&, const std::string&, const TimePoint&)
+   *
+   * Possible exceptions tf2::LookupException, tf2::ConnectivityException,
+   * tf2::ExtrapolationException, tf2::InvalidArgumentException
+   */
+  TF2_PUBLIC
+  void lookupTransform(
+    const std::string & target_frame, const std::string & source_frame,
+    const TimePoint & time, tf2::Transform & transform, TimePoint & time_out) const;
+
+  /** \brief Get the transform between two frames by frame ID assuming fixed frame without
+   *   building a message.
+   * \param[out] transform The transform between the frames
+   * \param[out] time_out The time stamp of the transform
+   * \sa lookupTransform(const std::string&, const TimePoint&, const std::string&,
+   *   const TimePoint&, const std::string&)
+   *
+   * Possible exceptions tf2::LookupException, tf2::ConnectivityException,
+   * tf2::ExtrapolationException, tf2::InvalidArgumentException
+   */
+  TF2_PUBLIC
+  void lookupTransform(
+    const std::string & target_frame, const TimePoint & target_time,
+    const std::string & source_frame, const TimePoint & source_time,
+    const std::string & fixed_frame, tf2::Transform & transform, TimePoint & time_out) const;
+
+  /** \brief Get the transform between two frames by frame ID, returning an error instead of
+   *   throwing.
+   *
+   * Meant for polling a transform that may not be available yet, where a failed lookup should
+   * cost about as much as a successful one.  Nothing is thrown or logged, and the reason of a
+   * failure is only formatted if asked for.
+   * \param target_frame The frame to which data should be transformed
+   * \param source_frame The frame where the data originated
+   * \param time The time at which the value of the transform is desired. (0 will get the latest)
+   * \param[out] transform The transform between the frames, only set on success
+   * \param error_msg A pointer to a string which will be filled with why the lookup failed, if
+   *   not NULL
+   * \return tf2::TF2Error::NO_ERROR on success, otherwise the error lookupTransform() would
+   *   have thrown
+   */
+  TF2_PUBLIC
+  tf2::TF2Error tryLookupTransform(
+    const std::string & target_frame, const std::string & source_frame,
+    const TimePoint & time, geometry_msgs::msg::TransformStamped & transform,
+    std::string * error_msg = NULL) const;
+
+  /** \brief Get the transform between two frames by frame ID without building a message,
+   *   returning an error instead of throwing.
+   * \param[out] transform The transform between the frames, only set on success
+   * \param[out] time_out The time stamp of the transform, only set on success
+   * \sa tryLookupTransform(const std::string&, const std::string&, const TimePoint&,
+   *   geometry_msgs::msg::TransformStamped&, std::string*)
+   */
+  TF2_PUBLIC
+  tf2::TF2Error tryLookupTransform(
+    const std::string & target_frame, const std::string & source_frame,
+    const TimePoint & time, tf2::Transform & transform, TimePoint & time_out,
+    std::string * error_msg = NULL) const;
+
   /** \brief Test if a transform is possible
    * \param target_frame The frame into which to transform
    * \param source_frame The frame from which to transform
@@ -183,11 +530,285 @@ public:
     const std::string & source_frame, const TimePoint & source_time,
     const std::string & fixed_frame, std::string * error_msg = NULL) const override;
 
+  /** \brief Resolve a frame name once for the FrameHandle based lookups.
+   * \param frame_id The name of the frame
+   * \param error_msg A pointer to a string which will be filled with why the frame could not be
+   *   resolved, if not NULL.  Otherwise the reason is logged as a warning.
+   * \return The handle of the frame, which evaluates to false if frame_id is invalid or does not
+   *   exist yet
+   */
+  TF2_PUBLIC
+  FrameHandle resolveFrame(const std::string & frame_id, std::string * error_msg = NULL) const;
+
+  /** \brief Get the transform between two frames resolved by resolveFrame().
+   * \sa lookupTransform(const std::string&, const std::string&, const TimePoint&)
+   *
+   * Possible exceptions tf2::LookupException, tf2::ConnectivityException,
+   * tf2::ExtrapolationException
+   */
+  TF2_PUBLIC
+  geometry_msgs::msg::TransformStamped
+  lookupTransform(FrameHandle target_frame, FrameHandle source_frame, const TimePoint & time) const;
+
+  /** \brief Get the transform between two frames resolved by resolveFrame() assuming fixed frame.
+   * \sa lookupTransform(const std::string&, const TimePoint&, const std::string&,
+   *   const TimePoint&, const std::string&)
+   *
+   * Possible exceptions tf2::LookupException, tf2::ConnectivityException,
+   * tf2::ExtrapolationException
+   */
+  TF2_PUBLIC
+  geometry_msgs::msg::TransformStamped
+  lookupTransform(
+    FrameHandle target_frame, const TimePoint & target_time,
+    FrameHandle source_frame, const TimePoint & source_time,
+    FrameHandle fixed_frame) const;
+
+  /** \brief Test if a transform between two frames resolved by resolveFrame() is possible
+   * \sa canTransform(const std::string&, const std::string&, const TimePoint&, std::string*)
+   */
+  TF2_PUBLIC
+  bool canTransform(
+    FrameHandle target_frame, FrameHandle source_frame,
+    const TimePoint & time, std::string * error_msg = NULL) const;
+
+  /** \brief Test if a transform between frames resolved by resolveFrame() is possible
+   * \sa canTransform(const std::string&, const TimePoint&, const std::string&,
+   *   const TimePoint&, const std::string&, std::string*)
+   */
+  TF2_PUBLIC
+  bool canTransform(
+    FrameHandle target_frame, const TimePoint & target_time,
+    FrameHandle source_frame, const TimePoint & source_time,
+    FrameHandle fixed_frame, std::string * error_msg = NULL) const;
+
+  /** \brief Compile the chain of frames between two frames for repeated lookups.
+   * \param target_frame The frame to which data should be transformed
+   * \param source_frame The frame where the data originated
+   * \return A handle to pass to lookupTransform() and canTransform()
+   *
+   * Possible exceptions tf2::LookupException, tf2::InvalidArgumentException
+   */
+  TF2_PUBLIC
+  FrameChainHandle getFrameChain(
+    const std::string & target_frame, const std::string & source_frame) const;
+
+  /** \brief Get the transform along a chain compiled by getFrameChain().
+   * \param chain The chain between the target and the source frame
+   * \param time The time at which the value of the transform is desired. (0 will get the latest)
+   * \return The transform between the frames
+   *
+   * Possible exceptions tf2::LookupException, tf2::ConnectivityException,
+   * tf2::ExtrapolationException, tf2::InvalidArgumentException
+   */
+  TF2_PUBLIC
+  geometry_msgs::msg::TransformStamped
+  lookupTransform(const FrameChainHandle & chain, const TimePoint & time) const;
+
+  /** \brief Get the transform along a chain compiled by getFrameChain() without building a
+   *   message.
+   * \param[out] transform The transform between the frames
+   * \param[out] time_out The time stamp of the transform
+   * \sa lookupTransform(const FrameChainHandle&, const TimePoint&)
+   */
+  TF2_PUBLIC
+  void lookupTransform(
+    const FrameChainHandle & chain, const TimePoint & time,
+    tf2::Transform & transform, TimePoint & time_out) const;
+
+  /** \brief Get the transform along a chain compiled by getFrameChain(), returning an error
+   *   instead of throwing.
+   * \param[out] transform The transform between the frames, only set on success
+   * \param[out] time_out The time stamp of the transform, only set on success
+   * \sa tryLookupTransform(const std::string&, const std::string&, const TimePoint&,
+   *   geometry_msgs::msg::TransformStamped&, std::string*)
+   */
+  TF2_PUBLIC
+  tf2::TF2Error tryLookupTransform(
+    const FrameChainHandle & chain, const TimePoint & time,
+    tf2::Transform & transform, TimePoint & time_out, std::string * error_msg = NULL) const;
+
+  /** \brief Test if a transform is possible along a chain compiled by getFrameChain().
+   * \param chain The chain between the target and the source frame
+   * \param time The time at which to transform
+   * \param error_msg A pointer to a string which will be filled with why the transform failed, if not NULL
+   * \return True if the transform is possible, false otherwise
+   */
+  TF2_PUBLIC
+  bool canTransform(
+    const FrameChainHandle & chain, const TimePoint & time,
+    std::string * error_msg = NULL) const;
+
+  /** \brief Get the transform along a chain compiled by getFrameChain() from a real-time thread.
+   *
+   * Unlike lookupTransform() this never waits for the lock of the buffer, allocates, throws or
+   * logs, so a control loop can call it.  Latest (TimePointZero) lookups along a chain whose
+   * frames share their latest stamp take no lock at all.  Other ones try to take the lock
+   * shared and give up with tf2::TF2Error::TIMEOUT_ERROR while the buffer is being modified,
+   * that is while frames are added or reparented.  Inserting samples into existing frames does
+   * not hold it exclusively, the caches then only hold their own spin locks for the copy of a
+   * sample.  Releasing the lock may still have to wake a writer that is waiting for it.
+   *
+   * Compile the chain and size the caches with reserve() before entering the real-time loop.  A
+   * chain compiled before the tree changed is still looked up correctly, if more slowly.
+   * \param chain The chain between the target and the source frame
+   * \param time The time at which the value of the transform is desired. (0 will get the latest)
+   * \param[out] transform The transform between the frames, only set on success
+   * \param[out] time_out The time stamp of the transform, only set on success
+   * \return tf2::TF2Error::NO_ERROR on success, otherwise the error lookupTransform() would
+   *   have thrown, or TIMEOUT_ERROR if the lock was taken
+   */
+  TF2_PUBLIC
+  tf2::TF2Error lookupTransformRealtime(
+    const FrameChainHandle & chain, const TimePoint & time,
+    tf2::Transform & transform, TimePoint & time_out) const noexcept;
+
+  /** \brief Get the transforms between two frames at many times at once.
+   * \param target_frame The frame to which data should be transformed
+   * \param source_frame The frame where the data originated
+   * \param times The times at which the value of the transform is desired. (0 will get the latest)
+   * \return The transform between the frames at each of the times, in the same order
+   *
+   * The chain between the frames is walked once and each cache along it is swept through the
+   * sorted times in a single pass, which is much cheaper than one lookupTransform() per time
+   * when de-skewing a scan or sampling a trajectory.
+   *
+   * Possible exceptions tf2::LookupException, tf2::ConnectivityException,
+   * tf2::ExtrapolationException, tf2::InvalidArgumentException
+   */
+  TF2_PUBLIC
+  std::vector<geometry_msgs::msg::TransformStamped>
+  lookupTransforms(
+    const std::string & target_frame, const std::string & source_frame,
+    const std::vector<TimePoint> & times) const;
+
+  /** \brief Get the transforms between two frames at many times at once without building
+   *   messages.
+   * \param[out] transforms The transform between the frames at each of the times
+   * \param[out] times_out The time stamp of each of the transforms
+   * \sa lookupTransforms(const std::string&, const std::string&, const std::vector<TimePoint>&)
+   */
+  TF2_PUBLIC
+  void lookupTransforms(
+    const std::string & target_frame, const std::string & source_frame,
+    const std::vector<TimePoint> & times, std::vector<tf2::Transform> & transforms,
+    std::vector<TimePoint> & times_out) const;
+
+  /** \brief Get the transforms from one frame into several target frames at once.
+   * \param target_frames The frames to which data should be transformed
+   * \param source_frame The frame where the data originated
+   * \param time The time at which the value of the transforms is desired. (0 will get the latest)
+   * \return The transform from the source frame into each of the target frames, in the same order
+   *
+   * The source frame is walked up the tree once and each target only walks until it meets that
+   * path, so targets such as map, odom and base_link share the lookups of their common links.
+   * At time 0 each target uses its own latest common time, so they are looked up one by one.
+   *
+   * Possible exceptions tf2::LookupException, tf2::ConnectivityException,
+   * tf2::ExtrapolationException, tf2::InvalidArgumentException
+   */
+  TF2_PUBLIC
+  std::vector<geometry_msgs::msg::TransformStamped>
+  lookupTransforms(
+    const std::vector<std::string> & target_frames, const std::string & source_frame,
+    const TimePoint & time) const;
+
+  /** \brief Get the transforms from one frame into several target frames at once without
+   *   building messages.
+   * \param[out] transforms The transform from the source frame into each of the target frames
+   * \param[out] times_out The time stamp of each of the transforms
+   * \sa lookupTransforms(const std::vector<std::string>&, const std::string&, const TimePoint&)
+   */
+  TF2_PUBLIC
+  void lookupTransforms(
+    const std::vector<std::string> & target_frames, const std::string & source_frame,
+    const TimePoint & time, std::vector<tf2::Transform> & transforms,
+    std::vector<TimePoint> & times_out) const;
+
+  /** \brief Get the transforms of every frame below a root frame at one time.
+   * \param root_frame The frame to which all the other frames are transformed
+   * \param time The time at which the value of the transforms is desired.  0 will get the
+   *   latest common time of the dynamic frames below root_frame, their oldest latest stamp.
+   * \return The root followed by the frames below it, every frame after its parent
+   *
+   * The subtree is walked down once under a single lock, each frame composing its link with the
+   * transform of its parent, instead of walking every frame up to the root.  Frames without data
+   * at the time are left out together with everything below them.
+   *
+   * Possible exceptions tf2::LookupException, tf2::InvalidArgumentException
+   */
+  TF2_PUBLIC
+  std::vector<SubtreeTransform> lookupSubtree(
+    const std::string & root_frame, const TimePoint & time) const;
+
+  /** \brief Get the transforms of every frame below a root frame at one time into a reused
+   *   vector.
+   * \param[out] transforms The root followed by the frames below it
+   * \param[out] time_out The time the transforms were looked up at
+   * \sa lookupSubtree(const std::string&, const TimePoint&)
+   */
+  TF2_PUBLIC
+  void lookupSubtree(
+    const std::string & root_frame, const TimePoint & time,
+    std::vector<SubtreeTransform> & transforms, TimePoint & time_out) const;
+
+  /** \brief Get the velocity of one frame relative to another.
+   * \param tracking_frame The frame whose motion is tracked
+   * \param observation_frame The frame the motion is observed from and expressed in
+   * \param time The time at which the velocity is desired. (0 will get the latest)
+   * \param averaging_interval The span the poses are differenced over, centered on time
+   * \return The linear velocity of the origin of tracking_frame and the angular velocity of
+   *   tracking_frame, both relative to and expressed in observation_frame and stamped with time
+   *
+   * The interval is shifted back to end at the latest common time of the frames when it would
+   * reach past it. Both ends are looked up with a single walk of the chain, so this costs
+   * about as much as one lookupTransform(). Frames connected only by static transforms have a
+   * velocity of zero.
+   *
+   * Possible exceptions tf2::LookupException, tf2::ConnectivityException,
+   * tf2::ExtrapolationException, tf2::InvalidArgumentException
+   */
+  TF2_PUBLIC
+  geometry_msgs::msg::TwistStamped
+  lookupVelocity(
+    const std::string & tracking_frame, const std::string & observation_frame,
+    const TimePoint & time, const tf2::Duration & averaging_interval) const;
+
+  /** \brief Get the velocity of one frame relative to another without building a message.
+   * \param[out] linear The linear velocity in observation_frame
+   * \param[out] angular The angular velocity in observation_frame
+   * \param[out] time_out The time the velocity was computed for
+   * \sa lookupVelocity(const std::string&, const std::string&, const TimePoint&,
+   *   const tf2::Duration&)
+   */
+  TF2_PUBLIC
+  void lookupVelocity(
+    const std::string & tracking_frame, const std::string & observation_frame,
+    const TimePoint & time, const tf2::Duration & averaging_interval,
+    tf2::Vector3 & linear, tf2::Vector3 & angular, TimePoint & time_out) const;
+
   /** \brief Get all frames that exist in the system.
    */
   TF2_PUBLIC
   std::vector<std::string> getAllFrameNames() const override;
 
+  /** \brief A counter bumped whenever a frame is added, read without taking any lock.
+   * Callers enumerating the frames can compare it to skip enumerating when nothing changed.
+   */
+  TF2_PUBLIC
+  uint64_t getFrameTableVersion() const
+  {
+    return frame_table_version_.load(std::memory_order_acquire);
+  }
+
+  /** \brief Fill table with the frames getAllFrameNames() returns, without copying their names.
+   * \param table A table filled from this buffer before or a new one.  Only the frames added
+   *   since it was last filled are appended.
+   * \return False if the table was already up to date, in which case no lock is taken
+   */
+  TF2_PUBLIC
+  bool getFrameTable(FrameTable & table) const;
+
   /** \brief A way to see what frames have been cached in yaml format
    * Useful for debugging tools
    */
@@ -205,12 +826,25 @@ public:
   TF2_PUBLIC
   std::string allFramesAsString() const;
 
+  /** \brief Copy the parent, authority and history bounds of every frame.
+   *
+   * The copy is taken in one short pass under the frame lock, the string dumps above and
+   * _allFramesAsDot() are formatted from it afterwards so they do not hold up lookups.
+   * \return The frames ordered by their CompactFrameID, which is the order they appeared in
+   */
+  TF2_PUBLIC
+  std::vector<FrameGraphEntry> getFrameGraph() const;
+
   using TransformableCallback = std::function<
     void (TransformableRequestHandle request_handle, const std::string & target_frame,
     const std::string & source_frame,
     TimePoint time, TransformableResult result)>;
 
-  /// \brief Internal use only
+  /** \brief Internal use only
+   *
+   * cb is called without any of the buffer's mutexes held, so it may add requests of its own.
+   * A call that was already due can still happen after cancelTransformableRequest() returned.
+   */
   TF2_PUBLIC
   TransformableRequestHandle addTransformableRequest(
     const TransformableCallback & cb,
@@ -221,6 +855,43 @@ public:
   TF2_PUBLIC
   void cancelTransformableRequest(TransformableRequestHandle handle);
 
+  /// Like TransformableCallback, transform is NULL unless result is TransformAvailable
+  using TransformRequestCallback = std::function<
+    void (TransformableRequestHandle request_handle, const std::string & target_frame,
+    const std::string & source_frame, TimePoint time, TransformableResult result,
+    const geometry_msgs::msg::TransformStamped * transform)>;
+
+  /** \brief Internal use only
+   *
+   * addTransformableRequest() handing the transform from source_frame to target_frame at time
+   * to cb.  The buffer computes it while it checks the request, as soon as the samples around
+   * time arrive, so the caller does not have to look it up again.  Unlike
+   * addTransformableRequest() cb is also called when the result is known right away: before
+   * this returns 0 or 0xffffffffffffffff, with a request_handle of 0.
+   */
+  TF2_PUBLIC
+  TransformableRequestHandle addTransformRequest(
+    const TransformRequestCallback & cb,
+    const std::string & target_frame,
+    const std::string & source_frame,
+    TimePoint time);
+
+  /// Called with the newest sample of the frame, from its parent to the frame
+  using FrameCallback = std::function<
+    void (FrameSubscriptionHandle handle, const geometry_msgs::msg::TransformStamped & latest)>;
+
+  /** \brief Call cb every time frame_id receives data, instead of on inserts into any frame.
+   * cb is called by the inserting thread once per insert call that changed the samples of the
+   * frame, with the newest one, and without any of the buffer's mutexes held.  A call that was
+   * already due can still happen after unsubscribeFrame() returned.
+   * \param frame_id The child frame to watch, which does not need to exist yet
+   * \return The handle to pass to unsubscribeFrame(), 0 if frame_id is not a valid frame name
+   */
+  TF2_PUBLIC
+  FrameSubscriptionHandle subscribeFrame(const std::string & frame_id, const FrameCallback & cb);
+  TF2_PUBLIC
+  void unsubscribeFrame(FrameSubscriptionHandle handle);
+
 
   // Tell the buffer that there are multiple threads serviciing it.
   // This is useful for derived classes to know if they can block or not.
@@ -267,7 +938,7 @@ public:
     CompactFrameID target_frame, CompactFrameID source_frame,
     TimePoint & time, std::string * error_string) const
   {
-    std::unique_lock<std::mutex> lock(frame_mutex_);
+    std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
     return getLatestCommonTime(target_frame, source_frame, time, error_string);
   }
 
@@ -283,6 +954,121 @@ public:
   TF2_PUBLIC
   tf2::Duration getCacheLength() {return cache_time_;}
 
+  /** \brief Set how much history of a dynamic frame is kept.
+   * \param frame_id The frame, which does not need to exist yet
+   * \param policy The limits, which replace the buffer's cache time for this frame if it sets a
+   *   max_age.  Samples beyond them are dropped right away.  Whether the history is compressed
+   *   or single precision only changes when the frame next receives dynamic data after having
+   *   none or being static.
+   * \return False if frame_id is not a valid frame name
+   */
+  TF2_PUBLIC
+  bool setRetentionPolicy(const std::string & frame_id, const RetentionPolicy & policy);
+
+  /** \brief Set the retention policy of all frames without one of their own.
+   * Setting it before any data is inserted makes e.g. a replay buffer compress all history.
+   */
+  TF2_PUBLIC
+  void setDefaultRetentionPolicy(const RetentionPolicy & policy);
+
+  /** \brief Limit the memory taken up by the samples of all dynamic frames.
+   * \param bytes The limit, 0 for no limit.  When it is exceeded the oldest samples of the
+   *   frames with the longest histories are dropped.  The newest sample of each frame is always
+   *   kept.
+   */
+  TF2_PUBLIC
+  void setMemoryBudget(size_t bytes);
+
+  /** \brief Set aside storage so that a steady state within the reservation never allocates.
+   *
+   * Inserting samples into existing frames, looking up transforms and adding, satisfying or
+   * cancelling transformable requests then reuse what was set aside or freed before.  The
+   * callbacks of requests are std::function objects, which only allocate for callables larger
+   * than the small object buffer of the standard library.  Frame names do not allocate as long
+   * as they fit the small string buffer.
+   * \param reservation What to set aside.  Storage is never released, reserving less than
+   *   before keeps what was set aside.  samples_per_frame also applies to frames created later.
+   */
+  TF2_PUBLIC
+  void reserve(const BufferCoreReservation & reservation);
+
+  /** \brief Get the memory accounting of the buffer */
+  TF2_PUBLIC
+  BufferCoreStats getStats() const;
+
+  /** \brief Get the heap memory taken up by the buffer, broken down by what it holds.
+   *
+   * Takes every mutex of the buffer in turn, so it is meant for diagnostics and not for
+   * calling on every insert.  The history of each frame is also in getFrameGraph().
+   */
+  TF2_PUBLIC
+  BufferCoreMemoryStats memoryStats() const;
+
+  /** \brief Remember the results of recent lookups so that identical lookups from several
+   *   consumers are only computed once.
+   *
+   * Off by default.  Lookups between two different frames at the same time are answered from
+   * the cache until a sample of any frame between them is inserted or dropped.  The cache takes
+   * a mutex of its own on every such lookup, so it only pays off when several consumers look up
+   * the same transforms at the same stamps.  Hits and misses are counted in getMetrics().
+   * \param capacity The number of results to keep, 0 turns the cache off
+   */
+  TF2_PUBLIC
+  void setLookupCacheCapacity(size_t capacity);
+
+  /** \brief Start or stop recording the activity of the buffer, see getMetrics().
+   *
+   * Off by default.  While on, every lookup, canTransform and insert reads a steady clock twice
+   * and bumps a few relaxed atomic counters that are not shared with other threads.  Turning it
+   * off keeps the counts recorded so far.
+   */
+  TF2_PUBLIC
+  void setMetricsEnabled(bool enabled);
+
+  /** \brief Get the activity recorded since metrics were first enabled or last reset */
+  TF2_PUBLIC
+  BufferCoreMetrics getMetrics() const;
+
+  /** \brief Zero the counters returned by getMetrics() */
+  TF2_PUBLIC
+  void resetMetrics();
+
+  /** \brief Set how often rejected transforms are logged, see InsertErrorLog.
+   *
+   * Rejected transforms are counted as they come in and logged from a thread of the buffer, at
+   * most once per frame, authority and reason every period.  One second by default.
+   * \param period The shortest time between two messages, zero logs every rejected transform
+   *   right away from the inserting thread
+   */
+  TF2_PUBLIC
+  void setInsertErrorLogPeriod(tf2::Duration period);
+
+  /** \brief Get how many transforms were rejected so far by frame, authority and reason */
+  TF2_PUBLIC
+  std::vector<InsertErrorCount> getInsertErrors() const;
+
+  /** \brief Write the frame names, authorities and every sample of the buffer to a file.
+   *
+   * The file is a header followed by flat tables of frames and samples in host byte order, so
+   * it can be memory mapped or read back with a single read.
+   * \param path The file to write, replaced if it exists
+   * \return False if the file could not be written
+   */
+  TF2_PUBLIC
+  bool saveSnapshot(const std::string & path) const;
+
+  /** \brief Insert the samples of a file written by saveSnapshot().
+   *
+   * The samples are inserted like setTransform() would with the authority they were set with,
+   * on top of what the buffer already holds, and are subject to its cache time and retention
+   * policies.
+   * \param path The file to read
+   * \return False if the file could not be read or is not a valid snapshot, in which case the
+   *   buffer is left unchanged
+   */
+  TF2_PUBLIC
+  bool loadSnapshot(const std::string & path);
+
   /** \brief Backwards compatabilityA way to see what frames have been cached
    * Useful for debugging
    */
@@ -307,6 +1093,9 @@ private:
    */
   std::string allFramesAsStringNoLock() const;
 
+  /// getFrameGraph() for callers that hold frame_mutex_
+  std::vector<FrameGraphEntry> getFrameGraphNoLock() const;
+
 
   /******************** Internal Storage ****************/
 
@@ -315,69 +1104,286 @@ private:
   typedef std::vector<TimeCacheInterfacePtr> V_TimeCacheInterface;
   V_TimeCacheInterface frames_;
 
-  /** \brief A mutex to protect testing and allocating new frames on the above vector. */
-  mutable std::mutex frame_mutex_;
+  /** \brief The kind of cache each frame in frames_ has. */
+  enum class FrameType : uint8_t
+  {
+    Unallocated,
+    Static,
+    Dynamic,
+  };
+
+  /** \brief Dense per frame tables indexed like frames_, so walking the tree touches contiguous
+   * memory and only calls into the caches of dynamic frames.
+   * frame_parents_ is the latest parent of each frame, 0 if it has no data.
+   * static_transforms_ is only valid for frames whose type is FrameType::Static. */
+  std::vector<FrameType> frame_types_;
+  std::vector<CompactFrameID> frame_parents_;
+  std::vector<TransformStorage> static_transforms_;
+
+  /** \brief For each dynamic frame, the newest stamp at or before which its history may hold
+   * samples of a parent other than frame_parents_.  Raised on insert whenever a sample with
+   * another parent arrives, so canTransformFromBoundsNoLock() knows the parent after it. */
+  std::vector<TimePoint> reparent_stamps_;
+
+  /** \brief For each dynamic frame whose history is a full precision TimeCache, that cache, so
+   * walks call into it directly instead of through TimeCacheInterface.  nullptr otherwise. */
+  std::vector<TimeCache *> time_caches_;
+
+  /** \brief For each static frame, its transform to the nearest ancestor that is not static.
+   * The frame_id_ of each entry is that ancestor, so walks cross a run of static frames with a
+   * single multiply.  Only valid for frames whose type is FrameType::Static. */
+  std::vector<TransformStorage> static_segments_;
+
+  /// The retention policies set with setRetentionPolicy(), applied whenever a frame turns dynamic
+  std::unordered_map<CompactFrameID, RetentionPolicy> retention_policies_;
+  /// The retention policy of the frames without one in retention_policies_
+  RetentionPolicy default_retention_policy_;
+
+  /// Samples reserved in the cache of each dynamic frame, see reserve()
+  size_t sample_reservation_;
+
+  /** \brief For each frame, bumped after every change to its samples so results in
+   * lookup_cache_ computed from older ones are told apart.  A deque since frames are added
+   * while lookups read it, with frame_mutex_ held exclusively. */
+  std::deque<std::atomic<uint64_t>> frame_versions_;
+  /// See setLookupCacheCapacity(), replaced with frame_mutex_ held exclusively
+  std::unique_ptr<LookupCache> lookup_cache_;
+
+  /// Memory accounting of the dynamic frames, see getStats()
+  size_t memory_budget_;
+  /// Also updated with frame_mutex_ held shared, by tryInsertSampleSharedLock()
+  std::atomic<size_t> sample_count_;
+  uint64_t evicted_samples_;
+
+  /** \brief A mutex to protect testing and allocating new frames on the above vector.
+   * Lookups only take it shared so they do not block each other, anything that modifies
+   * the frames must take it exclusively.  The caches lock themselves, so new samples that
+   * leave the frames untouched are inserted with it held shared. */
+  mutable std::shared_timed_mutex frame_mutex_;
+
+  /** \brief Incremented whenever frames are added or reparented, see FrameChain.
+   * Only modified with frame_mutex_ held exclusively, but read without it by
+   * lookupLatestLockFree(). */
+  std::atomic<uint64_t> topology_version_;
+
+  /** \brief Chains compiled by lookups, keyed by target and source CompactFrameID */
+  mutable std::unordered_map<uint64_t, FrameChainHandle> frame_chains_;
+  /** \brief A mutex to protect frame_chains_, taken after frame_mutex_ */
+  mutable std::shared_timed_mutex frame_chains_mutex_;
 
   /** \brief A map from string frame ids to CompactFrameID */
   typedef std::unordered_map<std::string, CompactFrameID> M_StringToCompactFrameID;
   M_StringToCompactFrameID frameIDs_;
-  /** \brief A map from CompactFrameID frame_id_numbers to string for debugging and output */
-  std::vector<std::string> frameIDs_reverse_;
-  /** \brief A map to lookup the most recent authority for a given frame */
-  std::map<CompactFrameID, std::string> frame_authority_;
+  /** \brief A map from CompactFrameID frame_id_numbers to string for debugging and output.  A
+   * deque so the names stay in place as frames are added, see FrameTable. */
+  std::deque<std::string> frameIDs_reverse_;
+  /// See getFrameTableVersion(), bumped with frame_mutex_ held exclusively
+  std::atomic<uint64_t> frame_table_version_;
+  /** \brief The authority of the most recent transform of each frame as an index into
+   * authorities_, 0 if none was recorded.  Interning saves copying the authority on inserts. */
+  std::vector<uint32_t> frame_authorities_;
+  /** \brief The authorities met so far, authorities_[0] stands for none */
+  std::vector<std::string> authorities_;
+  std::unordered_map<std::string, uint32_t> authority_ids_;
 
 
   /// How long to cache transform history
   tf2::Duration cache_time_;
 
-  typedef uint32_t TransformableCallbackHandle;
-
-  typedef std::unordered_map<TransformableCallbackHandle,
-      TransformableCallback> M_TransformableCallback;
-  M_TransformableCallback transformable_callbacks_;
-  uint32_t transformable_callbacks_counter_;
-  std::mutex transformable_callbacks_mutex_;
+  /// The callback of a request, ready_cb for the requests of addTransformRequest()
+  struct RequestCallback
+  {
+    TransformableCallback cb;
+    TransformRequestCallback ready_cb;
+  };
 
   struct TransformableRequest
   {
     TimePoint time;
-    TransformableRequestHandle request_handle;
-    TransformableCallbackHandle cb_handle;
+    /// 0 while the slot is free
+    TransformableRequestHandle request_handle = 0;
+    /// Bumped whenever the slot is handed out, so handles of earlier requests no longer match
+    uint32_t generation = 0;
+    RequestCallback cb;
     CompactFrameID target_id;
     CompactFrameID source_id;
     std::string target_string;
     std::string source_string;
+    /// The frames the request is indexed under in transformable_requests_by_frame_
+    std::vector<CompactFrameID> indexed_frames;
+    /// Look the transform up when the request becomes transformable, see addTransformRequest()
+    bool stage_transform;
+  };
+  /** \brief The requests along with their callbacks, pending ones and finished ones kept in
+   * free_request_slots_.  Slots are reused along with the storage of their strings and vectors.
+   * The handle of a request is its slot tagged with the generation of the slot, so finding,
+   * cancelling and satisfying a request takes no search. */
+  std::vector<TransformableRequest> transformable_request_slots_;
+  std::vector<size_t> free_request_slots_;
+  /// The number of slots holding a pending request
+  size_t num_transformable_requests_;
+  /** \brief Pending requests indexed by the frames between their source and target frames and
+   * the roots of the tree, sorted by requested time.  An insert into a frame only needs to
+   * recheck the requests filed under that frame.  Indexed by CompactFrameID, emptied vectors
+   * keep their capacity.  Entries of finished requests are left behind as tombstones, their
+   * handles no longer match a slot, and swept out once they outnumber the live ones. */
+  typedef std::vector<std::pair<TimePoint, TransformableRequestHandle>>
+    V_TimeToTransformableRequest;
+  std::vector<V_TimeToTransformableRequest> transformable_requests_by_frame_;
+  /// The entries in transformable_requests_by_frame_, and how many of them are tombstones
+  size_t num_indexed_requests_;
+  size_t num_stale_indexed_requests_;
+
+  /// A request whose callback testTransformableRequests() is about to call
+  struct ReadyRequest
+  {
+    TransformableRequestHandle request_handle;
+    std::string target_frame;
+    std::string source_frame;
+    TimePoint time;
+    TransformableResult result;
+    /// The transform looked up for a request of addTransformRequest()
+    tf2::Transform transform;
+    TimePoint time_out;
+    /// Taken out of the slot of the request so it can be called without holding the mutex
+    RequestCallback cb;
+  };
+  /// Scratch space of testTransformableRequests(), only ever grown so it is reused
+  std::vector<TransformableRequestHandle> transformable_candidates_;
+  std::vector<ReadyRequest> ready_requests_;
+  mutable std::mutex transformable_requests_mutex_;
+
+  /// A subscription of subscribeFrame(), shared with the notifications that are being called
+  struct FrameSubscription
+  {
+    FrameSubscriptionHandle handle;
+    std::shared_ptr<const FrameCallback> cb;
   };
-  typedef std::vector<TransformableRequest> V_TransformableRequest;
-  V_TransformableRequest transformable_requests_;
-  std::mutex transformable_requests_mutex_;
-  uint64_t transformable_requests_counter_;
+  /// The subscriptions of each frame, indexed by CompactFrameID
+  std::vector<std::vector<FrameSubscription>> frame_subscriptions_;
+  /// The frame of each subscription
+  std::unordered_map<FrameSubscriptionHandle, CompactFrameID> frame_subscription_frames_;
+  FrameSubscriptionHandle frame_subscriptions_counter_;
+  /// Lets inserts skip notifyFrameSubscribers() without locking while there are none
+  std::atomic<size_t> num_frame_subscriptions_;
+  /// Guards the frame subscriptions, taken before frame_mutex_
+  mutable std::mutex frame_subscriptions_mutex_;
+
+  /** \brief The counters behind getMetrics(), allocated when metrics are first enabled and
+   * kept until destruction so callers never see it go away. */
+  std::unique_ptr<BufferCoreMetricsRecorder> metrics_;
+  std::atomic<bool> metrics_enabled_;
+  /** \brief A mutex to protect allocating metrics_ */
+  mutable std::mutex metrics_mutex_;
+
+  /// Counts and logs rejected transforms, it guards itself
+  mutable InsertErrorLog insert_error_log_;
+
+  /// metrics_ while metrics are enabled, nullptr otherwise
+  BufferCoreMetricsRecorder * activeMetrics() const
+  {
+    return metrics_enabled_.load(std::memory_order_acquire) ? metrics_.get() : nullptr;
+  }
 
 
   /************************* Internal Functions ****************************/
 
   bool setTransformImpl(
-    const tf2::Transform & transform_in, const std::string frame_id,
-    const std::string child_frame_id, const TimePoint stamp,
+    const tf2::Transform & transform_in, const std::string & frame_id,
+    const std::string & child_frame_id, const TimePoint stamp,
     const std::string & authority, bool is_static);
+
+  /** \brief Check a transform for invalid frame ids and values, reporting why it is rejected */
+  bool validateTransform(
+    const tf2::Transform & transform_in, const std::string & stripped_frame_id,
+    const std::string & stripped_child_frame_id, const std::string & authority) const;
+  /// validateTransform() with the values already checked by batch::checkTransforms()
+  bool validateTransform(
+    const tf2::Transform & transform_in, const std::string & stripped_frame_id,
+    const std::string & stripped_child_frame_id, const std::string & authority,
+    uint8_t value_errors) const;
+
+  /** \brief Insert a validated transform, frame_mutex_ must be held exclusively
+   * \param[out] frame_number The CompactFrameID of the child frame that was updated
+   * \param[out] topology_changed Set to true if the insert added a frame, changed the parent
+   *   of a frame or changed the type of its cache.  Left untouched otherwise.
+   */
+  bool insertTransformNoLock(
+    const tf2::Transform & transform_in, const std::string & stripped_frame_id,
+    const std::string & stripped_child_frame_id, const TimePoint stamp,
+    const std::string & authority, bool is_static,
+    CompactFrameID & frame_number, bool & topology_changed);
+
+  /** \brief Insert a validated transform with frame_mutex_ held shared, if all it changes is
+   * the history of an existing dynamic frame with the same parent and authority.
+   * \param[out] frame_number The CompactFrameID of the child frame if it was handled
+   * \param[out] inserted Whether the sample was inserted if it was handled
+   * \return false if the insert must be done by insertTransformNoLock() instead
+   */
+  bool tryInsertSampleSharedLock(
+    const tf2::Transform & transform_in, const std::string & stripped_frame_id,
+    const std::string & stripped_child_frame_id, const TimePoint stamp,
+    const std::string & authority, bool is_static,
+    CompactFrameID & frame_number, bool & inserted);
+
   void lookupTransformImpl(
     const std::string & target_frame, const std::string & source_frame,
     const TimePoint & time_in, tf2::Transform & transform, TimePoint & time_out) const;
 
+  /** \brief Lookup between two existing frames, frame_mutex_ must be held. */
+  void lookupTransformNoLock(
+    CompactFrameID target_id, CompactFrameID source_id, const TimePoint & time,
+    tf2::Transform & transform, TimePoint & time_out) const;
+
+  /** \brief Lookup along chain, falling back to walkToTopParent() if the chain does not
+   * apply at time.  frame_mutex_ must be held. */
+  void lookupTransformNoLock(
+    const FrameChain & chain, const TimePoint & time,
+    tf2::Transform & transform, TimePoint & time_out) const;
+
+  /** \brief lookupTransformNoLock() returning the error instead of throwing it.  The message
+   * is only formatted if error_msg is not NULL. */
+  tf2::TF2Error tryLookupTransformNoLock(
+    CompactFrameID target_id, CompactFrameID source_id, const TimePoint & time,
+    tf2::Transform & transform, TimePoint & time_out, std::string * error_msg) const;
+  tf2::TF2Error tryLookupTransformNoLock(
+    const FrameChain & chain, const TimePoint & time,
+    tf2::Transform & transform, TimePoint & time_out, std::string * error_msg) const;
+
   void lookupTransformImpl(
     const std::string & target_frame, const TimePoint & target_time,
     const std::string & source_frame, const TimePoint & source_time,
     const std::string & fixed_frame, tf2::Transform & transform, TimePoint & time_out) const;
 
+  /** \brief Lookup between existing frames assuming fixed frame, frame_mutex_ must be held. */
+  void lookupTransformNoLock(
+    CompactFrameID target_id, const TimePoint & target_time,
+    CompactFrameID source_id, const TimePoint & source_time,
+    CompactFrameID fixed_id, tf2::Transform & transform, TimePoint & time_out) const;
+
   /** \brief An accessor to get a frame, which will throw an exception if the frame is no there.
    * \param frame_number The frameID of the desired Reference Frame
    *
    * This is an internal function which will get the pointer to the frame associated with the frame id
+   * The pointer is owned by frames_ and only valid while frame_mutex_ is held.
    * Possible Exception: tf::LookupException
    */
-  TimeCacheInterfacePtr getFrame(CompactFrameID c_frame_id) const;
+  TimeCacheInterface * getFrame(CompactFrameID c_frame_id) const;
+
+  TimeCacheInterface * allocateFrame(CompactFrameID cfid, bool is_static);
+
+  /** \brief Recompute static_segments_ after a static transform or the type of a frame
+   * changed.  frame_mutex_ must be held exclusively. */
+  void updateStaticSegmentsNoLock();
+
+  /** \brief Drop samples until the dynamic frames fit in memory_budget_.
+   * frame_mutex_ must be held exclusively. */
+  void enforceMemoryBudgetNoLock();
 
-  TimeCacheInterfacePtr allocateFrame(CompactFrameID cfid, bool is_static);
+  const RetentionPolicy & getRetentionPolicyNoLock(CompactFrameID frame_number) const;
+
+  /// Apply the retention policy of a frame to its cache if it is dynamic
+  void applyRetentionPolicyNoLock(CompactFrameID frame_number);
 
   /** \brief Validate a frame ID format and look up its CompactFrameID.
     *   For invalid cases, produce an message.
@@ -406,12 +1412,40 @@ private:
     const char * function_name_arg,
     const std::string & frame_id) const;
 
+  /** \brief Validate a frame ID format and look up its compact ID without throwing or logging.
+    * \param[out] id The CompactFrameID of the existing frame
+    * \param[out] error_msg if non-NULL, filled with the message validateFrameId() would throw
+    * \return INVALID_ARGUMENT_ERROR or LOOKUP_ERROR in the cases validateFrameId() throws
+    */
+  tf2::TF2Error checkFrameId(
+    const char * function_name_arg, const std::string & frame_id,
+    CompactFrameID & id, std::string * error_msg) const;
+
   /// String to number for frame lookup. Returns 0 if the frame was not found.
   CompactFrameID lookupFrameNumber(const std::string & frameid_str) const;
 
   /// String to number for frame lookup with dynamic allocation of new frames
   CompactFrameID lookupOrInsertFrameNumber(const std::string & frameid_str);
 
+  /// The index of authority in authorities_, adding it if new.  frame_mutex_ must be held
+  /// exclusively.
+  uint32_t internAuthority(const std::string & authority);
+
+  /// Mark the samples of a frame as changed for lookup_cache_
+  void bumpFrameVersion(CompactFrameID frame_number)
+  {
+    frame_versions_[frame_number].fetch_add(1, std::memory_order_release);
+  }
+
+  /// The sum of the frame versions along a chain, which grows whenever any of its samples change
+  uint64_t chainDataVersionNoLock(const FrameChain & chain) const;
+
+  /// The authority of the most recent transform of a frame, empty if none was recorded
+  const std::string & lookupAuthority(CompactFrameID frame_number) const
+  {
+    return authorities_[frame_authorities_[frame_number]];
+  }
+
   /// Number to string frame lookup may throw LookupException if number invalid
   const std::string & lookupFrameString(CompactFrameID frame_id_num) const;
 
@@ -438,7 +1472,98 @@ private:
     CompactFrameID source_id, std::string * error_string,
     std::vector<CompactFrameID> * frame_chain) const;
 
-  void testTransformableRequests();
+  /** \brief Get the cached chain between two frames, possibly stale, without frame_mutex_.
+   * \return nullptr if no lookup compiled the chain yet */
+  FrameChainHandle findFrameChain(CompactFrameID target_id, CompactFrameID source_id) const;
+
+  /** \brief Latest lookup along chain from the snapshots of its caches, without frame_mutex_.
+   * \return false if the chain is stale or its frames do not share their latest stamp, in which
+   *   case lookupTransformNoLock() has to be used */
+  bool lookupLatestLockFree(
+    const FrameChain & chain, tf2::Transform & transform, TimePoint & time_out) const;
+
+  /** \brief Get the chain between two existing frames, compiling it if the cached one is
+   * missing or stale.  frame_mutex_ must be held. */
+  FrameChainHandle getFrameChainNoLock(CompactFrameID target_id, CompactFrameID source_id) const;
+
+  /** \brief Fill chain with the frames between its target and source along their latest parents.
+   * frame_mutex_ must be held. */
+  void compileFrameChainNoLock(FrameChain & chain) const;
+
+  /** \brief Accumulate f along a compiled chain.
+   * \return false if the frames at time are not connected as they were when the chain was
+   *   compiled, in which case the result of f is undefined and walkToTopParent() must be used */
+  template<typename F>
+  bool walkFrameChain(F & f, TimePoint time, const FrameChain & chain) const;
+
+  /** \brief Accumulate fs[i] along a compiled chain at times[i] for all of the times.
+   * \param times The times, sorted from oldest to newest and none of them zero
+   * \return false if the chain does not apply at all of the times, same as walkFrameChain() */
+  template<typename F>
+  bool walkFrameChain(
+    std::vector<F> & fs, const std::vector<TimePoint> & times, const FrameChain & chain) const;
+
+  /** \brief Tell whether chain can be walked at time from the history bounds of its links alone.
+   *
+   * Each dynamic link only needs time inside its oldest and newest stamps and after its last
+   * reparenting, which takes two reads per link and no search or interpolation.
+   * \return true if the walk would succeed, false if that cannot be told this way and the chain
+   *   must be walked.  frame_mutex_ must be held. */
+  bool canTransformFromBoundsNoLock(const FrameChain & chain, TimePoint time) const;
+
+  /** \brief Fire the callbacks of pending requests that became transformable or impossible.
+   * \param updated_frames The frames that just received data
+   * \param topology_changed If true every pending request is rechecked and reindexed,
+   *   otherwise only the requests indexed under updated_frames are rechecked
+   */
+  void testTransformableRequests(
+    const std::vector<CompactFrameID> & updated_frames, bool topology_changed)
+  {
+    testTransformableRequests(updated_frames.data(), updated_frames.size(), topology_changed);
+  }
+  void testTransformableRequests(
+    const CompactFrameID * updated_frames, size_t num_updated_frames, bool topology_changed);
+
+  /** \brief Call back the first num_ready entries of ready, taken out of ready_requests_.
+   * \param lock Holds transformable_requests_mutex_, it is released while calling back
+   */
+  void callReadyRequests(
+    std::unique_lock<std::mutex> & lock, std::vector<ReadyRequest> & ready, size_t num_ready);
+
+  /// Call the subscriptions of the frames that just received data, see subscribeFrame()
+  void notifyFrameSubscribers(const CompactFrameID * updated_frames, size_t num_updated_frames);
+  void notifyFrameSubscribers(const std::vector<CompactFrameID> & updated_frames)
+  {
+    notifyFrameSubscribers(updated_frames.data(), updated_frames.size());
+  }
+
+  /// Set the indexed_frames of req to the frames between its source and target and their roots,
+  /// frame_mutex_ and transformable_requests_mutex_ must be held
+  void findIndexedFrames(TransformableRequest & req) const;
+  /// File req under the frames between its source and target and their roots,
+  /// frame_mutex_ and transformable_requests_mutex_ must be held
+  void indexTransformableRequest(TransformableRequest & req);
+  /// Refile every pending request in one pass, after the tree changed.
+  /// frame_mutex_ and transformable_requests_mutex_ must be held
+  void rebuildTransformableRequestIndex();
+  /// Turn the entries of req in transformable_requests_by_frame_ into tombstones, sweeping
+  /// them out when there are too many.  transformable_requests_mutex_ must be held
+  void unindexTransformableRequest(TransformableRequest & req);
+  /// The slot of a pending request, nullptr if it is no longer pending.
+  /// transformable_requests_mutex_ must be held
+  TransformableRequest * findTransformableRequest(TransformableRequestHandle handle);
+  /// Free the slot of a request, moving its callback to cb.  unindex is false when the index
+  /// is cleared or rebuilt anyway.  Takes constant time unless it sweeps out the tombstones.
+  /// transformable_requests_mutex_ must be held
+  void releaseTransformableRequest(size_t slot, RequestCallback & cb, bool unindex = true);
+  /** \brief addTransformableRequest() and addTransformRequest()
+   * \param transform If not NULL the transform is staged.  It is then set along with time_out
+   *   when 0 is returned because the request is transformable right away.
+   */
+  TransformableRequestHandle addTransformableRequestImpl(
+    RequestCallback callback, const std::string & target_frame,
+    const std::string & source_frame, TimePoint time,
+    tf2::Transform * transform, TimePoint * time_out);
   // Thread safe transform check, acquire lock and call canTransformNoLock.
   bool canTransformInternal(
     CompactFrameID target_id, CompactFrameID source_id,
@@ -0,0 +1,173 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef TF2__BUFFER_CORE_METRICS_H_
+#define TF2__BUFFER_CORE_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "tf2/exceptions.h"
+#include "tf2/visibility_control.h"
+
+namespace tf2
+{
+
+/** \brief Latencies counted in power of two nanosecond buckets */
+struct LatencyHistogram
+{
+  /// Bucket i counts latencies of at least 2^i and less than 2^(i+1) nanoseconds
+  static constexpr size_t BUCKETS = 32;
+
+  std::array<uint64_t, BUCKETS> counts{};
+  /// Sum of all latencies in nanoseconds
+  uint64_t total_ns = 0;
+
+  /** \brief The number of latencies counted */
+  TF2_PUBLIC
+  uint64_t count() const;
+
+  /** \brief The mean latency in nanoseconds */
+  TF2_PUBLIC
+  double meanNs() const;
+
+  /** \brief An upper bound of the latency below which fraction of the calls fall
+   * \return The upper end of the bucket that holds the percentile, 0 with no calls
+   */
+  TF2_PUBLIC
+  uint64_t percentileNs(double fraction) const;
+};
+
+/** \brief The groups of BufferCore calls that are instrumented */
+enum class BufferCoreCall : uint8_t
+{
+  /// lookupTransform() and lookupTransforms()
+  Lookup = 0,
+  /// canTransform()
+  CanTransform = 1,
+  /// setTransform() and setTransforms()
+  Insert = 2,
+};
+
+/** \brief The counters of one group of calls */
+struct BufferCoreCallMetrics
+{
+  uint64_t calls = 0;
+  /** \brief Failed calls by cause, indexed by TF2Error.
+   *
+   * Lookups are counted by the exception they throw and rejected inserts as
+   * INVALID_ARGUMENT_ERROR.  canTransform() does not report a cause, so its failures count as
+   * TRANSFORM_ERROR.  The NO_ERROR entry is always 0.
+   */
+  std::array<uint64_t, 7> failures{};
+  LatencyHistogram latency;
+
+  /** \brief The total number of failed calls */
+  TF2_PUBLIC
+  uint64_t failureCount() const;
+};
+
+/** \brief Activity of a BufferCore, see BufferCore::setMetricsEnabled() */
+struct BufferCoreMetrics
+{
+  BufferCoreCallMetrics lookup;
+  BufferCoreCallMetrics can_transform;
+  BufferCoreCallMetrics insert;
+
+  /// How often inserts took frame_mutex_ exclusively, and how long they waited and held it
+  uint64_t exclusive_lock_count = 0;
+  uint64_t exclusive_lock_wait_ns = 0;
+  uint64_t exclusive_lock_hold_ns = 0;
+
+  /// Transformable requests waiting for data when the metrics were read
+  size_t pending_transformable_requests = 0;
+  /// Lookups answered from, and missing, the cache of BufferCore::setLookupCacheCapacity()
+  uint64_t lookup_cache_hits = 0;
+  uint64_t lookup_cache_misses = 0;
+  /// The number of samples kept by each dynamic frame when the metrics were read
+  std::map<std::string, size_t> history_lengths;
+};
+
+/** \brief The counters behind BufferCoreMetrics.
+ *
+ * Counters are spread over padded shards and each thread always updates the same
+ * shard with relaxed atomics, so concurrent callers rarely share a cache line and recording
+ * stays cheap enough to leave on.  Reading sums the shards.
+ */
+class BufferCoreMetricsRecorder
+{
+public:
+  TF2_PUBLIC
+  void recordCall(BufferCoreCall call, TF2Error error, uint64_t latency_ns);
+
+  TF2_PUBLIC
+  void recordExclusiveLock(uint64_t wait_ns, uint64_t hold_ns);
+
+  /** \brief Add the counters to the call and lock fields of metrics */
+  TF2_PUBLIC
+  void collect(BufferCoreMetrics & metrics) const;
+
+  TF2_PUBLIC
+  void reset();
+
+private:
+  static constexpr size_t SHARDS = 16;
+  static constexpr size_t CALLS = 3;
+
+  struct CallCounters
+  {
+    std::atomic<uint64_t> calls{0};
+    std::array<std::atomic<uint64_t>, 7> failures{};
+    std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKETS> latency{};
+    std::atomic<uint64_t> latency_total_ns{0};
+  };
+
+  struct Shard
+  {
+    std::array<CallCounters, CALLS> calls;
+    std::atomic<uint64_t> lock_count{0};
+    std::atomic<uint64_t> lock_wait_ns{0};
+    std::atomic<uint64_t> lock_hold_ns{0};
+    // Keeps the last counters of a shard off the cache line of the next one.  Padding instead
+    // of alignas, since C++14 new does not honor extended alignment.
+    char padding[64];
+  };
+
+  Shard & localShard();
+
+  std::array<Shard, SHARDS> shards_;
+};
+
+}  // namespace tf2
+
+#endif  // TF2__BUFFER_CORE_METRICS_H_
@@ -0,0 +1,159 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TF2__COMPACT_TF_H_
+#define TF2__COMPACT_TF_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "geometry_msgs/msg/transform_stamped.hpp"
+#include "tf2/buffer_core.h"
+#include "tf2/time.h"
+#include "tf2/visibility_control.h"
+
+namespace tf2
+{
+
+/** \brief One packet of the compact transform encoding, the fields of tf2_msgs/CompactTFMessage.
+ *
+ * Frame names are sent once and referred to by their index in a dictionary the receiver keeps.
+ * data holds one record per transform: the varint indices of the child and the parent frame,
+ * the zigzag varint difference of its stamp in nanoseconds to the stamp of the previous record
+ * (base_stamp for the first) and its pose.  Exact poses are seven little endian doubles, the
+ * translation followed by the rotation.  Quantized poses are the zigzag varint multiples of
+ * translation_resolution of the translation, then the index of the largest rotation component in
+ * a byte and the other three components as little endian int16 multiples of 1/32767, with the
+ * quaternion's sign chosen to make the largest one positive.
+ */
+struct CompactTFPacket
+{
+  /// Identifies the dictionary of the encoder, which starts over when the encoder does
+  uint32_t dictionary_epoch = 0;
+  /// The dictionary index of the first of new_frames, 0 when the whole dictionary is sent
+  uint32_t dictionary_offset = 0;
+  std::vector<std::string> new_frames;
+  TimePoint base_stamp;
+  /// The translation step of quantized poses in meters, 0 if the poses are exact
+  double translation_resolution = 0.0;
+  std::vector<uint8_t> data;
+};
+
+/** \brief How a CompactTFEncoder encodes transforms */
+struct CompactTFEncoderOptions
+{
+  /** \brief Quantize translations to multiples of this many meters and rotation components to
+   *   steps of 1/32767, 0 to send exact poses
+   */
+  double translation_resolution = 0.0;
+  /** \brief Send the whole dictionary every this many packets, so that receivers that joined
+   *   late or lost a packet with new frames catch up.  0 only sends it in the first packet.
+   */
+  uint32_t keyframe_interval = 100;
+};
+
+/** \brief Encodes transforms into CompactTFPackets for a stream of packets to CompactTFDecoders */
+class CompactTFEncoder
+{
+public:
+  TF2_PUBLIC
+  explicit CompactTFEncoder(const CompactTFEncoderOptions & options = CompactTFEncoderOptions());
+
+  /** \brief Encode transforms into packet, reusing its storage */
+  TF2_PUBLIC
+  void encode(
+    const std::vector<geometry_msgs::msg::TransformStamped> & transforms,
+    CompactTFPacket & packet);
+
+private:
+  /// The dictionary index of frame_id, adding it to the dictionary and packet if it is new
+  uint32_t frameIndex(const std::string & frame_id, CompactTFPacket & packet);
+
+  CompactTFEncoderOptions options_;
+  uint32_t epoch_;
+  uint64_t packets_;
+  std::unordered_map<std::string, uint32_t> frame_indices_;
+  std::vector<std::string> frames_;
+};
+
+/** \brief Counters of a CompactTFDecoder */
+struct CompactTFDecoderStats
+{
+  uint64_t packets = 0;
+  /// Packets that ended in the middle of a record, the records before it were decoded
+  uint64_t malformed_packets = 0;
+  uint64_t transforms = 0;
+  /// Transforms that referred to frames missing from the dictionary, until the next keyframe
+  uint64_t unknown_frame_transforms = 0;
+};
+
+/** \brief Decodes the packets of one CompactTFEncoder */
+class CompactTFDecoder
+{
+public:
+  TF2_PUBLIC
+  CompactTFDecoder();
+
+  /** \brief Insert the transforms of packet into buffer, without building messages
+   * \return False if packet was malformed
+   */
+  TF2_PUBLIC
+  bool decode(
+    const CompactTFPacket & packet, BufferCore & buffer, const std::string & authority,
+    bool is_static = false);
+
+  /** \brief Decode the transforms of packet into messages, to bridge back to tf2_msgs/TFMessage
+   * \return False if packet was malformed
+   */
+  TF2_PUBLIC
+  bool decode(
+    const CompactTFPacket & packet, std::vector<geometry_msgs::msg::TransformStamped> & transforms);
+
+  TF2_PUBLIC
+  const CompactTFDecoderStats & getStats() const;
+
+private:
+  void updateDictionary(const CompactTFPacket & packet);
+
+  /// Call f(transform, parent, child, stamp) for every record whose frames are known
+  template<typename F>
+  bool decodeRecords(const CompactTFPacket & packet, F f);
+
+  uint32_t epoch_;
+  /// False until the first keyframe, and again after the encoder started over
+  bool synced_;
+  std::vector<std::string> frames_;
+  CompactTFDecoderStats stats_;
+};
+
+}  // namespace tf2
+
+#endif  // TF2__COMPACT_TF_H_
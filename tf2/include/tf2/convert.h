@@ -33,6 +33,7 @@
 
 #include <array>
 #include <string>
+#include <type_traits>
 
 #include "builtin_interfaces/msg/time.hpp"
 #include "geometry_msgs/msg/transform_stamped.hpp"
@@ -59,6 +60,20 @@ void doTransform(
   const T & data_in, T & data_out,
   const geometry_msgs::msg::TransformStamped & transform);
 
+/**\brief Apply a transform to data in place
+ *
+ * The default copies the data and calls the three argument doTransform(). Types that are
+ * expensive to copy, such as point clouds, can specialize this to avoid the copy.
+ * \param data[inout] The data to be transformed.
+ * \param transform[in] The transform to apply to data.
+ */
+template<class T>
+void doTransform(T & data, const geometry_msgs::msg::TransformStamped & transform)
+{
+  const T data_in = data;
+  doTransform(data_in, data, transform);
+}
+
 /**\brief Get the timestamp from data
  * \param[in] t The data input.
  * \return The timestamp associated with the data.
@@ -159,6 +174,28 @@ void convert(const A & a1, A & a2)
   }
 }
 
+namespace impl
+{
+
+/** \brief Converts a tf2::Stamped<A> into a tf2::Stamped<B> when A converts directly into B.
+ *
+ * The stamp and frame_id are copied over and the data goes through DirectConverter<A, B>, so
+ * neither a stamped message nor its header is built on the way.
+ */
+template<typename A, typename B>
+struct DirectConverter<tf2::Stamped<A>, tf2::Stamped<B>,
+  typename std::enable_if<DirectConverter<A, B>::value>::type> : std::true_type
+{
+  static void convert(const tf2::Stamped<A> & a, tf2::Stamped<B> & b)
+  {
+    DirectConverter<A, B>::convert(a, b);
+    b.stamp_ = a.stamp_;
+    b.frame_id_ = a.frame_id_;
+  }
+};
+
+}  // namespace impl
+
 /**\brief Function that converts from a row-major representation of a 6x6
  * covariance matrix to a nested array representation.
  * \param row_major A row-major array of 36 covariance values.
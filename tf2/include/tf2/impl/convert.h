@@ -29,11 +29,38 @@
 #ifndef TF2__IMPL__CONVERT_H_
 #define TF2__IMPL__CONVERT_H_
 
+#include <type_traits>
+
 namespace tf2
 {
 namespace impl
 {
 
+/** \brief Converts an A straight into a B, without a ROS message in between.
+ *
+ * tf2::convert() converts two non message types through toMsg() and fromMsg(), which builds a
+ * message, and for stamped types a frame_id string, on every call. Specialize this for a pair
+ * of types with value true and a static convert(const A &, B &) and tf2::convert() calls that
+ * instead. Partial specializations with an enable_if on Enable work too, like the one in
+ * tf2/convert.h that forwards tf2::Stamped<A> to tf2::Stamped<B> to the conversion of A to B.
+ */
+template<typename A, typename B, typename Enable = void>
+struct DirectConverter : std::false_type
+{
+};
+
+template<typename A, typename B>
+inline void convertNonMessages(const A & a, B & b, std::true_type)
+{
+  DirectConverter<A, B>::convert(a, b);
+}
+
+template<typename A, typename B>
+inline void convertNonMessages(const A & a, B & b, std::false_type)
+{
+  fromMsg(toMsg(a), b);
+}
+
 template<bool IS_MESSAGE_A, bool IS_MESSAGE_B>
 class Converter
 {
@@ -71,7 +98,7 @@ template< >
 template<typename A, typename B>
 inline void Converter<false, false>::convert(const A & a, B & b)
 {
-  fromMsg(toMsg(a), b);
+  convertNonMessages(a, b, std::integral_constant<bool, DirectConverter<A, B>::value>());
 }
 
 }  // namespace impl
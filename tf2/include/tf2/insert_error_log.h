@@ -0,0 +1,154 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TF2__INSERT_ERROR_LOG_H_
+#define TF2__INSERT_ERROR_LOG_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "LinearMath/Transform.h"
+#include "tf2/time.h"
+#include "tf2/visibility_control.h"
+
+namespace tf2
+{
+
+/** \brief The reasons a BufferCore rejects a transform it is given */
+enum class InsertError : uint8_t
+{
+  /// TF_SELF_TRANSFORM, frame_id and child_frame_id are the same
+  SelfTransform = 0,
+  /// TF_NO_CHILD_FRAME_ID
+  NoChildFrameId = 1,
+  /// TF_NO_FRAME_ID
+  NoFrameId = 2,
+  /// TF_NAN_INPUT, the translation or rotation holds a nan
+  NanInput = 3,
+  /// TF_DENORMALIZED_QUATERNION
+  DenormalizedQuaternion = 4,
+  /// TF_OLD_DATA, the transform is older than the history of its frame
+  OldData = 5,
+};
+
+/** \brief The name an InsertError is logged with, such as "TF_OLD_DATA" */
+TF2_PUBLIC
+const char * insertErrorName(InsertError error);
+
+/** \brief How often transforms of one frame from one authority were rejected for one reason */
+struct InsertErrorCount
+{
+  std::string child_frame_id;
+  std::string authority;
+  InsertError error = InsertError::SelfTransform;
+  /// Rejected transforms since the log was created
+  uint64_t count = 0;
+};
+
+/** \brief Counts the transforms a BufferCore rejects and logs them from a thread of its own.
+ *
+ * Reporting a rejected transform only bumps a counter and, for the first one since the last
+ * log message, copies the transform, so a publisher sending bad or stale data at a high rate
+ * neither slows down inserts nor floods the log.  A summarizer thread, started on the first
+ * report, logs the first rejection of each frame, authority and reason right away and then at
+ * most one message per period saying how many more there were.  Whatever is left is logged on
+ * destruction.
+ */
+class InsertErrorLog
+{
+public:
+  /** \param period The shortest time between two log messages, zero logs every report
+   *   synchronously from report() like tf2 used to */
+  TF2_PUBLIC
+  explicit InsertErrorLog(tf2::Duration period = std::chrono::seconds(1));
+
+  TF2_PUBLIC
+  ~InsertErrorLog();
+
+  InsertErrorLog(const InsertErrorLog &) = delete;
+  InsertErrorLog & operator=(const InsertErrorLog &) = delete;
+
+  /** \brief Change the time between log messages, see the constructor */
+  TF2_PUBLIC
+  void setPeriod(tf2::Duration period);
+
+  /** \brief Count count rejected transforms of a frame
+   * \param transform The rejected transform, logged for nan inputs and denormalized quaternions
+   * \param stamp The stamp of the rejected transform, logged for old data
+   */
+  TF2_PUBLIC
+  void report(
+    InsertError error, const std::string & child_frame_id, const std::string & authority,
+    const tf2::Transform & transform, TimePoint stamp, uint64_t count = 1);
+
+  /** \brief Log the rejections not logged yet now, from the calling thread */
+  TF2_PUBLIC
+  void flush();
+
+  /** \brief The rejections counted so far, sorted by frame, authority and reason */
+  TF2_PUBLIC
+  std::vector<InsertErrorCount> getCounts() const;
+
+private:
+  struct Entry
+  {
+    InsertErrorCount total;
+    /// Rejections since the last log message
+    uint64_t pending = 0;
+    /// The first of those rejections
+    tf2::Transform transform;
+    TimePoint stamp;
+  };
+
+  /// Log the pending entries, expects lock to be held and releases it while logging
+  void flushLocked(std::unique_lock<std::mutex> & lock);
+  void run();
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  /// Keyed by the frame, authority and reason, see report()
+  std::unordered_map<std::string, Entry> entries_;
+  /// Reused to build keys so reports of known entries do not allocate
+  std::string key_;
+  /// The number of entries with pending rejections
+  size_t num_pending_ = 0;
+  tf2::Duration period_;
+  bool stopping_ = false;
+  std::thread summarizer_;
+};
+
+}  // namespace tf2
+
+#endif  // TF2__INSERT_ERROR_LOG_H_
@@ -0,0 +1,121 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TF2__LOOKUP_CACHE_H_
+#define TF2__LOOKUP_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "LinearMath/Transform.h"
+#include "tf2/time.h"
+#include "tf2/transform_storage.h"
+#include "tf2/visibility_control.h"
+
+namespace tf2
+{
+
+/** \brief Results of recent lookups, shared by everyone looking up through a BufferCore.
+ *
+ * Results are keyed by the frames and the time of the lookup and tagged with a version of the
+ * data they were computed from, so a result that no longer matches is never handed out.  The
+ * cache is set associative: a key can only live in one of a few slots, the least recently used
+ * one of which is replaced on a miss.  All the storage is allocated up front and a mutex guards
+ * it, so it is safe to use from any thread without allocating.
+ */
+class LookupCache
+{
+public:
+  /** \param capacity The number of results to keep, rounded up to a power of two */
+  TF2_PUBLIC
+  explicit LookupCache(size_t capacity);
+
+  LookupCache(const LookupCache &) = delete;
+  LookupCache & operator=(const LookupCache &) = delete;
+
+  /** \brief Get the result of a lookup computed from the data at version
+   * \return True on a hit, transform and time_out are only set then
+   */
+  TF2_PUBLIC
+  bool find(
+    CompactFrameID target_id, CompactFrameID source_id, TimePoint time, uint64_t topology_version,
+    uint64_t data_version, tf2::Transform & transform, TimePoint & time_out);
+
+  /** \brief Remember the result of a lookup computed from the data at version */
+  TF2_PUBLIC
+  void store(
+    CompactFrameID target_id, CompactFrameID source_id, TimePoint time, uint64_t topology_version,
+    uint64_t data_version, const tf2::Transform & transform, TimePoint time_out);
+
+  /** \brief The number of results the cache holds at most */
+  size_t capacity() const {return entries_.size();}
+
+  /** \brief The memory taken up by the results in bytes */
+  size_t getMemoryUsage() const {return entries_.capacity() * sizeof(Entry);}
+
+  /** \brief The number of find() calls that returned a result so far */
+  TF2_PUBLIC
+  uint64_t getHits() const;
+
+  /** \brief The number of find() calls that did not so far */
+  TF2_PUBLIC
+  uint64_t getMisses() const;
+
+private:
+  /// The slots a key can be stored in
+  static constexpr size_t WAYS = 4;
+
+  struct Entry
+  {
+    CompactFrameID target_id = 0;
+    CompactFrameID source_id = 0;
+    TimePoint time;
+    uint64_t topology_version = 0;
+    uint64_t data_version = 0;
+    /// When the entry was last used, 0 if it is empty
+    uint64_t last_used = 0;
+    tf2::Transform transform;
+    TimePoint time_out;
+  };
+
+  /// The first of the WAYS entries the key can be stored in
+  size_t setOf(CompactFrameID target_id, CompactFrameID source_id, TimePoint time) const;
+
+  mutable std::mutex mutex_;
+  std::vector<Entry> entries_;
+  size_t set_mask_;
+  uint64_t clock_;
+  uint64_t hits_;
+  uint64_t misses_;
+};
+
+}  // namespace tf2
+
+#endif  // TF2__LOOKUP_CACHE_H_
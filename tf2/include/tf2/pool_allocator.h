@@ -0,0 +1,154 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TF2__POOL_ALLOCATOR_H_
+#define TF2__POOL_ALLOCATOR_H_
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include "tf2/visibility_control.h"
+
+namespace tf2
+{
+
+/** \brief Hands out blocks of one size from chunks it keeps until it is destroyed.
+ *
+ * Meant for the nodes of a node based container, so erasing and inserting elements reuses the
+ * memory of the erased ones instead of going to the heap.  The block size is that of the first
+ * allocation, larger ones are passed on to operator new.  allocate() and deallocate() follow
+ * std::pmr::memory_resource, but it is not thread safe, whoever guards the container guards
+ * its pool too.
+ */
+class PoolResource
+{
+public:
+  TF2_PUBLIC
+  PoolResource();
+
+  TF2_PUBLIC
+  ~PoolResource();
+
+  PoolResource(const PoolResource &) = delete;
+  PoolResource & operator=(const PoolResource &) = delete;
+
+  TF2_PUBLIC
+  void * allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+  TF2_PUBLIC
+  void deallocate(void * ptr, size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+  /** \brief Make room for at least this many blocks in total.
+   *
+   * Before the first allocation the block size is unknown, the room is then made by it.
+   */
+  TF2_PUBLIC
+  void reserve(size_t blocks);
+
+  /** \brief The number of free blocks, ready to be handed out without touching the heap */
+  TF2_PUBLIC
+  size_t getNumFreeBlocks() const;
+
+  /** \brief The memory taken from the heap for blocks in bytes, used or free */
+  TF2_PUBLIC
+  size_t getMemoryUsage() const;
+
+private:
+  struct FreeBlock
+  {
+    FreeBlock * next;
+  };
+
+  /// Whether a request is served from the pool, setting the block size on the first one
+  bool fits(size_t bytes, size_t alignment);
+  void addChunk(size_t blocks);
+
+  size_t block_size_;
+  size_t num_blocks_;
+  size_t reserved_blocks_;
+  size_t num_free_;
+  FreeBlock * free_;
+  std::vector<void *> chunks_;
+};
+
+/** \brief A std::allocator replacement allocating single elements from a PoolResource.
+ *
+ * Arrays, such as the buckets of an unordered map, come from operator new.
+ */
+template<class T>
+class PoolAllocator
+{
+public:
+  using value_type = T;
+
+  explicit PoolAllocator(PoolResource * resource) noexcept
+  : resource_(resource) {}
+
+  template<class U>
+  PoolAllocator(const PoolAllocator<U> & other) noexcept  // NOLINT(runtime/explicit)
+  : resource_(other.resource()) {}
+
+  T * allocate(size_t n)
+  {
+    if (n == 1) {
+      return static_cast<T *>(resource_->allocate(sizeof(T), alignof(T)));
+    }
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T * ptr, size_t n) noexcept
+  {
+    if (n == 1) {
+      resource_->deallocate(ptr, sizeof(T), alignof(T));
+    } else {
+      ::operator delete(ptr);
+    }
+  }
+
+  PoolResource * resource() const noexcept {return resource_;}
+
+private:
+  PoolResource * resource_;
+};
+
+template<class T, class U>
+bool operator==(const PoolAllocator<T> & a, const PoolAllocator<U> & b) noexcept
+{
+  return a.resource() == b.resource();
+}
+
+template<class T, class U>
+bool operator!=(const PoolAllocator<T> & a, const PoolAllocator<U> & b) noexcept
+{
+  return !(a == b);
+}
+
+}  // namespace tf2
+
+#endif  // TF2__POOL_ALLOCATOR_H_
@@ -0,0 +1,164 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TF2__REPLICATED_BUFFER_H_
+#define TF2__REPLICATED_BUFFER_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "geometry_msgs/msg/transform_stamped.hpp"
+#include "tf2/buffer_core.h"
+#include "tf2/buffer_core_interface.h"
+#include "tf2/time.h"
+#include "tf2/visibility_control.h"
+
+namespace tf2
+{
+
+/** \brief Keeps one BufferCore per NUMA node, so lookups never touch memory of another socket.
+ *
+ * Transforms set on it are queued to a worker thread per replica, which runs on the CPUs of
+ * its node and inserts them, so the replica's memory is allocated there.  Lookups go to the
+ * replica of the node the calling thread runs on.  Replicas apply the same transforms in the
+ * same order, but each at its own pace, call waitForInserts() to make sure a lookup sees
+ * everything set before.
+ *
+ * Nodes and their CPUs are read from /sys/devices/system/node on Linux.  Elsewhere, or if
+ * that is unavailable, there is a single node and workers are not pinned.
+ */
+class ReplicatedBuffer : public BufferCoreInterface
+{
+public:
+  /** \brief Create the replicas and start their workers
+   * \param cache_time How long each replica keeps a history of transforms
+   * \param num_replicas The number of replicas, 0 for one per NUMA node.  Nodes are spread
+   *   over the replicas if there are fewer of them.
+   */
+  TF2_PUBLIC
+  explicit ReplicatedBuffer(
+    tf2::Duration cache_time = BUFFER_CORE_DEFAULT_CACHE_TIME, size_t num_replicas = 0);
+
+  /** \brief Stop the workers, after they applied everything queued */
+  TF2_PUBLIC
+  ~ReplicatedBuffer() override;
+
+  ReplicatedBuffer(const ReplicatedBuffer &) = delete;
+  ReplicatedBuffer & operator=(const ReplicatedBuffer &) = delete;
+
+  /** \brief Queue a transform for every replica, see BufferCore::setTransform()
+   * \return true, the replicas validate the transform on insert and log why they reject it
+   *   like BufferCore does
+   */
+  TF2_PUBLIC
+  bool setTransform(
+    const geometry_msgs::msg::TransformStamped & transform,
+    const std::string & authority, bool is_static = false);
+
+  /** \brief Queue several transforms for every replica at once, see BufferCore::setTransforms()
+   * \return true, see setTransform()
+   */
+  TF2_PUBLIC
+  bool setTransforms(
+    const std::vector<geometry_msgs::msg::TransformStamped> & transforms,
+    const std::string & authority, bool is_static = false);
+
+  /** \brief Block until every replica applied everything queued before the call */
+  TF2_PUBLIC
+  void waitForInserts() const;
+
+  /** \brief Queue clearing every replica, after what is queued before it */
+  TF2_PUBLIC
+  void clear() override;
+
+  TF2_PUBLIC
+  geometry_msgs::msg::TransformStamped
+  lookupTransform(
+    const std::string & target_frame, const std::string & source_frame,
+    const TimePoint & time) const override;
+
+  TF2_PUBLIC
+  geometry_msgs::msg::TransformStamped
+  lookupTransform(
+    const std::string & target_frame, const TimePoint & target_time,
+    const std::string & source_frame, const TimePoint & source_time,
+    const std::string & fixed_frame) const override;
+
+  TF2_PUBLIC
+  bool
+  canTransform(
+    const std::string & target_frame, const std::string & source_frame,
+    const TimePoint & time, std::string * error_msg = NULL) const override;
+
+  TF2_PUBLIC
+  bool
+  canTransform(
+    const std::string & target_frame, const TimePoint & target_time,
+    const std::string & source_frame, const TimePoint & source_time,
+    const std::string & fixed_frame, std::string * error_msg = NULL) const override;
+
+  TF2_PUBLIC
+  std::vector<std::string> getAllFrameNames() const override;
+
+  /** \brief The number of replicas */
+  TF2_PUBLIC
+  size_t getNumReplicas() const;
+
+  /** \brief The replica lookups from the calling thread go to */
+  TF2_PUBLIC
+  size_t getLocalReplicaIndex() const;
+
+  /** \brief Access a replica, for the parts of the BufferCore API this class does not forward.
+   * It must not be modified directly, or it stops matching the others.
+   */
+  TF2_PUBLIC
+  const BufferCore & getReplica(size_t index) const;
+
+  /** \brief The number of NUMA nodes of the host, 1 if it can not be determined */
+  TF2_PUBLIC
+  static size_t getNumNumaNodes();
+
+private:
+  /// A replica with its worker thread and queue, defined in replicated_buffer.cpp
+  struct Replica;
+  /// One of the updates queued for the replicas
+  struct Update;
+
+  const BufferCore & localReplica() const;
+  void enqueue(const std::shared_ptr<const Update> & update);
+
+  std::vector<std::unique_ptr<Replica>> replicas_;
+  /// The replica of each CPU, empty if the CPUs of the nodes are unknown
+  std::vector<size_t> cpu_replicas_;
+};
+
+}  // namespace tf2
+
+#endif  // TF2__REPLICATED_BUFFER_H_
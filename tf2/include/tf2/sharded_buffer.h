@@ -0,0 +1,180 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TF2__SHARDED_BUFFER_H_
+#define TF2__SHARDED_BUFFER_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "LinearMath/Transform.h"
+#include "geometry_msgs/msg/transform_stamped.hpp"
+#include "tf2/buffer_core.h"
+#include "tf2/buffer_core_interface.h"
+#include "tf2/time.h"
+#include "tf2/visibility_control.h"
+
+namespace tf2
+{
+
+/** \brief Splits the frames of many disjoint trees, such as the robots of a fleet, over
+ *   several BufferCores so that they do not share a lock.
+ *
+ * A frame belongs to the shard of its namespace, the part of its name before the first '/'
+ * (a leading slash is ignored), so robot_1/base_link and robot_1/odom end up in the same shard.
+ * Frames without a namespace, such as map, have a shard of their own.  Namespaces are spread
+ * over the other shards by a hash of their name, robots that share a shard only contend with
+ * each other.  A transform is inserted into the shard of its child frame, its parent is known
+ * there as a frame without history.
+ *
+ * Lookups between two frames of one shard go straight to it.  Other lookups are stitched
+ * together at the frames where a shard's tree hangs off a frame of another shard: each frame
+ * is walked up its latest parents to the top of its tree in its shard, and on from there in the
+ * shard of that top, until the two walks meet.  The pieces are then looked up at the requested
+ * time, each in its own shard and under its own lock, so lookups across shards at time 0 may
+ * combine pieces with different latest stamps, the oldest of which is returned.
+ */
+class ShardedBuffer : public BufferCoreInterface
+{
+public:
+  /** \brief Create the shards
+   * \param cache_time How long each shard keeps a history of transforms
+   * \param num_shards The number of shards including the one of the frames without a
+   *   namespace, at least 2 to separate namespaces from it
+   */
+  TF2_PUBLIC
+  explicit ShardedBuffer(
+    tf2::Duration cache_time = BUFFER_CORE_DEFAULT_CACHE_TIME, size_t num_shards = 16);
+
+  ShardedBuffer(const ShardedBuffer &) = delete;
+  ShardedBuffer & operator=(const ShardedBuffer &) = delete;
+
+  /** \brief Add a transform to the shard of its child frame, see BufferCore::setTransform() */
+  TF2_PUBLIC
+  bool setTransform(
+    const geometry_msgs::msg::TransformStamped & transform,
+    const std::string & authority, bool is_static = false);
+
+  /** \brief Add several transforms, see BufferCore::setTransforms()
+   * \return True if all of them were inserted
+   */
+  TF2_PUBLIC
+  bool setTransforms(
+    const std::vector<geometry_msgs::msg::TransformStamped> & transforms,
+    const std::string & authority, bool is_static = false);
+
+  /** \brief Clear every shard */
+  TF2_PUBLIC
+  void clear() override;
+
+  TF2_PUBLIC
+  geometry_msgs::msg::TransformStamped
+  lookupTransform(
+    const std::string & target_frame, const std::string & source_frame,
+    const TimePoint & time) const override;
+
+  /** \brief Get the transform between two frames without building a message, see
+   *   BufferCore::lookupTransform()
+   */
+  TF2_PUBLIC
+  void lookupTransform(
+    const std::string & target_frame, const std::string & source_frame,
+    const TimePoint & time, tf2::Transform & transform, TimePoint & time_out) const;
+
+  /** \brief Look up through a fixed frame, which may be in any shard */
+  TF2_PUBLIC
+  geometry_msgs::msg::TransformStamped
+  lookupTransform(
+    const std::string & target_frame, const TimePoint & target_time,
+    const std::string & source_frame, const TimePoint & source_time,
+    const std::string & fixed_frame) const override;
+
+  TF2_PUBLIC
+  bool
+  canTransform(
+    const std::string & target_frame, const std::string & source_frame,
+    const TimePoint & time, std::string * error_msg = NULL) const override;
+
+  TF2_PUBLIC
+  bool
+  canTransform(
+    const std::string & target_frame, const TimePoint & target_time,
+    const std::string & source_frame, const TimePoint & source_time,
+    const std::string & fixed_frame, std::string * error_msg = NULL) const override;
+
+  /** \brief The frames of all shards, each once */
+  TF2_PUBLIC
+  std::vector<std::string> getAllFrameNames() const override;
+
+  /** \brief The number of shards */
+  TF2_PUBLIC
+  size_t getNumShards() const;
+
+  /** \brief The shard a frame belongs to, 0 for frames without a namespace */
+  TF2_PUBLIC
+  size_t getShardIndex(const std::string & frame_id) const;
+
+  /** \brief Access a shard, for the parts of the BufferCore API this class does not forward.
+   *
+   * Transformable requests between frames of one shard can be added to it, they are then only
+   * tested against inserts into that shard.  Transforms set on it directly must belong to it.
+   */
+  TF2_PUBLIC
+  BufferCore & getShard(size_t index);
+
+  TF2_PUBLIC
+  const BufferCore & getShard(size_t index) const;
+
+private:
+  /// Bounds the hops between shards of a lookup, in case the trees of shards form a loop
+  static const size_t MAX_SHARD_HOPS = 64;
+
+  /** \brief Look up between frames whose trees meet in another shard than their own.
+   * \return False if the trees do not meet
+   */
+  bool lookupAcrossShards(
+    const std::string & target_frame, const std::string & source_frame, const TimePoint & time,
+    tf2::Transform & transform, TimePoint & time_out) const;
+
+  /// Throw the exception BufferCore throws for a frame id that is empty or known to no shard
+  void checkFrameExists(const char * function_name_arg, const std::string & frame_id) const;
+
+  /// The frame followed by the top of its tree in its shard, the top of that in its shard...
+  std::vector<std::string> shardTops(const std::string & frame_id) const;
+
+  /// The top of the tree of frame_id within a shard, frame_id itself if it has no parent
+  std::string topFrame(size_t shard, const std::string & frame_id) const;
+
+  std::vector<std::unique_ptr<BufferCore>> shards_;
+};
+
+}  // namespace tf2
+
+#endif  // TF2__SHARDED_BUFFER_H_
@@ -0,0 +1,206 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TF2__SHARED_BUFFER_H_
+#define TF2__SHARED_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "geometry_msgs/msg/transform_stamped.hpp"
+#include "tf2/LinearMath/Transform.h"
+#include "tf2/buffer_core_interface.h"
+#include "tf2/time.h"
+#include "tf2/time_cache.h"
+#include "tf2/visibility_control.h"
+
+namespace tf2
+{
+
+/** \brief Sizes of a shared buffer segment, fixed when a SharedBufferWriter creates it */
+struct SharedBufferOptions
+{
+  /// Frames that can be registered, including parents that have no data of their own
+  size_t max_frames = 1024;
+  /// Samples kept per dynamic frame, the oldest ones are overwritten
+  size_t samples_per_frame = 1024;
+};
+
+/// The memory mapping of a shared buffer segment, defined in shared_buffer.cpp
+class SharedSegment;
+
+/** \brief Keeps transforms in a shared memory segment that SharedBufferReader instances in other
+ * processes on the same host look up from.
+ *
+ * Each frame has a fixed size ring of samples guarded by a sequence lock, so readers never
+ * block the writer and never take a lock the writer holds.  There must be only one writer per
+ * segment, which removes it when it is destroyed.  Dynamic samples must be set in order, older
+ * ones are rejected.  Only available on POSIX systems.
+ */
+class SharedBufferWriter
+{
+public:
+  /** \brief Create the segment, replacing a stale one of the same name.
+   * \param name The name of the segment, without slashes
+   * \throws std::runtime_error if the segment can not be created
+   */
+  TF2_PUBLIC
+  explicit SharedBufferWriter(
+    const std::string & name, const SharedBufferOptions & options = SharedBufferOptions());
+
+  TF2_PUBLIC
+  ~SharedBufferWriter();
+
+  /** \brief Add transform information to the shared buffer.
+   * \param transform The transform to store
+   * \param authority The source of the information for this transform
+   * \param is_static Record this transform as a static transform
+   * \return True unless an error occured
+   */
+  TF2_PUBLIC
+  bool setTransform(
+    const geometry_msgs::msg::TransformStamped & transform,
+    const std::string & authority, bool is_static = false);
+
+  /** \brief Drop the samples of all frames, the frames stay registered. */
+  TF2_PUBLIC
+  void clear();
+
+private:
+  uint32_t registerFrame(const std::string & frame_id);
+
+  std::unique_ptr<SharedSegment> segment_;
+  /// Serializes setTransform() and clear(), readers never take it
+  std::mutex mutex_;
+  std::unordered_map<std::string, uint32_t> frame_ids_;
+};
+
+/** \brief Looks up transforms from a segment written by a SharedBufferWriter.
+ *
+ * Lookups read the samples straight from the shared memory, so a process keeps no copy of the
+ * transforms and does not need to subscribe to them.  They behave like the ones of BufferCore.
+ */
+class SharedBufferReader : public BufferCoreInterface
+{
+public:
+  /** \brief Map an existing segment read only.
+   * \param name The name the SharedBufferWriter was created with
+   * \param policy How lookups interpolate and extrapolate, only nlerp_max_angle and
+   *   max_extrapolation apply since the writer decides which samples are kept
+   * \throws std::runtime_error if there is no such segment
+   */
+  TF2_PUBLIC
+  explicit SharedBufferReader(
+    const std::string & name, const RetentionPolicy & policy = RetentionPolicy());
+
+  TF2_PUBLIC
+  ~SharedBufferReader() override;
+
+  /** \brief Does nothing, only the writer can clear the shared buffer. */
+  TF2_PUBLIC
+  void clear() override;
+
+  TF2_PUBLIC
+  geometry_msgs::msg::TransformStamped
+  lookupTransform(
+    const std::string & target_frame, const std::string & source_frame,
+    const TimePoint & time) const override;
+
+  TF2_PUBLIC
+  geometry_msgs::msg::TransformStamped
+  lookupTransform(
+    const std::string & target_frame, const TimePoint & target_time,
+    const std::string & source_frame, const TimePoint & source_time,
+    const std::string & fixed_frame) const override;
+
+  TF2_PUBLIC
+  bool
+  canTransform(
+    const std::string & target_frame, const std::string & source_frame,
+    const TimePoint & time, std::string * error_msg = NULL) const override;
+
+  TF2_PUBLIC
+  bool
+  canTransform(
+    const std::string & target_frame, const TimePoint & target_time,
+    const std::string & source_frame, const TimePoint & source_time,
+    const std::string & fixed_frame, std::string * error_msg = NULL) const override;
+
+  TF2_PUBLIC
+  std::vector<std::string> getAllFrameNames() const override;
+
+private:
+  /// A frame on the way from a frame to the root, with the transform from the start of the way
+  struct Step
+  {
+    uint32_t frame;
+    tf2::Transform transform;
+    /// The stamp of the latest sample of frame, zero if it is static or has no data
+    TimePoint latest;
+  };
+
+  /// Throws the same exceptions as BufferCore for invalid or unknown frames
+  uint32_t resolveFrame(const char * function_name_arg, const std::string & frame_id) const;
+
+  /// Pick up the frames registered since the last call, frame_ids_mutex_ must be held
+  void refreshFramesNoLock() const;
+
+  /// The name of a frame, empty if it is not registered
+  std::string frameName(uint32_t frame) const;
+
+  /** \brief Walk from start towards the root, stopping early at a frame in meet.
+   * \return false if a frame could not be evaluated at time, steps then ends at that frame and
+   *   extrapolation_error says why */
+  bool walkToTopParent(
+    uint32_t start, TimePoint time, const std::vector<Step> & meet, std::vector<Step> & steps,
+    std::string & extrapolation_error) const;
+
+  void lookupTransformImpl(
+    uint32_t target, uint32_t source, TimePoint time,
+    tf2::Transform & transform, TimePoint & time_out) const;
+
+  std::unique_ptr<SharedSegment> segment_;
+  /// Rotations with an absolute dot product of at least this are interpolated with nlerp
+  tf2Scalar nlerp_min_dot_;
+  /// How far past the newest sample of a frame lookups are extrapolated
+  tf2::Duration max_extrapolation_;
+
+  /// The frame names seen so far, refreshed when an unknown name is looked up
+  mutable std::mutex frame_ids_mutex_;
+  mutable std::unordered_map<std::string, uint32_t> frame_ids_;
+  mutable std::vector<std::string> frame_names_;
+};
+
+}  // namespace tf2
+
+#endif  // TF2__SHARED_BUFFER_H_
@@ -0,0 +1,356 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TF2__STATIC_CHAIN_H_
+#define TF2__STATIC_CHAIN_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "tf2/buffer_core.h"
+#include "tf2/LinearMath/Transform.h"
+
+/** \brief Define a fixed offset for a tf2::StaticLink
+ *
+ * The offset from a parent frame to its child as a translation and a quaternion, kept as
+ * compile-time constants, for example TF2_STATIC_OFFSET(ToolFlange, 0, 0, 0.08, 0, 0, 0, 1).
+ * A generator can turn the fixed joints of a URDF into one of these per joint.
+ */
+#define TF2_STATIC_OFFSET(name, tx, ty, tz, rx, ry, rz, rw) \
+  struct name \
+  { \
+    static constexpr double x = tx; \
+    static constexpr double y = ty; \
+    static constexpr double z = tz; \
+    static constexpr double qx = rx; \
+    static constexpr double qy = ry; \
+    static constexpr double qz = rz; \
+    static constexpr double qw = rw; \
+  }
+
+namespace tf2
+{
+
+/** \brief A link of a StaticChain whose transform is the compile-time constant Offset
+ *
+ * Offset is a type with static constexpr x, y, z, qx, qy, qz and qw members, as defined by
+ * TF2_STATIC_OFFSET().  The quaternion does not need to be normalized.
+ */
+template<typename Offset>
+struct StaticLink
+{
+};
+
+/** \brief A link of a StaticChain whose transform is read from the BufferCore at lookup time */
+struct DynamicLink
+{
+};
+
+namespace impl
+{
+
+/** \brief An entry of the rotation matrix of the quaternion of Offset */
+template<typename Offset>
+constexpr double staticRotation(int row, int col)
+{
+  const double s = 2.0 / (Offset::qx * Offset::qx + Offset::qy * Offset::qy +
+    Offset::qz * Offset::qz + Offset::qw * Offset::qw);
+  const double xx = Offset::qx * Offset::qx * s;
+  const double yy = Offset::qy * Offset::qy * s;
+  const double zz = Offset::qz * Offset::qz * s;
+  const double xy = Offset::qx * Offset::qy * s;
+  const double xz = Offset::qx * Offset::qz * s;
+  const double yz = Offset::qy * Offset::qz * s;
+  const double wx = Offset::qw * Offset::qx * s;
+  const double wy = Offset::qw * Offset::qy * s;
+  const double wz = Offset::qw * Offset::qz * s;
+  switch (row * 3 + col) {
+    case 0: return 1.0 - (yy + zz);
+    case 1: return xy - wz;
+    case 2: return xz + wy;
+    case 3: return xy + wz;
+    case 4: return 1.0 - (xx + zz);
+    case 5: return yz - wx;
+    case 6: return xz - wy;
+    case 7: return yz + wx;
+    default: return 1.0 - (xx + yy);
+  }
+}
+
+/** \brief The offset of A followed by the offset of B, folded at compile time */
+template<typename A, typename B>
+struct ComposedOffset
+{
+  static constexpr double x = A::x + staticRotation<A>(0, 0) * B::x +
+    staticRotation<A>(0, 1) * B::y + staticRotation<A>(0, 2) * B::z;
+  static constexpr double y = A::y + staticRotation<A>(1, 0) * B::x +
+    staticRotation<A>(1, 1) * B::y + staticRotation<A>(1, 2) * B::z;
+  static constexpr double z = A::z + staticRotation<A>(2, 0) * B::x +
+    staticRotation<A>(2, 1) * B::y + staticRotation<A>(2, 2) * B::z;
+  static constexpr double qx = A::qw * B::qx + A::qx * B::qw + A::qy * B::qz - A::qz * B::qy;
+  static constexpr double qy = A::qw * B::qy - A::qx * B::qz + A::qy * B::qw + A::qz * B::qx;
+  static constexpr double qz = A::qw * B::qz + A::qx * B::qy - A::qy * B::qx + A::qz * B::qw;
+  static constexpr double qw = A::qw * B::qw - A::qx * B::qx - A::qy * B::qy - A::qz * B::qz;
+};
+
+/** \brief Set t to the constant transform of Offset */
+template<typename Offset>
+inline void setStatic(tf2::Transform & t)
+{
+  constexpr double r00 = staticRotation<Offset>(0, 0);
+  constexpr double r01 = staticRotation<Offset>(0, 1);
+  constexpr double r02 = staticRotation<Offset>(0, 2);
+  constexpr double r10 = staticRotation<Offset>(1, 0);
+  constexpr double r11 = staticRotation<Offset>(1, 1);
+  constexpr double r12 = staticRotation<Offset>(1, 2);
+  constexpr double r20 = staticRotation<Offset>(2, 0);
+  constexpr double r21 = staticRotation<Offset>(2, 1);
+  constexpr double r22 = staticRotation<Offset>(2, 2);
+  constexpr double x = Offset::x;
+  constexpr double y = Offset::y;
+  constexpr double z = Offset::z;
+  t.getBasis().setValue(r00, r01, r02, r10, r11, r12, r20, r21, r22);
+  t.getOrigin().setValue(x, y, z);
+}
+
+/** \brief Multiply t by the constant transform of Offset on the right
+ *
+ * Written out entry by entry with the rotation as constexpr values, so the compiler drops the
+ * terms the zeros and ones of the offset make trivial.
+ */
+template<typename Offset>
+inline void applyStatic(tf2::Transform & t)
+{
+  constexpr double r00 = staticRotation<Offset>(0, 0);
+  constexpr double r01 = staticRotation<Offset>(0, 1);
+  constexpr double r02 = staticRotation<Offset>(0, 2);
+  constexpr double r10 = staticRotation<Offset>(1, 0);
+  constexpr double r11 = staticRotation<Offset>(1, 1);
+  constexpr double r12 = staticRotation<Offset>(1, 2);
+  constexpr double r20 = staticRotation<Offset>(2, 0);
+  constexpr double r21 = staticRotation<Offset>(2, 1);
+  constexpr double r22 = staticRotation<Offset>(2, 2);
+  tf2::Matrix3x3 & b = t.getBasis();
+  tf2::Vector3 & o = t.getOrigin();
+  o.setValue(
+    o.x() + b[0][0] * Offset::x + b[0][1] * Offset::y + b[0][2] * Offset::z,
+    o.y() + b[1][0] * Offset::x + b[1][1] * Offset::y + b[1][2] * Offset::z,
+    o.z() + b[2][0] * Offset::x + b[2][1] * Offset::y + b[2][2] * Offset::z);
+  for (int i = 0; i < 3; ++i) {
+    const tf2Scalar b0 = b[i][0];
+    const tf2Scalar b1 = b[i][1];
+    const tf2Scalar b2 = b[i][2];
+    b[i].setValue(
+      b0 * r00 + b1 * r10 + b2 * r20, b0 * r01 + b1 * r11 + b2 * r21,
+      b0 * r02 + b1 * r12 + b2 * r22);
+  }
+}
+
+/** \brief Composes the links of a chain, with runs of static links folded into one */
+template<typename ... Links>
+struct ChainComposer;
+
+template<>
+struct ChainComposer<>
+{
+  static void first(tf2::Transform & t, const tf2::Transform *) {t.setIdentity();}
+  static void apply(tf2::Transform &, const tf2::Transform *) {}
+};
+
+template<typename Offset, typename ... Rest>
+struct ChainComposer<StaticLink<Offset>, Rest...>
+{
+  static void first(tf2::Transform & t, const tf2::Transform * dynamic)
+  {
+    setStatic<Offset>(t);
+    ChainComposer<Rest...>::apply(t, dynamic);
+  }
+  static void apply(tf2::Transform & t, const tf2::Transform * dynamic)
+  {
+    applyStatic<Offset>(t);
+    ChainComposer<Rest...>::apply(t, dynamic);
+  }
+};
+
+template<typename A, typename B, typename ... Rest>
+struct ChainComposer<StaticLink<A>, StaticLink<B>, Rest...>
+  : ChainComposer<StaticLink<ComposedOffset<A, B>>, Rest...>
+{
+};
+
+template<typename ... Rest>
+struct ChainComposer<DynamicLink, Rest...>
+{
+  static void first(tf2::Transform & t, const tf2::Transform * dynamic)
+  {
+    t = *dynamic;
+    ChainComposer<Rest...>::apply(t, dynamic + 1);
+  }
+  static void apply(tf2::Transform & t, const tf2::Transform * dynamic)
+  {
+    t *= *dynamic;
+    ChainComposer<Rest...>::apply(t, dynamic + 1);
+  }
+};
+
+template<typename ... Links>
+struct CountDynamicLinks;
+
+template<>
+struct CountDynamicLinks<>: std::integral_constant<size_t, 0>
+{
+};
+
+template<typename Link, typename ... Rest>
+struct CountDynamicLinks<Link, Rest...>
+  : std::integral_constant<size_t,
+    std::is_same<Link, DynamicLink>::value + CountDynamicLinks<Rest...>::value>
+{
+};
+
+}  // namespace impl
+
+/** \brief A kinematic chain whose topology and fixed offsets are known at compile time
+ *
+ * Links lists the links from the root frame, such as base_link, to the tip, such as tool0.
+ * StaticLink<Offset> links are constants: runs of them are folded into a single offset at
+ * compile time and applied with the constant entries written into the code.  Only the
+ * DynamicLink ones, the moving joints, are read from a BufferCore, each through its own
+ * FrameChain, and the composition is unrolled and inlined.
+ *
+ * \code
+ *   TF2_STATIC_OFFSET(ShoulderMount, 0, 0, 0.3, 0, 0, 0, 1);
+ *   TF2_STATIC_OFFSET(ToolFlange, 0, 0, 0.08, 0, 0, 0, 1);
+ *   using ArmChain = tf2::StaticChain<
+ *     tf2::StaticLink<ShoulderMount>, tf2::DynamicLink, tf2::StaticLink<ToolFlange>>;
+ *   ArmChain chain(buffer, {{{"shoulder_mount", "upper_arm"}}});
+ * \endcode
+ */
+template<typename ... Links>
+class StaticChain
+{
+public:
+  /// The number of DynamicLinks in the chain
+  static constexpr size_t num_dynamic = impl::CountDynamicLinks<Links...>::value;
+
+  /** \brief Compose the chain from the transforms of its dynamic links
+   * \param dynamic The transform of each DynamicLink, from its parent to its child frame, in
+   *   the order of the links
+   * \param[out] transform The transform from the tip to the root of the chain
+   */
+  static void compose(
+    const std::array<tf2::Transform, num_dynamic> & dynamic, tf2::Transform & transform)
+  {
+    impl::ChainComposer<Links...>::first(transform, dynamic.data());
+  }
+
+  /** \brief Bind the dynamic links to frames of buffer
+   * \param buffer The buffer to read the dynamic links from, which must outlive the chain
+   * \param dynamic_frames The parent and child frame of each DynamicLink, in the order of the
+   *   links
+   *
+   * Possible exceptions tf2::LookupException, tf2::InvalidArgumentException
+   */
+  StaticChain(
+    const BufferCore & buffer,
+    const std::array<std::pair<std::string, std::string>, num_dynamic> & dynamic_frames)
+  : buffer_(buffer)
+  {
+    for (size_t i = 0; i < num_dynamic; ++i) {
+      chains_[i] = buffer.getFrameChain(dynamic_frames[i].first, dynamic_frames[i].second);
+    }
+  }
+
+  /** \brief Get the transform from the tip to the root of the chain
+   *
+   * With TimePointZero every dynamic link is read at its own latest time.
+   * \param time The time at which to read the dynamic links. (0 will get the latest)
+   * \param[out] transform The transform from the tip to the root of the chain
+   * \param[out] time_out The oldest time stamp of the dynamic links, or TimePointZero if there
+   *   are none
+   *
+   * Possible exceptions tf2::LookupException, tf2::ConnectivityException,
+   * tf2::ExtrapolationException
+   */
+  void lookupTransform(
+    const TimePoint & time, tf2::Transform & transform, TimePoint & time_out) const
+  {
+    std::array<tf2::Transform, num_dynamic> dynamic;
+    time_out = TimePoint::max();
+    for (size_t i = 0; i < num_dynamic; ++i) {
+      TimePoint stamp;
+      buffer_.lookupTransform(chains_[i], time, dynamic[i], stamp);
+      time_out = std::min(time_out, stamp);
+    }
+    if (num_dynamic == 0) {
+      time_out = TimePointZero;
+    }
+    compose(dynamic, transform);
+  }
+
+  /** \brief Get the transform from the tip to the root of the chain from a real-time thread
+   *
+   * Reads the dynamic links with BufferCore::lookupTransformRealtime(), so this never
+   * allocates, throws or waits for the lock of the buffer.
+   * \sa lookupTransform()
+   * \return tf2::TF2Error::NO_ERROR on success, otherwise the first error of the dynamic links
+   */
+  tf2::TF2Error lookupTransformRealtime(
+    const TimePoint & time, tf2::Transform & transform, TimePoint & time_out) const noexcept
+  {
+    std::array<tf2::Transform, num_dynamic> dynamic;
+    TimePoint oldest = num_dynamic == 0 ? TimePointZero : TimePoint::max();
+    for (size_t i = 0; i < num_dynamic; ++i) {
+      TimePoint stamp;
+      const tf2::TF2Error error =
+        buffer_.lookupTransformRealtime(chains_[i], time, dynamic[i], stamp);
+      if (error != tf2::TF2Error::NO_ERROR) {
+        return error;
+      }
+      oldest = std::min(oldest, stamp);
+    }
+    compose(dynamic, transform);
+    time_out = oldest;
+    return tf2::TF2Error::NO_ERROR;
+  }
+
+private:
+  const BufferCore & buffer_;
+  std::array<FrameChainHandle, num_dynamic> chains_;
+};
+
+template<typename ... Links>
+constexpr size_t StaticChain<Links...>::num_dynamic;
+
+}  // namespace tf2
+
+#endif  // TF2__STATIC_CHAIN_H_
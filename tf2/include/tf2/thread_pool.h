@@ -0,0 +1,108 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef TF2__THREAD_POOL_H_
+#define TF2__THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "tf2/visibility_control.h"
+
+namespace tf2
+{
+
+/** \brief A fixed set of worker threads that batch conversions split their work across.
+ *
+ * Conversions such as the PointCloud2 doTransform() in tf2_sensor_msgs take one by reference,
+ * so a process can share a single pool between all of them instead of starting threads per
+ * call.  parallelFor() can be called from several threads at once and from inside a range
+ * being processed by the pool.
+ */
+class ThreadPool
+{
+public:
+  /** \brief Start the workers
+   * \param num_threads The number of worker threads. The thread calling parallelFor() works as
+   *   well, so 0 makes parallelFor() run everything on the calling thread.
+   */
+  TF2_PUBLIC
+  explicit ThreadPool(size_t num_threads = defaultNumThreads());
+
+  /** \brief Stop the workers, after they finish the ranges already handed to them */
+  TF2_PUBLIC
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  /** \brief Call fn on contiguous ranges covering [0, count), across the workers and the
+   * calling thread, and wait for all of them.
+   *
+   * The ranges only depend on count, min_range and the number of threads, never on timing,
+   * so functions that write their own range of the output produce the same result on every
+   * call.
+   * \param count The size of the index range to cover
+   * \param min_range The smallest range worth a thread of its own
+   * \param fn Called as fn(begin, end) for each range
+   * \throws The first exception thrown by fn, once every range is done
+   */
+  TF2_PUBLIC
+  void parallelFor(
+    size_t count, size_t min_range, const std::function<void(size_t, size_t)> & fn);
+
+  /** \brief The number of worker threads, not counting the callers of parallelFor() */
+  TF2_PUBLIC
+  size_t getNumThreads() const;
+
+  /** \brief One less than the number of hardware threads, leaving one for the caller */
+  TF2_PUBLIC
+  static size_t defaultNumThreads();
+
+private:
+  void work();
+  /// Run one queued task if there is any, expects lock to be held and releases it while running
+  bool runOne(std::unique_lock<std::mutex> & lock);
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable task_available_;
+  std::condition_variable task_done_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_ = false;
+};
+
+}  // namespace tf2
+
+#endif  // TF2__THREAD_POOL_H_
@@ -30,12 +30,16 @@
 #ifndef TF2__TIME_CACHE_H_
 #define TF2__TIME_CACHE_H_
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <deque>
 #include <memory>
-#include <list>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "tf2/visibility_control.h"
 #include "tf2/transform_storage.h"
@@ -44,6 +48,96 @@ namespace tf2
 {
 typedef std::pair<tf2::TimePoint, tf2::CompactFrameID> P_TimeAndFrameID;
 
+/** \brief A copy of a TransformStorage that is protected by a sequence lock.
+ *
+ * One writer at a time may update it while any number of readers copy it concurrently.
+ * Readers never block the writer, they retry if their copy overlapped an update.
+ */
+class TransformSnapshot
+{
+public:
+  TF2_PUBLIC
+  TransformSnapshot();
+
+  /** \brief Publish sample, must not be called concurrently with store() or reset() */
+  TF2_PUBLIC
+  void store(const tf2::TransformStorage & sample);
+
+  /** \brief Mark the snapshot empty, must not be called concurrently with store() or reset() */
+  TF2_PUBLIC
+  void reset();
+
+  /** \brief Copy the published sample, safe to call concurrently with store() and reset()
+   * \return false if the snapshot is empty or kept changing while being copied */
+  TF2_PUBLIC
+  bool load(tf2::TransformStorage & sample) const;
+
+private:
+  /// Odd while a write is in progress
+  std::atomic<uint32_t> sequence_;
+  std::atomic<bool> valid_;
+  std::atomic<tf2Scalar> rotation_[4];
+  std::atomic<tf2Scalar> translation_[3];
+  std::atomic<int64_t> stamp_;
+  std::atomic<CompactFrameID> frame_id_;
+  std::atomic<CompactFrameID> child_frame_id_;
+};
+
+/** \brief A reader-writer spin lock small enough to guard every cache on its own.
+ *
+ * Critical sections on a cache are a binary search and a copy, far shorter than putting a
+ * thread to sleep, so waiters spin and yield instead.  A waiting writer keeps new readers out.
+ * Meets the Lockable and SharedLockable requirements.
+ */
+class SharedSpinLock
+{
+public:
+  TF2_PUBLIC
+  SharedSpinLock();
+
+  TF2_PUBLIC
+  void lock();
+  TF2_PUBLIC
+  void unlock();
+  TF2_PUBLIC
+  void lock_shared();
+  TF2_PUBLIC
+  void unlock_shared();
+
+private:
+  static constexpr uint32_t WRITER = 1u << 31;
+
+  /// WRITER while a writer holds or waits for the lock, plus the number of readers
+  std::atomic<uint32_t> state_;
+};
+
+/** \brief Limits on the history a cache keeps, see BufferCore::setRetentionPolicy() */
+struct RetentionPolicy
+{
+  /// Samples older than this relative to the newest one are dropped, 0 for the cache's default
+  tf2::Duration max_age = tf2::Duration::zero();
+  /// At most this many samples are kept, 0 for TimeCache::MAX_LENGTH_LINKED_LIST
+  size_t max_samples = 0;
+  /// Samples older than this relative to the newest one are thinned out
+  tf2::Duration decimation_age = tf2::Duration::zero();
+  /// The minimum interval between thinned out samples, 0 to keep all of them
+  tf2::Duration decimation_interval = tf2::Duration::zero();
+  /// Keep the history in a CompressedCache instead of a TimeCache
+  bool compress = false;
+  /// Keep the history in a Float32TimeCache, which takes less memory at about 1e-7 relative
+  /// precision.  Ignored if compress is set.
+  bool single_precision = false;
+  /// Keep the history in a SingleWriterCache, whose lookups never wait for inserts.  Ignored if
+  /// compress or single_precision is set.
+  bool single_writer = false;
+  /// Interpolate rotations closer than this many radians apart with a normalized lerp instead
+  /// of a slerp, 0 to always slerp. See Quaternion::nlerp() for the error this introduces.
+  double nlerp_max_angle = 0.0;
+  /// Lookups up to this far past the newest sample are extrapolated at the constant velocity
+  /// between the two newest samples instead of failing, 0 to never extrapolate
+  tf2::Duration max_extrapolation = tf2::Duration::zero();
+};
+
 class TimeCacheInterface
 {
 public:
@@ -58,10 +152,59 @@ public:
     tf2::TimePoint time, tf2::TransformStorage & data_out,
     std::string * error_str = 0) = 0;
 
+  /** \brief Access data from the cache at several times in one pass
+   * \param times The times to look up, sorted from oldest to newest and none of them zero
+   * \param data_out Resized to hold the sample at each of the times
+   * returns false if data is unavailable at any of the times
+   */
+  TF2_PUBLIC
+  virtual bool getDataBatch(
+    const std::vector<tf2::TimePoint> & times, std::vector<tf2::TransformStorage> & data_out,
+    std::string * error_str = 0)
+  {
+    data_out.resize(times.size());
+    for (size_t i = 0; i < times.size(); ++i) {
+      if (!getData(times[i], data_out[i], error_str)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   /** \brief Insert data into the cache */
   TF2_PUBLIC
   virtual bool insertData(const tf2::TransformStorage & new_data) = 0;
 
+  /** \brief Insert data into the cache, reporting how its length changed
+   * \param length_change Set to the samples added minus the samples pruned by the insert,
+   * counted atomically with it by caches that may be modified concurrently
+   */
+  TF2_PUBLIC
+  virtual bool insertDataCounted(const tf2::TransformStorage & new_data, int64_t & length_change)
+  {
+    int64_t previous_length = getListLength();
+    bool inserted = insertData(new_data);
+    length_change = static_cast<int64_t>(getListLength()) - previous_length;
+    return inserted;
+  }
+
+  /** \brief Insert samples sorted from oldest to newest in one go
+   * Equivalent to calling insertData() on each of them, caches may skip the samples they would
+   * prune right away and prune only once.
+   * \return The number of samples that were too old to be inserted
+   */
+  TF2_PUBLIC
+  virtual size_t insertSorted(const tf2::TransformStorage * data, size_t count)
+  {
+    size_t rejected = 0;
+    for (size_t i = 0; i < count; ++i) {
+      if (!insertData(data[i])) {
+        ++rejected;
+      }
+    }
+    return rejected;
+  }
+
   /** @brief Clear the list of stored values */
   TF2_PUBLIC
   virtual void clearList() = 0;
@@ -88,6 +231,53 @@ public:
   /** @brief Get the oldest timestamp cached */
   TF2_PUBLIC
   virtual tf2::TimePoint getOldestTimestamp() = 0;
+
+  /** \brief Get a copy of the latest sample without waiting for modifications of the cache.
+   * \return false if no data is available or a copy could not be made right now
+   */
+  TF2_PUBLIC
+  virtual bool getLatestSnapshot(tf2::TransformStorage & data_out) const
+  {
+    (void)data_out;
+    return false;
+  }
+
+  /** \brief Limit the history kept, samples beyond the new limits are dropped right away */
+  TF2_PUBLIC
+  virtual void setRetentionPolicy(const RetentionPolicy & policy)
+  {
+    (void)policy;
+  }
+
+  /** \brief Drop up to count of the oldest samples, the newest one is always kept
+   * \return The number of samples dropped */
+  TF2_PUBLIC
+  virtual size_t dropOldest(size_t count)
+  {
+    (void)count;
+    return 0;
+  }
+
+  /** \brief Get the memory reserved for samples in bytes */
+  TF2_PUBLIC
+  virtual size_t getMemoryUsage() const
+  {
+    return 0;
+  }
+
+  /** \brief Set aside room for at least this many samples, so inserting them does not allocate */
+  TF2_PUBLIC
+  virtual void reserve(size_t samples)
+  {
+    (void)samples;
+  }
+
+  /** \brief Append a copy of every sample to data_out, from oldest to newest */
+  TF2_PUBLIC
+  virtual void copySamples(std::vector<tf2::TransformStorage> & data_out) const
+  {
+    (void)data_out;
+  }
 };
 
 using TimeCacheInterfacePtr = std::shared_ptr<TimeCacheInterface>;
@@ -95,11 +285,43 @@ using TimeCacheInterfacePtr = std::shared_ptr<TimeCacheInterface>;
 /// default value of 10 seconds storage
 constexpr tf2::Duration TIMECACHE_DEFAULT_MAX_STORAGE_TIME = std::chrono::seconds(10);
 
-/** \brief A class to keep a sorted linked list in time
+/** \brief Interpolate between two rotations the way the caches do
+ * \param min_dot Use nlerp when the absolute dot product of one and two is at least this,
+ * see getNlerpMinDot()
+ */
+inline tf2::Quaternion interpolateRotation(
+  const tf2::Quaternion & one, const tf2::Quaternion & two, tf2Scalar ratio, tf2Scalar min_dot)
+{
+  tf2Scalar dot = one.dot(two);
+  if ((dot < 0 ? -dot : dot) >= min_dot) {
+    return nlerp(one, two, ratio);
+  }
+  return slerp(one, two, ratio);
+}
+
+/** \brief The dot product above which interpolateRotation() uses nlerp for a policy */
+inline tf2Scalar getNlerpMinDot(const RetentionPolicy & policy)
+{
+  // Unit quaternions a rotation angle apart have a dot product of cos(angle / 2)
+  return policy.nlerp_max_angle > 0.0 ? tf2Cos(policy.nlerp_max_angle / 2.0) : 2.0;
+}
+
+/** \brief A class to keep a sorted list in time
  * This builds and maintains a list of timestamped
  * data.  And provides lookup functions to get
- * data out as a function of time. */
-class TimeCache : public TimeCacheInterface
+ * data out as a function of time.
+ *
+ * The samples are kept oldest to newest in a contiguous ring buffer, so
+ * lookups are a binary search and appending or pruning at either end is
+ * amortized constant time.
+ *
+ * Sample is the type the samples are stored as, TransformStorage or the smaller
+ * Float32TransformStorage, see the TimeCache and Float32TimeCache aliases.  Only those two are
+ * instantiated.  It is final so calls through a pointer to it need no virtual dispatch.
+ *
+ * Every method takes a lock of the cache, so one frame can be updated while others are read. */
+template<class Sample>
+class BasicTimeCache final : public TimeCacheInterface
 {
 public:
   /// Number of nano-seconds to not interpolate below.
@@ -110,7 +332,7 @@ public:
   TF2_PUBLIC
   static const unsigned int MAX_LENGTH_LINKED_LIST = 1000000;
   TF2_PUBLIC
-  explicit TimeCache(tf2::Duration max_storage_time = TIMECACHE_DEFAULT_MAX_STORAGE_TIME);
+  explicit BasicTimeCache(tf2::Duration max_storage_time = TIMECACHE_DEFAULT_MAX_STORAGE_TIME);
 
   /// Virtual methods
 
@@ -119,8 +341,16 @@ public:
     tf2::TimePoint time, tf2::TransformStorage & data_out,
     std::string * error_str = 0);
   TF2_PUBLIC
+  virtual bool getDataBatch(
+    const std::vector<tf2::TimePoint> & times, std::vector<tf2::TransformStorage> & data_out,
+    std::string * error_str = 0);
+  TF2_PUBLIC
   virtual bool insertData(const tf2::TransformStorage & new_data);
   TF2_PUBLIC
+  virtual bool insertDataCounted(const tf2::TransformStorage & new_data, int64_t & length_change);
+  TF2_PUBLIC
+  virtual size_t insertSorted(const tf2::TransformStorage * data, size_t count);
+  TF2_PUBLIC
   virtual void clearList();
   TF2_PUBLIC
   virtual tf2::CompactFrameID getParent(tf2::TimePoint time, std::string * error_str);
@@ -135,26 +365,96 @@ public:
   TF2_PUBLIC
   virtual TimePoint getOldestTimestamp();
 
+  TF2_PUBLIC
+  virtual bool getLatestSnapshot(tf2::TransformStorage & data_out) const;
+
+  TF2_PUBLIC
+  virtual void setRetentionPolicy(const RetentionPolicy & policy);
+  TF2_PUBLIC
+  virtual size_t dropOldest(size_t count);
+  TF2_PUBLIC
+  virtual size_t getMemoryUsage() const;
+  TF2_PUBLIC
+  virtual void copySamples(std::vector<tf2::TransformStorage> & data_out) const;
+  TF2_PUBLIC
+  virtual void reserve(size_t samples);
+
 private:
-  typedef std::list<TransformStorage> L_TransformStorage;
-  L_TransformStorage storage_;
+  /// Ring buffer holding the samples, its capacity is always zero or a power of two.
+  std::vector<Sample> storage_;
+  /// Physical index of the oldest sample in storage_.
+  size_t storage_head_;
+  /// Number of valid samples in storage_.
+  size_t storage_size_;
 
   tf2::Duration max_storage_time_;
+  /// The max_storage_time the cache was constructed with
+  tf2::Duration default_max_storage_time_;
+  size_t max_samples_;
+  tf2::Duration decimation_age_;
+  tf2::Duration decimation_interval_;
+  /// Number of oldest samples that have already been thinned out
+  size_t decimated_size_;
+  /// Rotations with an absolute dot product of at least this are interpolated with nlerp
+  tf2Scalar nlerp_min_dot_;
+  /// See RetentionPolicy::max_extrapolation
+  tf2::Duration max_extrapolation_;
+
+  /// The newest sample, republished by every change to the samples
+  TransformSnapshot latest_;
+  /// Guards everything above but latest_
+  mutable SharedSpinLock lock_;
+  /** \brief Where findClosest() found the last interpolated lookup, the logical index of the
+   * newer sample.  Readers share it without ordering, it is only ever a hint. */
+  std::atomic<size_t> cursor_;
+
+  /// Access a sample by logical index, 0 being the oldest.
+  inline Sample & sampleAt(size_t index)
+  {
+    return storage_[(storage_head_ + index) & (storage_.size() - 1)];
+  }
+
+  inline Sample & oldest() {return sampleAt(0);}
+  inline Sample & newest() {return sampleAt(storage_size_ - 1);}
+
+  /// Logical index of the first sample with a stamp strictly greater than time.
+  size_t upperBound(tf2::TimePoint time);
+  /// upperBound() among the samples from first up to but excluding last
+  size_t upperBound(tf2::TimePoint time, size_t first, size_t last);
+  /// upperBound() searching outwards from the logical index hint, the cache must not be empty
+  size_t upperBoundFrom(tf2::TimePoint time, size_t hint);
+
+  /// Move the samples to a ring buffer of capacity, a power of two, oldest sample at index 0.
+  void grow(size_t capacity);
+
+  /// insertData() with lock_ already held
+  bool insertDataLocked(const tf2::TransformStorage & new_data);
+  /// Insert a sample older than the newest one, there must be room for it
+  void insertLate(const tf2::TransformStorage & new_data);
 
 
   // A helper function for getData
   // Assumes storage is already locked for it
   inline uint8_t findClosest(
-    tf2::TransformStorage * & one, TransformStorage * & two,
+    Sample * & one, Sample * & two,
     tf2::TimePoint target_time, std::string * error_str);
 
-  inline void interpolate(
-    const tf2::TransformStorage & one, const tf2::TransformStorage & two,
-    tf2::TimePoint time, tf2::TransformStorage & output);
-
   void pruneList();
+
+  inline void popOldest();
+
+  /// Thin out the samples older than decimation_age_, in batches to keep inserts cheap
+  void decimate();
 };
 
+/// A TimeCache keeping samples at full precision
+using TimeCache = BasicTimeCache<TransformStorage>;
+/// A TimeCache keeping samples in single precision, see RetentionPolicy::single_precision
+using Float32TimeCache = BasicTimeCache<Float32TransformStorage>;
+
+extern template class BasicTimeCache<TransformStorage>;
+extern template class BasicTimeCache<Float32TransformStorage>;
+
 class StaticCache : public TimeCacheInterface
 {
 public:
@@ -179,8 +479,282 @@ public:
   TF2_PUBLIC
   virtual TimePoint getOldestTimestamp();
 
+  TF2_PUBLIC
+  virtual bool getLatestSnapshot(tf2::TransformStorage & data_out) const;
+
+  TF2_PUBLIC
+  virtual size_t getMemoryUsage() const;
+  TF2_PUBLIC
+  virtual void copySamples(std::vector<tf2::TransformStorage> & data_out) const;
+
 private:
   TransformStorage storage_;
+  /// storage_ with its stamp zeroed, like getLatestTimeAndParent() reports it
+  TransformSnapshot latest_;
 };
+
+/** \brief A cache for long histories that trades accuracy for memory.
+ *
+ * Samples are kept in blocks that share a parent and an origin.  Each sample stores its stamp
+ * as the delta to the previous one, its rotation quantized to 16 bits per component and its
+ * translation as a float offset from the block origin, under a third of the size of a
+ * TransformStorage.  Samples are decoded on demand, rotations are within about 1e-4 rad and
+ * translations within about 3e-5 m of what was inserted.
+ *
+ * Samples must be inserted in order, older ones are rejected.  Decimation is not supported. */
+class CompressedCache : public TimeCacheInterface
+{
+public:
+  /// Most samples in a block, lookups scan through a block linearly
+  TF2_PUBLIC
+  static const unsigned int MAX_BLOCK_SAMPLES = 64;
+
+  /// Largest distance of a sample from the origin of its block in meters
+  TF2_PUBLIC
+  static constexpr double MAX_BLOCK_OFFSET = 256.0;
+
+  TF2_PUBLIC
+  explicit CompressedCache(tf2::Duration max_storage_time = TIMECACHE_DEFAULT_MAX_STORAGE_TIME);
+
+  /// Virtual methods
+
+  TF2_PUBLIC
+  virtual bool getData(
+    tf2::TimePoint time, tf2::TransformStorage & data_out,
+    std::string * error_str = 0);
+  TF2_PUBLIC
+  virtual bool insertData(const tf2::TransformStorage & new_data);
+  TF2_PUBLIC
+  virtual bool insertDataCounted(const tf2::TransformStorage & new_data, int64_t & length_change);
+  TF2_PUBLIC
+  virtual void clearList();
+  TF2_PUBLIC
+  virtual tf2::CompactFrameID getParent(tf2::TimePoint time, std::string * error_str);
+  TF2_PUBLIC
+  virtual P_TimeAndFrameID getLatestTimeAndParent();
+
+  /// Debugging information methods
+  TF2_PUBLIC
+  virtual unsigned int getListLength();
+  TF2_PUBLIC
+  virtual TimePoint getLatestTimestamp();
+  TF2_PUBLIC
+  virtual TimePoint getOldestTimestamp();
+
+  TF2_PUBLIC
+  virtual bool getLatestSnapshot(tf2::TransformStorage & data_out) const;
+
+  TF2_PUBLIC
+  virtual void setRetentionPolicy(const RetentionPolicy & policy);
+  TF2_PUBLIC
+  virtual size_t dropOldest(size_t count);
+  TF2_PUBLIC
+  virtual size_t getMemoryUsage() const;
+  TF2_PUBLIC
+  virtual void copySamples(std::vector<tf2::TransformStorage> & data_out) const;
+
+private:
+  struct Sample
+  {
+    /// Nanoseconds since the previous sample in the block, 0 for the first one
+    uint32_t stamp_delta;
+    int16_t rotation[4];
+    float translation[3];
+  };
+
+  struct Block
+  {
+    tf2::TimePoint start;
+    /// Stamp of the last sample
+    tf2::TimePoint end;
+    tf2::Vector3 origin;
+    CompactFrameID frame_id;
+    CompactFrameID child_frame_id;
+    std::vector<Sample> samples;
+  };
+
+  /// A sample by block and index in the block, along with its stamp
+  struct Position
+  {
+    size_t block;
+    size_t index;
+    tf2::TimePoint stamp;
+  };
+
+  /// Blocks from oldest to newest, none of them empty
+  std::deque<Block> blocks_;
+  /// Number of samples already dropped from the front of the oldest block
+  size_t front_offset_;
+  /// Stamp of the oldest sample
+  tf2::TimePoint front_stamp_;
+  /// Number of samples in all blocks, not counting the dropped ones
+  size_t size_;
+
+  tf2::Duration max_storage_time_;
+  /// The max_storage_time the cache was constructed with
+  tf2::Duration default_max_storage_time_;
+  size_t max_samples_;
+  /// Rotations with an absolute dot product of at least this are interpolated with nlerp
+  tf2Scalar nlerp_min_dot_;
+  /// See RetentionPolicy::max_extrapolation
+  tf2::Duration max_extrapolation_;
+
+  /// The newest sample, republished by every change to the samples
+  TransformSnapshot latest_;
+  /// Guards everything above but latest_
+  mutable SharedSpinLock lock_;
+
+  tf2::TransformStorage decode(const Position & position) const;
+
+  /// insertData() with lock_ already held
+  bool insertDataLocked(const tf2::TransformStorage & new_data);
+  Position oldest() const {return Position{0, front_offset_, front_stamp_};}
+  Position newest() const
+  {
+    return Position{blocks_.size() - 1, blocks_.back().samples.size() - 1, blocks_.back().end};
+  }
+
+  /// Find the samples right before and after time, which must be strictly between the oldest
+  /// and newest sample
+  void bracket(tf2::TimePoint time, Position & older, Position & newer) const;
+
+  /// Same as TimeCache::findClosest(), but decoding the samples found
+  uint8_t findClosest(
+    tf2::TransformStorage & one, tf2::TransformStorage & two,
+    tf2::TimePoint target_time, std::string * error_str);
+
+  void pruneList();
+  void popOldest();
+};
+
+/** \brief A cache for frames with a single publisher, whose readers never wait for it.
+ *
+ * Samples are appended to a power-of-two ring and published by advancing its end index.
+ * Readers copy what they need with relaxed atomic loads and retry if the writer wrapped around
+ * onto a sample they used meanwhile, so they neither block nor are blocked by inserts.  When
+ * the history outgrows the ring it is copied into one twice as large, the old rings are kept
+ * until the cache is destroyed for the readers that may still be using them.
+ *
+ * Writers are serialized by a mutex of their own.  Samples must be inserted in order, older
+ * ones are rejected.  Decimation is not supported. */
+class SingleWriterCache final : public TimeCacheInterface
+{
+public:
+  TF2_PUBLIC
+  explicit SingleWriterCache(tf2::Duration max_storage_time = TIMECACHE_DEFAULT_MAX_STORAGE_TIME);
+
+  /// Virtual methods
+
+  TF2_PUBLIC
+  virtual bool getData(
+    tf2::TimePoint time, tf2::TransformStorage & data_out,
+    std::string * error_str = 0);
+  TF2_PUBLIC
+  virtual bool insertData(const tf2::TransformStorage & new_data);
+  TF2_PUBLIC
+  virtual bool insertDataCounted(const tf2::TransformStorage & new_data, int64_t & length_change);
+  TF2_PUBLIC
+  virtual void clearList();
+  TF2_PUBLIC
+  virtual tf2::CompactFrameID getParent(tf2::TimePoint time, std::string * error_str);
+  TF2_PUBLIC
+  virtual P_TimeAndFrameID getLatestTimeAndParent();
+
+  /// Debugging information methods
+  TF2_PUBLIC
+  virtual unsigned int getListLength();
+  TF2_PUBLIC
+  virtual TimePoint getLatestTimestamp();
+  TF2_PUBLIC
+  virtual TimePoint getOldestTimestamp();
+
+  TF2_PUBLIC
+  virtual bool getLatestSnapshot(tf2::TransformStorage & data_out) const;
+
+  TF2_PUBLIC
+  virtual void setRetentionPolicy(const RetentionPolicy & policy);
+  TF2_PUBLIC
+  virtual size_t dropOldest(size_t count);
+  TF2_PUBLIC
+  virtual size_t getMemoryUsage() const;
+  TF2_PUBLIC
+  virtual void copySamples(std::vector<tf2::TransformStorage> & data_out) const;
+  TF2_PUBLIC
+  virtual void reserve(size_t samples);
+
+private:
+  /// A TransformStorage that may be overwritten while it is being read
+  struct Slot
+  {
+    std::atomic<tf2Scalar> rotation[4];
+    std::atomic<tf2Scalar> translation[3];
+    std::atomic<int64_t> stamp;
+    std::atomic<CompactFrameID> frame_id;
+    std::atomic<CompactFrameID> child_frame_id;
+  };
+
+  struct Ring
+  {
+    explicit Ring(size_t capacity)
+    : slots(new Slot[capacity]), mask(capacity - 1) {}
+
+    Slot & at(uint64_t index) const {return slots[index & mask];}
+
+    std::unique_ptr<Slot[]> slots;
+    uint64_t mask;
+  };
+
+  /// The samples a reader may use, with logical indices in [begin, end)
+  struct View
+  {
+    const Ring * ring;
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  /// The ring appended to, always the last of rings_
+  std::atomic<Ring *> ring_;
+  /// Logical index of the oldest sample
+  std::atomic<uint64_t> begin_;
+  /// Logical index after the newest sample, advanced once it is written
+  std::atomic<uint64_t> end_;
+  /// Logical index after the sample being written, advanced before writing it
+  std::atomic<uint64_t> claimed_;
+  /// Rotations with an absolute dot product of at least this are interpolated with nlerp
+  std::atomic<tf2Scalar> nlerp_min_dot_;
+  /// See RetentionPolicy::max_extrapolation
+  std::atomic<tf2::Duration> max_extrapolation_;
+
+  /// Guards everything below, lookups never take it
+  mutable std::mutex writer_mutex_;
+  /// Every ring allocated so far, the older ones retired by growing
+  std::vector<std::unique_ptr<Ring>> rings_;
+  tf2::Duration max_storage_time_;
+  /// The max_storage_time the cache was constructed with
+  tf2::Duration default_max_storage_time_;
+  size_t max_samples_;
+
+  static void store(Slot & slot, const tf2::TransformStorage & sample);
+  static tf2::TransformStorage load(const Slot & slot);
+  static tf2::TimePoint loadStamp(const Slot & slot);
+
+  /** \brief Run f on the current samples until none it used was overwritten meanwhile
+   * \param f Called as f(view, oldest_used), it must set oldest_used to the lowest logical
+   *   index it loaded if it loaded any
+   * \return What f returned for the view it was left intact on */
+  template<class F>
+  bool read(F f) const;
+
+  /// Logical index of the first sample in view with a stamp strictly greater than time
+  static uint64_t upperBound(const View & view, tf2::TimePoint time);
+
+  /// insertData() with writer_mutex_ already held
+  bool insertDataLocked(const tf2::TransformStorage & new_data);
+  /// Drop the samples beyond the retention limits, writer_mutex_ must be held
+  void pruneList(uint64_t end);
+  /// Publish a copy of the samples in a new ring of capacity, writer_mutex_ must be held
+  Ring * grow(uint64_t capacity);
+};
+
 }  // namespace tf2
 #endif  // TF2__TIME_CACHE_H_
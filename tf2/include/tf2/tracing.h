@@ -0,0 +1,106 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+/** \file
+ * \brief Static tracepoints on the paths a transform takes from arrival to the consumers that
+ * waited for it.
+ *
+ * They are compiled out unless tf2 is built with -DTF2_TRACING=ON, which also defines
+ * TF2_TRACING_ENABLED for everything that builds against it.  The events are LTTng userspace
+ * events of the "tf2" provider, so a session started with
+ * `ros2 trace -u 'ros2:*' 'tf2:*'` records them next to the ros2_tracing events.
+ * Arguments of a compiled out TF2_TRACEPOINT are not evaluated.
+ */
+
+#ifndef TF2__TRACING_H_
+#define TF2__TRACING_H_
+
+#include <cstdint>
+
+#include "tf2/visibility_control.h"
+
+#ifdef TF2_TRACING_ENABLED
+
+/** \brief Emit the tf2:event_name tracepoint */
+#define TF2_TRACEPOINT(event_name, ...) ::tf2::tracing::event_name(__VA_ARGS__)
+
+namespace tf2
+{
+namespace tracing
+{
+
+/// BufferCore stored a transform, stamp in nanoseconds
+TF2_PUBLIC
+void set_transform(
+  const void * buffer, const char * frame_id, const char * child_frame_id, int64_t stamp,
+  bool is_static);
+
+/// A transformable request of BufferCore completed and is about to call back
+TF2_PUBLIC
+void transformable_request_ready(
+  const void * buffer, uint64_t request_handle, const char * target_frame,
+  const char * source_frame, int64_t stamp, bool available);
+
+/// A TransformListener received a TFMessage
+TF2_PUBLIC
+void listener_callback(const void * listener, uint64_t transform_count, bool is_static);
+
+/// tf2_ros::Buffer::waitForTransform() started waiting on a transformable request
+TF2_PUBLIC
+void wait_for_transform(
+  const void * buffer, uint64_t request_handle, const char * target_frame,
+  const char * source_frame, int64_t stamp);
+
+/// A waitForTransform() request timed out
+TF2_PUBLIC
+void wait_for_transform_timeout(const void * buffer, uint64_t request_handle);
+
+/// A tf2_ros::MessageFilter received a message
+TF2_PUBLIC
+void message_filter_add(const void * filter, const char * frame_id, int64_t stamp);
+
+/// A MessageFilter passed a message on to its callbacks
+TF2_PUBLIC
+void message_filter_dispatch(const void * filter, const char * frame_id, int64_t stamp);
+
+/// A MessageFilter dropped a message, reason is a tf2_ros::FilterFailureReason
+TF2_PUBLIC
+void message_filter_drop(
+  const void * filter, const char * frame_id, int64_t stamp, int reason);
+
+}  // namespace tracing
+}  // namespace tf2
+
+#else
+
+#define TF2_TRACEPOINT(event_name, ...) ((void)0)
+
+#endif  // TF2_TRACING_ENABLED
+
+#endif  // TF2__TRACING_H_
@@ -73,5 +73,65 @@ public:
   CompactFrameID frame_id_;
   CompactFrameID child_frame_id_;
 };
+
+/** \brief Storage for transforms and their parent in single precision
+ *
+ * Takes 48 bytes instead of the 80 of a TransformStorage.  Converting to a TransformStorage
+ * widens the values back to double, so all math is still done in double precision.
+ */
+class Float32TransformStorage
+{
+public:
+  TF2_PUBLIC
+  Float32TransformStorage()
+  {
+  }
+
+  TF2_PUBLIC
+  Float32TransformStorage(const TransformStorage & rhs)  // NOLINT(runtime/explicit)
+  {
+    *this = rhs;
+  }
+
+  TF2_PUBLIC
+  Float32TransformStorage & operator=(const TransformStorage & rhs)
+  {
+    for (int i = 0; i < 4; ++i) {
+      rotation_[i] = static_cast<float>(rhs.rotation_[i]);
+    }
+    for (int i = 0; i < 3; ++i) {
+      translation_[i] = static_cast<float>(rhs.translation_[i]);
+    }
+    stamp_ = rhs.stamp_;
+    frame_id_ = rhs.frame_id_;
+    child_frame_id_ = rhs.child_frame_id_;
+    return *this;
+  }
+
+  TF2_PUBLIC
+  operator TransformStorage() const
+  {
+    return TransformStorage(
+      stamp_, getRotation(), getTranslation(), frame_id_, child_frame_id_);
+  }
+
+  TF2_PUBLIC
+  tf2::Quaternion getRotation() const
+  {
+    return tf2::Quaternion(rotation_[0], rotation_[1], rotation_[2], rotation_[3]);
+  }
+
+  TF2_PUBLIC
+  tf2::Vector3 getTranslation() const
+  {
+    return tf2::Vector3(translation_[0], translation_[1], translation_[2]);
+  }
+
+  TimePoint stamp_;
+  float rotation_[4];
+  float translation_[3];
+  CompactFrameID frame_id_;
+  CompactFrameID child_frame_id_;
+};
 }  // namespace tf2
 #endif  // TF2__TRANSFORM_STORAGE_H_
@@ -0,0 +1,479 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "tf2/batch_math.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TF2_BATCH_MATH_AVX2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TF2_BATCH_MATH_NEON
+#endif
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "tf2/LinearMath/Quaternion.h"
+#include "tf2/LinearMath/Transform.h"
+
+namespace tf2
+{
+namespace batch
+{
+namespace
+{
+
+/// The rows of the basis of a transform followed by its origin
+struct Matrix
+{
+  double m[3][3];
+  double o[3];
+
+  explicit Matrix(const tf2::Transform & t)
+  {
+    for (int row = 0; row < 3; ++row) {
+      for (int col = 0; col < 3; ++col) {
+        m[row][col] = t.getBasis()[row][col];
+      }
+      o[row] = t.getOrigin()[row];
+    }
+  }
+};
+
+// The scalar kernels start at `begin`, so the vector kernels can hand them their remainder
+
+void transformPointsScalar(
+  const Matrix & t, const Vector3Array & in, const Vector3Array & out, size_t begin, size_t count)
+{
+  for (size_t i = begin; i < count; ++i) {
+    const double x = in.x[i], y = in.y[i], z = in.z[i];
+    out.x[i] = t.m[0][0] * x + t.m[0][1] * y + t.m[0][2] * z + t.o[0];
+    out.y[i] = t.m[1][0] * x + t.m[1][1] * y + t.m[1][2] * z + t.o[1];
+    out.z[i] = t.m[2][0] * x + t.m[2][1] * y + t.m[2][2] * z + t.o[2];
+  }
+}
+
+void composeTransformsScalar(
+  const TransformArray & a, const TransformArray & b, const TransformArray & out, size_t begin,
+  size_t count)
+{
+  for (size_t i = begin; i < count; ++i) {
+    const double ax = a.rotation.x[i], ay = a.rotation.y[i], az = a.rotation.z[i];
+    const double aw = a.rotation.w[i];
+    const double bx = b.rotation.x[i], by = b.rotation.y[i], bz = b.rotation.z[i];
+    const double bw = b.rotation.w[i];
+    const double vx = b.origin.x[i], vy = b.origin.y[i], vz = b.origin.z[i];
+    // v + w t + u x t, with u the vector part of a and t = 2 u x v
+    const double tx = 2.0 * (ay * vz - az * vy);
+    const double ty = 2.0 * (az * vx - ax * vz);
+    const double tz = 2.0 * (ax * vy - ay * vx);
+    out.origin.x[i] = a.origin.x[i] + vx + aw * tx + (ay * tz - az * ty);
+    out.origin.y[i] = a.origin.y[i] + vy + aw * ty + (az * tx - ax * tz);
+    out.origin.z[i] = a.origin.z[i] + vz + aw * tz + (ax * ty - ay * tx);
+    out.rotation.x[i] = aw * bx + ax * bw + ay * bz - az * by;
+    out.rotation.y[i] = aw * by + ay * bw + az * bx - ax * bz;
+    out.rotation.z[i] = aw * bz + az * bw + ax * by - ay * bx;
+    out.rotation.w[i] = aw * bw - ax * bx - ay * by - az * bz;
+  }
+}
+
+void normalizeQuaternionsScalar(const QuaternionArray & q, size_t begin, size_t count)
+{
+  for (size_t i = begin; i < count; ++i) {
+    const double scale = 1.0 /
+      std::sqrt(q.x[i] * q.x[i] + q.y[i] * q.y[i] + q.z[i] * q.z[i] + q.w[i] * q.w[i]);
+    q.x[i] *= scale;
+    q.y[i] *= scale;
+    q.z[i] *= scale;
+    q.w[i] *= scale;
+  }
+}
+
+void checkTransformsScalar(
+  const TransformArray & t, double tolerance, uint8_t * flags, size_t begin, size_t count)
+{
+  for (size_t i = begin; i < count; ++i) {
+    const double x = t.rotation.x[i], y = t.rotation.y[i], z = t.rotation.z[i];
+    const double w = t.rotation.w[i];
+    const bool has_nan = std::isnan(x) || std::isnan(y) || std::isnan(z) || std::isnan(w) ||
+      std::isnan(t.origin.x[i]) || std::isnan(t.origin.y[i]) || std::isnan(t.origin.z[i]);
+    const bool normalized = std::abs((w * w + x * x + y * y + z * z) - 1.0) < tolerance;
+    flags[i] = (has_nan ? TRANSFORM_HAS_NAN : 0) | (normalized ? 0 : TRANSFORM_DENORMALIZED);
+  }
+}
+
+#if defined(TF2_BATCH_MATH_AVX2)
+
+#define TF2_AVX2 __attribute__((target("avx2,fma")))
+
+TF2_AVX2
+void transformPointsAVX2(
+  const Matrix & t, const Vector3Array & in, const Vector3Array & out, size_t count)
+{
+  __m256d m[3][3], o[3];
+  for (int row = 0; row < 3; ++row) {
+    for (int col = 0; col < 3; ++col) {
+      m[row][col] = _mm256_set1_pd(t.m[row][col]);
+    }
+    o[row] = _mm256_set1_pd(t.o[row]);
+  }
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m256d x = _mm256_loadu_pd(in.x + i);
+    const __m256d y = _mm256_loadu_pd(in.y + i);
+    const __m256d z = _mm256_loadu_pd(in.z + i);
+    __m256d r[3];
+    for (int row = 0; row < 3; ++row) {
+      r[row] = _mm256_fmadd_pd(
+        m[row][0], x, _mm256_fmadd_pd(m[row][1], y, _mm256_fmadd_pd(m[row][2], z, o[row])));
+    }
+    _mm256_storeu_pd(out.x + i, r[0]);
+    _mm256_storeu_pd(out.y + i, r[1]);
+    _mm256_storeu_pd(out.z + i, r[2]);
+  }
+  transformPointsScalar(t, in, out, i, count);
+}
+
+TF2_AVX2
+void composeTransformsAVX2(
+  const TransformArray & a, const TransformArray & b, const TransformArray & out, size_t count)
+{
+  const __m256d two = _mm256_set1_pd(2.0);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m256d ax = _mm256_loadu_pd(a.rotation.x + i), ay = _mm256_loadu_pd(a.rotation.y + i);
+    const __m256d az = _mm256_loadu_pd(a.rotation.z + i), aw = _mm256_loadu_pd(a.rotation.w + i);
+    const __m256d bx = _mm256_loadu_pd(b.rotation.x + i), by = _mm256_loadu_pd(b.rotation.y + i);
+    const __m256d bz = _mm256_loadu_pd(b.rotation.z + i), bw = _mm256_loadu_pd(b.rotation.w + i);
+    const __m256d vx = _mm256_loadu_pd(b.origin.x + i), vy = _mm256_loadu_pd(b.origin.y + i);
+    const __m256d vz = _mm256_loadu_pd(b.origin.z + i);
+
+    const __m256d tx = _mm256_mul_pd(two, _mm256_fmsub_pd(ay, vz, _mm256_mul_pd(az, vy)));
+    const __m256d ty = _mm256_mul_pd(two, _mm256_fmsub_pd(az, vx, _mm256_mul_pd(ax, vz)));
+    const __m256d tz = _mm256_mul_pd(two, _mm256_fmsub_pd(ax, vy, _mm256_mul_pd(ay, vx)));
+    const __m256d px = _mm256_add_pd(
+      _mm256_add_pd(_mm256_loadu_pd(a.origin.x + i), vx),
+      _mm256_fmadd_pd(aw, tx, _mm256_fmsub_pd(ay, tz, _mm256_mul_pd(az, ty))));
+    const __m256d py = _mm256_add_pd(
+      _mm256_add_pd(_mm256_loadu_pd(a.origin.y + i), vy),
+      _mm256_fmadd_pd(aw, ty, _mm256_fmsub_pd(az, tx, _mm256_mul_pd(ax, tz))));
+    const __m256d pz = _mm256_add_pd(
+      _mm256_add_pd(_mm256_loadu_pd(a.origin.z + i), vz),
+      _mm256_fmadd_pd(aw, tz, _mm256_fmsub_pd(ax, ty, _mm256_mul_pd(ay, tx))));
+
+    const __m256d qx = _mm256_fmadd_pd(
+      aw, bx, _mm256_fmadd_pd(ax, bw, _mm256_fmsub_pd(ay, bz, _mm256_mul_pd(az, by))));
+    const __m256d qy = _mm256_fmadd_pd(
+      aw, by, _mm256_fmadd_pd(ay, bw, _mm256_fmsub_pd(az, bx, _mm256_mul_pd(ax, bz))));
+    const __m256d qz = _mm256_fmadd_pd(
+      aw, bz, _mm256_fmadd_pd(az, bw, _mm256_fmsub_pd(ax, by, _mm256_mul_pd(ay, bx))));
+    const __m256d qw = _mm256_fmsub_pd(
+      aw, bw, _mm256_fmadd_pd(ax, bx, _mm256_fmadd_pd(ay, by, _mm256_mul_pd(az, bz))));
+
+    // Everything is loaded before anything is stored, so out may alias a or b
+    _mm256_storeu_pd(out.origin.x + i, px);
+    _mm256_storeu_pd(out.origin.y + i, py);
+    _mm256_storeu_pd(out.origin.z + i, pz);
+    _mm256_storeu_pd(out.rotation.x + i, qx);
+    _mm256_storeu_pd(out.rotation.y + i, qy);
+    _mm256_storeu_pd(out.rotation.z + i, qz);
+    _mm256_storeu_pd(out.rotation.w + i, qw);
+  }
+  composeTransformsScalar(a, b, out, i, count);
+}
+
+TF2_AVX2
+void normalizeQuaternionsAVX2(const QuaternionArray & q, size_t count)
+{
+  const __m256d one = _mm256_set1_pd(1.0);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m256d x = _mm256_loadu_pd(q.x + i), y = _mm256_loadu_pd(q.y + i);
+    const __m256d z = _mm256_loadu_pd(q.z + i), w = _mm256_loadu_pd(q.w + i);
+    const __m256d length2 = _mm256_fmadd_pd(
+      x, x, _mm256_fmadd_pd(y, y, _mm256_fmadd_pd(z, z, _mm256_mul_pd(w, w))));
+    const __m256d scale = _mm256_div_pd(one, _mm256_sqrt_pd(length2));
+    _mm256_storeu_pd(q.x + i, _mm256_mul_pd(x, scale));
+    _mm256_storeu_pd(q.y + i, _mm256_mul_pd(y, scale));
+    _mm256_storeu_pd(q.z + i, _mm256_mul_pd(z, scale));
+    _mm256_storeu_pd(q.w + i, _mm256_mul_pd(w, scale));
+  }
+  normalizeQuaternionsScalar(q, i, count);
+}
+
+TF2_AVX2
+void checkTransformsAVX2(
+  const TransformArray & t, double tolerance, uint8_t * flags, size_t count)
+{
+  const __m256d one = _mm256_set1_pd(1.0), limit = _mm256_set1_pd(tolerance);
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m256d x = _mm256_loadu_pd(t.rotation.x + i), y = _mm256_loadu_pd(t.rotation.y + i);
+    const __m256d z = _mm256_loadu_pd(t.rotation.z + i), w = _mm256_loadu_pd(t.rotation.w + i);
+    const __m256d ox = _mm256_loadu_pd(t.origin.x + i), oy = _mm256_loadu_pd(t.origin.y + i);
+    const __m256d oz = _mm256_loadu_pd(t.origin.z + i);
+    // An unordered comparison is true if either value is a nan
+    __m256d nan = _mm256_cmp_pd(x, y, _CMP_UNORD_Q);
+    nan = _mm256_or_pd(nan, _mm256_cmp_pd(z, w, _CMP_UNORD_Q));
+    nan = _mm256_or_pd(nan, _mm256_cmp_pd(ox, oy, _CMP_UNORD_Q));
+    nan = _mm256_or_pd(nan, _mm256_cmp_pd(oz, oz, _CMP_UNORD_Q));
+    // Summed in the order of the scalar loop so both round the same
+    const __m256d length2 = _mm256_add_pd(
+      _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(w, w), _mm256_mul_pd(x, x)), _mm256_mul_pd(y, y)),
+      _mm256_mul_pd(z, z));
+    const __m256d deviation = _mm256_andnot_pd(sign, _mm256_sub_pd(length2, one));
+    const int has_nan = _mm256_movemask_pd(nan);
+    const int normalized = _mm256_movemask_pd(_mm256_cmp_pd(deviation, limit, _CMP_LT_OQ));
+    for (size_t j = 0; j < 4; ++j) {
+      flags[i + j] = static_cast<uint8_t>(
+        ((has_nan >> j) & 1 ? TRANSFORM_HAS_NAN : 0) |
+        ((normalized >> j) & 1 ? 0 : TRANSFORM_DENORMALIZED));
+    }
+  }
+  checkTransformsScalar(t, tolerance, flags, i, count);
+}
+
+#undef TF2_AVX2
+
+#elif defined(TF2_BATCH_MATH_NEON)
+
+void transformPointsNEON(
+  const Matrix & t, const Vector3Array & in, const Vector3Array & out, size_t count)
+{
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const float64x2_t x = vld1q_f64(in.x + i);
+    const float64x2_t y = vld1q_f64(in.y + i);
+    const float64x2_t z = vld1q_f64(in.z + i);
+    float64x2_t r[3];
+    for (int row = 0; row < 3; ++row) {
+      r[row] = vfmaq_n_f64(
+        vfmaq_n_f64(vfmaq_n_f64(vdupq_n_f64(t.o[row]), z, t.m[row][2]), y, t.m[row][1]),
+        x, t.m[row][0]);
+    }
+    vst1q_f64(out.x + i, r[0]);
+    vst1q_f64(out.y + i, r[1]);
+    vst1q_f64(out.z + i, r[2]);
+  }
+  transformPointsScalar(t, in, out, i, count);
+}
+
+void composeTransformsNEON(
+  const TransformArray & a, const TransformArray & b, const TransformArray & out, size_t count)
+{
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const float64x2_t ax = vld1q_f64(a.rotation.x + i), ay = vld1q_f64(a.rotation.y + i);
+    const float64x2_t az = vld1q_f64(a.rotation.z + i), aw = vld1q_f64(a.rotation.w + i);
+    const float64x2_t bx = vld1q_f64(b.rotation.x + i), by = vld1q_f64(b.rotation.y + i);
+    const float64x2_t bz = vld1q_f64(b.rotation.z + i), bw = vld1q_f64(b.rotation.w + i);
+    const float64x2_t vx = vld1q_f64(b.origin.x + i), vy = vld1q_f64(b.origin.y + i);
+    const float64x2_t vz = vld1q_f64(b.origin.z + i);
+
+    // vfmsq_f64(a, b, c) is a - b * c
+    const float64x2_t tx = vmulq_n_f64(vfmsq_f64(vmulq_f64(ay, vz), az, vy), 2.0);
+    const float64x2_t ty = vmulq_n_f64(vfmsq_f64(vmulq_f64(az, vx), ax, vz), 2.0);
+    const float64x2_t tz = vmulq_n_f64(vfmsq_f64(vmulq_f64(ax, vy), ay, vx), 2.0);
+    const float64x2_t px = vaddq_f64(
+      vaddq_f64(vld1q_f64(a.origin.x + i), vx),
+      vfmaq_f64(vfmsq_f64(vmulq_f64(ay, tz), az, ty), aw, tx));
+    const float64x2_t py = vaddq_f64(
+      vaddq_f64(vld1q_f64(a.origin.y + i), vy),
+      vfmaq_f64(vfmsq_f64(vmulq_f64(az, tx), ax, tz), aw, ty));
+    const float64x2_t pz = vaddq_f64(
+      vaddq_f64(vld1q_f64(a.origin.z + i), vz),
+      vfmaq_f64(vfmsq_f64(vmulq_f64(ax, ty), ay, tx), aw, tz));
+
+    const float64x2_t qx = vfmaq_f64(vfmaq_f64(vfmsq_f64(vmulq_f64(ay, bz), az, by), ax, bw), aw, bx);
+    const float64x2_t qy = vfmaq_f64(vfmaq_f64(vfmsq_f64(vmulq_f64(az, bx), ax, bz), ay, bw), aw, by);
+    const float64x2_t qz = vfmaq_f64(vfmaq_f64(vfmsq_f64(vmulq_f64(ax, by), ay, bx), az, bw), aw, bz);
+    const float64x2_t qw = vfmsq_f64(
+      vfmsq_f64(vfmsq_f64(vmulq_f64(aw, bw), ax, bx), ay, by), az, bz);
+
+    // Everything is loaded before anything is stored, so out may alias a or b
+    vst1q_f64(out.origin.x + i, px);
+    vst1q_f64(out.origin.y + i, py);
+    vst1q_f64(out.origin.z + i, pz);
+    vst1q_f64(out.rotation.x + i, qx);
+    vst1q_f64(out.rotation.y + i, qy);
+    vst1q_f64(out.rotation.z + i, qz);
+    vst1q_f64(out.rotation.w + i, qw);
+  }
+  composeTransformsScalar(a, b, out, i, count);
+}
+
+void normalizeQuaternionsNEON(const QuaternionArray & q, size_t count)
+{
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const float64x2_t x = vld1q_f64(q.x + i), y = vld1q_f64(q.y + i);
+    const float64x2_t z = vld1q_f64(q.z + i), w = vld1q_f64(q.w + i);
+    const float64x2_t length2 = vfmaq_f64(vfmaq_f64(vfmaq_f64(vmulq_f64(w, w), z, z), y, y), x, x);
+    const float64x2_t scale = vdivq_f64(vdupq_n_f64(1.0), vsqrtq_f64(length2));
+    vst1q_f64(q.x + i, vmulq_f64(x, scale));
+    vst1q_f64(q.y + i, vmulq_f64(y, scale));
+    vst1q_f64(q.z + i, vmulq_f64(z, scale));
+    vst1q_f64(q.w + i, vmulq_f64(w, scale));
+  }
+  normalizeQuaternionsScalar(q, i, count);
+}
+
+void checkTransformsNEON(
+  const TransformArray & t, double tolerance, uint8_t * flags, size_t count)
+{
+  const float64x2_t one = vdupq_n_f64(1.0), limit = vdupq_n_f64(tolerance);
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const float64x2_t x = vld1q_f64(t.rotation.x + i), y = vld1q_f64(t.rotation.y + i);
+    const float64x2_t z = vld1q_f64(t.rotation.z + i), w = vld1q_f64(t.rotation.w + i);
+    // A value equals itself unless it is a nan
+    uint64x2_t ordered = vandq_u64(vceqq_f64(x, x), vceqq_f64(y, y));
+    ordered = vandq_u64(ordered, vandq_u64(vceqq_f64(z, z), vceqq_f64(w, w)));
+    const float64x2_t ox = vld1q_f64(t.origin.x + i), oy = vld1q_f64(t.origin.y + i);
+    const float64x2_t oz = vld1q_f64(t.origin.z + i);
+    ordered = vandq_u64(ordered, vandq_u64(vceqq_f64(ox, ox), vceqq_f64(oy, oy)));
+    ordered = vandq_u64(ordered, vceqq_f64(oz, oz));
+    // Summed in the order of the scalar loop so both round the same
+    const float64x2_t length2 = vaddq_f64(
+      vaddq_f64(vaddq_f64(vmulq_f64(w, w), vmulq_f64(x, x)), vmulq_f64(y, y)), vmulq_f64(z, z));
+    const uint64x2_t normalized = vcltq_f64(vabsq_f64(vsubq_f64(length2, one)), limit);
+    flags[i] = static_cast<uint8_t>(
+      (vgetq_lane_u64(ordered, 0) ? 0 : TRANSFORM_HAS_NAN) |
+      (vgetq_lane_u64(normalized, 0) ? 0 : TRANSFORM_DENORMALIZED));
+    flags[i + 1] = static_cast<uint8_t>(
+      (vgetq_lane_u64(ordered, 1) ? 0 : TRANSFORM_HAS_NAN) |
+      (vgetq_lane_u64(normalized, 1) ? 0 : TRANSFORM_DENORMALIZED));
+  }
+  checkTransformsScalar(t, tolerance, flags, i, count);
+}
+
+#endif
+
+#if defined(TF2_BATCH_MATH_AVX2)
+bool haveAVX2()
+{
+  static const bool have_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return have_avx2;
+}
+#endif
+
+}  // namespace
+
+void transformPoints(
+  const tf2::Transform & t, const Vector3Array & in, const Vector3Array & out, size_t count)
+{
+  const Matrix matrix(t);
+#if defined(TF2_BATCH_MATH_AVX2)
+  if (haveAVX2()) {
+    transformPointsAVX2(matrix, in, out, count);
+    return;
+  }
+#elif defined(TF2_BATCH_MATH_NEON)
+  transformPointsNEON(matrix, in, out, count);
+  return;
+#endif
+  transformPointsScalar(matrix, in, out, 0, count);
+}
+
+void composeTransforms(
+  const TransformArray & a, const TransformArray & b, const TransformArray & out, size_t count)
+{
+#if defined(TF2_BATCH_MATH_AVX2)
+  if (haveAVX2()) {
+    composeTransformsAVX2(a, b, out, count);
+    return;
+  }
+#elif defined(TF2_BATCH_MATH_NEON)
+  composeTransformsNEON(a, b, out, count);
+  return;
+#endif
+  composeTransformsScalar(a, b, out, 0, count);
+}
+
+void normalizeQuaternions(const QuaternionArray & q, size_t count)
+{
+#if defined(TF2_BATCH_MATH_AVX2)
+  if (haveAVX2()) {
+    normalizeQuaternionsAVX2(q, count);
+    return;
+  }
+#elif defined(TF2_BATCH_MATH_NEON)
+  normalizeQuaternionsNEON(q, count);
+  return;
+#endif
+  normalizeQuaternionsScalar(q, 0, count);
+}
+
+void checkTransforms(const TransformArray & t, double tolerance, uint8_t * flags, size_t count)
+{
+#if defined(TF2_BATCH_MATH_AVX2)
+  if (haveAVX2()) {
+    checkTransformsAVX2(t, tolerance, flags, count);
+    return;
+  }
+#elif defined(TF2_BATCH_MATH_NEON)
+  checkTransformsNEON(t, tolerance, flags, count);
+  return;
+#endif
+  checkTransformsScalar(t, tolerance, flags, 0, count);
+}
+
+void slerpQuaternions(
+  const QuaternionArray & a, const QuaternionArray & b, const double * ratio,
+  const QuaternionArray & out, size_t count)
+{
+  // acos and sin have no vector instructions, so this stays a scalar loop over the arrays,
+  // following tf2::Quaternion::slerp() exactly
+  for (size_t i = 0; i < count; ++i) {
+    const tf2::Quaternion qa(a.x[i], a.y[i], a.z[i], a.w[i]);
+    const tf2::Quaternion qb(b.x[i], b.y[i], b.z[i], b.w[i]);
+    const tf2::Quaternion q = qa.slerp(qb, ratio[i]);
+    out.x[i] = q.x();
+    out.y[i] = q.y();
+    out.z[i] = q.z();
+    out.w[i] = q.w();
+  }
+}
+
+const char * getKernelName()
+{
+#if defined(TF2_BATCH_MATH_AVX2)
+  return haveAVX2() ? "avx2" : "scalar";
+#elif defined(TF2_BATCH_MATH_NEON)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
+}  // namespace batch
+}  // namespace tf2
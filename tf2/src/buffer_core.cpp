@@ -30,15 +30,23 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <map>
 #include <mutex>
+#include <numeric>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "tf2/batch_math.h"
 #include "tf2/buffer_core.h"
 #include "tf2/time_cache.h"
 #include "tf2/exceptions.h"
+#include "tf2/tracing.h"
 
 #include "console_bridge/console.h"
 #include "tf2/LinearMath/Transform.h"
@@ -46,9 +54,61 @@
 namespace tf2
 {
 
+// Layout of the files written by BufferCore::saveSnapshot(): a Header, header.frame_count
+// Frames, header.names_size bytes of names and header.sample_count Samples.  Frame i describes
+// CompactFrameID i + 1 of the buffer that wrote the file, which is what Sample::frame_id and
+// Sample::child_frame_id refer to.
+namespace snapshot
+{
+const char MAGIC[8] = {'T', 'F', '2', 'S', 'N', 'A', 'P', '\0'};
+const uint32_t VERSION = 1;
+
+struct Header
+{
+  char magic[8];
+  uint32_t version;
+  /// sizeof(Sample), files written with another layout are rejected
+  uint32_t sample_size;
+  uint64_t frame_count;
+  uint64_t names_size;
+  uint64_t sample_count;
+};
+
+struct Frame
+{
+  /// The name followed by the authority in the names
+  uint64_t name_offset;
+  uint32_t name_length;
+  uint32_t authority_length;
+  uint64_t first_sample;
+  uint64_t sample_count;
+  /// 0 without data, 1 for static and 2 for dynamic frames
+  uint32_t type;
+  uint32_t reserved;
+};
+
+struct Sample
+{
+  int64_t stamp;
+  double rotation[4];
+  double translation[3];
+  uint32_t frame_id;
+  uint32_t child_frame_id;
+};
+
+/// Names are padded so the samples stay aligned when the file is mapped
+inline uint64_t paddedSize(uint64_t size)
+{
+  return (size + 7) & ~static_cast<uint64_t>(7);
+}
+}  // namespace snapshot
+
 // Tolerance for acceptable quaternion normalization
 constexpr static double QUATERNION_NORMALIZATION_TOLERANCE = 10e-3;
 
+// Number of frame pairs compiled by lookups that are kept before the cache is reset
+constexpr static size_t MAX_CACHED_FRAME_CHAINS = 1024;
+
 /** \brief convert Transform msg to Transform */
 void transformMsgToTF2(const geometry_msgs::msg::Transform & msg, tf2::Transform & tf2)
 {
@@ -139,9 +199,27 @@ std::string stripSlash(const std::string & in)
   return out;
 }
 
+/** \brief stripSlash() without copying frame ids that do not start with a slash.
+ * \return in, or stripped holding in without its slash */
+const std::string & stripSlash(const std::string & in, std::string & stripped)
+{
+  if (!startsWithSlash(in)) {
+    return in;
+  }
+  stripped.assign(in, 1, std::string::npos);
+  return stripped;
+}
+
 namespace
 {
 
+TimePoint stampToTimePoint(const builtin_interfaces::msg::Time & stamp)
+{
+  return TimePoint(
+    std::chrono::nanoseconds(stamp.nanosec) +
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::seconds(stamp.sec)));
+}
+
 void fillOrWarnMessageForInvalidFrame(
   const char * function_name_arg,
   const std::string & frame_id,
@@ -188,308 +266,1467 @@ CompactFrameID BufferCore::validateFrameId(
   const char * function_name_arg,
   const std::string & frame_id) const
 {
-  if (frame_id.empty()) {
-    std::string error_msg = "Invalid argument \"" + frame_id + "\" passed to " + function_name_arg +
-      " - in tf2 frame_ids cannot be empty";
+  CompactFrameID id = 0;
+  std::string error_msg;
+  tf2::TF2Error error = checkFrameId(function_name_arg, frame_id, id, &error_msg);
+  if (error == tf2::TF2Error::INVALID_ARGUMENT_ERROR) {
     throw tf2::InvalidArgumentException(error_msg.c_str());
   }
+  if (error == tf2::TF2Error::LOOKUP_ERROR) {
+    throw tf2::LookupException(error_msg.c_str());
+  }
+  return id;
+}
+
+tf2::TF2Error BufferCore::checkFrameId(
+  const char * function_name_arg, const std::string & frame_id,
+  CompactFrameID & id, std::string * error_msg) const
+{
+  if (frame_id.empty()) {
+    if (error_msg) {
+      *error_msg = "Invalid argument \"" + frame_id + "\" passed to " + function_name_arg +
+        " - in tf2 frame_ids cannot be empty";
+    }
+    return tf2::TF2Error::INVALID_ARGUMENT_ERROR;
+  }
 
   if (startsWithSlash(frame_id)) {
-    std::string error_msg = "Invalid argument \"" + frame_id + "\" passed to " + function_name_arg +
-      " - in tf2 frame_ids cannot start with a '/'";
-    throw tf2::InvalidArgumentException(error_msg.c_str());
+    if (error_msg) {
+      *error_msg = "Invalid argument \"" + frame_id + "\" passed to " + function_name_arg +
+        " - in tf2 frame_ids cannot start with a '/'";
+    }
+    return tf2::TF2Error::INVALID_ARGUMENT_ERROR;
   }
 
-  CompactFrameID id = lookupFrameNumber(frame_id);
+  id = lookupFrameNumber(frame_id);
   if (id == 0) {
-    std::string error_msg = "\"" + frame_id + "\" passed to " + function_name_arg +
-      " does not exist. ";
-    throw tf2::LookupException(error_msg.c_str());
+    if (error_msg) {
+      *error_msg = "\"" + frame_id + "\" passed to " + function_name_arg + " does not exist. ";
+    }
+    return tf2::TF2Error::LOOKUP_ERROR;
   }
 
-  return id;
+  return tf2::TF2Error::NO_ERROR;
 }
 
-BufferCore::BufferCore(tf2::Duration cache_time)
-: cache_time_(cache_time),
-  transformable_callbacks_counter_(0),
-  transformable_requests_counter_(0),
-  using_dedicated_thread_(false)
+namespace
 {
-  frameIDs_["NO_PARENT"] = 0;
-  frames_.push_back(TimeCacheInterfacePtr());
-  frameIDs_reverse_.push_back("NO_PARENT");
+
+/// Instrumented calls running on this thread, so calls made by other calls are only counted once
+thread_local int metrics_call_depth = 0;
+
+uint64_t elapsedNs(
+  std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+  return static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
 }
 
-BufferCore::~BufferCore() {}
+/** \brief Times one instrumented call and records it when it goes out of scope */
+class CallMetricsScope
+{
+public:
+  CallMetricsScope(BufferCoreMetricsRecorder * metrics, BufferCoreCall call)
+  : metrics_(metrics), call_(call), error_(TF2Error::NO_ERROR),
+    start_(std::chrono::steady_clock::now())
+  {
+    ++metrics_call_depth;
+  }
 
-void BufferCore::clear()
+  ~CallMetricsScope()
+  {
+    --metrics_call_depth;
+    metrics_->recordCall(call_, error_, elapsedNs(start_, std::chrono::steady_clock::now()));
+  }
+
+  void fail(TF2Error error)
+  {
+    error_ = error;
+  }
+
+private:
+  BufferCoreMetricsRecorder * metrics_;
+  BufferCoreCall call_;
+  TF2Error error_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+/** \brief Run f as one call, counting the exception it throws as its failure */
+template<typename F>
+auto recordCall(BufferCoreMetricsRecorder * metrics, BufferCoreCall call, F && f) -> decltype(f())
 {
-  std::unique_lock<std::mutex> lock(frame_mutex_);
-  if (frames_.size() > 1) {
-    for (std::vector<TimeCacheInterfacePtr>::iterator cache_it = frames_.begin() + 1;
-      cache_it != frames_.end(); ++cache_it)
-    {
-      if (*cache_it) {
-        (*cache_it)->clearList();
-      }
-    }
+  if (!metrics || metrics_call_depth > 0) {
+    return f();
+  }
+  CallMetricsScope scope(metrics, call);
+  try {
+    return f();
+  } catch (const LookupException &) {
+    scope.fail(TF2Error::LOOKUP_ERROR);
+    throw;
+  } catch (const ConnectivityException &) {
+    scope.fail(TF2Error::CONNECTIVITY_ERROR);
+    throw;
+  } catch (const ExtrapolationException &) {
+    scope.fail(TF2Error::EXTRAPOLATION_ERROR);
+    throw;
+  } catch (const InvalidArgumentException &) {
+    scope.fail(TF2Error::INVALID_ARGUMENT_ERROR);
+    throw;
+  } catch (const TimeoutException &) {
+    scope.fail(TF2Error::TIMEOUT_ERROR);
+    throw;
+  } catch (...) {
+    scope.fail(TF2Error::TRANSFORM_ERROR);
+    throw;
   }
 }
 
-bool BufferCore::setTransform(
-  const geometry_msgs::msg::TransformStamped & transform,
-  const std::string & authority, bool is_static)
+/** \brief Run f as one call, counting a false result as a failure with the given cause */
+template<typename F>
+bool recordCheck(
+  BufferCoreMetricsRecorder * metrics, BufferCoreCall call, TF2Error failure, F && f)
 {
-  tf2::Transform tf2_transform(tf2::Quaternion(
-      transform.transform.rotation.x,
-      transform.transform.rotation.y,
-      transform.transform.rotation.z,
-      transform.transform.rotation.w),
-    tf2::Vector3(
-      transform.transform.translation.x,
-      transform.transform.translation.y,
-      transform.transform.translation.z));
-  TimePoint time_point(std::chrono::nanoseconds(transform.header.stamp.nanosec) +
-    std::chrono::duration_cast<std::chrono::nanoseconds>(
-      std::chrono::seconds(
-        transform.header.stamp.sec)));
-  return setTransformImpl(
-    tf2_transform, transform.header.frame_id, transform.child_frame_id,
-    time_point, authority, is_static);
+  if (!metrics || metrics_call_depth > 0) {
+    return f();
+  }
+  CallMetricsScope scope(metrics, call);
+  bool result = f();
+  if (!result) {
+    scope.fail(failure);
+  }
+  return result;
 }
 
-bool BufferCore::setTransformImpl(
-  const tf2::Transform & transform_in, const std::string frame_id,
-  const std::string child_frame_id, const TimePoint stamp,
-  const std::string & authority, bool is_static)
+/** \brief Run f as one call, counting the error it returns as its failure */
+template<typename F>
+TF2Error recordResult(BufferCoreMetricsRecorder * metrics, BufferCoreCall call, F && f)
 {
-  std::string stripped_frame_id = stripSlash(frame_id);
-  std::string stripped_child_frame_id = stripSlash(child_frame_id);
+  if (!metrics || metrics_call_depth > 0) {
+    return f();
+  }
+  CallMetricsScope scope(metrics, call);
+  TF2Error result = f();
+  scope.fail(result);
+  return result;
+}
 
-  bool error_exists = false;
-  if (stripped_child_frame_id == stripped_frame_id) {
-    CONSOLE_BRIDGE_logError(
-      "TF_SELF_TRANSFORM: Ignoring transform from authority \"%s\" with frame_id and  "
-      "child_frame_id \"%s\" because they are the same",
-      authority.c_str(), stripped_child_frame_id.c_str());
-    error_exists = true;
+/** \brief Holds frame_mutex_ exclusively, recording how long it waited for and held it */
+class TimedExclusiveLock
+{
+public:
+  TimedExclusiveLock(std::shared_timed_mutex & mutex, BufferCoreMetricsRecorder * metrics)
+  : metrics_(metrics)
+  {
+    if (metrics_) {
+      requested_ = std::chrono::steady_clock::now();
+    }
+    lock_ = std::unique_lock<std::shared_timed_mutex>(mutex);
+    if (metrics_) {
+      acquired_ = std::chrono::steady_clock::now();
+    }
   }
 
-  if (stripped_child_frame_id == "") {
-    CONSOLE_BRIDGE_logError(
-      "TF_NO_CHILD_FRAME_ID: Ignoring transform from authority \"%s\" because child_frame_id not"
-      " set ", authority.c_str());
-    error_exists = true;
+  ~TimedExclusiveLock()
+  {
+    if (!metrics_) {
+      return;
+    }
+    std::chrono::steady_clock::time_point released = std::chrono::steady_clock::now();
+    lock_.unlock();
+    metrics_->recordExclusiveLock(
+      elapsedNs(requested_, acquired_), elapsedNs(acquired_, released));
   }
 
-  if (stripped_frame_id == "") {
-    CONSOLE_BRIDGE_logError(
-      "TF_NO_FRAME_ID: Ignoring transform with child_frame_id \"%s\"  from authority \"%s\" "
-      "because frame_id not set", stripped_child_frame_id.c_str(), authority.c_str());
-    error_exists = true;
+private:
+  BufferCoreMetricsRecorder * metrics_;
+  std::unique_lock<std::shared_timed_mutex> lock_;
+  std::chrono::steady_clock::time_point requested_;
+  std::chrono::steady_clock::time_point acquired_;
+};
+
+/// The values of transforms laid out for batch::checkTransforms()
+class TransformValues
+{
+public:
+  explicit TransformValues(size_t count)
+  : count_(count), values_(7 * count) {}
+
+  void set(size_t i, const tf2::Transform & transform)
+  {
+    const tf2::Quaternion rotation = transform.getRotation();
+    values_[i] = rotation.x();
+    values_[count_ + i] = rotation.y();
+    values_[2 * count_ + i] = rotation.z();
+    values_[3 * count_ + i] = rotation.w();
+    values_[4 * count_ + i] = transform.getOrigin().x();
+    values_[5 * count_ + i] = transform.getOrigin().y();
+    values_[6 * count_ + i] = transform.getOrigin().z();
   }
 
-  if (std::isnan(transform_in.getOrigin().x()) || std::isnan(transform_in.getOrigin().y()) ||
-    std::isnan(transform_in.getOrigin().z()) ||
-    std::isnan(transform_in.getRotation().x()) || std::isnan(transform_in.getRotation().y()) ||
-    std::isnan(transform_in.getRotation().z()) || std::isnan(transform_in.getRotation().w()))
+  /// Fill flags with the errors of the values set, see batch::checkTransforms()
+  void check(uint8_t * flags)
   {
-    CONSOLE_BRIDGE_logError(
-      "TF_NAN_INPUT: Ignoring transform for child_frame_id \"%s\" from authority \"%s\" because"
-      " of a nan value in the transform (%f %f %f) (%f %f %f %f)",
-      stripped_child_frame_id.c_str(), authority.c_str(),
-      transform_in.getOrigin().x(), transform_in.getOrigin().y(), transform_in.getOrigin().z(),
-      transform_in.getRotation().x(), transform_in.getRotation().y(),
-      transform_in.getRotation().z(), transform_in.getRotation().w()
-    );
-    error_exists = true;
-  }
-
-  bool valid = std::abs(
-    (transform_in.getRotation().w() * transform_in.getRotation().w() +
-    transform_in.getRotation().x() * transform_in.getRotation().x() +
-    transform_in.getRotation().y() * transform_in.getRotation().y() +
-    transform_in.getRotation().z() * transform_in.getRotation().z()) - 1.0f) <
-    QUATERNION_NORMALIZATION_TOLERANCE;
+    double * v = values_.data();
+    const batch::TransformArray array = {
+      {v, v + count_, v + 2 * count_, v + 3 * count_},
+      {v + 4 * count_, v + 5 * count_, v + 6 * count_}};
+    batch::checkTransforms(array, QUATERNION_NORMALIZATION_TOLERANCE, flags, count_);
+  }
 
-  if (!valid) {
-    CONSOLE_BRIDGE_logError(
-      "TF_DENORMALIZED_QUATERNION: Ignoring transform for child_frame_id \"%s\" from authority"
-      " \"%s\" because of an invalid quaternion in the transform (%f %f %f %f)",
-      stripped_child_frame_id.c_str(), authority.c_str(),
-      transform_in.getRotation().x(), transform_in.getRotation().y(),
-      transform_in.getRotation().z(), transform_in.getRotation().w());
-    error_exists = true;
+private:
+  size_t count_;
+  std::vector<double> values_;
+};
+
+/// The handle of the request in slot, the slot in the lower half and the generation of the slot
+/// in the upper one.  Never 0, and never 0xffffffffffffffff as generations stop short of
+/// 0xffffffff.
+TransformableRequestHandle makeRequestHandle(size_t slot, uint32_t generation)
+{
+  return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(slot + 1);
+}
+
+/// The slot a handle of makeRequestHandle() refers to, out of range for 0
+size_t requestSlot(TransformableRequestHandle handle)
+{
+  return static_cast<size_t>(handle & 0xffffffffULL) - 1;
+}
+
+/// Orders the entries of BufferCore::transformable_requests_by_frame_ by requested time
+struct RequestTimeLess
+{
+  bool operator()(
+    const std::pair<TimePoint, TransformableRequestHandle> & entry, TimePoint time) const
+  {
+    return entry.first < time;
+  }
+  bool operator()(
+    TimePoint time, const std::pair<TimePoint, TransformableRequestHandle> & entry) const
+  {
+    return time < entry.first;
   }
+};
 
-  if (error_exists) {
-    return false;
+}  // anonymous namespace
+
+BufferCore::BufferCore(tf2::Duration cache_time)
+: sample_reservation_(0),
+  memory_budget_(0),
+  sample_count_(0),
+  evicted_samples_(0),
+  topology_version_(0),
+  frame_table_version_(0),
+  cache_time_(cache_time),
+  num_transformable_requests_(0),
+  num_indexed_requests_(0),
+  num_stale_indexed_requests_(0),
+  frame_subscriptions_counter_(0),
+  num_frame_subscriptions_(0),
+  metrics_enabled_(false),
+  using_dedicated_thread_(false)
+{
+  frameIDs_["NO_PARENT"] = 0;
+  frames_.push_back(TimeCacheInterfacePtr());
+  frame_types_.push_back(FrameType::Unallocated);
+  frame_parents_.push_back(0);
+  reparent_stamps_.push_back(TimePointZero);
+  static_transforms_.push_back(TransformStorage());
+  static_segments_.push_back(TransformStorage());
+  time_caches_.push_back(nullptr);
+  frameIDs_reverse_.push_back("NO_PARENT");
+  frame_authorities_.push_back(0);
+  authorities_.push_back(std::string());
+  frame_versions_.emplace_back(0);
+}
+
+BufferCore::~BufferCore() {}
+
+void BufferCore::clear()
+{
+  std::unique_lock<std::shared_timed_mutex> lock(frame_mutex_);
+  for (size_t i = 1; i < frames_.size(); ++i) {
+    if (frames_[i]) {
+      frames_[i]->clearList();
+      frame_parents_[i] = frames_[i]->getLatestTimeAndParent().second;
+    }
+    reparent_stamps_[i] = TimePointZero;
+  }
+  sample_count_ = 0;
+  ++topology_version_;
+}
+
+void BufferCore::resetAfterTimeJump(bool fail_pending_requests)
+{
+  clear();
+  if (!fail_pending_requests) {
+    return;
   }
 
+  std::unique_lock<std::mutex> lock(transformable_requests_mutex_);
+  std::vector<ReadyRequest> ready;
+  ready.swap(ready_requests_);
+  size_t num_ready = 0;
   {
-    std::unique_lock<std::mutex> lock(frame_mutex_);
-    CompactFrameID frame_number = lookupOrInsertFrameNumber(stripped_child_frame_id);
-    TimeCacheInterfacePtr frame = getFrame(frame_number);
-    if (frame == NULL) {
-      frame = allocateFrame(frame_number, is_static);
-    } else {
-      // Overwrite TimeCacheInterface type with a current input
-      const TimeCache * time_cache_ptr = dynamic_cast<TimeCache *>(frame.get());
-      const StaticCache * static_cache_ptr = dynamic_cast<StaticCache *>(frame.get());
-      if (time_cache_ptr && is_static) {
-        frame = allocateFrame(frame_number, is_static);
-      } else if (static_cache_ptr && !is_static) {
-        frame = allocateFrame(frame_number, is_static);
-      }
+    std::shared_lock<std::shared_timed_mutex> frame_lock(frame_mutex_);
+    // Every request goes, so drop the index at once rather than erasing from it per request
+    for (V_TimeToTransformableRequest & requests : transformable_requests_by_frame_) {
+      requests.clear();
     }
-
-    if (frame->insertData(
-        TransformStorage(
-          stamp, transform_in.getRotation(),
-          transform_in.getOrigin(), lookupOrInsertFrameNumber(stripped_frame_id), frame_number)))
-    {
-      frame_authority_[frame_number] = authority;
-    } else {
-      std::string stamp_str = displayTimePoint(stamp);
-      CONSOLE_BRIDGE_logWarn(
-        "TF_OLD_DATA ignoring data from the past for frame %s at time %s according to authority"
-        " %s\nPossible reasons are listed at http://wiki.ros.org/tf/Errors%%20explained",
-        stripped_child_frame_id.c_str(), stamp_str.c_str(), authority.c_str());
-      return false;
+    num_indexed_requests_ = 0;
+    num_stale_indexed_requests_ = 0;
+    for (size_t slot = 0; slot < transformable_request_slots_.size(); ++slot) {
+      TransformableRequest & req = transformable_request_slots_[slot];
+      if (req.request_handle == 0) {
+        continue;
+      }
+      if (num_ready == ready.size()) {
+        ready.emplace_back();
+      }
+      ReadyRequest & ready_request = ready[num_ready++];
+      ready_request.request_handle = req.request_handle;
+      ready_request.target_frame.assign(
+        req.target_id != 0 ? lookupFrameString(req.target_id) : req.target_string);
+      ready_request.source_frame.assign(
+        req.source_id != 0 ? lookupFrameString(req.source_id) : req.source_string);
+      ready_request.time = req.time;
+      ready_request.result = TransformFailure;
+      releaseTransformableRequest(slot, ready_request.cb, false);
     }
   }
+  callReadyRequests(lock, ready, num_ready);
+}
 
-  testTransformableRequests();
+bool BufferCore::setRetentionPolicy(const std::string & frame_id, const RetentionPolicy & policy)
+{
+  std::string stripped_buffer;
+  const std::string & stripped_frame_id = stripSlash(frame_id, stripped_buffer);
+  if (stripped_frame_id.empty()) {
+    CONSOLE_BRIDGE_logError("Ignoring retention policy because frame_id not set");
+    return false;
+  }
 
+  std::unique_lock<std::shared_timed_mutex> lock(frame_mutex_);
+  CompactFrameID frame_number = lookupOrInsertFrameNumber(stripped_frame_id);
+  retention_policies_[frame_number] = policy;
+  applyRetentionPolicyNoLock(frame_number);
   return true;
 }
 
-TimeCacheInterfacePtr BufferCore::allocateFrame(CompactFrameID cfid, bool is_static)
+void BufferCore::setDefaultRetentionPolicy(const RetentionPolicy & policy)
 {
-  TimeCacheInterfacePtr frame_ptr = frames_[cfid];
-  if (is_static) {
-    frames_[cfid] = TimeCacheInterfacePtr(new StaticCache());
-  } else {
-    frames_[cfid] = TimeCacheInterfacePtr(new TimeCache(cache_time_));
+  std::unique_lock<std::shared_timed_mutex> lock(frame_mutex_);
+  default_retention_policy_ = policy;
+  for (CompactFrameID frame_number = 1; frame_number < frames_.size(); ++frame_number) {
+    if (retention_policies_.find(frame_number) == retention_policies_.end()) {
+      applyRetentionPolicyNoLock(frame_number);
+    }
   }
+}
 
-  return frames_[cfid];
+const RetentionPolicy & BufferCore::getRetentionPolicyNoLock(CompactFrameID frame_number) const
+{
+  auto policy = retention_policies_.find(frame_number);
+  return policy != retention_policies_.end() ? policy->second : default_retention_policy_;
 }
 
-enum WalkEnding
+void BufferCore::applyRetentionPolicyNoLock(CompactFrameID frame_number)
 {
-  Identity,
-  TargetParentOfSource,
-  SourceParentOfTarget,
-  FullPath,
-};
+  if (frame_types_[frame_number] != FrameType::Dynamic) {
+    return;
+  }
+  TimeCacheInterface * cache = frames_[frame_number].get();
+  size_t previous_length = cache->getListLength();
+  cache->setRetentionPolicy(getRetentionPolicyNoLock(frame_number));
+  sample_count_ += cache->getListLength() - previous_length;
+  bumpFrameVersion(frame_number);
+}
 
-// TODO(anyone): for Jade: Merge walkToTopParent functions; this is now a stub to preserve ABI
-template<typename F>
-tf2::TF2Error BufferCore::walkToTopParent(
-  F & f, TimePoint time, CompactFrameID target_id,
-  CompactFrameID source_id,
-  std::string * error_string) const
+void BufferCore::setMemoryBudget(size_t bytes)
 {
-  return walkToTopParent(f, time, target_id, source_id, error_string, NULL);
+  std::unique_lock<std::shared_timed_mutex> lock(frame_mutex_);
+  memory_budget_ = bytes;
+  enforceMemoryBudgetNoLock();
 }
 
-template<typename F>
-tf2::TF2Error BufferCore::walkToTopParent(
-  F & f, TimePoint time, CompactFrameID target_id,
-  CompactFrameID source_id, std::string * error_string, std::vector<CompactFrameID>
-  * frame_chain) const
+void BufferCore::reserve(const BufferCoreReservation & reservation)
 {
-  if (frame_chain) {
-    frame_chain->clear();
+  {
+    std::unique_lock<std::shared_timed_mutex> lock(frame_mutex_);
+    // Frame 0 is NO_PARENT
+    size_t frames = reservation.frames + 1;
+    frames_.reserve(frames);
+    frame_types_.reserve(frames);
+    frame_parents_.reserve(frames);
+    reparent_stamps_.reserve(frames);
+    static_transforms_.reserve(frames);
+    static_segments_.reserve(frames);
+    time_caches_.reserve(frames);
+    frameIDs_.reserve(frames);
+    frame_authorities_.reserve(frames);
+
+    sample_reservation_ = std::max(sample_reservation_, reservation.samples_per_frame);
+    for (size_t i = 1; i < frames_.size(); ++i) {
+      if (frame_types_[i] == FrameType::Dynamic) {
+        frames_[i]->reserve(sample_reservation_);
+      }
+    }
   }
 
-  // Short circuit if zero length transform to allow lookups on non existant links
-  if (source_id == target_id) {
-    f.finalize(Identity, time);
-    return tf2::TF2Error::NO_ERROR;
+  const size_t requests = reservation.transformable_requests;
+  std::lock_guard<std::mutex> lock(transformable_requests_mutex_);
+  transformable_request_slots_.reserve(requests);
+  free_request_slots_.reserve(requests);
+  transformable_candidates_.reserve(requests);
+  ready_requests_.reserve(requests);
+  if (transformable_requests_by_frame_.size() < reservation.frames + 1) {
+    transformable_requests_by_frame_.resize(reservation.frames + 1);
   }
+  for (V_TimeToTransformableRequest & by_frame : transformable_requests_by_frame_) {
+    by_frame.reserve(requests);
+  }
+}
 
-  // If getting the latest get the latest common time
-  if (time == TimePointZero) {
-    tf2::TF2Error retval = getLatestCommonTime(target_id, source_id, time, error_string);
-    if (retval != tf2::TF2Error::NO_ERROR) {
-      return retval;
+BufferCoreStats BufferCore::getStats() const
+{
+  std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+  BufferCoreStats stats;
+  for (size_t i = 1; i < frames_.size(); ++i) {
+    if (frame_types_[i] != FrameType::Unallocated) {
+      ++stats.frame_count;
+    }
+    if (frame_types_[i] == FrameType::Dynamic) {
+      stats.reserved_bytes += frames_[i]->getMemoryUsage();
     }
   }
+  stats.sample_count = sample_count_;
+  stats.sample_bytes = sample_count_ * sizeof(TransformStorage);
+  stats.memory_budget = memory_budget_;
+  stats.evicted_samples = evicted_samples_;
+  return stats;
+}
 
-  // Walk the tree to its root from the source frame, accumulating the transform
-  CompactFrameID frame = source_id;
-  CompactFrameID top_parent = frame;
-  uint32_t depth = 0;
-
-  std::string extrapolation_error_string;
-  bool extrapolation_might_have_occurred = false;
-
-  while (frame != 0) {
-    TimeCacheInterfacePtr cache = getFrame(frame);
-    if (frame_chain) {
-      frame_chain->push_back(frame);
-    }
+namespace
+{
 
-    if (!cache) {
-      // There will be no cache for the very root of the tree
-      top_parent = frame;
-      break;
-    }
+template<typename T, typename Allocator>
+size_t vectorBytes(const std::vector<T, Allocator> & v)
+{
+  return v.capacity() * sizeof(T);
+}
 
-    CompactFrameID parent = f.gather(cache, time, &extrapolation_error_string);
-    if (parent == 0) {
-      // Just break out here... there may still be a path from source -> target
-      top_parent = frame;
-      extrapolation_might_have_occurred = true;
-      break;
-    }
+/// Nothing for names that fit the small string buffer
+size_t stringBytes(const std::string & s)
+{
+  static const size_t inline_capacity = std::string().capacity();
+  return s.capacity() > inline_capacity ? s.capacity() + 1 : 0;
+}
 
-    // Early out... target frame is a direct parent of the source frame
-    if (frame == target_id) {
-      f.finalize(TargetParentOfSource, time);
-      return tf2::TF2Error::NO_ERROR;
-    }
+/// The bucket array of a hash map
+template<typename Map>
+size_t bucketBytes(const Map & map)
+{
+  return map.bucket_count() * sizeof(void *);
+}
 
-    f.accum(true);
+/// The buckets and nodes of a hash map allocating from the heap, each node holding an element,
+/// a link to the next one and its hash
+template<typename Map>
+size_t hashMapBytes(const Map & map)
+{
+  return bucketBytes(map) +
+         map.size() * (sizeof(typename Map::value_type) + sizeof(void *) + sizeof(size_t));
+}
 
-    top_parent = frame;
-    frame = parent;
+}  // namespace
 
-    ++depth;
-    if (depth > MAX_GRAPH_DEPTH) {
-      if (error_string) {
-        std::stringstream ss;
-        ss << "The tf tree is invalid because it contains a loop." << std::endl <<
-          allFramesAsStringNoLock() << std::endl;
-        *error_string = ss.str();
+BufferCoreMemoryStats BufferCore::memoryStats() const
+{
+  BufferCoreMemoryStats stats;
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+    for (size_t i = 1; i < frames_.size(); ++i) {
+      if (frame_types_[i] != FrameType::Unallocated) {
+        stats.frame_history_bytes += frames_[i]->getMemoryUsage();
       }
-      return tf2::TF2Error::LOOKUP_ERROR;
     }
-  }
-
-  // Now walk to the top parent from the target frame, accumulating its transform
-  frame = target_id;
-  depth = 0;
-  std::vector<CompactFrameID> reverse_frame_chain;
 
-  while (frame != top_parent) {
-    TimeCacheInterfacePtr cache = getFrame(frame);
-    if (frame_chain) {
-      reverse_frame_chain.push_back(frame);
+    size_t & table = stats.frame_table_bytes;
+    table += vectorBytes(frames_) + vectorBytes(frame_types_) + vectorBytes(frame_parents_) +
+      vectorBytes(static_transforms_) + vectorBytes(reparent_stamps_) +
+      vectorBytes(time_caches_) + vectorBytes(static_segments_) +
+      vectorBytes(frame_authorities_) + vectorBytes(authorities_);
+    table += frame_versions_.size() * sizeof(std::atomic<uint64_t>);
+    table += frameIDs_reverse_.size() * sizeof(std::string);
+    for (const std::string & name : frameIDs_reverse_) {
+      // frameIDs_ holds a copy of every name as its key
+      table += 2 * stringBytes(name);
     }
-
-    if (!cache) {
-      break;
+    table += hashMapBytes(frameIDs_);
+    for (const std::string & authority : authorities_) {
+      table += 2 * stringBytes(authority);
     }
+    table += hashMapBytes(authority_ids_) + hashMapBytes(retention_policies_);
 
-    CompactFrameID parent = f.gather(cache, time, error_string);
-    if (parent == 0) {
-      if (error_string) {
-        std::stringstream ss;
-        ss << *error_string << ", when looking up transform from frame [" << lookupFrameString(
+    if (lookup_cache_) {
+      stats.lookup_cache_bytes += lookup_cache_->getMemoryUsage();
+    }
+    std::shared_lock<std::shared_timed_mutex> chains_lock(frame_chains_mutex_);
+    stats.lookup_cache_bytes += hashMapBytes(frame_chains_);
+    for (const auto & chain : frame_chains_) {
+      // The control block allocated along with the chain is not counted
+      stats.lookup_cache_bytes += sizeof(FrameChain) + stringBytes(chain.second->target_frame_) +
+        stringBytes(chain.second->source_frame_) + vectorBytes(chain.second->source_links_) +
+        vectorBytes(chain.second->target_links_);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(transformable_requests_mutex_);
+    size_t & requests = stats.transformable_request_bytes;
+    requests += vectorBytes(transformable_request_slots_) + vectorBytes(free_request_slots_);
+    for (const TransformableRequest & request : transformable_request_slots_) {
+      requests += stringBytes(request.target_string) + stringBytes(request.source_string) +
+        vectorBytes(request.indexed_frames);
+    }
+    requests += vectorBytes(transformable_requests_by_frame_);
+    for (const V_TimeToTransformableRequest & by_frame : transformable_requests_by_frame_) {
+      requests += vectorBytes(by_frame);
+    }
+    requests += vectorBytes(transformable_candidates_) + vectorBytes(ready_requests_);
+  }
+  {
+    std::lock_guard<std::mutex> lock(frame_subscriptions_mutex_);
+    stats.callback_bytes += vectorBytes(frame_subscriptions_) +
+      hashMapBytes(frame_subscription_frames_);
+    for (const std::vector<FrameSubscription> & subscriptions : frame_subscriptions_) {
+      stats.callback_bytes += vectorBytes(subscriptions) +
+        subscriptions.size() * sizeof(FrameCallback);
+    }
+  }
+  return stats;
+}
+
+void BufferCore::setInsertErrorLogPeriod(tf2::Duration period)
+{
+  insert_error_log_.setPeriod(period);
+}
+
+std::vector<InsertErrorCount> BufferCore::getInsertErrors() const
+{
+  return insert_error_log_.getCounts();
+}
+
+void BufferCore::setLookupCacheCapacity(size_t capacity)
+{
+  std::unique_lock<std::shared_timed_mutex> lock(frame_mutex_);
+  if (capacity == 0) {
+    lookup_cache_.reset();
+  } else if (!lookup_cache_ || lookup_cache_->capacity() < capacity) {
+    lookup_cache_.reset(new LookupCache(capacity));
+  }
+}
+
+void BufferCore::setMetricsEnabled(bool enabled)
+{
+  std::lock_guard<std::mutex> lock(metrics_mutex_);
+  if (enabled && !metrics_) {
+    metrics_.reset(new BufferCoreMetricsRecorder());
+  }
+  metrics_enabled_.store(enabled, std::memory_order_release);
+}
+
+BufferCoreMetrics BufferCore::getMetrics() const
+{
+  BufferCoreMetrics metrics;
+  {
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    if (metrics_) {
+      metrics_->collect(metrics);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(transformable_requests_mutex_);
+    metrics.pending_transformable_requests = num_transformable_requests_;
+  }
+  std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+  if (lookup_cache_) {
+    metrics.lookup_cache_hits = lookup_cache_->getHits();
+    metrics.lookup_cache_misses = lookup_cache_->getMisses();
+  }
+  for (size_t i = 1; i < frames_.size(); ++i) {
+    if (frame_types_[i] == FrameType::Dynamic) {
+      metrics.history_lengths[frameIDs_reverse_[i]] = frames_[i]->getListLength();
+    }
+  }
+  return metrics;
+}
+
+void BufferCore::resetMetrics()
+{
+  std::lock_guard<std::mutex> lock(metrics_mutex_);
+  if (metrics_) {
+    metrics_->reset();
+  }
+}
+
+bool BufferCore::saveSnapshot(const std::string & path) const
+{
+  snapshot::Header header;
+  std::memcpy(header.magic, snapshot::MAGIC, sizeof(header.magic));
+  header.version = snapshot::VERSION;
+  header.sample_size = sizeof(snapshot::Sample);
+
+  // Copy everything out first, so writers are not blocked while writing the file
+  std::vector<snapshot::Frame> frames;
+  std::string names;
+  std::vector<snapshot::Sample> samples;
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+    frames.resize(frames_.size() - 1);
+    std::vector<TransformStorage> data;
+    for (CompactFrameID frame_number = 1; frame_number < frames_.size(); ++frame_number) {
+      snapshot::Frame & frame = frames[frame_number - 1];
+      const std::string & authority = lookupAuthority(frame_number);
+      frame.name_offset = names.size();
+      frame.name_length = static_cast<uint32_t>(frameIDs_reverse_[frame_number].size());
+      names += frameIDs_reverse_[frame_number];
+      frame.authority_length = static_cast<uint32_t>(authority.size());
+      names += authority;
+      frame.type = static_cast<uint32_t>(frame_types_[frame_number]);
+      frame.reserved = 0;
+
+      data.clear();
+      if (frame_types_[frame_number] != FrameType::Unallocated) {
+        frames_[frame_number]->copySamples(data);
+      }
+      frame.first_sample = samples.size();
+      frame.sample_count = data.size();
+      for (const TransformStorage & storage : data) {
+        snapshot::Sample sample;
+        sample.stamp = storage.stamp_.time_since_epoch().count();
+        for (int i = 0; i < 4; ++i) {
+          sample.rotation[i] = storage.rotation_[i];
+        }
+        for (int i = 0; i < 3; ++i) {
+          sample.translation[i] = storage.translation_[i];
+        }
+        sample.frame_id = storage.frame_id_;
+        sample.child_frame_id = storage.child_frame_id_;
+        samples.push_back(sample);
+      }
+    }
+  }
+  header.frame_count = frames.size();
+  header.names_size = snapshot::paddedSize(names.size());
+  header.sample_count = samples.size();
+  names.resize(header.names_size, '\0');
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(
+    reinterpret_cast<const char *>(frames.data()), frames.size() * sizeof(snapshot::Frame));
+  file.write(names.data(), names.size());
+  file.write(
+    reinterpret_cast<const char *>(samples.data()), samples.size() * sizeof(snapshot::Sample));
+  file.close();
+  if (!file) {
+    CONSOLE_BRIDGE_logError("Failed to write a tf2 snapshot to %s", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool BufferCore::loadSnapshot(const std::string & path)
+{
+  // Read the whole file at once, the samples are then inserted straight out of it
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    CONSOLE_BRIDGE_logError("Failed to open the tf2 snapshot %s", path.c_str());
+    return false;
+  }
+  std::vector<char> contents(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(contents.data(), contents.size());
+  if (!file) {
+    CONSOLE_BRIDGE_logError("Failed to read the tf2 snapshot %s", path.c_str());
+    return false;
+  }
+
+  snapshot::Header header;
+  bool valid = contents.size() >= sizeof(header);
+  if (valid) {
+    std::memcpy(&header, contents.data(), sizeof(header));
+    valid = std::memcmp(header.magic, snapshot::MAGIC, sizeof(header.magic)) == 0 &&
+      header.version == snapshot::VERSION && header.sample_size == sizeof(snapshot::Sample) &&
+      header.frame_count < contents.size() / sizeof(snapshot::Frame) &&
+      header.names_size < contents.size() &&
+      header.sample_count < contents.size() / sizeof(snapshot::Sample) &&
+      contents.size() == sizeof(header) + header.frame_count * sizeof(snapshot::Frame) +
+      header.names_size + header.sample_count * sizeof(snapshot::Sample);
+  }
+  const char * frames_begin = contents.data() + sizeof(header);
+  const char * names_begin = frames_begin + header.frame_count * sizeof(snapshot::Frame);
+  const char * samples_begin = names_begin + header.names_size;
+
+  // Check the frame table before touching the buffer
+  std::vector<snapshot::Frame> frames(valid ? header.frame_count : 0);
+  std::vector<std::string> frame_names(frames.size() + 1);
+  std::vector<std::string> authorities(frames.size() + 1);
+  for (size_t i = 0; valid && i < frames.size(); ++i) {
+    snapshot::Frame & frame = frames[i];
+    std::memcpy(&frame, frames_begin + i * sizeof(frame), sizeof(frame));
+    valid = frame.name_offset <= header.names_size &&
+      static_cast<uint64_t>(frame.name_length) + frame.authority_length <=
+      header.names_size - frame.name_offset &&
+      frame.first_sample <= header.sample_count &&
+      frame.sample_count <= header.sample_count - frame.first_sample &&
+      frame.type <= static_cast<uint32_t>(FrameType::Dynamic) && frame.name_length > 0;
+    if (valid) {
+      frame_names[i + 1].assign(names_begin + frame.name_offset, frame.name_length);
+      authorities[i + 1].assign(
+        names_begin + frame.name_offset + frame.name_length, frame.authority_length);
+    }
+  }
+  if (!valid) {
+    CONSOLE_BRIDGE_logError("%s is not a valid tf2 snapshot", path.c_str());
+    return false;
+  }
+
+  bool topology_changed = false;
+  std::vector<CompactFrameID> updated_frames;
+  {
+    std::unique_lock<std::shared_timed_mutex> lock(frame_mutex_);
+    for (size_t i = 0; i < frames.size(); ++i) {
+      const snapshot::Frame & frame = frames[i];
+      const std::string & child_frame_id = frame_names[i + 1];
+      bool is_static = frame.type == static_cast<uint32_t>(FrameType::Static);
+      bool inserted = false;
+      CompactFrameID frame_number = 0;
+      for (uint64_t j = 0; j < frame.sample_count; ++j) {
+        snapshot::Sample sample;
+        std::memcpy(
+          &sample, samples_begin + (frame.first_sample + j) * sizeof(sample), sizeof(sample));
+        if (sample.frame_id == 0 || sample.frame_id > frames.size()) {
+          continue;
+        }
+        tf2::Transform transform(
+          tf2::Quaternion(
+            sample.rotation[0], sample.rotation[1], sample.rotation[2], sample.rotation[3]),
+          tf2::Vector3(sample.translation[0], sample.translation[1], sample.translation[2]));
+        const std::string & frame_id = frame_names[sample.frame_id];
+        if (validateTransform(transform, frame_id, child_frame_id, authorities[i + 1]) &&
+          insertTransformNoLock(
+            transform, frame_id, child_frame_id,
+            TimePoint(std::chrono::nanoseconds(sample.stamp)), authorities[i + 1], is_static,
+            frame_number, topology_changed))
+        {
+          inserted = true;
+        }
+      }
+      if (inserted) {
+        updated_frames.push_back(frame_number);
+      }
+    }
+    if (topology_changed) {
+      ++topology_version_;
+    }
+  }
+
+  if (!updated_frames.empty()) {
+    notifyFrameSubscribers(updated_frames);
+    testTransformableRequests(updated_frames, topology_changed);
+  }
+  return true;
+}
+
+bool BufferCore::setTransform(
+  const geometry_msgs::msg::TransformStamped & transform,
+  const std::string & authority, bool is_static)
+{
+  tf2::Transform tf2_transform;
+  transformMsgToTF2(transform.transform, tf2_transform);
+  return recordCheck(
+    activeMetrics(), BufferCoreCall::Insert, TF2Error::INVALID_ARGUMENT_ERROR, [&]() {
+      return setTransformImpl(
+        tf2_transform, transform.header.frame_id, transform.child_frame_id,
+        stampToTimePoint(transform.header.stamp), authority, is_static);
+    });
+}
+
+bool BufferCore::setTransform(
+  const tf2::Transform & transform, const std::string & frame_id,
+  const std::string & child_frame_id, TimePoint stamp,
+  const std::string & authority, bool is_static)
+{
+  return recordCheck(
+    activeMetrics(), BufferCoreCall::Insert, TF2Error::INVALID_ARGUMENT_ERROR, [&]() {
+      return setTransformImpl(transform, frame_id, child_frame_id, stamp, authority, is_static);
+    });
+}
+
+bool BufferCore::setTransforms(
+  const std::vector<geometry_msgs::msg::TransformStamped> & transforms,
+  const std::string & authority, bool is_static)
+{
+  return recordCheck(
+    activeMetrics(), BufferCoreCall::Insert, TF2Error::INVALID_ARGUMENT_ERROR, [&]() {
+      bool all_inserted = true;
+      bool topology_changed = false;
+      std::vector<CompactFrameID> updated_frames;
+      // Insert what only adds samples first, then the rest with the lock held exclusively
+      std::vector<size_t> deferred;
+      std::string frame_id_buffer;
+      std::string child_frame_id_buffer;
+      // Check the values of the whole batch at once, the frame ids one at a time below
+      std::vector<tf2::Transform> tf2_transforms(transforms.size());
+      std::vector<uint8_t> value_errors(transforms.size());
+      {
+        TransformValues values(transforms.size());
+        for (size_t i = 0; i < transforms.size(); ++i) {
+          transformMsgToTF2(transforms[i].transform, tf2_transforms[i]);
+          values.set(i, tf2_transforms[i]);
+        }
+        values.check(value_errors.data());
+      }
+      {
+        std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+        for (size_t i = 0; i < transforms.size(); ++i) {
+          const geometry_msgs::msg::TransformStamped & transform = transforms[i];
+          const tf2::Transform & tf2_transform = tf2_transforms[i];
+          const std::string & stripped_frame_id = stripSlash(
+            transform.header.frame_id, frame_id_buffer);
+          const std::string & stripped_child_frame_id = stripSlash(
+            transform.child_frame_id, child_frame_id_buffer);
+          if (!validateTransform(
+              tf2_transform, stripped_frame_id, stripped_child_frame_id, authority,
+              value_errors[i]))
+          {
+            all_inserted = false;
+            continue;
+          }
+          TimePoint stamp = stampToTimePoint(transform.header.stamp);
+          CompactFrameID frame_number;
+          bool inserted;
+          if (!tryInsertSampleSharedLock(
+              tf2_transform, stripped_frame_id, stripped_child_frame_id, stamp, authority,
+              is_static, frame_number, inserted))
+          {
+            deferred.push_back(i);
+            continue;
+          }
+          if (inserted) {
+            updated_frames.push_back(frame_number);
+            TF2_TRACEPOINT(
+              set_transform, this, stripped_frame_id.c_str(), stripped_child_frame_id.c_str(),
+              stamp.time_since_epoch().count(), is_static);
+          } else {
+            all_inserted = false;
+          }
+        }
+      }
+      if (!deferred.empty()) {
+        TimedExclusiveLock lock(frame_mutex_, activeMetrics());
+        for (size_t i : deferred) {
+          const geometry_msgs::msg::TransformStamped & transform = transforms[i];
+          const tf2::Transform & tf2_transform = tf2_transforms[i];
+          const std::string & stripped_frame_id = stripSlash(
+            transform.header.frame_id, frame_id_buffer);
+          const std::string & stripped_child_frame_id = stripSlash(
+            transform.child_frame_id, child_frame_id_buffer);
+          TimePoint stamp = stampToTimePoint(transform.header.stamp);
+          CompactFrameID frame_number;
+          if (insertTransformNoLock(
+              tf2_transform, stripped_frame_id, stripped_child_frame_id, stamp, authority,
+              is_static, frame_number, topology_changed))
+          {
+            updated_frames.push_back(frame_number);
+            TF2_TRACEPOINT(
+              set_transform, this, stripped_frame_id.c_str(), stripped_child_frame_id.c_str(),
+              stamp.time_since_epoch().count(), is_static);
+          } else {
+            all_inserted = false;
+          }
+        }
+        if (topology_changed) {
+          ++topology_version_;
+        }
+      }
+
+      if (!updated_frames.empty()) {
+        std::sort(updated_frames.begin(), updated_frames.end());
+        updated_frames.erase(
+          std::unique(updated_frames.begin(), updated_frames.end()), updated_frames.end());
+        notifyFrameSubscribers(updated_frames);
+        testTransformableRequests(updated_frames, topology_changed);
+      }
+
+      return all_inserted;
+    });
+}
+
+bool BufferCore::loadTransforms(
+  const std::vector<geometry_msgs::msg::TransformStamped> & transforms,
+  const std::string & authority, bool is_static)
+{
+  if (is_static) {
+    // Static frames keep a single sample, there is no history to append to
+    return setTransforms(transforms, authority, true);
+  }
+  return recordCheck(
+    activeMetrics(), BufferCoreCall::Insert, TF2Error::INVALID_ARGUMENT_ERROR, [&]() {
+      // The frame ids of a child frame, resolved again only when its parent changes
+      struct Link
+      {
+        std::string frame_id;
+        std::string stripped_frame_id;
+        std::string stripped_child_frame_id;
+        CompactFrameID parent = 0;
+        CompactFrameID child = 0;
+        std::vector<TransformStorage> samples;
+      };
+      std::unordered_map<std::string, size_t> link_indices;
+      std::vector<Link> links;
+      bool all_inserted = true;
+      bool topology_changed = false;
+      bool static_changed = false;
+      std::vector<CompactFrameID> updated_frames;
+      {
+        TimedExclusiveLock lock(frame_mutex_, activeMetrics());
+        for (const geometry_msgs::msg::TransformStamped & transform : transforms) {
+          auto it = link_indices.find(transform.child_frame_id);
+          if (it == link_indices.end()) {
+            it = link_indices.emplace(transform.child_frame_id, links.size()).first;
+            links.emplace_back();
+            links.back().stripped_child_frame_id = stripSlash(transform.child_frame_id);
+          }
+          Link & link = links[it->second];
+          if (link.parent == 0 || link.frame_id != transform.header.frame_id) {
+            link.frame_id = transform.header.frame_id;
+            link.stripped_frame_id = stripSlash(transform.header.frame_id);
+            link.parent = 0;
+          }
+          tf2::Transform tf2_transform;
+          transformMsgToTF2(transform.transform, tf2_transform);
+          if (!validateTransform(
+              tf2_transform, link.stripped_frame_id, link.stripped_child_frame_id, authority))
+          {
+            all_inserted = false;
+            continue;
+          }
+          if (link.child == 0) {
+            link.child = lookupOrInsertFrameNumber(link.stripped_child_frame_id);
+            if (frame_types_[link.child] != FrameType::Dynamic) {
+              static_changed |= frame_types_[link.child] == FrameType::Static;
+              allocateFrame(link.child, false);
+              topology_changed = true;
+            }
+          }
+          if (link.parent == 0) {
+            link.parent = lookupOrInsertFrameNumber(link.stripped_frame_id);
+          }
+          link.samples.emplace_back(
+            stampToTimePoint(transform.header.stamp), tf2_transform.getRotation(),
+            tf2_transform.getOrigin(), link.parent, link.child);
+        }
+
+        for (const Link & link : links) {
+          if (link.samples.empty()) {
+            continue;
+          }
+          const CompactFrameID frame_number = link.child;
+          TimeCacheInterface * frame = getFrame(frame_number);
+          // Record the parent changes inserting the samples one at a time would have recorded
+          CompactFrameID previous_parent = frame_parents_[frame_number];
+          TimePoint previous_latest = frame->getLatestTimestamp();
+          for (const TransformStorage & sample : link.samples) {
+            if (sample.frame_id_ != previous_parent) {
+              if (previous_parent != 0) {
+                reparent_stamps_[frame_number] = std::max(
+                  reparent_stamps_[frame_number], std::max(sample.stamp_, previous_latest));
+              }
+              topology_changed = true;
+            }
+            if (sample.stamp_ >= previous_latest) {
+              previous_latest = sample.stamp_;
+              previous_parent = sample.frame_id_;
+            }
+          }
+
+          const size_t previous_length = frame->getListLength();
+          const size_t rejected = frame->insertSorted(link.samples.data(), link.samples.size());
+          sample_count_ += frame->getListLength();
+          sample_count_ -= previous_length;
+          if (rejected > 0) {
+            insert_error_log_.report(
+              InsertError::OldData, link.stripped_child_frame_id, authority,
+              tf2::Transform::getIdentity(), link.samples.front().stamp_, rejected);
+            all_inserted = false;
+          }
+          if (rejected == link.samples.size()) {
+            continue;
+          }
+          bumpFrameVersion(frame_number);
+          frame_parents_[frame_number] = frame->getLatestTimeAndParent().second;
+          if (frame_authorities_[frame_number] == 0 ||
+            lookupAuthority(frame_number) != authority)
+          {
+            frame_authorities_[frame_number] = internAuthority(authority);
+          }
+          updated_frames.push_back(frame_number);
+        }
+        if (static_changed) {
+          updateStaticSegmentsNoLock();
+        }
+        if (memory_budget_ != 0) {
+          enforceMemoryBudgetNoLock();
+        }
+        if (topology_changed) {
+          ++topology_version_;
+        }
+      }
+
+      if (!updated_frames.empty()) {
+        notifyFrameSubscribers(updated_frames);
+        testTransformableRequests(updated_frames, topology_changed);
+      }
+      return all_inserted;
+    });
+}
+
+bool BufferCore::setTransformImpl(
+  const tf2::Transform & transform_in, const std::string & frame_id,
+  const std::string & child_frame_id, const TimePoint stamp,
+  const std::string & authority, bool is_static)
+{
+  std::string frame_id_buffer;
+  std::string child_frame_id_buffer;
+  const std::string & stripped_frame_id = stripSlash(frame_id, frame_id_buffer);
+  const std::string & stripped_child_frame_id = stripSlash(child_frame_id, child_frame_id_buffer);
+
+  if (!validateTransform(transform_in, stripped_frame_id, stripped_child_frame_id, authority)) {
+    return false;
+  }
+
+  CompactFrameID frame_number;
+  bool topology_changed = false;
+  bool inserted = false;
+  bool handled;
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+    handled = tryInsertSampleSharedLock(
+      transform_in, stripped_frame_id, stripped_child_frame_id, stamp, authority, is_static,
+      frame_number, inserted);
+  }
+  if (!handled) {
+    TimedExclusiveLock lock(frame_mutex_, activeMetrics());
+    inserted = insertTransformNoLock(
+      transform_in, stripped_frame_id, stripped_child_frame_id, stamp, authority, is_static,
+      frame_number, topology_changed);
+    if (topology_changed) {
+      ++topology_version_;
+    }
+  }
+  if (!inserted) {
+    return false;
+  }
+  TF2_TRACEPOINT(
+    set_transform, this, stripped_frame_id.c_str(), stripped_child_frame_id.c_str(),
+    stamp.time_since_epoch().count(), is_static);
+
+  notifyFrameSubscribers(&frame_number, 1);
+  testTransformableRequests(&frame_number, 1, topology_changed);
+
+  return true;
+}
+
+bool BufferCore::validateTransform(
+  const tf2::Transform & transform_in, const std::string & stripped_frame_id,
+  const std::string & stripped_child_frame_id, const std::string & authority) const
+{
+  // On the stack, inserting single transforms does not allocate
+  const tf2::Quaternion rotation = transform_in.getRotation();
+  double values[7] = {rotation.x(), rotation.y(), rotation.z(), rotation.w(),
+    transform_in.getOrigin().x(), transform_in.getOrigin().y(), transform_in.getOrigin().z()};
+  const batch::TransformArray array = {
+    {&values[0], &values[1], &values[2], &values[3]}, {&values[4], &values[5], &values[6]}};
+  uint8_t value_errors;
+  batch::checkTransforms(array, QUATERNION_NORMALIZATION_TOLERANCE, &value_errors, 1);
+  return validateTransform(
+    transform_in, stripped_frame_id, stripped_child_frame_id, authority, value_errors);
+}
+
+bool BufferCore::validateTransform(
+  const tf2::Transform & transform_in, const std::string & stripped_frame_id,
+  const std::string & stripped_child_frame_id, const std::string & authority,
+  uint8_t value_errors) const
+{
+  bool error_exists = false;
+  auto report = [&](InsertError error) {
+      insert_error_log_.report(
+        error, stripped_child_frame_id, authority, transform_in, TimePointZero);
+      error_exists = true;
+    };
+  if (stripped_child_frame_id == stripped_frame_id) {
+    report(InsertError::SelfTransform);
+  }
+  if (stripped_child_frame_id == "") {
+    report(InsertError::NoChildFrameId);
+  }
+  if (stripped_frame_id == "") {
+    report(InsertError::NoFrameId);
+  }
+  if (value_errors & batch::TRANSFORM_HAS_NAN) {
+    report(InsertError::NanInput);
+  }
+  if (value_errors & batch::TRANSFORM_DENORMALIZED) {
+    report(InsertError::DenormalizedQuaternion);
+  }
+  return !error_exists;
+}
+
+bool BufferCore::tryInsertSampleSharedLock(
+  const tf2::Transform & transform_in, const std::string & stripped_frame_id,
+  const std::string & stripped_child_frame_id, const TimePoint stamp,
+  const std::string & authority, bool is_static,
+  CompactFrameID & frame_number, bool & inserted)
+{
+  // Evicting for the memory budget touches other frames
+  if (is_static || memory_budget_ != 0) {
+    return false;
+  }
+  CompactFrameID child_number = lookupFrameNumber(stripped_child_frame_id);
+  if (child_number == 0 || frame_types_[child_number] != FrameType::Dynamic) {
+    return false;
+  }
+  CompactFrameID parent_number = lookupFrameNumber(stripped_frame_id);
+  if (parent_number == 0 || frame_parents_[child_number] != parent_number) {
+    return false;
+  }
+  if (frame_authorities_[child_number] == 0 || lookupAuthority(child_number) != authority) {
+    return false;
+  }
+
+  // Neither the latest parent nor anything else but the samples of the frame changes, which
+  // the cache guards on its own
+  TransformStorage storage(
+    stamp, transform_in.getRotation(), transform_in.getOrigin(), parent_number, child_number);
+  int64_t length_change;
+  frame_number = child_number;
+  inserted = frames_[child_number]->insertDataCounted(storage, length_change);
+  if (inserted) {
+    sample_count_ += length_change;
+    bumpFrameVersion(child_number);
+  } else {
+    insert_error_log_.report(
+      InsertError::OldData, stripped_child_frame_id, authority, transform_in, stamp);
+  }
+  return true;
+}
+
+bool BufferCore::insertTransformNoLock(
+  const tf2::Transform & transform_in, const std::string & stripped_frame_id,
+  const std::string & stripped_child_frame_id, const TimePoint stamp,
+  const std::string & authority, bool is_static,
+  CompactFrameID & frame_number, bool & topology_changed)
+{
+  frame_number = lookupOrInsertFrameNumber(stripped_child_frame_id);
+  // Overwrite TimeCacheInterface type with a current input
+  FrameType type = is_static ? FrameType::Static : FrameType::Dynamic;
+  FrameType previous_type = frame_types_[frame_number];
+  TimeCacheInterface * frame = getFrame(frame_number);
+  if (previous_type != type) {
+    frame = allocateFrame(frame_number, is_static);
+    topology_changed = true;
+  }
+
+  CompactFrameID parent_number = lookupOrInsertFrameNumber(stripped_frame_id);
+  CompactFrameID previous_parent = frame_parents_[frame_number];
+  TransformStorage storage(
+    stamp, transform_in.getRotation(), transform_in.getOrigin(), parent_number, frame_number);
+  size_t previous_length = is_static ? 0 : frame->getListLength();
+  TimePoint previous_latest = is_static ? TimePointZero : frame->getLatestTimestamp();
+  if (frame->insertData(storage)) {
+    bumpFrameVersion(frame_number);
+    if (!is_static) {
+      sample_count_ += frame->getListLength() - previous_length;
+      // Between the newest sample of the old parent and the oldest of the new one the parent
+      // depends on the sample picked, so only later times are known to have the latest parent
+      if (previous_parent != 0 && parent_number != previous_parent) {
+        reparent_stamps_[frame_number] = std::max(
+          reparent_stamps_[frame_number], std::max(stamp, previous_latest));
+      }
+    }
+    // Any reparenting, even in the past, may change the chains of pending requests
+    if (parent_number != previous_parent) {
+      topology_changed = true;
+    }
+    if (is_static) {
+      static_transforms_[frame_number] = storage;
+    }
+    frame_parents_[frame_number] = frame->getLatestTimeAndParent().second;
+    if (is_static || previous_type == FrameType::Static) {
+      updateStaticSegmentsNoLock();
+    }
+    if (frame_authorities_[frame_number] == 0 || lookupAuthority(frame_number) != authority) {
+      frame_authorities_[frame_number] = internAuthority(authority);
+    }
+    if (memory_budget_ != 0) {
+      enforceMemoryBudgetNoLock();
+    }
+  } else {
+    insert_error_log_.report(
+      InsertError::OldData, stripped_child_frame_id, authority, transform_in, stamp);
+    return false;
+  }
+
+  return true;
+}
+
+TimeCacheInterface * BufferCore::allocateFrame(CompactFrameID cfid, bool is_static)
+{
+  if (frame_types_[cfid] == FrameType::Dynamic) {
+    sample_count_ -= frames_[cfid]->getListLength();
+  }
+  time_caches_[cfid] = nullptr;
+  if (is_static) {
+    frames_[cfid] = TimeCacheInterfacePtr(new StaticCache());
+    frame_types_[cfid] = FrameType::Static;
+  } else {
+    const RetentionPolicy & policy = getRetentionPolicyNoLock(cfid);
+    if (policy.compress) {
+      frames_[cfid] = TimeCacheInterfacePtr(new CompressedCache(cache_time_));
+    } else if (policy.single_precision) {
+      frames_[cfid] = TimeCacheInterfacePtr(new Float32TimeCache(cache_time_));
+    } else if (policy.single_writer) {
+      frames_[cfid] = TimeCacheInterfacePtr(new SingleWriterCache(cache_time_));
+    } else {
+      TimeCache * cache = new TimeCache(cache_time_);
+      frames_[cfid] = TimeCacheInterfacePtr(cache);
+      time_caches_[cfid] = cache;
+    }
+    frames_[cfid]->setRetentionPolicy(policy);
+    if (sample_reservation_ > 0) {
+      frames_[cfid]->reserve(sample_reservation_);
+    }
+    frame_types_[cfid] = FrameType::Dynamic;
+  }
+  frame_parents_[cfid] = 0;
+  reparent_stamps_[cfid] = TimePointZero;
+
+  return frames_[cfid].get();
+}
+
+void BufferCore::enforceMemoryBudgetNoLock()
+{
+  if (memory_budget_ == 0) {
+    return;
+  }
+  const size_t max_samples = memory_budget_ / sizeof(TransformStorage);
+  while (sample_count_ > max_samples) {
+    // Trim the longest history down towards the next longest, so the frames that are published
+    // fastest give up their oldest data first and the histories converge on the same length
+    CompactFrameID longest = 0;
+    size_t longest_length = 0;
+    size_t next_length = 0;
+    for (size_t i = 1; i < frames_.size(); ++i) {
+      if (frame_types_[i] != FrameType::Dynamic) {
+        continue;
+      }
+      size_t length = frames_[i]->getListLength();
+      if (length > longest_length) {
+        next_length = longest_length;
+        longest_length = length;
+        longest = static_cast<CompactFrameID>(i);
+      } else if (length > next_length) {
+        next_length = length;
+      }
+    }
+    if (longest == 0) {
+      break;
+    }
+    size_t excess = sample_count_ - max_samples;
+    size_t dropped = frames_[longest]->dropOldest(
+      std::min(excess, std::max<size_t>(1, longest_length - next_length)));
+    if (dropped == 0) {
+      // Every frame is down to its newest sample
+      break;
+    }
+    bumpFrameVersion(longest);
+    sample_count_ -= dropped;
+    evicted_samples_ += dropped;
+  }
+}
+
+void BufferCore::updateStaticSegmentsNoLock()
+{
+  enum State : uint8_t {Pending, OnPath, Done};
+  std::vector<State> state(frames_.size(), Pending);
+  std::vector<CompactFrameID> path;
+  for (CompactFrameID frame = 1; frame < frames_.size(); ++frame) {
+    // Climb to the first frame that is not static or whose segment is already known
+    path.clear();
+    CompactFrameID top = frame;
+    while (frame_types_[top] == FrameType::Static && state[top] == Pending &&
+      path.size() <= MAX_GRAPH_DEPTH)
+    {
+      state[top] = OnPath;
+      path.push_back(top);
+      top = static_transforms_[top].frame_id_;
+    }
+    // Frames in a loop keep their own transform, walkToTopParent() reports the loop
+    bool loop = path.size() > MAX_GRAPH_DEPTH ||
+      (frame_types_[top] == FrameType::Static && state[top] == OnPath);
+
+    // Compose the segments on the way back down
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+      const TransformStorage & link = static_transforms_[*it];
+      TransformStorage & segment = static_segments_[*it];
+      if (loop || frame_types_[link.frame_id_] != FrameType::Static) {
+        segment = link;
+      } else {
+        const TransformStorage & above = static_segments_[link.frame_id_];
+        segment.rotation_ = above.rotation_ * link.rotation_;
+        segment.translation_ = quatRotate(above.rotation_, link.translation_) + above.translation_;
+        segment.frame_id_ = above.frame_id_;
+        segment.child_frame_id_ = *it;
+      }
+      state[*it] = Done;
+    }
+  }
+}
+
+enum WalkEnding
+{
+  Identity,
+  TargetParentOfSource,
+  SourceParentOfTarget,
+  FullPath,
+};
+
+namespace
+{
+
+/// Gather from the cache of a dynamic frame, calling time_cache directly if it is set
+template<typename F>
+inline CompactFrameID gatherDynamic(
+  F & f, TimeCacheInterface * cache, TimeCache * time_cache, TimePoint time,
+  std::string * error_string)
+{
+  return time_cache ? f.gather(time_cache, time, error_string) :
+         f.gather(cache, time, error_string);
+}
+
+}  // namespace
+
+// TODO(anyone): for Jade: Merge walkToTopParent functions; this is now a stub to preserve ABI
+template<typename F>
+tf2::TF2Error BufferCore::walkToTopParent(
+  F & f, TimePoint time, CompactFrameID target_id,
+  CompactFrameID source_id,
+  std::string * error_string) const
+{
+  return walkToTopParent(f, time, target_id, source_id, error_string, NULL);
+}
+
+template<typename F>
+tf2::TF2Error BufferCore::walkToTopParent(
+  F & f, TimePoint time, CompactFrameID target_id,
+  CompactFrameID source_id, std::string * error_string, std::vector<CompactFrameID>
+  * frame_chain) const
+{
+  if (frame_chain) {
+    frame_chain->clear();
+  }
+
+  // Short circuit if zero length transform to allow lookups on non existant links
+  if (source_id == target_id) {
+    f.finalize(Identity, time);
+    return tf2::TF2Error::NO_ERROR;
+  }
+
+  // If getting the latest get the latest common time
+  if (time == TimePointZero) {
+    tf2::TF2Error retval = getLatestCommonTime(target_id, source_id, time, error_string);
+    if (retval != tf2::TF2Error::NO_ERROR) {
+      return retval;
+    }
+  }
+
+  // Walk the tree to its root from the source frame, accumulating the transform
+  CompactFrameID frame = source_id;
+  CompactFrameID top_parent = frame;
+  uint32_t depth = 0;
+
+  bool extrapolation_might_have_occurred = false;
+
+  while (frame != 0) {
+    FrameType type = frame_types_[frame];
+    if (frame_chain) {
+      frame_chain->push_back(frame);
+    }
+
+    if (type == FrameType::Unallocated) {
+      // There will be no cache for the very root of the tree
+      top_parent = frame;
+      break;
+    }
+
+    // The error is only needed if there turns out to be no path, see below
+    CompactFrameID parent = type == FrameType::Static ?
+      f.gather(frame_chain ? static_transforms_[frame] : static_segments_[frame], time) :
+      gatherDynamic(f, frames_[frame].get(), time_caches_[frame], time, nullptr);
+    if (parent == 0) {
+      // Just break out here... there may still be a path from source -> target
+      top_parent = frame;
+      extrapolation_might_have_occurred = true;
+      break;
+    }
+
+    // Early out... target frame is a direct parent of the source frame
+    if (frame == target_id) {
+      f.finalize(TargetParentOfSource, time);
+      return tf2::TF2Error::NO_ERROR;
+    }
+
+    f.accum(true);
+
+    top_parent = frame;
+    frame = parent;
+
+    ++depth;
+    if (depth > MAX_GRAPH_DEPTH) {
+      if (error_string) {
+        std::stringstream ss;
+        ss << "The tf tree is invalid because it contains a loop." << std::endl <<
+          allFramesAsStringNoLock() << std::endl;
+        *error_string = ss.str();
+      }
+      return tf2::TF2Error::LOOKUP_ERROR;
+    }
+  }
+
+  // Now walk to the top parent from the target frame, accumulating its transform
+  frame = target_id;
+  depth = 0;
+  std::vector<CompactFrameID> reverse_frame_chain;
+
+  while (frame != top_parent) {
+    FrameType type = frame_types_[frame];
+    if (frame_chain) {
+      reverse_frame_chain.push_back(frame);
+    }
+
+    if (type == FrameType::Unallocated) {
+      break;
+    }
+
+    CompactFrameID parent = type == FrameType::Static ?
+      f.gather(frame_chain ? static_transforms_[frame] : static_segments_[frame], time) :
+      gatherDynamic(f, frames_[frame].get(), time_caches_[frame], time, error_string);
+    if (parent == 0) {
+      if (error_string) {
+        std::stringstream ss;
+        ss << *error_string << ", when looking up transform from frame [" << lookupFrameString(
           source_id) << "] to frame [" << lookupFrameString(target_id) << "]";
         *error_string = ss.str();
       }
@@ -525,6 +1762,8 @@ tf2::TF2Error BufferCore::walkToTopParent(
   if (frame != top_parent) {
     if (extrapolation_might_have_occurred) {
       if (error_string) {
+        std::string extrapolation_error_string;
+        getFrame(top_parent)->getParent(time, &extrapolation_error_string);
         std::stringstream ss;
         ss << extrapolation_error_string << ", when looking up transform from frame [" <<
           lookupFrameString(source_id) << "] to frame [" << lookupFrameString(target_id) << "]";
@@ -565,6 +1804,142 @@ tf2::TF2Error BufferCore::walkToTopParent(
   return tf2::TF2Error::NO_ERROR;
 }
 
+template<typename F>
+bool BufferCore::walkFrameChain(F & f, TimePoint time, const FrameChain & chain) const
+{
+  // The caches the links point to are only guaranteed to be alive for the current topology
+  if (!chain.connected_ || chain.topology_version_ != topology_version_) {
+    return false;
+  }
+
+  // Same as getLatestCommonTime(), the latest time shared by all frames in the chain
+  if (time == TimePointZero) {
+    // False if a link has been reparented since the chain was compiled
+    auto latest_common_time = [](const std::vector<FrameChain::Link> & links, TimePoint & time) {
+        for (const FrameChain::Link & link : links) {
+          P_TimeAndFrameID latest = link.cache->getLatestTimeAndParent();
+          if (latest.second != link.parent) {
+            return false;
+          }
+          if (latest.first != TimePointZero) {
+            time = std::min(latest.first, time);
+          }
+        }
+        return true;
+      };
+    TimePoint common_time = TimePoint::max();
+    if (!latest_common_time(chain.source_links_, common_time) ||
+      !latest_common_time(chain.target_links_, common_time))
+    {
+      return false;
+    }
+    time = common_time == TimePoint::max() ? TimePointZero : common_time;
+  }
+
+  auto gather = [&](const std::vector<FrameChain::Link> & links, bool source) {
+      for (size_t i = 0; i < links.size(); ++i) {
+        const FrameChain::Link & link = links[i];
+        if (link.segment_end != 0) {
+          // The segment ends on the chain as long as the topology is unchanged
+          f.gather(static_segments_[link.child], time);
+          i = link.segment_end - 1;
+        } else if (gatherDynamic(f, link.cache.get(), link.time_cache, time, nullptr) !=
+          link.parent)
+        {
+          return false;
+        }
+        f.accum(source);
+      }
+      return true;
+    };
+  if (!gather(chain.source_links_, true) || !gather(chain.target_links_, false)) {
+    return false;
+  }
+
+  if (chain.target_links_.empty()) {
+    f.finalize(TargetParentOfSource, time);
+  } else if (chain.source_links_.empty()) {
+    f.finalize(SourceParentOfTarget, time);
+  } else {
+    f.finalize(FullPath, time);
+  }
+  return true;
+}
+
+template<typename F>
+bool BufferCore::walkFrameChain(
+  std::vector<F> & fs, const std::vector<TimePoint> & times, const FrameChain & chain) const
+{
+  if (!chain.connected_ || chain.topology_version_ != topology_version_) {
+    return false;
+  }
+
+  // Each cache is swept through all of the times before moving on to the next link
+  std::vector<TransformStorage> samples;
+  auto gather = [&](const std::vector<FrameChain::Link> & links, bool source) {
+      for (const FrameChain::Link & link : links) {
+        if (!link.cache->getDataBatch(times, samples)) {
+          return false;
+        }
+        for (size_t i = 0; i < times.size(); ++i) {
+          if (samples[i].frame_id_ != link.parent) {
+            return false;
+          }
+          fs[i].st = samples[i];
+          fs[i].accum(source);
+        }
+      }
+      return true;
+    };
+  if (!gather(chain.source_links_, true) || !gather(chain.target_links_, false)) {
+    return false;
+  }
+
+  WalkEnding end = FullPath;
+  if (chain.target_links_.empty()) {
+    end = TargetParentOfSource;
+  } else if (chain.source_links_.empty()) {
+    end = SourceParentOfTarget;
+  }
+  for (size_t i = 0; i < times.size(); ++i) {
+    fs[i].finalize(end, times[i]);
+  }
+  return true;
+}
+
+namespace
+{
+
+/// v rotated by q, same as quatRotate() but without the intermediate quaternions
+inline tf2::Vector3 rotate(const tf2::Quaternion & q, const tf2::Vector3 & v)
+{
+  // q v q* = (w^2 - u.u) v + 2 (u.v) u + 2 w (u x v) for a quaternion of any length
+  const tf2Scalar x = q.x(), y = q.y(), z = q.z(), w = q.w();
+  const tf2Scalar vx = v.x(), vy = v.y(), vz = v.z();
+  const tf2Scalar a = w * w - (x * x + y * y + z * z);
+  const tf2Scalar b = 2.0 * (x * vx + y * vy + z * vz);
+  const tf2Scalar c = 2.0 * w;
+  return tf2::Vector3(
+    a * vx + b * x + c * (y * vz - z * vy),
+    a * vy + b * y + c * (z * vx - x * vz),
+    a * vz + b * z + c * (x * vy - y * vx));
+}
+
+/// Prepend the transform (q, t) to the accumulated one, in place
+inline void compose(
+  const tf2::Quaternion & q, const tf2::Vector3 & t, tf2::Quaternion & quat, tf2::Vector3 & vec)
+{
+  vec = rotate(q, vec) + t;
+  const tf2Scalar x = quat.x(), y = quat.y(), z = quat.z(), w = quat.w();
+  quat.setValue(
+    q.w() * x + q.x() * w + q.y() * z - q.z() * y,
+    q.w() * y + q.y() * w + q.z() * x - q.x() * z,
+    q.w() * z + q.z() * w + q.x() * y - q.y() * x,
+    q.w() * w - q.x() * x - q.y() * y - q.z() * z);
+}
+
+}  // namespace
+
 struct TransformAccum
 {
   TransformAccum()
@@ -577,7 +1952,8 @@ struct TransformAccum
   {
   }
 
-  CompactFrameID gather(TimeCacheInterfacePtr cache, TimePoint time, std::string * error_string)
+  template<typename Cache>
+  CompactFrameID gather(Cache * cache, TimePoint time, std::string * error_string)
   {
     if (!cache->getData(time, st, error_string)) {
       return 0;
@@ -586,14 +1962,19 @@ struct TransformAccum
     return st.frame_id_;
   }
 
+  CompactFrameID gather(const TransformStorage & static_transform, TimePoint time)
+  {
+    st = static_transform;
+    st.stamp_ = time;
+    return st.frame_id_;
+  }
+
   void accum(bool source)
   {
     if (source) {
-      source_to_top_vec = quatRotate(st.rotation_, source_to_top_vec) + st.translation_;
-      source_to_top_quat = st.rotation_ * source_to_top_quat;
+      compose(st.rotation_, st.translation_, source_to_top_quat, source_to_top_vec);
     } else {
-      target_to_top_vec = quatRotate(st.rotation_, target_to_top_vec) + st.translation_;
-      target_to_top_quat = st.rotation_ * target_to_top_quat;
+      compose(st.rotation_, st.translation_, target_to_top_quat, target_to_top_vec);
     }
   }
 
@@ -609,7 +1990,7 @@ struct TransformAccum
       case SourceParentOfTarget:
         {
           tf2::Quaternion inv_target_quat = target_to_top_quat.inverse();
-          tf2::Vector3 inv_target_vec = quatRotate(inv_target_quat, -target_to_top_vec);
+          tf2::Vector3 inv_target_vec = rotate(inv_target_quat, -target_to_top_vec);
           result_vec = inv_target_vec;
           result_quat = inv_target_quat;
           break;
@@ -617,9 +1998,9 @@ struct TransformAccum
       case FullPath:
         {
           tf2::Quaternion inv_target_quat = target_to_top_quat.inverse();
-          tf2::Vector3 inv_target_vec = quatRotate(inv_target_quat, -target_to_top_vec);
+          tf2::Vector3 inv_target_vec = rotate(inv_target_quat, -target_to_top_vec);
 
-          result_vec = quatRotate(inv_target_quat, source_to_top_vec) + inv_target_vec;
+          result_vec = rotate(inv_target_quat, source_to_top_vec) + inv_target_vec;
           result_quat = inv_target_quat * source_to_top_quat;
         }
         break;
@@ -639,14 +2020,13 @@ struct TransformAccum
   tf2::Vector3 result_vec;
 };
 
-geometry_msgs::msg::TransformStamped
-BufferCore::lookupTransform(
-  const std::string & target_frame, const std::string & source_frame,
-  const TimePoint & time) const
+namespace
+{
+
+geometry_msgs::msg::TransformStamped transformToMsg(
+  const tf2::Transform & transform, TimePoint time_out,
+  const std::string & target_frame, const std::string & source_frame)
 {
-  tf2::Transform transform;
-  TimePoint time_out;
-  lookupTransformImpl(target_frame, source_frame, time, transform, time_out);
   geometry_msgs::msg::TransformStamped msg;
   msg.transform.translation.x = transform.getOrigin().x();
   msg.transform.translation.y = transform.getOrigin().y();
@@ -667,6 +2047,19 @@ BufferCore::lookupTransform(
   return msg;
 }
 
+}  // anonymous namespace
+
+geometry_msgs::msg::TransformStamped
+BufferCore::lookupTransform(
+  const std::string & target_frame, const std::string & source_frame,
+  const TimePoint & time) const
+{
+  tf2::Transform transform;
+  TimePoint time_out;
+  lookupTransformImpl(target_frame, source_frame, time, transform, time_out);
+  return transformToMsg(transform, time_out, target_frame, source_frame);
+}
+
 geometry_msgs::msg::TransformStamped
 BufferCore::lookupTransform(
   const std::string & target_frame, const TimePoint & target_time,
@@ -678,24 +2071,24 @@ BufferCore::lookupTransform(
   lookupTransformImpl(
     target_frame, target_time, source_frame, source_time,
     fixed_frame, transform, time_out);
-  geometry_msgs::msg::TransformStamped msg;
-  msg.transform.translation.x = transform.getOrigin().x();
-  msg.transform.translation.y = transform.getOrigin().y();
-  msg.transform.translation.z = transform.getOrigin().z();
-  msg.transform.rotation.x = transform.getRotation().x();
-  msg.transform.rotation.y = transform.getRotation().y();
-  msg.transform.rotation.z = transform.getRotation().z();
-  msg.transform.rotation.w = transform.getRotation().w();
-  std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
-    time_out.time_since_epoch());
-  std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(
-    time_out.time_since_epoch());
-  msg.header.stamp.sec = (int32_t)s.count();
-  msg.header.stamp.nanosec = (uint32_t)(ns.count() % 1000000000ull);
-  msg.header.frame_id = target_frame;
-  msg.child_frame_id = source_frame;
+  return transformToMsg(transform, time_out, target_frame, source_frame);
+}
 
-  return msg;
+void BufferCore::lookupTransform(
+  const std::string & target_frame, const std::string & source_frame,
+  const TimePoint & time, tf2::Transform & transform, TimePoint & time_out) const
+{
+  lookupTransformImpl(target_frame, source_frame, time, transform, time_out);
+}
+
+void BufferCore::lookupTransform(
+  const std::string & target_frame, const TimePoint & target_time,
+  const std::string & source_frame, const TimePoint & source_time,
+  const std::string & fixed_frame, tf2::Transform & transform, TimePoint & time_out) const
+{
+  lookupTransformImpl(
+    target_frame, target_time, source_frame, source_time,
+    fixed_frame, transform, time_out);
 }
 
 void BufferCore::lookupTransformImpl(
@@ -704,49 +2097,183 @@ void BufferCore::lookupTransformImpl(
   const TimePoint & time, tf2::Transform & transform,
   TimePoint & time_out) const
 {
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  recordCall(
+    activeMetrics(), BufferCoreCall::Lookup, [&]() {
+      std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+
+      // Identity case does not need to be validated
+      if (target_frame == source_frame) {
+        CompactFrameID frame_id = lookupFrameNumber(target_frame);
+        lookupTransformNoLock(frame_id, frame_id, time, transform, time_out);
+        return;
+      }
 
-  if (target_frame == source_frame) {
+      CompactFrameID target_id = validateFrameId(
+        "lookupTransform argument target_frame", target_frame);
+      CompactFrameID source_id = validateFrameId(
+        "lookupTransform argument source_frame", source_frame);
+
+      lookupTransformNoLock(target_id, source_id, time, transform, time_out);
+    });
+}
+
+void BufferCore::lookupTransformNoLock(
+  CompactFrameID target_id, CompactFrameID source_id, const TimePoint & time,
+  tf2::Transform & transform, TimePoint & time_out) const
+{
+  if (target_id == source_id) {
     transform.setIdentity();
 
-    if (time == TimePointZero) {
-      CompactFrameID target_id = lookupFrameNumber(target_frame);
-      TimeCacheInterfacePtr cache = getFrame(target_id);
-      if (cache) {
-        time_out = cache->getLatestTimestamp();
-      } else {
-        time_out = time;
-      }
+    TimeCacheInterface * cache = getFrame(target_id);
+    if (time == TimePointZero && cache) {
+      time_out = cache->getLatestTimestamp();
     } else {
       time_out = time;
     }
     return;
   }
 
-  // Identity case does not need to be validated
-  CompactFrameID target_id = validateFrameId("lookupTransform argument target_frame", target_frame);
-  CompactFrameID source_id = validateFrameId("lookupTransform argument source_frame", source_frame);
+  lookupTransformNoLock(*getFrameChainNoLock(target_id, source_id), time, transform, time_out);
+}
 
+void BufferCore::lookupTransformNoLock(
+  const FrameChain & chain, const TimePoint & time,
+  tf2::Transform & transform, TimePoint & time_out) const
+{
   std::string error_string;
+  tf2::TF2Error retval = tryLookupTransformNoLock(chain, time, transform, time_out, &error_string);
+  switch (retval) {
+    case tf2::TF2Error::NO_ERROR:
+      break;
+    case tf2::TF2Error::CONNECTIVITY_ERROR:
+      throw ConnectivityException(error_string);
+    case tf2::TF2Error::EXTRAPOLATION_ERROR:
+      throw ExtrapolationException(error_string);
+    case tf2::TF2Error::LOOKUP_ERROR:
+      throw LookupException(error_string);
+    default:
+      CONSOLE_BRIDGE_logError("Unknown error code: %d", retval);
+      assert(0);
+  }
+}
+
+tf2::TF2Error BufferCore::tryLookupTransformNoLock(
+  CompactFrameID target_id, CompactFrameID source_id, const TimePoint & time,
+  tf2::Transform & transform, TimePoint & time_out, std::string * error_msg) const
+{
+  if (target_id == source_id) {
+    lookupTransformNoLock(target_id, source_id, time, transform, time_out);
+    return tf2::TF2Error::NO_ERROR;
+  }
+
+  return tryLookupTransformNoLock(
+    *getFrameChainNoLock(target_id, source_id), time, transform, time_out, error_msg);
+}
+
+tf2::TF2Error BufferCore::tryLookupTransformNoLock(
+  const FrameChain & chain, const TimePoint & time,
+  tf2::Transform & transform, TimePoint & time_out, std::string * error_msg) const
+{
+  // Only results along chains compiled for the current tree are remembered, those name every
+  // frame the result depends on.  The versions are read before the walk, so samples inserted
+  // during it make the result outdated rather than the other way around.
+  LookupCache * lookup_cache = lookup_cache_.get();
+  uint64_t data_version = 0;
+  if (lookup_cache) {
+    if (!chain.connected_ || chain.topology_version_ != topology_version_) {
+      lookup_cache = nullptr;
+    } else {
+      data_version = chainDataVersionNoLock(chain);
+      if (lookup_cache->find(
+          chain.target_id_, chain.source_id_, time, chain.topology_version_, data_version,
+          transform, time_out))
+      {
+        return tf2::TF2Error::NO_ERROR;
+      }
+    }
+  }
+
   TransformAccum accum;
-  tf2::TF2Error retval = walkToTopParent(accum, time, target_id, source_id, &error_string);
-  if (retval != tf2::TF2Error::NO_ERROR) {
-    switch (retval) {
-      case tf2::TF2Error::CONNECTIVITY_ERROR:
-        throw ConnectivityException(error_string);
-      case tf2::TF2Error::EXTRAPOLATION_ERROR:
-        throw ExtrapolationException(error_string);
-      case tf2::TF2Error::LOOKUP_ERROR:
-        throw LookupException(error_string);
-      default:
-        CONSOLE_BRIDGE_logError("Unknown error code: %d", retval);
-        assert(0);
+  if (!walkFrameChain(accum, time, chain)) {
+    // The walk up the tree may cross frames that are not on the chain, such as a parent the
+    // source had before a reparent, so data_version does not cover the result
+    lookup_cache = nullptr;
+    accum = TransformAccum();
+    tf2::TF2Error retval = walkToTopParent(
+      accum, time, chain.target_id_, chain.source_id_, error_msg);
+    if (retval != tf2::TF2Error::NO_ERROR) {
+      return retval;
     }
   }
 
-  time_out = accum.time;
-  transform.setOrigin(accum.result_vec);
-  transform.setRotation(accum.result_quat);
+  time_out = accum.time;
+  transform.setOrigin(accum.result_vec);
+  transform.setRotation(accum.result_quat);
+  if (lookup_cache) {
+    lookup_cache->store(
+      chain.target_id_, chain.source_id_, time, chain.topology_version_, data_version,
+      transform, time_out);
+  }
+  return tf2::TF2Error::NO_ERROR;
+}
+
+uint64_t BufferCore::chainDataVersionNoLock(const FrameChain & chain) const
+{
+  uint64_t version = 0;
+  for (const FrameChain::Link & link : chain.source_links_) {
+    version += frame_versions_[link.child].load(std::memory_order_acquire);
+  }
+  for (const FrameChain::Link & link : chain.target_links_) {
+    version += frame_versions_[link.child].load(std::memory_order_acquire);
+  }
+  return version;
+}
+
+tf2::TF2Error BufferCore::tryLookupTransform(
+  const std::string & target_frame, const std::string & source_frame,
+  const TimePoint & time, geometry_msgs::msg::TransformStamped & transform,
+  std::string * error_msg) const
+{
+  tf2::Transform result;
+  TimePoint time_out;
+  tf2::TF2Error retval = tryLookupTransform(
+    target_frame, source_frame, time, result, time_out, error_msg);
+  if (retval == tf2::TF2Error::NO_ERROR) {
+    transform = transformToMsg(result, time_out, target_frame, source_frame);
+  }
+  return retval;
+}
+
+tf2::TF2Error BufferCore::tryLookupTransform(
+  const std::string & target_frame, const std::string & source_frame,
+  const TimePoint & time, tf2::Transform & transform, TimePoint & time_out,
+  std::string * error_msg) const
+{
+  return recordResult(
+    activeMetrics(), BufferCoreCall::Lookup, [&]() {
+      std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+
+      // Identity case does not need to be validated
+      if (target_frame == source_frame) {
+        CompactFrameID frame_id = lookupFrameNumber(target_frame);
+        lookupTransformNoLock(frame_id, frame_id, time, transform, time_out);
+        return tf2::TF2Error::NO_ERROR;
+      }
+
+      CompactFrameID target_id = 0;
+      CompactFrameID source_id = 0;
+      tf2::TF2Error retval = checkFrameId(
+        "tryLookupTransform argument target_frame", target_frame, target_id, error_msg);
+      if (retval == tf2::TF2Error::NO_ERROR) {
+        retval = checkFrameId(
+          "tryLookupTransform argument source_frame", source_frame, source_id, error_msg);
+      }
+      if (retval != tf2::TF2Error::NO_ERROR) {
+        return retval;
+      }
+
+      return tryLookupTransformNoLock(target_id, source_id, time, transform, time_out, error_msg);
+    });
 }
 
 void BufferCore::lookupTransformImpl(
@@ -757,25 +2284,48 @@ void BufferCore::lookupTransformImpl(
   const std::string & fixed_frame, tf2::Transform & transform,
   TimePoint & time_out) const
 {
-  validateFrameId("lookupTransform argument target_frame", target_frame);
-  validateFrameId("lookupTransform argument source_frame", source_frame);
-  validateFrameId("lookupTransform argument fixed_frame", fixed_frame);
-
-  tf2::Transform tf1, tf2;
-
-  lookupTransformImpl(fixed_frame, source_frame, source_time, tf1, time_out);
-  lookupTransformImpl(target_frame, fixed_frame, target_time, tf2, time_out);
+  recordCall(
+    activeMetrics(), BufferCoreCall::Lookup, [&]() {
+      std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+      CompactFrameID target_id = validateFrameId(
+        "lookupTransform argument target_frame", target_frame);
+      CompactFrameID source_id = validateFrameId(
+        "lookupTransform argument source_frame", source_frame);
+      CompactFrameID fixed_id = validateFrameId(
+        "lookupTransform argument fixed_frame", fixed_frame);
+      lookupTransformNoLock(
+        target_id, target_time, source_id, source_time, fixed_id, transform, time_out);
+    });
+}
 
-  transform = tf2 * tf1;
+void BufferCore::lookupTransformNoLock(
+  CompactFrameID target_id, const TimePoint & target_time,
+  CompactFrameID source_id, const TimePoint & source_time,
+  CompactFrameID fixed_id, tf2::Transform & transform, TimePoint & time_out) const
+{
+  // Both halves come from the chain cache, which keeps them compiled across calls.  They are
+  // walked at different times, so the frames they have in common share no samples.
+  tf2::Transform fixed_from_source;
+  tf2::Transform target_from_fixed;
+  lookupTransformNoLock(fixed_id, source_id, source_time, fixed_from_source, time_out);
+  lookupTransformNoLock(target_id, fixed_id, target_time, target_from_fixed, time_out);
+  transform.mult(target_from_fixed, fixed_from_source);
 }
 
 struct CanTransformAccum
 {
-  CompactFrameID gather(TimeCacheInterfacePtr cache, TimePoint time, std::string * error_string)
+  template<typename Cache>
+  CompactFrameID gather(Cache * cache, TimePoint time, std::string * error_string)
   {
     return cache->getParent(time, error_string);
   }
 
+  CompactFrameID gather(const TransformStorage & static_transform, TimePoint time)
+  {
+    (void)time;
+    return static_transform.frame_id_;
+  }
+
   void accum(bool source)
   {
     (void)source;
@@ -805,6 +2355,14 @@ bool BufferCore::canTransformNoLock(
     return true;
   }
 
+  // Frames that have been looked up before have a compiled chain to check the bounds along
+  if (time != TimePointZero) {
+    FrameChainHandle chain = findFrameChain(target_id, source_id);
+    if (chain && canTransformFromBoundsNoLock(*chain, time)) {
+      return true;
+    }
+  }
+
   CanTransformAccum accum;
   if (walkToTopParent(accum, time, target_id, source_id, error_msg) == tf2::TF2Error::NO_ERROR) {
     return true;
@@ -817,7 +2375,7 @@ bool BufferCore::canTransformInternal(
   CompactFrameID target_id, CompactFrameID source_id,
   const TimePoint & time, std::string * error_msg) const
 {
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
   return canTransformNoLock(target_id, source_id, time, error_msg);
 }
 
@@ -825,57 +2383,889 @@ bool BufferCore::canTransform(
   const std::string & target_frame, const std::string & source_frame,
   const TimePoint & time, std::string * error_msg) const
 {
-  // Short circuit if target_frame == source_frame
-  if (target_frame == source_frame) {
-    return true;
+  return recordCheck(
+    activeMetrics(), BufferCoreCall::CanTransform, TF2Error::TRANSFORM_ERROR, [&]() {
+      // Short circuit if target_frame == source_frame
+      if (target_frame == source_frame) {
+        return true;
+      }
+
+      std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+      CompactFrameID target_id = validateFrameId(
+        "canTransform argument target_frame", target_frame, error_msg);
+      if (target_id == 0) {
+        return false;
+      }
+      CompactFrameID source_id = validateFrameId(
+        "canTransform argument source_frame", source_frame, error_msg);
+      if (source_id == 0) {
+        return false;
+      }
+
+      return canTransformNoLock(target_id, source_id, time, error_msg);
+    });
+}
+
+bool BufferCore::canTransform(
+  const std::string & target_frame, const TimePoint & target_time,
+  const std::string & source_frame, const TimePoint & source_time,
+  const std::string & fixed_frame, std::string * error_msg) const
+{
+  return recordCheck(
+    activeMetrics(), BufferCoreCall::CanTransform, TF2Error::TRANSFORM_ERROR, [&]() {
+      std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+      CompactFrameID target_id = validateFrameId(
+        "canTransform argument target_frame", target_frame, error_msg);
+      if (target_id == 0) {
+        return false;
+      }
+      CompactFrameID source_id = validateFrameId(
+        "canTransform argument source_frame", source_frame, error_msg);
+      if (source_id == 0) {
+        return false;
+      }
+      CompactFrameID fixed_id = validateFrameId(
+        "canTransform argument fixed_frame", fixed_frame, error_msg);
+      if (fixed_id == 0) {
+        return false;
+      }
+
+      return
+        canTransformNoLock(target_id, fixed_id, target_time, error_msg) &&
+        canTransformNoLock(fixed_id, source_id, source_time, error_msg);
+    });
+}
+
+FrameHandle BufferCore::resolveFrame(const std::string & frame_id, std::string * error_msg) const
+{
+  std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+  return FrameHandle(validateFrameId("resolveFrame argument frame_id", frame_id, error_msg));
+}
+
+geometry_msgs::msg::TransformStamped
+BufferCore::lookupTransform(
+  FrameHandle target_frame, FrameHandle source_frame, const TimePoint & time) const
+{
+  return recordCall(
+    activeMetrics(), BufferCoreCall::Lookup, [&]() {
+      if (!target_frame || !source_frame) {
+        throw LookupException("lookupTransform called with an unresolved FrameHandle");
+      }
+
+      tf2::Transform transform;
+      TimePoint time_out;
+      if (time == TimePointZero && target_frame != source_frame) {
+        FrameChainHandle chain = findFrameChain(target_frame.id_, source_frame.id_);
+        if (chain && lookupLatestLockFree(*chain, transform, time_out)) {
+          return transformToMsg(transform, time_out, chain->target_frame_, chain->source_frame_);
+        }
+      }
+
+      std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+      lookupTransformNoLock(target_frame.id_, source_frame.id_, time, transform, time_out);
+      return transformToMsg(
+        transform, time_out, lookupFrameString(target_frame.id_),
+        lookupFrameString(source_frame.id_));
+    });
+}
+
+geometry_msgs::msg::TransformStamped
+BufferCore::lookupTransform(
+  FrameHandle target_frame, const TimePoint & target_time,
+  FrameHandle source_frame, const TimePoint & source_time,
+  FrameHandle fixed_frame) const
+{
+  return recordCall(
+    activeMetrics(), BufferCoreCall::Lookup, [&]() {
+      if (!target_frame || !source_frame || !fixed_frame) {
+        throw LookupException("lookupTransform called with an unresolved FrameHandle");
+      }
+
+      tf2::Transform transform;
+      TimePoint time_out;
+      std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+      lookupTransformNoLock(
+        target_frame.id_, target_time, source_frame.id_, source_time, fixed_frame.id_,
+        transform, time_out);
+      return transformToMsg(
+        transform, time_out, lookupFrameString(target_frame.id_),
+        lookupFrameString(source_frame.id_));
+    });
+}
+
+bool BufferCore::canTransform(
+  FrameHandle target_frame, FrameHandle source_frame,
+  const TimePoint & time, std::string * error_msg) const
+{
+  return recordCheck(
+    activeMetrics(), BufferCoreCall::CanTransform, TF2Error::TRANSFORM_ERROR, [&]() {
+      std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+      return canTransformNoLock(target_frame.id_, source_frame.id_, time, error_msg);
+    });
+}
+
+bool BufferCore::canTransform(
+  FrameHandle target_frame, const TimePoint & target_time,
+  FrameHandle source_frame, const TimePoint & source_time,
+  FrameHandle fixed_frame, std::string * error_msg) const
+{
+  return recordCheck(
+    activeMetrics(), BufferCoreCall::CanTransform, TF2Error::TRANSFORM_ERROR, [&]() {
+      std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+      return
+        canTransformNoLock(target_frame.id_, fixed_frame.id_, target_time, error_msg) &&
+        canTransformNoLock(fixed_frame.id_, source_frame.id_, source_time, error_msg);
+    });
+}
+
+FrameChainHandle BufferCore::getFrameChain(
+  const std::string & target_frame, const std::string & source_frame) const
+{
+  std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+
+  if (target_frame == source_frame) {
+    // Identity case does not need to be validated, same as lookupTransform
+    std::shared_ptr<FrameChain> chain = std::make_shared<FrameChain>();
+    chain->target_id_ = chain->source_id_ = lookupFrameNumber(target_frame);
+    chain->target_frame_ = chain->source_frame_ = target_frame;
+    chain->topology_version_ = topology_version_;
+    chain->connected_ = true;
+    return chain;
+  }
+
+  CompactFrameID target_id = validateFrameId("getFrameChain argument target_frame", target_frame);
+  CompactFrameID source_id = validateFrameId("getFrameChain argument source_frame", source_frame);
+  return getFrameChainNoLock(target_id, source_id);
+}
+
+geometry_msgs::msg::TransformStamped
+BufferCore::lookupTransform(const FrameChainHandle & chain, const TimePoint & time) const
+{
+  tf2::Transform transform;
+  TimePoint time_out;
+  lookupTransform(chain, time, transform, time_out);
+  return transformToMsg(transform, time_out, chain->target_frame_, chain->source_frame_);
+}
+
+void BufferCore::lookupTransform(
+  const FrameChainHandle & chain, const TimePoint & time,
+  tf2::Transform & transform, TimePoint & time_out) const
+{
+  recordCall(
+    activeMetrics(), BufferCoreCall::Lookup, [&]() {
+      if (!chain) {
+        throw InvalidArgumentException("lookupTransform called with an empty FrameChainHandle");
+      }
+
+      if (time != TimePointZero || chain->target_id_ == chain->source_id_ ||
+        !lookupLatestLockFree(*chain, transform, time_out))
+      {
+        std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+        if (chain->target_id_ != chain->source_id_ &&
+          chain->topology_version_ == topology_version_)
+        {
+          lookupTransformNoLock(*chain, time, transform, time_out);
+        } else {
+          lookupTransformNoLock(chain->target_id_, chain->source_id_, time, transform, time_out);
+        }
+      }
+    });
+}
+
+tf2::TF2Error BufferCore::tryLookupTransform(
+  const FrameChainHandle & chain, const TimePoint & time,
+  tf2::Transform & transform, TimePoint & time_out, std::string * error_msg) const
+{
+  return recordResult(
+    activeMetrics(), BufferCoreCall::Lookup, [&]() {
+      if (!chain) {
+        if (error_msg) {
+          *error_msg = "tryLookupTransform called with an empty FrameChainHandle";
+        }
+        return tf2::TF2Error::INVALID_ARGUMENT_ERROR;
+      }
+
+      if (time == TimePointZero && chain->target_id_ != chain->source_id_ &&
+        lookupLatestLockFree(*chain, transform, time_out))
+      {
+        return tf2::TF2Error::NO_ERROR;
+      }
+
+      std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+      if (chain->target_id_ != chain->source_id_ &&
+        chain->topology_version_ == topology_version_)
+      {
+        return tryLookupTransformNoLock(*chain, time, transform, time_out, error_msg);
+      }
+      return tryLookupTransformNoLock(
+        chain->target_id_, chain->source_id_, time, transform, time_out, error_msg);
+    });
+}
+
+tf2::TF2Error BufferCore::lookupTransformRealtime(
+  const FrameChainHandle & chain, const TimePoint & time,
+  tf2::Transform & transform, TimePoint & time_out) const noexcept
+{
+  // Metrics are not recorded, the recorder takes a mutex
+  if (!chain) {
+    return tf2::TF2Error::INVALID_ARGUMENT_ERROR;
+  }
+  if (time == TimePointZero && lookupLatestLockFree(*chain, transform, time_out)) {
+    return tf2::TF2Error::NO_ERROR;
+  }
+
+  std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return tf2::TF2Error::TIMEOUT_ERROR;
+  }
+
+  TransformAccum accum;
+  if (!walkFrameChain(accum, time, *chain)) {
+    // Walking the tree instead of recompiling the chain does not allocate
+    accum = TransformAccum();
+    tf2::TF2Error retval = walkToTopParent(
+      accum, time, chain->target_id_, chain->source_id_, nullptr);
+    if (retval != tf2::TF2Error::NO_ERROR) {
+      return retval;
+    }
+  }
+  if (chain->target_id_ == chain->source_id_ && time == TimePointZero) {
+    // Same as lookupTransformNoLock()
+    TimeCacheInterface * cache = getFrame(chain->target_id_);
+    accum.time = cache ? cache->getLatestTimestamp() : time;
+  }
+
+  time_out = accum.time;
+  transform.setOrigin(accum.result_vec);
+  transform.setRotation(accum.result_quat);
+  return tf2::TF2Error::NO_ERROR;
+}
+
+std::vector<geometry_msgs::msg::TransformStamped>
+BufferCore::lookupTransforms(
+  const std::string & target_frame, const std::string & source_frame,
+  const std::vector<TimePoint> & times) const
+{
+  std::vector<tf2::Transform> transforms;
+  std::vector<TimePoint> times_out;
+  lookupTransforms(target_frame, source_frame, times, transforms, times_out);
+
+  std::vector<geometry_msgs::msg::TransformStamped> msgs;
+  msgs.reserve(transforms.size());
+  for (size_t i = 0; i < transforms.size(); ++i) {
+    msgs.push_back(transformToMsg(transforms[i], times_out[i], target_frame, source_frame));
+  }
+  return msgs;
+}
+
+void BufferCore::lookupTransforms(
+  const std::string & target_frame, const std::string & source_frame,
+  const std::vector<TimePoint> & times, std::vector<tf2::Transform> & transforms,
+  std::vector<TimePoint> & times_out) const
+{
+  recordCall(
+    activeMetrics(), BufferCoreCall::Lookup, [&]() {
+      transforms.resize(times.size());
+      times_out.resize(times.size());
+
+      std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+
+      if (target_frame == source_frame) {
+        CompactFrameID frame_id = lookupFrameNumber(target_frame);
+        for (size_t i = 0; i < times.size(); ++i) {
+          lookupTransformNoLock(frame_id, frame_id, times[i], transforms[i], times_out[i]);
+        }
+        return;
+      }
+
+      CompactFrameID target_id = validateFrameId(
+        "lookupTransforms argument target_frame", target_frame);
+      CompactFrameID source_id = validateFrameId(
+        "lookupTransforms argument source_frame", source_frame);
+      FrameChainHandle chain = getFrameChainNoLock(target_id, source_id);
+
+      // Order the requests by time, the latest ones (time 0) go first and are looked up one by one
+      std::vector<size_t> order(times.size());
+      std::iota(order.begin(), order.end(), 0);
+      if (!std::is_sorted(times.begin(), times.end())) {
+        std::stable_sort(
+          order.begin(), order.end(), [&times](size_t a, size_t b) {return times[a] < times[b];});
+      }
+      size_t first_timed = 0;
+      while (first_timed < order.size() && times[order[first_timed]] == TimePointZero) {
+        lookupTransformNoLock(
+          *chain, TimePointZero, transforms[order[first_timed]], times_out[order[first_timed]]);
+        ++first_timed;
+      }
+
+      std::vector<TimePoint> sorted_times;
+      sorted_times.reserve(order.size() - first_timed);
+      for (size_t i = first_timed; i < order.size(); ++i) {
+        sorted_times.push_back(times[order[i]]);
+      }
+
+      std::vector<TransformAccum> accums(sorted_times.size());
+      if (!walkFrameChain(accums, sorted_times, *chain)) {
+        // Some of the times need walkToTopParent(), which also reports why a lookup failed
+        for (size_t i = first_timed; i < order.size(); ++i) {
+          lookupTransformNoLock(*chain, times[order[i]], transforms[order[i]], times_out[order[i]]);
+        }
+        return;
+      }
+      for (size_t i = 0; i < accums.size(); ++i) {
+        size_t index = order[first_timed + i];
+        transforms[index].setOrigin(accums[i].result_vec);
+        transforms[index].setRotation(accums[i].result_quat);
+        times_out[index] = accums[i].time;
+      }
+    });
+}
+
+geometry_msgs::msg::TwistStamped
+BufferCore::lookupVelocity(
+  const std::string & tracking_frame, const std::string & observation_frame,
+  const TimePoint & time, const tf2::Duration & averaging_interval) const
+{
+  tf2::Vector3 linear;
+  tf2::Vector3 angular;
+  TimePoint time_out;
+  lookupVelocity(
+    tracking_frame, observation_frame, time, averaging_interval, linear, angular, time_out);
+
+  geometry_msgs::msg::TwistStamped msg;
+  msg.twist.linear.x = linear.x();
+  msg.twist.linear.y = linear.y();
+  msg.twist.linear.z = linear.z();
+  msg.twist.angular.x = angular.x();
+  msg.twist.angular.y = angular.y();
+  msg.twist.angular.z = angular.z();
+  std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    time_out.time_since_epoch());
+  std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(
+    time_out.time_since_epoch());
+  msg.header.stamp.sec = (int32_t)s.count();
+  msg.header.stamp.nanosec = (uint32_t)(ns.count() % 1000000000ull);
+  msg.header.frame_id = observation_frame;
+  return msg;
+}
+
+void BufferCore::lookupVelocity(
+  const std::string & tracking_frame, const std::string & observation_frame,
+  const TimePoint & time, const tf2::Duration & averaging_interval,
+  tf2::Vector3 & linear, tf2::Vector3 & angular, TimePoint & time_out) const
+{
+  if (averaging_interval <= tf2::Duration::zero()) {
+    throw InvalidArgumentException("lookupVelocity called with a non positive averaging_interval");
+  }
+
+  recordCall(
+    activeMetrics(), BufferCoreCall::Lookup, [&]() {
+      linear.setZero();
+      angular.setZero();
+      time_out = time;
+
+      std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+
+      // A frame never moves relative to itself
+      if (tracking_frame == observation_frame) {
+        return;
+      }
+
+      CompactFrameID observation_id = validateFrameId(
+        "lookupVelocity argument observation_frame", observation_frame);
+      CompactFrameID tracking_id = validateFrameId(
+        "lookupVelocity argument tracking_frame", tracking_frame);
+
+      TimePoint latest_time;
+      std::string error_string;
+      tf2::TF2Error retval = getLatestCommonTime(
+        observation_id, tracking_id, latest_time, &error_string);
+      switch (retval) {
+        case tf2::TF2Error::NO_ERROR:
+          break;
+        case tf2::TF2Error::CONNECTIVITY_ERROR:
+          throw ConnectivityException(error_string);
+        case tf2::TF2Error::EXTRAPOLATION_ERROR:
+          throw ExtrapolationException(error_string);
+        default:
+          throw LookupException(error_string);
+      }
+      // Only static transforms connect the frames
+      if (latest_time == TimePointZero) {
+        return;
+      }
+
+      TimePoint target_time = time == TimePointZero ? latest_time : time;
+      time_out = target_time;
+      TimePoint end_time = std::min(target_time + averaging_interval / 2, latest_time);
+      // Keep the start off 0, which would mean the latest data
+      TimePoint start_time = end_time.time_since_epoch() > averaging_interval ?
+        end_time - averaging_interval : TimePoint(std::chrono::nanoseconds(1));
+      if (start_time >= end_time) {
+        throw ExtrapolationException(
+          "lookupVelocity needs data from before " + displayTimePoint(end_time));
+      }
+
+      // Both ends share one walk of the chain, and with it the cache searches of each link
+      FrameChainHandle chain = getFrameChainNoLock(observation_id, tracking_id);
+      const std::vector<TimePoint> times{start_time, end_time};
+      std::vector<TransformAccum> accums(times.size());
+      tf2::Transform start;
+      tf2::Transform end;
+      if (walkFrameChain(accums, times, *chain)) {
+        start.setOrigin(accums[0].result_vec);
+        start.setRotation(accums[0].result_quat);
+        end.setOrigin(accums[1].result_vec);
+        end.setRotation(accums[1].result_quat);
+      } else {
+        TimePoint unused;
+        lookupTransformNoLock(*chain, start_time, start, unused);
+        lookupTransformNoLock(*chain, end_time, end, unused);
+      }
+
+      const double interval = tf2::durationToSec(end_time - start_time);
+      linear = (end.getOrigin() - start.getOrigin()) / interval;
+
+      // The rotation from start to end as seen from the observation frame
+      tf2::Quaternion delta = end.getRotation() * start.getRotation().inverse();
+      if (delta.w() < 0) {
+        delta *= -1.0;
+      }
+      angular = delta.getAxis() * (delta.getAngle() / interval);
+    });
+}
+
+std::vector<geometry_msgs::msg::TransformStamped>
+BufferCore::lookupTransforms(
+  const std::vector<std::string> & target_frames, const std::string & source_frame,
+  const TimePoint & time) const
+{
+  std::vector<tf2::Transform> transforms;
+  std::vector<TimePoint> times_out;
+  lookupTransforms(target_frames, source_frame, time, transforms, times_out);
+
+  std::vector<geometry_msgs::msg::TransformStamped> msgs;
+  msgs.reserve(transforms.size());
+  for (size_t i = 0; i < transforms.size(); ++i) {
+    msgs.push_back(transformToMsg(transforms[i], times_out[i], target_frames[i], source_frame));
+  }
+  return msgs;
+}
+
+void BufferCore::lookupTransforms(
+  const std::vector<std::string> & target_frames, const std::string & source_frame,
+  const TimePoint & time, std::vector<tf2::Transform> & transforms,
+  std::vector<TimePoint> & times_out) const
+{
+  recordCall(
+    activeMetrics(), BufferCoreCall::Lookup, [&]() {
+      transforms.resize(target_frames.size());
+      times_out.resize(target_frames.size());
+
+      std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+
+      // Identity cases do not need to be validated, same as lookupTransform()
+      std::vector<CompactFrameID> target_ids(target_frames.size());
+      CompactFrameID source_id = 0;
+      for (size_t i = 0; i < target_frames.size(); ++i) {
+        if (target_frames[i] == source_frame) {
+          target_ids[i] = lookupFrameNumber(source_frame);
+          continue;
+        }
+        if (source_id == 0) {
+          source_id = validateFrameId("lookupTransforms argument source_frame", source_frame);
+        }
+        target_ids[i] = validateFrameId(
+          "lookupTransforms argument target_frames", target_frames[i]);
+      }
+
+      // Walk the source up the tree once, recording the source relative to each of its ancestors.
+      // The walk stops at the first link without data, targets that meet the path above it fall
+      // back to a regular lookup which reports the error.
+      std::vector<CompactFrameID> ancestors;
+      std::vector<tf2::Transform> source_in_ancestors;
+      if (time != TimePointZero && source_id != 0) {
+        tf2::Transform accum = tf2::Transform::getIdentity();
+        CompactFrameID frame = source_id;
+        TransformStorage st;
+        while (frame != 0 && ancestors.size() <= MAX_GRAPH_DEPTH) {
+          ancestors.push_back(frame);
+          source_in_ancestors.push_back(accum);
+          TimeCacheInterface * cache = getFrame(frame);
+          if (!cache || !cache->getData(time, st, nullptr)) {
+            break;
+          }
+          accum = tf2::Transform(st.rotation_, st.translation_) * accum;
+          frame = st.frame_id_;
+        }
+      }
+
+      for (size_t i = 0; i < target_ids.size(); ++i) {
+        CompactFrameID target_id = target_ids[i];
+        if (target_frames[i] == source_frame) {
+          lookupTransformNoLock(target_id, target_id, time, transforms[i], times_out[i]);
+          continue;
+        }
+        if (ancestors.empty()) {
+          lookupTransformNoLock(target_id, source_id, time, transforms[i], times_out[i]);
+          continue;
+        }
+
+        // Walk the target up until it meets the source's path
+        tf2::Transform target_in_frame = tf2::Transform::getIdentity();
+        CompactFrameID frame = target_id;
+        TransformStorage st;
+        bool met = false;
+        for (uint32_t depth = 0; frame != 0 && depth <= MAX_GRAPH_DEPTH; ++depth) {
+          auto it = std::find(ancestors.begin(), ancestors.end(), frame);
+          if (it != ancestors.end()) {
+            transforms[i] = target_in_frame.inverse() * source_in_ancestors[it - ancestors.begin()];
+            times_out[i] = time;
+            met = true;
+            break;
+          }
+          TimeCacheInterface * cache = getFrame(frame);
+          if (!cache || !cache->getData(time, st, nullptr)) {
+            break;
+          }
+          target_in_frame = tf2::Transform(st.rotation_, st.translation_) * target_in_frame;
+          frame = st.frame_id_;
+        }
+        if (!met) {
+          lookupTransformNoLock(target_id, source_id, time, transforms[i], times_out[i]);
+        }
+      }
+    });
+}
+
+std::vector<SubtreeTransform> BufferCore::lookupSubtree(
+  const std::string & root_frame, const TimePoint & time) const
+{
+  std::vector<SubtreeTransform> transforms;
+  TimePoint time_out;
+  lookupSubtree(root_frame, time, transforms, time_out);
+  return transforms;
+}
+
+void BufferCore::lookupSubtree(
+  const std::string & root_frame, const TimePoint & time,
+  std::vector<SubtreeTransform> & transforms, TimePoint & time_out) const
+{
+  recordCall(
+    activeMetrics(), BufferCoreCall::Lookup, [&]() {
+      std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+      CompactFrameID root = validateFrameId("lookupSubtree argument root_frame", root_frame);
+
+      const size_t frame_count = frameIDs_reverse_.size();
+      // The parent of each frame, 0 if it has none, and the link from the frame into it
+      std::vector<CompactFrameID> parents(frame_count, 0);
+      std::vector<tf2::Transform> links(frame_count);
+      // The children of frame f are children[child_offsets[f]] to children[child_offsets[f + 1]]
+      std::vector<size_t> child_offsets(frame_count + 1, 0);
+      std::vector<CompactFrameID> children;
+      std::vector<CompactFrameID> subtree;
+      auto collectSubtree = [&]() {
+          std::fill(child_offsets.begin(), child_offsets.end(), 0);
+          for (CompactFrameID frame = 1; frame < frame_count; ++frame) {
+            ++child_offsets[parents[frame] + 1];
+          }
+          for (size_t i = 1; i <= frame_count; ++i) {
+            child_offsets[i] += child_offsets[i - 1];
+          }
+          children.resize(frame_count);
+          std::vector<size_t> next(child_offsets.begin(), child_offsets.end() - 1);
+          for (CompactFrameID frame = 1; frame < frame_count; ++frame) {
+            children[next[parents[frame]]++] = frame;
+          }
+          // Breadth first so every frame comes after its parent.  A loop through the root would
+          // lead back to it, so it is cut there.
+          subtree.assign(1, root);
+          for (size_t i = 0; i < subtree.size(); ++i) {
+            CompactFrameID parent = subtree[i];
+            for (size_t c = child_offsets[parent]; c < child_offsets[parent + 1]; ++c) {
+              if (children[c] != root) {
+                subtree.push_back(children[c]);
+              }
+            }
+          }
+        };
+
+      // At time 0 pick the latest common time of the subtree formed by the latest parents
+      TimePoint stamp = time;
+      if (stamp == TimePointZero) {
+        for (CompactFrameID frame = 1; frame < frame_count; ++frame) {
+          TimeCacheInterface * cache = getFrame(frame);
+          if (cache) {
+            parents[frame] = cache->getLatestTimeAndParent().second;
+          }
+        }
+        collectSubtree();
+        bool found = false;
+        for (size_t i = 1; i < subtree.size(); ++i) {
+          if (frame_types_[subtree[i]] == FrameType::Static) {
+            continue;
+          }
+          TimePoint latest = getFrame(subtree[i])->getLatestTimestamp();
+          if (!found || latest < stamp) {
+            stamp = latest;
+            found = true;
+          }
+        }
+      }
+
+      TransformStorage st;
+      for (CompactFrameID frame = 1; frame < frame_count; ++frame) {
+        TimeCacheInterface * cache = getFrame(frame);
+        if (cache && cache->getData(stamp, st, nullptr)) {
+          parents[frame] = st.frame_id_;
+          links[frame] = tf2::Transform(st.rotation_, st.translation_);
+        } else {
+          parents[frame] = 0;
+        }
+      }
+      collectSubtree();
+
+      // Each frame is only composed with the transform of its parent, which precedes it
+      std::vector<size_t> index_of(frame_count, 0);
+      transforms.resize(subtree.size());
+      for (size_t i = 0; i < subtree.size(); ++i) {
+        CompactFrameID frame = subtree[i];
+        SubtreeTransform & entry = transforms[i];
+        index_of[frame] = i;
+        entry.frame_id = frameIDs_reverse_[frame];
+        if (i == 0) {
+          entry.parent_index = 0;
+          entry.transform.setIdentity();
+        } else {
+          entry.parent_index = index_of[parents[frame]];
+          entry.transform = transforms[entry.parent_index].transform * links[frame];
+        }
+      }
+      time_out = stamp;
+    });
+}
+
+bool BufferCore::canTransform(
+  const FrameChainHandle & chain, const TimePoint & time, std::string * error_msg) const
+{
+  return recordCheck(
+    activeMetrics(), BufferCoreCall::CanTransform, TF2Error::TRANSFORM_ERROR, [&]() {
+      if (!chain) {
+        if (error_msg) {
+          *error_msg = "canTransform called with an empty FrameChainHandle";
+        }
+        return false;
+      }
+
+      if (chain->target_id_ == chain->source_id_) {
+        return true;
+      }
+
+      if (time == TimePointZero) {
+        tf2::Transform transform;
+        TimePoint time_out;
+        if (lookupLatestLockFree(*chain, transform, time_out)) {
+          return true;
+        }
+      }
+
+      std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+      FrameChainHandle current = chain;
+      if (current->topology_version_ != topology_version_) {
+        current = getFrameChainNoLock(chain->target_id_, chain->source_id_);
+      }
+
+      if (canTransformFromBoundsNoLock(*current, time)) {
+        return true;
+      }
+      CanTransformAccum accum;
+      if (walkFrameChain(accum, time, *current)) {
+        return true;
+      }
+      return canTransformNoLock(current->target_id_, current->source_id_, time, error_msg);
+    });
+}
+
+bool BufferCore::canTransformFromBoundsNoLock(const FrameChain & chain, TimePoint time) const
+{
+  if (!chain.connected_ || chain.topology_version_ != topology_version_ ||
+    time == TimePointZero)
+  {
+    return false;
+  }
+
+  auto covered = [this, time](const std::vector<FrameChain::Link> & links) {
+      for (const FrameChain::Link & link : links) {
+        // Static links, and the static segments starting at them, apply at any time
+        if (frame_types_[link.child] != FrameType::Dynamic) {
+          continue;
+        }
+        if (time <= reparent_stamps_[link.child] || time < link.cache->getOldestTimestamp() ||
+          time > link.cache->getLatestTimestamp())
+        {
+          return false;
+        }
+      }
+      return true;
+    };
+  return covered(chain.source_links_) && covered(chain.target_links_);
+}
+
+FrameChainHandle BufferCore::findFrameChain(
+  CompactFrameID target_id, CompactFrameID source_id) const
+{
+  uint64_t key = (static_cast<uint64_t>(target_id) << 32) | source_id;
+  std::shared_lock<std::shared_timed_mutex> lock(frame_chains_mutex_);
+  auto it = frame_chains_.find(key);
+  if (it == frame_chains_.end()) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+bool BufferCore::lookupLatestLockFree(
+  const FrameChain & chain, tf2::Transform & transform, TimePoint & time_out) const
+{
+  uint64_t topology_version = topology_version_.load(std::memory_order_acquire);
+  if (!chain.connected_ || chain.topology_version_ != topology_version ||
+    chain.target_id_ == chain.source_id_)
+  {
+    return false;
   }
 
-  CompactFrameID target_id = validateFrameId(
-    "canTransform argument target_frame", target_frame, error_msg);
-  if (target_id == 0) {
+  // With the same latest stamp in all frames that stamp is the latest common time, and the
+  // samples at that time are the snapshots.  Otherwise interpolation is needed.
+  TransformAccum accum;
+  TimePoint common_time = TimePointZero;
+  auto accumulate = [&accum, &common_time](
+    const std::vector<FrameChain::Link> & links, bool source) {
+      for (const FrameChain::Link & link : links) {
+        if (!link.cache->getLatestSnapshot(accum.st) || accum.st.frame_id_ != link.parent) {
+          return false;
+        }
+        if (accum.st.stamp_ != TimePointZero) {
+          if (common_time == TimePointZero) {
+            common_time = accum.st.stamp_;
+          } else if (accum.st.stamp_ != common_time) {
+            return false;
+          }
+        }
+        accum.accum(source);
+      }
+      return true;
+    };
+  if (!accumulate(chain.source_links_, true) || !accumulate(chain.target_links_, false)) {
     return false;
   }
-  CompactFrameID source_id = validateFrameId(
-    "canTransform argument source_frame", source_frame, error_msg);
-  if (source_id == 0) {
+  if (topology_version_.load(std::memory_order_acquire) != topology_version) {
     return false;
   }
 
-  return canTransformInternal(target_id, source_id, time, error_msg);
+  if (chain.target_links_.empty()) {
+    accum.finalize(TargetParentOfSource, common_time);
+  } else if (chain.source_links_.empty()) {
+    accum.finalize(SourceParentOfTarget, common_time);
+  } else {
+    accum.finalize(FullPath, common_time);
+  }
+  time_out = accum.time;
+  transform.setOrigin(accum.result_vec);
+  transform.setRotation(accum.result_quat);
+  return true;
 }
 
-bool BufferCore::canTransform(
-  const std::string & target_frame, const TimePoint & target_time,
-  const std::string & source_frame, const TimePoint & source_time,
-  const std::string & fixed_frame, std::string * error_msg) const
+FrameChainHandle BufferCore::getFrameChainNoLock(
+  CompactFrameID target_id, CompactFrameID source_id) const
 {
-  CompactFrameID target_id = validateFrameId(
-    "canTransform argument target_frame", target_frame, error_msg);
-  if (target_id == 0) {
-    return false;
+  FrameChainHandle cached = findFrameChain(target_id, source_id);
+  if (cached && cached->topology_version_ == topology_version_) {
+    return cached;
   }
-  CompactFrameID source_id = validateFrameId(
-    "canTransform argument source_frame", source_frame, error_msg);
-  if (source_id == 0) {
-    return false;
+
+  std::shared_ptr<FrameChain> chain = std::make_shared<FrameChain>();
+  chain->target_id_ = target_id;
+  chain->source_id_ = source_id;
+  compileFrameChainNoLock(*chain);
+
+  uint64_t key = (static_cast<uint64_t>(target_id) << 32) | source_id;
+  std::unique_lock<std::shared_timed_mutex> lock(frame_chains_mutex_);
+  // Chains are cheap to recompile, so rather than tracking usage just start over if lookups
+  // have been made between an unreasonable number of frame pairs.
+  if (frame_chains_.size() >= MAX_CACHED_FRAME_CHAINS) {
+    frame_chains_.clear();
   }
-  CompactFrameID fixed_id = validateFrameId(
-    "canTransform argument fixed_frame", fixed_frame, error_msg);
-  if (fixed_id == 0) {
-    return false;
+  frame_chains_[key] = chain;
+  return chain;
+}
+
+void BufferCore::compileFrameChainNoLock(FrameChain & chain) const
+{
+  chain.target_frame_ = lookupFrameString(chain.target_id_);
+  chain.source_frame_ = lookupFrameString(chain.source_id_);
+  chain.topology_version_ = topology_version_;
+  chain.connected_ = false;
+  chain.source_links_.clear();
+  chain.target_links_.clear();
+
+  // Follow the latest parents of both frames to their roots
+  auto path_to_root = [this](CompactFrameID frame, std::vector<CompactFrameID> & path) {
+      while (frame != 0 && path.size() <= MAX_GRAPH_DEPTH) {
+        path.push_back(frame);
+        frame = frame_parents_[frame];
+      }
+    };
+  std::vector<CompactFrameID> source_path;
+  std::vector<CompactFrameID> target_path;
+  path_to_root(chain.source_id_, source_path);
+  path_to_root(chain.target_id_, target_path);
+  if (source_path.size() > MAX_GRAPH_DEPTH || target_path.size() > MAX_GRAPH_DEPTH) {
+    // Leave reporting the loop to walkToTopParent()
+    return;
   }
 
-  return
-    canTransformInternal(target_id, fixed_id, target_time, error_msg) &&
-    canTransformInternal(fixed_id, source_id, source_time, error_msg);
+  for (size_t i = 0; i < source_path.size(); ++i) {
+    auto common = std::find(target_path.begin(), target_path.end(), source_path[i]);
+    if (common == target_path.end()) {
+      continue;
+    }
+
+    for (size_t j = 0; j < i; ++j) {
+      chain.source_links_.push_back(
+        {frames_[source_path[j]], source_path[j + 1], source_path[j], 0,
+          time_caches_[source_path[j]]});
+    }
+    for (auto it = target_path.begin(); it != common; ++it) {
+      chain.target_links_.push_back({frames_[*it], *(it + 1), *it, 0, time_caches_[*it]});
+    }
+
+    // Runs of static frames whose segment ends before the common parent are crossed at once
+    auto collapse = [this](std::vector<FrameChain::Link> & links) {
+        for (size_t j = 0; j < links.size(); ++j) {
+          if (frame_types_[links[j].child] != FrameType::Static) {
+            continue;
+          }
+          CompactFrameID top = static_segments_[links[j].child].frame_id_;
+          for (size_t k = j + 1; k < links.size(); ++k) {
+            if (links[k].parent == top) {
+              links[j].segment_end = k + 1;
+              break;
+            }
+          }
+        }
+      };
+    collapse(chain.source_links_);
+    collapse(chain.target_links_);
+    chain.connected_ = true;
+    return;
+  }
 }
 
-tf2::TimeCacheInterfacePtr BufferCore::getFrame(CompactFrameID frame_id) const
+TimeCacheInterface * BufferCore::getFrame(CompactFrameID frame_id) const
 {
   if (frame_id >= frames_.size()) {
-    return TimeCacheInterfacePtr();
+    return nullptr;
   } else {
-    return frames_[frame_id];
+    return frames_[frame_id].get();
   }
 }
 
@@ -899,14 +3289,35 @@ CompactFrameID BufferCore::lookupOrInsertFrameNumber(const std::string & frameid
     retval = CompactFrameID(frames_.size());
     // Just a place holder for iteration
     frames_.push_back(TimeCacheInterfacePtr());
-    frameIDs_[frameid_str] = retval;
+    frame_types_.push_back(FrameType::Unallocated);
+    frame_parents_.push_back(0);
+    reparent_stamps_.push_back(TimePointZero);
+    static_transforms_.push_back(TransformStorage());
+    static_segments_.push_back(TransformStorage());
+    time_caches_.push_back(nullptr);
+    frame_authorities_.push_back(0);
+    frame_versions_.emplace_back(0);
+    frameIDs_.emplace(frameid_str, retval);
     frameIDs_reverse_.push_back(frameid_str);
+    frame_table_version_.fetch_add(1, std::memory_order_release);
   } else {
-    retval = frameIDs_[frameid_str];
+    retval = map_it->second;
   }
   return retval;
 }
 
+uint32_t BufferCore::internAuthority(const std::string & authority)
+{
+  auto it = authority_ids_.find(authority);
+  if (it != authority_ids_.end()) {
+    return it->second;
+  }
+  uint32_t id = static_cast<uint32_t>(authorities_.size());
+  authorities_.push_back(authority);
+  authority_ids_.emplace(authority, id);
+  return id;
+}
+
 const std::string & BufferCore::lookupFrameString(CompactFrameID frame_id_num) const
 {
   if (frame_id_num >= frameIDs_reverse_.size()) {
@@ -938,37 +3349,123 @@ std::vector<std::string> BufferCore::getAllFrameNames() const
   return frames;
 }
 
-std::string BufferCore::allFramesAsString() const
+bool BufferCore::getFrameTable(FrameTable & table) const
+{
+  if (table.version_ == getFrameTableVersion()) {
+    return false;
+  }
+
+  std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+  table.names_.reserve(frameIDs_reverse_.size() - 1);
+  for (size_t counter = table.names_.size() + 1; counter < frameIDs_reverse_.size(); ++counter) {
+    table.names_.push_back(&frameIDs_reverse_[counter]);
+  }
+  table.version_ = frame_table_version_.load(std::memory_order_relaxed);
+  return true;
+}
+
+namespace
+{
+
+const char NO_AUTHORITY[] = "no recorded authority";
+
+/// The average rate the samples of a frame came in at, over at least 100 microseconds
+double frameRate(const FrameGraphEntry & frame)
 {
-  std::unique_lock<std::mutex> lock(frame_mutex_);
-  return this->allFramesAsStringNoLock();
+  tf2::Duration span = std::max<tf2::Duration>(
+    frame.latest - frame.oldest, std::chrono::microseconds(100));
+  return (frame.sample_count * 1e9) /
+         std::chrono::duration_cast<std::chrono::nanoseconds>(span).count();
 }
 
-std::string BufferCore::allFramesAsStringNoLock() const
+std::string framesAsString(const std::vector<FrameGraphEntry> & frames)
 {
-  std::stringstream mstream;
+  std::string out;
+  for (const FrameGraphEntry & frame : frames) {
+    if (frame.allocated) {
+      out += "Frame " + frame.frame_id + " exists with parent " +
+        (frame.parent.empty() ? "NO_PARENT" : frame.parent) + ".\n";
+    }
+  }
+  return out;
+}
 
-  TransformStorage temp;
+}  // anonymous namespace
 
-  // regular transforms
-  for (size_t counter = 1; counter < frames_.size(); counter++) {
-    TimeCacheInterfacePtr frame_ptr = getFrame(static_cast<CompactFrameID>(counter));
-    if (frame_ptr == NULL) {
+std::vector<FrameGraphEntry> BufferCore::getFrameGraph() const
+{
+  std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
+  return getFrameGraphNoLock();
+}
+
+std::vector<FrameGraphEntry> BufferCore::getFrameGraphNoLock() const
+{
+  std::vector<FrameGraphEntry> frames(frames_.size() - 1);
+  for (CompactFrameID frame_number = 1; frame_number < frames_.size(); ++frame_number) {
+    FrameGraphEntry & frame = frames[frame_number - 1];
+    frame.frame_id = frameIDs_reverse_[frame_number];
+    TimeCacheInterface * cache = getFrame(frame_number);
+    if (!cache) {
       continue;
     }
-    CompactFrameID frame_id_num;
-    if (frame_ptr->getData(TimePointZero, temp)) {
-      frame_id_num = temp.frame_id_;
-    } else {
-      frame_id_num = 0;
+    frame.allocated = true;
+    frame.is_static = frame_types_[frame_number] == FrameType::Static;
+    P_TimeAndFrameID latest = cache->getLatestTimeAndParent();
+    if (latest.second != 0) {
+      frame.parent = frameIDs_reverse_[latest.second];
     }
-    mstream << "Frame " << frameIDs_reverse_[counter] << " exists with parent " <<
-      frameIDs_reverse_[frame_id_num] << "." << std::endl;
+    frame.authority = lookupAuthority(frame_number);
+    frame.oldest = cache->getOldestTimestamp();
+    frame.latest = latest.first;
+    frame.sample_count = cache->getListLength();
+    frame.memory_bytes = cache->getMemoryUsage();
   }
+  return frames;
+}
 
-  return mstream.str();
+std::string BufferCore::allFramesAsString() const
+{
+  return framesAsString(getFrameGraph());
+}
+
+std::string BufferCore::allFramesAsStringNoLock() const
+{
+  return framesAsString(getFrameGraphNoLock());
 }
 
+namespace
+{
+
+/// A sequence that keeps up to N elements on the stack and only allocates for longer ones,
+/// so walking trees of typical depth does not touch the heap.
+template<typename T, size_t N>
+class SmallVector
+{
+public:
+  void push_back(const T & value)
+  {
+    if (heap_.empty() && size_ < N) {
+      stack_[size_++] = value;
+      return;
+    }
+    if (heap_.empty()) {
+      heap_.assign(stack_, stack_ + size_);
+    }
+    heap_.push_back(value);
+    ++size_;
+  }
+
+  T * begin() {return heap_.empty() ? stack_ : heap_.data();}
+  T * end() {return begin() + size_;}
+
+private:
+  T stack_[N];
+  std::vector<T> heap_;
+  size_t size_ = 0;
+};
+
+}  // anonymous namespace
+
 struct TimeAndFrameIDFrameComparator
 {
   explicit TimeAndFrameIDFrameComparator(CompactFrameID id)
@@ -991,7 +3488,7 @@ tf2::TF2Error BufferCore::getLatestCommonTime(
   if (source_id == 0 || target_id == 0) {return tf2::TF2Error::LOOKUP_ERROR;}
 
   if (source_id == target_id) {
-    TimeCacheInterfacePtr cache = getFrame(source_id);
+    TimeCacheInterface * cache = getFrame(source_id);
     // Set time to latest timestamp of frameid in case of target and source frame id are the same
     if (cache) {
       time = cache->getLatestTimestamp();
@@ -1001,7 +3498,7 @@ tf2::TF2Error BufferCore::getLatestCommonTime(
     return tf2::TF2Error::NO_ERROR;
   }
 
-  std::vector<P_TimeAndFrameID> lct_cache;
+  SmallVector<P_TimeAndFrameID, 64> lct_cache;
 
   // Walk the tree to its root from the source frame, accumulating the list of parent/time as
   //  well as the latest time in the target is a direct parent
@@ -1009,14 +3506,16 @@ tf2::TF2Error BufferCore::getLatestCommonTime(
   uint32_t depth = 0;
   TimePoint common_time = TimePoint::max();
   while (frame != 0) {
-    TimeCacheInterfacePtr cache = getFrame(frame);
+    FrameType type = frame_types_[frame];
 
-    if (!cache) {
+    if (type == FrameType::Unallocated) {
       // There will be no cache for the very root of the tree
       break;
     }
 
-    P_TimeAndFrameID latest = cache->getLatestTimeAndParent();
+    P_TimeAndFrameID latest = type == FrameType::Static ?
+      P_TimeAndFrameID(TimePointZero, static_segments_[frame].frame_id_) :
+      frames_[frame]->getLatestTimeAndParent();
 
     if (latest.second == 0) {
       // Just break out here... there may still be a path from source -> target
@@ -1059,13 +3558,15 @@ tf2::TF2Error BufferCore::getLatestCommonTime(
   common_time = TimePoint::max();
   CompactFrameID common_parent = 0;
   while (true) {
-    TimeCacheInterfacePtr cache = getFrame(frame);
+    FrameType type = frame_types_[frame];
 
-    if (!cache) {
+    if (type == FrameType::Unallocated) {
       break;
     }
 
-    P_TimeAndFrameID latest = cache->getLatestTimeAndParent();
+    P_TimeAndFrameID latest = type == FrameType::Static ?
+      P_TimeAndFrameID(TimePointZero, static_segments_[frame].frame_id_) :
+      frames_[frame]->getLatestTimeAndParent();
 
     if (latest.second == 0) {
       break;
@@ -1075,7 +3576,7 @@ tf2::TF2Error BufferCore::getLatestCommonTime(
       common_time = std::min(latest.first, common_time);
     }
 
-    std::vector<P_TimeAndFrameID>::iterator it = std::find_if(
+    P_TimeAndFrameID * it = std::find_if(
       lct_cache.begin(),
       lct_cache.end(), TimeAndFrameIDFrameComparator(latest.second));
     if (it != lct_cache.end()) {  // found a common parent
@@ -1113,8 +3614,8 @@ tf2::TF2Error BufferCore::getLatestCommonTime(
 
   // Loop through the source -> root list until we hit the common parent
   {
-    std::vector<P_TimeAndFrameID>::iterator it = lct_cache.begin();
-    std::vector<P_TimeAndFrameID>::iterator end = lct_cache.end();
+    P_TimeAndFrameID * it = lct_cache.begin();
+    P_TimeAndFrameID * end = lct_cache.end();
     for (; it != end; ++it) {
       if (it->first != TimePointZero) {
         common_time = std::min(common_time, it->first);
@@ -1136,66 +3637,33 @@ tf2::TF2Error BufferCore::getLatestCommonTime(
 
 std::string BufferCore::allFramesAsYAML(TimePoint current_time) const
 {
+  std::vector<FrameGraphEntry> frames = getFrameGraph();
   std::stringstream mstream;
-  std::unique_lock<std::mutex> lock(frame_mutex_);
-
-  TransformStorage temp;
 
-  if (frames_.size() == 1) {
+  if (frames.empty()) {
     mstream << "[]";
   }
 
-  mstream.precision(3);
-  mstream.setf(std::ios::fixed, std::ios::floatfield);
-
-  // one referenced for 0 is no frame
-  for (size_t counter = 1; counter < frames_.size(); counter++) {
-    CompactFrameID cfid = static_cast<CompactFrameID>(counter);
-    CompactFrameID frame_id_num;
-    TimeCacheInterfacePtr cache = getFrame(cfid);
-    if (!cache) {
-      continue;
-    }
+  mstream << std::fixed;  // fixed point notation
+  mstream.precision(3);  // 3 decimal places
 
-    if (!cache->getData(TimePointZero, temp)) {
+  for (const FrameGraphEntry & frame : frames) {
+    if (!frame.allocated || frame.parent.empty()) {
       continue;
     }
 
-    frame_id_num = temp.frame_id_;
-
-    std::string authority = "no recorded authority";
-    std::map<CompactFrameID, std::string>::const_iterator it = frame_authority_.find(cfid);
-    if (it != frame_authority_.end()) {
-      authority = it->second;
-    }
-
-    tf2::Duration dur1 = cache->getLatestTimestamp() - cache->getOldestTimestamp();
-    tf2::Duration dur2 = tf2::Duration(std::chrono::microseconds(100));
-
-    double rate;
-    if (dur1 > dur2) {
-      rate = (cache->getListLength() * 1e9) / std::chrono::duration_cast<std::chrono::nanoseconds>(
-        dur1).count();
-    } else {
-      rate = (cache->getListLength() * 1e9) / std::chrono::duration_cast<std::chrono::nanoseconds>(
-        dur2).count();
-    }
-
-    mstream << std::fixed;  // fixed point notation
-    mstream.precision(3);  // 3 decimal places
-    mstream << frameIDs_reverse_[cfid] << ": " << std::endl;
-    mstream << "  parent: '" << frameIDs_reverse_[frame_id_num] << "'" << std::endl;
-    mstream << "  broadcaster: '" << authority << "'" << std::endl;
-    mstream << "  rate: " << rate << std::endl;
-    mstream << "  most_recent_transform: " << displayTimePoint(cache->getLatestTimestamp()) <<
-      std::endl;
-    mstream << "  oldest_transform: " << displayTimePoint(cache->getOldestTimestamp()) << std::endl;
+    mstream << frame.frame_id << ": " << std::endl;
+    mstream << "  parent: '" << frame.parent << "'" << std::endl;
+    mstream << "  broadcaster: '" << (frame.authority.empty() ? NO_AUTHORITY : frame.authority) <<
+      "'" << std::endl;
+    mstream << "  rate: " << frameRate(frame) << std::endl;
+    mstream << "  most_recent_transform: " << displayTimePoint(frame.latest) << std::endl;
+    mstream << "  oldest_transform: " << displayTimePoint(frame.oldest) << std::endl;
     if (current_time != TimePointZero) {
-      mstream << "  transform_delay: " <<
-        durationToSec(current_time - cache->getLatestTimestamp()) << std::endl;
+      mstream << "  transform_delay: " << durationToSec(current_time - frame.latest) << std::endl;
     }
-    mstream << "  buffer_length: " << durationToSec(
-      cache->getLatestTimestamp() - cache->getOldestTimestamp()) << std::endl;
+    mstream << "  buffer_length: " << durationToSec(frame.latest - frame.oldest) << std::endl;
+    mstream << "  memory_bytes: " << frame.memory_bytes << std::endl;
   }
 
   return mstream.str();
@@ -1216,14 +3684,51 @@ TransformableRequestHandle BufferCore::addTransformableRequest(
   if (target_frame == source_frame) {
     return 0;
   }
+  return addTransformableRequestImpl(
+    RequestCallback{cb, nullptr}, target_frame, source_frame, time, nullptr, nullptr);
+}
+
+TransformableRequestHandle BufferCore::addTransformRequest(
+  const TransformRequestCallback & cb,
+  const std::string & target_frame,
+  const std::string & source_frame,
+  TimePoint time)
+{
+  if (target_frame == source_frame) {
+    const geometry_msgs::msg::TransformStamped msg = transformToMsg(
+      tf2::Transform::getIdentity(), time, target_frame, source_frame);
+    cb(0, target_frame, source_frame, time, TransformAvailable, &msg);
+    return 0;
+  }
+
+  tf2::Transform transform;
+  TimePoint time_out;
+  TransformableRequestHandle handle = addTransformableRequestImpl(
+    RequestCallback{nullptr, cb}, target_frame, source_frame, time, &transform, &time_out);
+  if (handle == 0) {
+    const geometry_msgs::msg::TransformStamped msg = transformToMsg(
+      transform, time_out, target_frame, source_frame);
+    cb(0, target_frame, source_frame, time, TransformAvailable, &msg);
+  } else if (handle == 0xffffffffffffffffULL) {
+    cb(0, target_frame, source_frame, time, TransformFailure, nullptr);
+  }
+  return handle;
+}
+
+TransformableRequestHandle BufferCore::addTransformableRequestImpl(
+  RequestCallback callback,
+  const std::string & target_frame,
+  const std::string & source_frame,
+  TimePoint time, tf2::Transform * transform, TimePoint * time_out)
+{
 
-  // Even though we only modify transformable_requests_ at the end of the
+  // Even though we only modify transformable_request_slots_ at the end of the
   // method, we still need to take the lock near the beginning.  This is to
   // ensure that we don't have a TOCTTOU race between this method and
   // testTransformableRequests.  If the lock were only at the end of this
   // method, the race occurs like this:
   //
-  // T1: addTransformableRequest, determines that needs to add to transformable_requests_
+  // T1: addTransformableRequest, determines that needs to add a request
   // T2: in testTransformableRequests already, holding the lock
   // T1: blocked getting lock
   // T2: calls all callbacks for outstanding transforms (doesn't include the current one)
@@ -1234,74 +3739,200 @@ TransformableRequestHandle BufferCore::addTransformableRequest(
   // current request will never get called.  We fix this by holding the mutex
   // across most of this method.
   std::unique_lock<std::mutex> lock(transformable_requests_mutex_);
+  std::shared_lock<std::shared_timed_mutex> frame_lock(frame_mutex_);
 
-  TransformableRequest req;
-  req.target_id = lookupFrameNumber(target_frame);
-  req.source_id = lookupFrameNumber(source_frame);
+  CompactFrameID target_id = lookupFrameNumber(target_frame);
+  CompactFrameID source_id = lookupFrameNumber(source_frame);
 
   // First check if the request is already transformable.  If it is, return immediately
-  if (canTransformInternal(req.target_id, req.source_id, time, 0)) {
+  if (transform ?
+    target_id != 0 && source_id != 0 &&
+    tryLookupTransformNoLock(target_id, source_id, time, *transform, *time_out, nullptr) ==
+    tf2::TF2Error::NO_ERROR :
+    canTransformNoLock(target_id, source_id, time, 0))
+  {
     return 0;
   }
 
   // Might not be transformable at all, ever (if it's too far in the past)
-  if (req.target_id && req.source_id) {
+  if (target_id && source_id) {
     TimePoint latest_time;
     // TODO(anyone): This is incorrect, but better than nothing.  Really we want the latest time for
     // any of the frames
-    getLatestCommonTime(req.target_id, req.source_id, latest_time, 0);
+    getLatestCommonTime(target_id, source_id, latest_time, 0);
     if ((latest_time != TimePointZero) && (time + cache_time_ < latest_time)) {
       return 0xffffffffffffffffULL;
     }
   }
 
-  {
-    std::unique_lock<std::mutex> lock(transformable_callbacks_mutex_);
-    TransformableCallbackHandle handle = ++transformable_callbacks_counter_;
-    while (!transformable_callbacks_.insert(std::make_pair(handle, cb)).second) {
-      handle = ++transformable_callbacks_counter_;
-    }
-
-    req.cb_handle = handle;
+  // Reuse a finished request, along with the storage of its strings and indexed frames
+  size_t slot;
+  if (free_request_slots_.empty()) {
+    slot = transformable_request_slots_.size();
+    transformable_request_slots_.emplace_back();
+  } else {
+    slot = free_request_slots_.back();
+    free_request_slots_.pop_back();
   }
-
+  TransformableRequest & req = transformable_request_slots_[slot];
+  req.target_id = target_id;
+  req.source_id = source_id;
+  req.stage_transform = transform != nullptr;
+  req.cb = std::move(callback);
   req.time = time;
-  req.request_handle = ++transformable_requests_counter_;
-  if (req.request_handle == 0 || req.request_handle == 0xffffffffffffffffULL) {
-    req.request_handle = 1;
-  }
+  req.request_handle = makeRequestHandle(slot, req.generation);
 
   if (req.target_id == 0) {
-    req.target_string = target_frame;
+    req.target_string.assign(target_frame);
+  } else {
+    req.target_string.clear();
   }
 
   if (req.source_id == 0) {
-    req.source_string = source_frame;
+    req.source_string.assign(source_frame);
+  } else {
+    req.source_string.clear();
   }
 
-  transformable_requests_.push_back(req);
+  indexTransformableRequest(req);
+  ++num_transformable_requests_;
 
   return req.request_handle;
 }
 
-void BufferCore::cancelTransformableRequest(TransformableRequestHandle handle)
+void BufferCore::findIndexedFrames(TransformableRequest & req) const
+{
+  req.indexed_frames.clear();
+
+  // Walk up from both ends of the request along the latest parents.  Frames above the common
+  // parent get indexed too, which only costs an unneeded recheck when they are updated.
+  CompactFrameID ends[2] = {req.source_id, req.target_id};
+  for (CompactFrameID frame : ends) {
+    uint32_t depth = 0;
+    while (frame != 0 && depth++ <= MAX_GRAPH_DEPTH) {
+      if (std::find(req.indexed_frames.begin(), req.indexed_frames.end(), frame) !=
+        req.indexed_frames.end())
+      {
+        break;
+      }
+      req.indexed_frames.push_back(frame);
+      frame = frame_parents_[frame];
+    }
+  }
+}
+
+void BufferCore::indexTransformableRequest(TransformableRequest & req)
+{
+  findIndexedFrames(req);
+  for (CompactFrameID frame : req.indexed_frames) {
+    if (frame >= transformable_requests_by_frame_.size()) {
+      transformable_requests_by_frame_.resize(frames_.size());
+    }
+    V_TimeToTransformableRequest & requests = transformable_requests_by_frame_[frame];
+    // Requests for the same time stay in the order they were made
+    auto it = std::upper_bound(requests.begin(), requests.end(), req.time, RequestTimeLess());
+    requests.insert(it, std::make_pair(req.time, req.request_handle));
+  }
+  num_indexed_requests_ += req.indexed_frames.size();
+}
+
+void BufferCore::rebuildTransformableRequestIndex()
+{
+  for (V_TimeToTransformableRequest & requests : transformable_requests_by_frame_) {
+    requests.clear();
+  }
+  if (transformable_requests_by_frame_.size() < frames_.size()) {
+    transformable_requests_by_frame_.resize(frames_.size());
+  }
+  num_indexed_requests_ = 0;
+  num_stale_indexed_requests_ = 0;
+  for (TransformableRequest & req : transformable_request_slots_) {
+    if (req.request_handle == 0) {
+      continue;
+    }
+    findIndexedFrames(req);
+    num_indexed_requests_ += req.indexed_frames.size();
+    for (CompactFrameID frame : req.indexed_frames) {
+      transformable_requests_by_frame_[frame].emplace_back(req.time, req.request_handle);
+    }
+  }
+  // Requests for the same time end up in the order of their handles
+  for (V_TimeToTransformableRequest & requests : transformable_requests_by_frame_) {
+    std::sort(requests.begin(), requests.end());
+  }
+}
+
+void BufferCore::unindexTransformableRequest(TransformableRequest & req)
+{
+  // Erasing from the sorted vectors would make finishing a request linear in the number of
+  // pending ones.  The entries stay until a sweep, which is paid for by the releases that
+  // left at least as many tombstones behind.
+  num_stale_indexed_requests_ += req.indexed_frames.size();
+  req.indexed_frames.clear();
+  if (num_stale_indexed_requests_ < 64 ||
+    2 * num_stale_indexed_requests_ < num_indexed_requests_)
+  {
+    return;
+  }
+  for (V_TimeToTransformableRequest & requests : transformable_requests_by_frame_) {
+    requests.erase(
+      std::remove_if(
+        requests.begin(), requests.end(),
+        [this](const std::pair<TimePoint, TransformableRequestHandle> & entry) {
+          return findTransformableRequest(entry.second) == nullptr;
+        }),
+      requests.end());
+  }
+  num_indexed_requests_ -= num_stale_indexed_requests_;
+  num_stale_indexed_requests_ = 0;
+}
+
+BufferCore::TransformableRequest * BufferCore::findTransformableRequest(
+  TransformableRequestHandle handle)
 {
-  std::unique_lock<std::mutex> tr_lock(transformable_requests_mutex_);
-  std::unique_lock<std::mutex> tc_lock(transformable_callbacks_mutex_);
+  const size_t slot = requestSlot(handle);
+  if (slot >= transformable_request_slots_.size()) {
+    return nullptr;
+  }
+  TransformableRequest & req = transformable_request_slots_[slot];
+  return req.request_handle == handle ? &req : nullptr;
+}
 
-  V_TransformableRequest::iterator remove_it = std::remove_if(transformable_requests_.begin(), transformable_requests_.end(),
-                                                              [handle](TransformableRequest req) { return handle == req.request_handle; });
-  for (V_TransformableRequest::iterator it = remove_it; it != transformable_requests_.end(); ++it) {
-    transformable_callbacks_.erase(it->cb_handle);
+void BufferCore::releaseTransformableRequest(size_t slot, RequestCallback & cb, bool unindex)
+{
+  TransformableRequest & req = transformable_request_slots_[slot];
+  cb.cb = std::move(req.cb.cb);
+  cb.ready_cb = std::move(req.cb.ready_cb);
+  req.cb.cb = nullptr;
+  req.cb.ready_cb = nullptr;
+  req.request_handle = 0;
+  // The next request in the slot gets a handle of its own
+  if (++req.generation == 0xffffffffu) {
+    req.generation = 0;
   }
+  free_request_slots_.push_back(slot);
+  --num_transformable_requests_;
+  // Only once the slot is free, so a sweep takes the entries of the request along
+  if (unindex) {
+    unindexTransformableRequest(req);
+  }
+  req.indexed_frames.clear();
+}
 
-  transformable_requests_.erase(remove_it, transformable_requests_.end());
+void BufferCore::cancelTransformableRequest(TransformableRequestHandle handle)
+{
+  // Destroyed after unlocking, whatever the callback holds may take locks of its own
+  RequestCallback cb;
+  std::lock_guard<std::mutex> lock(transformable_requests_mutex_);
+  if (findTransformableRequest(handle) != nullptr) {
+    releaseTransformableRequest(requestSlot(handle), cb);
+  }
 }
 
 // backwards compability for tf methods
 bool BufferCore::_frameExists(const std::string & frame_id_str) const
 {
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
   return frameIDs_.count(frame_id_str) != 0;
 }
 
@@ -1309,9 +3940,9 @@ bool BufferCore::_getParent(
   const std::string & frame_id, TimePoint time,
   std::string & parent) const
 {
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
   CompactFrameID frame_number = lookupFrameNumber(frame_id);
-  TimeCacheInterfacePtr frame = getFrame(frame_number);
+  TimeCacheInterface * frame = getFrame(frame_number);
 
   if (!frame) {
     return false;
@@ -1330,7 +3961,7 @@ void BufferCore::_getFrameStrings(std::vector<std::string> & vec) const
 {
   vec.clear();
 
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
 
   TransformStorage temp;
 
@@ -1339,131 +3970,279 @@ void BufferCore::_getFrameStrings(std::vector<std::string> & vec) const
   }
 }
 
-void BufferCore::testTransformableRequests()
+void BufferCore::testTransformableRequests(
+  const CompactFrameID * updated_frames, size_t num_updated_frames, bool topology_changed)
 {
   std::unique_lock<std::mutex> lock(transformable_requests_mutex_);
-  V_TransformableRequest::iterator it = transformable_requests_.begin();
-  for (; it != transformable_requests_.end(); ) {
-    TransformableRequest & req = *it;
+  if (num_transformable_requests_ == 0) {
+    return;
+  }
 
-    // One or both of the frames may not have existed when the request was originally made.
-    if (req.target_id == 0) {
-      req.target_id = lookupFrameNumber(req.target_string);
+  // The scratch vectors are members guarded by the lock, so they keep their capacity.  The
+  // strings of ready_requests_ do too as they are assigned, not cleared.  The ready list is
+  // taken out of the member as the callbacks run after unlocking, when another insert may
+  // need one as well.
+  std::vector<ReadyRequest> ready;
+  ready.swap(ready_requests_);
+  size_t num_ready = 0;
+  {
+    std::shared_lock<std::shared_timed_mutex> frame_lock(frame_mutex_);
+
+    std::vector<TransformableRequestHandle> & candidates = transformable_candidates_;
+    candidates.clear();
+    if (topology_changed) {
+      // The chains of any of the requests may have changed, so recheck and reindex all of them
+      candidates.reserve(num_transformable_requests_);
+      for (const TransformableRequest & req : transformable_request_slots_) {
+        if (req.request_handle != 0) {
+          candidates.push_back(req.request_handle);
+        }
+      }
+    } else {
+      for (size_t i = 0; i < num_updated_frames; ++i) {
+        CompactFrameID frame = updated_frames[i];
+        if (frame >= transformable_requests_by_frame_.size()) {
+          continue;
+        }
+        // A request newer than the latest data of a frame on its chain, plus how far the frame
+        // may be extrapolated, still can't be satisfied.  Static frames report a latest time of
+        // zero and cover all requests.
+        const V_TimeToTransformableRequest & requests = transformable_requests_by_frame_[frame];
+        auto end = requests.end();
+        TimeCacheInterface * cache = getFrame(frame);
+        if (cache && !requests.empty()) {
+          TimePoint latest_time = cache->getLatestTimestamp();
+          if (latest_time != TimePointZero) {
+            latest_time += getRetentionPolicyNoLock(frame).max_extrapolation;
+            end = std::upper_bound(requests.begin(), end, latest_time, RequestTimeLess());
+          }
+        }
+        for (auto it = requests.begin(); it != end; ++it) {
+          candidates.push_back(it->second);
+        }
+      }
+      if (num_updated_frames > 1) {
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+      }
     }
 
-    if (req.source_id == 0) {
-      req.source_id = lookupFrameNumber(req.source_string);
-    }
+    for (TransformableRequestHandle handle : candidates) {
+      TransformableRequest * found = findTransformableRequest(handle);
+      if (found == nullptr) {
+        continue;
+      }
+      TransformableRequest & req = *found;
 
-    TimePoint latest_time;
-    bool do_cb = false;
-    TransformableResult result = TransformAvailable;
-    // TODO(anyone): This is incorrect, but better than nothing. Really we want the latest time for
-    // any of the frames
-    getLatestCommonTime(req.target_id, req.source_id, latest_time, 0);
-    if ((latest_time != TimePointZero) && (req.time + cache_time_ < latest_time)) {
-      do_cb = true;
-      result = TransformFailure;
-    } else if (canTransformInternal(req.target_id, req.source_id, req.time, 0)) {
-      do_cb = true;
-      result = TransformAvailable;
-    }
+      // One or both of the frames may not have existed when the request was originally made.
+      if (req.target_id == 0) {
+        req.target_id = lookupFrameNumber(req.target_string);
+      }
 
-    if (do_cb) {
-      {
-        std::unique_lock<std::mutex> lock2(transformable_callbacks_mutex_);
-        M_TransformableCallback::iterator it = transformable_callbacks_.find(req.cb_handle);
-        if (it != transformable_callbacks_.end()) {
-          const TransformableCallback & cb = it->second;
-          cb(
-            req.request_handle, lookupFrameString(req.target_id), lookupFrameString(
-              req.source_id), req.time, result);
-          transformable_callbacks_.erase(req.cb_handle);
-        }
+      if (req.source_id == 0) {
+        req.source_id = lookupFrameNumber(req.source_string);
       }
 
-      if (transformable_requests_.size() > 1) {
-        transformable_requests_[it -
-          transformable_requests_.begin()] = transformable_requests_.back();
+      TimePoint latest_time;
+      bool do_cb = false;
+      TransformableResult result = TransformAvailable;
+      if (num_ready == ready.size()) {
+        ready.emplace_back();
+      }
+      ReadyRequest & ready_request = ready[num_ready];
+      // TODO(anyone): This is incorrect, but better than nothing. Really we want the latest time
+      // for any of the frames
+      getLatestCommonTime(req.target_id, req.source_id, latest_time, 0);
+      if ((latest_time != TimePointZero) && (req.time + cache_time_ < latest_time)) {
+        do_cb = true;
+        result = TransformFailure;
+      } else if (req.stage_transform) {
+        // Looking the transform up doubles as the check, the callback then gets the result
+        do_cb = req.target_id != 0 && req.source_id != 0 &&
+          tryLookupTransformNoLock(
+          req.target_id, req.source_id, req.time, ready_request.transform,
+          ready_request.time_out, nullptr) == tf2::TF2Error::NO_ERROR;
+        result = TransformAvailable;
+      } else if (canTransformNoLock(req.target_id, req.source_id, req.time, 0)) {
+        do_cb = true;
+        result = TransformAvailable;
       }
 
-      transformable_requests_.erase(transformable_requests_.end() - 1);
+      if (do_cb) {
+        ++num_ready;
+        ready_request.request_handle = req.request_handle;
+        ready_request.target_frame.assign(lookupFrameString(req.target_id));
+        ready_request.source_frame.assign(lookupFrameString(req.source_id));
+        ready_request.time = req.time;
+        ready_request.result = result;
+        // After a topology change the whole index is rebuilt below
+        releaseTransformableRequest(requestSlot(handle), ready_request.cb, !topology_changed);
+      }
+    }
+    if (topology_changed) {
+      rebuildTransformableRequestIndex();
+    }
+  }
+  callReadyRequests(lock, ready, num_ready);
+}
 
-      // If we've removed the last element, then the iterator is invalid
-      if (0u == transformable_requests_.size()) {
-        it = transformable_requests_.end();
+void BufferCore::callReadyRequests(
+  std::unique_lock<std::mutex> & lock, std::vector<ReadyRequest> & ready, size_t num_ready)
+{
+  lock.unlock();
+
+  // Call back without holding any of the mutexes, so the callbacks are free to look up
+  // transforms and to add requests of their own
+  for (size_t i = 0; i < num_ready; ++i) {
+    ReadyRequest & req = ready[i];
+    if (req.cb.cb || req.cb.ready_cb) {
+      TF2_TRACEPOINT(
+        transformable_request_ready, this, req.request_handle, req.target_frame.c_str(),
+        req.source_frame.c_str(), req.time.time_since_epoch().count(),
+        req.result == TransformAvailable);
+    }
+    if (req.cb.cb) {
+      req.cb.cb(req.request_handle, req.target_frame, req.source_frame, req.time, req.result);
+      req.cb.cb = nullptr;
+    } else if (req.cb.ready_cb) {
+      if (req.result == TransformAvailable) {
+        const geometry_msgs::msg::TransformStamped msg = transformToMsg(
+          req.transform, req.time_out, req.target_frame, req.source_frame);
+        req.cb.ready_cb(
+          req.request_handle, req.target_frame, req.source_frame, req.time, req.result, &msg);
+      } else {
+        req.cb.ready_cb(
+          req.request_handle, req.target_frame, req.source_frame, req.time, req.result, nullptr);
       }
-    } else {
-      ++it;
+      req.cb.ready_cb = nullptr;
     }
   }
+
+  // Hand the scratch space back, unless a concurrent insert grew a larger one meanwhile
+  lock.lock();
+  if (ready.capacity() > ready_requests_.capacity()) {
+    ready_requests_.swap(ready);
+  }
 }
 
-std::string BufferCore::_allFramesAsDot(TimePoint current_time) const
+FrameSubscriptionHandle BufferCore::subscribeFrame(
+  const std::string & frame_id, const FrameCallback & cb)
 {
-  std::stringstream mstream;
-  mstream << "digraph G {" << std::endl;
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  std::string stripped_buffer;
+  const std::string & stripped_frame_id = stripSlash(frame_id, stripped_buffer);
+  if (stripped_frame_id.empty()) {
+    CONSOLE_BRIDGE_logError("Ignoring frame subscription because frame_id not set");
+    return 0;
+  }
 
-  TransformStorage temp;
+  CompactFrameID frame_number;
+  {
+    std::unique_lock<std::shared_timed_mutex> lock(frame_mutex_);
+    frame_number = lookupOrInsertFrameNumber(stripped_frame_id);
+  }
 
-  if (frames_.size() == 1) {
-    mstream << "\"no tf data recieved\"";
+  std::lock_guard<std::mutex> lock(frame_subscriptions_mutex_);
+  FrameSubscriptionHandle handle = ++frame_subscriptions_counter_;
+  if (frame_number >= frame_subscriptions_.size()) {
+    frame_subscriptions_.resize(frame_number + 1);
   }
-  mstream.precision(3);
-  mstream.setf(std::ios::fixed, std::ios::floatfield);
-  // one referenced for 0 is no frame
-  for (size_t counter = 1; counter < frames_.size(); counter++) {
-    CompactFrameID frame_id_num;
-    TimeCacheInterfacePtr counter_frame = getFrame(static_cast<CompactFrameID>(counter));
-    if (!counter_frame) {
-      continue;
-    }
-    if (!counter_frame->getData(TimePointZero, temp)) {
-      continue;
-    } else {
-      frame_id_num = temp.frame_id_;
-    }
-    std::string authority = "no recorded authority";
-    std::map<CompactFrameID, std::string>::const_iterator it = frame_authority_.find(static_cast<CompactFrameID>(counter));
-    if (it != frame_authority_.end()) {
-      authority = it->second;
+  frame_subscriptions_[frame_number].push_back(
+    FrameSubscription{handle, std::make_shared<const FrameCallback>(cb)});
+  frame_subscription_frames_.emplace(handle, frame_number);
+  ++num_frame_subscriptions_;
+  return handle;
+}
+
+void BufferCore::unsubscribeFrame(FrameSubscriptionHandle handle)
+{
+  std::lock_guard<std::mutex> lock(frame_subscriptions_mutex_);
+  auto it = frame_subscription_frames_.find(handle);
+  if (it == frame_subscription_frames_.end()) {
+    return;
+  }
+  std::vector<FrameSubscription> & subscriptions = frame_subscriptions_[it->second];
+  for (auto sub = subscriptions.begin(); sub != subscriptions.end(); ++sub) {
+    if (sub->handle == handle) {
+      subscriptions.erase(sub);
+      break;
     }
+  }
+  frame_subscription_frames_.erase(it);
+  --num_frame_subscriptions_;
+}
 
-    tf2::Duration dur1 = counter_frame->getLatestTimestamp() - counter_frame->getOldestTimestamp();
-    tf2::Duration dur2 = std::chrono::microseconds(100);
+void BufferCore::notifyFrameSubscribers(
+  const CompactFrameID * updated_frames, size_t num_updated_frames)
+{
+  if (num_frame_subscriptions_.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
 
-    double rate;
-    if (dur1 > dur2) {
-      rate = (counter_frame->getListLength() * 1e9) /
-        std::chrono::duration_cast<std::chrono::nanoseconds>(dur1).count();
-    } else {
-      rate = (counter_frame->getListLength() * 1e9) /
-        std::chrono::duration_cast<std::chrono::nanoseconds>(dur2).count();
+  struct Notification
+  {
+    FrameSubscription subscription;
+    geometry_msgs::msg::TransformStamped latest;
+  };
+  std::vector<Notification> notifications;
+  {
+    std::lock_guard<std::mutex> lock(frame_subscriptions_mutex_);
+    std::shared_lock<std::shared_timed_mutex> frame_lock(frame_mutex_);
+    for (size_t i = 0; i < num_updated_frames; ++i) {
+      CompactFrameID frame = updated_frames[i];
+      if (frame >= frame_subscriptions_.size() || frame_subscriptions_[frame].empty()) {
+        continue;
+      }
+      TimeCacheInterface * cache = getFrame(frame);
+      TransformStorage latest;
+      if (!cache || (!cache->getLatestSnapshot(latest) && !cache->getData(TimePointZero, latest)))
+      {
+        continue;
+      }
+      geometry_msgs::msg::TransformStamped msg = transformToMsg(
+        tf2::Transform(latest.rotation_, latest.translation_), latest.stamp_,
+        lookupFrameString(latest.frame_id_), lookupFrameString(frame));
+      for (const FrameSubscription & subscription : frame_subscriptions_[frame]) {
+        notifications.push_back(Notification{subscription, msg});
+      }
     }
+  }
+
+  for (const Notification & notification : notifications) {
+    (*notification.subscription.cb)(notification.subscription.handle, notification.latest);
+  }
+}
+
+std::string BufferCore::_allFramesAsDot(TimePoint current_time) const
+{
+  std::vector<FrameGraphEntry> frames = getFrameGraph();
+  std::stringstream mstream;
+  mstream << "digraph G {" << std::endl;
+
+  if (frames.empty()) {
+    mstream << "\"no tf data recieved\"";
+  }
+  mstream << std::fixed;  // fixed point notation
+  mstream.precision(3);  // 3 decimal places
 
-    mstream << std::fixed;  // fixed point notation
-    mstream.precision(3);  // 3 decimal places
-    mstream << "\"" << frameIDs_reverse_[frame_id_num] << "\"" << " -> " <<
-      "\"" << frameIDs_reverse_[counter] << "\"" << "[label=\"" <<
-      "Broadcaster: " << authority << "\\n" <<
-      "Average rate: " << rate << " Hz\\n" <<
-      "Most recent transform: " << displayTimePoint(counter_frame->getLatestTimestamp()) << " ";
+  for (const FrameGraphEntry & frame : frames) {
+    if (!frame.allocated || frame.parent.empty()) {
+      continue;
+    }
+    mstream << "\"" << frame.parent << "\"" << " -> " <<
+      "\"" << frame.frame_id << "\"" << "[label=\"" <<
+      "Broadcaster: " << (frame.authority.empty() ? NO_AUTHORITY : frame.authority) << "\\n" <<
+      "Average rate: " << frameRate(frame) << " Hz\\n" <<
+      "Most recent transform: " << displayTimePoint(frame.latest) << " ";
     if (current_time != TimePointZero) {
-      mstream << "( " << durationToSec(current_time - counter_frame->getLatestTimestamp()) <<
-        " sec old)";
+      mstream << "( " << durationToSec(current_time - frame.latest) << " sec old)";
     }
     mstream << "\\n" <<
-      "Buffer length: " << durationToSec(
-      counter_frame->getLatestTimestamp() - counter_frame->getOldestTimestamp()) << " sec\\n" <<
+      "Buffer length: " << durationToSec(frame.latest - frame.oldest) << " sec\\n" <<
       "\"];" << std::endl;
   }
 
-  // one referenced for 0 is no frame
-  for (size_t counter = 1; counter < frames_.size(); counter++) {
-    CompactFrameID frame_id_num;
-    TimeCacheInterfacePtr counter_frame = getFrame(static_cast<CompactFrameID>(counter));
-    if (!counter_frame) {
+  for (const FrameGraphEntry & frame : frames) {
+    if (!frame.allocated) {
       if (current_time != TimePointZero) {
         mstream << "edge [style=invis];" << std::endl;
         mstream <<
@@ -1471,17 +4250,12 @@ std::string BufferCore::_allFramesAsDot(TimePoint current_time) const
                 <<
           "\"Recorded at time: " << displayTimePoint(current_time) <<
           "\"[ shape=plaintext ] ;\n " <<
-          "}" << "->" << "\"" << frameIDs_reverse_[counter] << "\";" << std::endl;
+          "}" << "->" << "\"" << frame.frame_id << "\";" << std::endl;
       }
       continue;
     }
-    if (counter_frame->getData(TimePointZero, temp)) {
-      frame_id_num = temp.frame_id_;
-    } else {
-      frame_id_num = 0;
-    }
 
-    if (frameIDs_reverse_[frame_id_num] == "NO_PARENT") {
+    if (frame.parent.empty()) {
       mstream << "edge [style=invis];" << std::endl;
       mstream <<
         " subgraph cluster_legend { style=bold; color=black; label =\"view_frames Result\";\n";
@@ -1489,7 +4263,7 @@ std::string BufferCore::_allFramesAsDot(TimePoint current_time) const
         mstream << "\"Recorded at time: " << displayTimePoint(current_time) <<
           "\"[ shape=plaintext ] ;\n ";
       }
-      mstream << "}" << "->" << "\"" << frameIDs_reverse_[counter] << "\";" << std::endl;
+      mstream << "}" << "->" << "\"" << frame.frame_id << "\";" << std::endl;
     }
   }
   mstream << "}";
@@ -1512,7 +4286,7 @@ void BufferCore::_chainAsVector(
   output.clear();  // empty vector
 
   std::stringstream mstream;
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  std::shared_lock<std::shared_timed_mutex> lock(frame_mutex_);
 
   TransformAccum accum;
 
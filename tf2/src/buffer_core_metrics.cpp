@@ -0,0 +1,174 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "tf2/buffer_core_metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace tf2
+{
+
+namespace
+{
+
+size_t latencyBucket(uint64_t latency_ns)
+{
+  size_t bucket = 0;
+  while (latency_ns > 1 && bucket + 1 < LatencyHistogram::BUCKETS) {
+    latency_ns >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+void add(std::atomic<uint64_t> & counter, uint64_t value)
+{
+  counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t get(const std::atomic<uint64_t> & counter)
+{
+  return counter.load(std::memory_order_relaxed);
+}
+
+}  // namespace
+
+uint64_t LatencyHistogram::count() const
+{
+  uint64_t total = 0;
+  for (uint64_t bucket_count : counts) {
+    total += bucket_count;
+  }
+  return total;
+}
+
+double LatencyHistogram::meanNs() const
+{
+  uint64_t calls = count();
+  return calls ? static_cast<double>(total_ns) / static_cast<double>(calls) : 0.0;
+}
+
+uint64_t LatencyHistogram::percentileNs(double fraction) const
+{
+  uint64_t calls = count();
+  if (calls == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(std::max(0.0, std::min(1.0, fraction)) * calls);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BUCKETS; ++i) {
+    seen += counts[i];
+    if (seen > rank || seen == calls) {
+      return uint64_t(2) << i;
+    }
+  }
+  return uint64_t(2) << (BUCKETS - 1);
+}
+
+uint64_t BufferCoreCallMetrics::failureCount() const
+{
+  uint64_t total = 0;
+  for (uint64_t count : failures) {
+    total += count;
+  }
+  return total;
+}
+
+BufferCoreMetricsRecorder::Shard & BufferCoreMetricsRecorder::localShard()
+{
+  // Threads are dealt out to the shards in the order they first record something
+  static std::atomic<size_t> next_shard(0);
+  thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+  return shards_[shard];
+}
+
+void BufferCoreMetricsRecorder::recordCall(
+  BufferCoreCall call, TF2Error error, uint64_t latency_ns)
+{
+  CallCounters & counters = localShard().calls[static_cast<size_t>(call)];
+  add(counters.calls, 1);
+  if (error != TF2Error::NO_ERROR) {
+    add(counters.failures[static_cast<size_t>(error)], 1);
+  }
+  add(counters.latency[latencyBucket(latency_ns)], 1);
+  add(counters.latency_total_ns, latency_ns);
+}
+
+void BufferCoreMetricsRecorder::recordExclusiveLock(uint64_t wait_ns, uint64_t hold_ns)
+{
+  Shard & shard = localShard();
+  add(shard.lock_count, 1);
+  add(shard.lock_wait_ns, wait_ns);
+  add(shard.lock_hold_ns, hold_ns);
+}
+
+void BufferCoreMetricsRecorder::collect(BufferCoreMetrics & metrics) const
+{
+  BufferCoreCallMetrics * calls[CALLS] = {&metrics.lookup, &metrics.can_transform, &metrics.insert};
+  for (const Shard & shard : shards_) {
+    for (size_t c = 0; c < CALLS; ++c) {
+      const CallCounters & counters = shard.calls[c];
+      calls[c]->calls += get(counters.calls);
+      for (size_t i = 0; i < counters.failures.size(); ++i) {
+        calls[c]->failures[i] += get(counters.failures[i]);
+      }
+      for (size_t i = 0; i < LatencyHistogram::BUCKETS; ++i) {
+        calls[c]->latency.counts[i] += get(counters.latency[i]);
+      }
+      calls[c]->latency.total_ns += get(counters.latency_total_ns);
+    }
+    metrics.exclusive_lock_count += get(shard.lock_count);
+    metrics.exclusive_lock_wait_ns += get(shard.lock_wait_ns);
+    metrics.exclusive_lock_hold_ns += get(shard.lock_hold_ns);
+  }
+}
+
+void BufferCoreMetricsRecorder::reset()
+{
+  for (Shard & shard : shards_) {
+    for (CallCounters & counters : shard.calls) {
+      counters.calls.store(0, std::memory_order_relaxed);
+      for (auto & count : counters.failures) {
+        count.store(0, std::memory_order_relaxed);
+      }
+      for (auto & count : counters.latency) {
+        count.store(0, std::memory_order_relaxed);
+      }
+      counters.latency_total_ns.store(0, std::memory_order_relaxed);
+    }
+    shard.lock_count.store(0, std::memory_order_relaxed);
+    shard.lock_wait_ns.store(0, std::memory_order_relaxed);
+    shard.lock_hold_ns.store(0, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace tf2
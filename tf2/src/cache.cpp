@@ -30,7 +30,12 @@
 
 #include <assert.h>
 
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #include <utility>
 
 #include "tf2/time_cache.h"
@@ -58,8 +63,143 @@ TransformStorage::TransformStorage(
 {
 }
 
-TimeCache::TimeCache(tf2::Duration max_storage_time)
-: max_storage_time_(max_storage_time)
+TransformSnapshot::TransformSnapshot()
+: sequence_(0),
+  valid_(false),
+  stamp_(0),
+  frame_id_(0),
+  child_frame_id_(0)
+{
+  for (std::atomic<tf2Scalar> & value : rotation_) {
+    value.store(0.0, std::memory_order_relaxed);
+  }
+  for (std::atomic<tf2Scalar> & value : translation_) {
+    value.store(0.0, std::memory_order_relaxed);
+  }
+}
+
+void TransformSnapshot::store(const TransformStorage & sample)
+{
+  uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+  sequence_.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  for (int i = 0; i < 4; ++i) {
+    rotation_[i].store(sample.rotation_[i], std::memory_order_relaxed);
+  }
+  for (int i = 0; i < 3; ++i) {
+    translation_[i].store(sample.translation_[i], std::memory_order_relaxed);
+  }
+  stamp_.store(sample.stamp_.time_since_epoch().count(), std::memory_order_relaxed);
+  frame_id_.store(sample.frame_id_, std::memory_order_relaxed);
+  child_frame_id_.store(sample.child_frame_id_, std::memory_order_relaxed);
+  valid_.store(true, std::memory_order_relaxed);
+
+  sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+void TransformSnapshot::reset()
+{
+  uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+  sequence_.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  valid_.store(false, std::memory_order_relaxed);
+  sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+bool TransformSnapshot::load(TransformStorage & sample) const
+{
+  // Writes are rare compared to reads, give up after a few collisions rather than spinning
+  for (int attempt = 0; attempt < 4; ++attempt) {
+    uint32_t sequence = sequence_.load(std::memory_order_acquire);
+    if (sequence & 1) {
+      continue;
+    }
+
+    bool valid = valid_.load(std::memory_order_relaxed);
+    sample.rotation_.setValue(
+      rotation_[0].load(std::memory_order_relaxed), rotation_[1].load(std::memory_order_relaxed),
+      rotation_[2].load(std::memory_order_relaxed), rotation_[3].load(std::memory_order_relaxed));
+    sample.translation_.setValue(
+      translation_[0].load(std::memory_order_relaxed),
+      translation_[1].load(std::memory_order_relaxed),
+      translation_[2].load(std::memory_order_relaxed));
+    sample.stamp_ = TimePoint(std::chrono::nanoseconds(stamp_.load(std::memory_order_relaxed)));
+    sample.frame_id_ = frame_id_.load(std::memory_order_relaxed);
+    sample.child_frame_id_ = child_frame_id_.load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) == sequence) {
+      return valid;
+    }
+  }
+  return false;
+}
+
+constexpr uint32_t SharedSpinLock::WRITER;
+
+SharedSpinLock::SharedSpinLock()
+: state_(0)
+{
+}
+
+namespace
+{
+/// Back off while waiting for a SharedSpinLock, soon letting the holder run on this core
+inline void spinWait(unsigned int & spins)
+{
+  if (++spins > 64) {
+    std::this_thread::yield();
+  }
+}
+}  // namespace
+
+void SharedSpinLock::lock()
+{
+  unsigned int spins = 0;
+  // Claim the writer bit first so no new readers get in, then wait for the current ones
+  while (state_.fetch_or(WRITER, std::memory_order_acquire) & WRITER) {
+    spinWait(spins);
+  }
+  while (state_.load(std::memory_order_acquire) != WRITER) {
+    spinWait(spins);
+  }
+}
+
+void SharedSpinLock::unlock()
+{
+  state_.fetch_and(~WRITER, std::memory_order_release);
+}
+
+void SharedSpinLock::lock_shared()
+{
+  unsigned int spins = 0;
+  while (state_.fetch_add(1, std::memory_order_acquire) & WRITER) {
+    state_.fetch_sub(1, std::memory_order_relaxed);
+    while (state_.load(std::memory_order_relaxed) & WRITER) {
+      spinWait(spins);
+    }
+  }
+}
+
+void SharedSpinLock::unlock_shared()
+{
+  state_.fetch_sub(1, std::memory_order_release);
+}
+
+template<class Sample>
+BasicTimeCache<Sample>::BasicTimeCache(tf2::Duration max_storage_time)
+: storage_head_(0),
+  storage_size_(0),
+  max_storage_time_(max_storage_time),
+  default_max_storage_time_(max_storage_time),
+  max_samples_(MAX_LENGTH_LINKED_LIST),
+  decimation_age_(tf2::Duration::zero()),
+  decimation_interval_(tf2::Duration::zero()),
+  decimated_size_(0),
+  nlerp_min_dot_(getNlerpMinDot(RetentionPolicy())),
+  max_extrapolation_(tf2::Duration::zero()),
+  cursor_(0)
 {}
 
 // Avoid ODR collisions https://github.com/ros/geometry2/issues/175
@@ -96,26 +236,162 @@ void createExtrapolationException3(TimePoint t0, TimePoint t1, std::string * err
     *error_str = ss.str();
   }
 }
+
+// Widen the values of a sample for interpolating them, without copying full precision ones
+inline const Quaternion & getRotation(const TransformStorage & sample) {return sample.rotation_;}
+inline Quaternion getRotation(const Float32TransformStorage & sample) {return sample.getRotation();}
+inline const Vector3 & getTranslation(const TransformStorage & sample)
+{
+  return sample.translation_;
+}
+inline Vector3 getTranslation(const Float32TransformStorage & sample)
+{
+  return sample.getTranslation();
+}
+
+/** \brief The transform at time from the samples around it, the same way in every cache.
+ * one is the last sample at or before time and two the next one.  Past the newest sample, two
+ * is the newest one and one the last before its stamp, and time is extrapolated to if it is at
+ * most max_extrapolation past two.
+ * \param output Set to the result, nullptr to only check that time can be looked up
+ * \return false with the extrapolation error in error_str if time can not be looked up
+ */
+template<class Sample>
+bool interpolateSamples(
+  const Sample & one, const Sample & two, TimePoint time, tf2Scalar min_dot,
+  tf2::Duration max_extrapolation, TransformStorage * output, std::string * error_str)
+{
+  if (time > two.stamp_) {
+    // Extrapolate at the velocity between the two samples, if allowed
+    if (time - two.stamp_ > max_extrapolation || one.stamp_ == two.stamp_ ||
+      one.frame_id_ != two.frame_id_)
+    {
+      createExtrapolationException2(time, two.stamp_, error_str);
+      return false;
+    }
+  } else if (one.frame_id_ != two.frame_id_) {
+    // The parent changed in between, so there is nothing to interpolate
+    if (output) {
+      *output = one;
+    }
+    return true;
+  }
+  if (!output) {
+    return true;
+  }
+  // Check for zero distance case
+  if (two.stamp_ == one.stamp_) {
+    *output = two;
+    return true;
+  }
+  // Calculate the ratio
+  tf2Scalar ratio = static_cast<double>((time - one.stamp_).count()) /
+    static_cast<double>((two.stamp_ - one.stamp_).count());
+
+  // Interpolate translation
+  output->translation_.setInterpolate3(getTranslation(one), getTranslation(two), ratio);
+
+  // Interpolate rotation
+  output->rotation_ = interpolateRotation(getRotation(one), getRotation(two), ratio, min_dot);
+
+  output->stamp_ = one.stamp_;
+  output->frame_id_ = one.frame_id_;
+  output->child_frame_id_ = one.child_frame_id_;
+  return true;
+}
+
+// The caches keeping full precision samples declare this one, so they all look up the same way
+bool interpolateSamples(
+  const TransformStorage & one, const TransformStorage & two, TimePoint time, tf2Scalar min_dot,
+  tf2::Duration max_extrapolation, TransformStorage * output, std::string * error_str)
+{
+  return interpolateSamples<TransformStorage>(
+    one, two, time, min_dot, max_extrapolation, output, error_str);
+}
 }  // namespace cache
 
-uint8_t TimeCache::findClosest(
-  TransformStorage * & one, TransformStorage * & two,
+template<class Sample>
+size_t BasicTimeCache<Sample>::upperBound(TimePoint time)
+{
+  return upperBound(time, 0, storage_size_);
+}
+
+template<class Sample>
+size_t BasicTimeCache<Sample>::upperBound(TimePoint time, size_t first, size_t last)
+{
+  size_t count = last - first;
+  while (count > 0) {
+    size_t step = count / 2;
+    if (sampleAt(first + step).stamp_ <= time) {
+      first += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  return first;
+}
+
+template<class Sample>
+size_t BasicTimeCache<Sample>::upperBoundFrom(TimePoint time, size_t hint)
+{
+  // Gallop away from the hint in steps doubling in size until the result is bracketed, so a
+  // result d samples from the hint costs O(log d)
+  hint = std::min(hint, storage_size_ - 1);
+  size_t first;
+  size_t last;
+  if (sampleAt(hint).stamp_ <= time) {
+    first = hint + 1;
+    size_t step = 1;
+    last = first;
+    while (last < storage_size_ && sampleAt(last).stamp_ <= time) {
+      first = last + 1;
+      step *= 2;
+      last = std::min(first + step, storage_size_);
+    }
+  } else {
+    last = hint;
+    size_t step = 1;
+    first = last;
+    while (first > 0 && sampleAt(first - 1).stamp_ > time) {
+      last = first - 1;
+      step *= 2;
+      first = last > step ? last - step : 0;
+    }
+  }
+  return upperBound(time, first, last);
+}
+
+template<class Sample>
+void BasicTimeCache<Sample>::grow(size_t capacity)
+{
+  std::vector<Sample> grown(capacity);
+  for (size_t i = 0; i < storage_size_; ++i) {
+    grown[i] = sampleAt(i);
+  }
+  storage_.swap(grown);
+  storage_head_ = 0;
+}
+
+template<class Sample>
+uint8_t BasicTimeCache<Sample>::findClosest(
+  Sample * & one, Sample * & two,
   TimePoint target_time, std::string * error_str)
 {
   // No values stored
-  if (storage_.empty()) {
+  if (storage_size_ == 0) {
     return 0;
   }
 
   // If time == 0 return the latest
   if (target_time == TimePointZero) {
-    one = &storage_.front();
+    one = &newest();
     return 1;
   }
 
   // One value stored
-  if (++storage_.begin() == storage_.end()) {
-    TransformStorage & ts = *storage_.begin();
+  if (storage_size_ == 1) {
+    Sample & ts = oldest();
     if (ts.stamp_ == target_time) {
       one = &ts;
       return 1;
@@ -125,19 +401,23 @@ uint8_t TimeCache::findClosest(
     }
   }
 
-  TimePoint latest_time = (*storage_.begin()).stamp_;
-  TimePoint earliest_time = (*(storage_.rbegin())).stamp_;
+  TimePoint latest_time = newest().stamp_;
+  TimePoint earliest_time = oldest().stamp_;
 
   if (target_time == latest_time) {
-    one = &(*storage_.begin());
+    one = &newest();
     return 1;
   } else if (target_time == earliest_time) {
-    one = &(*storage_.rbegin());
+    one = &oldest();
     return 1;
   } else {   // Catch cases that would require extrapolation
     if (target_time > latest_time) {
-      cache::createExtrapolationException2(target_time, latest_time, error_str);
-      return 0;
+      // The newest sample and the last one before its stamp, cache::interpolateSamples()
+      // decides whether to extrapolate from them
+      two = &newest();
+      one = earliest_time < latest_time ?
+        &sampleAt(upperBound(latest_time - tf2::Duration(1)) - 1) : two;
+      return 2;
     } else {
       if (target_time < earliest_time) {
         cache::createExtrapolationException3(target_time, earliest_time, error_str);
@@ -147,52 +427,27 @@ uint8_t TimeCache::findClosest(
   }
 
   // At least 2 values stored
-  // Find the first value less than the target value
-  L_TransformStorage::iterator storage_it = storage_.begin();
-  while (storage_it != storage_.end()) {
-    if (storage_it->stamp_ <= target_time) {
-      break;
-    }
-    storage_it++;
-  }
+  // Find the first value newer than the target value, the one before it is the last value
+  // less than or equal to the target.  Lookups mostly come in time order, so start from where
+  // the last one ended up.
+  size_t newer = upperBoundFrom(target_time, cursor_.load(std::memory_order_relaxed));
+  cursor_.store(newer, std::memory_order_relaxed);
 
   // Finally the case were somewhere in the middle  Guarenteed no extrapolation :-)
-  one = &*(storage_it);  // Older
-  two = &*(--storage_it);  // Newer
+  one = &sampleAt(newer - 1);  // Older
+  two = &sampleAt(newer);  // Newer
   return 2;
 }
 
-void TimeCache::interpolate(
-  const TransformStorage & one, const TransformStorage & two,
-  TimePoint time, TransformStorage & output)
-{
-  // Check for zero distance case
-  if (two.stamp_ == one.stamp_) {
-    output = two;
-    return;
-  }
-  // Calculate the ratio
-  tf2Scalar ratio = static_cast<double>((time - one.stamp_).count()) /
-    static_cast<double>((two.stamp_ - one.stamp_).count());
-
-  // Interpolate translation
-  output.translation_.setInterpolate3(one.translation_, two.translation_, ratio);
-
-  // Interpolate rotation
-  output.rotation_ = slerp(one.rotation_, two.rotation_, ratio);
-
-  output.stamp_ = one.stamp_;
-  output.frame_id_ = one.frame_id_;
-  output.child_frame_id_ = one.child_frame_id_;
-}
-
-bool TimeCache::getData(
+template<class Sample>
+bool BasicTimeCache<Sample>::getData(
   TimePoint time, TransformStorage & data_out,
   std::string * error_str)
 {
+  std::shared_lock<SharedSpinLock> lock(lock_);
   // returns false if data not available
-  TransformStorage * p_temp_1;
-  TransformStorage * p_temp_2;
+  Sample * p_temp_1;
+  Sample * p_temp_2;
 
   int num_nodes = findClosest(p_temp_1, p_temp_2, time, error_str);
   if (num_nodes == 0) {
@@ -200,96 +455,403 @@ bool TimeCache::getData(
   } else if (num_nodes == 1) {
     data_out = *p_temp_1;
   } else if (num_nodes == 2) {
-    if (p_temp_1->frame_id_ == p_temp_2->frame_id_) {
-      interpolate(*p_temp_1, *p_temp_2, time, data_out);
-    } else {
-      data_out = *p_temp_1;
-    }
+    return cache::interpolateSamples(
+      *p_temp_1, *p_temp_2, time, nlerp_min_dot_, max_extrapolation_, &data_out, error_str);
   } else {
     assert(0);
   }
   return true;
 }
 
-CompactFrameID TimeCache::getParent(TimePoint time, std::string * error_str)
+template<class Sample>
+bool BasicTimeCache<Sample>::getDataBatch(
+  const std::vector<TimePoint> & times, std::vector<TransformStorage> & data_out,
+  std::string * error_str)
+{
+  std::shared_lock<SharedSpinLock> lock(lock_);
+  data_out.resize(times.size());
+  if (times.empty()) {
+    return true;
+  }
+  if (storage_size_ == 0) {
+    return false;
+  }
+
+  // The requested times are sorted, so the range they all fall in can be checked up front
+  TimePoint latest_time = newest().stamp_;
+  TimePoint earliest_time = oldest().stamp_;
+  if (storage_size_ == 1) {
+    for (TimePoint time : times) {
+      if (time != earliest_time) {
+        cache::createExtrapolationException1(time, earliest_time, error_str);
+        return false;
+      }
+    }
+    std::fill(data_out.begin(), data_out.end(), oldest());
+    return true;
+  }
+  // The times past the newest sample are extrapolated from the same samples findClosest() picks
+  const Sample * extrapolate_from = &newest();
+  if (times.back() > latest_time) {
+    if (earliest_time < latest_time) {
+      extrapolate_from = &sampleAt(upperBound(latest_time - tf2::Duration(1)) - 1);
+    }
+    if (!cache::interpolateSamples(
+        *extrapolate_from, newest(), times.back(), nlerp_min_dot_, max_extrapolation_, nullptr,
+        error_str))
+    {
+      return false;
+    }
+  }
+  if (times.front() < earliest_time) {
+    cache::createExtrapolationException3(times.front(), earliest_time, error_str);
+    return false;
+  }
+
+  // Sweep the samples from oldest to newest along with the times, the same way findClosest()
+  // would pick them for each time on its own
+  size_t newer = upperBound(times.front());
+  for (size_t i = 0; i < times.size(); ++i) {
+    TimePoint time = times[i];
+    if (time == latest_time) {
+      data_out[i] = newest();
+      continue;
+    }
+    if (time == earliest_time) {
+      data_out[i] = oldest();
+      continue;
+    }
+    if (time > latest_time) {
+      cache::interpolateSamples(
+        *extrapolate_from, newest(), time, nlerp_min_dot_, max_extrapolation_, &data_out[i],
+        nullptr);
+      continue;
+    }
+    while (sampleAt(newer).stamp_ <= time) {
+      ++newer;
+    }
+
+    cache::interpolateSamples(
+      sampleAt(newer - 1), sampleAt(newer), time, nlerp_min_dot_, max_extrapolation_,
+      &data_out[i], nullptr);
+  }
+  return true;
+}
+
+template<class Sample>
+CompactFrameID BasicTimeCache<Sample>::getParent(TimePoint time, std::string * error_str)
 {
-  TransformStorage * p_temp_1;
-  TransformStorage * p_temp_2;
+  std::shared_lock<SharedSpinLock> lock(lock_);
+  Sample * p_temp_1;
+  Sample * p_temp_2;
 
   int num_nodes = findClosest(p_temp_1, p_temp_2, time, error_str);
   if (num_nodes == 0) {
     return 0;
   }
+  if (num_nodes == 2 &&
+    !cache::interpolateSamples(
+      *p_temp_1, *p_temp_2, time, nlerp_min_dot_, max_extrapolation_, nullptr, error_str))
+  {
+    return 0;
+  }
 
   return p_temp_1->frame_id_;
 }
 
-bool TimeCache::insertData(const TransformStorage & new_data)
+template<class Sample>
+bool BasicTimeCache<Sample>::insertData(const TransformStorage & new_data)
 {
-  L_TransformStorage::iterator storage_it = storage_.begin();
+  std::lock_guard<SharedSpinLock> lock(lock_);
+  return insertDataLocked(new_data);
+}
 
-  if (storage_it != storage_.end()) {
-    if (storage_it->stamp_ > new_data.stamp_ + max_storage_time_) {
+template<class Sample>
+bool BasicTimeCache<Sample>::insertDataLocked(const TransformStorage & new_data)
+{
+  if (storage_size_ > 0) {
+    if (newest().stamp_ > new_data.stamp_ + max_storage_time_) {
       return false;
     }
   }
 
-  while (storage_it != storage_.end()) {
-    if (storage_it->stamp_ <= new_data.stamp_) {
-      break;
-    }
-    storage_it++;
+  if (storage_size_ == storage_.size()) {
+    grow(storage_.empty() ? 16 : storage_.size() * 2);
+  }
+
+  // Samples normally arrive in order and are appended
+  if (storage_size_ == 0 || newest().stamp_ <= new_data.stamp_) {
+    sampleAt(storage_size_) = new_data;
+    ++storage_size_;
+    pruneList();
+    latest_.store(newest());
+    return true;
   }
-  storage_.insert(storage_it, new_data);
 
+  insertLate(new_data);
   pruneList();
   return true;
 }
 
-void TimeCache::clearList()
+template<class Sample>
+void BasicTimeCache<Sample>::insertLate(const TransformStorage & new_data)
+{
+  // Samples with equal stamps are kept in insertion order.  The ring buffer can open the gap by
+  // moving either the older or the newer samples, so move the fewer ones.
+  size_t position = upperBound(new_data.stamp_);
+  if (position < storage_size_ - position) {
+    storage_head_ = (storage_head_ - 1) & (storage_.size() - 1);
+    for (size_t i = 0; i < position; ++i) {
+      sampleAt(i) = sampleAt(i + 1);
+    }
+  } else {
+    for (size_t i = storage_size_; i > position; --i) {
+      sampleAt(i) = sampleAt(i - 1);
+    }
+  }
+  sampleAt(position) = new_data;
+  ++storage_size_;
+  if (position < decimated_size_) {
+    ++decimated_size_;
+  }
+}
+
+template<class Sample>
+bool BasicTimeCache<Sample>::insertDataCounted(
+  const TransformStorage & new_data, int64_t & length_change)
+{
+  std::lock_guard<SharedSpinLock> lock(lock_);
+  int64_t previous_length = storage_size_;
+  bool inserted = insertDataLocked(new_data);
+  length_change = static_cast<int64_t>(storage_size_) - previous_length;
+  return inserted;
+}
+
+template<class Sample>
+size_t BasicTimeCache<Sample>::insertSorted(const TransformStorage * data, size_t count)
+{
+  std::lock_guard<SharedSpinLock> lock(lock_);
+  if (count == 0) {
+    return 0;
+  }
+
+  // Whatever is older than the history kept at the end is pruned anyway, so drop the old
+  // samples first and skip the new ones that would not survive.  Those insertData() would
+  // have rejected are still counted.
+  size_t rejected = 0;
+  TimePoint latest_time = data[count - 1].stamp_;
+  if (storage_size_ > 0) {
+    const TimePoint previous_latest = newest().stamp_;
+    latest_time = std::max(latest_time, previous_latest);
+    while (storage_size_ > 0 && oldest().stamp_ + max_storage_time_ < latest_time) {
+      popOldest();
+    }
+    while (rejected < count && data[rejected].stamp_ + max_storage_time_ < previous_latest) {
+      ++rejected;
+    }
+  }
+  size_t first = std::max(rejected, count > max_samples_ ? count - max_samples_ : 0);
+  while (first < count && data[first].stamp_ + max_storage_time_ < latest_time) {
+    ++first;
+  }
+
+  size_t capacity = storage_.empty() ? 16 : storage_.size();
+  while (capacity < storage_size_ + count - first) {
+    capacity *= 2;
+  }
+  if (capacity > storage_.size()) {
+    grow(capacity);
+  }
+
+  for (size_t i = first; i < count; ++i) {
+    const TransformStorage & new_data = data[i];
+    if (storage_size_ == 0 || newest().stamp_ <= new_data.stamp_) {
+      sampleAt(storage_size_) = new_data;
+      ++storage_size_;
+    } else if (newest().stamp_ > new_data.stamp_ + max_storage_time_) {
+      ++rejected;
+    } else {
+      insertLate(new_data);
+    }
+  }
+  if (storage_size_ > 0) {
+    pruneList();
+    latest_.store(newest());
+  }
+  return rejected;
+}
+
+template<class Sample>
+void BasicTimeCache<Sample>::clearList()
 {
-  storage_.clear();
+  std::lock_guard<SharedSpinLock> lock(lock_);
+  storage_head_ = 0;
+  storage_size_ = 0;
+  decimated_size_ = 0;
+  latest_.reset();
 }
 
-unsigned int TimeCache::getListLength()
+template<class Sample>
+unsigned int BasicTimeCache<Sample>::getListLength()
 {
-  return (unsigned int)storage_.size();
+  std::shared_lock<SharedSpinLock> lock(lock_);
+  return (unsigned int)storage_size_;
 }
 
-P_TimeAndFrameID TimeCache::getLatestTimeAndParent()
+template<class Sample>
+P_TimeAndFrameID BasicTimeCache<Sample>::getLatestTimeAndParent()
 {
-  if (storage_.empty()) {
+  std::shared_lock<SharedSpinLock> lock(lock_);
+  if (storage_size_ == 0) {
     return std::make_pair(TimePoint(), 0);
   }
 
-  const TransformStorage & ts = storage_.front();
+  const Sample & ts = newest();
   return std::make_pair(ts.stamp_, ts.frame_id_);
 }
 
-TimePoint TimeCache::getLatestTimestamp()
+template<class Sample>
+TimePoint BasicTimeCache<Sample>::getLatestTimestamp()
 {
+  std::shared_lock<SharedSpinLock> lock(lock_);
   // empty list case
-  if (storage_.empty()) {
+  if (storage_size_ == 0) {
     return TimePoint();
   }
-  return storage_.front().stamp_;
+  return newest().stamp_;
 }
 
-TimePoint TimeCache::getOldestTimestamp()
+template<class Sample>
+TimePoint BasicTimeCache<Sample>::getOldestTimestamp()
 {
+  std::shared_lock<SharedSpinLock> lock(lock_);
   // empty list case
-  if (storage_.empty()) {
+  if (storage_size_ == 0) {
     return TimePoint();
   }
-  return storage_.back().stamp_;
+  return oldest().stamp_;
+}
+
+template<class Sample>
+bool BasicTimeCache<Sample>::getLatestSnapshot(TransformStorage & data_out) const
+{
+  return latest_.load(data_out);
+}
+
+template<class Sample>
+void BasicTimeCache<Sample>::setRetentionPolicy(const RetentionPolicy & policy)
+{
+  std::lock_guard<SharedSpinLock> lock(lock_);
+  max_storage_time_ = policy.max_age != tf2::Duration::zero() ?
+    policy.max_age : default_max_storage_time_;
+  max_samples_ = policy.max_samples != 0 ?
+    std::min<size_t>(policy.max_samples, MAX_LENGTH_LINKED_LIST) : MAX_LENGTH_LINKED_LIST;
+  decimation_age_ = policy.decimation_age;
+  decimation_interval_ = policy.decimation_interval;
+  decimated_size_ = 0;
+  nlerp_min_dot_ = getNlerpMinDot(policy);
+  max_extrapolation_ = policy.max_extrapolation;
+
+  if (storage_size_ > 0) {
+    pruneList();
+    latest_.store(newest());
+  }
+}
+
+template<class Sample>
+size_t BasicTimeCache<Sample>::dropOldest(size_t count)
+{
+  std::lock_guard<SharedSpinLock> lock(lock_);
+  size_t dropped = 0;
+  while (dropped < count && storage_size_ > 1) {
+    popOldest();
+    ++dropped;
+  }
+  return dropped;
+}
+
+template<class Sample>
+size_t BasicTimeCache<Sample>::getMemoryUsage() const
+{
+  std::shared_lock<SharedSpinLock> lock(lock_);
+  return storage_.capacity() * sizeof(Sample);
+}
+
+template<class Sample>
+void BasicTimeCache<Sample>::copySamples(std::vector<TransformStorage> & data_out) const
+{
+  std::shared_lock<SharedSpinLock> lock(lock_);
+  for (size_t i = 0; i < storage_size_; ++i) {
+    data_out.push_back(storage_[(storage_head_ + i) & (storage_.size() - 1)]);
+  }
 }
 
-void TimeCache::pruneList()
+template<class Sample>
+void BasicTimeCache<Sample>::reserve(size_t samples)
 {
-  TimePoint latest_time = storage_.begin()->stamp_;
+  std::lock_guard<SharedSpinLock> lock(lock_);
+  size_t capacity = storage_.empty() ? 16 : storage_.size();
+  while (capacity < samples) {
+    capacity *= 2;
+  }
+  if (capacity > storage_.size()) {
+    grow(capacity);
+  }
+}
 
-  while (!storage_.empty() && storage_.back().stamp_ + max_storage_time_ < latest_time) {
-    storage_.pop_back();
+template<class Sample>
+void BasicTimeCache<Sample>::popOldest()
+{
+  storage_head_ = (storage_head_ + 1) & (storage_.size() - 1);
+  --storage_size_;
+  if (decimated_size_ > 0) {
+    --decimated_size_;
   }
 }
+
+template<class Sample>
+void BasicTimeCache<Sample>::pruneList()
+{
+  TimePoint latest_time = newest().stamp_;
+
+  while (storage_size_ > 0 && oldest().stamp_ + max_storage_time_ < latest_time) {
+    popOldest();
+  }
+  while (storage_size_ > max_samples_) {
+    popOldest();
+  }
+  if (decimation_interval_ != tf2::Duration::zero()) {
+    decimate();
+  }
+}
+
+template<class Sample>
+void BasicTimeCache<Sample>::decimate()
+{
+  // Thinning out closes the gap by moving all newer samples, so wait for a batch of them
+  static const size_t DECIMATION_BATCH = 64;
+
+  // The newest sample is always kept, it is what latest lookups and latest_ report
+  size_t old_size = std::min(upperBound(newest().stamp_ - decimation_age_), storage_size_ - 1);
+  if (old_size < decimated_size_ + DECIMATION_BATCH) {
+    return;
+  }
+
+  size_t kept = decimated_size_;
+  for (size_t i = decimated_size_; i < old_size; ++i) {
+    if (kept == 0 || sampleAt(i).stamp_ - sampleAt(kept - 1).stamp_ >= decimation_interval_) {
+      sampleAt(kept++) = sampleAt(i);
+    }
+  }
+
+  size_t removed = old_size - kept;
+  for (size_t i = old_size; i < storage_size_; ++i) {
+    sampleAt(i - removed) = sampleAt(i);
+  }
+  storage_size_ -= removed;
+  decimated_size_ = kept;
+}
+
+template class BasicTimeCache<TransformStorage>;
+template class BasicTimeCache<Float32TransformStorage>;
 }  // namespace tf2
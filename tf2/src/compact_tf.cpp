@@ -0,0 +1,378 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tf2/compact_tf.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "tf2/LinearMath/Quaternion.h"
+#include "tf2/LinearMath/Transform.h"
+#include "tf2/LinearMath/Vector3.h"
+
+namespace tf2
+{
+
+namespace
+{
+
+/// Rotation components are quantized to multiples of 1 / ROTATION_SCALE
+constexpr double ROTATION_SCALE = 32767.0;
+
+uint64_t zigzag(int64_t value)
+{
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value)
+{
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+void putVarint(std::vector<uint8_t> & out, uint64_t value)
+{
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+void putDouble(std::vector<uint8_t> & out, double value)
+{
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  for (int i = 0; i < 8; ++i) {
+    out.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+  }
+}
+
+void putInt16(std::vector<uint8_t> & out, int16_t value)
+{
+  uint16_t bits = static_cast<uint16_t>(value);
+  out.push_back(static_cast<uint8_t>(bits));
+  out.push_back(static_cast<uint8_t>(bits >> 8));
+}
+
+/// Reads the fields of records, ok turns false once it ran past the end
+struct Reader
+{
+  const uint8_t * pos;
+  const uint8_t * end;
+  bool ok;
+
+  uint64_t varint()
+  {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (pos == end) {
+        ok = false;
+        return 0;
+      }
+      uint8_t byte = *pos++;
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return value;
+      }
+    }
+    ok = false;
+    return 0;
+  }
+
+  uint8_t byte()
+  {
+    if (pos == end) {
+      ok = false;
+      return 0;
+    }
+    return *pos++;
+  }
+
+  double float64()
+  {
+    if (end - pos < 8) {
+      ok = false;
+      pos = end;
+      return 0.0;
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; ++i) {
+      bits |= static_cast<uint64_t>(*pos++) << (8 * i);
+    }
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  int16_t int16()
+  {
+    if (end - pos < 2) {
+      ok = false;
+      pos = end;
+      return 0;
+    }
+    uint16_t bits = static_cast<uint16_t>(pos[0] | (pos[1] << 8));
+    pos += 2;
+    return static_cast<int16_t>(bits);
+  }
+};
+
+builtin_interfaces::msg::Time toStamp(TimePoint time)
+{
+  builtin_interfaces::msg::Time stamp;
+  std::chrono::nanoseconds ns = time.time_since_epoch();
+  stamp.sec = static_cast<int32_t>(ns.count() / 1000000000);
+  stamp.nanosec = static_cast<uint32_t>(ns.count() % 1000000000);
+  return stamp;
+}
+
+TimePoint fromStamp(const builtin_interfaces::msg::Time & stamp)
+{
+  return TimePoint(std::chrono::seconds(stamp.sec) + std::chrono::nanoseconds(stamp.nanosec));
+}
+
+}  // namespace
+
+CompactTFEncoder::CompactTFEncoder(const CompactTFEncoderOptions & options)
+: options_(options),
+  packets_(0)
+{
+  // Tells the dictionaries of an encoder that was restarted apart
+  uint64_t now = std::chrono::system_clock::now().time_since_epoch().count();
+  epoch_ = static_cast<uint32_t>(now ^ (now >> 32));
+}
+
+uint32_t CompactTFEncoder::frameIndex(const std::string & frame_id, CompactTFPacket & packet)
+{
+  auto it = frame_indices_.find(frame_id);
+  if (it != frame_indices_.end()) {
+    return it->second;
+  }
+  uint32_t index = static_cast<uint32_t>(frames_.size());
+  frame_indices_.emplace(frame_id, index);
+  frames_.push_back(frame_id);
+  packet.new_frames.push_back(frame_id);
+  return index;
+}
+
+void CompactTFEncoder::encode(
+  const std::vector<geometry_msgs::msg::TransformStamped> & transforms,
+  CompactTFPacket & packet)
+{
+  const bool keyframe = packets_ == 0 ||
+    (options_.keyframe_interval != 0 && packets_ % options_.keyframe_interval == 0);
+  ++packets_;
+  packet.dictionary_epoch = epoch_;
+  if (keyframe) {
+    packet.dictionary_offset = 0;
+    packet.new_frames.assign(frames_.begin(), frames_.end());
+  } else {
+    packet.dictionary_offset = static_cast<uint32_t>(frames_.size());
+    packet.new_frames.clear();
+  }
+  packet.base_stamp = transforms.empty() ?
+    TimePointZero : fromStamp(transforms.front().header.stamp);
+  packet.translation_resolution = std::max(options_.translation_resolution, 0.0);
+  packet.data.clear();
+
+  const double resolution = packet.translation_resolution;
+  TimePoint previous = packet.base_stamp;
+  for (const geometry_msgs::msg::TransformStamped & transform : transforms) {
+    putVarint(packet.data, frameIndex(transform.child_frame_id, packet));
+    putVarint(packet.data, frameIndex(transform.header.frame_id, packet));
+    TimePoint stamp = fromStamp(transform.header.stamp);
+    putVarint(packet.data, zigzag((stamp - previous).count()));
+    previous = stamp;
+
+    const geometry_msgs::msg::Vector3 & t = transform.transform.translation;
+    const geometry_msgs::msg::Quaternion & r = transform.transform.rotation;
+    if (resolution == 0.0) {
+      for (double value : {t.x, t.y, t.z, r.x, r.y, r.z, r.w}) {
+        putDouble(packet.data, value);
+      }
+      continue;
+    }
+    for (double value : {t.x, t.y, t.z}) {
+      putVarint(packet.data, zigzag(std::llround(value / resolution)));
+    }
+    tf2::Quaternion q(r.x, r.y, r.z, r.w);
+    q.normalize();
+    uint8_t largest = 0;
+    for (uint8_t i = 1; i < 4; ++i) {
+      if (std::abs(q[i]) > std::abs(q[largest])) {
+        largest = i;
+      }
+    }
+    const double sign = q[largest] < 0 ? -1.0 : 1.0;
+    packet.data.push_back(largest);
+    for (uint8_t i = 0; i < 4; ++i) {
+      if (i != largest) {
+        putInt16(packet.data, static_cast<int16_t>(std::lround(sign * q[i] * ROTATION_SCALE)));
+      }
+    }
+  }
+}
+
+CompactTFDecoder::CompactTFDecoder()
+: epoch_(0),
+  synced_(false)
+{
+}
+
+const CompactTFDecoderStats & CompactTFDecoder::getStats() const
+{
+  return stats_;
+}
+
+void CompactTFDecoder::updateDictionary(const CompactTFPacket & packet)
+{
+  if (packet.dictionary_offset == 0) {
+    frames_.assign(packet.new_frames.begin(), packet.new_frames.end());
+    epoch_ = packet.dictionary_epoch;
+    synced_ = true;
+    return;
+  }
+  if (!synced_ || packet.dictionary_epoch != epoch_) {
+    // Indices of another dictionary are meaningless, wait for the next keyframe
+    frames_.clear();
+    synced_ = false;
+    return;
+  }
+  // New frames already known from a keyframe are skipped.  After a lost packet with new frames
+  // the ones after the gap can not be placed, records referring to them are skipped until the
+  // next keyframe.
+  const size_t offset = packet.dictionary_offset;
+  if (offset <= frames_.size() && offset + packet.new_frames.size() > frames_.size()) {
+    frames_.insert(
+      frames_.end(), packet.new_frames.begin() + (frames_.size() - offset),
+      packet.new_frames.end());
+  }
+}
+
+template<typename F>
+bool CompactTFDecoder::decodeRecords(const CompactTFPacket & packet, F f)
+{
+  ++stats_.packets;
+  updateDictionary(packet);
+
+  Reader reader{packet.data.data(), packet.data.data() + packet.data.size(), true};
+  const double resolution = packet.translation_resolution;
+  TimePoint stamp = packet.base_stamp;
+  tf2::Transform transform;
+  while (reader.ok && reader.pos != reader.end) {
+    uint64_t child = reader.varint();
+    uint64_t parent = reader.varint();
+    stamp += std::chrono::nanoseconds(unzigzag(reader.varint()));
+    if (resolution == 0.0) {
+      double x = reader.float64();
+      double y = reader.float64();
+      double z = reader.float64();
+      transform.setOrigin(tf2::Vector3(x, y, z));
+      double qx = reader.float64();
+      double qy = reader.float64();
+      double qz = reader.float64();
+      double qw = reader.float64();
+      transform.setRotation(tf2::Quaternion(qx, qy, qz, qw));
+    } else {
+      double x = unzigzag(reader.varint()) * resolution;
+      double y = unzigzag(reader.varint()) * resolution;
+      double z = unzigzag(reader.varint()) * resolution;
+      transform.setOrigin(tf2::Vector3(x, y, z));
+      uint8_t largest = reader.byte();
+      if (largest > 3) {
+        reader.ok = false;
+        break;
+      }
+      double q[4];
+      double sum = 0.0;
+      for (uint8_t i = 0; i < 4; ++i) {
+        if (i != largest) {
+          q[i] = reader.int16() / ROTATION_SCALE;
+          sum += q[i] * q[i];
+        }
+      }
+      q[largest] = std::sqrt(std::max(0.0, 1.0 - sum));
+      transform.setRotation(tf2::Quaternion(q[0], q[1], q[2], q[3]));
+    }
+    if (!reader.ok) {
+      break;
+    }
+    if (child >= frames_.size() || parent >= frames_.size()) {
+      ++stats_.unknown_frame_transforms;
+      continue;
+    }
+    ++stats_.transforms;
+    f(transform, frames_[parent], frames_[child], stamp);
+  }
+  if (!reader.ok) {
+    ++stats_.malformed_packets;
+  }
+  return reader.ok;
+}
+
+bool CompactTFDecoder::decode(
+  const CompactTFPacket & packet, BufferCore & buffer, const std::string & authority,
+  bool is_static)
+{
+  return decodeRecords(
+    packet, [&](
+      const tf2::Transform & transform, const std::string & parent, const std::string & child,
+      TimePoint stamp) {
+      buffer.setTransform(transform, parent, child, stamp, authority, is_static);
+    });
+}
+
+bool CompactTFDecoder::decode(
+  const CompactTFPacket & packet, std::vector<geometry_msgs::msg::TransformStamped> & transforms)
+{
+  transforms.clear();
+  return decodeRecords(
+    packet, [&](
+      const tf2::Transform & transform, const std::string & parent, const std::string & child,
+      TimePoint stamp) {
+      transforms.emplace_back();
+      geometry_msgs::msg::TransformStamped & msg = transforms.back();
+      msg.header.stamp = toStamp(stamp);
+      msg.header.frame_id = parent;
+      msg.child_frame_id = child;
+      msg.transform.translation.x = transform.getOrigin().x();
+      msg.transform.translation.y = transform.getOrigin().y();
+      msg.transform.translation.z = transform.getOrigin().z();
+      msg.transform.rotation.x = transform.getRotation().x();
+      msg.transform.rotation.y = transform.getRotation().y();
+      msg.transform.rotation.z = transform.getRotation().z();
+      msg.transform.rotation.w = transform.getRotation().w();
+    });
+}
+
+}  // namespace tf2
@@ -0,0 +1,421 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+
+#include "tf2/time_cache.h"
+
+#include "tf2/LinearMath/Quaternion.h"
+#include "tf2/LinearMath/Vector3.h"
+
+namespace tf2
+{
+
+// Defined in cache.cpp, so all caches look up and report extrapolation the same way
+namespace cache
+{
+void createExtrapolationException1(TimePoint t0, TimePoint t1, std::string * error_str);
+void createExtrapolationException3(TimePoint t0, TimePoint t1, std::string * error_str);
+bool interpolateSamples(
+  const TransformStorage & one, const TransformStorage & two, TimePoint time, tf2Scalar min_dot,
+  tf2::Duration max_extrapolation, TransformStorage * output, std::string * error_str);
+}  // namespace cache
+
+namespace
+{
+const tf2Scalar ROTATION_SCALE = 32767.0;
+
+int16_t quantize(tf2Scalar value)
+{
+  return static_cast<int16_t>(std::lrint(std::max(-1.0, std::min(1.0, value)) * ROTATION_SCALE));
+}
+}  // namespace
+
+const unsigned int CompressedCache::MAX_BLOCK_SAMPLES;
+constexpr double CompressedCache::MAX_BLOCK_OFFSET;
+
+CompressedCache::CompressedCache(tf2::Duration max_storage_time)
+: front_offset_(0),
+  front_stamp_(),
+  size_(0),
+  max_storage_time_(max_storage_time),
+  default_max_storage_time_(max_storage_time),
+  max_samples_(TimeCache::MAX_LENGTH_LINKED_LIST),
+  nlerp_min_dot_(getNlerpMinDot(RetentionPolicy())),
+  max_extrapolation_(tf2::Duration::zero())
+{}
+
+TransformStorage CompressedCache::decode(const Position & position) const
+{
+  const Block & block = blocks_[position.block];
+  const Sample & sample = block.samples[position.index];
+  TransformStorage storage;
+  storage.rotation_.setValue(
+    sample.rotation[0] / ROTATION_SCALE, sample.rotation[1] / ROTATION_SCALE,
+    sample.rotation[2] / ROTATION_SCALE, sample.rotation[3] / ROTATION_SCALE);
+  storage.rotation_.normalize();
+  storage.translation_.setValue(
+    block.origin.x() + sample.translation[0], block.origin.y() + sample.translation[1],
+    block.origin.z() + sample.translation[2]);
+  storage.stamp_ = position.stamp;
+  storage.frame_id_ = block.frame_id;
+  storage.child_frame_id_ = block.child_frame_id;
+  return storage;
+}
+
+void CompressedCache::bracket(TimePoint time, Position & older, Position & newer) const
+{
+  // The last block starting at or before time holds the older sample
+  auto block = std::upper_bound(
+    blocks_.begin(), blocks_.end(), time,
+    [](TimePoint t, const Block & b) {return t < b.start;});
+  size_t block_index = static_cast<size_t>(block - blocks_.begin()) - 1;
+  const Block & b = blocks_[block_index];
+  if (b.end <= time) {
+    // Which makes the newer sample the first of the next block
+    older = Position{block_index, b.samples.size() - 1, b.end};
+    newer = Position{block_index + 1, 0, blocks_[block_index + 1].start};
+    return;
+  }
+
+  older = block_index == 0 ? oldest() : Position{block_index, 0, b.start};
+  newer = older;
+  do {
+    older = newer;
+    ++newer.index;
+    newer.stamp += std::chrono::nanoseconds(b.samples[newer.index].stamp_delta);
+  } while (newer.stamp <= time);
+}
+
+uint8_t CompressedCache::findClosest(
+  TransformStorage & one, TransformStorage & two,
+  TimePoint target_time, std::string * error_str)
+{
+  // No values stored
+  if (size_ == 0) {
+    return 0;
+  }
+
+  // If time == 0 return the latest
+  if (target_time == TimePointZero) {
+    one = decode(newest());
+    return 1;
+  }
+
+  // One value stored
+  if (size_ == 1) {
+    TimePoint stamp = front_stamp_;
+    if (stamp == target_time) {
+      one = decode(oldest());
+      return 1;
+    } else {
+      cache::createExtrapolationException1(target_time, stamp, error_str);
+      return 0;
+    }
+  }
+
+  TimePoint latest_time = blocks_.back().end;
+  TimePoint earliest_time = front_stamp_;
+
+  if (target_time == latest_time) {
+    one = decode(newest());
+    return 1;
+  } else if (target_time == earliest_time) {
+    one = decode(oldest());
+    return 1;
+  } else if (target_time > latest_time) {
+    // The newest sample and the last one before its stamp, cache::interpolateSamples() decides
+    // whether to extrapolate from them
+    two = decode(newest());
+    one = two;
+    if (earliest_time < latest_time) {
+      Position older;
+      Position newer;
+      bracket(latest_time - tf2::Duration(1), older, newer);
+      one = decode(older);
+    }
+    return 2;
+  } else if (target_time < earliest_time) {
+    cache::createExtrapolationException3(target_time, earliest_time, error_str);
+    return 0;
+  }
+
+  // Strictly between the oldest and newest sample, so both neighbours exist
+  Position older;
+  Position newer;
+  bracket(target_time, older, newer);
+  one = decode(older);
+  two = decode(newer);
+  return 2;
+}
+
+bool CompressedCache::getData(
+  TimePoint time, TransformStorage & data_out,
+  std::string * error_str)
+{
+  std::shared_lock<SharedSpinLock> lock(lock_);
+  TransformStorage one;
+  TransformStorage two;
+
+  int num_nodes = findClosest(one, two, time, error_str);
+  if (num_nodes == 0) {
+    return false;
+  } else if (num_nodes == 1) {
+    data_out = one;
+    return true;
+  }
+  return cache::interpolateSamples(
+    one, two, time, nlerp_min_dot_, max_extrapolation_, &data_out, error_str);
+}
+
+CompactFrameID CompressedCache::getParent(TimePoint time, std::string * error_str)
+{
+  std::shared_lock<SharedSpinLock> lock(lock_);
+  TransformStorage one;
+  TransformStorage two;
+
+  int num_nodes = findClosest(one, two, time, error_str);
+  if (num_nodes == 0) {
+    return 0;
+  }
+  if (num_nodes == 2 &&
+    !cache::interpolateSamples(
+      one, two, time, nlerp_min_dot_, max_extrapolation_, nullptr, error_str))
+  {
+    return 0;
+  }
+  return one.frame_id_;
+}
+
+bool CompressedCache::insertData(const TransformStorage & new_data)
+{
+  std::lock_guard<SharedSpinLock> lock(lock_);
+  return insertDataLocked(new_data);
+}
+
+bool CompressedCache::insertDataCounted(const TransformStorage & new_data, int64_t & length_change)
+{
+  std::lock_guard<SharedSpinLock> lock(lock_);
+  int64_t previous_length = size_;
+  bool inserted = insertDataLocked(new_data);
+  length_change = static_cast<int64_t>(size_) - previous_length;
+  return inserted;
+}
+
+bool CompressedCache::insertDataLocked(const TransformStorage & new_data)
+{
+  if (size_ > 0 && blocks_.back().end > new_data.stamp_) {
+    return false;
+  }
+
+  // Start a new block whenever the shared fields or the delta and offset ranges no longer fit
+  Block * block = blocks_.empty() ? nullptr : &blocks_.back();
+  if (block) {
+    tf2::Vector3 offset = new_data.translation_ - block->origin;
+    if (block->samples.size() >= MAX_BLOCK_SAMPLES ||
+      block->frame_id != new_data.frame_id_ ||
+      block->child_frame_id != new_data.child_frame_id_ ||
+      new_data.stamp_ - block->end >
+      std::chrono::nanoseconds(std::numeric_limits<uint32_t>::max()) ||
+      std::abs(offset.x()) > MAX_BLOCK_OFFSET || std::abs(offset.y()) > MAX_BLOCK_OFFSET ||
+      std::abs(offset.z()) > MAX_BLOCK_OFFSET)
+    {
+      // Blocks are never appended to again, so give back what they reserved
+      block->samples.shrink_to_fit();
+      block = nullptr;
+    }
+  }
+  if (!block) {
+    blocks_.emplace_back();
+    block = &blocks_.back();
+    block->start = new_data.stamp_;
+    block->end = new_data.stamp_;
+    block->origin = new_data.translation_;
+    block->frame_id = new_data.frame_id_;
+    block->child_frame_id = new_data.child_frame_id_;
+    block->samples.reserve(MAX_BLOCK_SAMPLES);
+  }
+  if (size_ == 0) {
+    front_stamp_ = new_data.stamp_;
+  }
+
+  Sample sample;
+  sample.stamp_delta = static_cast<uint32_t>((new_data.stamp_ - block->end).count());
+  tf2::Quaternion rotation = new_data.rotation_.normalized();
+  for (int i = 0; i < 4; ++i) {
+    sample.rotation[i] = quantize(rotation[i]);
+  }
+  for (int i = 0; i < 3; ++i) {
+    sample.translation[i] = static_cast<float>(new_data.translation_[i] - block->origin[i]);
+  }
+  block->samples.push_back(sample);
+  block->end = new_data.stamp_;
+  ++size_;
+
+  pruneList();
+  latest_.store(decode(newest()));
+  return true;
+}
+
+void CompressedCache::clearList()
+{
+  std::lock_guard<SharedSpinLock> lock(lock_);
+  blocks_.clear();
+  front_offset_ = 0;
+  size_ = 0;
+  latest_.reset();
+}
+
+unsigned int CompressedCache::getListLength()
+{
+  std::shared_lock<SharedSpinLock> lock(lock_);
+  return (unsigned int)size_;
+}
+
+P_TimeAndFrameID CompressedCache::getLatestTimeAndParent()
+{
+  std::shared_lock<SharedSpinLock> lock(lock_);
+  if (size_ == 0) {
+    return std::make_pair(TimePoint(), 0);
+  }
+  return std::make_pair(blocks_.back().end, blocks_.back().frame_id);
+}
+
+TimePoint CompressedCache::getLatestTimestamp()
+{
+  std::shared_lock<SharedSpinLock> lock(lock_);
+  // empty list case
+  if (size_ == 0) {
+    return TimePoint();
+  }
+  return blocks_.back().end;
+}
+
+TimePoint CompressedCache::getOldestTimestamp()
+{
+  std::shared_lock<SharedSpinLock> lock(lock_);
+  // empty list case
+  if (size_ == 0) {
+    return TimePoint();
+  }
+  return front_stamp_;
+}
+
+bool CompressedCache::getLatestSnapshot(TransformStorage & data_out) const
+{
+  return latest_.load(data_out);
+}
+
+void CompressedCache::setRetentionPolicy(const RetentionPolicy & policy)
+{
+  std::lock_guard<SharedSpinLock> lock(lock_);
+  max_storage_time_ = policy.max_age != tf2::Duration::zero() ?
+    policy.max_age : default_max_storage_time_;
+  max_samples_ = policy.max_samples != 0 ?
+    std::min<size_t>(policy.max_samples, TimeCache::MAX_LENGTH_LINKED_LIST) :
+    TimeCache::MAX_LENGTH_LINKED_LIST;
+  nlerp_min_dot_ = getNlerpMinDot(policy);
+  max_extrapolation_ = policy.max_extrapolation;
+
+  if (size_ > 0) {
+    pruneList();
+    latest_.store(decode(newest()));
+  }
+}
+
+size_t CompressedCache::dropOldest(size_t count)
+{
+  std::lock_guard<SharedSpinLock> lock(lock_);
+  size_t dropped = 0;
+  while (dropped < count && size_ > 1) {
+    popOldest();
+    ++dropped;
+  }
+  return dropped;
+}
+
+size_t CompressedCache::getMemoryUsage() const
+{
+  std::shared_lock<SharedSpinLock> lock(lock_);
+  size_t bytes = blocks_.size() * sizeof(Block);
+  for (const Block & block : blocks_) {
+    bytes += block.samples.capacity() * sizeof(Sample);
+  }
+  return bytes;
+}
+
+void CompressedCache::copySamples(std::vector<TransformStorage> & data_out) const
+{
+  std::shared_lock<SharedSpinLock> lock(lock_);
+  if (size_ == 0) {
+    return;
+  }
+  Position position = oldest();
+  for (size_t i = 0; i < size_; ++i) {
+    data_out.push_back(decode(position));
+    if (++position.index == blocks_[position.block].samples.size() && i + 1 < size_) {
+      position = Position{position.block + 1, 0, blocks_[position.block + 1].start};
+    } else if (i + 1 < size_) {
+      position.stamp +=
+        std::chrono::nanoseconds(blocks_[position.block].samples[position.index].stamp_delta);
+    }
+  }
+}
+
+void CompressedCache::popOldest()
+{
+  if (++front_offset_ == blocks_.front().samples.size()) {
+    blocks_.pop_front();
+    front_offset_ = 0;
+    if (!blocks_.empty()) {
+      front_stamp_ = blocks_.front().start;
+    }
+  } else {
+    front_stamp_ += std::chrono::nanoseconds(blocks_.front().samples[front_offset_].stamp_delta);
+  }
+  --size_;
+}
+
+void CompressedCache::pruneList()
+{
+  TimePoint latest_time = blocks_.back().end;
+
+  while (size_ > 0 && front_stamp_ + max_storage_time_ < latest_time) {
+    popOldest();
+  }
+  while (size_ > max_samples_) {
+    popOldest();
+  }
+}
+}  // namespace tf2
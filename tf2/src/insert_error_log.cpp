@@ -0,0 +1,259 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tf2/insert_error_log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "console_bridge/console.h"
+
+namespace tf2
+{
+
+namespace
+{
+
+void logRejection(
+  const InsertErrorCount & rejection, const tf2::Transform & transform, TimePoint stamp,
+  uint64_t repeated)
+{
+  // The first rejection is logged the way it always was, more of them are summed up after it
+  std::string more;
+  if (repeated > 1) {
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), " (%" PRIu64 " times since the last message)", repeated);
+    more = buffer;
+  }
+  const char * child = rejection.child_frame_id.c_str();
+  const char * authority = rejection.authority.c_str();
+  switch (rejection.error) {
+    case InsertError::SelfTransform:
+      CONSOLE_BRIDGE_logError(
+        "TF_SELF_TRANSFORM: Ignoring transform from authority \"%s\" with frame_id and  "
+        "child_frame_id \"%s\" because they are the same%s", authority, child, more.c_str());
+      break;
+    case InsertError::NoChildFrameId:
+      CONSOLE_BRIDGE_logError(
+        "TF_NO_CHILD_FRAME_ID: Ignoring transform from authority \"%s\" because child_frame_id"
+        " not set%s", authority, more.c_str());
+      break;
+    case InsertError::NoFrameId:
+      CONSOLE_BRIDGE_logError(
+        "TF_NO_FRAME_ID: Ignoring transform with child_frame_id \"%s\"  from authority \"%s\" "
+        "because frame_id not set%s", child, authority, more.c_str());
+      break;
+    case InsertError::NanInput:
+      CONSOLE_BRIDGE_logError(
+        "TF_NAN_INPUT: Ignoring transform for child_frame_id \"%s\" from authority \"%s\" because"
+        " of a nan value in the transform (%f %f %f) (%f %f %f %f)%s", child, authority,
+        transform.getOrigin().x(), transform.getOrigin().y(), transform.getOrigin().z(),
+        transform.getRotation().x(), transform.getRotation().y(),
+        transform.getRotation().z(), transform.getRotation().w(), more.c_str());
+      break;
+    case InsertError::DenormalizedQuaternion:
+      CONSOLE_BRIDGE_logError(
+        "TF_DENORMALIZED_QUATERNION: Ignoring transform for child_frame_id \"%s\" from authority"
+        " \"%s\" because of an invalid quaternion in the transform (%f %f %f %f)%s",
+        child, authority, transform.getRotation().x(), transform.getRotation().y(),
+        transform.getRotation().z(), transform.getRotation().w(), more.c_str());
+      break;
+    case InsertError::OldData:
+      {
+        std::string stamp_str = displayTimePoint(stamp);
+        CONSOLE_BRIDGE_logWarn(
+          "TF_OLD_DATA ignoring data from the past for frame %s at time %s according to authority"
+          " %s%s\nPossible reasons are listed at http://wiki.ros.org/tf/Errors%%20explained",
+          child, stamp_str.c_str(), authority, more.c_str());
+      }
+      break;
+  }
+}
+
+/// A rejection taken out of the log so it can be logged without holding its mutex
+struct PendingRejection
+{
+  InsertErrorCount rejection;
+  tf2::Transform transform;
+  TimePoint stamp;
+  uint64_t repeated;
+};
+
+}  // namespace
+
+const char * insertErrorName(InsertError error)
+{
+  switch (error) {
+    case InsertError::SelfTransform:
+      return "TF_SELF_TRANSFORM";
+    case InsertError::NoChildFrameId:
+      return "TF_NO_CHILD_FRAME_ID";
+    case InsertError::NoFrameId:
+      return "TF_NO_FRAME_ID";
+    case InsertError::NanInput:
+      return "TF_NAN_INPUT";
+    case InsertError::DenormalizedQuaternion:
+      return "TF_DENORMALIZED_QUATERNION";
+    case InsertError::OldData:
+      return "TF_OLD_DATA";
+  }
+  return "";
+}
+
+InsertErrorLog::InsertErrorLog(tf2::Duration period)
+: period_(period)
+{
+}
+
+InsertErrorLog::~InsertErrorLog()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  if (summarizer_.joinable()) {
+    summarizer_.join();
+  }
+  flush();
+}
+
+void InsertErrorLog::setPeriod(tf2::Duration period)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    period_ = period;
+  }
+  wake_.notify_all();
+}
+
+void InsertErrorLog::report(
+  InsertError error, const std::string & child_frame_id, const std::string & authority,
+  const tf2::Transform & transform, TimePoint stamp, uint64_t count)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  key_.assign(child_frame_id);
+  key_.push_back('\0');
+  key_.append(authority);
+  key_.push_back(static_cast<char>(error));
+  auto it = entries_.find(key_);
+  if (it == entries_.end()) {
+    it = entries_.emplace(key_, Entry()).first;
+    it->second.total.child_frame_id = child_frame_id;
+    it->second.total.authority = authority;
+    it->second.total.error = error;
+  }
+  Entry & entry = it->second;
+  entry.total.count += count;
+  if (period_ == tf2::Duration::zero()) {
+    InsertErrorCount rejection = entry.total;
+    lock.unlock();
+    logRejection(rejection, transform, stamp, 1);
+    return;
+  }
+  if (entry.pending == 0) {
+    entry.transform = transform;
+    entry.stamp = stamp;
+    ++num_pending_;
+  }
+  entry.pending += count;
+  if (!summarizer_.joinable() && !stopping_) {
+    summarizer_ = std::thread(&InsertErrorLog::run, this);
+  } else if (entry.pending == count) {
+    lock.unlock();
+    wake_.notify_one();
+  }
+}
+
+void InsertErrorLog::flush()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  flushLocked(lock);
+}
+
+std::vector<InsertErrorCount> InsertErrorLog::getCounts() const
+{
+  std::vector<InsertErrorCount> counts;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    counts.reserve(entries_.size());
+    for (const auto & entry : entries_) {
+      counts.push_back(entry.second.total);
+    }
+  }
+  std::sort(
+    counts.begin(), counts.end(), [](const InsertErrorCount & a, const InsertErrorCount & b) {
+      return std::tie(a.child_frame_id, a.authority, a.error) <
+      std::tie(b.child_frame_id, b.authority, b.error);
+    });
+  return counts;
+}
+
+void InsertErrorLog::flushLocked(std::unique_lock<std::mutex> & lock)
+{
+  if (num_pending_ == 0) {
+    return;
+  }
+  std::vector<PendingRejection> pending;
+  pending.reserve(num_pending_);
+  for (auto & it : entries_) {
+    Entry & entry = it.second;
+    if (entry.pending != 0) {
+      pending.push_back({entry.total, entry.transform, entry.stamp, entry.pending});
+      entry.pending = 0;
+    }
+  }
+  num_pending_ = 0;
+  lock.unlock();
+  for (const PendingRejection & rejection : pending) {
+    logRejection(rejection.rejection, rejection.transform, rejection.stamp, rejection.repeated);
+  }
+  lock.lock();
+}
+
+void InsertErrorLog::run()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    wake_.wait(lock, [this]() {return stopping_ || num_pending_ != 0;});
+    flushLocked(lock);
+    // Whatever is reported until the period is over goes into the next message
+    const std::chrono::steady_clock::time_point until = std::chrono::steady_clock::now() +
+      period_;
+    wake_.wait_until(lock, until, [this]() {return stopping_;});
+  }
+}
+
+}  // namespace tf2
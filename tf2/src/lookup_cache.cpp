@@ -0,0 +1,127 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tf2/lookup_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace tf2
+{
+
+constexpr size_t LookupCache::WAYS;
+
+LookupCache::LookupCache(size_t capacity)
+: set_mask_(0),
+  clock_(0),
+  hits_(0),
+  misses_(0)
+{
+  size_t sets = 1;
+  while (sets * WAYS < capacity) {
+    sets *= 2;
+  }
+  set_mask_ = sets - 1;
+  entries_.resize(sets * WAYS);
+}
+
+size_t LookupCache::setOf(
+  CompactFrameID target_id, CompactFrameID source_id, TimePoint time) const
+{
+  uint64_t h = (static_cast<uint64_t>(target_id) << 32 | source_id) * 0x9e3779b97f4a7c15ULL;
+  h ^= static_cast<uint64_t>(time.time_since_epoch().count()) * 0xc2b2ae3d27d4eb4fULL;
+  h ^= h >> 29;
+  return (h & set_mask_) * WAYS;
+}
+
+bool LookupCache::find(
+  CompactFrameID target_id, CompactFrameID source_id, TimePoint time, uint64_t topology_version,
+  uint64_t data_version, tf2::Transform & transform, TimePoint & time_out)
+{
+  const size_t first = setOf(target_id, source_id, time);
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = first; i < first + WAYS; ++i) {
+    Entry & entry = entries_[i];
+    if (entry.last_used != 0 && entry.target_id == target_id &&
+      entry.source_id == source_id && entry.time == time &&
+      entry.topology_version == topology_version && entry.data_version == data_version)
+    {
+      entry.last_used = ++clock_;
+      transform = entry.transform;
+      time_out = entry.time_out;
+      ++hits_;
+      return true;
+    }
+  }
+  ++misses_;
+  return false;
+}
+
+void LookupCache::store(
+  CompactFrameID target_id, CompactFrameID source_id, TimePoint time, uint64_t topology_version,
+  uint64_t data_version, const tf2::Transform & transform, TimePoint time_out)
+{
+  const size_t first = setOf(target_id, source_id, time);
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Replace an outdated result of the same lookup, otherwise the least recently used
+  Entry * victim = &entries_[first];
+  for (size_t i = first; i < first + WAYS; ++i) {
+    Entry & entry = entries_[i];
+    if (entry.target_id == target_id && entry.source_id == source_id && entry.time == time) {
+      victim = &entry;
+      break;
+    }
+    if (entry.last_used < victim->last_used) {
+      victim = &entry;
+    }
+  }
+  victim->target_id = target_id;
+  victim->source_id = source_id;
+  victim->time = time;
+  victim->topology_version = topology_version;
+  victim->data_version = data_version;
+  victim->last_used = ++clock_;
+  victim->transform = transform;
+  victim->time_out = time_out;
+}
+
+uint64_t LookupCache::getHits() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+uint64_t LookupCache::getMisses() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
+
+}  // namespace tf2
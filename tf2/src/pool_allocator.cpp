@@ -0,0 +1,132 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tf2/pool_allocator.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace tf2
+{
+
+namespace
+{
+/// Blocks carved from the first chunk, each further chunk doubles the pool
+const size_t FIRST_CHUNK_BLOCKS = 16;
+}  // namespace
+
+PoolResource::PoolResource()
+: block_size_(0),
+  num_blocks_(0),
+  reserved_blocks_(0),
+  num_free_(0),
+  free_(nullptr)
+{
+}
+
+PoolResource::~PoolResource()
+{
+  for (void * chunk : chunks_) {
+    ::operator delete(chunk);
+  }
+}
+
+bool PoolResource::fits(size_t bytes, size_t alignment)
+{
+  if (alignment > alignof(std::max_align_t)) {
+    return false;
+  }
+  if (block_size_ == 0) {
+    // Round up so every block in a chunk stays aligned
+    const size_t align = alignof(std::max_align_t);
+    block_size_ = (std::max(bytes, sizeof(FreeBlock)) + align - 1) / align * align;
+  }
+  return bytes <= block_size_;
+}
+
+void PoolResource::addChunk(size_t blocks)
+{
+  char * chunk = static_cast<char *>(::operator new(blocks * block_size_));
+  chunks_.push_back(chunk);
+  for (size_t i = 0; i < blocks; ++i) {
+    FreeBlock * block = reinterpret_cast<FreeBlock *>(chunk + i * block_size_);
+    block->next = free_;
+    free_ = block;
+  }
+  num_free_ += blocks;
+  num_blocks_ += blocks;
+}
+
+void * PoolResource::allocate(size_t bytes, size_t alignment)
+{
+  if (!fits(bytes, alignment)) {
+    return ::operator new(bytes);
+  }
+  if (free_ == nullptr) {
+    size_t missing = reserved_blocks_ > num_blocks_ ? reserved_blocks_ - num_blocks_ : 0;
+    addChunk(std::max(std::max(FIRST_CHUNK_BLOCKS, num_blocks_), missing));
+  }
+  FreeBlock * block = free_;
+  free_ = block->next;
+  --num_free_;
+  return block;
+}
+
+void PoolResource::deallocate(void * ptr, size_t bytes, size_t alignment)
+{
+  if (!fits(bytes, alignment)) {
+    ::operator delete(ptr);
+    return;
+  }
+  FreeBlock * block = static_cast<FreeBlock *>(ptr);
+  block->next = free_;
+  free_ = block;
+  ++num_free_;
+}
+
+void PoolResource::reserve(size_t blocks)
+{
+  reserved_blocks_ = std::max(reserved_blocks_, blocks);
+  if (block_size_ != 0 && num_blocks_ < reserved_blocks_) {
+    addChunk(reserved_blocks_ - num_blocks_);
+  }
+}
+
+size_t PoolResource::getNumFreeBlocks() const
+{
+  return num_free_;
+}
+
+size_t PoolResource::getMemoryUsage() const
+{
+  return num_blocks_ * block_size_ + chunks_.capacity() * sizeof(void *);
+}
+
+}  // namespace tf2
@@ -0,0 +1,338 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tf2/replicated_buffer.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "console_bridge/console.h"
+
+namespace tf2
+{
+
+struct ReplicatedBuffer::Update
+{
+  std::vector<geometry_msgs::msg::TransformStamped> transforms;
+  std::string authority;
+  bool is_static = false;
+  /// Clear the replica instead of inserting transforms
+  bool clear = false;
+};
+
+struct ReplicatedBuffer::Replica
+{
+  /// Created by the worker, so its first allocations are local to the node
+  std::unique_ptr<BufferCore> buffer;
+  /// The CPUs of the nodes of this replica, the worker runs on them
+  std::vector<int> cpus;
+  std::thread worker;
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<std::shared_ptr<const Update>> queue;
+  /// Updates ever queued and applied, waitForInserts() waits for the latter to catch up
+  uint64_t queued = 0;
+  uint64_t applied = 0;
+  bool stopping = false;
+};
+
+namespace
+{
+
+/// Parse a sysfs list like "0-3,8,10-11"
+std::vector<int> parseList(const std::string & list)
+{
+  std::vector<int> values;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    size_t dash = range.find('-');
+    try {
+      int first = std::stoi(range.substr(0, dash));
+      int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      for (int value = first; value <= last; ++value) {
+        values.push_back(value);
+      }
+    } catch (const std::exception &) {
+      // Skip anything malformed, such as the trailing newline
+    }
+  }
+  return values;
+}
+
+/// The CPUs of each online NUMA node, empty if they can not be read
+std::vector<std::vector<int>> readNumaNodes()
+{
+  std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+  const std::string root = "/sys/devices/system/node/";
+  std::ifstream online(root + "online");
+  std::string list;
+  if (!std::getline(online, list)) {
+    return nodes;
+  }
+  for (int node : parseList(list)) {
+    std::ifstream cpulist(root + "node" + std::to_string(node) + "/cpulist");
+    std::string cpus;
+    if (std::getline(cpulist, cpus)) {
+      nodes.push_back(parseList(cpus));
+    }
+  }
+#endif
+  return nodes;
+}
+
+void pinToCpus(const std::vector<int> & cpus)
+{
+#ifdef __linux__
+  if (cpus.empty()) {
+    return;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    CONSOLE_BRIDGE_logWarn("Could not pin a ReplicatedBuffer worker to its NUMA node");
+  }
+#else
+  (void)cpus;
+#endif
+}
+
+}  // namespace
+
+ReplicatedBuffer::ReplicatedBuffer(tf2::Duration cache_time, size_t num_replicas)
+{
+  std::vector<std::vector<int>> nodes = readNumaNodes();
+  if (num_replicas == 0) {
+    num_replicas = std::max<size_t>(1, nodes.size());
+  }
+
+  for (size_t i = 0; i < num_replicas; ++i) {
+    replicas_.emplace_back(new Replica());
+  }
+  for (size_t node = 0; node < nodes.size(); ++node) {
+    size_t index = node % num_replicas;
+    for (int cpu : nodes[node]) {
+      replicas_[index]->cpus.push_back(cpu);
+      if (cpu >= 0) {
+        if (static_cast<size_t>(cpu) >= cpu_replicas_.size()) {
+          cpu_replicas_.resize(cpu + 1, 0);
+        }
+        cpu_replicas_[cpu] = index;
+      }
+    }
+  }
+
+  for (const std::unique_ptr<Replica> & replica_ptr : replicas_) {
+    Replica * replica = replica_ptr.get();
+    replica->worker = std::thread(
+      [replica, cache_time]() {
+        pinToCpus(replica->cpus);
+        std::unique_ptr<BufferCore> buffer(new BufferCore(cache_time));
+        std::unique_lock<std::mutex> lock(replica->mutex);
+        replica->buffer = std::move(buffer);
+        replica->changed.notify_all();
+
+        while (true) {
+          replica->changed.wait(
+            lock, [replica]() {return replica->stopping || !replica->queue.empty();});
+          if (replica->queue.empty()) {
+            return;
+          }
+          std::shared_ptr<const Update> update = std::move(replica->queue.front());
+          replica->queue.pop_front();
+          lock.unlock();
+          if (update->clear) {
+            replica->buffer->clear();
+          } else {
+            replica->buffer->setTransforms(
+              update->transforms, update->authority, update->is_static);
+          }
+          lock.lock();
+          ++replica->applied;
+          replica->changed.notify_all();
+        }
+      });
+  }
+
+  // Lookups can only be forwarded once every replica exists
+  for (const std::unique_ptr<Replica> & replica : replicas_) {
+    std::unique_lock<std::mutex> lock(replica->mutex);
+    replica->changed.wait(lock, [&replica]() {return replica->buffer != nullptr;});
+  }
+}
+
+ReplicatedBuffer::~ReplicatedBuffer()
+{
+  for (const std::unique_ptr<Replica> & replica : replicas_) {
+    std::lock_guard<std::mutex> lock(replica->mutex);
+    replica->stopping = true;
+    replica->changed.notify_all();
+  }
+  for (const std::unique_ptr<Replica> & replica : replicas_) {
+    replica->worker.join();
+  }
+}
+
+void ReplicatedBuffer::enqueue(const std::shared_ptr<const Update> & update)
+{
+  for (const std::unique_ptr<Replica> & replica : replicas_) {
+    std::lock_guard<std::mutex> lock(replica->mutex);
+    replica->queue.push_back(update);
+    ++replica->queued;
+    replica->changed.notify_all();
+  }
+}
+
+bool ReplicatedBuffer::setTransform(
+  const geometry_msgs::msg::TransformStamped & transform,
+  const std::string & authority, bool is_static)
+{
+  return setTransforms(
+    std::vector<geometry_msgs::msg::TransformStamped>(1, transform), authority, is_static);
+}
+
+bool ReplicatedBuffer::setTransforms(
+  const std::vector<geometry_msgs::msg::TransformStamped> & transforms,
+  const std::string & authority, bool is_static)
+{
+  // All replicas share one copy of the transforms
+  std::shared_ptr<Update> update = std::make_shared<Update>();
+  update->transforms = transforms;
+  update->authority = authority;
+  update->is_static = is_static;
+  enqueue(update);
+  return true;
+}
+
+void ReplicatedBuffer::waitForInserts() const
+{
+  for (const std::unique_ptr<Replica> & replica : replicas_) {
+    std::unique_lock<std::mutex> lock(replica->mutex);
+    uint64_t queued = replica->queued;
+    replica->changed.wait(lock, [&replica, queued]() {return replica->applied >= queued;});
+  }
+}
+
+void ReplicatedBuffer::clear()
+{
+  std::shared_ptr<Update> update = std::make_shared<Update>();
+  update->clear = true;
+  enqueue(update);
+}
+
+geometry_msgs::msg::TransformStamped ReplicatedBuffer::lookupTransform(
+  const std::string & target_frame, const std::string & source_frame,
+  const TimePoint & time) const
+{
+  return localReplica().lookupTransform(target_frame, source_frame, time);
+}
+
+geometry_msgs::msg::TransformStamped ReplicatedBuffer::lookupTransform(
+  const std::string & target_frame, const TimePoint & target_time,
+  const std::string & source_frame, const TimePoint & source_time,
+  const std::string & fixed_frame) const
+{
+  return localReplica().lookupTransform(
+    target_frame, target_time, source_frame, source_time, fixed_frame);
+}
+
+bool ReplicatedBuffer::canTransform(
+  const std::string & target_frame, const std::string & source_frame,
+  const TimePoint & time, std::string * error_msg) const
+{
+  return localReplica().canTransform(target_frame, source_frame, time, error_msg);
+}
+
+bool ReplicatedBuffer::canTransform(
+  const std::string & target_frame, const TimePoint & target_time,
+  const std::string & source_frame, const TimePoint & source_time,
+  const std::string & fixed_frame, std::string * error_msg) const
+{
+  return localReplica().canTransform(
+    target_frame, target_time, source_frame, source_time, fixed_frame, error_msg);
+}
+
+std::vector<std::string> ReplicatedBuffer::getAllFrameNames() const
+{
+  return localReplica().getAllFrameNames();
+}
+
+size_t ReplicatedBuffer::getNumReplicas() const
+{
+  return replicas_.size();
+}
+
+size_t ReplicatedBuffer::getLocalReplicaIndex() const
+{
+#ifdef __linux__
+  int cpu = sched_getcpu();
+  if (cpu >= 0 && static_cast<size_t>(cpu) < cpu_replicas_.size()) {
+    return cpu_replicas_[cpu];
+  }
+#endif
+  return 0;
+}
+
+const BufferCore & ReplicatedBuffer::getReplica(size_t index) const
+{
+  return *replicas_.at(index)->buffer;
+}
+
+size_t ReplicatedBuffer::getNumNumaNodes()
+{
+  return std::max<size_t>(1, readNumaNodes().size());
+}
+
+const BufferCore & ReplicatedBuffer::localReplica() const
+{
+  return *replicas_[getLocalReplicaIndex()]->buffer;
+}
+
+}  // namespace tf2
@@ -0,0 +1,325 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tf2/sharded_buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "tf2/exceptions.h"
+
+namespace tf2
+{
+
+namespace
+{
+
+geometry_msgs::msg::TransformStamped transformToMsg(
+  const tf2::Transform & transform, TimePoint time_out,
+  const std::string & target_frame, const std::string & source_frame)
+{
+  geometry_msgs::msg::TransformStamped msg;
+  msg.transform.translation.x = transform.getOrigin().x();
+  msg.transform.translation.y = transform.getOrigin().y();
+  msg.transform.translation.z = transform.getOrigin().z();
+  msg.transform.rotation.x = transform.getRotation().x();
+  msg.transform.rotation.y = transform.getRotation().y();
+  msg.transform.rotation.z = transform.getRotation().z();
+  msg.transform.rotation.w = transform.getRotation().w();
+  std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    time_out.time_since_epoch());
+  std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(
+    time_out.time_since_epoch());
+  msg.header.stamp.sec = static_cast<int32_t>(s.count());
+  msg.header.stamp.nanosec = static_cast<uint32_t>(ns.count() % 1000000000ull);
+  msg.header.frame_id = target_frame;
+  msg.child_frame_id = source_frame;
+  return msg;
+}
+
+/// The older of two stamps of pieces of a lookup, identity pieces at time 0 have no stamp
+TimePoint olderStamp(TimePoint a, TimePoint b)
+{
+  if (a == TimePointZero) {
+    return b;
+  }
+  if (b == TimePointZero) {
+    return a;
+  }
+  return std::min(a, b);
+}
+
+}  // namespace
+
+const size_t ShardedBuffer::MAX_SHARD_HOPS;
+
+ShardedBuffer::ShardedBuffer(tf2::Duration cache_time, size_t num_shards)
+{
+  num_shards = std::max<size_t>(num_shards, 2);
+  shards_.reserve(num_shards);
+  for (size_t i = 0; i < num_shards; ++i) {
+    shards_.emplace_back(new BufferCore(cache_time));
+  }
+}
+
+size_t ShardedBuffer::getNumShards() const
+{
+  return shards_.size();
+}
+
+size_t ShardedBuffer::getShardIndex(const std::string & frame_id) const
+{
+  size_t begin = !frame_id.empty() && frame_id[0] == '/' ? 1 : 0;
+  size_t end = frame_id.find('/', begin);
+  if (end == std::string::npos) {
+    return 0;
+  }
+  // FNV-1a, which needs no copy of the namespace
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = begin; i < end; ++i) {
+    hash ^= static_cast<unsigned char>(frame_id[i]);
+    hash *= 1099511628211ULL;
+  }
+  return 1 + hash % (shards_.size() - 1);
+}
+
+BufferCore & ShardedBuffer::getShard(size_t index)
+{
+  return *shards_.at(index);
+}
+
+const BufferCore & ShardedBuffer::getShard(size_t index) const
+{
+  return *shards_.at(index);
+}
+
+bool ShardedBuffer::setTransform(
+  const geometry_msgs::msg::TransformStamped & transform,
+  const std::string & authority, bool is_static)
+{
+  return shards_[getShardIndex(transform.child_frame_id)]->setTransform(
+    transform, authority, is_static);
+}
+
+bool ShardedBuffer::setTransforms(
+  const std::vector<geometry_msgs::msg::TransformStamped> & transforms,
+  const std::string & authority, bool is_static)
+{
+  bool all_inserted = true;
+  for (const geometry_msgs::msg::TransformStamped & transform : transforms) {
+    all_inserted &= setTransform(transform, authority, is_static);
+  }
+  return all_inserted;
+}
+
+void ShardedBuffer::clear()
+{
+  for (auto & shard : shards_) {
+    shard->clear();
+  }
+}
+
+void ShardedBuffer::checkFrameExists(
+  const char * function_name_arg, const std::string & frame_id) const
+{
+  if (frame_id.empty()) {
+    throw InvalidArgumentException(
+            "Invalid argument \"" + frame_id + "\" passed to " + function_name_arg +
+            " - in tf2 frame_ids cannot be empty");
+  }
+  for (const auto & shard : shards_) {
+    if (shard->_frameExists(frame_id)) {
+      return;
+    }
+  }
+  throw LookupException(
+          "\"" + frame_id + "\" passed to " + function_name_arg + " does not exist. ");
+}
+
+std::string ShardedBuffer::topFrame(size_t shard, const std::string & frame_id) const
+{
+  std::string top = frame_id;
+  std::string parent;
+  for (uint32_t depth = 0; depth < BufferCore::MAX_GRAPH_DEPTH; ++depth) {
+    if (!shards_[shard]->_getParent(top, TimePointZero, parent)) {
+      break;
+    }
+    top.swap(parent);
+  }
+  return top;
+}
+
+std::vector<std::string> ShardedBuffer::shardTops(const std::string & frame_id) const
+{
+  std::vector<std::string> tops(1, frame_id);
+  while (tops.size() < MAX_SHARD_HOPS) {
+    std::string top = topFrame(getShardIndex(tops.back()), tops.back());
+    if (std::find(tops.begin(), tops.end(), top) != tops.end()) {
+      break;
+    }
+    tops.push_back(top);
+  }
+  return tops;
+}
+
+bool ShardedBuffer::lookupAcrossShards(
+  const std::string & target_frame, const std::string & source_frame, const TimePoint & time,
+  tf2::Transform & transform, TimePoint & time_out) const
+{
+  const std::vector<std::string> target_tops = shardTops(target_frame);
+  const std::vector<std::string> source_tops = shardTops(source_frame);
+  size_t source_end = 0;
+  size_t target_end = 0;
+  for (; source_end < source_tops.size(); ++source_end) {
+    auto it = std::find(target_tops.begin(), target_tops.end(), source_tops[source_end]);
+    if (it != target_tops.end()) {
+      target_end = it - target_tops.begin();
+      break;
+    }
+  }
+  if (source_end == source_tops.size()) {
+    return false;
+  }
+
+  // Each piece is looked up in the shard of the frame it starts from, up to the common top
+  time_out = TimePointZero;
+  auto accumulate = [&](const std::vector<std::string> & tops, size_t end) {
+      tf2::Transform top_from_frame = tf2::Transform::getIdentity();
+      for (size_t i = 0; i < end; ++i) {
+        tf2::Transform link;
+        TimePoint link_time;
+        shards_[getShardIndex(tops[i])]->lookupTransform(
+          tops[i + 1], tops[i], time, link, link_time);
+        top_from_frame = link * top_from_frame;
+        time_out = olderStamp(time_out, link_time);
+      }
+      return top_from_frame;
+    };
+  tf2::Transform top_from_source = accumulate(source_tops, source_end);
+  tf2::Transform top_from_target = accumulate(target_tops, target_end);
+  transform = top_from_target.inverse() * top_from_source;
+  if (time_out == TimePointZero) {
+    time_out = time;
+  }
+  return true;
+}
+
+void ShardedBuffer::lookupTransform(
+  const std::string & target_frame, const std::string & source_frame,
+  const TimePoint & time, tf2::Transform & transform, TimePoint & time_out) const
+{
+  const size_t target_shard = getShardIndex(target_frame);
+  if (target_shard == getShardIndex(source_frame)) {
+    try {
+      shards_[target_shard]->lookupTransform(
+        target_frame, source_frame, time, transform, time_out);
+    } catch (const ConnectivityException &) {
+      if (!lookupAcrossShards(target_frame, source_frame, time, transform, time_out)) {
+        throw;
+      }
+    }
+    return;
+  }
+  if (!lookupAcrossShards(target_frame, source_frame, time, transform, time_out)) {
+    // Frames known to no shard never meet, report them the way BufferCore does
+    checkFrameExists("lookupTransform argument target_frame", target_frame);
+    checkFrameExists("lookupTransform argument source_frame", source_frame);
+    throw ConnectivityException(
+            "Could not find a connection between '" + target_frame + "' and '" + source_frame +
+            "' because their trees do not meet in any shard");
+  }
+}
+
+geometry_msgs::msg::TransformStamped ShardedBuffer::lookupTransform(
+  const std::string & target_frame, const std::string & source_frame,
+  const TimePoint & time) const
+{
+  tf2::Transform transform;
+  TimePoint time_out;
+  lookupTransform(target_frame, source_frame, time, transform, time_out);
+  return transformToMsg(transform, time_out, target_frame, source_frame);
+}
+
+geometry_msgs::msg::TransformStamped ShardedBuffer::lookupTransform(
+  const std::string & target_frame, const TimePoint & target_time,
+  const std::string & source_frame, const TimePoint & source_time,
+  const std::string & fixed_frame) const
+{
+  tf2::Transform fixed_from_source;
+  TimePoint source_time_out;
+  lookupTransform(fixed_frame, source_frame, source_time, fixed_from_source, source_time_out);
+  tf2::Transform target_from_fixed;
+  TimePoint target_time_out;
+  lookupTransform(target_frame, fixed_frame, target_time, target_from_fixed, target_time_out);
+  return transformToMsg(
+    target_from_fixed * fixed_from_source, target_time_out, target_frame, source_frame);
+}
+
+bool ShardedBuffer::canTransform(
+  const std::string & target_frame, const std::string & source_frame,
+  const TimePoint & time, std::string * error_msg) const
+{
+  tf2::Transform transform;
+  TimePoint time_out;
+  try {
+    lookupTransform(target_frame, source_frame, time, transform, time_out);
+  } catch (const TransformException & ex) {
+    if (error_msg) {
+      *error_msg = ex.what();
+    }
+    return false;
+  }
+  return true;
+}
+
+bool ShardedBuffer::canTransform(
+  const std::string & target_frame, const TimePoint & target_time,
+  const std::string & source_frame, const TimePoint & source_time,
+  const std::string & fixed_frame, std::string * error_msg) const
+{
+  return canTransform(target_frame, fixed_frame, target_time, error_msg) &&
+         canTransform(fixed_frame, source_frame, source_time, error_msg);
+}
+
+std::vector<std::string> ShardedBuffer::getAllFrameNames() const
+{
+  // Parents from other shards are known to each shard that has children of theirs
+  std::set<std::string> frames;
+  for (const auto & shard : shards_) {
+    std::vector<std::string> shard_frames = shard->getAllFrameNames();
+    frames.insert(shard_frames.begin(), shard_frames.end());
+  }
+  return std::vector<std::string>(frames.begin(), frames.end());
+}
+
+}  // namespace tf2
@@ -0,0 +1,791 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tf2/shared_buffer.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "console_bridge/console.h"
+#include "tf2/buffer_core.h"
+#include "tf2/exceptions.h"
+
+namespace tf2
+{
+
+// Defined in cache.cpp, so all caches look up and report extrapolation the same way
+namespace cache
+{
+void createExtrapolationException1(TimePoint t0, TimePoint t1, std::string * error_str);
+void createExtrapolationException3(TimePoint t0, TimePoint t1, std::string * error_str);
+bool interpolateSamples(
+  const TransformStorage & one, const TransformStorage & two, TimePoint time, tf2Scalar min_dot,
+  tf2::Duration max_extrapolation, TransformStorage * output, std::string * error_str);
+}  // namespace cache
+
+namespace
+{
+const uint64_t SEGMENT_MAGIC = 0x5446325348425546ULL;
+const uint32_t SEGMENT_VERSION = 1;
+const size_t MAX_FRAME_NAME_LENGTH = 128;
+
+// Everything in the segment is accessed through lock free atomics, which are address free and
+// so work across processes mapping the segment at different addresses.
+struct SegmentHeader
+{
+  std::atomic<uint64_t> magic;
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t max_frames;
+  uint64_t samples_per_frame;
+  /// Frame slots in use, slot 0 is never used so a parent of 0 means no parent
+  std::atomic<uint64_t> frame_count;
+};
+
+struct SharedSample
+{
+  std::atomic<int64_t> stamp;
+  std::atomic<double> rotation[4];
+  std::atomic<double> translation[3];
+  std::atomic<uint32_t> parent;
+};
+
+struct SharedFrame
+{
+  /// Written once before frame_count is increased past this frame
+  char name[MAX_FRAME_NAME_LENGTH];
+  /// Odd while the writer changes the samples
+  std::atomic<uint32_t> sequence;
+  std::atomic<uint32_t> is_static;
+  /// Samples set since the frame was last cleared, the newest is at (count - 1) % capacity
+  std::atomic<uint64_t> count;
+  // Followed by samples_per_frame SharedSamples
+};
+
+/// The newest sample, or the ones right before and after a time, copied out of a frame
+struct FrameRead
+{
+  enum Result {NoData, One, Two, ExtrapolationSingle, ExtrapolationPast};
+  Result result;
+  // The samples in the order of TimeCache::findClosest()
+  int64_t stamp[2];
+  double rotation[2][4];
+  double translation[2][3];
+  uint32_t parent[2];
+  bool is_static;
+};
+
+std::string stripSlash(const std::string & in)
+{
+  if (!in.empty() && in[0] == '/') {
+    return in.substr(1);
+  }
+  return in;
+}
+}  // namespace
+
+class SharedSegment
+{
+public:
+  SharedSegment(const std::string & name, const SharedBufferOptions * options)
+  {
+#ifdef _WIN32
+    (void)name;
+    (void)options;
+    throw std::runtime_error("tf2 shared buffers are only supported on POSIX systems");
+#else
+    if (name.empty() || name.find('/') != std::string::npos) {
+      throw std::runtime_error("Invalid tf2 shared buffer name \"" + name + "\"");
+    }
+    std::atomic<double> test_double;
+    std::atomic<uint64_t> test_int;
+    if (!test_double.is_lock_free() || !test_int.is_lock_free()) {
+      throw std::runtime_error("tf2 shared buffers need lock free 64 bit atomics");
+    }
+
+    path_ = "/" + name;
+    owner_ = options != nullptr;
+    int fd;
+    if (owner_) {
+      // A writer that crashed leaves its segment behind, replace it
+      shm_unlink(path_.c_str());
+      fd = shm_open(path_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+      size_ = segmentSize(options->max_frames, options->samples_per_frame);
+      if (fd >= 0 && ftruncate(fd, static_cast<off_t>(size_)) != 0) {
+        close(fd);
+        fd = -1;
+      }
+    } else {
+      fd = shm_open(path_.c_str(), O_RDONLY, 0);
+      struct stat st;
+      if (fd >= 0 && fstat(fd, &st) == 0) {
+        size_ = static_cast<size_t>(st.st_size);
+      } else {
+        size_ = 0;
+      }
+    }
+    if (fd < 0) {
+      throw std::runtime_error(
+        "Failed to open the tf2 shared buffer " + path_ + ": " + std::strerror(errno));
+    }
+
+    if (size_ >= sizeof(SegmentHeader)) {
+      memory_ = mmap(
+        nullptr, size_, owner_ ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (memory_ == nullptr || memory_ == MAP_FAILED) {
+      memory_ = nullptr;
+      throwAndUnmap("Failed to map the tf2 shared buffer " + path_);
+    }
+
+    if (owner_) {
+      // The memory is zero filled, which is a valid empty state for everything in it
+      SegmentHeader * header = new (memory_) SegmentHeader();
+      header->version = SEGMENT_VERSION;
+      header->max_frames = options->max_frames;
+      header->samples_per_frame = options->samples_per_frame;
+      header->frame_count.store(1, std::memory_order_relaxed);
+      header->magic.store(SEGMENT_MAGIC, std::memory_order_release);
+    } else {
+      const SegmentHeader * header = static_cast<const SegmentHeader *>(memory_);
+      if (header->magic.load(std::memory_order_acquire) != SEGMENT_MAGIC ||
+        header->version != SEGMENT_VERSION ||
+        size_ != segmentSize(header->max_frames, header->samples_per_frame))
+      {
+        throwAndUnmap(path_ + " is not a tf2 shared buffer compatible with this version");
+      }
+    }
+#endif
+  }
+
+  ~SharedSegment()
+  {
+#ifndef _WIN32
+    if (memory_) {
+      munmap(memory_, size_);
+    }
+    if (owner_) {
+      shm_unlink(path_.c_str());
+    }
+#endif
+  }
+
+  SegmentHeader & header() const {return *static_cast<SegmentHeader *>(memory_);}
+
+  SharedFrame & frame(uint32_t index) const
+  {
+    return *reinterpret_cast<SharedFrame *>(
+      static_cast<char *>(memory_) + sizeof(SegmentHeader) + index * frameStride());
+  }
+
+  SharedSample & sample(SharedFrame & frame, uint64_t slot) const
+  {
+    return reinterpret_cast<SharedSample *>(&frame + 1)[slot];
+  }
+
+  size_t maxFrames() const {return header().max_frames;}
+  size_t capacity() const {return header().samples_per_frame;}
+
+private:
+  static size_t segmentSize(size_t max_frames, size_t samples_per_frame)
+  {
+    return sizeof(SegmentHeader) +
+           (max_frames + 1) * (sizeof(SharedFrame) + samples_per_frame * sizeof(SharedSample));
+  }
+
+  size_t frameStride() const
+  {
+    return sizeof(SharedFrame) + capacity() * sizeof(SharedSample);
+  }
+
+  void throwAndUnmap(const std::string & message)
+  {
+#ifndef _WIN32
+    if (memory_) {
+      munmap(memory_, size_);
+      memory_ = nullptr;
+    }
+    if (owner_) {
+      shm_unlink(path_.c_str());
+    }
+#endif
+    throw std::runtime_error(message);
+  }
+
+  std::string path_;
+  bool owner_ = false;
+  void * memory_ = nullptr;
+  size_t size_ = 0;
+};
+
+namespace
+{
+void writeSample(
+  SharedSample & sample, const geometry_msgs::msg::TransformStamped & transform,
+  int64_t stamp, uint32_t parent)
+{
+  const geometry_msgs::msg::Quaternion & q = transform.transform.rotation;
+  const geometry_msgs::msg::Vector3 & t = transform.transform.translation;
+  sample.stamp.store(stamp, std::memory_order_relaxed);
+  sample.rotation[0].store(q.x, std::memory_order_relaxed);
+  sample.rotation[1].store(q.y, std::memory_order_relaxed);
+  sample.rotation[2].store(q.z, std::memory_order_relaxed);
+  sample.rotation[3].store(q.w, std::memory_order_relaxed);
+  sample.translation[0].store(t.x, std::memory_order_relaxed);
+  sample.translation[1].store(t.y, std::memory_order_relaxed);
+  sample.translation[2].store(t.z, std::memory_order_relaxed);
+  sample.parent.store(parent, std::memory_order_relaxed);
+}
+
+void readSample(const SharedSample & sample, FrameRead & read, int i)
+{
+  read.stamp[i] = sample.stamp.load(std::memory_order_relaxed);
+  for (int j = 0; j < 4; ++j) {
+    read.rotation[i][j] = sample.rotation[j].load(std::memory_order_relaxed);
+  }
+  for (int j = 0; j < 3; ++j) {
+    read.translation[i][j] = sample.translation[j].load(std::memory_order_relaxed);
+  }
+  read.parent[i] = sample.parent.load(std::memory_order_relaxed);
+}
+
+/// Copy the samples of frame needed at time, the same ones TimeCache::findClosest() picks
+/// \return false if the writer seems to have died while updating the frame
+bool readFrame(const SharedSegment & segment, uint32_t index, TimePoint time, FrameRead & read)
+{
+  // Updates take well under a microsecond, so this many retries means the writer is gone
+  const int MAX_ATTEMPTS = 100000;
+
+  SharedFrame & frame = segment.frame(index);
+  const uint64_t capacity = segment.capacity();
+  const int64_t target = time.time_since_epoch().count();
+  for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+    uint32_t sequence = frame.sequence.load(std::memory_order_acquire);
+    if (sequence & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    uint64_t count = frame.count.load(std::memory_order_relaxed);
+    uint64_t size = std::min(count, capacity);
+    read.is_static = frame.is_static.load(std::memory_order_relaxed) != 0;
+    auto at = [&](uint64_t i) -> SharedSample & {
+        return segment.sample(frame, (count - size + i) % capacity);
+      };
+    // The first sample newer than stamp
+    auto upper_bound = [&](int64_t stamp) {
+        uint64_t first = 0;
+        uint64_t remaining = size;
+        while (remaining > 0) {
+          uint64_t step = remaining / 2;
+          if (at(first + step).stamp.load(std::memory_order_relaxed) <= stamp) {
+            first += step + 1;
+            remaining -= step + 1;
+          } else {
+            remaining = step;
+          }
+        }
+        // A concurrent write may have produced garbage, which the sequence check below discards
+        return std::max<uint64_t>(1, std::min(first, size - 1));
+      };
+    if (size == 0) {
+      read.result = FrameRead::NoData;
+    } else if (read.is_static || time == TimePointZero) {
+      read.result = FrameRead::One;
+      readSample(at(size - 1), read, 0);
+    } else {
+      int64_t latest = at(size - 1).stamp.load(std::memory_order_relaxed);
+      int64_t earliest = at(0).stamp.load(std::memory_order_relaxed);
+      if (target == latest) {
+        read.result = FrameRead::One;
+        readSample(at(size - 1), read, 0);
+      } else if (target == earliest) {
+        read.result = FrameRead::One;
+        readSample(at(0), read, 0);
+      } else if (size == 1) {
+        read.result = FrameRead::ExtrapolationSingle;
+        read.stamp[0] = earliest;
+      } else if (target > latest) {
+        // The newest sample and the last one before its stamp, to extrapolate from if allowed
+        read.result = FrameRead::Two;
+        readSample(at(earliest < latest ? upper_bound(latest - 1) - 1 : size - 1), read, 0);
+        readSample(at(size - 1), read, 1);
+      } else if (target < earliest) {
+        read.result = FrameRead::ExtrapolationPast;
+        read.stamp[0] = earliest;
+      } else {
+        // Strictly between oldest and newest, so both neighbours exist
+        uint64_t first = upper_bound(target);
+        read.result = FrameRead::Two;
+        readSample(at(first - 1), read, 0);
+        readSample(at(first), read, 1);
+      }
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (frame.sequence.load(std::memory_order_relaxed) == sequence) {
+      return true;
+    }
+  }
+  return false;
+}
+
+TransformStorage sampleStorage(const FrameRead & read, int i)
+{
+  return TransformStorage(
+    TimePoint(std::chrono::nanoseconds(read.stamp[i])),
+    tf2::Quaternion(read.rotation[i][0], read.rotation[i][1], read.rotation[i][2],
+    read.rotation[i][3]),
+    tf2::Vector3(read.translation[i][0], read.translation[i][1], read.translation[i][2]),
+    read.parent[i], 0);
+}
+}  // namespace
+
+SharedBufferWriter::SharedBufferWriter(
+  const std::string & name, const SharedBufferOptions & options)
+: segment_(new SharedSegment(name, &options))
+{
+}
+
+SharedBufferWriter::~SharedBufferWriter() {}
+
+uint32_t SharedBufferWriter::registerFrame(const std::string & frame_id)
+{
+  auto it = frame_ids_.find(frame_id);
+  if (it != frame_ids_.end()) {
+    return it->second;
+  }
+
+  SegmentHeader & header = segment_->header();
+  uint64_t index = header.frame_count.load(std::memory_order_relaxed);
+  if (index > segment_->maxFrames()) {
+    return 0;
+  }
+  std::strncpy(segment_->frame(index).name, frame_id.c_str(), MAX_FRAME_NAME_LENGTH - 1);
+  header.frame_count.store(index + 1, std::memory_order_release);
+  frame_ids_[frame_id] = static_cast<uint32_t>(index);
+  return static_cast<uint32_t>(index);
+}
+
+bool SharedBufferWriter::setTransform(
+  const geometry_msgs::msg::TransformStamped & transform,
+  const std::string & authority, bool is_static)
+{
+  std::string frame_id = stripSlash(transform.header.frame_id);
+  std::string child_frame_id = stripSlash(transform.child_frame_id);
+  const geometry_msgs::msg::Quaternion & q = transform.transform.rotation;
+  const geometry_msgs::msg::Vector3 & t = transform.transform.translation;
+  if (frame_id.empty() || child_frame_id.empty() || frame_id == child_frame_id ||
+    frame_id.size() >= MAX_FRAME_NAME_LENGTH || child_frame_id.size() >= MAX_FRAME_NAME_LENGTH)
+  {
+    CONSOLE_BRIDGE_logError(
+      "Ignoring transform from \"%s\" to \"%s\" from authority \"%s\" because the frame ids are "
+      "invalid", frame_id.c_str(), child_frame_id.c_str(), authority.c_str());
+    return false;
+  }
+  if (std::isnan(t.x) || std::isnan(t.y) || std::isnan(t.z) ||
+    std::isnan(q.x) || std::isnan(q.y) || std::isnan(q.z) || std::isnan(q.w) ||
+    std::abs(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w - 1.0) >= 10e-3)
+  {
+    CONSOLE_BRIDGE_logError(
+      "TF_NAN_INPUT: Ignoring transform for child_frame_id \"%s\" from authority \"%s\" because"
+      " of a nan value or an unnormalized quaternion", child_frame_id.c_str(), authority.c_str());
+    return false;
+  }
+  int64_t stamp = (std::chrono::seconds(transform.header.stamp.sec) +
+    std::chrono::nanoseconds(transform.header.stamp.nanosec)).count();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint32_t child = registerFrame(child_frame_id);
+  uint32_t parent = registerFrame(frame_id);
+  if (child == 0 || parent == 0) {
+    CONSOLE_BRIDGE_logError(
+      "Ignoring transform for child_frame_id \"%s\" because the shared buffer is full",
+      child_frame_id.c_str());
+    return false;
+  }
+
+  SharedFrame & frame = segment_->frame(child);
+  const uint64_t capacity = segment_->capacity();
+  uint64_t count = frame.count.load(std::memory_order_relaxed);
+  bool was_static = frame.is_static.load(std::memory_order_relaxed) != 0;
+  if (is_static || was_static) {
+    // Static frames keep only their latest sample, switching type drops the history
+    count = 0;
+  } else if (count > 0 &&
+    segment_->sample(frame, (count - 1) % capacity).stamp.load(std::memory_order_relaxed) > stamp)
+  {
+    CONSOLE_BRIDGE_logWarn(
+      "TF_OLD_DATA ignoring data from the past for frame %s according to authority %s, the "
+      "shared buffer only accepts data in order", child_frame_id.c_str(), authority.c_str());
+    return false;
+  }
+
+  uint32_t sequence = frame.sequence.load(std::memory_order_relaxed);
+  frame.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  writeSample(segment_->sample(frame, count % capacity), transform, stamp, parent);
+  frame.is_static.store(is_static ? 1 : 0, std::memory_order_relaxed);
+  frame.count.store(count + 1, std::memory_order_relaxed);
+  frame.sequence.store(sequence + 2, std::memory_order_release);
+  return true;
+}
+
+void SharedBufferWriter::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t frame_count = segment_->header().frame_count.load(std::memory_order_relaxed);
+  for (uint32_t index = 1; index < frame_count; ++index) {
+    SharedFrame & frame = segment_->frame(index);
+    uint32_t sequence = frame.sequence.load(std::memory_order_relaxed);
+    frame.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    frame.count.store(0, std::memory_order_relaxed);
+    frame.sequence.store(sequence + 2, std::memory_order_release);
+  }
+}
+
+SharedBufferReader::SharedBufferReader(const std::string & name, const RetentionPolicy & policy)
+: segment_(new SharedSegment(name, nullptr)),
+  nlerp_min_dot_(getNlerpMinDot(policy)),
+  max_extrapolation_(policy.max_extrapolation),
+  frame_names_(1, "NO_PARENT")
+{
+}
+
+SharedBufferReader::~SharedBufferReader() {}
+
+void SharedBufferReader::clear() {}
+
+uint32_t SharedBufferReader::resolveFrame(
+  const char * function_name_arg, const std::string & frame_id) const
+{
+  if (frame_id.empty()) {
+    throw tf2::InvalidArgumentException(
+      "Invalid argument \"" + frame_id + "\" passed to " + function_name_arg +
+      " - in tf2 frame_ids cannot be empty");
+  }
+  if (frame_id[0] == '/') {
+    throw tf2::InvalidArgumentException(
+      "Invalid argument \"" + frame_id + "\" passed to " + function_name_arg +
+      " - in tf2 frame_ids cannot start with a '/'");
+  }
+
+  std::lock_guard<std::mutex> lock(frame_ids_mutex_);
+  auto it = frame_ids_.find(frame_id);
+  if (it == frame_ids_.end()) {
+    refreshFramesNoLock();
+    it = frame_ids_.find(frame_id);
+  }
+  if (it == frame_ids_.end()) {
+    throw tf2::LookupException(
+      "\"" + frame_id + "\" passed to " + function_name_arg + " does not exist. ");
+  }
+  return it->second;
+}
+
+void SharedBufferReader::refreshFramesNoLock() const
+{
+  uint64_t frame_count = std::min<uint64_t>(
+    segment_->header().frame_count.load(std::memory_order_acquire), segment_->maxFrames() + 1);
+  for (uint32_t index = static_cast<uint32_t>(frame_names_.size()); index < frame_count; ++index) {
+    const char * name = segment_->frame(index).name;
+    frame_names_.emplace_back(name, strnlen(name, MAX_FRAME_NAME_LENGTH));
+    frame_ids_[frame_names_.back()] = index;
+  }
+}
+
+std::string SharedBufferReader::frameName(uint32_t frame) const
+{
+  std::lock_guard<std::mutex> lock(frame_ids_mutex_);
+  if (frame >= frame_names_.size()) {
+    refreshFramesNoLock();
+  }
+  return frame < frame_names_.size() ? frame_names_[frame] : std::string();
+}
+
+bool SharedBufferReader::walkToTopParent(
+  uint32_t start, TimePoint time, const std::vector<Step> & meet, std::vector<Step> & steps,
+  std::string & extrapolation_error) const
+{
+  steps.clear();
+  steps.push_back(Step{start, tf2::Transform::getIdentity(), TimePointZero});
+  FrameRead read;
+  while (true) {
+    Step & step = steps.back();
+    auto met = std::find_if(
+      meet.begin(), meet.end(), [&](const Step & s) {return s.frame == step.frame;});
+    if (met != meet.end()) {
+      return true;
+    }
+    if (!readFrame(*segment_, step.frame, time, read)) {
+      throw LookupException(
+        "The writer of the shared buffer stopped while updating frame [" +
+        frameName(step.frame) + "]");
+    }
+
+    TimePoint stamp{std::chrono::nanoseconds(read.stamp[0])};
+    switch (read.result) {
+      case FrameRead::NoData:
+        // The root of the tree
+        return true;
+      case FrameRead::One:
+      case FrameRead::Two:
+        break;
+      case FrameRead::ExtrapolationSingle:
+        cache::createExtrapolationException1(time, stamp, &extrapolation_error);
+        return false;
+      case FrameRead::ExtrapolationPast:
+        cache::createExtrapolationException3(time, stamp, &extrapolation_error);
+        return false;
+    }
+
+    TransformStorage sample = sampleStorage(read, 0);
+    if (read.result == FrameRead::Two &&
+      !cache::interpolateSamples(
+        sample, sampleStorage(read, 1), time, nlerp_min_dot_, max_extrapolation_, &sample,
+        &extrapolation_error))
+    {
+      return false;
+    }
+    tf2::Transform link(sample.rotation_, sample.translation_);
+    uint32_t parent = sample.frame_id_;
+    step.latest = read.is_static ? TimePointZero : stamp;
+
+    if (parent == 0 || parent > segment_->maxFrames()) {
+      throw LookupException(
+        "The shared buffer holds an invalid parent for frame [" + frameName(step.frame) + "]");
+    }
+    if (steps.size() > BufferCore::MAX_GRAPH_DEPTH) {
+      throw LookupException("The tf tree is invalid because it contains a loop.");
+    }
+    steps.push_back(Step{parent, link * step.transform, TimePointZero});
+  }
+}
+
+void SharedBufferReader::lookupTransformImpl(
+  uint32_t target, uint32_t source, TimePoint time,
+  tf2::Transform & transform, TimePoint & time_out) const
+{
+  const std::vector<Step> target_only{Step{target, tf2::Transform::getIdentity(), TimePointZero}};
+  std::vector<Step> source_steps;
+  std::vector<Step> target_steps;
+  size_t source_index = 0;
+  size_t target_index = 0;
+
+  // Walk up from the source and then from the target until they meet, the same way
+  // BufferCore::walkToTopParent() does
+  auto walk = [&](TimePoint walk_time) {
+      auto describe = [&](const std::string & error) {
+          return error + ", when looking up transform from frame [" + frameName(source) +
+                 "] to frame [" + frameName(target) + "]";
+        };
+      std::string source_error;
+      std::string target_error;
+      bool source_ok = walkToTopParent(source, walk_time, target_only, source_steps, source_error);
+      if (source_steps.back().frame == target) {
+        target_steps = target_only;
+        source_index = source_steps.size() - 1;
+        target_index = 0;
+        return;
+      }
+      if (!walkToTopParent(target, walk_time, source_steps, target_steps, target_error)) {
+        throw ExtrapolationException(describe(target_error));
+      }
+      target_index = target_steps.size() - 1;
+      auto met = std::find_if(
+        source_steps.begin(), source_steps.end(),
+        [&](const Step & s) {return s.frame == target_steps.back().frame;});
+      if (met != source_steps.end()) {
+        source_index = static_cast<size_t>(met - source_steps.begin());
+        return;
+      }
+      if (!source_ok) {
+        throw ExtrapolationException(describe(source_error));
+      }
+      throw ConnectivityException(
+        "Could not find a connection between '" + frameName(target) + "' and '" +
+        frameName(source) + "' because they are not part of the same tree." +
+        "Tf has two or more unconnected trees.");
+    };
+
+  // At time zero the latest samples below where the walks meet give the time to look up at,
+  // like BufferCore::getLatestCommonTime()
+  if (time == TimePointZero) {
+    walk(TimePointZero);
+    TimePoint common_time = TimePoint::max();
+    for (size_t i = 0; i < source_index; ++i) {
+      if (source_steps[i].latest != TimePointZero) {
+        common_time = std::min(common_time, source_steps[i].latest);
+      }
+    }
+    for (size_t i = 0; i < target_index; ++i) {
+      if (target_steps[i].latest != TimePointZero) {
+        common_time = std::min(common_time, target_steps[i].latest);
+      }
+    }
+    time = common_time == TimePoint::max() ? TimePointZero : common_time;
+  }
+  if (time != TimePointZero) {
+    walk(time);
+  }
+
+  transform = target_steps[target_index].transform.inverse() *
+    source_steps[source_index].transform;
+  time_out = time;
+}
+
+geometry_msgs::msg::TransformStamped SharedBufferReader::lookupTransform(
+  const std::string & target_frame, const std::string & source_frame,
+  const TimePoint & time) const
+{
+  uint32_t target = resolveFrame("lookupTransform argument target_frame", target_frame);
+  uint32_t source = resolveFrame("lookupTransform argument source_frame", source_frame);
+
+  tf2::Transform transform;
+  TimePoint time_out;
+  if (target == source) {
+    transform.setIdentity();
+    time_out = time;
+    FrameRead read;
+    if (time == TimePointZero && readFrame(*segment_, target, time, read)) {
+      if (read.result == FrameRead::One && !read.is_static) {
+        time_out = TimePoint(std::chrono::nanoseconds(read.stamp[0]));
+      }
+    }
+  } else {
+    lookupTransformImpl(target, source, time, transform, time_out);
+  }
+
+  geometry_msgs::msg::TransformStamped msg;
+  msg.header.stamp.sec = static_cast<int32_t>(
+    std::chrono::duration_cast<std::chrono::seconds>(time_out.time_since_epoch()).count());
+  msg.header.stamp.nanosec = static_cast<uint32_t>(
+    time_out.time_since_epoch().count() % 1000000000ULL);
+  msg.header.frame_id = target_frame;
+  msg.child_frame_id = source_frame;
+  msg.transform.translation.x = transform.getOrigin().x();
+  msg.transform.translation.y = transform.getOrigin().y();
+  msg.transform.translation.z = transform.getOrigin().z();
+  msg.transform.rotation.x = transform.getRotation().x();
+  msg.transform.rotation.y = transform.getRotation().y();
+  msg.transform.rotation.z = transform.getRotation().z();
+  msg.transform.rotation.w = transform.getRotation().w();
+  return msg;
+}
+
+geometry_msgs::msg::TransformStamped SharedBufferReader::lookupTransform(
+  const std::string & target_frame, const TimePoint & target_time,
+  const std::string & source_frame, const TimePoint & source_time,
+  const std::string & fixed_frame) const
+{
+  resolveFrame("lookupTransform argument target_frame", target_frame);
+  resolveFrame("lookupTransform argument source_frame", source_frame);
+  resolveFrame("lookupTransform argument fixed_frame", fixed_frame);
+
+  geometry_msgs::msg::TransformStamped source_to_fixed =
+    lookupTransform(fixed_frame, source_frame, source_time);
+  geometry_msgs::msg::TransformStamped fixed_to_target =
+    lookupTransform(target_frame, fixed_frame, target_time);
+
+  auto toTransform = [](const geometry_msgs::msg::Transform & t) {
+      return tf2::Transform(
+        tf2::Quaternion(t.rotation.x, t.rotation.y, t.rotation.z, t.rotation.w),
+        tf2::Vector3(t.translation.x, t.translation.y, t.translation.z));
+    };
+  tf2::Transform transform =
+    toTransform(fixed_to_target.transform) * toTransform(source_to_fixed.transform);
+
+  geometry_msgs::msg::TransformStamped msg = fixed_to_target;
+  msg.child_frame_id = source_frame;
+  msg.transform.translation.x = transform.getOrigin().x();
+  msg.transform.translation.y = transform.getOrigin().y();
+  msg.transform.translation.z = transform.getOrigin().z();
+  msg.transform.rotation.x = transform.getRotation().x();
+  msg.transform.rotation.y = transform.getRotation().y();
+  msg.transform.rotation.z = transform.getRotation().z();
+  msg.transform.rotation.w = transform.getRotation().w();
+  return msg;
+}
+
+bool SharedBufferReader::canTransform(
+  const std::string & target_frame, const std::string & source_frame,
+  const TimePoint & time, std::string * error_msg) const
+{
+  try {
+    lookupTransform(target_frame, source_frame, time);
+    return true;
+  } catch (const tf2::TransformException & ex) {
+    if (error_msg) {
+      *error_msg = ex.what();
+    }
+    return false;
+  }
+}
+
+bool SharedBufferReader::canTransform(
+  const std::string & target_frame, const TimePoint & target_time,
+  const std::string & source_frame, const TimePoint & source_time,
+  const std::string & fixed_frame, std::string * error_msg) const
+{
+  try {
+    lookupTransform(target_frame, target_time, source_frame, source_time, fixed_frame);
+    return true;
+  } catch (const tf2::TransformException & ex) {
+    if (error_msg) {
+      *error_msg = ex.what();
+    }
+    return false;
+  }
+}
+
+std::vector<std::string> SharedBufferReader::getAllFrameNames() const
+{
+  std::lock_guard<std::mutex> lock(frame_ids_mutex_);
+  refreshFramesNoLock();
+  return std::vector<std::string>(frame_names_.begin() + 1, frame_names_.end());
+}
+
+}  // namespace tf2
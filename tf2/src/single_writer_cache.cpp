@@ -0,0 +1,433 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tf2/time_cache.h"
+
+#include "tf2/LinearMath/Quaternion.h"
+#include "tf2/LinearMath/Vector3.h"
+
+namespace tf2
+{
+
+// Defined in cache.cpp, so all caches look up and report extrapolation the same way
+namespace cache
+{
+void createExtrapolationException1(TimePoint t0, TimePoint t1, std::string * error_str);
+void createExtrapolationException3(TimePoint t0, TimePoint t1, std::string * error_str);
+bool interpolateSamples(
+  const TransformStorage & one, const TransformStorage & two, TimePoint time, tf2Scalar min_dot,
+  tf2::Duration max_extrapolation, TransformStorage * output, std::string * error_str);
+}  // namespace cache
+
+namespace
+{
+const size_t INITIAL_CAPACITY = 16;
+}  // namespace
+
+SingleWriterCache::SingleWriterCache(tf2::Duration max_storage_time)
+: ring_(nullptr),
+  begin_(0),
+  end_(0),
+  claimed_(0),
+  nlerp_min_dot_(getNlerpMinDot(RetentionPolicy())),
+  max_extrapolation_(tf2::Duration::zero()),
+  max_storage_time_(max_storage_time),
+  default_max_storage_time_(max_storage_time),
+  max_samples_(TimeCache::MAX_LENGTH_LINKED_LIST)
+{
+  rings_.emplace_back(new Ring(INITIAL_CAPACITY));
+  ring_.store(rings_.back().get(), std::memory_order_release);
+}
+
+void SingleWriterCache::store(Slot & slot, const TransformStorage & sample)
+{
+  for (int i = 0; i < 4; ++i) {
+    slot.rotation[i].store(sample.rotation_[i], std::memory_order_relaxed);
+  }
+  for (int i = 0; i < 3; ++i) {
+    slot.translation[i].store(sample.translation_[i], std::memory_order_relaxed);
+  }
+  slot.stamp.store(sample.stamp_.time_since_epoch().count(), std::memory_order_relaxed);
+  slot.frame_id.store(sample.frame_id_, std::memory_order_relaxed);
+  slot.child_frame_id.store(sample.child_frame_id_, std::memory_order_relaxed);
+}
+
+TransformStorage SingleWriterCache::load(const Slot & slot)
+{
+  TransformStorage sample;
+  sample.rotation_.setValue(
+    slot.rotation[0].load(std::memory_order_relaxed),
+    slot.rotation[1].load(std::memory_order_relaxed),
+    slot.rotation[2].load(std::memory_order_relaxed),
+    slot.rotation[3].load(std::memory_order_relaxed));
+  sample.translation_.setValue(
+    slot.translation[0].load(std::memory_order_relaxed),
+    slot.translation[1].load(std::memory_order_relaxed),
+    slot.translation[2].load(std::memory_order_relaxed));
+  sample.stamp_ = loadStamp(slot);
+  sample.frame_id_ = slot.frame_id.load(std::memory_order_relaxed);
+  sample.child_frame_id_ = slot.child_frame_id.load(std::memory_order_relaxed);
+  return sample;
+}
+
+TimePoint SingleWriterCache::loadStamp(const Slot & slot)
+{
+  return TimePoint(std::chrono::nanoseconds(slot.stamp.load(std::memory_order_relaxed)));
+}
+
+template<class F>
+bool SingleWriterCache::read(F f) const
+{
+  while (true) {
+    // Load end_ first, the ring published before it holds every sample up to it.  Samples
+    // pruned before growing are not copied, so begin_ must not be older than the ring.
+    View view;
+    view.end = end_.load(std::memory_order_acquire);
+    view.ring = ring_.load(std::memory_order_acquire);
+    view.begin = begin_.load(std::memory_order_acquire);
+    if (view.begin > view.end) {
+      // Pruned past the end loaded, there are newer samples to look at
+      continue;
+    }
+
+    uint64_t oldest_used = view.end;
+    bool result = f(view, oldest_used);
+
+    // A sample is intact until the writer claims the index that wraps onto its slot
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (claimed_.load(std::memory_order_relaxed) <= oldest_used + view.ring->mask + 1) {
+      return result;
+    }
+  }
+}
+
+uint64_t SingleWriterCache::upperBound(const View & view, TimePoint time)
+{
+  uint64_t first = view.begin;
+  uint64_t count = view.end - view.begin;
+  while (count > 0) {
+    uint64_t step = count / 2;
+    if (loadStamp(view.ring->at(first + step)) <= time) {
+      first += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  return first;
+}
+
+bool SingleWriterCache::getData(
+  TimePoint time, TransformStorage & data_out,
+  std::string * error_str)
+{
+  tf2Scalar min_dot = nlerp_min_dot_.load(std::memory_order_relaxed);
+  tf2::Duration max_extrapolation = max_extrapolation_.load(std::memory_order_relaxed);
+  return read(
+    [&](const View & view, uint64_t & oldest_used) {
+      if (view.begin == view.end) {
+        return false;
+      }
+      const Ring & ring = *view.ring;
+      uint64_t newest = view.end - 1;
+
+      // If time == 0 return the latest
+      if (time == TimePointZero) {
+        oldest_used = newest;
+        data_out = load(ring.at(newest));
+        return true;
+      }
+
+      oldest_used = view.begin;
+      TimePoint earliest_time = loadStamp(ring.at(view.begin));
+      if (view.begin == newest) {
+        if (earliest_time != time) {
+          cache::createExtrapolationException1(time, earliest_time, error_str);
+          return false;
+        }
+        data_out = load(ring.at(newest));
+        return true;
+      }
+
+      TimePoint latest_time = loadStamp(ring.at(newest));
+      if (time == latest_time) {
+        data_out = load(ring.at(newest));
+        return true;
+      } else if (time == earliest_time) {
+        data_out = load(ring.at(view.begin));
+        return true;
+      } else if (time < earliest_time) {
+        cache::createExtrapolationException3(time, earliest_time, error_str);
+        return false;
+      }
+
+      uint64_t older;
+      uint64_t newer;
+      if (time > latest_time) {
+        // The newest sample and the last one before its stamp, cache::interpolateSamples()
+        // decides whether to extrapolate from them
+        newer = newest;
+        older = earliest_time < latest_time ?
+          upperBound(view, latest_time - tf2::Duration(1)) - 1 : newest;
+      } else {
+        // Strictly between the oldest and newest sample, so both neighbours exist
+        newer = upperBound(view, time);
+        older = newer - 1;
+      }
+      return cache::interpolateSamples(
+        load(ring.at(older)), load(ring.at(newer)), time, min_dot, max_extrapolation, &data_out,
+        error_str);
+    });
+}
+
+CompactFrameID SingleWriterCache::getParent(TimePoint time, std::string * error_str)
+{
+  // getData() reports the parent of the older sample it picked, like TimeCache::getParent()
+  TransformStorage sample;
+  if (!getData(time, sample, error_str)) {
+    return 0;
+  }
+  return sample.frame_id_;
+}
+
+bool SingleWriterCache::insertData(const TransformStorage & new_data)
+{
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  return insertDataLocked(new_data);
+}
+
+bool SingleWriterCache::insertDataCounted(
+  const TransformStorage & new_data, int64_t & length_change)
+{
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  int64_t previous_length = end_.load(std::memory_order_relaxed) -
+    begin_.load(std::memory_order_relaxed);
+  bool inserted = insertDataLocked(new_data);
+  length_change = static_cast<int64_t>(
+    end_.load(std::memory_order_relaxed) - begin_.load(std::memory_order_relaxed)) -
+    previous_length;
+  return inserted;
+}
+
+bool SingleWriterCache::insertDataLocked(const TransformStorage & new_data)
+{
+  uint64_t begin = begin_.load(std::memory_order_relaxed);
+  uint64_t end = end_.load(std::memory_order_relaxed);
+  Ring * ring = ring_.load(std::memory_order_relaxed);
+  if (begin != end && loadStamp(ring->at(end - 1)) > new_data.stamp_) {
+    return false;
+  }
+
+  if (end - begin > ring->mask) {
+    ring = grow((ring->mask + 1) * 2);
+  }
+
+  // The slot written last held a sample that was already pruned, but readers that loaded
+  // begin_ before it was may still be using it
+  claimed_.store(end + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  store(ring->at(end), new_data);
+  end_.store(end + 1, std::memory_order_release);
+
+  pruneList(end + 1);
+  return true;
+}
+
+SingleWriterCache::Ring * SingleWriterCache::grow(uint64_t capacity)
+{
+  // Readers may still be using the old ring, so copy it instead of reallocating it
+  uint64_t begin = begin_.load(std::memory_order_relaxed);
+  uint64_t end = end_.load(std::memory_order_relaxed);
+  const Ring * ring = ring_.load(std::memory_order_relaxed);
+  std::unique_ptr<Ring> grown(new Ring(capacity));
+  for (uint64_t i = begin; i < end; ++i) {
+    store(grown->at(i), load(ring->at(i)));
+  }
+  Ring * result = grown.get();
+  rings_.push_back(std::move(grown));
+  ring_.store(result, std::memory_order_release);
+  return result;
+}
+
+void SingleWriterCache::reserve(size_t samples)
+{
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  uint64_t capacity = ring_.load(std::memory_order_relaxed)->mask + 1;
+  uint64_t wanted = capacity;
+  while (wanted < samples) {
+    wanted *= 2;
+  }
+  if (wanted > capacity) {
+    grow(wanted);
+  }
+}
+
+void SingleWriterCache::clearList()
+{
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  begin_.store(end_.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+unsigned int SingleWriterCache::getListLength()
+{
+  uint64_t length = 0;
+  read(
+    [&length](const View & view, uint64_t &) {
+      length = view.end - view.begin;
+      return true;
+    });
+  return static_cast<unsigned int>(length);
+}
+
+P_TimeAndFrameID SingleWriterCache::getLatestTimeAndParent()
+{
+  P_TimeAndFrameID latest(TimePoint(), 0);
+  read(
+    [&latest](const View & view, uint64_t & oldest_used) {
+      if (view.begin == view.end) {
+        latest = std::make_pair(TimePoint(), 0);
+        return false;
+      }
+      oldest_used = view.end - 1;
+      const Slot & slot = view.ring->at(oldest_used);
+      latest = std::make_pair(loadStamp(slot), slot.frame_id.load(std::memory_order_relaxed));
+      return true;
+    });
+  return latest;
+}
+
+TimePoint SingleWriterCache::getLatestTimestamp()
+{
+  return getLatestTimeAndParent().first;
+}
+
+TimePoint SingleWriterCache::getOldestTimestamp()
+{
+  TimePoint oldest;
+  read(
+    [&oldest](const View & view, uint64_t & oldest_used) {
+      // empty list case
+      if (view.begin == view.end) {
+        oldest = TimePoint();
+        return false;
+      }
+      oldest_used = view.begin;
+      oldest = loadStamp(view.ring->at(view.begin));
+      return true;
+    });
+  return oldest;
+}
+
+bool SingleWriterCache::getLatestSnapshot(TransformStorage & data_out) const
+{
+  return read(
+    [&data_out](const View & view, uint64_t & oldest_used) {
+      if (view.begin == view.end) {
+        return false;
+      }
+      oldest_used = view.end - 1;
+      data_out = load(view.ring->at(oldest_used));
+      return true;
+    });
+}
+
+void SingleWriterCache::setRetentionPolicy(const RetentionPolicy & policy)
+{
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  max_storage_time_ = policy.max_age != tf2::Duration::zero() ?
+    policy.max_age : default_max_storage_time_;
+  max_samples_ = policy.max_samples != 0 ?
+    std::min<size_t>(policy.max_samples, TimeCache::MAX_LENGTH_LINKED_LIST) :
+    TimeCache::MAX_LENGTH_LINKED_LIST;
+  nlerp_min_dot_.store(getNlerpMinDot(policy), std::memory_order_relaxed);
+  max_extrapolation_.store(policy.max_extrapolation, std::memory_order_relaxed);
+
+  uint64_t end = end_.load(std::memory_order_relaxed);
+  if (end != begin_.load(std::memory_order_relaxed)) {
+    pruneList(end);
+  }
+}
+
+size_t SingleWriterCache::dropOldest(size_t count)
+{
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  uint64_t begin = begin_.load(std::memory_order_relaxed);
+  uint64_t end = end_.load(std::memory_order_relaxed);
+  // The newest sample is always kept
+  uint64_t dropped = std::min<uint64_t>(count, end - begin > 1 ? end - begin - 1 : 0);
+  begin_.store(begin + dropped, std::memory_order_release);
+  return static_cast<size_t>(dropped);
+}
+
+size_t SingleWriterCache::getMemoryUsage() const
+{
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  size_t bytes = 0;
+  for (const std::unique_ptr<Ring> & ring : rings_) {
+    bytes += (ring->mask + 1) * sizeof(Slot);
+  }
+  return bytes;
+}
+
+void SingleWriterCache::copySamples(std::vector<TransformStorage> & data_out) const
+{
+  std::vector<TransformStorage> samples;
+  read(
+    [&samples](const View & view, uint64_t & oldest_used) {
+      samples.clear();
+      oldest_used = view.begin;
+      for (uint64_t i = view.begin; i < view.end; ++i) {
+        samples.push_back(load(view.ring->at(i)));
+      }
+      return true;
+    });
+  data_out.insert(data_out.end(), samples.begin(), samples.end());
+}
+
+void SingleWriterCache::pruneList(uint64_t end)
+{
+  const Ring * ring = ring_.load(std::memory_order_relaxed);
+  uint64_t begin = begin_.load(std::memory_order_relaxed);
+  TimePoint latest_time = loadStamp(ring->at(end - 1));
+
+  while (begin < end && loadStamp(ring->at(begin)) + max_storage_time_ < latest_time) {
+    ++begin;
+  }
+  if (end - begin > max_samples_) {
+    begin = end - max_samples_;
+  }
+  begin_.store(begin, std::memory_order_release);
+}
+}  // namespace tf2
@@ -30,6 +30,7 @@
 
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "tf2/time_cache.h"
 #include "tf2/exceptions.h"
@@ -49,6 +50,9 @@ bool tf2::StaticCache::getData(
 bool tf2::StaticCache::insertData(const tf2::TransformStorage & new_data)
 {
   storage_ = new_data;
+  TransformStorage latest = new_data;
+  latest.stamp_ = TimePoint();
+  latest_.store(latest);
   return true;
 }
 
@@ -77,3 +81,18 @@ tf2::TimePoint tf2::StaticCache::getOldestTimestamp()
 {
   return tf2::TimePoint();
 }
+
+bool tf2::StaticCache::getLatestSnapshot(tf2::TransformStorage & data_out) const
+{
+  return latest_.load(data_out);
+}
+
+size_t tf2::StaticCache::getMemoryUsage() const
+{
+  return sizeof(storage_) + sizeof(latest_);
+}
+
+void tf2::StaticCache::copySamples(std::vector<tf2::TransformStorage> & data_out) const
+{
+  data_out.push_back(storage_);
+}
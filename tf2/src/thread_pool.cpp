@@ -0,0 +1,166 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "tf2/thread_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace tf2
+{
+
+ThreadPool::ThreadPool(size_t num_threads)
+{
+  workers_.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::work, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  task_available_.notify_all();
+  for (std::thread & worker : workers_) {
+    worker.join();
+  }
+}
+
+size_t ThreadPool::getNumThreads() const
+{
+  return workers_.size();
+}
+
+size_t ThreadPool::defaultNumThreads()
+{
+  const unsigned int hardware_threads = std::thread::hardware_concurrency();
+  return hardware_threads > 1 ? hardware_threads - 1 : 0;
+}
+
+void ThreadPool::parallelFor(
+  size_t count, size_t min_range, const std::function<void(size_t, size_t)> & fn)
+{
+  min_range = std::max<size_t>(min_range, 1);
+  const size_t num_ranges = std::min(workers_.size() + 1, (count + min_range - 1) / min_range);
+  if (num_ranges <= 1) {
+    if (count > 0) {
+      fn(0, count);
+    }
+    return;
+  }
+
+  // Equal ranges, the first count % num_ranges of them one longer
+  const size_t base = count / num_ranges;
+  const size_t extra = count % num_ranges;
+  auto range_begin = [base, extra](size_t i) {return i * base + std::min(i, extra);};
+
+  size_t remaining = num_ranges - 1;
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 1; i < num_ranges; ++i) {
+      tasks_.emplace_back(
+        [this, &fn, &remaining, &error, begin = range_begin(i), end = range_begin(i + 1)]() {
+          std::exception_ptr task_error;
+          try {
+            fn(begin, end);
+          } catch (...) {
+            task_error = std::current_exception();
+          }
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (task_error && !error) {
+            error = task_error;
+          }
+          if (--remaining == 0) {
+            task_done_.notify_all();
+          }
+        });
+    }
+  }
+  task_available_.notify_all();
+
+  std::exception_ptr own_error;
+  try {
+    fn(0, range_begin(1));
+  } catch (...) {
+    own_error = std::current_exception();
+  }
+
+  // Help with queued tasks rather than just waiting, so a parallelFor() running on a worker
+  // can't wait for ranges that no free worker is left to pick up
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (remaining > 0) {
+    if (!runOne(lock)) {
+      task_done_.wait(lock);
+    }
+  }
+  if (own_error) {
+    std::rethrow_exception(own_error);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+bool ThreadPool::runOne(std::unique_lock<std::mutex> & lock)
+{
+  if (tasks_.empty()) {
+    return false;
+  }
+  std::function<void()> task = std::move(tasks_.front());
+  tasks_.pop_front();
+  lock.unlock();
+  task();
+  lock.lock();
+  return true;
+}
+
+void ThreadPool::work()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    if (runOne(lock)) {
+      continue;
+    }
+    if (stopping_) {
+      return;
+    }
+    task_available_.wait(lock);
+  }
+}
+
+}  // namespace tf2
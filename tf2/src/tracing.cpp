@@ -0,0 +1,94 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// Only built with -DTF2_TRACING=ON, see tf2/tracing.h
+
+#define TRACEPOINT_CREATE_PROBES
+#define TRACEPOINT_DEFINE
+#include "tracing_provider.h"
+
+#include <cstdint>
+
+#include "tf2/tracing.h"
+
+namespace tf2
+{
+namespace tracing
+{
+
+void set_transform(
+  const void * buffer, const char * frame_id, const char * child_frame_id, int64_t stamp,
+  bool is_static)
+{
+  tracepoint(tf2, set_transform, buffer, frame_id, child_frame_id, stamp, is_static);
+}
+
+void transformable_request_ready(
+  const void * buffer, uint64_t request_handle, const char * target_frame,
+  const char * source_frame, int64_t stamp, bool available)
+{
+  tracepoint(
+    tf2, transformable_request_ready, buffer, request_handle, target_frame, source_frame, stamp,
+    available);
+}
+
+void listener_callback(const void * listener, uint64_t transform_count, bool is_static)
+{
+  tracepoint(tf2, listener_callback, listener, transform_count, is_static);
+}
+
+void wait_for_transform(
+  const void * buffer, uint64_t request_handle, const char * target_frame,
+  const char * source_frame, int64_t stamp)
+{
+  tracepoint(tf2, wait_for_transform, buffer, request_handle, target_frame, source_frame, stamp);
+}
+
+void wait_for_transform_timeout(const void * buffer, uint64_t request_handle)
+{
+  tracepoint(tf2, wait_for_transform_timeout, buffer, request_handle);
+}
+
+void message_filter_add(const void * filter, const char * frame_id, int64_t stamp)
+{
+  tracepoint(tf2, message_filter_add, filter, frame_id, stamp);
+}
+
+void message_filter_dispatch(const void * filter, const char * frame_id, int64_t stamp)
+{
+  tracepoint(tf2, message_filter_dispatch, filter, frame_id, stamp);
+}
+
+void message_filter_drop(const void * filter, const char * frame_id, int64_t stamp, int reason)
+{
+  tracepoint(tf2, message_filter_drop, filter, frame_id, stamp, reason);
+}
+
+}  // namespace tracing
+}  // namespace tf2
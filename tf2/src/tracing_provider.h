@@ -0,0 +1,174 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// LTTng tracepoint provider of the tf2 events, only built with -DTF2_TRACING=ON.  This header
+// is read several times by lttng-ust, so it has no regular include guard.
+
+#undef TRACEPOINT_PROVIDER
+#define TRACEPOINT_PROVIDER tf2
+
+#undef TRACEPOINT_INCLUDE
+#define TRACEPOINT_INCLUDE "tracing_provider.h"
+
+#if !defined(TF2__TRACING_PROVIDER_H_) || defined(TRACEPOINT_HEADER_MULTI_READ)
+#define TF2__TRACING_PROVIDER_H_
+
+#include <lttng/tracepoint.h>
+
+#include <stdint.h>
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  set_transform,
+  TP_ARGS(
+    const void *, buffer_arg,
+    const char *, frame_id_arg,
+    const char *, child_frame_id_arg,
+    int64_t, stamp_arg,
+    int, is_static_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, buffer, buffer_arg)
+    ctf_string(frame_id, frame_id_arg)
+    ctf_string(child_frame_id, child_frame_id_arg)
+    ctf_integer(int64_t, stamp, stamp_arg)
+    ctf_integer(int, is_static, is_static_arg)
+  )
+)
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  transformable_request_ready,
+  TP_ARGS(
+    const void *, buffer_arg,
+    uint64_t, request_handle_arg,
+    const char *, target_frame_arg,
+    const char *, source_frame_arg,
+    int64_t, stamp_arg,
+    int, available_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, buffer, buffer_arg)
+    ctf_integer(uint64_t, request_handle, request_handle_arg)
+    ctf_string(target_frame, target_frame_arg)
+    ctf_string(source_frame, source_frame_arg)
+    ctf_integer(int64_t, stamp, stamp_arg)
+    ctf_integer(int, available, available_arg)
+  )
+)
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  listener_callback,
+  TP_ARGS(
+    const void *, listener_arg,
+    uint64_t, transform_count_arg,
+    int, is_static_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, listener, listener_arg)
+    ctf_integer(uint64_t, transform_count, transform_count_arg)
+    ctf_integer(int, is_static, is_static_arg)
+  )
+)
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  wait_for_transform,
+  TP_ARGS(
+    const void *, buffer_arg,
+    uint64_t, request_handle_arg,
+    const char *, target_frame_arg,
+    const char *, source_frame_arg,
+    int64_t, stamp_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, buffer, buffer_arg)
+    ctf_integer(uint64_t, request_handle, request_handle_arg)
+    ctf_string(target_frame, target_frame_arg)
+    ctf_string(source_frame, source_frame_arg)
+    ctf_integer(int64_t, stamp, stamp_arg)
+  )
+)
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  wait_for_transform_timeout,
+  TP_ARGS(
+    const void *, buffer_arg,
+    uint64_t, request_handle_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, buffer, buffer_arg)
+    ctf_integer(uint64_t, request_handle, request_handle_arg)
+  )
+)
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  message_filter_add,
+  TP_ARGS(
+    const void *, filter_arg,
+    const char *, frame_id_arg,
+    int64_t, stamp_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, filter, filter_arg)
+    ctf_string(frame_id, frame_id_arg)
+    ctf_integer(int64_t, stamp, stamp_arg)
+  )
+)
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  message_filter_dispatch,
+  TP_ARGS(
+    const void *, filter_arg,
+    const char *, frame_id_arg,
+    int64_t, stamp_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, filter, filter_arg)
+    ctf_string(frame_id, frame_id_arg)
+    ctf_integer(int64_t, stamp, stamp_arg)
+  )
+)
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  message_filter_drop,
+  TP_ARGS(
+    const void *, filter_arg,
+    const char *, frame_id_arg,
+    int64_t, stamp_arg,
+    int, reason_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, filter, filter_arg)
+    ctf_string(frame_id, frame_id_arg)
+    ctf_integer(int64_t, stamp, stamp_arg)
+    ctf_integer(int, reason, reason_arg)
+  )
+)
+
+#endif  // TF2__TRACING_PROVIDER_H_
+
+#include <lttng/tracepoint-event.h>
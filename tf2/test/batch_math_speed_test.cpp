@@ -0,0 +1,112 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// Compares the tf2::batch kernels with the same work done one tf2::Transform at a time.
+//
+// Usage: batch_math_speed_test [count] [iterations]
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "console_bridge/console.h"
+#include "tf2/batch_math.h"
+#include "tf2/LinearMath/Quaternion.h"
+#include "tf2/LinearMath/Transform.h"
+#include "tf2/LinearMath/Vector3.h"
+
+namespace
+{
+
+template<class F>
+void report(const char * name, size_t count, int iterations, F && f)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    f();
+  }
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  CONSOLE_BRIDGE_logInform(
+    "%-22s %8.2f M elements/s", name, (static_cast<double>(count) * iterations) / secs / 1e6);
+}
+
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  size_t count = 4096;
+  int iterations = 2000;
+  if (argc > 1) {
+    count = std::stoul(argv[1]);
+  }
+  if (argc > 2) {
+    iterations = std::stoi(argv[2]);
+  }
+  CONSOLE_BRIDGE_logInform(
+    "%zu elements, %d iterations, %s kernels", count, iterations, tf2::batch::getKernelName());
+
+  const tf2::Transform t(tf2::Quaternion(0.1, 0.2, 0.3, 0.9).normalized(), tf2::Vector3(1, 2, 3));
+  std::vector<tf2::Vector3> aos_points(count, tf2::Vector3(1, 2, 3));
+  std::vector<tf2::Transform> aos_a(count, t), aos_b(count, t), aos_out(count);
+  std::vector<std::vector<double>> soa(14, std::vector<double>(count, 0.5));
+  tf2::batch::Vector3Array points{soa[0].data(), soa[1].data(), soa[2].data()};
+  tf2::batch::TransformArray a{{soa[3].data(), soa[4].data(), soa[5].data(), soa[6].data()},
+    {soa[7].data(), soa[8].data(), soa[9].data()}};
+  tf2::batch::TransformArray b{{soa[10].data(), soa[11].data(), soa[12].data(), soa[13].data()},
+    {soa[0].data(), soa[1].data(), soa[2].data()}};
+  tf2::batch::normalizeQuaternions(a.rotation, count);
+  tf2::batch::normalizeQuaternions(b.rotation, count);
+
+  report(
+    "tf2::Transform * point", count, iterations, [&]() {
+      for (auto & p : aos_points) {
+        p = t * p;
+      }
+    });
+  report(
+    "batch transformPoints", count, iterations, [&]() {
+      tf2::batch::transformPoints(t, points, points, count);
+    });
+  report(
+    "tf2::Transform * tf", count, iterations, [&]() {
+      for (size_t i = 0; i < count; ++i) {
+        aos_out[i] = aos_a[i] * aos_b[i];
+      }
+    });
+  report(
+    "batch composeTransforms", count, iterations, [&]() {
+      tf2::batch::composeTransforms(a, b, a, count);
+    });
+  report(
+    "batch normalize", count, iterations, [&]() {
+      tf2::batch::normalizeQuaternions(a.rotation, count);
+    });
+
+  return 0;
+}
@@ -0,0 +1,409 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// Benchmarks of tf2::BufferCore, run with --benchmark_format=json or --benchmark_out=<file>
+// for machine readable results.
+//
+// The trees are two spines of depth frames hanging off a common root, so lookups from the tip
+// of one spine to the tip of the other walk 2 * depth links.  Each spine frame also has
+// fan_out - 1 leaf children, and static_percent of the links are static.  Dynamic frames
+// keep history samples 10 ms apart.
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "tf2/buffer_core.h"
+#include "geometry_msgs/msg/transform_stamped.hpp"
+
+namespace
+{
+
+constexpr int64_t SAMPLE_INTERVAL_NS = 10000000;
+
+struct Tree
+{
+  int64_t depth;
+  int64_t fan_out;
+  int64_t static_percent;
+  int64_t history;
+};
+
+Tree treeFromArgs(const benchmark::State & state)
+{
+  return Tree{state.range(0), state.range(1), state.range(2), state.range(3)};
+}
+
+geometry_msgs::msg::TransformStamped makeTransform(
+  const std::string & parent, const std::string & child, int64_t stamp_ns)
+{
+  geometry_msgs::msg::TransformStamped t;
+  t.header.stamp.sec = static_cast<int32_t>(stamp_ns / 1000000000);
+  t.header.stamp.nanosec = static_cast<uint32_t>(stamp_ns % 1000000000);
+  t.header.frame_id = parent;
+  t.child_frame_id = child;
+  t.transform.translation.x = 0.1;
+  t.transform.translation.y = 0.01 * static_cast<double>(stamp_ns % 1000);
+  t.transform.rotation.z = 0.0499792;
+  t.transform.rotation.w = 0.9987503;
+  return t;
+}
+
+std::string spineFrame(int spine, int64_t level)
+{
+  return "spine" + std::to_string(spine) + "_" + std::to_string(level);
+}
+
+/// Whether the link above level is static, spreading static_percent evenly over the spine
+bool isStatic(const Tree & tree, int64_t level)
+{
+  return (level + 1) * tree.static_percent / 100 != level * tree.static_percent / 100;
+}
+
+/// The links of the tree, parents before children
+std::vector<std::pair<std::string, std::string>> links(
+  const Tree & tree, std::vector<bool> & is_static)
+{
+  std::vector<std::pair<std::string, std::string>> result;
+  is_static.clear();
+  for (int spine = 0; spine < 2; ++spine) {
+    for (int64_t level = 0; level < tree.depth; ++level) {
+      const std::string parent = level == 0 ? "root" : spineFrame(spine, level - 1);
+      const std::string child = spineFrame(spine, level);
+      result.emplace_back(parent, child);
+      is_static.push_back(isStatic(tree, level));
+      for (int64_t leaf = 1; leaf < tree.fan_out; ++leaf) {
+        result.emplace_back(child, child + "_leaf" + std::to_string(leaf));
+        is_static.push_back(false);
+      }
+    }
+  }
+  return result;
+}
+
+/// Fill buffer with tree, returning the stamp of the newest samples
+int64_t fill(tf2::BufferCore & buffer, const Tree & tree)
+{
+  std::vector<bool> is_static;
+  auto tree_links = links(tree, is_static);
+  int64_t stamp = SAMPLE_INTERVAL_NS;
+  for (int64_t sample = 0; sample < tree.history; ++sample) {
+    stamp = (sample + 1) * SAMPLE_INTERVAL_NS;
+    for (size_t i = 0; i < tree_links.size(); ++i) {
+      if (is_static[i] && sample > 0) {
+        continue;
+      }
+      buffer.setTransform(
+        makeTransform(tree_links[i].first, tree_links[i].second, stamp), "benchmark",
+        is_static[i]);
+    }
+  }
+  return stamp;
+}
+
+std::unique_ptr<tf2::BufferCore> makeBuffer(const Tree & tree, int64_t & newest_stamp)
+{
+  // Long enough to hold the whole history
+  auto buffer = std::make_unique<tf2::BufferCore>(
+    tf2::Duration(std::chrono::nanoseconds((tree.history + 1) * SAMPLE_INTERVAL_NS)));
+  newest_stamp = fill(*buffer, tree);
+  return buffer;
+}
+
+/// A time in the middle of the history that falls between two samples
+tf2::TimePoint pastTime(int64_t newest_stamp)
+{
+  return tf2::TimePoint(std::chrono::nanoseconds(newest_stamp / 2 + SAMPLE_INTERVAL_NS / 3));
+}
+
+void treeArgs(benchmark::internal::Benchmark * b)
+{
+  b->ArgNames({"depth", "fan_out", "static_percent", "history"});
+  for (int64_t depth : {1, 4, 16}) {
+    for (int64_t static_percent : {0, 50, 100}) {
+      b->Args({depth, 1, static_percent, 100});
+    }
+  }
+  b->Args({4, 16, 50, 100});
+  b->Args({4, 1, 50, 1});
+  b->Args({4, 1, 50, 1000});
+  b->Args({4, 1, 50, 10000});
+}
+
+void BM_LookupLatest(benchmark::State & state)
+{
+  const Tree tree = treeFromArgs(state);
+  int64_t newest_stamp;
+  auto buffer = makeBuffer(tree, newest_stamp);
+  const std::string target = spineFrame(0, tree.depth - 1);
+  const std::string source = spineFrame(1, tree.depth - 1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer->lookupTransform(target, source, tf2::TimePointZero));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LookupLatest)->Apply(treeArgs);
+
+void BM_LookupPast(benchmark::State & state)
+{
+  const Tree tree = treeFromArgs(state);
+  int64_t newest_stamp;
+  auto buffer = makeBuffer(tree, newest_stamp);
+  const std::string target = spineFrame(0, tree.depth - 1);
+  const std::string source = spineFrame(1, tree.depth - 1);
+  const tf2::TimePoint time = tree.history > 1 ?
+    pastTime(newest_stamp) : tf2::TimePoint(std::chrono::nanoseconds(newest_stamp));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer->lookupTransform(target, source, time));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LookupPast)->Apply(treeArgs);
+
+/// The same as BM_LookupPast answered from the lookup cache
+void BM_LookupPastCached(benchmark::State & state)
+{
+  const Tree tree = treeFromArgs(state);
+  int64_t newest_stamp;
+  auto buffer = makeBuffer(tree, newest_stamp);
+  buffer->setLookupCacheCapacity(64);
+  const std::string target = spineFrame(0, tree.depth - 1);
+  const std::string source = spineFrame(1, tree.depth - 1);
+  const tf2::TimePoint time = tree.history > 1 ?
+    pastTime(newest_stamp) : tf2::TimePoint(std::chrono::nanoseconds(newest_stamp));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer->lookupTransform(target, source, time));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LookupPastCached)->Apply(treeArgs);
+
+void BM_CanTransform(benchmark::State & state)
+{
+  const Tree tree = treeFromArgs(state);
+  int64_t newest_stamp;
+  auto buffer = makeBuffer(tree, newest_stamp);
+  const std::string target = spineFrame(0, tree.depth - 1);
+  const std::string source = spineFrame(1, tree.depth - 1);
+  const tf2::TimePoint time = tree.history > 1 ?
+    pastTime(newest_stamp) : tf2::TimePoint(std::chrono::nanoseconds(newest_stamp));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer->canTransform(target, source, time));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CanTransform)->Apply(treeArgs);
+
+/// Lookups from the tip of one spine in the past to the tip of the other now, fixed in root
+void BM_LookupFixedFrame(benchmark::State & state)
+{
+  const Tree tree = treeFromArgs(state);
+  int64_t newest_stamp;
+  auto buffer = makeBuffer(tree, newest_stamp);
+  const std::string target = spineFrame(0, tree.depth - 1);
+  const std::string source = spineFrame(1, tree.depth - 1);
+  const tf2::TimePoint time = tree.history > 1 ?
+    pastTime(newest_stamp) : tf2::TimePoint(std::chrono::nanoseconds(newest_stamp));
+  tf2::Transform transform;
+  tf2::TimePoint time_out;
+  for (auto _ : state) {
+    buffer->lookupTransform(target, time, source, tf2::TimePointZero, "root", transform, time_out);
+    benchmark::DoNotOptimize(transform);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LookupFixedFrame)->Apply(treeArgs);
+
+/// The same as BM_LookupFixedFrame with two separate lookups, which is what it used to do
+void BM_LookupFixedFrameSeparately(benchmark::State & state)
+{
+  const Tree tree = treeFromArgs(state);
+  int64_t newest_stamp;
+  auto buffer = makeBuffer(tree, newest_stamp);
+  const std::string target = spineFrame(0, tree.depth - 1);
+  const std::string source = spineFrame(1, tree.depth - 1);
+  const tf2::TimePoint time = tree.history > 1 ?
+    pastTime(newest_stamp) : tf2::TimePoint(std::chrono::nanoseconds(newest_stamp));
+  tf2::Transform fixed_from_source;
+  tf2::Transform target_from_fixed;
+  tf2::TimePoint time_out;
+  for (auto _ : state) {
+    buffer->lookupTransform("root", source, tf2::TimePointZero, fixed_from_source, time_out);
+    buffer->lookupTransform(target, "root", time, target_from_fixed, time_out);
+    benchmark::DoNotOptimize(target_from_fixed * fixed_from_source);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LookupFixedFrameSeparately)->Apply(treeArgs);
+
+/// Every frame of the tree relative to the root in the past
+void BM_LookupSubtree(benchmark::State & state)
+{
+  const Tree tree = treeFromArgs(state);
+  int64_t newest_stamp;
+  auto buffer = makeBuffer(tree, newest_stamp);
+  const tf2::TimePoint time = tree.history > 1 ?
+    pastTime(newest_stamp) : tf2::TimePoint(std::chrono::nanoseconds(newest_stamp));
+  std::vector<tf2::SubtreeTransform> subtree;
+  tf2::TimePoint time_out;
+  for (auto _ : state) {
+    buffer->lookupSubtree("root", time, subtree, time_out);
+    benchmark::DoNotOptimize(subtree.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LookupSubtree)->Apply(treeArgs);
+
+/// The same as BM_LookupSubtree with one lookup per frame
+void BM_LookupSubtreeSeparately(benchmark::State & state)
+{
+  const Tree tree = treeFromArgs(state);
+  int64_t newest_stamp;
+  auto buffer = makeBuffer(tree, newest_stamp);
+  const tf2::TimePoint time = tree.history > 1 ?
+    pastTime(newest_stamp) : tf2::TimePoint(std::chrono::nanoseconds(newest_stamp));
+  std::vector<bool> is_static;
+  auto tree_links = links(tree, is_static);
+  tf2::Transform transform;
+  tf2::TimePoint time_out;
+  for (auto _ : state) {
+    for (const auto & link : tree_links) {
+      buffer->lookupTransform("root", link.second, time, transform, time_out);
+      benchmark::DoNotOptimize(transform);
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LookupSubtreeSeparately)->Apply(treeArgs);
+
+/// Inserting into a frame whose history is already full, so every insert also prunes
+void BM_SetTransform(benchmark::State & state)
+{
+  const Tree tree{1, 1, 0, state.range(0)};
+  int64_t stamp;
+  auto buffer = makeBuffer(tree, stamp);
+  const std::string parent = "root";
+  const std::string child = spineFrame(0, 0);
+  for (auto _ : state) {
+    stamp += SAMPLE_INTERVAL_NS;
+    buffer->setTransform(makeTransform(parent, child, stamp), "benchmark");
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SetTransform)->ArgName("history")->Arg(1)->Arg(100)->Arg(10000);
+
+/// Lookups from several threads while another thread inserts at insert_rate Hz, 0 for none
+void BM_LookupContended(benchmark::State & state)
+{
+  static std::unique_ptr<tf2::BufferCore> buffer;
+  static std::atomic<bool> done;
+  static std::thread writer;
+  static int64_t newest_stamp;
+  const Tree tree{4, 1, 50, 100};
+
+  if (state.thread_index() == 0) {
+    buffer = makeBuffer(tree, newest_stamp);
+    done = false;
+    const int64_t rate = state.range(0);
+    if (rate > 0) {
+      writer = std::thread(
+        [tree, rate]() {
+          const auto period = std::chrono::nanoseconds(1000000000 / rate);
+          auto next = std::chrono::steady_clock::now();
+          int64_t stamp = newest_stamp;
+          while (!done) {
+            stamp += SAMPLE_INTERVAL_NS;
+            for (int spine = 0; spine < 2; ++spine) {
+              for (int64_t level = 0; level < tree.depth; ++level) {
+                if (!isStatic(tree, level)) {
+                  buffer->setTransform(
+                    makeTransform(
+                      level == 0 ? "root" : spineFrame(spine, level - 1),
+                      spineFrame(spine, level), stamp), "benchmark");
+                }
+              }
+            }
+            next += period;
+            std::this_thread::sleep_until(next);
+          }
+        });
+    }
+  }
+
+  const std::string target = spineFrame(0, tree.depth - 1);
+  const std::string source = spineFrame(1, tree.depth - 1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer->lookupTransform(target, source, tf2::TimePointZero));
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  if (state.thread_index() == 0) {
+    done = true;
+    if (writer.joinable()) {
+      writer.join();
+    }
+  }
+}
+BENCHMARK(BM_LookupContended)->ArgName("insert_rate")->Arg(0)->Arg(1000)
+->ThreadRange(1, 8)->UseRealTime();
+
+/// setTransform with pending transformable requests that the insert does not satisfy
+void BM_PendingRequests(benchmark::State & state)
+{
+  tf2::BufferCore buffer;
+  auto cb = [](
+    tf2::TransformableRequestHandle, const std::string &, const std::string &,
+    tf2::TimePoint, tf2::TransformableResult) {};
+  for (int i = 0; i < 30; ++i) {
+    buffer.setTransform(
+      makeTransform("odom", "sensor_" + std::to_string(i), 1000000000), "benchmark");
+  }
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    buffer.addTransformableRequest(
+      cb, "odom", "sensor_" + std::to_string(i % 30),
+      tf2::TimePoint(std::chrono::seconds(2) + std::chrono::microseconds(i)));
+  }
+
+  int64_t stamp = 1000000000;
+  for (auto _ : state) {
+    stamp += 1000;
+    buffer.setTransform(makeTransform("base_link", "arm", stamp), "benchmark");
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PendingRequests)->ArgName("pending")->Arg(0)->Arg(100)->Arg(10000);
+
+}  // namespace
@@ -28,9 +28,11 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <cmath>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -322,6 +324,674 @@ TEST(TimeCache, DuplicateEntries)
   EXPECT_TRUE(!std::isnan(stor.rotation_.w()));
 }
 
+TEST(TimeCache, LatestSnapshot)
+{
+  tf2::TimeCache cache;
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  EXPECT_FALSE(cache.getLatestSnapshot(stor));
+
+  stor.translation_.setValue(1.0, 2.0, 3.0);
+  stor.frame_id_ = 3;
+  stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(20));
+  EXPECT_TRUE(cache.insertData(stor));
+
+  // Inserting into the past does not change the latest sample
+  stor.translation_.setValue(4.0, 5.0, 6.0);
+  stor.frame_id_ = 4;
+  stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(10));
+  EXPECT_TRUE(cache.insertData(stor));
+
+  tf2::TransformStorage latest;
+  ASSERT_TRUE(cache.getLatestSnapshot(latest));
+  EXPECT_EQ(latest.stamp_, tf2::TimePoint(std::chrono::nanoseconds(20)));
+  EXPECT_EQ(latest.frame_id_, 3u);
+  EXPECT_EQ(latest.translation_, tf2::Vector3(1.0, 2.0, 3.0));
+  EXPECT_EQ(latest.rotation_, stor.rotation_);
+
+  cache.clearList();
+  EXPECT_FALSE(cache.getLatestSnapshot(latest));
+}
+
+TEST(TimeCache, GetDataBatch)
+{
+  seed_rand();
+
+  tf2::TimeCache cache;
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  std::vector<tf2::TimePoint> times;
+  std::vector<tf2::TransformStorage> batch;
+  EXPECT_FALSE(cache.getDataBatch({tf2::TimePoint(std::chrono::nanoseconds(10))}, batch));
+
+  for (int i = 1; i <= 10; i++) {
+    // The parent changes halfway, interpolating across it must return the older sample
+    stor.frame_id_ = i <= 5 ? 1 : 2;
+    stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(i * 100));
+    stor.translation_.setValue(get_rand(), get_rand(), get_rand());
+    stor.rotation_.setRPY(get_rand(), get_rand(), get_rand());
+    EXPECT_TRUE(cache.insertData(stor));
+  }
+
+  for (int64_t ns = 100; ns <= 1000; ns += 25) {
+    times.push_back(tf2::TimePoint(std::chrono::nanoseconds(ns)));
+  }
+  times.push_back(times.back());
+  ASSERT_TRUE(cache.getDataBatch(times, batch));
+  ASSERT_EQ(times.size(), batch.size());
+  for (size_t i = 0; i < times.size(); i++) {
+    tf2::TransformStorage expected;
+    ASSERT_TRUE(cache.getData(times[i], expected));
+    EXPECT_EQ(expected.frame_id_, batch[i].frame_id_);
+    EXPECT_EQ(expected.stamp_, batch[i].stamp_);
+    EXPECT_EQ(expected.translation_.x(), batch[i].translation_.x());
+    EXPECT_EQ(expected.translation_.y(), batch[i].translation_.y());
+    EXPECT_EQ(expected.translation_.z(), batch[i].translation_.z());
+    EXPECT_EQ(expected.rotation_, batch[i].rotation_);
+  }
+
+  std::string error_str;
+  times.push_back(tf2::TimePoint(std::chrono::nanoseconds(1001)));
+  EXPECT_FALSE(cache.getDataBatch(times, batch, &error_str));
+  EXPECT_FALSE(error_str.empty());
+  EXPECT_FALSE(cache.getDataBatch({tf2::TimePoint(std::chrono::nanoseconds(99))}, batch));
+}
+
+TEST(TimeCache, OutOfOrderInsertAfterWrapAround)
+{
+  tf2::TimeCache cache(tf2::Duration(std::chrono::nanoseconds(50)));
+
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+
+  // Push enough in order data through the cache that old samples get pruned
+  // and the storage wraps around.
+  for (uint64_t i = 1; i <= 200; i += 2) {
+    stor.frame_id_ = tf2::CompactFrameID(i);
+    stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(i));
+    EXPECT_TRUE(cache.insertData(stor));
+  }
+  EXPECT_EQ(cache.getOldestTimestamp(), tf2::TimePoint(std::chrono::nanoseconds(149)));
+  EXPECT_EQ(cache.getLatestTimestamp(), tf2::TimePoint(std::chrono::nanoseconds(199)));
+  EXPECT_EQ(cache.getListLength(), 26u);
+
+  // Fill in the gaps in reverse order
+  for (uint64_t i = 198; i >= 150; i -= 2) {
+    stor.frame_id_ = tf2::CompactFrameID(i);
+    stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(i));
+    EXPECT_TRUE(cache.insertData(stor));
+  }
+  EXPECT_EQ(cache.getListLength(), 51u);
+
+  for (uint64_t i = 149; i <= 199; i++) {
+    cache.getData(tf2::TimePoint(std::chrono::nanoseconds(i)), stor);
+    EXPECT_EQ(stor.frame_id_, i);
+    EXPECT_EQ(stor.stamp_, tf2::TimePoint(std::chrono::nanoseconds(i)));
+  }
+
+  // Too old for the cache
+  stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(100));
+  EXPECT_FALSE(cache.insertData(stor));
+}
+
+// Late samples close to the oldest end move the older samples, the others the newer ones
+TEST(TimeCache, LateInsertsOnBothSides)
+{
+  tf2::TimeCache cache(tf2::Duration(std::chrono::nanoseconds(1000)));
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  auto insert = [&](uint64_t i) {
+      stor.frame_id_ = tf2::CompactFrameID(i);
+      stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(i));
+      EXPECT_TRUE(cache.insertData(stor));
+    };
+
+  // Wrap the ring buffer around first
+  for (uint64_t i = 0; i <= 2000; i += 4) {
+    insert(i);
+  }
+  for (uint64_t i = 0; i < 250; ++i) {
+    insert(1002 + (i * 37) % 250 * 4);
+  }
+  EXPECT_EQ(cache.getListLength(), 501u);
+
+  std::vector<tf2::TransformStorage> samples;
+  cache.copySamples(samples);
+  ASSERT_EQ(samples.size(), 501u);
+  for (size_t i = 1; i < samples.size(); ++i) {
+    EXPECT_LT(samples[i - 1].stamp_, samples[i].stamp_);
+  }
+  for (uint64_t i = 1002; i < 2000; i += 2) {
+    ASSERT_TRUE(cache.getData(tf2::TimePoint(std::chrono::nanoseconds(i)), stor));
+    EXPECT_EQ(stor.frame_id_, i);
+  }
+  ASSERT_TRUE(cache.getLatestSnapshot(stor));
+  EXPECT_EQ(stor.stamp_, tf2::TimePoint(std::chrono::nanoseconds(2000)));
+}
+
+TEST(TimeCache, RetentionPolicy)
+{
+  tf2::TimeCache cache(tf2::Duration(std::chrono::seconds(10)));
+
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  for (uint64_t i = 1; i <= 100; i++) {
+    stor.frame_id_ = tf2::CompactFrameID(i);
+    stor.stamp_ = tf2::TimePoint(std::chrono::milliseconds(i));
+    EXPECT_TRUE(cache.insertData(stor));
+  }
+  EXPECT_EQ(cache.getListLength(), 100u);
+
+  // Capping the number of samples drops the oldest ones right away
+  tf2::RetentionPolicy policy;
+  policy.max_samples = 40;
+  cache.setRetentionPolicy(policy);
+  EXPECT_EQ(cache.getListLength(), 40u);
+  EXPECT_EQ(cache.getOldestTimestamp(), tf2::TimePoint(std::chrono::milliseconds(61)));
+
+  // A shorter max age replaces the cache time
+  policy.max_age = std::chrono::milliseconds(9);
+  cache.setRetentionPolicy(policy);
+  EXPECT_EQ(cache.getListLength(), 10u);
+  EXPECT_EQ(cache.getOldestTimestamp(), tf2::TimePoint(std::chrono::milliseconds(91)));
+  EXPECT_EQ(cache.getLatestTimestamp(), tf2::TimePoint(std::chrono::milliseconds(100)));
+
+  stor.stamp_ = tf2::TimePoint(std::chrono::milliseconds(101));
+  EXPECT_TRUE(cache.insertData(stor));
+  EXPECT_EQ(cache.getOldestTimestamp(), tf2::TimePoint(std::chrono::milliseconds(92)));
+
+  // The newest sample always survives
+  EXPECT_EQ(cache.dropOldest(100), 9u);
+  EXPECT_EQ(cache.getListLength(), 1u);
+  EXPECT_EQ(cache.getLatestTimestamp(), tf2::TimePoint(std::chrono::milliseconds(101)));
+  EXPECT_EQ(cache.dropOldest(1), 0u);
+  EXPECT_GE(cache.getMemoryUsage(), sizeof(tf2::TransformStorage));
+}
+
+TEST(TimeCache, NlerpInterpolation)
+{
+  const double max_angle = 0.1;
+  tf2::RetentionPolicy policy;
+  policy.nlerp_max_angle = max_angle;
+  tf2::TimeCache nlerp_cache, slerp_cache;
+  nlerp_cache.setRetentionPolicy(policy);
+
+  // A pair of samples just inside the nlerp threshold followed by one well beyond it
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  const double angles[] = {0.0, 0.9 * max_angle, 1.0};
+  for (int i = 0; i < 3; i++) {
+    stor.stamp_ = tf2::TimePoint(std::chrono::milliseconds(i + 1));
+    stor.rotation_.setRotation(tf2::Vector3(0.3, -0.5, 0.8).normalized(), angles[i]);
+    nlerp_cache.insertData(stor);
+    slerp_cache.insertData(stor);
+  }
+
+  tf2::TransformStorage nlerped, slerped;
+  for (int i = 1; i < 20; i++) {
+    tf2::TimePoint time(std::chrono::microseconds(1000 + i * 100));
+    ASSERT_TRUE(nlerp_cache.getData(time, nlerped));
+    ASSERT_TRUE(slerp_cache.getData(time, slerped));
+    EXPECT_NEAR(nlerped.rotation_.length(), 1.0, 1e-12);
+    double error = nlerped.rotation_.angleShortestPath(slerped.rotation_);
+    if (i < 10) {
+      // Close samples stay within the documented error bound
+      EXPECT_LT(error, 0.005 * std::pow(0.9 * max_angle, 3));
+    } else {
+      // Samples further apart than the threshold are interpolated exactly as before
+      EXPECT_EQ(nlerped.rotation_, slerped.rotation_);
+    }
+  }
+}
+
+// Shared by the tests of all caches supporting RetentionPolicy::max_extrapolation
+void expectBoundedExtrapolation(tf2::TimeCacheInterface & cache)
+{
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  for (int i = 1; i <= 2; i++) {
+    stor.stamp_ = tf2::TimePoint(std::chrono::milliseconds(10 * i));
+    stor.translation_.setX(i);
+    stor.rotation_.setRotation(tf2::Vector3(0, 0, 1), 0.1 * i);
+    EXPECT_TRUE(cache.insertData(stor));
+  }
+
+  tf2::TransformStorage out;
+  tf2::TimePoint ahead(std::chrono::milliseconds(25));
+  EXPECT_FALSE(cache.getData(ahead, out));
+
+  // Continue at the velocity between the two newest samples, up to the limit
+  tf2::RetentionPolicy policy;
+  policy.max_extrapolation = std::chrono::milliseconds(5);
+  cache.setRetentionPolicy(policy);
+  ASSERT_TRUE(cache.getData(ahead, out));
+  EXPECT_NEAR(out.translation_.x(), 2.5, 1e-9);
+  // Loose enough for the quantized rotations of a CompressedCache
+  EXPECT_NEAR(out.rotation_.getAngle(), 0.25, 1e-4);
+  EXPECT_EQ(cache.getParent(ahead, nullptr), stor.frame_id_);
+  std::string error;
+  EXPECT_FALSE(cache.getData(tf2::TimePoint(std::chrono::milliseconds(26)), out, &error));
+  EXPECT_NE(error.find("extrapolation into the future"), std::string::npos);
+
+  // Never across a change of parent
+  stor.stamp_ = tf2::TimePoint(std::chrono::milliseconds(30));
+  stor.frame_id_ = 2;
+  EXPECT_TRUE(cache.insertData(stor));
+  EXPECT_FALSE(cache.getData(tf2::TimePoint(std::chrono::milliseconds(31)), out));
+}
+
+TEST(TimeCache, BoundedExtrapolation)
+{
+  tf2::TimeCache cache;
+  expectBoundedExtrapolation(cache);
+
+  tf2::TimeCache batch_cache;
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  for (int i = 1; i <= 2; i++) {
+    stor.stamp_ = tf2::TimePoint(std::chrono::milliseconds(10 * i));
+    stor.translation_.setX(i);
+    EXPECT_TRUE(batch_cache.insertData(stor));
+  }
+  tf2::RetentionPolicy policy;
+  policy.max_extrapolation = std::chrono::milliseconds(5);
+  batch_cache.setRetentionPolicy(policy);
+  std::vector<tf2::TimePoint> times = {
+    tf2::TimePoint(std::chrono::milliseconds(15)), tf2::TimePoint(std::chrono::milliseconds(24))};
+  std::vector<tf2::TransformStorage> out;
+  ASSERT_TRUE(batch_cache.getDataBatch(times, out));
+  EXPECT_NEAR(out[0].translation_.x(), 1.5, 1e-9);
+  EXPECT_NEAR(out[1].translation_.x(), 2.4, 1e-9);
+  times.push_back(tf2::TimePoint(std::chrono::milliseconds(26)));
+  EXPECT_FALSE(batch_cache.getDataBatch(times, out));
+}
+
+TEST(TimeCache, Decimation)
+{
+  tf2::TimeCache cache(tf2::Duration(std::chrono::seconds(10)));
+
+  // Keep the last 100 ms at full rate and 10 ms between samples before that
+  tf2::RetentionPolicy policy;
+  policy.decimation_age = std::chrono::milliseconds(100);
+  policy.decimation_interval = std::chrono::milliseconds(10);
+  cache.setRetentionPolicy(policy);
+
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  for (uint64_t i = 0; i <= 2000; i++) {
+    stor.frame_id_ = tf2::CompactFrameID(i + 1);
+    stor.stamp_ = tf2::TimePoint(std::chrono::milliseconds(i));
+    EXPECT_TRUE(cache.insertData(stor));
+  }
+  EXPECT_LT(cache.getListLength(), 500u);
+  EXPECT_EQ(cache.getOldestTimestamp(), tf2::TimePoint(std::chrono::milliseconds(0)));
+  EXPECT_EQ(cache.getLatestTimestamp(), tf2::TimePoint(std::chrono::milliseconds(2000)));
+
+  // Recent history is untouched
+  for (uint64_t i = 1900; i <= 2000; i++) {
+    ASSERT_TRUE(cache.getData(tf2::TimePoint(std::chrono::milliseconds(i)), stor));
+    EXPECT_EQ(stor.frame_id_, i + 1);
+  }
+
+  // Older history is thinned out but still interpolates between the kept samples
+  cache.getData(tf2::TimePoint(std::chrono::milliseconds(500)), stor);
+  EXPECT_EQ(stor.stamp_, tf2::TimePoint(std::chrono::milliseconds(500)));
+  size_t kept = 0;
+  for (uint64_t i = 0; i < 1800; i++) {
+    tf2::TimePoint time{std::chrono::milliseconds(i)};
+    ASSERT_TRUE(cache.getData(time, stor));
+    // Exact samples are only found where one was kept
+    if (stor.frame_id_ == i + 1) {
+      ++kept;
+    }
+  }
+  EXPECT_LE(kept, 181u);
+}
+
+// findClosest() starts searching where the previous lookup ended up
+TEST(TimeCache, Lookups_In_Any_Order)
+{
+  tf2::TimeCache cache(std::chrono::seconds(1));
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  auto insert = [&](int64_t ms) {
+      stor.stamp_ = tf2::TimePoint(std::chrono::milliseconds(ms));
+      stor.translation_.setX(static_cast<double>(ms));
+      EXPECT_TRUE(cache.insertData(stor));
+    };
+  auto expect_lookup = [&](double ms) {
+      tf2::TransformStorage out;
+      tf2::TimePoint time(std::chrono::microseconds(static_cast<int64_t>(ms * 1000)));
+      ASSERT_TRUE(cache.getData(time, out));
+      EXPECT_NEAR(ms, out.translation_.x(), 1e-9);
+    };
+  for (int64_t ms = 1; ms <= 1000; ++ms) {
+    insert(ms);
+  }
+
+  for (int64_t ms = 1; ms < 1000; ++ms) {
+    expect_lookup(ms + 0.5);
+  }
+  for (int64_t ms = 999; ms >= 1; ms -= 7) {
+    expect_lookup(ms + 0.25);
+  }
+  for (unsigned int i = 0; i < 1000; ++i) {
+    expect_lookup(1.0 + (i * 7919) % 999 + 0.75);
+  }
+
+  // The history shifts under the cursor as samples are pruned
+  for (int64_t ms = 1001; ms <= 3000; ++ms) {
+    insert(ms);
+    expect_lookup(ms - 500.5);
+    expect_lookup(ms - 999.5);
+  }
+}
+
+TEST(TimeCache, Insert_Sorted)
+{
+  tf2::TimeCache reference(std::chrono::seconds(1));
+  tf2::TimeCache cache(std::chrono::seconds(1));
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  std::vector<tf2::TransformStorage> samples;
+  for (int64_t ms = 0; ms < 2500; ms += 10) {
+    stor.stamp_ = tf2::TimePoint(std::chrono::milliseconds(ms));
+    stor.translation_.setX(static_cast<double>(ms));
+    samples.push_back(stor);
+    EXPECT_TRUE(reference.insertData(stor));
+  }
+
+  // Appended in two batches, the first one longer than the history kept
+  EXPECT_EQ(0u, cache.insertSorted(samples.data(), 150));
+  EXPECT_EQ(0u, cache.insertSorted(samples.data() + 150, samples.size() - 150));
+  EXPECT_EQ(reference.getListLength(), cache.getListLength());
+  EXPECT_EQ(reference.getOldestTimestamp(), cache.getOldestTimestamp());
+  EXPECT_EQ(reference.getLatestTimestamp(), cache.getLatestTimestamp());
+  for (int64_t ms = 1500; ms < 2490; ms += 3) {
+    tf2::TransformStorage out;
+    ASSERT_TRUE(cache.getData(tf2::TimePoint(std::chrono::milliseconds(ms)), out));
+    EXPECT_NEAR(static_cast<double>(ms), out.translation_.x(), 1e-9);
+  }
+
+  // Samples older than the history are rejected like insertData() rejects them, late ones
+  // within it are inserted in order
+  EXPECT_FALSE(reference.insertData(samples[10]));
+  std::vector<tf2::TransformStorage> late = {samples[10], samples[200], samples.back()};
+  late[1].stamp_ += std::chrono::milliseconds(5);
+  EXPECT_EQ(1u, cache.insertSorted(late.data(), late.size()));
+  EXPECT_EQ(reference.getListLength() + 2, cache.getListLength());
+  tf2::TransformStorage out;
+  ASSERT_TRUE(cache.getData(late[1].stamp_, out));
+  EXPECT_EQ(late[1].stamp_, out.stamp_);
+}
+
+TEST(Float32TimeCache, Matches_TimeCache)
+{
+  tf2::TimeCache reference(std::chrono::seconds(100));
+  tf2::Float32TimeCache cache(std::chrono::seconds(100));
+  EXPECT_LE(sizeof(tf2::Float32TransformStorage) * 5, sizeof(tf2::TransformStorage) * 3);
+
+  // The same trajectory as for the CompressedCache, inserted out of order every so often
+  tf2::TransformStorage stor;
+  for (uint64_t i = 0; i < 2000; i++) {
+    uint64_t j = i % 10 == 9 ? i - 1 : (i % 10 == 8 ? i + 1 : i);
+    double t = j * 0.01;
+    stor.stamp_ = tf2::TimePoint(std::chrono::milliseconds(j * 10));
+    stor.frame_id_ = j < 1000 ? 1 : 2;
+    stor.child_frame_id_ = 3;
+    stor.translation_.setValue(100.0 * t, std::sin(t), -3.0);
+    stor.rotation_.setRPY(0.1 * t, std::cos(t), t);
+    EXPECT_TRUE(reference.insertData(stor));
+    EXPECT_TRUE(cache.insertData(stor));
+  }
+  EXPECT_EQ(cache.getListLength(), reference.getListLength());
+  EXPECT_EQ(cache.getOldestTimestamp(), reference.getOldestTimestamp());
+  EXPECT_EQ(cache.getLatestTimestamp(), reference.getLatestTimestamp());
+  EXPECT_EQ(cache.getLatestTimeAndParent(), reference.getLatestTimeAndParent());
+  EXPECT_LE(cache.getMemoryUsage() * 5, reference.getMemoryUsage() * 3);
+
+  for (uint64_t i = 0; i <= 19990; i += 7) {
+    tf2::TimePoint time{std::chrono::milliseconds(i)};
+    tf2::TransformStorage expected;
+    tf2::TransformStorage actual;
+    ASSERT_TRUE(reference.getData(time, expected));
+    ASSERT_TRUE(cache.getData(time, actual));
+    EXPECT_EQ(expected.stamp_, actual.stamp_);
+    EXPECT_EQ(expected.frame_id_, actual.frame_id_);
+    EXPECT_EQ(expected.child_frame_id_, actual.child_frame_id_);
+    EXPECT_LT(expected.translation_.distance(actual.translation_), 2e-5);
+    EXPECT_LT(expected.rotation_.angleShortestPath(actual.rotation_), 1e-6);
+    EXPECT_EQ(reference.getParent(time, nullptr), cache.getParent(time, nullptr));
+  }
+
+  ASSERT_TRUE(cache.getLatestSnapshot(stor));
+  EXPECT_EQ(stor.stamp_, reference.getLatestTimestamp());
+  std::vector<tf2::TransformStorage> samples;
+  cache.copySamples(samples);
+  EXPECT_EQ(samples.size(), 2000u);
+}
+
+TEST(CompressedCache, Matches_TimeCache)
+{
+  tf2::TimeCache reference(std::chrono::seconds(100));
+  tf2::CompressedCache cache(std::chrono::seconds(100));
+
+  // A smooth trajectory at 100 Hz that changes parent half way and travels far from its start
+  tf2::TransformStorage stor;
+  for (uint64_t i = 0; i < 2000; i++) {
+    double t = i * 0.01;
+    stor.stamp_ = tf2::TimePoint(std::chrono::milliseconds(i * 10));
+    stor.frame_id_ = i < 1000 ? 1 : 2;
+    stor.child_frame_id_ = 3;
+    stor.translation_.setValue(100.0 * t, std::sin(t), -3.0);
+    stor.rotation_.setRPY(0.1 * t, std::cos(t), t);
+    EXPECT_TRUE(reference.insertData(stor));
+    EXPECT_TRUE(cache.insertData(stor));
+  }
+  EXPECT_EQ(cache.getListLength(), reference.getListLength());
+  EXPECT_EQ(cache.getOldestTimestamp(), reference.getOldestTimestamp());
+  EXPECT_EQ(cache.getLatestTimestamp(), reference.getLatestTimestamp());
+  EXPECT_EQ(cache.getLatestTimeAndParent(), reference.getLatestTimeAndParent());
+  EXPECT_LT(cache.getMemoryUsage() * 2, reference.getMemoryUsage());
+
+  for (uint64_t i = 0; i <= 19990; i += 7) {
+    tf2::TimePoint time{std::chrono::milliseconds(i)};
+    tf2::TransformStorage expected;
+    tf2::TransformStorage actual;
+    ASSERT_TRUE(reference.getData(time, expected));
+    ASSERT_TRUE(cache.getData(time, actual));
+    EXPECT_EQ(expected.stamp_, actual.stamp_);
+    EXPECT_EQ(expected.frame_id_, actual.frame_id_);
+    EXPECT_EQ(expected.child_frame_id_, actual.child_frame_id_);
+    EXPECT_LT(expected.translation_.distance(actual.translation_), 3e-5);
+    EXPECT_LT(expected.rotation_.angleShortestPath(actual.rotation_), 1e-4);
+    EXPECT_EQ(reference.getParent(time, nullptr), cache.getParent(time, nullptr));
+  }
+
+  std::string error_str;
+  EXPECT_FALSE(cache.getData(tf2::TimePoint(std::chrono::seconds(20)), stor, &error_str));
+  EXPECT_FALSE(error_str.empty());
+
+  // Only appending is supported
+  stor.stamp_ = tf2::TimePoint(std::chrono::seconds(1));
+  EXPECT_FALSE(cache.insertData(stor));
+  EXPECT_EQ(cache.getListLength(), 2000u);
+}
+
+TEST(CompressedCache, BoundedExtrapolation)
+{
+  tf2::CompressedCache cache;
+  expectBoundedExtrapolation(cache);
+}
+
+TEST(CompressedCache, RetentionPolicy)
+{
+  tf2::CompressedCache cache(std::chrono::milliseconds(99));
+
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  for (uint64_t i = 1; i <= 1000; i++) {
+    stor.stamp_ = tf2::TimePoint(std::chrono::milliseconds(i));
+    EXPECT_TRUE(cache.insertData(stor));
+  }
+  EXPECT_EQ(cache.getListLength(), 100u);
+  EXPECT_EQ(cache.getOldestTimestamp(), tf2::TimePoint(std::chrono::milliseconds(901)));
+
+  tf2::RetentionPolicy policy;
+  policy.max_samples = 10;
+  cache.setRetentionPolicy(policy);
+  EXPECT_EQ(cache.getListLength(), 10u);
+  EXPECT_EQ(cache.getOldestTimestamp(), tf2::TimePoint(std::chrono::milliseconds(991)));
+
+  EXPECT_EQ(cache.dropOldest(100), 9u);
+  EXPECT_EQ(cache.getListLength(), 1u);
+  ASSERT_TRUE(cache.getData(tf2::TimePointZero, stor));
+  EXPECT_EQ(stor.stamp_, tf2::TimePoint(std::chrono::milliseconds(1000)));
+  ASSERT_TRUE(cache.getLatestSnapshot(stor));
+  EXPECT_EQ(stor.stamp_, tf2::TimePoint(std::chrono::milliseconds(1000)));
+
+  cache.clearList();
+  EXPECT_EQ(cache.getListLength(), 0u);
+  EXPECT_FALSE(cache.getData(tf2::TimePointZero, stor));
+  EXPECT_FALSE(cache.getLatestSnapshot(stor));
+}
+
+TEST(SingleWriterCache, Matches_TimeCache)
+{
+  tf2::TimeCache reference(std::chrono::seconds(100));
+  tf2::SingleWriterCache cache(std::chrono::seconds(100));
+
+  // Enough samples to grow the ring several times, changing parent half way
+  tf2::TransformStorage stor;
+  for (uint64_t i = 0; i < 2000; i++) {
+    double t = i * 0.01;
+    stor.stamp_ = tf2::TimePoint(std::chrono::milliseconds(i * 10));
+    stor.frame_id_ = i < 1000 ? 1 : 2;
+    stor.child_frame_id_ = 3;
+    stor.translation_.setValue(100.0 * t, std::sin(t), -3.0);
+    stor.rotation_.setRPY(0.1 * t, std::cos(t), t);
+    EXPECT_TRUE(reference.insertData(stor));
+    EXPECT_TRUE(cache.insertData(stor));
+  }
+  EXPECT_EQ(cache.getListLength(), reference.getListLength());
+  EXPECT_EQ(cache.getOldestTimestamp(), reference.getOldestTimestamp());
+  EXPECT_EQ(cache.getLatestTimestamp(), reference.getLatestTimestamp());
+  EXPECT_EQ(cache.getLatestTimeAndParent(), reference.getLatestTimeAndParent());
+
+  for (uint64_t i = 0; i <= 19990; i += 7) {
+    tf2::TimePoint time{std::chrono::milliseconds(i)};
+    tf2::TransformStorage expected;
+    tf2::TransformStorage actual;
+    ASSERT_TRUE(reference.getData(time, expected));
+    ASSERT_TRUE(cache.getData(time, actual));
+    EXPECT_EQ(expected.stamp_, actual.stamp_);
+    EXPECT_EQ(expected.frame_id_, actual.frame_id_);
+    EXPECT_EQ(expected.child_frame_id_, actual.child_frame_id_);
+    EXPECT_EQ(expected.translation_, actual.translation_);
+    EXPECT_EQ(expected.rotation_, actual.rotation_);
+    EXPECT_EQ(reference.getParent(time, nullptr), cache.getParent(time, nullptr));
+  }
+
+  std::string error_str;
+  EXPECT_FALSE(cache.getData(tf2::TimePoint(std::chrono::seconds(20)), stor, &error_str));
+  EXPECT_FALSE(error_str.empty());
+
+  // Only appending is supported
+  stor.stamp_ = tf2::TimePoint(std::chrono::seconds(1));
+  EXPECT_FALSE(cache.insertData(stor));
+  EXPECT_EQ(cache.getListLength(), 2000u);
+  std::vector<tf2::TransformStorage> samples;
+  cache.copySamples(samples);
+  EXPECT_EQ(samples.size(), 2000u);
+}
+
+TEST(SingleWriterCache, BoundedExtrapolation)
+{
+  tf2::SingleWriterCache cache;
+  expectBoundedExtrapolation(cache);
+}
+
+TEST(SingleWriterCache, RetentionPolicy)
+{
+  tf2::SingleWriterCache cache(std::chrono::milliseconds(99));
+
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  for (uint64_t i = 1; i <= 1000; i++) {
+    stor.stamp_ = tf2::TimePoint(std::chrono::milliseconds(i));
+    EXPECT_TRUE(cache.insertData(stor));
+  }
+  EXPECT_EQ(cache.getListLength(), 100u);
+  EXPECT_EQ(cache.getOldestTimestamp(), tf2::TimePoint(std::chrono::milliseconds(901)));
+
+  tf2::RetentionPolicy policy;
+  policy.max_samples = 10;
+  cache.setRetentionPolicy(policy);
+  EXPECT_EQ(cache.getListLength(), 10u);
+  EXPECT_EQ(cache.getOldestTimestamp(), tf2::TimePoint(std::chrono::milliseconds(991)));
+
+  EXPECT_EQ(cache.dropOldest(100), 9u);
+  EXPECT_EQ(cache.getListLength(), 1u);
+  ASSERT_TRUE(cache.getData(tf2::TimePointZero, stor));
+  EXPECT_EQ(stor.stamp_, tf2::TimePoint(std::chrono::milliseconds(1000)));
+  ASSERT_TRUE(cache.getLatestSnapshot(stor));
+  EXPECT_EQ(stor.stamp_, tf2::TimePoint(std::chrono::milliseconds(1000)));
+
+  cache.clearList();
+  EXPECT_EQ(cache.getListLength(), 0u);
+  EXPECT_FALSE(cache.getData(tf2::TimePointZero, stor));
+  EXPECT_FALSE(cache.getLatestSnapshot(stor));
+}
+
+TEST(SingleWriterCache, Reads_While_Appending)
+{
+  // A short history makes the writer wrap around onto the samples being read all the time
+  tf2::SingleWriterCache cache(std::chrono::microseconds(50));
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  stor.stamp_ = tf2::TimePoint(std::chrono::microseconds(1));
+  stor.translation_.setValue(1.0, 0.0, 0.0);
+  ASSERT_TRUE(cache.insertData(stor));
+
+  std::atomic<bool> done(false);
+  std::atomic<int> failures(0);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 2; ++i) {
+    readers.emplace_back(
+      [&cache, &done, &failures]() {
+        // Every sample has its x equal to its stamp in microseconds, so does any interpolation
+        tf2::TransformStorage sample;
+        while (!done) {
+          if (!cache.getData(tf2::TimePointZero, sample)) {
+            ++failures;
+            continue;
+          }
+          tf2::TimePoint time = sample.stamp_ - std::chrono::nanoseconds(20500);
+          if (!cache.getData(time, sample)) {
+            continue;
+          }
+          double expected = std::chrono::duration<double, std::micro>(
+            time.time_since_epoch()).count();
+          if (std::abs(sample.translation_.x() - expected) > 1e-6) {
+            ++failures;
+          }
+        }
+      });
+  }
+
+  for (uint64_t i = 2; i < 200000; i++) {
+    stor.stamp_ = tf2::TimePoint(std::chrono::microseconds(i));
+    stor.translation_.setValue(static_cast<double>(i), 0.0, 0.0);
+    EXPECT_TRUE(cache.insertData(stor));
+  }
+  done = true;
+  for (auto & reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(failures, 0);
+  EXPECT_EQ(cache.getListLength(), 51u);
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,116 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// Measures the error and the lookup throughput of interpolating rotations with a normalized
+// lerp instead of a slerp, see RetentionPolicy::nlerp_max_angle.
+//
+// Usage: interpolation_speed_test [lookups]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+
+#include "console_bridge/console.h"
+#include "tf2/time_cache.h"
+#include "tf2/LinearMath/Quaternion.h"
+#include "tf2/LinearMath/Vector3.h"
+
+namespace
+{
+
+/// Fill a cache with 1 kHz samples, each rotated by step radians from the previous one
+void fill(tf2::TimeCache & cache, double step)
+{
+  tf2::TransformStorage stor;
+  stor.translation_.setValue(0.0, 0.0, 0.0);
+  for (int i = 0; i < 1000; ++i) {
+    stor.stamp_ = tf2::TimePoint(std::chrono::milliseconds(i + 1));
+    stor.rotation_.setRotation(tf2::Vector3(0.3, -0.5, 0.8).normalized(), step * i);
+    cache.insertData(stor);
+  }
+}
+
+/// Returns lookups per second, and the sum of the results to keep them from being optimized out
+double lookups(tf2::TimeCache & cache, int count, double & sum)
+{
+  tf2::TransformStorage out;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; ++i) {
+    // Spread the lookups over the whole history without hitting a sample exactly
+    tf2::TimePoint time(std::chrono::microseconds(1000 + (i * 7919) % 998000 + 1));
+    cache.getData(time, out);
+    sum += out.rotation_.w();
+  }
+  return count / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  int count = 1000000;
+  if (argc > 1) {
+    count = std::stoi(argv[1]);
+  }
+
+  CONSOLE_BRIDGE_logInform(
+    "%10s %14s %14s %14s %14s", "step rad", "max error rad", "0.005*step^3", "slerp/s", "nlerp/s");
+  const double steps[] = {0.0001, 0.001, 0.01, 0.05, 0.1, 0.5};
+  double sum = 0.0;
+  for (double step : steps) {
+    // The largest error over one interval, all intervals are alike
+    const tf2::Quaternion one = tf2::Quaternion::getIdentity();
+    tf2::Quaternion two;
+    two.setRotation(tf2::Vector3(0.3, -0.5, 0.8).normalized(), step);
+    double max_error = 0.0;
+    for (int i = 1; i < 1000; ++i) {
+      const double ratio = i / 1000.0;
+      const tf2::Quaternion exact = tf2::slerp(one, two, ratio);
+      const tf2::Quaternion fast = tf2::nlerp(one, two, ratio);
+      // Twice the angle between the quaternions, without acos losing precision near zero
+      max_error = std::max(max_error, 4.0 * std::asin(std::min(1.0, (exact - fast).length() / 2)));
+    }
+
+    tf2::TimeCache slerp_cache, nlerp_cache;
+    tf2::RetentionPolicy policy;
+    policy.nlerp_max_angle = step * 2.0;
+    nlerp_cache.setRetentionPolicy(policy);
+    fill(slerp_cache, step);
+    fill(nlerp_cache, step);
+    const double slerp_rate = lookups(slerp_cache, count, sum);
+    const double nlerp_rate = lookups(nlerp_cache, count, sum);
+
+    CONSOLE_BRIDGE_logInform(
+      "%10g %14.3g %14.3g %14.0f %14.0f", step, max_error, 0.005 * step * step * step,
+      slerp_rate, nlerp_rate);
+  }
+  CONSOLE_BRIDGE_logDebug("checksum %f", sum);
+  return 0;
+}
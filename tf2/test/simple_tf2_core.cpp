@@ -28,8 +28,13 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "tf2/buffer_core.h"
@@ -108,6 +113,246 @@ TEST(tf2, setTransformValidWithCallback)
   EXPECT_TRUE(transform_available);
 }
 
+TEST(tf2, setTransformsBatch)
+{
+  tf2::BufferCore buffer;
+
+  int callback_count = 0;
+  auto cb =
+    [&callback_count](
+    tf2::TransformableRequestHandle, const std::string &, const std::string &,
+    tf2::TimePoint, tf2::TransformableResult result)
+    {
+      EXPECT_EQ(tf2::TransformAvailable, result);
+      ++callback_count;
+    };
+
+  tf2::TransformableRequestHandle request_handle = buffer.addTransformableRequest(
+    cb, "foo", "baz", tf2::timeFromSec(1.0));
+  ASSERT_NE(request_handle, 0u);
+
+  std::vector<geometry_msgs::msg::TransformStamped> transforms(3);
+  transforms[0].header.frame_id = "foo";
+  transforms[0].header.stamp.sec = 1;
+  transforms[0].child_frame_id = "bar";
+  transforms[0].transform.rotation.w = 1;
+  transforms[1] = transforms[0];
+  transforms[1].header.frame_id = "bar";
+  transforms[1].child_frame_id = "baz";
+  // An invalid transform does not prevent the rest of the batch from being inserted
+  transforms[2] = transforms[0];
+  transforms[2].child_frame_id = "";
+
+  EXPECT_FALSE(buffer.setTransforms(transforms, "authority1"));
+  EXPECT_EQ(callback_count, 1);
+  EXPECT_TRUE(buffer.canTransform("foo", "baz", tf2::timeFromSec(1.0)));
+
+  transforms.pop_back();
+  EXPECT_TRUE(buffer.setTransforms(transforms, "authority1", true));
+  EXPECT_TRUE(buffer.canTransform("foo", "baz", tf2::timeFromSec(2.0)));
+}
+
+TEST(tf2, transformableRequestsOnlyFireWhenAvailable)
+{
+  tf2::BufferCore buffer;
+
+  std::vector<std::string> fired;
+  auto cb =
+    [&fired](
+    tf2::TransformableRequestHandle, const std::string &, const std::string & source_frame,
+    tf2::TimePoint, tf2::TransformableResult result)
+    {
+      EXPECT_EQ(tf2::TransformAvailable, result);
+      fired.push_back(source_frame);
+    };
+
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "base";
+  st.header.stamp.sec = 1;
+  st.child_frame_id = "laser";
+  st.transform.rotation.w = 1;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1"));
+
+  // laser has data at 1s and needs data after 2s, camera is not connected to base yet
+  ASSERT_NE(0u, buffer.addTransformableRequest(cb, "base", "laser", tf2::timeFromSec(2.0)));
+  ASSERT_NE(0u, buffer.addTransformableRequest(cb, "base", "camera", tf2::timeFromSec(1.0)));
+
+  // Data that doesn't cover the requested time doesn't fire anything
+  st.header.stamp.nanosec = 500000000;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1"));
+  EXPECT_TRUE(fired.empty());
+
+  st.header.stamp.sec = 3;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1"));
+  ASSERT_EQ(1u, fired.size());
+  EXPECT_EQ("laser", fired[0]);
+
+  // Connecting camera to the tree changes the topology
+  st.header.frame_id = "laser";
+  st.header.stamp.sec = 1;
+  st.header.stamp.nanosec = 0;
+  st.child_frame_id = "camera";
+  EXPECT_TRUE(buffer.setTransform(st, "authority1", true));
+  ASSERT_EQ(2u, fired.size());
+  EXPECT_EQ("camera", fired[1]);
+}
+
+TEST(tf2, transformableRequestsFromCallbacks)
+{
+  tf2::BufferCore buffer;
+
+  // Each callback waits for the next second, as a coroutine awaiting in a loop would
+  std::vector<int32_t> fired;
+  tf2::BufferCore::TransformableCallback cb =
+    [&buffer, &fired, &cb](
+    tf2::TransformableRequestHandle, const std::string & target_frame,
+    const std::string & source_frame, tf2::TimePoint time, tf2::TransformableResult result)
+    {
+      EXPECT_EQ(tf2::TransformAvailable, result);
+      fired.push_back(static_cast<int32_t>(tf2::timeToSec(time)));
+      EXPECT_NE(
+        0u, buffer.addTransformableRequest(
+          cb, target_frame, source_frame, time + std::chrono::seconds(1)));
+    };
+  ASSERT_NE(0u, buffer.addTransformableRequest(cb, "base", "laser", tf2::timeFromSec(1.0)));
+
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "base";
+  st.child_frame_id = "laser";
+  st.transform.rotation.w = 1;
+  for (int32_t sec = 1; sec <= 3; ++sec) {
+    st.header.stamp.sec = sec;
+    EXPECT_TRUE(buffer.setTransform(st, "authority1"));
+  }
+  EXPECT_EQ(std::vector<int32_t>({1, 2, 3}), fired);
+}
+
+TEST(tf2, cancelledRequestHandlesAreNotReused)
+{
+  tf2::BufferCore buffer;
+
+  std::vector<tf2::TransformableRequestHandle> fired;
+  auto cb =
+    [&fired](
+    tf2::TransformableRequestHandle handle, const std::string &, const std::string &,
+    tf2::TimePoint, tf2::TransformableResult)
+    {
+      fired.push_back(handle);
+    };
+  tf2::TransformableRequestHandle cancelled =
+    buffer.addTransformableRequest(cb, "base", "laser", tf2::timeFromSec(1.0));
+  ASSERT_NE(0u, cancelled);
+  buffer.cancelTransformableRequest(cancelled);
+
+  // The new request takes over the slot of the cancelled one, but not its handle
+  tf2::TransformableRequestHandle pending =
+    buffer.addTransformableRequest(cb, "base", "laser", tf2::timeFromSec(1.0));
+  ASSERT_NE(0u, pending);
+  EXPECT_NE(cancelled, pending);
+  buffer.cancelTransformableRequest(cancelled);
+  buffer.cancelTransformableRequest(0);
+  buffer.cancelTransformableRequest(0xffffffffffffffffULL);
+  EXPECT_EQ(1u, buffer.getMetrics().pending_transformable_requests);
+
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "base";
+  st.header.stamp.sec = 1;
+  st.child_frame_id = "laser";
+  st.transform.rotation.w = 1;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1"));
+  EXPECT_EQ(std::vector<tf2::TransformableRequestHandle>({pending}), fired);
+  EXPECT_EQ(0u, buffer.getMetrics().pending_transformable_requests);
+}
+
+TEST(tf2, requestsSurviveSweepingCancelledOnes)
+{
+  tf2::BufferCore buffer;
+
+  std::vector<tf2::TransformableRequestHandle> fired;
+  auto cb =
+    [&fired](
+    tf2::TransformableRequestHandle handle, const std::string &, const std::string &,
+    tf2::TimePoint, tf2::TransformableResult)
+    {
+      fired.push_back(handle);
+    };
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "base";
+  st.header.stamp.sec = 1;
+  st.child_frame_id = "laser";
+  st.transform.rotation.w = 1;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1"));
+
+  // Cancel enough requests for their entries to be swept out between the kept ones
+  std::vector<tf2::TransformableRequestHandle> kept;
+  for (int i = 0; i < 1000; ++i) {
+    tf2::TransformableRequestHandle handle = buffer.addTransformableRequest(
+      cb, "base", "laser", tf2::timeFromSec(2.0 + i * 0.001));
+    ASSERT_NE(0u, handle);
+    if (i % 10 == 0) {
+      kept.push_back(handle);
+    } else {
+      buffer.cancelTransformableRequest(handle);
+    }
+  }
+  EXPECT_EQ(kept.size(), buffer.getMetrics().pending_transformable_requests);
+
+  st.header.stamp.sec = 3;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1"));
+  EXPECT_EQ(kept, fired);
+  EXPECT_EQ(0u, buffer.getMetrics().pending_transformable_requests);
+}
+
+TEST(tf2, frameSubscriptionsOnlyFireForTheirFrame)
+{
+  tf2::BufferCore buffer;
+
+  std::vector<geometry_msgs::msg::TransformStamped> received;
+  auto cb =
+    [&received](tf2::FrameSubscriptionHandle, const geometry_msgs::msg::TransformStamped & latest)
+    {
+      received.push_back(latest);
+    };
+  EXPECT_EQ(0u, buffer.subscribeFrame("", cb));
+  tf2::FrameSubscriptionHandle handle = buffer.subscribeFrame("/laser", cb);
+  ASSERT_NE(0u, handle);
+
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "base";
+  st.header.stamp.sec = 1;
+  st.child_frame_id = "camera";
+  st.transform.rotation.w = 1;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1"));
+  EXPECT_TRUE(received.empty());
+
+  st.child_frame_id = "laser";
+  st.transform.translation.x = 2.0;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1"));
+  ASSERT_EQ(1u, received.size());
+  EXPECT_EQ("base", received[0].header.frame_id);
+  EXPECT_EQ("laser", received[0].child_frame_id);
+  EXPECT_EQ(1, received[0].header.stamp.sec);
+  EXPECT_DOUBLE_EQ(2.0, received[0].transform.translation.x);
+
+  // One call per insert with the newest sample, also for batches
+  std::vector<geometry_msgs::msg::TransformStamped> batch(3, st);
+  batch[1].header.stamp.sec = 3;
+  batch[2].header.stamp.sec = 2;
+  EXPECT_TRUE(buffer.setTransforms(batch, "authority1"));
+  ASSERT_EQ(2u, received.size());
+  EXPECT_EQ(3, received[1].header.stamp.sec);
+
+  // Rejected samples change nothing
+  st.header.stamp.sec = -100;
+  EXPECT_FALSE(buffer.setTransform(st, "authority1"));
+  EXPECT_EQ(2u, received.size());
+
+  buffer.unsubscribeFrame(handle);
+  st.header.stamp.sec = 4;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1"));
+  EXPECT_EQ(2u, received.size());
+}
+
 TEST(tf2, setTransformInvalidQuaternion)
 {
   tf2::BufferCore tfc;
@@ -204,6 +449,1523 @@ TEST(tf2_clear, LookUp_Static_Transfrom_Fail)
   );
 }
 
+static void setFrameChainTestTransform(
+  tf2::BufferCore & buffer, const std::string & parent, const std::string & child,
+  int32_t sec, double x, double yaw, bool is_static = false)
+{
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = parent;
+  st.header.stamp.sec = sec;
+  st.child_frame_id = child;
+  st.transform.translation.x = x;
+  st.transform.rotation.z = std::sin(yaw / 2);
+  st.transform.rotation.w = std::cos(yaw / 2);
+  EXPECT_TRUE(buffer.setTransform(st, "authority1", is_static));
+}
+
+static void expectSameTransform(
+  const geometry_msgs::msg::TransformStamped & expected,
+  const geometry_msgs::msg::TransformStamped & actual)
+{
+  EXPECT_EQ(expected.header.frame_id, actual.header.frame_id);
+  EXPECT_EQ(expected.child_frame_id, actual.child_frame_id);
+  EXPECT_EQ(expected.header.stamp.sec, actual.header.stamp.sec);
+  EXPECT_EQ(expected.header.stamp.nanosec, actual.header.stamp.nanosec);
+  EXPECT_NEAR(expected.transform.translation.x, actual.transform.translation.x, 1e-9);
+  EXPECT_NEAR(expected.transform.translation.y, actual.transform.translation.y, 1e-9);
+  EXPECT_NEAR(expected.transform.translation.z, actual.transform.translation.z, 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.x, actual.transform.rotation.x, 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.y, actual.transform.rotation.y, 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.z, actual.transform.rotation.z, 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.w, actual.transform.rotation.w, 1e-9);
+}
+
+TEST(tf2, transformRequestsStageTheTransform)
+{
+  tf2::BufferCore buffer;
+  std::vector<geometry_msgs::msg::TransformStamped> received;
+  std::vector<tf2::TransformableResult> results;
+  auto cb =
+    [&](tf2::TransformableRequestHandle, const std::string &, const std::string &,
+      tf2::TimePoint, tf2::TransformableResult result,
+      const geometry_msgs::msg::TransformStamped * transform)
+    {
+      results.push_back(result);
+      EXPECT_EQ(result == tf2::TransformAvailable, transform != nullptr);
+      if (transform) {
+        received.push_back(*transform);
+      }
+    };
+
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "foo";
+  st.child_frame_id = "bar";
+  st.header.stamp.sec = 1;
+  st.transform.translation.x = 1.0;
+  st.transform.rotation.w = 1;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1"));
+
+  // Waits for the sample after the requested time, then hands over the interpolated transform
+  EXPECT_NE(0u, buffer.addTransformRequest(cb, "foo", "bar", tf2::timeFromSec(1.5)));
+  EXPECT_TRUE(received.empty());
+  st.header.stamp.sec = 2;
+  st.transform.translation.x = 3.0;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1"));
+  ASSERT_EQ(1u, received.size());
+  expectSameTransform(buffer.lookupTransform("foo", "bar", tf2::timeFromSec(1.5)), received[0]);
+  EXPECT_NEAR(2.0, received[0].transform.translation.x, 1e-9);
+
+  // Results known right away are handed over before returning
+  EXPECT_EQ(0u, buffer.addTransformRequest(cb, "foo", "bar", tf2::timeFromSec(1.25)));
+  ASSERT_EQ(2u, received.size());
+  EXPECT_NEAR(1.5, received[1].transform.translation.x, 1e-9);
+  EXPECT_EQ(0u, buffer.addTransformRequest(cb, "bar", "bar", tf2::timeFromSec(1.25)));
+  ASSERT_EQ(3u, received.size());
+  EXPECT_EQ(1, received[2].transform.rotation.w);
+  EXPECT_EQ(
+    0xffffffffffffffffULL, buffer.addTransformRequest(cb, "foo", "bar", tf2::timeFromSec(-20)));
+  ASSERT_EQ(4u, results.size());
+  EXPECT_EQ(tf2::TransformFailure, results[3]);
+}
+
+TEST(tf2_frameChain, Lookup_Matches_String_Lookup)
+{
+  tf2::BufferCore buffer;
+  for (int32_t sec = 1; sec <= 2; ++sec) {
+    setFrameChainTestTransform(buffer, "root", "a", sec, 1.0 * sec, 0.1 * sec);
+    setFrameChainTestTransform(buffer, "a", "b", sec, 2.0 * sec, 0.2 * sec);
+    setFrameChainTestTransform(buffer, "root", "c", sec, 3.0 * sec, 0.3 * sec);
+  }
+
+  const std::vector<std::pair<std::string, std::string>> pairs = {
+    {"c", "b"}, {"b", "c"}, {"root", "b"}, {"b", "root"}, {"a", "a"}};
+  const std::vector<tf2::TimePoint> times = {
+    tf2::TimePointZero, tf2::timeFromSec(1.0), tf2::timeFromSec(1.25)};
+  for (const auto & pair : pairs) {
+    tf2::FrameChainHandle chain = buffer.getFrameChain(pair.first, pair.second);
+    ASSERT_TRUE(chain);
+    EXPECT_EQ(pair.first, chain->getTargetFrame());
+    EXPECT_EQ(pair.second, chain->getSourceFrame());
+    for (tf2::TimePoint time : times) {
+      EXPECT_TRUE(buffer.canTransform(chain, time));
+      expectSameTransform(
+        buffer.lookupTransform(pair.first, pair.second, time),
+        buffer.lookupTransform(chain, time));
+    }
+    if (pair.first != pair.second) {
+      EXPECT_FALSE(buffer.canTransform(chain, tf2::timeFromSec(3.0)));
+      EXPECT_THROW(
+        buffer.lookupTransform(chain, tf2::timeFromSec(3.0)), tf2::ExtrapolationException);
+    }
+  }
+}
+
+TEST(tf2_frameChain, Follows_Reparenting)
+{
+  tf2::BufferCore buffer;
+  setFrameChainTestTransform(buffer, "root", "a", 1, 1.0, 0.0);
+  setFrameChainTestTransform(buffer, "root", "c", 1, 3.0, 0.0);
+  setFrameChainTestTransform(buffer, "a", "b", 1, 2.0, 0.0);
+
+  tf2::FrameChainHandle chain = buffer.getFrameChain("root", "b");
+  EXPECT_NEAR(3.0, buffer.lookupTransform(chain, tf2::TimePointZero).transform.translation.x, 1e-9);
+
+  // Move b from a to c, the handle must follow while old times still use the old parent
+  setFrameChainTestTransform(buffer, "root", "a", 2, 1.0, 0.0);
+  setFrameChainTestTransform(buffer, "root", "c", 2, 3.0, 0.0);
+  setFrameChainTestTransform(buffer, "c", "b", 2, 2.0, 0.0);
+  EXPECT_NEAR(5.0, buffer.lookupTransform(chain, tf2::TimePointZero).transform.translation.x, 1e-9);
+  expectSameTransform(
+    buffer.lookupTransform("root", "b", tf2::timeFromSec(1.0)),
+    buffer.lookupTransform(chain, tf2::timeFromSec(1.0)));
+  EXPECT_NEAR(
+    3.0, buffer.lookupTransform(chain, tf2::timeFromSec(1.0)).transform.translation.x, 1e-9);
+
+  // Disconnected frames fail the same way the string lookups do
+  setFrameChainTestTransform(buffer, "other_root", "d", 1, 1.0, 0.0);
+  tf2::FrameChainHandle disconnected = buffer.getFrameChain("b", "d");
+  std::string error_msg;
+  EXPECT_FALSE(buffer.canTransform(disconnected, tf2::TimePointZero, &error_msg));
+  EXPECT_FALSE(error_msg.empty());
+  EXPECT_THROW(
+    buffer.lookupTransform(disconnected, tf2::TimePointZero), tf2::ConnectivityException);
+}
+
+TEST(tf2_frameChain, Invalid_Arguments)
+{
+  tf2::BufferCore buffer;
+  setFrameChainTestTransform(buffer, "root", "a", 1, 1.0, 0.0);
+  EXPECT_THROW(buffer.getFrameChain("root", "missing"), tf2::LookupException);
+  EXPECT_THROW(buffer.getFrameChain("", "a"), tf2::InvalidArgumentException);
+
+  tf2::FrameChainHandle empty;
+  EXPECT_FALSE(buffer.canTransform(empty, tf2::TimePointZero));
+  EXPECT_THROW(buffer.lookupTransform(empty, tf2::TimePointZero), tf2::InvalidArgumentException);
+}
+
+TEST(tf2_frameChain, Latest_Lookups)
+{
+  tf2::BufferCore buffer;
+  // Frames with equal latest stamps and static frames can be read without locking
+  setFrameChainTestTransform(buffer, "root", "a", 1, 1.0, 0.1);
+  setFrameChainTestTransform(buffer, "a", "b", 1, 2.0, 0.2);
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "b";
+  st.child_frame_id = "sensor";
+  st.transform.translation.x = 0.5;
+  st.transform.rotation.w = 1;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1", true));
+
+  tf2::FrameChainHandle chain = buffer.getFrameChain("root", "sensor");
+  tf2::FrameChainHandle inverse = buffer.getFrameChain("sensor", "root");
+  expectSameTransform(
+    buffer.lookupTransform("root", "sensor", tf2::TimePointZero),
+    buffer.lookupTransform(chain, tf2::TimePointZero));
+  expectSameTransform(
+    buffer.lookupTransform("sensor", "root", tf2::TimePointZero),
+    buffer.lookupTransform(inverse, tf2::TimePointZero));
+  EXPECT_EQ(1, buffer.lookupTransform(chain, tf2::TimePointZero).header.stamp.sec);
+
+  // Differing latest stamps need interpolation at the latest common time
+  setFrameChainTestTransform(buffer, "root", "a", 2, 2.0, 0.2);
+  expectSameTransform(
+    buffer.lookupTransform("root", "sensor", tf2::TimePointZero),
+    buffer.lookupTransform(chain, tf2::TimePointZero));
+  EXPECT_EQ(1, buffer.lookupTransform(chain, tf2::TimePointZero).header.stamp.sec);
+  setFrameChainTestTransform(buffer, "a", "b", 3, 2.0, 0.2);
+  EXPECT_EQ(2, buffer.lookupTransform(chain, tf2::TimePointZero).header.stamp.sec);
+  EXPECT_EQ(
+    2, buffer.lookupTransform(
+      buffer.resolveFrame("root"), buffer.resolveFrame("sensor"),
+      tf2::TimePointZero).header.stamp.sec);
+
+  // Cleared dynamic frames are not available anymore
+  buffer.clear();
+  EXPECT_FALSE(buffer.canTransform(chain, tf2::TimePointZero));
+  EXPECT_THROW(buffer.lookupTransform(chain, tf2::TimePointZero), tf2::TransformException);
+}
+
+TEST(tf2_frameHandle, Lookup_Matches_String_Lookup)
+{
+  tf2::BufferCore buffer;
+  for (int32_t sec = 1; sec <= 2; ++sec) {
+    setFrameChainTestTransform(buffer, "root", "a", sec, 1.0 * sec, 0.1 * sec);
+    setFrameChainTestTransform(buffer, "a", "b", sec, 2.0 * sec, 0.2 * sec);
+    setFrameChainTestTransform(buffer, "root", "c", sec, 3.0 * sec, 0.3 * sec);
+  }
+
+  tf2::FrameHandle a = buffer.resolveFrame("a");
+  tf2::FrameHandle b = buffer.resolveFrame("b");
+  tf2::FrameHandle c = buffer.resolveFrame("c");
+  tf2::FrameHandle root = buffer.resolveFrame("root");
+  ASSERT_TRUE(a && b && c && root);
+  EXPECT_EQ(b, buffer.resolveFrame("b"));
+  EXPECT_NE(a, b);
+
+  for (tf2::TimePoint time : {tf2::TimePointZero, tf2::timeFromSec(1.5)}) {
+    EXPECT_TRUE(buffer.canTransform(c, b, time));
+    expectSameTransform(
+      buffer.lookupTransform("c", "b", time), buffer.lookupTransform(c, b, time));
+    expectSameTransform(
+      buffer.lookupTransform("a", "a", time), buffer.lookupTransform(a, a, time));
+    EXPECT_TRUE(buffer.canTransform(c, time, b, tf2::timeFromSec(1.0), root));
+    expectSameTransform(
+      buffer.lookupTransform("c", time, "b", tf2::timeFromSec(1.0), "root"),
+      buffer.lookupTransform(c, time, b, tf2::timeFromSec(1.0), root));
+  }
+
+  EXPECT_FALSE(buffer.canTransform(c, b, tf2::timeFromSec(3.0)));
+  EXPECT_THROW(buffer.lookupTransform(c, b, tf2::timeFromSec(3.0)), tf2::ExtrapolationException);
+}
+
+TEST(tf2_frameTable, Matches_Frame_Names)
+{
+  tf2::BufferCore buffer;
+  tf2::FrameTable table;
+  EXPECT_FALSE(buffer.getFrameTable(table));
+  EXPECT_TRUE(table.empty());
+
+  setFrameChainTestTransform(buffer, "root", "a", 1, 1.0, 0.0);
+  uint64_t version = buffer.getFrameTableVersion();
+  EXPECT_TRUE(buffer.getFrameTable(table));
+  EXPECT_EQ(version, table.getVersion());
+  EXPECT_EQ(buffer.getAllFrameNames(), std::vector<std::string>(table.begin(), table.end()));
+  const std::string * root_name = &table[0];
+
+  // Nothing changed, so nothing to do
+  setFrameChainTestTransform(buffer, "root", "a", 2, 1.0, 0.0);
+  EXPECT_EQ(version, buffer.getFrameTableVersion());
+  EXPECT_FALSE(buffer.getFrameTable(table));
+
+  // New frames are appended, the names already in the table stay where they are
+  for (int i = 0; i < 100; ++i) {
+    setFrameChainTestTransform(buffer, "a", "b" + std::to_string(i), 2, 1.0, 0.0);
+  }
+  EXPECT_NE(version, buffer.getFrameTableVersion());
+  EXPECT_TRUE(buffer.getFrameTable(table));
+  EXPECT_EQ(buffer.getAllFrameNames(), std::vector<std::string>(table.begin(), table.end()));
+  EXPECT_EQ(root_name, &table[0]);
+  for (size_t i = 0; i < table.size(); ++i) {
+    EXPECT_EQ(buffer.resolveFrame(table[i]), table.getHandle(i));
+  }
+}
+
+TEST(tf2_frameHandle, Unresolved_Frames)
+{
+  tf2::BufferCore buffer;
+  std::string error_msg;
+  tf2::FrameHandle missing = buffer.resolveFrame("a", &error_msg);
+  EXPECT_FALSE(missing);
+  EXPECT_FALSE(error_msg.empty());
+  EXPECT_FALSE(buffer.resolveFrame("/a", &error_msg));
+  EXPECT_FALSE(buffer.resolveFrame("", &error_msg));
+
+  setFrameChainTestTransform(buffer, "root", "a", 1, 1.0, 0.0);
+  tf2::FrameHandle a = buffer.resolveFrame("a");
+  ASSERT_TRUE(a);
+  EXPECT_FALSE(buffer.canTransform(a, missing, tf2::TimePointZero, &error_msg));
+  EXPECT_THROW(buffer.lookupTransform(a, missing, tf2::TimePointZero), tf2::LookupException);
+
+  // Handles stay valid across clear
+  buffer.clear();
+  EXPECT_EQ(a, buffer.resolveFrame("a"));
+  setFrameChainTestTransform(buffer, "root", "a", 2, 1.0, 0.0);
+  EXPECT_TRUE(buffer.canTransform(buffer.resolveFrame("root"), a, tf2::TimePointZero));
+}
+
+static void expectSameTransform(
+  const geometry_msgs::msg::TransformStamped & expected,
+  const tf2::Transform & actual, tf2::TimePoint actual_time)
+{
+  EXPECT_EQ(
+    tf2::TimePoint(
+      std::chrono::seconds(expected.header.stamp.sec) +
+      std::chrono::nanoseconds(expected.header.stamp.nanosec)), actual_time);
+  EXPECT_NEAR(expected.transform.translation.x, actual.getOrigin().x(), 1e-9);
+  EXPECT_NEAR(expected.transform.translation.y, actual.getOrigin().y(), 1e-9);
+  EXPECT_NEAR(expected.transform.translation.z, actual.getOrigin().z(), 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.x, actual.getRotation().x(), 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.y, actual.getRotation().y(), 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.z, actual.getRotation().z(), 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.w, actual.getRotation().w(), 1e-9);
+}
+
+TEST(tf2_lookupTransform, Transform_Output_Matches_Message)
+{
+  tf2::BufferCore buffer;
+  for (int32_t sec = 1; sec <= 2; ++sec) {
+    setFrameChainTestTransform(buffer, "root", "a", sec, 1.0 * sec, 0.1 * sec);
+    setFrameChainTestTransform(buffer, "a", "b", sec, 2.0 * sec, 0.2 * sec);
+    setFrameChainTestTransform(buffer, "root", "c", sec, 3.0 * sec, 0.3 * sec);
+  }
+
+  tf2::FrameChainHandle chain = buffer.getFrameChain("c", "b");
+  tf2::Transform transform;
+  tf2::TimePoint time_out;
+  for (tf2::TimePoint time : {tf2::TimePointZero, tf2::timeFromSec(1.5)}) {
+    buffer.lookupTransform("c", "b", time, transform, time_out);
+    expectSameTransform(buffer.lookupTransform("c", "b", time), transform, time_out);
+    buffer.lookupTransform(chain, time, transform, time_out);
+    expectSameTransform(buffer.lookupTransform(chain, time), transform, time_out);
+    buffer.lookupTransform("c", time, "b", tf2::timeFromSec(1.0), "root", transform, time_out);
+    expectSameTransform(
+      buffer.lookupTransform("c", time, "b", tf2::timeFromSec(1.0), "root"), transform, time_out);
+  }
+
+  EXPECT_THROW(
+    buffer.lookupTransform("c", "missing", tf2::TimePointZero, transform, time_out),
+    tf2::LookupException);
+  EXPECT_THROW(
+    buffer.lookupTransform("c", "b", tf2::timeFromSec(3.0), transform, time_out),
+    tf2::ExtrapolationException);
+}
+
+TEST(tf2_tryLookupTransform, Matches_Throwing_Lookups)
+{
+  tf2::BufferCore buffer;
+  for (int32_t sec = 1; sec <= 2; ++sec) {
+    setFrameChainTestTransform(buffer, "root", "a", sec, 1.0 * sec, 0.1 * sec);
+    setFrameChainTestTransform(buffer, "a", "b", sec, 2.0 * sec, 0.2 * sec);
+    setFrameChainTestTransform(buffer, "other_root", "c", sec, 3.0 * sec, 0.3 * sec);
+  }
+
+  tf2::FrameChainHandle chain = buffer.getFrameChain("root", "b");
+  geometry_msgs::msg::TransformStamped msg;
+  tf2::Transform transform;
+  tf2::TimePoint time_out;
+  for (tf2::TimePoint time : {tf2::TimePointZero, tf2::timeFromSec(1.5)}) {
+    EXPECT_EQ(tf2::TF2Error::NO_ERROR, buffer.tryLookupTransform("root", "b", time, msg));
+    buffer.lookupTransform("root", "b", time, transform, time_out);
+    expectSameTransform(msg, transform, time_out);
+    EXPECT_EQ(
+      tf2::TF2Error::NO_ERROR, buffer.tryLookupTransform(chain, time, transform, time_out));
+    expectSameTransform(msg, transform, time_out);
+  }
+  EXPECT_EQ(
+    tf2::TF2Error::NO_ERROR,
+    buffer.tryLookupTransform("b", "b", tf2::TimePointZero, transform, time_out));
+
+  // The message is only filled in if asked for, and is the one that would have been thrown
+  auto expect_error = [&](
+    tf2::TF2Error error, const std::string & target, const std::string & source,
+    tf2::TimePoint time) {
+      EXPECT_EQ(error, buffer.tryLookupTransform(target, source, time, transform, time_out));
+      std::string error_msg;
+      EXPECT_EQ(
+        error, buffer.tryLookupTransform(target, source, time, transform, time_out, &error_msg));
+      try {
+        buffer.lookupTransform(target, source, time);
+        ADD_FAILURE() << "lookupTransform did not throw";
+      } catch (const tf2::TransformException & ex) {
+        // Apart from the name of the function
+        size_t name = error_msg.find("tryLookupTransform");
+        if (name != std::string::npos) {
+          error_msg.replace(name, 18, "lookupTransform");
+        }
+        EXPECT_EQ(ex.what(), error_msg);
+      }
+    };
+  expect_error(tf2::TF2Error::LOOKUP_ERROR, "root", "missing", tf2::TimePointZero);
+  expect_error(tf2::TF2Error::INVALID_ARGUMENT_ERROR, "", "b", tf2::TimePointZero);
+  expect_error(tf2::TF2Error::CONNECTIVITY_ERROR, "root", "c", tf2::TimePointZero);
+  expect_error(tf2::TF2Error::EXTRAPOLATION_ERROR, "root", "b", tf2::timeFromSec(3.0));
+  EXPECT_EQ(
+    tf2::TF2Error::EXTRAPOLATION_ERROR,
+    buffer.tryLookupTransform(chain, tf2::timeFromSec(3.0), transform, time_out));
+  EXPECT_EQ(
+    tf2::TF2Error::INVALID_ARGUMENT_ERROR,
+    buffer.tryLookupTransform(nullptr, tf2::TimePointZero, transform, time_out));
+}
+
+TEST(tf2_lookupTransforms, Matches_Single_Lookups)
+{
+  tf2::BufferCore buffer;
+  for (int32_t sec = 1; sec <= 3; ++sec) {
+    setFrameChainTestTransform(buffer, "root", "a", sec, 1.0 * sec, 0.1 * sec);
+    setFrameChainTestTransform(buffer, "a", "b", sec, 2.0 * sec, 0.2 * sec);
+    setFrameChainTestTransform(buffer, "root", "c", sec, 3.0 * sec, 0.3 * sec);
+  }
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "b";
+  st.child_frame_id = "sensor";
+  st.transform.translation.x = 0.5;
+  st.transform.rotation.w = 1;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1", true));
+
+  // Unsorted, with duplicates and the latest time mixed in
+  const std::vector<tf2::TimePoint> times = {
+    tf2::timeFromSec(2.5), tf2::timeFromSec(1.0), tf2::TimePointZero, tf2::timeFromSec(1.75),
+    tf2::timeFromSec(3.0), tf2::timeFromSec(1.0)};
+  const std::vector<std::pair<std::string, std::string>> pairs = {
+    {"c", "sensor"}, {"sensor", "c"}, {"root", "b"}, {"b", "root"}, {"a", "a"}};
+  for (const auto & pair : pairs) {
+    std::vector<geometry_msgs::msg::TransformStamped> batch =
+      buffer.lookupTransforms(pair.first, pair.second, times);
+    ASSERT_EQ(times.size(), batch.size());
+    for (size_t i = 0; i < times.size(); ++i) {
+      expectSameTransform(buffer.lookupTransform(pair.first, pair.second, times[i]), batch[i]);
+    }
+  }
+  EXPECT_TRUE(buffer.lookupTransforms("c", "b", {}).empty());
+
+  EXPECT_THROW(
+    buffer.lookupTransforms("c", "b", {tf2::timeFromSec(1.0), tf2::timeFromSec(4.0)}),
+    tf2::ExtrapolationException);
+  EXPECT_THROW(buffer.lookupTransforms("c", "missing", times), tf2::LookupException);
+  EXPECT_THROW(buffer.lookupTransforms("", "b", times), tf2::InvalidArgumentException);
+}
+
+TEST(tf2_lookupTransforms, Across_Reparenting)
+{
+  tf2::BufferCore buffer;
+  setFrameChainTestTransform(buffer, "root", "a", 1, 1.0, 0.0);
+  setFrameChainTestTransform(buffer, "root", "c", 1, 3.0, 0.0);
+  setFrameChainTestTransform(buffer, "a", "b", 1, 2.0, 0.0);
+  setFrameChainTestTransform(buffer, "root", "a", 2, 1.0, 0.0);
+  setFrameChainTestTransform(buffer, "root", "c", 2, 3.0, 0.0);
+  setFrameChainTestTransform(buffer, "c", "b", 2, 2.0, 0.0);
+
+  // The chain compiled along the latest parents does not apply at the first time
+  const std::vector<tf2::TimePoint> times = {tf2::timeFromSec(1.0), tf2::timeFromSec(2.0)};
+  std::vector<tf2::Transform> transforms;
+  std::vector<tf2::TimePoint> times_out;
+  buffer.lookupTransforms("root", "b", times, transforms, times_out);
+  ASSERT_EQ(2u, transforms.size());
+  EXPECT_NEAR(3.0, transforms[0].getOrigin().x(), 1e-9);
+  EXPECT_NEAR(5.0, transforms[1].getOrigin().x(), 1e-9);
+  EXPECT_EQ(times, times_out);
+}
+
+TEST(tf2_lookupTransforms, Multiple_Target_Frames)
+{
+  tf2::BufferCore buffer;
+  for (int32_t sec = 1; sec <= 3; ++sec) {
+    setFrameChainTestTransform(buffer, "map", "odom", sec, 1.0 * sec, 0.1 * sec);
+    setFrameChainTestTransform(buffer, "odom", "base_link", sec, 2.0 * sec, 0.2 * sec);
+    setFrameChainTestTransform(buffer, "base_link", "lidar", sec, 0.5, 0.3);
+    setFrameChainTestTransform(buffer, "map", "beacon", sec, 3.0 * sec, 0.4 * sec);
+  }
+  // Only has data at the first second, above where the other targets meet the source
+  setFrameChainTestTransform(buffer, "world", "map", 1, 1.0, 0.0);
+
+  const std::vector<std::string> targets = {
+    "map", "odom", "base_link", "lidar", "beacon", "base_link"};
+  for (tf2::TimePoint time : {tf2::timeFromSec(1.5), tf2::timeFromSec(2.75), tf2::TimePointZero}) {
+    std::vector<geometry_msgs::msg::TransformStamped> batch =
+      buffer.lookupTransforms(targets, "lidar", time);
+    ASSERT_EQ(targets.size(), batch.size());
+    for (size_t i = 0; i < targets.size(); ++i) {
+      EXPECT_EQ(targets[i], batch[i].header.frame_id);
+      EXPECT_EQ("lidar", batch[i].child_frame_id);
+      expectSameTransform(buffer.lookupTransform(targets[i], "lidar", time), batch[i]);
+    }
+  }
+  EXPECT_TRUE(buffer.lookupTransforms(std::vector<std::string>(), "lidar", tf2::TimePointZero)
+    .empty());
+
+  // Errors are the ones a single lookup would report
+  EXPECT_THROW(
+    buffer.lookupTransforms({"odom", "world"}, "lidar", tf2::timeFromSec(2.0)),
+    tf2::ExtrapolationException);
+  EXPECT_THROW(
+    buffer.lookupTransforms({"odom"}, "lidar", tf2::timeFromSec(4.0)),
+    tf2::ExtrapolationException);
+  EXPECT_THROW(
+    buffer.lookupTransforms({"odom", "missing"}, "lidar", tf2::timeFromSec(2.0)),
+    tf2::LookupException);
+  setFrameChainTestTransform(buffer, "island", "reef", 1, 1.0, 0.0);
+  EXPECT_THROW(
+    buffer.lookupTransforms({"reef"}, "lidar", tf2::timeFromSec(1.0)),
+    tf2::ConnectivityException);
+}
+
+TEST(tf2_lookupSubtree, Matches_Single_Lookups)
+{
+  tf2::BufferCore buffer;
+  for (int32_t sec = 1; sec <= 3; ++sec) {
+    setFrameChainTestTransform(buffer, "map", "odom", sec, 1.0 * sec, 0.1 * sec);
+    setFrameChainTestTransform(buffer, "odom", "base_link", sec, 2.0 * sec, 0.2 * sec);
+    setFrameChainTestTransform(buffer, "base_link", "arm", sec, 0.5, 0.3 * sec);
+    setFrameChainTestTransform(buffer, "arm", "hand", sec, 0.25, 0.4 * sec);
+  }
+  setFrameChainTestTransform(buffer, "base_link", "lidar", 0, 0.5, 0.3, true);
+  // Stops a second earlier, so it is left out of later lookups and sets the latest common time
+  setFrameChainTestTransform(buffer, "base_link", "wheel", 1, 0.1, 0.0);
+  setFrameChainTestTransform(buffer, "wheel", "hub", 0, 0.1, 0.0, true);
+  setFrameChainTestTransform(buffer, "island", "reef", 1, 1.0, 0.0);
+
+  tf2::TimePoint time_out;
+  std::vector<tf2::SubtreeTransform> subtree;
+  for (tf2::TimePoint time : {tf2::timeFromSec(1.0), tf2::timeFromSec(2.5), tf2::TimePointZero}) {
+    buffer.lookupSubtree("odom", time, subtree, time_out);
+    const size_t expected_size = time_out > tf2::timeFromSec(1.0) ? 5u : 7u;
+    ASSERT_EQ(expected_size, subtree.size());
+    EXPECT_EQ("odom", subtree[0].frame_id);
+    for (size_t i = 0; i < subtree.size(); ++i) {
+      EXPECT_LE(subtree[i].parent_index, i);
+      expectSameTransform(
+        buffer.lookupTransform("odom", subtree[i].frame_id, time_out), subtree[i].transform,
+        time_out);
+    }
+  }
+  EXPECT_EQ(tf2::timeFromSec(1.0), time_out);
+
+  subtree = buffer.lookupSubtree("base_link", tf2::timeFromSec(3.0));
+  ASSERT_EQ(4u, subtree.size());
+  EXPECT_EQ("hand", subtree[3].frame_id);
+  EXPECT_EQ("arm", subtree[subtree[3].parent_index].frame_id);
+  EXPECT_EQ(1u, buffer.lookupSubtree("hand", tf2::TimePointZero).size());
+
+  EXPECT_THROW(buffer.lookupSubtree("missing", tf2::TimePointZero), tf2::LookupException);
+  EXPECT_THROW(buffer.lookupSubtree("", tf2::TimePointZero), tf2::InvalidArgumentException);
+}
+
+TEST(tf2_lookupCache, Results_Follow_Inserts)
+{
+  tf2::BufferCore buffer;
+  tf2::BufferCore reference;
+  buffer.setLookupCacheCapacity(16);
+  buffer.setMetricsEnabled(true);
+  for (tf2::BufferCore * b : {&buffer, &reference}) {
+    for (int32_t sec = 1; sec <= 3; sec += 2) {
+      setFrameChainTestTransform(*b, "map", "odom", sec, 1.0 * sec, 0.1 * sec);
+      setFrameChainTestTransform(*b, "odom", "base_link", sec, 2.0 * sec, 0.2 * sec);
+    }
+    setFrameChainTestTransform(*b, "base_link", "camera", 0, 0.5, 0.3, true);
+  }
+
+  const tf2::TimePoint time = tf2::timeFromSec(2.5);
+  auto expectSameLookups = [&]() {
+      for (tf2::TimePoint t : {time, time, tf2::TimePointZero, tf2::TimePointZero}) {
+        expectSameTransform(
+          reference.lookupTransform("map", "camera", t),
+          buffer.lookupTransform("map", "camera", t));
+        expectSameTransform(
+          reference.lookupTransform("camera", "odom", t),
+          buffer.lookupTransform("camera", "odom", t));
+      }
+    };
+  expectSameLookups();
+  tf2::BufferCoreMetrics metrics = buffer.getMetrics();
+  EXPECT_EQ(4u, metrics.lookup_cache_hits);
+  EXPECT_EQ(4u, metrics.lookup_cache_misses);
+
+  // A late sample changes the result at time, a new static transform the results at any time
+  for (tf2::BufferCore * b : {&buffer, &reference}) {
+    setFrameChainTestTransform(*b, "odom", "base_link", 2, 5.0, 0.0);
+  }
+  expectSameLookups();
+  for (tf2::BufferCore * b : {&buffer, &reference}) {
+    setFrameChainTestTransform(*b, "base_link", "camera", 0, 0.7, 0.1, true);
+  }
+  expectSameLookups();
+  metrics = buffer.getMetrics();
+  EXPECT_EQ(12u, metrics.lookup_cache_hits);
+  EXPECT_EQ(12u, metrics.lookup_cache_misses);
+
+  // Errors are not remembered
+  EXPECT_THROW(buffer.lookupTransform("map", "camera", tf2::timeFromSec(4.0)),
+    tf2::ExtrapolationException);
+  for (tf2::BufferCore * b : {&buffer, &reference}) {
+    setFrameChainTestTransform(*b, "map", "odom", 4, 4.0, 0.4);
+    setFrameChainTestTransform(*b, "odom", "base_link", 4, 8.0, 0.8);
+  }
+  expectSameTransform(
+    reference.lookupTransform("map", "camera", tf2::timeFromSec(4.0)),
+    buffer.lookupTransform("map", "camera", tf2::timeFromSec(4.0)));
+
+  buffer.setLookupCacheCapacity(0);
+  EXPECT_EQ(0u, buffer.getMetrics().lookup_cache_hits);
+  expectSameLookups();
+}
+
+// Before a reparent, lookups walk frames the current chain does not name, so their results
+// must not be remembered under the versions of the chain
+TEST(tf2_lookupCache, Results_Before_A_Reparent_Follow_Inserts)
+{
+  tf2::BufferCore buffer;
+  tf2::BufferCore reference;
+  buffer.setLookupCacheCapacity(64);
+  for (tf2::BufferCore * b : {&buffer, &reference}) {
+    for (int32_t sec = 1; sec <= 6; ++sec) {
+      setFrameChainTestTransform(*b, "map", "a", sec, 1.0, 0.0);
+      setFrameChainTestTransform(*b, "map", "b", sec, 2.0, 0.0);
+    }
+    setFrameChainTestTransform(*b, "a", "c", 1, 0.0, 0.0);
+    setFrameChainTestTransform(*b, "a", "c", 2, 0.0, 0.0);
+    setFrameChainTestTransform(*b, "b", "c", 5, 0.0, 0.0);
+    setFrameChainTestTransform(*b, "b", "c", 6, 0.0, 0.0);
+  }
+
+  const tf2::TimePoint time = tf2::timeFromSec(1.5);
+  expectSameTransform(
+    reference.lookupTransform("map", "c", time), buffer.lookupTransform("map", "c", time));
+  EXPECT_DOUBLE_EQ(1.0, buffer.lookupTransform("map", "c", time).transform.translation.x);
+
+  geometry_msgs::msg::TransformStamped late;
+  late.header.frame_id = "map";
+  late.header.stamp.sec = 1;
+  late.header.stamp.nanosec = 500000000;
+  late.child_frame_id = "a";
+  late.transform.translation.x = 100.0;
+  late.transform.rotation.w = 1.0;
+  for (tf2::BufferCore * b : {&buffer, &reference}) {
+    EXPECT_TRUE(b->setTransform(late, "authority1"));
+  }
+  expectSameTransform(
+    reference.lookupTransform("map", "c", time), buffer.lookupTransform("map", "c", time));
+  EXPECT_DOUBLE_EQ(100.0, buffer.lookupTransform("map", "c", time).transform.translation.x);
+}
+
+TEST(tf2_lookupVelocity, Constant_Velocity)
+{
+  tf2::BufferCore buffer;
+  for (int32_t sec = 1; sec <= 5; ++sec) {
+    setFrameChainTestTransform(buffer, "world", "odom", sec, 2.0 * sec, 0.5 * sec);
+  }
+  setFrameChainTestTransform(buffer, "odom", "base", 0, 1.0, 0.0, true);
+  setFrameChainTestTransform(buffer, "world", "landmark", 0, 3.0, 0.0, true);
+
+  const tf2::Duration interval = std::chrono::milliseconds(500);
+  geometry_msgs::msg::TwistStamped twist = buffer.lookupVelocity(
+    "odom", "world", tf2::TimePoint(std::chrono::seconds(3)), interval);
+  EXPECT_EQ("world", twist.header.frame_id);
+  EXPECT_EQ(3, twist.header.stamp.sec);
+  EXPECT_NEAR(2.0, twist.twist.linear.x, 1e-9);
+  EXPECT_NEAR(0.0, twist.twist.linear.y, 1e-9);
+  EXPECT_NEAR(0.0, twist.twist.angular.x, 1e-9);
+  EXPECT_NEAR(0.5, twist.twist.angular.z, 1e-9);
+
+  // The latest velocity is averaged over the interval before the newest data
+  tf2::Vector3 linear;
+  tf2::Vector3 angular;
+  tf2::TimePoint time_out;
+  buffer.lookupVelocity("base", "world", tf2::TimePointZero, interval, linear, angular, time_out);
+  EXPECT_EQ(tf2::TimePoint(std::chrono::seconds(5)), time_out);
+  EXPECT_NEAR(0.5, angular.z(), 1e-9);
+
+  twist = buffer.lookupVelocity("landmark", "world", tf2::TimePointZero, interval);
+  EXPECT_EQ(0.0, twist.twist.linear.x);
+  EXPECT_EQ(0.0, twist.twist.angular.z);
+
+  EXPECT_THROW(
+    buffer.lookupVelocity("odom", "world", tf2::TimePointZero, tf2::Duration::zero()),
+    tf2::InvalidArgumentException);
+  EXPECT_THROW(
+    buffer.lookupVelocity("odom", "world", tf2::TimePoint(std::chrono::seconds(1)), interval),
+    tf2::ExtrapolationException);
+  EXPECT_THROW(
+    buffer.lookupVelocity("missing", "world", tf2::TimePointZero, interval),
+    tf2::LookupException);
+}
+
+TEST(tf2_canTransform, History_Bounds_After_Reparenting)
+{
+  tf2::BufferCore buffer;
+  for (int32_t sec = 1; sec <= 6; ++sec) {
+    setFrameChainTestTransform(buffer, "root", "b", sec, 1.0, 0.0);
+    if (sec >= 4) {
+      setFrameChainTestTransform(buffer, "root", "a", sec, 1.0, 0.0);
+    }
+    setFrameChainTestTransform(buffer, "root", "mount", 0, 2.0, 0.0, true);
+    setFrameChainTestTransform(buffer, sec <= 3 ? "a" : "b", "c", sec, 1.0, 0.0);
+  }
+
+  // Up to 3s c hangs off a, which has no data then, even though its latest parent b does
+  tf2::FrameChainHandle chain = buffer.getFrameChain("mount", "c");
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_FALSE(buffer.canTransform("mount", "c", tf2::TimePoint(std::chrono::seconds(2))));
+    EXPECT_FALSE(buffer.canTransform(chain, tf2::TimePoint(std::chrono::seconds(2))));
+    EXPECT_TRUE(buffer.canTransform("mount", "c", tf2::TimePoint(std::chrono::seconds(5))));
+    EXPECT_TRUE(buffer.canTransform(chain, tf2::TimePoint(std::chrono::milliseconds(4500))));
+    EXPECT_FALSE(buffer.canTransform(chain, tf2::TimePoint(std::chrono::seconds(7))));
+    EXPECT_TRUE(buffer.canTransform("mount", "b", tf2::TimePoint(std::chrono::seconds(1))));
+    EXPECT_FALSE(buffer.canTransform("mount", "b", tf2::TimePoint(std::chrono::milliseconds(500))));
+  }
+
+  // Clearing the buffer forgets the old parent
+  buffer.clear();
+  EXPECT_FALSE(buffer.canTransform(chain, tf2::TimePoint(std::chrono::seconds(5))));
+  setFrameChainTestTransform(buffer, "root", "b", 1, 1.0, 0.0);
+  setFrameChainTestTransform(buffer, "root", "b", 3, 1.0, 0.0);
+  setFrameChainTestTransform(buffer, "b", "c", 1, 1.0, 0.0);
+  setFrameChainTestTransform(buffer, "b", "c", 3, 1.0, 0.0);
+  EXPECT_TRUE(buffer.canTransform(chain, tf2::TimePoint(std::chrono::seconds(2))));
+}
+
+TEST(tf2_lookupTransform, Frames_Switching_Between_Static_And_Dynamic)
+{
+  tf2::BufferCore buffer;
+  setFrameChainTestTransform(buffer, "root", "a", 1, 1.0, 0.0);
+  setFrameChainTestTransform(buffer, "root", "a", 2, 2.0, 0.0);
+  EXPECT_NEAR(
+    1.5, buffer.lookupTransform("root", "a", tf2::timeFromSec(1.5)).transform.translation.x, 1e-9);
+
+  // A static transform replaces the history of the frame and applies at any time
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "other_root";
+  st.child_frame_id = "a";
+  st.transform.translation.x = 5.0;
+  st.transform.rotation.w = 1;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1", true));
+  EXPECT_FALSE(buffer.canTransform("root", "a", tf2::TimePointZero));
+  EXPECT_NEAR(
+    5.0, buffer.lookupTransform("other_root", "a", tf2::timeFromSec(7.0)).transform.translation.x,
+    1e-9);
+  EXPECT_EQ(
+    7, buffer.lookupTransform("other_root", "a", tf2::timeFromSec(7.0)).header.stamp.sec);
+
+  // Static frames survive clear, dynamic ones do not
+  buffer.clear();
+  EXPECT_TRUE(buffer.canTransform("other_root", "a", tf2::TimePointZero));
+
+  setFrameChainTestTransform(buffer, "root", "a", 3, 3.0, 0.0);
+  EXPECT_FALSE(buffer.canTransform("other_root", "a", tf2::TimePointZero));
+  EXPECT_NEAR(
+    3.0, buffer.lookupTransform("root", "a", tf2::TimePointZero).transform.translation.x, 1e-9);
+  buffer.clear();
+  EXPECT_FALSE(buffer.canTransform("root", "a", tf2::TimePointZero));
+}
+
+struct RigTransform
+{
+  std::string parent;
+  std::string child;
+  double x;
+  double yaw;
+  bool is_static;
+};
+
+// Static transforms go in as static, or as dynamic ones that never change when as_static is false
+static void setRigTransform(tf2::BufferCore & buffer, const RigTransform & t, bool as_static)
+{
+  if (t.is_static && as_static) {
+    setFrameChainTestTransform(buffer, t.parent, t.child, 0, t.x, t.yaw, true);
+    return;
+  }
+  for (int32_t sec = 1; sec <= 2; ++sec) {
+    double scale = t.is_static ? 1.0 : sec;
+    setFrameChainTestTransform(buffer, t.parent, t.child, sec, scale * t.x, scale * t.yaw);
+  }
+}
+
+TEST(tf2_lookupTransform, Static_Segments_Match_Dynamic_Frames)
+{
+  std::vector<RigTransform> rig = {
+    {"root", "base", 1.0, 0.1, false},
+    {"base", "mount_0", 0.1, 0.2, true},
+    {"mount_0", "mount_1", 0.2, 0.4, true},
+    {"mount_1", "mount_2", 0.3, 0.6, true},
+    {"mount_2", "camera", 0.4, 0.8, true},
+    {"mount_2", "arm", 0.5, 0.3, false},
+    {"arm", "gripper", 0.5, 1.0, true},
+    {"mount_1", "lidar", 0.6, 1.2, true}};
+  tf2::BufferCore buffer;
+  for (const RigTransform & t : rig) {
+    setRigTransform(buffer, t, true);
+  }
+
+  // Compare against a buffer with the same tree in which all of the frames are dynamic
+  auto expect_same_lookups = [&]() {
+      tf2::BufferCore reference;
+      for (const RigTransform & t : rig) {
+        setRigTransform(reference, t, false);
+      }
+      for (const RigTransform & target : rig) {
+        for (const RigTransform & source : rig) {
+          SCOPED_TRACE(target.child + " from " + source.child);
+          expectSameTransform(
+            reference.lookupTransform(target.child, source.child, tf2::timeFromSec(1.5)),
+            buffer.lookupTransform(target.child, source.child, tf2::timeFromSec(1.5)));
+          geometry_msgs::msg::TransformStamped expected =
+            reference.lookupTransform(target.child, source.child, tf2::TimePointZero);
+          geometry_msgs::msg::TransformStamped actual =
+            buffer.lookupTransform(target.child, source.child, tf2::TimePointZero);
+          // Frames connected only through static frames have no latest stamp
+          if (actual.header.stamp.sec == 0) {
+            actual.header.stamp = expected.header.stamp;
+          }
+          expectSameTransform(expected, actual);
+        }
+      }
+    };
+  expect_same_lookups();
+
+  // Updating a frame in the middle of the rig updates everything below it
+  rig[2].x = 0.7;
+  rig[2].yaw = -0.4;
+  setRigTransform(buffer, rig[2], true);
+  expect_same_lookups();
+
+  // And so does turning it into a dynamic frame
+  rig[2].is_static = false;
+  setRigTransform(buffer, rig[2], true);
+  expect_same_lookups();
+}
+
+TEST(tf2_clear, Reset_After_Time_Jump)
+{
+  tf2::BufferCore buffer;
+  setFrameChainTestTransform(buffer, "root", "fixed", 1, 1.0, 0.0, true);
+  for (int32_t sec = 1; sec <= 3; ++sec) {
+    setFrameChainTestTransform(buffer, "root", "a", sec, 1.0 * sec, 0.0);
+  }
+
+  std::vector<tf2::TransformableResult> results;
+  auto cb =
+    [&results](
+    tf2::TransformableRequestHandle, const std::string &, const std::string &,
+    tf2::TimePoint, tf2::TransformableResult result)
+    {
+      results.push_back(result);
+    };
+  ASSERT_NE(0u, buffer.addTransformableRequest(cb, "root", "a", tf2::timeFromSec(10.0)));
+
+  // Requests stay queued for the new timeline unless asked to fail them, even for unknown frames
+  buffer.resetAfterTimeJump(false);
+  EXPECT_TRUE(results.empty());
+  EXPECT_FALSE(buffer.canTransform("root", "a", tf2::timeFromSec(2.0)));
+  EXPECT_TRUE(buffer.canTransform("root", "fixed", tf2::timeFromSec(2.0)));
+  EXPECT_TRUE(buffer._frameExists("a"));
+  EXPECT_EQ(0u, buffer.getStats().sample_count);
+
+  ASSERT_NE(0u, buffer.addTransformableRequest(cb, "root", "b", tf2::timeFromSec(1.0)));
+  buffer.resetAfterTimeJump(true);
+  ASSERT_EQ(2u, results.size());
+  EXPECT_EQ(tf2::TransformFailure, results[0]);
+  EXPECT_EQ(tf2::TransformFailure, results[1]);
+
+  // The history refills as before, and failed requests are gone
+  setFrameChainTestTransform(buffer, "root", "a", 1, 1.0, 0.0);
+  setFrameChainTestTransform(buffer, "root", "a", 2, 2.0, 0.0);
+  EXPECT_TRUE(buffer.canTransform("root", "a", tf2::timeFromSec(1.5)));
+  EXPECT_EQ(2u, results.size());
+}
+
+TEST(tf2_retention, Retention_Policy)
+{
+  tf2::BufferCore buffer(tf2::Duration(std::chrono::seconds(100)));
+  tf2::RetentionPolicy policy;
+  policy.max_samples = 5;
+  EXPECT_FALSE(buffer.setRetentionPolicy("", policy));
+  EXPECT_FALSE(buffer.setRetentionPolicy("/", policy));
+
+  // A policy set before the frame exists applies once it is published
+  EXPECT_TRUE(buffer.setRetentionPolicy("a", policy));
+  for (int32_t sec = 1; sec <= 20; ++sec) {
+    setFrameChainTestTransform(buffer, "root", "a", sec, sec, 0.0);
+    setFrameChainTestTransform(buffer, "root", "b", sec, sec, 0.0);
+  }
+  setFrameChainTestTransform(buffer, "root", "fixed", 0, 1.0, 0.0, true);
+  EXPECT_FALSE(buffer.canTransform("root", "a", tf2::TimePoint(std::chrono::seconds(15))));
+  EXPECT_TRUE(buffer.canTransform("root", "a", tf2::TimePoint(std::chrono::seconds(16))));
+  EXPECT_TRUE(buffer.canTransform("root", "b", tf2::TimePoint(std::chrono::seconds(1))));
+
+  tf2::BufferCoreStats stats = buffer.getStats();
+  EXPECT_EQ(stats.frame_count, 3u);
+  EXPECT_EQ(stats.sample_count, 25u);
+  EXPECT_EQ(stats.sample_bytes, 25 * sizeof(tf2::TransformStorage));
+  EXPECT_GE(stats.reserved_bytes, stats.sample_bytes);
+  EXPECT_EQ(stats.memory_budget, 0u);
+  EXPECT_EQ(stats.evicted_samples, 0u);
+
+  // And so does one set on an existing frame
+  EXPECT_TRUE(buffer.setRetentionPolicy("/b", policy));
+  EXPECT_FALSE(buffer.canTransform("root", "b", tf2::TimePoint(std::chrono::seconds(15))));
+  EXPECT_EQ(buffer.getStats().sample_count, 10u);
+
+  buffer.clear();
+  EXPECT_EQ(buffer.getStats().sample_count, 0u);
+}
+
+TEST(tf2_retention, Memory_Budget)
+{
+  tf2::BufferCore buffer(tf2::Duration(std::chrono::seconds(100)));
+  for (int32_t sec = 1; sec <= 40; ++sec) {
+    setFrameChainTestTransform(buffer, "root", "fast", sec, sec, 0.0);
+    if (sec % 4 == 0) {
+      setFrameChainTestTransform(buffer, "root", "slow", sec, sec, 0.0);
+    }
+  }
+  EXPECT_EQ(buffer.getStats().sample_count, 50u);
+
+  // The longest history is trimmed first
+  buffer.setMemoryBudget(30 * sizeof(tf2::TransformStorage));
+  tf2::BufferCoreStats stats = buffer.getStats();
+  EXPECT_EQ(stats.sample_count, 30u);
+  EXPECT_EQ(stats.memory_budget, 30 * sizeof(tf2::TransformStorage));
+  EXPECT_EQ(stats.evicted_samples, 20u);
+  EXPECT_TRUE(buffer.canTransform("root", "slow", tf2::TimePoint(std::chrono::seconds(4))));
+  EXPECT_FALSE(buffer.canTransform("root", "fast", tf2::TimePoint(std::chrono::seconds(20))));
+  EXPECT_TRUE(buffer.canTransform("root", "fast", tf2::TimePoint(std::chrono::seconds(21))));
+
+  // New data keeps the buffer within the budget, until the histories are even
+  for (int32_t sec = 41; sec <= 60; ++sec) {
+    setFrameChainTestTransform(buffer, "root", "fast", sec, sec, 0.0);
+  }
+  stats = buffer.getStats();
+  EXPECT_EQ(stats.sample_count, 30u);
+  EXPECT_EQ(stats.evicted_samples, 40u);
+  EXPECT_FALSE(buffer.canTransform("root", "fast", tf2::TimePoint(std::chrono::seconds(40))));
+
+  // The newest sample of each frame is always kept
+  buffer.setMemoryBudget(1);
+  EXPECT_EQ(buffer.getStats().sample_count, 2u);
+  EXPECT_TRUE(buffer.canTransform("root", "fast", tf2::TimePointZero));
+  EXPECT_TRUE(buffer.canTransform("root", "slow", tf2::TimePointZero));
+}
+
+TEST(tf2_retention, Memory_Stats)
+{
+  tf2::BufferCore buffer(tf2::Duration(std::chrono::seconds(100)));
+  for (int32_t sec = 1; sec <= 20; ++sec) {
+    setFrameChainTestTransform(buffer, "root", "a", sec, sec, 0.0);
+  }
+  setFrameChainTestTransform(buffer, "root", "fixed", 0, 1.0, 0.0, true);
+
+  tf2::BufferCoreMemoryStats stats = buffer.memoryStats();
+  size_t frame_bytes = 0;
+  for (const tf2::FrameGraphEntry & frame : buffer.getFrameGraph()) {
+    if (frame.allocated) {
+      EXPECT_GT(frame.memory_bytes, 0u) << frame.frame_id;
+    }
+    frame_bytes += frame.memory_bytes;
+  }
+  EXPECT_EQ(stats.frame_history_bytes, frame_bytes);
+  EXPECT_GE(stats.frame_history_bytes, buffer.getStats().reserved_bytes);
+  EXPECT_GE(stats.frame_history_bytes, 20 * sizeof(tf2::TransformStorage));
+  EXPECT_GT(stats.frame_table_bytes, 0u);
+  EXPECT_EQ(
+    stats.total(),
+    stats.frame_history_bytes + stats.frame_table_bytes + stats.transformable_request_bytes +
+    stats.callback_bytes + stats.lookup_cache_bytes);
+  EXPECT_NE(std::string::npos, buffer.allFramesAsYAML().find("memory_bytes: "));
+
+  // Pending requests, their callbacks and frame subscriptions are accounted for too
+  auto cb =
+    [](tf2::TransformableRequestHandle, const std::string &, const std::string &, tf2::TimePoint,
+    tf2::TransformableResult) {};
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_NE(
+      0u, buffer.addTransformableRequest(
+        cb, "root", "missing" + std::to_string(i), tf2::timeFromSec(1.0)));
+  }
+  ASSERT_NE(
+    0u, buffer.subscribeFrame(
+      "a", [](tf2::FrameSubscriptionHandle, const geometry_msgs::msg::TransformStamped &) {}));
+  tf2::BufferCoreMemoryStats busy = buffer.memoryStats();
+  EXPECT_GT(busy.transformable_request_bytes, stats.transformable_request_bytes);
+  EXPECT_GT(busy.callback_bytes, stats.callback_bytes);
+  EXPECT_EQ(busy.frame_history_bytes, stats.frame_history_bytes);
+
+  buffer.setLookupCacheCapacity(64);
+  EXPECT_GT(buffer.memoryStats().lookup_cache_bytes, busy.lookup_cache_bytes);
+}
+
+TEST(tf2_insert_errors, Counted_By_Frame_Authority_And_Reason)
+{
+  tf2::BufferCore buffer(tf2::Duration(std::chrono::seconds(10)));
+  buffer.setInsertErrorLogPeriod(std::chrono::hours(1));
+  setFrameChainTestTransform(buffer, "root", "a", 20, 1.0, 0.0);
+
+  geometry_msgs::msg::TransformStamped good;
+  good.header.frame_id = "root";
+  good.header.stamp.sec = 21;
+  good.child_frame_id = "a";
+  good.transform.rotation.w = 1.0;
+  std::vector<geometry_msgs::msg::TransformStamped> batch(7, good);
+  batch[1].transform.translation.y = std::nan("");
+  batch[2].transform.rotation.w = 0.0;
+  batch[3].child_frame_id = "root";
+  batch[4].header.frame_id = "";
+  batch[5].header.stamp.sec = 1;
+  batch[6].child_frame_id = "b";
+  batch[6].transform.translation.z = std::nan("");
+  EXPECT_FALSE(buffer.setTransforms(batch, "authority1"));
+  EXPECT_TRUE(buffer.canTransform("root", "a", tf2::timeFromSec(21)));
+  EXPECT_FALSE(buffer.setTransform(batch[1], "authority2"));
+
+  std::vector<tf2::InsertErrorCount> errors = buffer.getInsertErrors();
+  ASSERT_EQ(7u, errors.size());
+  const struct
+  {
+    const char * child_frame_id;
+    const char * authority;
+    tf2::InsertError error;
+  } expected[] = {
+    {"a", "authority1", tf2::InsertError::NoFrameId},
+    // A zero quaternion turns into a rotation of nans
+    {"a", "authority1", tf2::InsertError::NanInput},
+    {"a", "authority1", tf2::InsertError::DenormalizedQuaternion},
+    {"a", "authority1", tf2::InsertError::OldData},
+    {"a", "authority2", tf2::InsertError::NanInput},
+    {"b", "authority1", tf2::InsertError::NanInput},
+    {"root", "authority1", tf2::InsertError::SelfTransform},
+  };
+  for (size_t i = 0; i < errors.size(); ++i) {
+    EXPECT_EQ(expected[i].child_frame_id, errors[i].child_frame_id) << i;
+    EXPECT_EQ(expected[i].authority, errors[i].authority) << i;
+    EXPECT_EQ(expected[i].error, errors[i].error) << i;
+  }
+  EXPECT_EQ(2u, errors[1].count);
+  EXPECT_EQ(1u, errors[2].count);
+
+  // Rejections are only counted, the buffer is left alone
+  batch.assign(100, batch[1]);
+  EXPECT_FALSE(buffer.setTransforms(batch, "authority1"));
+  EXPECT_EQ(102u, buffer.getInsertErrors()[1].count);
+}
+
+TEST(tf2_frame_graph, Frame_Graph)
+{
+  tf2::BufferCore buffer(tf2::Duration(std::chrono::seconds(100)));
+  EXPECT_TRUE(buffer.getFrameGraph().empty());
+
+  for (int32_t sec = 1; sec <= 3; ++sec) {
+    setFrameChainTestTransform(buffer, "root", "a", sec, sec, 0.0);
+  }
+  setFrameChainTestTransform(buffer, "a", "fixed", 0, 1.0, 0.0, true);
+
+  std::vector<tf2::FrameGraphEntry> frames = buffer.getFrameGraph();
+  ASSERT_EQ(frames.size(), 3u);
+  // A child frame gets its id before the parent it introduces
+  EXPECT_EQ(frames[0].frame_id, "a");
+  EXPECT_TRUE(frames[0].allocated);
+  EXPECT_FALSE(frames[0].is_static);
+  EXPECT_EQ(frames[0].parent, "root");
+  EXPECT_EQ(frames[0].authority, "authority1");
+  EXPECT_EQ(frames[0].oldest, tf2::TimePoint(std::chrono::seconds(1)));
+  EXPECT_EQ(frames[0].latest, tf2::TimePoint(std::chrono::seconds(3)));
+  EXPECT_EQ(frames[0].sample_count, 3u);
+  EXPECT_EQ(frames[1].frame_id, "root");
+  EXPECT_FALSE(frames[1].allocated);
+  EXPECT_EQ(frames[2].frame_id, "fixed");
+  EXPECT_TRUE(frames[2].is_static);
+  EXPECT_EQ(frames[2].parent, "a");
+
+  EXPECT_EQ(
+    buffer.allFramesAsString(),
+    "Frame a exists with parent root.\nFrame fixed exists with parent a.\n");
+
+  // Cleared frames are still listed, without a parent
+  buffer.clear();
+  frames = buffer.getFrameGraph();
+  EXPECT_TRUE(frames[0].allocated);
+  EXPECT_TRUE(frames[0].parent.empty());
+  EXPECT_EQ(frames[0].sample_count, 0u);
+}
+
+TEST(tf2_metrics, Metrics)
+{
+  tf2::BufferCore buffer(tf2::Duration(std::chrono::seconds(100)));
+  setFrameChainTestTransform(buffer, "root", "a", 1, 1.0, 0.0);
+
+  // Nothing is recorded until metrics are enabled
+  buffer.lookupTransform("root", "a", tf2::TimePointZero);
+  tf2::BufferCoreMetrics metrics = buffer.getMetrics();
+  EXPECT_EQ(metrics.lookup.calls, 0u);
+  EXPECT_EQ(metrics.insert.calls, 0u);
+  EXPECT_EQ(metrics.history_lengths.at("a"), 1u);
+
+  buffer.setMetricsEnabled(true);
+  for (int32_t sec = 2; sec <= 5; ++sec) {
+    setFrameChainTestTransform(buffer, "root", "a", sec, sec, 0.0);
+  }
+  setFrameChainTestTransform(buffer, "root", "fixed", 0, 1.0, 0.0, true);
+  geometry_msgs::msg::TransformStamped self;
+  self.header.frame_id = self.child_frame_id = "a";
+  self.transform.rotation.w = 1.0;
+  EXPECT_FALSE(buffer.setTransform(self, "authority1"));
+  buffer.lookupTransform("root", "a", tf2::TimePoint(std::chrono::seconds(3)));
+  buffer.lookupTransform(
+    "root", tf2::TimePoint(std::chrono::seconds(3)), "a", tf2::TimePoint(std::chrono::seconds(4)),
+    "fixed");
+  EXPECT_THROW(
+    buffer.lookupTransform("root", "a", tf2::TimePoint(std::chrono::seconds(10))),
+    tf2::ExtrapolationException);
+  EXPECT_THROW(
+    buffer.lookupTransform("root", "missing", tf2::TimePointZero), tf2::LookupException);
+  EXPECT_THROW(
+    buffer.lookupTransform("root", "", tf2::TimePointZero), tf2::InvalidArgumentException);
+  EXPECT_TRUE(buffer.canTransform("root", "a", tf2::TimePointZero));
+  EXPECT_FALSE(buffer.canTransform("root", "missing", tf2::TimePointZero));
+  tf2::TransformableRequestHandle handle = buffer.addTransformableRequest(
+    [](tf2::TransformableRequestHandle, const std::string &, const std::string &,
+    tf2::TimePoint, tf2::TransformableResult) {}, "root", "a",
+    tf2::TimePoint(std::chrono::seconds(20)));
+  EXPECT_NE(handle, 0u);
+
+  metrics = buffer.getMetrics();
+  // The fixed frame lookup is counted once, not once per half
+  EXPECT_EQ(metrics.lookup.calls, 5u);
+  EXPECT_EQ(metrics.lookup.failureCount(), 3u);
+  EXPECT_EQ(
+    metrics.lookup.failures[static_cast<size_t>(tf2::TF2Error::EXTRAPOLATION_ERROR)], 1u);
+  EXPECT_EQ(metrics.lookup.failures[static_cast<size_t>(tf2::TF2Error::LOOKUP_ERROR)], 1u);
+  EXPECT_EQ(
+    metrics.lookup.failures[static_cast<size_t>(tf2::TF2Error::INVALID_ARGUMENT_ERROR)], 1u);
+  EXPECT_EQ(metrics.lookup.latency.count(), 5u);
+  EXPECT_GE(metrics.lookup.latency.percentileNs(0.5), 1u);
+  EXPECT_EQ(metrics.can_transform.calls, 2u);
+  EXPECT_EQ(metrics.can_transform.failureCount(), 1u);
+  EXPECT_EQ(metrics.insert.calls, 6u);
+  EXPECT_EQ(
+    metrics.insert.failures[static_cast<size_t>(tf2::TF2Error::INVALID_ARGUMENT_ERROR)], 1u);
+  // The rejected self transform never gets to take the lock, and new samples of "a" only take
+  // it shared, leaving the new static frame
+  EXPECT_EQ(metrics.exclusive_lock_count, 1u);
+  EXPECT_EQ(metrics.pending_transformable_requests, 1u);
+  EXPECT_EQ(metrics.history_lengths.size(), 1u);
+  EXPECT_EQ(metrics.history_lengths.at("a"), 5u);
+
+  // Disabling keeps the counts, resetting clears them
+  buffer.setMetricsEnabled(false);
+  buffer.lookupTransform("root", "a", tf2::TimePointZero);
+  EXPECT_EQ(buffer.getMetrics().lookup.calls, 5u);
+  buffer.resetMetrics();
+  buffer.cancelTransformableRequest(handle);
+  metrics = buffer.getMetrics();
+  EXPECT_EQ(metrics.lookup.calls, 0u);
+  EXPECT_EQ(metrics.lookup.latency.count(), 0u);
+  EXPECT_EQ(metrics.insert.failureCount(), 0u);
+  EXPECT_EQ(metrics.exclusive_lock_count, 0u);
+  EXPECT_EQ(metrics.pending_transformable_requests, 0u);
+}
+
+TEST(tf2_retention, Compressed_History)
+{
+  tf2::BufferCore buffer(tf2::Duration(std::chrono::seconds(100)));
+  tf2::BufferCore reference(tf2::Duration(std::chrono::seconds(100)));
+  tf2::RetentionPolicy policy;
+  policy.compress = true;
+  buffer.setDefaultRetentionPolicy(policy);
+  for (int32_t sec = 1; sec <= 50; ++sec) {
+    for (tf2::BufferCore * b : {&buffer, &reference}) {
+      setFrameChainTestTransform(*b, "root", "a", sec, 0.1 * sec, 0.01 * sec);
+      setFrameChainTestTransform(*b, "a", "b", sec, 1.0, -0.02 * sec);
+    }
+  }
+  EXPECT_LT(buffer.getStats().reserved_bytes * 2, reference.getStats().reserved_bytes);
+
+  for (double t = 1.0; t <= 50.0; t += 0.3) {
+    tf2::TimePoint time = tf2::TimePoint(std::chrono::nanoseconds(static_cast<int64_t>(t * 1e9)));
+    geometry_msgs::msg::TransformStamped expected = reference.lookupTransform("root", "b", time);
+    geometry_msgs::msg::TransformStamped actual = buffer.lookupTransform("root", "b", time);
+    EXPECT_NEAR(expected.transform.translation.x, actual.transform.translation.x, 1e-4);
+    EXPECT_NEAR(expected.transform.translation.y, actual.transform.translation.y, 1e-4);
+    EXPECT_NEAR(expected.transform.rotation.z, actual.transform.rotation.z, 1e-4);
+    EXPECT_NEAR(expected.transform.rotation.w, actual.transform.rotation.w, 1e-4);
+  }
+
+  // A frame with its own policy keeps its full precision history
+  EXPECT_TRUE(buffer.setRetentionPolicy("c", tf2::RetentionPolicy()));
+  setFrameChainTestTransform(buffer, "root", "c", 1, 0.123456789, 0.0);
+  EXPECT_EQ(buffer.lookupTransform("root", "c", tf2::TimePointZero).transform.translation.x,
+    0.123456789);
+}
+
+TEST(tf2_retention, Single_Precision_History)
+{
+  tf2::BufferCore buffer(tf2::Duration(std::chrono::seconds(100)));
+  tf2::BufferCore reference(tf2::Duration(std::chrono::seconds(100)));
+  tf2::RetentionPolicy policy;
+  policy.single_precision = true;
+  buffer.setDefaultRetentionPolicy(policy);
+  for (int32_t sec = 1; sec <= 50; ++sec) {
+    for (tf2::BufferCore * b : {&buffer, &reference}) {
+      setFrameChainTestTransform(*b, "root", "a", sec, 0.1 * sec, 0.01 * sec);
+      setFrameChainTestTransform(*b, "a", "b", sec, 1.0, -0.02 * sec);
+    }
+  }
+  EXPECT_LT(buffer.getStats().reserved_bytes, reference.getStats().reserved_bytes);
+
+  for (double t = 1.0; t <= 50.0; t += 0.3) {
+    tf2::TimePoint time = tf2::TimePoint(std::chrono::nanoseconds(static_cast<int64_t>(t * 1e9)));
+    geometry_msgs::msg::TransformStamped expected = reference.lookupTransform("root", "b", time);
+    geometry_msgs::msg::TransformStamped actual = buffer.lookupTransform("root", "b", time);
+    EXPECT_NEAR(expected.transform.translation.x, actual.transform.translation.x, 1e-6);
+    EXPECT_NEAR(expected.transform.translation.y, actual.transform.translation.y, 1e-6);
+    EXPECT_NEAR(expected.transform.rotation.z, actual.transform.rotation.z, 1e-6);
+    EXPECT_NEAR(expected.transform.rotation.w, actual.transform.rotation.w, 1e-6);
+  }
+}
+
+TEST(tf2_retention, Single_Writer_History)
+{
+  tf2::BufferCore buffer(tf2::Duration(std::chrono::seconds(100)));
+  tf2::BufferCore reference(tf2::Duration(std::chrono::seconds(100)));
+  tf2::RetentionPolicy policy;
+  policy.single_writer = true;
+  EXPECT_TRUE(buffer.setRetentionPolicy("a", policy));
+  for (int32_t sec = 1; sec <= 50; ++sec) {
+    for (tf2::BufferCore * b : {&buffer, &reference}) {
+      setFrameChainTestTransform(*b, "root", "a", sec, 0.1 * sec, 0.01 * sec);
+      setFrameChainTestTransform(*b, "a", "b", sec, 1.0, -0.02 * sec);
+    }
+  }
+  EXPECT_EQ(buffer.getStats().sample_count, reference.getStats().sample_count);
+
+  for (double t = 1.0; t <= 50.0; t += 0.3) {
+    tf2::TimePoint time = tf2::TimePoint(std::chrono::nanoseconds(static_cast<int64_t>(t * 1e9)));
+    geometry_msgs::msg::TransformStamped expected = reference.lookupTransform("root", "b", time);
+    geometry_msgs::msg::TransformStamped actual = buffer.lookupTransform("root", "b", time);
+    expectSameTransform(expected, actual);
+  }
+}
+
+TEST(tf2_retention, Bounded_Extrapolation)
+{
+  tf2::BufferCore buffer;
+  setFrameChainTestTransform(buffer, "root", "a", 1, 1.0, 0.0);
+  setFrameChainTestTransform(buffer, "root", "a", 2, 2.0, 0.0);
+  tf2::TimePoint ahead = tf2::timeFromSec(2.4);
+  EXPECT_FALSE(buffer.canTransform("root", "a", ahead));
+
+  int fired = 0;
+  auto cb =
+    [&fired](
+    tf2::TransformableRequestHandle, const std::string &, const std::string &,
+    tf2::TimePoint, tf2::TransformableResult result)
+    {
+      EXPECT_EQ(tf2::TransformAvailable, result);
+      ++fired;
+    };
+  ASSERT_NE(0u, buffer.addTransformableRequest(cb, "root", "a", tf2::timeFromSec(3.2)));
+
+  tf2::RetentionPolicy policy;
+  policy.max_extrapolation = std::chrono::milliseconds(500);
+  buffer.setDefaultRetentionPolicy(policy);
+  geometry_msgs::msg::TransformStamped out = buffer.lookupTransform("root", "a", ahead);
+  EXPECT_NEAR(out.transform.translation.x, 2.4, 1e-9);
+  EXPECT_FALSE(buffer.canTransform("root", "a", tf2::timeFromSec(2.6)));
+
+  // The pending request is satisfied by a sample it may be extrapolated from
+  setFrameChainTestTransform(buffer, "root", "a", 3, 3.0, 0.0);
+  EXPECT_EQ(1, fired);
+}
+
+TEST(tf2_snapshot, Save_And_Load)
+{
+  const std::string path = testing::TempDir() + "tf2_snapshot_test.bin";
+  tf2::BufferCore buffer(tf2::Duration(std::chrono::seconds(100)));
+  for (int32_t sec = 1; sec <= 20; ++sec) {
+    setFrameChainTestTransform(buffer, "root", "a", sec, 0.1 * sec, 0.01 * sec);
+    // Reparented half way
+    setFrameChainTestTransform(buffer, sec <= 10 ? "a" : "root", "b", sec, 1.0, -0.02 * sec);
+  }
+  setFrameChainTestTransform(buffer, "b", "sensor", 0, 0.5, 0.3, true);
+  ASSERT_TRUE(buffer.saveSnapshot(path));
+
+  tf2::BufferCore loaded(tf2::Duration(std::chrono::seconds(100)));
+  ASSERT_TRUE(loaded.loadSnapshot(path));
+  EXPECT_EQ(loaded.getStats().sample_count, buffer.getStats().sample_count);
+  EXPECT_EQ(loaded.allFramesAsYAML(tf2::TimePointZero), buffer.allFramesAsYAML(tf2::TimePointZero));
+  for (double t = 1.0; t <= 20.0; t += 0.25) {
+    tf2::TimePoint time = tf2::TimePoint(std::chrono::nanoseconds(static_cast<int64_t>(t * 1e9)));
+    expectSameTransform(
+      buffer.lookupTransform("root", "sensor", time),
+      loaded.lookupTransform("root", "sensor", time));
+  }
+  EXPECT_TRUE(loaded._frameExists("sensor"));
+
+  // Corrupt files are rejected without touching the buffer
+  {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(0);
+    file.put('X');
+  }
+  tf2::BufferCore empty;
+  EXPECT_FALSE(empty.loadSnapshot(path));
+  EXPECT_FALSE(empty.loadSnapshot(path + ".missing"));
+  EXPECT_TRUE(empty.getAllFrameNames().empty());
+  std::remove(path.c_str());
+}
+
+TEST(tf2_bulkLoad, Matches_Set_Transform)
+{
+  std::vector<geometry_msgs::msg::TransformStamped> transforms;
+  for (int32_t sec = 1; sec <= 40; ++sec) {
+    geometry_msgs::msg::TransformStamped st;
+    st.header.stamp.sec = sec;
+    st.transform.rotation.z = std::sin(0.01 * sec);
+    st.transform.rotation.w = std::cos(0.01 * sec);
+    st.header.frame_id = "/root";
+    st.child_frame_id = "a";
+    st.transform.translation.x = 0.1 * sec;
+    transforms.push_back(st);
+    // Reparented half way
+    st.header.frame_id = sec <= 30 ? "a" : "root";
+    st.child_frame_id = "b";
+    st.transform.translation.x = 1.0;
+    transforms.push_back(st);
+  }
+
+  tf2::BufferCore buffer;
+  for (const auto & transform : transforms) {
+    EXPECT_TRUE(buffer.setTransform(transform, "authority1"));
+  }
+
+  tf2::BufferCore loaded;
+  int callback_count = 0;
+  loaded.addTransformableRequest(
+    [&callback_count](
+      tf2::TransformableRequestHandle, const std::string &, const std::string &,
+      tf2::TimePoint, tf2::TransformableResult result)
+    {
+      EXPECT_EQ(tf2::TransformAvailable, result);
+      ++callback_count;
+    }, "root", "b", tf2::timeFromSec(35.0));
+  // Loaded in two chunks, the first one longer than the history kept
+  const size_t half = transforms.size() / 2;
+  EXPECT_TRUE(
+    loaded.loadTransforms({transforms.begin(), transforms.begin() + half}, "authority1"));
+  EXPECT_EQ(0, callback_count);
+  EXPECT_TRUE(loaded.loadTransforms({transforms.begin() + half, transforms.end()}, "authority1"));
+  EXPECT_EQ(1, callback_count);
+
+  EXPECT_EQ(buffer.getStats().sample_count, loaded.getStats().sample_count);
+  EXPECT_EQ(loaded.allFramesAsYAML(tf2::TimePointZero), buffer.allFramesAsYAML(tf2::TimePointZero));
+  for (double t = 30.0; t <= 40.0; t += 0.25) {
+    tf2::TimePoint time = tf2::timeFromSec(t);
+    expectSameTransform(
+      buffer.lookupTransform("root", "b", time), loaded.lookupTransform("root", "b", time));
+  }
+  EXPECT_THROW(
+    loaded.lookupTransform("root", "b", tf2::timeFromSec(29.5)), tf2::ExtrapolationException);
+
+  // Invalid and too old transforms are reported, the valid ones are still loaded
+  transforms.resize(2);
+  transforms[1].header.stamp.sec = 41;
+  transforms[1].child_frame_id = "";
+  EXPECT_FALSE(loaded.loadTransforms(transforms, "authority1"));
+  transforms[1].child_frame_id = "b";
+  transforms[1].header.frame_id = "root";
+  EXPECT_FALSE(loaded.loadTransforms(transforms, "authority1"));
+  EXPECT_TRUE(loaded.canTransform("root", "b", tf2::timeFromSec(41.0)));
+}
+
+TEST(tf2_concurrency, Lookups_While_Inserting)
+{
+  tf2::BufferCore tfc;
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "foo";
+  st.header.stamp.sec = 1;
+  st.child_frame_id = "bar";
+  st.transform.translation.x = 1;
+  st.transform.rotation.w = 1;
+  ASSERT_TRUE(tfc.setTransform(st, "authority1"));
+
+  std::atomic<bool> done(false);
+  std::atomic<int> failures(0);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back(
+      [&tfc, &done, &failures]() {
+        while (!done) {
+          try {
+            auto trans = tfc.lookupTransform("foo", "bar", tf2::TimePointZero);
+            if (trans.transform.translation.x != 1.0) {
+              ++failures;
+            }
+          } catch (const tf2::TransformException &) {
+            ++failures;
+          }
+          if (!tfc.canTransform("foo", "bar", tf2::TimePointZero)) {
+            ++failures;
+          }
+        }
+      });
+  }
+
+  for (uint32_t i = 1; i < 1000; ++i) {
+    st.header.stamp.nanosec = i * 1000;
+    EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+  }
+  done = true;
+  for (auto & reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(failures, 0);
+}
+
+TEST(tf2_concurrency, Chain_Lookups_While_Inserting)
+{
+  tf2::BufferCore tfc;
+  std::vector<geometry_msgs::msg::TransformStamped> transforms(2);
+  transforms[0].header.frame_id = "foo";
+  transforms[0].header.stamp.sec = 1;
+  transforms[0].child_frame_id = "bar";
+  transforms[0].transform.translation.x = 1;
+  transforms[0].transform.rotation.w = 1;
+  transforms[1] = transforms[0];
+  transforms[1].header.frame_id = "bar";
+  transforms[1].child_frame_id = "baz";
+  transforms[1].transform.translation.x = 2;
+  ASSERT_TRUE(tfc.setTransforms(transforms, "authority1"));
+  tf2::FrameChainHandle chain = tfc.getFrameChain("foo", "baz");
+
+  std::atomic<bool> done(false);
+  std::atomic<int> failures(0);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back(
+      [&tfc, &chain, &done, &failures]() {
+        while (!done) {
+          try {
+            auto trans = tfc.lookupTransform(chain, tf2::TimePointZero);
+            if (std::abs(trans.transform.translation.x - 3.0) > 1e-9) {
+              ++failures;
+            }
+          } catch (const tf2::TransformException &) {
+            ++failures;
+          }
+          if (!tfc.canTransform(chain, tf2::TimePointZero)) {
+            ++failures;
+          }
+        }
+      });
+  }
+
+  // Alternate between inserting both frames at once and one after the other
+  for (uint32_t i = 1; i < 1000; ++i) {
+    transforms[0].header.stamp.nanosec = transforms[1].header.stamp.nanosec = i * 1000;
+    if (i % 2) {
+      EXPECT_TRUE(tfc.setTransforms(transforms, "authority1"));
+    } else {
+      EXPECT_TRUE(tfc.setTransform(transforms[0], "authority1"));
+      EXPECT_TRUE(tfc.setTransform(transforms[1], "authority1"));
+    }
+  }
+  done = true;
+  for (auto & reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(failures, 0);
+}
+
+TEST(tf2_concurrency, Independent_Frames_From_Several_Writers)
+{
+  tf2::BufferCore tfc;
+  const int num_writers = 4;
+  for (int i = 0; i < num_writers; ++i) {
+    setFrameChainTestTransform(tfc, "root", "frame" + std::to_string(i), 1, i, 0);
+  }
+
+  std::atomic<bool> done(false);
+  std::atomic<int> failures(0);
+  std::thread reader(
+    [&tfc, &done, &failures]() {
+      while (!done) {
+        try {
+          auto trans = tfc.lookupTransform("frame0", "frame1", tf2::TimePointZero);
+          if (std::abs(trans.transform.translation.x - 1.0) > 1e-9) {
+            ++failures;
+          }
+        } catch (const tf2::TransformException &) {
+          ++failures;
+        }
+      }
+    });
+
+  // Each writer only adds samples to its own frame, so none of them needs the exclusive lock
+  std::vector<std::thread> writers;
+  for (int i = 0; i < num_writers; ++i) {
+    writers.emplace_back(
+      [&tfc, &failures, i]() {
+        geometry_msgs::msg::TransformStamped st;
+        st.header.frame_id = "root";
+        st.header.stamp.sec = 1;
+        st.child_frame_id = "frame" + std::to_string(i);
+        st.transform.translation.x = i;
+        st.transform.rotation.w = 1;
+        for (uint32_t j = 1; j < 1000; ++j) {
+          st.header.stamp.nanosec = j * 1000;
+          if (!tfc.setTransform(st, "authority1")) {
+            ++failures;
+          }
+        }
+      });
+  }
+  for (auto & writer : writers) {
+    writer.join();
+  }
+  done = true;
+  reader.join();
+  EXPECT_EQ(failures, 0);
+
+  EXPECT_EQ(tfc.getStats().sample_count, static_cast<size_t>(num_writers * 1000));
+  for (int i = 0; i < num_writers; ++i) {
+    tf2::TimePoint latest;
+    std::string error;
+    EXPECT_EQ(
+      tfc._getLatestCommonTime(
+        tfc._lookupFrameNumber("root"), tfc._lookupFrameNumber("frame" + std::to_string(i)),
+        latest, &error),
+      tf2::TF2Error::NO_ERROR);
+    EXPECT_EQ(latest, tf2::TimePoint(std::chrono::seconds(1) + std::chrono::microseconds(999)));
+  }
+}
+
 TEST(tf2_time, Display_Time_Point)
 {
   tf2::TimePoint t = tf2::get_now();
@@ -26,12 +26,27 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <chrono>
+#include <sstream>
 #include <string>
 
 #include "console_bridge/console.h"
 #include "tf2/buffer_core.h"
 #include "geometry_msgs/msg/transform_stamped.hpp"
 
+namespace
+{
+
+builtin_interfaces::msg::Time stamp(uint32_t sec)
+{
+  builtin_interfaces::msg::Time time;
+  time.sec = static_cast<int32_t>(sec);
+  time.nanosec = 0;
+  return time;
+}
+
+}  // namespace
+
 int main(int argc, char ** argv)
 {
   uint32_t num_levels = 10;
@@ -41,13 +56,13 @@ int main(int argc, char ** argv)
 
   tf2::BufferCore bc;
   geometry_msgs::msg::TransformStamped t;
-  t.header.stamp = builtin_interfaces::msg::Time(1);
+  t.header.stamp = stamp(1);
   t.header.frame_id = "root";
   t.child_frame_id = "0";
   t.transform.translation.x = 1;
   t.transform.rotation.w = 1.0;
   bc.setTransform(t, "me");
-  t.header.stamp = builtin_interfaces::msg::Time(2);
+  t.header.stamp = stamp(2);
   bc.setTransform(t, "me");
 
   for (uint32_t i = 1; i < num_levels / 2; ++i) {
@@ -57,7 +72,7 @@ int main(int argc, char ** argv)
       std::stringstream child_ss;
       child_ss << i;
 
-      t.header.stamp = builtin_interfaces::msg::Time(j);
+      t.header.stamp = stamp(j);
       t.header.frame_id = parent_ss.str();
       t.child_frame_id = child_ss.str();
       bc.setTransform(t, "me");
@@ -67,10 +82,10 @@ int main(int argc, char ** argv)
   t.header.frame_id = "root";
   std::stringstream ss;
   ss << num_levels / 2;
-  t.header.stamp = builtin_interfaces::msg::Time(1);
+  t.header.stamp = stamp(1);
   t.child_frame_id = ss.str();
   bc.setTransform(t, "me");
-  t.header.stamp = builtin_interfaces::msg::Time(2);
+  t.header.stamp = stamp(2);
   bc.setTransform(t, "me");
 
   for (uint32_t i = num_levels / 2 + 1; i < num_levels; ++i) {
@@ -80,7 +95,7 @@ int main(int argc, char ** argv)
       std::stringstream child_ss;
       child_ss << i;
 
-      t.header.stamp = builtin_interfaces::msg::Time(j);
+      t.header.stamp = stamp(j);
       t.header.frame_id = parent_ss.str();
       t.child_frame_id = child_ss.str();
       bc.setTransform(t, "me");
@@ -89,122 +104,122 @@ int main(int argc, char ** argv)
 
   std::string v_frame0 = std::to_string(num_levels - 1);
   std::string v_frame1 = std::to_string(num_levels / 2 - 1);
-  logInform("%s to %s", v_frame0.c_str(), v_frame1.c_str());
+  CONSOLE_BRIDGE_logInform("%s to %s", v_frame0.c_str(), v_frame1.c_str());
   geometry_msgs::msg::TransformStamped out_t;
 
   const uint32_t count = 1000000;
-  logInform("Doing %d %d-level tests", count, num_levels);
+  CONSOLE_BRIDGE_logInform("Doing %d %d-level tests", count, num_levels);
 
 #if 01
   {
-    ros::WallTime start = ros::WallTime::now();
+    auto start = std::chrono::steady_clock::now();
     for (uint32_t i = 0; i < count; ++i) {
       out_t = bc.lookupTransform(v_frame1, v_frame0, tf2::TimePoint());
     }
-    ros::WallTime end = ros::WallTime::now();
-    ros::WallDuration dur = end - start;
-    logInform(
-      "lookupTransform at Time(0) took %f for an average of %.9f", dur.toSec(),
-      dur.toSec() / static_cast<double>(count));
+    auto end = std::chrono::steady_clock::now();
+    double dur = std::chrono::duration<double>(end - start).count();
+    CONSOLE_BRIDGE_logInform(
+      "lookupTransform at Time(0) took %f for an average of %.9f", dur,
+      dur / static_cast<double>(count));
   }
 #endif
 
 #if 01
   {
-    ros::WallTime start = ros::WallTime::now();
+    auto start = std::chrono::steady_clock::now();
     for (uint32_t i = 0; i < count; ++i) {
       out_t = bc.lookupTransform(v_frame1, v_frame0, tf2::TimePoint(std::chrono::seconds(1)));
     }
-    ros::WallTime end = ros::WallTime::now();
-    ros::WallDuration dur = end - start;
-    logInform(
-      "lookupTransform at Time(1) took %f for an average of %.9f", dur.toSec(),
-      dur.toSec() / static_cast<double>(count));
+    auto end = std::chrono::steady_clock::now();
+    double dur = std::chrono::duration<double>(end - start).count();
+    CONSOLE_BRIDGE_logInform(
+      "lookupTransform at Time(1) took %f for an average of %.9f", dur,
+      dur / static_cast<double>(count));
   }
 #endif
 
 #if 01
   {
-    ros::WallTime start = ros::WallTime::now();
+    auto start = std::chrono::steady_clock::now();
     for (uint32_t i = 0; i < count; ++i) {
       out_t =
         bc.lookupTransform(v_frame1, v_frame0, tf2::TimePoint(std::chrono::milliseconds(1500)));
     }
-    ros::WallTime end = ros::WallTime::now();
-    ros::WallDuration dur = end - start;
-    logInform(
-      "lookupTransform at Time(1.5) took %f for an average of %.9f", dur.toSec(),
-      dur.toSec() / static_cast<double>(count));
+    auto end = std::chrono::steady_clock::now();
+    double dur = std::chrono::duration<double>(end - start).count();
+    CONSOLE_BRIDGE_logInform(
+      "lookupTransform at Time(1.5) took %f for an average of %.9f", dur,
+      dur / static_cast<double>(count));
   }
 #endif
 
 #if 01
   {
-    ros::WallTime start = ros::WallTime::now();
+    auto start = std::chrono::steady_clock::now();
     for (uint32_t i = 0; i < count; ++i) {
       out_t = bc.lookupTransform(v_frame1, v_frame0, tf2::TimePoint(std::chrono::seconds(2)));
     }
-    ros::WallTime end = ros::WallTime::now();
-    ros::WallDuration dur = end - start;
-    logInform(
-      "lookupTransform at Time(2) took %f for an average of %.9f", dur.toSec(),
-      dur.toSec() / static_cast<double>(count));
+    auto end = std::chrono::steady_clock::now();
+    double dur = std::chrono::duration<double>(end - start).count();
+    CONSOLE_BRIDGE_logInform(
+      "lookupTransform at Time(2) took %f for an average of %.9f", dur,
+      dur / static_cast<double>(count));
   }
 #endif
 
 #if 01
   {
-    ros::WallTime start = ros::WallTime::now();
+    auto start = std::chrono::steady_clock::now();
     for (uint32_t i = 0; i < count; ++i) {
       bc.canTransform(v_frame1, v_frame0, tf2::TimePoint());
     }
-    ros::WallTime end = ros::WallTime::now();
-    ros::WallDuration dur = end - start;
-    logInform(
-      "canTransform at Time(0) took %f for an average of %.9f", dur.toSec(),
-      dur.toSec() / static_cast<double>(count));
+    auto end = std::chrono::steady_clock::now();
+    double dur = std::chrono::duration<double>(end - start).count();
+    CONSOLE_BRIDGE_logInform(
+      "canTransform at Time(0) took %f for an average of %.9f", dur,
+      dur / static_cast<double>(count));
   }
 #endif
 
 #if 01
   {
-    ros::WallTime start = ros::WallTime::now();
+    auto start = std::chrono::steady_clock::now();
     for (uint32_t i = 0; i < count; ++i) {
       bc.canTransform(v_frame1, v_frame0, tf2::TimePoint(std::chrono::seconds(1)));
     }
-    ros::WallTime end = ros::WallTime::now();
-    ros::WallDuration dur = end - start;
-    logInform(
-      "canTransform at Time(1) took %f for an average of %.9f", dur.toSec(),
-      dur.toSec() / static_cast<double>(count));
+    auto end = std::chrono::steady_clock::now();
+    double dur = std::chrono::duration<double>(end - start).count();
+    CONSOLE_BRIDGE_logInform(
+      "canTransform at Time(1) took %f for an average of %.9f", dur,
+      dur / static_cast<double>(count));
   }
 #endif
 
 #if 01
   {
-    ros::WallTime start = ros::WallTime::now();
+    auto start = std::chrono::steady_clock::now();
     for (uint32_t i = 0; i < count; ++i) {
       bc.canTransform(v_frame1, v_frame0, tf2::TimePoint(std::chrono::milliseconds(1500)));
     }
-    ros::WallTime end = ros::WallTime::now();
-    ros::WallDuration dur = end - start;
-    logInform(
-      "canTransform at Time(1.5) took %f for an average of %.9f", dur.toSec(),
-      dur.toSec() / static_cast<double>(count));
+    auto end = std::chrono::steady_clock::now();
+    double dur = std::chrono::duration<double>(end - start).count();
+    CONSOLE_BRIDGE_logInform(
+      "canTransform at Time(1.5) took %f for an average of %.9f", dur,
+      dur / static_cast<double>(count));
   }
 #endif
 
 #if 01
   {
-    ros::WallTime start = ros::WallTime::now();
+    auto start = std::chrono::steady_clock::now();
     for (uint32_t i = 0; i < count; ++i) {
       bc.canTransform(v_frame1, v_frame0, tf2::TimePoint(std::chrono::seconds(2)));
     }
-    ros::WallTime end = ros::WallTime::now();
-    ros::WallDuration dur = end - start;
-    logInform(
-      "canTransform at Time(2) took %f for an average of %.9f", dur.toSec(),
-      dur.toSec() / static_cast<double>(count));
+    auto end = std::chrono::steady_clock::now();
+    double dur = std::chrono::duration<double>(end - start).count();
+    CONSOLE_BRIDGE_logInform(
+      "canTransform at Time(2) took %f for an average of %.9f", dur,
+      dur / static_cast<double>(count));
   }
 #endif
 }
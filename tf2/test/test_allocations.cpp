@@ -0,0 +1,286 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "tf2/buffer_core.h"
+#include "tf2/time.h"
+
+// Count every heap allocation made while g_counting is set
+namespace
+{
+std::atomic<bool> g_counting(false);
+std::atomic<size_t> g_allocations(0);
+
+template<typename F>
+size_t countAllocations(F f)
+{
+  g_allocations = 0;
+  g_counting = true;
+  f();
+  g_counting = false;
+  return g_allocations;
+}
+
+void setTestTransform(
+  tf2::BufferCore & buffer, const std::string & parent, const std::string & child,
+  int32_t sec, double x, bool is_static = false)
+{
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = parent;
+  st.header.stamp.sec = sec;
+  st.child_frame_id = child;
+  st.transform.translation.x = x;
+  st.transform.rotation.w = 1;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1", is_static));
+}
+}  // namespace
+
+void * operator new(std::size_t size)
+{
+  if (g_counting) {
+    ++g_allocations;
+  }
+  void * ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+// GCC cannot tell that operator new above uses malloc
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void * ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void * ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+// Frame names are kept short enough for the small string optimization, otherwise copying them
+// into the returned message allocates.
+TEST(tf2_allocations, Successful_Lookups)
+{
+  tf2::BufferCore buffer;
+  for (int32_t sec = 1; sec <= 3; ++sec) {
+    setTestTransform(buffer, "map", "odom", sec, 1.0 * sec);
+    setTestTransform(buffer, "odom", "base", sec, 2.0 * sec);
+    setTestTransform(buffer, "map", "gps", sec, 3.0 * sec);
+  }
+  setTestTransform(buffer, "base", "laser", 0, 0.5, true);
+
+  const tf2::TimePoint time = tf2::timeFromSec(1.5);
+  tf2::FrameHandle gps = buffer.resolveFrame("gps");
+  tf2::FrameHandle laser = buffer.resolveFrame("laser");
+  tf2::FrameChainHandle chain = buffer.getFrameChain("gps", "laser");
+  tf2::Transform transform;
+  tf2::TimePoint time_out;
+
+  auto lookups = [&]() {
+      buffer.lookupTransform("gps", "laser", time);
+      buffer.lookupTransform("gps", "laser", tf2::TimePointZero);
+      buffer.lookupTransform("laser", "laser", tf2::TimePointZero);
+      buffer.lookupTransform(gps, laser, time);
+      buffer.lookupTransform(gps, laser, tf2::TimePointZero);
+      buffer.lookupTransform(chain, time);
+      buffer.lookupTransform(chain, tf2::TimePointZero);
+      buffer.lookupTransform("gps", time, "laser", tf2::timeFromSec(2.5), "map");
+      buffer.lookupTransform("gps", "laser", time, transform, time_out);
+      buffer.lookupTransform(chain, tf2::TimePointZero, transform, time_out);
+    };
+  // The first lookup between two frames compiles and caches their chain
+  lookups();
+  EXPECT_EQ(0u, countAllocations(lookups));
+
+  EXPECT_EQ(
+    0u, countAllocations(
+      [&]() {
+        EXPECT_TRUE(buffer.canTransform("gps", "laser", time));
+        EXPECT_TRUE(buffer.canTransform("gps", "laser", tf2::TimePointZero));
+        EXPECT_TRUE(buffer.canTransform(gps, laser, tf2::TimePointZero));
+        EXPECT_TRUE(buffer.canTransform(chain, time));
+      }));
+}
+
+// Looking up into a tf2::Transform never copies the frame names
+TEST(tf2_allocations, Transform_Lookups_With_Long_Frame_Names)
+{
+  tf2::BufferCore buffer;
+  const std::string parent = "a_parent_frame_name_longer_than_the_small_string_buffer";
+  const std::string child = "a_child_frame_name_longer_than_the_small_string_buffer";
+  for (int32_t sec = 1; sec <= 3; ++sec) {
+    setTestTransform(buffer, parent, child, sec, 1.0 * sec);
+  }
+
+  const tf2::TimePoint time = tf2::timeFromSec(1.5);
+  tf2::Transform transform;
+  tf2::TimePoint time_out;
+  auto lookups = [&]() {
+      buffer.lookupTransform(parent, child, time, transform, time_out);
+      buffer.lookupTransform(child, parent, tf2::TimePointZero, transform, time_out);
+    };
+  lookups();
+  EXPECT_EQ(0u, countAllocations(lookups));
+}
+
+TEST(tf2_allocations, Lookup_Through_Frame_Without_Data_At_Time)
+{
+  tf2::BufferCore buffer;
+  // odom has no data at 1.5, but looking up base in odom does not need any
+  setTestTransform(buffer, "map", "odom", 5, 1.0);
+  setTestTransform(buffer, "odom", "base", 1, 1.0);
+  setTestTransform(buffer, "odom", "base", 2, 2.0);
+
+  const tf2::TimePoint time = tf2::timeFromSec(1.5);
+  EXPECT_EQ(
+    0u, countAllocations(
+      [&]() {
+        EXPECT_TRUE(buffer.canTransform("odom", "base", time));
+      }));
+
+  // The error message is still built when the lookup does fail
+  std::string error_msg;
+  EXPECT_FALSE(buffer.canTransform("map", "base", time, &error_msg));
+  EXPECT_NE(std::string::npos, error_msg.find("extrapolation"));
+}
+
+// Failed lookups that are not asked for a reason do not format one
+TEST(tf2_allocations, Failed_Try_Lookups)
+{
+  tf2::BufferCore buffer;
+  setTestTransform(buffer, "map", "odom", 1, 1.0);
+  setTestTransform(buffer, "odom", "base", 1, 1.0);
+  setTestTransform(buffer, "odom", "base", 2, 2.0);
+  setTestTransform(buffer, "world", "gps", 1, 1.0);
+  tf2::FrameChainHandle chain = buffer.getFrameChain("map", "base");
+
+  tf2::Transform transform;
+  tf2::TimePoint time_out;
+  auto lookups = [&]() {
+      EXPECT_EQ(
+        tf2::TF2Error::EXTRAPOLATION_ERROR,
+        buffer.tryLookupTransform("map", "base", tf2::timeFromSec(1.5), transform, time_out));
+      EXPECT_EQ(
+        tf2::TF2Error::EXTRAPOLATION_ERROR,
+        buffer.tryLookupTransform(chain, tf2::timeFromSec(5), transform, time_out));
+      EXPECT_EQ(
+        tf2::TF2Error::CONNECTIVITY_ERROR,
+        buffer.tryLookupTransform("map", "gps", tf2::TimePointZero, transform, time_out));
+      EXPECT_EQ(
+        tf2::TF2Error::LOOKUP_ERROR,
+        buffer.tryLookupTransform("map", "none", tf2::TimePointZero, transform, time_out));
+    };
+  // The first lookup between two frames compiles and caches their chain
+  lookups();
+  EXPECT_EQ(0u, countAllocations(lookups));
+}
+
+// Inserting into existing frames copies neither the frame names nor the authority, however long.
+// Only names with a leading slash are copied to strip it.
+TEST(tf2_allocations, Inserts_With_Long_Frame_Names)
+{
+  tf2::BufferCore buffer;
+  tf2::BufferCoreReservation reservation;
+  reservation.frames = 2;
+  reservation.samples_per_frame = 64;
+  buffer.reserve(reservation);
+
+  const std::string authority = "an_authority_name_longer_than_the_small_string_buffer";
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = "a_parent_frame_name_longer_than_the_small_string_buffer";
+  transform.child_frame_id = "a_child_frame_name_longer_than_the_small_string_buffer";
+  transform.transform.rotation.w = 1.0;
+  int32_t sec = 1;
+  auto inserts = [&]() {
+      for (int i = 0; i < 8; ++i, ++sec) {
+        transform.header.stamp.sec = sec;
+        EXPECT_TRUE(buffer.setTransform(transform, authority));
+      }
+    };
+  inserts();
+  EXPECT_EQ(0u, countAllocations(inserts));
+}
+
+// Within a reservation, a buffer that keeps receiving data and transformable requests does not
+// allocate once every frame exists
+TEST(tf2_allocations, Steady_State_Within_Reservation)
+{
+  tf2::BufferCore buffer;
+  tf2::BufferCoreReservation reservation;
+  reservation.frames = 4;
+  reservation.samples_per_frame = 64;
+  reservation.transformable_requests = 8;
+  buffer.reserve(reservation);
+
+  setTestTransform(buffer, "map", "odom", 1, 1.0);
+  setTestTransform(buffer, "odom", "base", 1, 1.0);
+  setTestTransform(buffer, "base", "laser", 0, 0.5, true);
+
+  size_t calls = 0;
+  auto callback = [&calls](
+    tf2::TransformableRequestHandle, const std::string &, const std::string &, tf2::TimePoint,
+    tf2::TransformableResult) {
+      ++calls;
+    };
+  int32_t sec = 2;
+  auto steady_state = [&]() {
+      for (int i = 0; i < 8; ++i, ++sec) {
+        // Satisfied by the next insert into base
+        buffer.addTransformableRequest(callback, "map", "laser", tf2::timeFromSec(sec));
+        tf2::TransformableRequestHandle cancelled =
+          buffer.addTransformableRequest(callback, "map", "laser", tf2::timeFromSec(sec + 100));
+        buffer.cancelTransformableRequest(cancelled);
+        setTestTransform(buffer, "map", "odom", sec, 1.0 * sec);
+        setTestTransform(buffer, "odom", "base", sec, 2.0 * sec);
+        buffer.lookupTransform("map", "laser", tf2::TimePointZero);
+      }
+    };
+  // The first lookup compiles the chain
+  steady_state();
+  const size_t reserved_bytes = buffer.getStats().reserved_bytes;
+  EXPECT_EQ(0u, countAllocations(steady_state));
+  EXPECT_EQ(16u, calls);
+  EXPECT_EQ(reserved_bytes, buffer.getStats().reserved_bytes);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
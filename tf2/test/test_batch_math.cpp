@@ -0,0 +1,253 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "tf2/batch_math.h"
+#include "tf2/LinearMath/Quaternion.h"
+#include "tf2/LinearMath/Transform.h"
+#include "tf2/LinearMath/Vector3.h"
+
+namespace
+{
+
+// Owns the arrays behind a TransformArray
+struct Transforms
+{
+  explicit Transforms(size_t count)
+  : data(7, std::vector<double>(count)) {}
+
+  tf2::batch::TransformArray arrays()
+  {
+    return {{data[0].data(), data[1].data(), data[2].data(), data[3].data()},
+      {data[4].data(), data[5].data(), data[6].data()}};
+  }
+
+  void set(size_t i, const tf2::Quaternion & q, const tf2::Vector3 & v)
+  {
+    data[0][i] = q.x();
+    data[1][i] = q.y();
+    data[2][i] = q.z();
+    data[3][i] = q.w();
+    data[4][i] = v.x();
+    data[5][i] = v.y();
+    data[6][i] = v.z();
+  }
+
+  tf2::Quaternion getRotation(size_t i) const
+  {
+    return tf2::Quaternion(data[0][i], data[1][i], data[2][i], data[3][i]);
+  }
+
+  std::vector<std::vector<double>> data;
+};
+
+tf2::Quaternion randomRotation(std::mt19937 & gen)
+{
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  return tf2::Quaternion(dist(gen), dist(gen), dist(gen), dist(gen)).normalized();
+}
+
+tf2::Vector3 randomVector(std::mt19937 & gen)
+{
+  std::uniform_real_distribution<double> dist(-10.0, 10.0);
+  return tf2::Vector3(dist(gen), dist(gen), dist(gen));
+}
+
+struct Expected
+{
+  tf2::Quaternion rotation;
+  tf2::Vector3 origin;
+};
+
+void expectNear(const Expected & expected, const Transforms & actual, size_t i)
+{
+  const double epsilon = 1e-12;
+  for (int j = 0; j < 3; ++j) {
+    EXPECT_NEAR(expected.origin[j], actual.data[4 + j][i], epsilon);
+  }
+  EXPECT_NEAR(expected.rotation.x(), actual.data[0][i], epsilon);
+  EXPECT_NEAR(expected.rotation.y(), actual.data[1][i], epsilon);
+  EXPECT_NEAR(expected.rotation.z(), actual.data[2][i], epsilon);
+  EXPECT_NEAR(expected.rotation.w(), actual.data[3][i], epsilon);
+}
+
+}  // namespace
+
+// Counts that are not a multiple of the vector width exercise the remainder loops
+const size_t counts[] = {0, 1, 3, 4, 7, 33};
+
+TEST(BatchMath, TransformPoints)
+{
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> dist(-100.0, 100.0);
+  for (size_t count : counts) {
+    const tf2::Transform t(randomRotation(gen), randomVector(gen));
+    std::vector<double> x(count), y(count), z(count), ox(count), oy(count), oz(count);
+    for (size_t i = 0; i < count; ++i) {
+      x[i] = dist(gen);
+      y[i] = dist(gen);
+      z[i] = dist(gen);
+    }
+    tf2::batch::transformPoints(
+      t, {x.data(), y.data(), z.data()}, {ox.data(), oy.data(), oz.data()}, count);
+    for (size_t i = 0; i < count; ++i) {
+      const tf2::Vector3 expected = t * tf2::Vector3(x[i], y[i], z[i]);
+      EXPECT_NEAR(expected.x(), ox[i], 1e-10);
+      EXPECT_NEAR(expected.y(), oy[i], 1e-10);
+      EXPECT_NEAR(expected.z(), oz[i], 1e-10);
+    }
+
+    // In place
+    tf2::batch::transformPoints(
+      t, {x.data(), y.data(), z.data()}, {x.data(), y.data(), z.data()}, count);
+    for (size_t i = 0; i < count; ++i) {
+      EXPECT_EQ(ox[i], x[i]);
+      EXPECT_EQ(oy[i], y[i]);
+      EXPECT_EQ(oz[i], z[i]);
+    }
+  }
+}
+
+TEST(BatchMath, ComposeTransforms)
+{
+  std::mt19937 gen(7);
+  for (size_t count : counts) {
+    Transforms a(count), b(count), out(count);
+    std::vector<Expected> expected;
+    for (size_t i = 0; i < count; ++i) {
+      const tf2::Quaternion qa = randomRotation(gen), qb = randomRotation(gen);
+      const tf2::Vector3 va = randomVector(gen), vb = randomVector(gen);
+      a.set(i, qa, va);
+      b.set(i, qb, vb);
+      expected.push_back({qa * qb, tf2::Transform(qa, va) * vb});
+    }
+    tf2::batch::composeTransforms(a.arrays(), b.arrays(), out.arrays(), count);
+    for (size_t i = 0; i < count; ++i) {
+      expectNear(expected[i], out, i);
+    }
+
+    // Writing over an input gives the same result
+    tf2::batch::composeTransforms(a.arrays(), b.arrays(), b.arrays(), count);
+    for (size_t i = 0; i < count; ++i) {
+      expectNear(expected[i], b, i);
+    }
+  }
+}
+
+TEST(BatchMath, NormalizeQuaternions)
+{
+  std::mt19937 gen(3);
+  std::uniform_real_distribution<double> dist(-5.0, 5.0);
+  for (size_t count : counts) {
+    std::vector<double> x(count), y(count), z(count), w(count);
+    std::vector<tf2::Quaternion> expected;
+    for (size_t i = 0; i < count; ++i) {
+      x[i] = dist(gen);
+      y[i] = dist(gen);
+      z[i] = dist(gen);
+      w[i] = dist(gen);
+      expected.push_back(tf2::Quaternion(x[i], y[i], z[i], w[i]).normalized());
+    }
+    tf2::batch::normalizeQuaternions({x.data(), y.data(), z.data(), w.data()}, count);
+    for (size_t i = 0; i < count; ++i) {
+      EXPECT_NEAR(expected[i].x(), x[i], 1e-12);
+      EXPECT_NEAR(expected[i].y(), y[i], 1e-12);
+      EXPECT_NEAR(expected[i].z(), z[i], 1e-12);
+      EXPECT_NEAR(expected[i].w(), w[i], 1e-12);
+    }
+  }
+}
+
+TEST(BatchMath, SlerpQuaternions)
+{
+  std::mt19937 gen(11);
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  const size_t count = 17;
+  Transforms a(count), b(count), out(count);
+  std::vector<double> ratio(count);
+  for (size_t i = 0; i < count; ++i) {
+    a.set(i, randomRotation(gen), tf2::Vector3(0, 0, 0));
+    b.set(i, randomRotation(gen), tf2::Vector3(0, 0, 0));
+    ratio[i] = dist(gen);
+  }
+  tf2::batch::slerpQuaternions(
+    a.arrays().rotation, b.arrays().rotation, ratio.data(), out.arrays().rotation, count);
+  for (size_t i = 0; i < count; ++i) {
+    const tf2::Quaternion expected =
+      tf2::slerp(a.getRotation(i), b.getRotation(i), ratio[i]);
+    EXPECT_NEAR(expected.x(), out.data[0][i], 1e-12);
+    EXPECT_NEAR(expected.y(), out.data[1][i], 1e-12);
+    EXPECT_NEAR(expected.z(), out.data[2][i], 1e-12);
+    EXPECT_NEAR(expected.w(), out.data[3][i], 1e-12);
+  }
+}
+
+TEST(BatchMath, CheckTransforms)
+{
+  std::mt19937 gen(5);
+  for (size_t count : counts) {
+    Transforms t(count);
+    std::vector<uint8_t> expected(count, 0);
+    for (size_t i = 0; i < count; ++i) {
+      t.set(i, randomRotation(gen), randomVector(gen));
+      switch (i % 4) {
+        case 1:
+          t.data[i % 7][i] = std::nan("");
+          // The squared norm of a rotation with a nan is a nan too
+          expected[i] = i % 7 < 4 ? tf2::batch::TRANSFORM_HAS_NAN |
+            tf2::batch::TRANSFORM_DENORMALIZED : tf2::batch::TRANSFORM_HAS_NAN;
+          break;
+        case 2:
+          t.set(i, t.getRotation(i) * 1.1, randomVector(gen));
+          expected[i] = tf2::batch::TRANSFORM_DENORMALIZED;
+          break;
+        default:
+          break;
+      }
+    }
+    std::vector<uint8_t> flags(count, 0xff);
+    tf2::batch::checkTransforms(t.arrays(), 1e-2, flags.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+      EXPECT_EQ(expected[i], flags[i]) << "transform " << i << " of " << count;
+    }
+  }
+}
+
+TEST(BatchMath, KernelName)
+{
+  const std::string name = tf2::batch::getKernelName();
+  EXPECT_TRUE(name == "avx2" || name == "neon" || name == "scalar") << name;
+}
@@ -0,0 +1,222 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "tf2/buffer_core.h"
+#include "tf2/compact_tf.h"
+#include "tf2/time.h"
+
+namespace
+{
+geometry_msgs::msg::TransformStamped makeTransform(
+  const std::string & parent, const std::string & child, int32_t sec, uint32_t nanosec,
+  double x, double yaw)
+{
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = parent;
+  st.header.stamp.sec = sec;
+  st.header.stamp.nanosec = nanosec;
+  st.child_frame_id = child;
+  st.transform.translation.x = x;
+  st.transform.translation.y = -0.25 * x;
+  st.transform.translation.z = 0.125;
+  st.transform.rotation.z = std::sin(yaw / 2);
+  st.transform.rotation.w = std::cos(yaw / 2);
+  return st;
+}
+
+std::vector<geometry_msgs::msg::TransformStamped> makeTree(int32_t sec)
+{
+  // Stamps out of order, so some deltas are negative
+  return {
+    makeTransform("map", "odom", sec, 500000000, 1.0 + sec, 0.1 * sec),
+    makeTransform("odom", "base_link", sec, 250000000, 2.0 * sec, -0.2 * sec),
+    makeTransform("base_link", "laser", sec, 750000000, 0.3, 3.0),
+    makeTransform("base_link", "camera", sec, 750000000, -0.1, -3.0)};
+}
+
+void expectNear(
+  const geometry_msgs::msg::TransformStamped & expected,
+  const geometry_msgs::msg::TransformStamped & actual, double translation_tolerance,
+  double rotation_tolerance)
+{
+  EXPECT_EQ(expected.header.frame_id, actual.header.frame_id);
+  EXPECT_EQ(expected.child_frame_id, actual.child_frame_id);
+  EXPECT_EQ(expected.header.stamp.sec, actual.header.stamp.sec);
+  EXPECT_EQ(expected.header.stamp.nanosec, actual.header.stamp.nanosec);
+  EXPECT_NEAR(expected.transform.translation.x, actual.transform.translation.x,
+    translation_tolerance);
+  EXPECT_NEAR(expected.transform.translation.y, actual.transform.translation.y,
+    translation_tolerance);
+  EXPECT_NEAR(expected.transform.translation.z, actual.transform.translation.z,
+    translation_tolerance);
+  // q and -q are the same rotation
+  const geometry_msgs::msg::Quaternion & a = expected.transform.rotation;
+  const geometry_msgs::msg::Quaternion & b = actual.transform.rotation;
+  double dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+  EXPECT_NEAR(1.0, std::abs(dot), rotation_tolerance);
+}
+}  // namespace
+
+TEST(CompactTF, Exact_Round_Trip)
+{
+  tf2::CompactTFEncoder encoder;
+  tf2::CompactTFDecoder decoder;
+  tf2::CompactTFPacket packet;
+  std::vector<geometry_msgs::msg::TransformStamped> decoded;
+  for (int32_t sec = 1; sec <= 3; ++sec) {
+    const std::vector<geometry_msgs::msg::TransformStamped> transforms = makeTree(sec);
+    encoder.encode(transforms, packet);
+    // Only the first packet names the frames
+    EXPECT_EQ(sec == 1 ? 5u : 0u, packet.new_frames.size());
+    ASSERT_TRUE(decoder.decode(packet, decoded));
+    ASSERT_EQ(transforms.size(), decoded.size());
+    for (size_t i = 0; i < transforms.size(); ++i) {
+      expectNear(transforms[i], decoded[i], 0.0, 1e-15);
+    }
+  }
+  EXPECT_EQ(3u, decoder.getStats().packets);
+  EXPECT_EQ(12u, decoder.getStats().transforms);
+
+  encoder.encode({}, packet);
+  EXPECT_TRUE(packet.data.empty());
+  EXPECT_TRUE(decoder.decode(packet, decoded));
+  EXPECT_TRUE(decoded.empty());
+}
+
+TEST(CompactTF, Quantized_Round_Trip)
+{
+  tf2::CompactTFEncoderOptions options;
+  options.translation_resolution = 0.001;
+  tf2::CompactTFEncoder encoder(options);
+  tf2::CompactTFEncoder exact_encoder;
+  tf2::CompactTFDecoder decoder;
+  tf2::CompactTFPacket packet;
+  tf2::CompactTFPacket exact_packet;
+  std::vector<geometry_msgs::msg::TransformStamped> decoded;
+  const std::vector<geometry_msgs::msg::TransformStamped> transforms = makeTree(2);
+  encoder.encode(transforms, packet);
+  exact_encoder.encode(transforms, exact_packet);
+  EXPECT_LT(packet.data.size() * 3, exact_packet.data.size());
+
+  ASSERT_TRUE(decoder.decode(packet, decoded));
+  ASSERT_EQ(transforms.size(), decoded.size());
+  for (size_t i = 0; i < transforms.size(); ++i) {
+    expectNear(transforms[i], decoded[i], 0.0005, 1e-8);
+  }
+}
+
+TEST(CompactTF, Decode_Into_Buffer)
+{
+  tf2::CompactTFEncoder encoder;
+  tf2::CompactTFDecoder decoder;
+  tf2::CompactTFPacket packet;
+  tf2::BufferCore buffer;
+  tf2::BufferCore reference;
+  for (int32_t sec = 1; sec <= 3; ++sec) {
+    const std::vector<geometry_msgs::msg::TransformStamped> transforms = makeTree(sec);
+    EXPECT_TRUE(reference.setTransforms(transforms, "test"));
+    encoder.encode(transforms, packet);
+    EXPECT_TRUE(decoder.decode(packet, buffer, "test"));
+  }
+  for (tf2::TimePoint time : {tf2::timeFromSec(2.8), tf2::TimePointZero}) {
+    expectNear(
+      reference.lookupTransform("map", "laser", time),
+      buffer.lookupTransform("map", "laser", time), 1e-12, 1e-12);
+  }
+
+  tf2::CompactTFEncoder static_encoder;
+  static_encoder.encode({makeTransform("laser", "lens", 0, 0, 0.01, 0.0)}, packet);
+  EXPECT_TRUE(decoder.decode(packet, buffer, "test", true));
+  EXPECT_TRUE(buffer.canTransform("map", "lens", tf2::timeFromSec(2.8)));
+}
+
+TEST(CompactTF, Dictionary_Recovers_At_Keyframes)
+{
+  tf2::CompactTFEncoderOptions options;
+  options.keyframe_interval = 3;
+  tf2::CompactTFEncoder encoder(options);
+  tf2::CompactTFDecoder decoder;
+  tf2::CompactTFPacket packet;
+  std::vector<geometry_msgs::msg::TransformStamped> decoded;
+
+  // Packet 0 is a keyframe, packet 1 adds a frame and is lost
+  encoder.encode(makeTree(1), packet);
+  ASSERT_TRUE(decoder.decode(packet, decoded));
+  std::vector<geometry_msgs::msg::TransformStamped> transforms = makeTree(2);
+  transforms.push_back(makeTransform("base_link", "imu", 2, 0, 0.0, 0.0));
+  encoder.encode(transforms, packet);
+  EXPECT_EQ(1u, packet.new_frames.size());
+
+  // Packet 2 decodes the frames known from the keyframe only
+  transforms = makeTree(3);
+  transforms.push_back(makeTransform("base_link", "imu", 3, 0, 0.0, 0.0));
+  encoder.encode(transforms, packet);
+  ASSERT_TRUE(decoder.decode(packet, decoded));
+  EXPECT_EQ(4u, decoded.size());
+  EXPECT_EQ(1u, decoder.getStats().unknown_frame_transforms);
+
+  // Packet 3 is the next keyframe
+  transforms = makeTree(4);
+  transforms.push_back(makeTransform("base_link", "imu", 4, 0, 0.0, 0.0));
+  encoder.encode(transforms, packet);
+  EXPECT_EQ(0u, packet.dictionary_offset);
+  ASSERT_TRUE(decoder.decode(packet, decoded));
+  EXPECT_EQ(5u, decoded.size());
+
+  // A restarted encoder starts with a keyframe of its own
+  tf2::CompactTFEncoder restarted(options);
+  restarted.encode({makeTransform("world", "map", 5, 0, 1.0, 0.0)}, packet);
+  ASSERT_TRUE(decoder.decode(packet, decoded));
+  ASSERT_EQ(1u, decoded.size());
+  EXPECT_EQ("world", decoded[0].header.frame_id);
+}
+
+TEST(CompactTF, Malformed_Packets)
+{
+  tf2::CompactTFEncoder encoder;
+  tf2::CompactTFDecoder decoder;
+  tf2::CompactTFPacket packet;
+  std::vector<geometry_msgs::msg::TransformStamped> decoded;
+  encoder.encode(makeTree(1), packet);
+  packet.data.resize(packet.data.size() - 3);
+  EXPECT_FALSE(decoder.decode(packet, decoded));
+  EXPECT_EQ(3u, decoded.size());
+  EXPECT_EQ(1u, decoder.getStats().malformed_packets);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,250 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <dlfcn.h>
+#include <pthread.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "tf2/buffer_core.h"
+#include "tf2/time.h"
+
+// Count every heap allocation and every lock that may block made while g_counting is set, and
+// fail the try-locks of the buffer while g_busy is set
+namespace
+{
+std::atomic<bool> g_counting(false);
+std::atomic<bool> g_busy(false);
+std::atomic<size_t> g_allocations(0);
+std::atomic<size_t> g_blocking_locks(0);
+
+template<typename F>
+void count(F f, size_t & allocations, size_t & blocking_locks)
+{
+  g_allocations = 0;
+  g_blocking_locks = 0;
+  g_counting = true;
+  f();
+  g_counting = false;
+  allocations = g_allocations;
+  blocking_locks = g_blocking_locks;
+}
+
+template<typename Function>
+Function next(const char * name)
+{
+  return reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+}
+
+void setTestTransform(
+  tf2::BufferCore & buffer, const std::string & parent, const std::string & child,
+  int32_t sec, double x, bool is_static = false)
+{
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = parent;
+  st.header.stamp.sec = sec;
+  st.child_frame_id = child;
+  st.transform.translation.x = x;
+  st.transform.rotation.w = 1;
+  EXPECT_TRUE(buffer.setTransform(st, "authority1", is_static));
+}
+}  // namespace
+
+void * operator new(std::size_t size)
+{
+  if (g_counting) {
+    ++g_allocations;
+  }
+  void * ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+// GCC cannot tell that operator new above uses malloc
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void * ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void * ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+// std::shared_timed_mutex and std::mutex are built on these
+extern "C" int pthread_rwlock_rdlock(pthread_rwlock_t * lock)
+{
+  static auto rdlock = next<int (*)(pthread_rwlock_t *)>("pthread_rwlock_rdlock");
+  if (g_counting) {
+    ++g_blocking_locks;
+  }
+  return rdlock(lock);
+}
+
+extern "C" int pthread_rwlock_wrlock(pthread_rwlock_t * lock)
+{
+  static auto wrlock = next<int (*)(pthread_rwlock_t *)>("pthread_rwlock_wrlock");
+  if (g_counting) {
+    ++g_blocking_locks;
+  }
+  return wrlock(lock);
+}
+
+extern "C" int pthread_rwlock_tryrdlock(pthread_rwlock_t * lock)
+{
+  static auto tryrdlock = next<int (*)(pthread_rwlock_t *)>("pthread_rwlock_tryrdlock");
+  if (g_busy) {
+    return EBUSY;
+  }
+  return tryrdlock(lock);
+}
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t * mutex)
+{
+  static auto lock = next<int (*)(pthread_mutex_t *)>("pthread_mutex_lock");
+  if (g_counting) {
+    ++g_blocking_locks;
+  }
+  return lock(mutex);
+}
+
+class tf2_realtime : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    for (int32_t sec = 1; sec <= 3; ++sec) {
+      setTestTransform(buffer, "map", "odom", sec, 1.0 * sec);
+      setTestTransform(buffer, "odom", "base", sec, 2.0 * sec);
+    }
+    setTestTransform(buffer, "base", "laser", 0, 0.5, true);
+    setTestTransform(buffer, "world", "other", 1, 1.0);
+    chain = buffer.getFrameChain("map", "laser");
+  }
+
+  tf2::BufferCore buffer;
+  tf2::FrameChainHandle chain;
+  tf2::Transform transform;
+  tf2::TimePoint time_out;
+};
+
+TEST_F(tf2_realtime, Lookups_Do_Not_Allocate_Or_Block)
+{
+  tf2::FrameChainHandle identity = buffer.getFrameChain("base", "base");
+  size_t allocations = 0;
+  size_t blocking_locks = 0;
+  count(
+    [&]() {
+      EXPECT_EQ(
+        tf2::TF2Error::NO_ERROR,
+        buffer.lookupTransformRealtime(chain, tf2::TimePointZero, transform, time_out));
+      EXPECT_EQ(tf2::timeFromSec(3), time_out);
+      EXPECT_DOUBLE_EQ(3.0 + 6.0 + 0.5, transform.getOrigin().x());
+
+      EXPECT_EQ(
+        tf2::TF2Error::NO_ERROR,
+        buffer.lookupTransformRealtime(chain, tf2::timeFromSec(1.5), transform, time_out));
+      EXPECT_EQ(tf2::timeFromSec(1.5), time_out);
+      EXPECT_DOUBLE_EQ(1.5 + 3.0 + 0.5, transform.getOrigin().x());
+
+      EXPECT_EQ(
+        tf2::TF2Error::NO_ERROR,
+        buffer.lookupTransformRealtime(identity, tf2::TimePointZero, transform, time_out));
+      EXPECT_EQ(tf2::timeFromSec(3), time_out);
+    }, allocations, blocking_locks);
+  EXPECT_EQ(0u, allocations);
+  EXPECT_EQ(0u, blocking_locks);
+
+  // The hooks do see the lock lookupTransform() waits for
+  count(
+    [&]() {
+      buffer.lookupTransform(chain, tf2::timeFromSec(1.5), transform, time_out);
+    }, allocations, blocking_locks);
+  EXPECT_LT(0u, blocking_locks);
+}
+
+TEST_F(tf2_realtime, Failures_Return_Error_Codes)
+{
+  tf2::FrameChainHandle disconnected = buffer.getFrameChain("map", "other");
+  size_t allocations = 0;
+  size_t blocking_locks = 0;
+  count(
+    [&]() {
+      EXPECT_EQ(
+        tf2::TF2Error::EXTRAPOLATION_ERROR,
+        buffer.lookupTransformRealtime(chain, tf2::timeFromSec(10), transform, time_out));
+      EXPECT_EQ(
+        tf2::TF2Error::CONNECTIVITY_ERROR,
+        buffer.lookupTransformRealtime(disconnected, tf2::TimePointZero, transform, time_out));
+      EXPECT_EQ(
+        tf2::TF2Error::INVALID_ARGUMENT_ERROR,
+        buffer.lookupTransformRealtime(nullptr, tf2::TimePointZero, transform, time_out));
+    }, allocations, blocking_locks);
+  EXPECT_EQ(0u, allocations);
+  EXPECT_EQ(0u, blocking_locks);
+}
+
+TEST_F(tf2_realtime, Gives_Up_While_The_Buffer_Is_Modified)
+{
+  // All frames of the chain share their latest stamp, so the latest lookup needs no lock
+  g_busy = true;
+  EXPECT_EQ(
+    tf2::TF2Error::NO_ERROR,
+    buffer.lookupTransformRealtime(chain, tf2::TimePointZero, transform, time_out));
+  EXPECT_EQ(
+    tf2::TF2Error::TIMEOUT_ERROR,
+    buffer.lookupTransformRealtime(chain, tf2::timeFromSec(1.5), transform, time_out));
+  g_busy = false;
+
+  // A chain compiled before the tree changed is still looked up
+  setTestTransform(buffer, "map", "odom", 4, 4.0);
+  setTestTransform(buffer, "laser", "tool", 0, 0.25, true);
+  EXPECT_EQ(
+    tf2::TF2Error::NO_ERROR,
+    buffer.lookupTransformRealtime(chain, tf2::TimePointZero, transform, time_out));
+  EXPECT_EQ(tf2::timeFromSec(3), time_out);
+  EXPECT_DOUBLE_EQ(3.0 + 6.0 + 0.5, transform.getOrigin().x());
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,107 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "tf2/buffer_core.h"
+#include "tf2/exceptions.h"
+#include "tf2/replicated_buffer.h"
+#include "tf2/time.h"
+
+namespace
+{
+geometry_msgs::msg::TransformStamped makeTransform(
+  const std::string & parent, const std::string & child, int32_t sec, double x)
+{
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = parent;
+  st.header.stamp.sec = sec;
+  st.child_frame_id = child;
+  st.transform.translation.x = x;
+  st.transform.rotation.w = 1.0;
+  return st;
+}
+}  // namespace
+
+TEST(ReplicatedBuffer, Replicas_Match)
+{
+  // More replicas than most hosts have nodes, the extra ones still get every transform
+  tf2::ReplicatedBuffer buffer(tf2::BUFFER_CORE_DEFAULT_CACHE_TIME, 3);
+  ASSERT_EQ(buffer.getNumReplicas(), 3u);
+  EXPECT_LT(buffer.getLocalReplicaIndex(), 3u);
+  EXPECT_GE(tf2::ReplicatedBuffer::getNumNumaNodes(), 1u);
+
+  EXPECT_TRUE(buffer.setTransform(makeTransform("map", "odom", 0, 5.0), "test", true));
+  std::vector<geometry_msgs::msg::TransformStamped> transforms;
+  for (int32_t sec = 1; sec <= 10; ++sec) {
+    transforms.push_back(makeTransform("odom", "base", sec, sec));
+  }
+  EXPECT_TRUE(buffer.setTransforms(transforms, "test"));
+  buffer.waitForInserts();
+
+  tf2::TimePoint time(std::chrono::milliseconds(2500));
+  for (size_t i = 0; i < buffer.getNumReplicas(); ++i) {
+    geometry_msgs::msg::TransformStamped trans =
+      buffer.getReplica(i).lookupTransform("map", "base", time);
+    EXPECT_NEAR(trans.transform.translation.x, 7.5, 1e-9);
+  }
+  EXPECT_NEAR(buffer.lookupTransform("map", "base", time).transform.translation.x, 7.5, 1e-9);
+  EXPECT_TRUE(buffer.canTransform("map", "base", tf2::TimePointZero));
+  EXPECT_TRUE(
+    buffer.canTransform(
+      "base", time, "base", tf2::TimePoint(std::chrono::seconds(9)), "odom"));
+  EXPECT_NEAR(
+    buffer.lookupTransform(
+      "base", time, "base", tf2::TimePoint(std::chrono::seconds(9)), "odom")
+    .transform.translation.x, 6.5, 1e-9);
+
+  std::vector<std::string> frames = buffer.getAllFrameNames();
+  std::sort(frames.begin(), frames.end());
+  EXPECT_EQ(frames, (std::vector<std::string>{"base", "map", "odom"}));
+  EXPECT_THROW(
+    buffer.lookupTransform("map", "missing", tf2::TimePointZero), tf2::LookupException);
+
+  // Clearing is ordered after the inserts queued before it
+  buffer.clear();
+  EXPECT_TRUE(buffer.setTransform(makeTransform("odom", "base", 20, 1.0), "test"));
+  buffer.waitForInserts();
+  for (size_t i = 0; i < buffer.getNumReplicas(); ++i) {
+    EXPECT_FALSE(buffer.getReplica(i).canTransform("map", "base", time));
+    EXPECT_TRUE(buffer.getReplica(i).canTransform("map", "base", tf2::TimePointZero));
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
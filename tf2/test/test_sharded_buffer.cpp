@@ -0,0 +1,211 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "tf2/buffer_core.h"
+#include "tf2/exceptions.h"
+#include "tf2/sharded_buffer.h"
+#include "tf2/time.h"
+
+namespace
+{
+geometry_msgs::msg::TransformStamped makeTransform(
+  const std::string & parent, const std::string & child, int32_t sec, double x, double yaw)
+{
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = parent;
+  st.header.stamp.sec = sec;
+  st.child_frame_id = child;
+  st.transform.translation.x = x;
+  st.transform.translation.y = 0.5 * x;
+  st.transform.rotation.z = std::sin(yaw / 2);
+  st.transform.rotation.w = std::cos(yaw / 2);
+  return st;
+}
+
+/// Inserts the same fleet into both buffers
+template<typename A, typename B>
+void setFleet(A & a, B & b)
+{
+  auto set = [&](const geometry_msgs::msg::TransformStamped & st, bool is_static) {
+      EXPECT_TRUE(a.setTransform(st, "test", is_static));
+      EXPECT_TRUE(b.setTransform(st, "test", is_static));
+    };
+  set(makeTransform("world", "map", 0, 10.0, 0.1), true);
+  for (int robot = 0; robot < 5; ++robot) {
+    const std::string ns = "robot_" + std::to_string(robot) + "/";
+    for (int32_t sec = 1; sec <= 3; ++sec) {
+      set(makeTransform("map", ns + "odom", sec, robot + 0.1 * sec, 0.2 * sec), false);
+      set(makeTransform(ns + "odom", ns + "base_link", sec, 1.0 * sec, 0.3 * robot), false);
+    }
+    set(makeTransform(ns + "base_link", ns + "laser", 0, 0.2, 0.0), true);
+  }
+  // A payload of one robot carried by the gripper of another
+  set(makeTransform("robot_1/base_link", "robot_1/gripper", 0, 0.4, 0.5), true);
+  for (int32_t sec = 1; sec <= 3; ++sec) {
+    set(makeTransform("robot_1/gripper", "robot_2/payload", sec, 0.1, 0.1 * sec), false);
+  }
+}
+
+void expectSameTransform(
+  const geometry_msgs::msg::TransformStamped & expected,
+  const geometry_msgs::msg::TransformStamped & actual)
+{
+  EXPECT_EQ(expected.header.frame_id, actual.header.frame_id);
+  EXPECT_EQ(expected.child_frame_id, actual.child_frame_id);
+  EXPECT_EQ(expected.header.stamp.sec, actual.header.stamp.sec);
+  EXPECT_EQ(expected.header.stamp.nanosec, actual.header.stamp.nanosec);
+  EXPECT_NEAR(expected.transform.translation.x, actual.transform.translation.x, 1e-9);
+  EXPECT_NEAR(expected.transform.translation.y, actual.transform.translation.y, 1e-9);
+  EXPECT_NEAR(expected.transform.translation.z, actual.transform.translation.z, 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.x, actual.transform.rotation.x, 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.y, actual.transform.rotation.y, 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.z, actual.transform.rotation.z, 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.w, actual.transform.rotation.w, 1e-9);
+}
+}  // namespace
+
+TEST(ShardedBuffer, Frames_Are_Split_By_Namespace)
+{
+  tf2::ShardedBuffer buffer(tf2::BUFFER_CORE_DEFAULT_CACHE_TIME, 4);
+  tf2::BufferCore reference;
+  setFleet(buffer, reference);
+  ASSERT_EQ(4u, buffer.getNumShards());
+
+  EXPECT_EQ(0u, buffer.getShardIndex("map"));
+  EXPECT_EQ(0u, buffer.getShardIndex("/map"));
+  const size_t robot_1 = buffer.getShardIndex("robot_1/odom");
+  EXPECT_NE(0u, robot_1);
+  EXPECT_EQ(robot_1, buffer.getShardIndex("/robot_1/base_link"));
+  EXPECT_EQ(robot_1, buffer.getShardIndex("robot_1/arm/link"));
+
+  // The frames of a robot only have history in its shard
+  std::string parent;
+  EXPECT_TRUE(buffer.getShard(robot_1)._getParent("robot_1/odom", tf2::TimePointZero, parent));
+  EXPECT_EQ("map", parent);
+  EXPECT_FALSE(buffer.getShard(0)._getParent("robot_1/odom", tf2::TimePointZero, parent));
+  EXPECT_TRUE(buffer.getShard(0)._getParent("map", tf2::TimePointZero, parent));
+
+  std::vector<std::string> expected = reference.getAllFrameNames();
+  std::vector<std::string> actual = buffer.getAllFrameNames();
+  std::sort(expected.begin(), expected.end());
+  std::sort(actual.begin(), actual.end());
+  EXPECT_EQ(expected, actual);
+
+  buffer.clear();
+  EXPECT_FALSE(buffer.canTransform("map", "robot_1/odom", tf2::TimePointZero));
+}
+
+TEST(ShardedBuffer, Lookups_Match_Single_Buffer)
+{
+  tf2::ShardedBuffer buffer(tf2::BUFFER_CORE_DEFAULT_CACHE_TIME, 3);
+  tf2::BufferCore reference;
+  setFleet(buffer, reference);
+
+  const std::vector<std::pair<std::string, std::string>> pairs = {
+    {"robot_0/odom", "robot_0/laser"}, {"map", "robot_3/laser"}, {"robot_3/laser", "world"},
+    {"robot_0/laser", "robot_4/base_link"}, {"robot_2/payload", "robot_1/laser"},
+    {"robot_2/base_link", "robot_2/payload"}, {"map", "map"}};
+  for (tf2::TimePoint time : {tf2::timeFromSec(1.5), tf2::timeFromSec(2.25), tf2::TimePointZero}) {
+    for (const auto & pair : pairs) {
+      expectSameTransform(
+        reference.lookupTransform(pair.first, pair.second, time),
+        buffer.lookupTransform(pair.first, pair.second, time));
+      EXPECT_TRUE(buffer.canTransform(pair.first, pair.second, time));
+    }
+  }
+  expectSameTransform(
+    reference.lookupTransform(
+      "robot_0/laser", tf2::timeFromSec(1.5), "robot_4/laser", tf2::timeFromSec(2.5), "map"),
+    buffer.lookupTransform(
+      "robot_0/laser", tf2::timeFromSec(1.5), "robot_4/laser", tf2::timeFromSec(2.5), "map"));
+  EXPECT_TRUE(
+    buffer.canTransform(
+      "robot_0/laser", tf2::timeFromSec(1.5), "robot_4/laser", tf2::timeFromSec(2.5), "world"));
+}
+
+TEST(ShardedBuffer, Errors)
+{
+  tf2::ShardedBuffer buffer(tf2::BUFFER_CORE_DEFAULT_CACHE_TIME, 3);
+  tf2::BufferCore reference;
+  setFleet(buffer, reference);
+  EXPECT_TRUE(
+    buffer.setTransform(makeTransform("island", "robot_9/reef", 1, 1.0, 0.0), "test"));
+
+  EXPECT_THROW(
+    buffer.lookupTransform("robot_0/odom", "robot_0/missing", tf2::TimePointZero),
+    tf2::LookupException);
+  EXPECT_THROW(
+    buffer.lookupTransform("robot_0/odom", "robot_5/missing", tf2::TimePointZero),
+    tf2::LookupException);
+  EXPECT_THROW(
+    buffer.lookupTransform("robot_0/odom", "robot_9/reef", tf2::TimePointZero),
+    tf2::ConnectivityException);
+  EXPECT_THROW(
+    buffer.lookupTransform("robot_0/odom", "robot_1/odom", tf2::timeFromSec(4.0)),
+    tf2::ExtrapolationException);
+  EXPECT_THROW(
+    buffer.lookupTransform("", "robot_1/odom", tf2::TimePointZero),
+    tf2::InvalidArgumentException);
+
+  std::string error;
+  EXPECT_FALSE(buffer.canTransform("map", "robot_9/reef", tf2::TimePointZero, &error));
+  EXPECT_FALSE(error.empty());
+}
+
+TEST(ShardedBuffer, Transformable_Requests_In_A_Shard)
+{
+  tf2::ShardedBuffer buffer(tf2::BUFFER_CORE_DEFAULT_CACHE_TIME, 3);
+  tf2::BufferCore reference;
+  setFleet(buffer, reference);
+
+  int calls = 0;
+  tf2::BufferCore & shard = buffer.getShard(buffer.getShardIndex("robot_0/odom"));
+  shard.addTransformableRequest(
+    [&calls](
+      tf2::TransformableRequestHandle, const std::string &, const std::string &, tf2::TimePoint,
+      tf2::TransformableResult result) {
+      EXPECT_EQ(tf2::TransformAvailable, result);
+      ++calls;
+    }, "robot_0/odom", "robot_0/laser", tf2::timeFromSec(4.0));
+  EXPECT_TRUE(buffer.setTransform(makeTransform("robot_0/odom", "robot_0/base_link", 4, 1.0, 0.0),
+    "test"));
+  EXPECT_EQ(1, calls);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,286 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tf2/buffer_core.h"
+#include "tf2/exceptions.h"
+#include "tf2/shared_buffer.h"
+#include "tf2/time.h"
+
+namespace
+{
+std::string segmentName(const std::string & test)
+{
+  return "tf2_test_" + test + "_" + std::to_string(getpid());
+}
+
+geometry_msgs::msg::TransformStamped makeTransform(
+  const std::string & parent, const std::string & child, int64_t nanoseconds, double x, double yaw)
+{
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = parent;
+  st.header.stamp.sec = static_cast<int32_t>(nanoseconds / 1000000000);
+  st.header.stamp.nanosec = static_cast<uint32_t>(nanoseconds % 1000000000);
+  st.child_frame_id = child;
+  st.transform.translation.x = x;
+  st.transform.translation.y = 0.5 * x;
+  st.transform.rotation.z = std::sin(yaw / 2);
+  st.transform.rotation.w = std::cos(yaw / 2);
+  return st;
+}
+
+void expectSameTransform(
+  const geometry_msgs::msg::TransformStamped & expected,
+  const geometry_msgs::msg::TransformStamped & actual)
+{
+  EXPECT_EQ(expected.header.frame_id, actual.header.frame_id);
+  EXPECT_EQ(expected.child_frame_id, actual.child_frame_id);
+  EXPECT_EQ(expected.header.stamp.sec, actual.header.stamp.sec);
+  EXPECT_EQ(expected.header.stamp.nanosec, actual.header.stamp.nanosec);
+  EXPECT_NEAR(expected.transform.translation.x, actual.transform.translation.x, 1e-9);
+  EXPECT_NEAR(expected.transform.translation.y, actual.transform.translation.y, 1e-9);
+  EXPECT_NEAR(expected.transform.translation.z, actual.transform.translation.z, 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.x, actual.transform.rotation.x, 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.y, actual.transform.rotation.y, 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.z, actual.transform.rotation.z, 1e-9);
+  EXPECT_NEAR(expected.transform.rotation.w, actual.transform.rotation.w, 1e-9);
+}
+}  // namespace
+
+TEST(tf2_shared_buffer, Matches_BufferCore)
+{
+  tf2::SharedBufferWriter writer(segmentName("matches"));
+  tf2::SharedBufferReader reader(segmentName("matches"));
+  tf2::BufferCore reference(tf2::Duration(std::chrono::seconds(100)));
+
+  //   map -> odom -> base -> arm -> hand
+  //                      \-> (static) laser
+  //   hand is reparented from arm to base half way
+  auto set = [&](const geometry_msgs::msg::TransformStamped & st, bool is_static) {
+      EXPECT_TRUE(writer.setTransform(st, "test", is_static));
+      EXPECT_TRUE(reference.setTransform(st, "test", is_static));
+    };
+  set(makeTransform("base", "laser", 0, 0.2, 0.1), true);
+  for (int64_t i = 1; i <= 50; ++i) {
+    int64_t ns = i * 100000000;
+    set(makeTransform("map", "odom", ns, 0.01 * i, 0.002 * i), false);
+    set(makeTransform("odom", "base", ns + 1000, 0.1 * i, -0.01 * i), false);
+    set(makeTransform("base", "arm", ns + 2000, 0.3, 0.05 * i), false);
+    set(makeTransform(i <= 25 ? "arm" : "base", "hand", ns + 3000, 0.1, 0.02 * i), false);
+  }
+
+  std::vector<std::string> frames = {"map", "odom", "base", "arm", "hand", "laser"};
+  std::vector<std::string> names = reader.getAllFrameNames();
+  EXPECT_EQ(names.size(), frames.size());
+
+  for (const std::string & target : frames) {
+    for (const std::string & source : frames) {
+      expectSameTransform(
+        reference.lookupTransform(target, source, tf2::TimePointZero),
+        reader.lookupTransform(target, source, tf2::TimePointZero));
+      for (int64_t ns = 200000000; ns <= 5000000000; ns += 123456789) {
+        tf2::TimePoint time{std::chrono::nanoseconds(ns)};
+        std::string reference_error;
+        std::string reader_error;
+        bool can = reference.canTransform(target, source, time, &reference_error);
+        ASSERT_EQ(can, reader.canTransform(target, source, time, &reader_error)) <<
+          target << " " << source << " " << ns << " " << reference_error << " " << reader_error;
+        if (can) {
+          expectSameTransform(
+            reference.lookupTransform(target, source, time),
+            reader.lookupTransform(target, source, time));
+        }
+      }
+    }
+  }
+
+  tf2::TimePoint early{std::chrono::seconds(1)};
+  tf2::TimePoint late{std::chrono::seconds(4)};
+  expectSameTransform(
+    reference.lookupTransform("hand", early, "laser", late, "map"),
+    reader.lookupTransform("hand", early, "laser", late, "map"));
+
+  EXPECT_THROW(reader.lookupTransform("map", "missing", tf2::TimePointZero), tf2::LookupException);
+  EXPECT_THROW(
+    reader.lookupTransform("", "map", tf2::TimePointZero), tf2::InvalidArgumentException);
+  EXPECT_THROW(
+    reader.lookupTransform("map", "hand", tf2::TimePoint(std::chrono::seconds(10))),
+    tf2::ExtrapolationException);
+  EXPECT_TRUE(writer.setTransform(makeTransform("other", "island", 1, 0.0, 0.0), "test"));
+  EXPECT_THROW(
+    reader.lookupTransform("map", "island", tf2::TimePointZero), tf2::ConnectivityException);
+
+  // Old data is rejected, the ring keeps the latest samples
+  EXPECT_FALSE(writer.setTransform(makeTransform("map", "odom", 1, 0.0, 0.0), "test"));
+  writer.clear();
+  EXPECT_FALSE(reader.canTransform("map", "odom", tf2::TimePointZero));
+}
+
+TEST(tf2_shared_buffer, Extrapolates_Like_BufferCore)
+{
+  tf2::RetentionPolicy policy;
+  policy.nlerp_max_angle = 0.5;
+  policy.max_extrapolation = tf2::Duration(std::chrono::milliseconds(50));
+  tf2::SharedBufferWriter writer(segmentName("extrapolate"));
+  tf2::SharedBufferReader reader(segmentName("extrapolate"), policy);
+  tf2::BufferCore reference(tf2::Duration(std::chrono::seconds(100)));
+  reference.setDefaultRetentionPolicy(policy);
+
+  //   map -> odom -> base, base is reparented to map at the last sample
+  auto set = [&](const geometry_msgs::msg::TransformStamped & st) {
+      EXPECT_TRUE(writer.setTransform(st, "test"));
+      EXPECT_TRUE(reference.setTransform(st, "test"));
+    };
+  for (int64_t i = 1; i <= 10; ++i) {
+    int64_t ns = i * 100000000;
+    set(makeTransform("map", "odom", ns, 0.01 * i, 0.2 * i));
+    set(makeTransform(i < 10 ? "odom" : "map", "base", ns, 0.1 * i, -0.1 * i));
+  }
+  // Two samples at the newest stamp, the last one before it is extrapolated from
+  set(makeTransform("map", "odom", 1000000000, 0.2, 2.1));
+
+  for (const char * source : {"odom", "base"}) {
+    for (int64_t ns = 950000000; ns <= 1100000000; ns += 10000000) {
+      tf2::TimePoint time{std::chrono::nanoseconds(ns)};
+      std::string reference_error;
+      std::string reader_error;
+      bool can = reference.canTransform("map", source, time, &reference_error);
+      ASSERT_EQ(can, reader.canTransform("map", source, time, &reader_error)) <<
+        source << " " << ns << " " << reference_error << " " << reader_error;
+      EXPECT_EQ(reference_error, reader_error);
+      if (can) {
+        expectSameTransform(
+          reference.lookupTransform("map", source, time),
+          reader.lookupTransform("map", source, time));
+      }
+    }
+  }
+  EXPECT_TRUE(reader.canTransform("map", "odom", tf2::TimePoint(std::chrono::milliseconds(1040))));
+  EXPECT_FALSE(reader.canTransform("map", "odom", tf2::TimePoint(std::chrono::milliseconds(1060))));
+}
+
+TEST(tf2_shared_buffer, Ring_Overwrites_Oldest)
+{
+  tf2::SharedBufferOptions options;
+  options.max_frames = 2;
+  options.samples_per_frame = 8;
+  tf2::SharedBufferWriter writer(segmentName("ring"), options);
+  tf2::SharedBufferReader reader(segmentName("ring"));
+
+  for (int64_t i = 1; i <= 20; ++i) {
+    EXPECT_TRUE(writer.setTransform(makeTransform("map", "base", i, 1.0 * i, 0.0), "test"));
+  }
+  EXPECT_FALSE(reader.canTransform("map", "base", tf2::TimePoint(std::chrono::nanoseconds(12))));
+  EXPECT_NEAR(
+    reader.lookupTransform("map", "base", tf2::TimePoint(std::chrono::nanoseconds(13)))
+    .transform.translation.x, 13.0, 1e-9);
+
+  // Full, a third frame does not fit
+  EXPECT_FALSE(writer.setTransform(makeTransform("map", "extra", 1, 0.0, 0.0), "test"));
+}
+
+TEST(tf2_shared_buffer, Missing_Segment)
+{
+  EXPECT_THROW(tf2::SharedBufferReader reader(segmentName("missing")), std::runtime_error);
+  EXPECT_THROW(tf2::SharedBufferWriter writer("with/slash"), std::runtime_error);
+  {
+    tf2::SharedBufferWriter writer(segmentName("removed"));
+  }
+  EXPECT_THROW(tf2::SharedBufferReader reader(segmentName("removed")), std::runtime_error);
+}
+
+TEST(tf2_shared_buffer, Lookups_While_Writing)
+{
+  tf2::SharedBufferOptions options;
+  options.max_frames = 16;
+  options.samples_per_frame = 1024;
+  tf2::SharedBufferWriter writer(segmentName("threads"), options);
+  tf2::SharedBufferReader reader(segmentName("threads"));
+
+  // Every sample is a pure translation along x of the same length, so each lookup in between
+  // two samples must give the same distance whatever samples it saw
+  auto set_chain = [&](int64_t ns) {
+      EXPECT_TRUE(writer.setTransform(makeTransform("root", "a", ns, 1.0, 0.0), "test"));
+      EXPECT_TRUE(writer.setTransform(makeTransform("a", "b", ns, 1.0, 0.0), "test"));
+      EXPECT_TRUE(writer.setTransform(makeTransform("b", "c", ns, 1.0, 0.0), "test"));
+    };
+  set_chain(1);
+  std::atomic<bool> done(false);
+  std::thread writer_thread([&]() {
+      for (int64_t ns = 2; ns < 20000; ++ns) {
+        set_chain(ns);
+      }
+      done = true;
+    });
+
+  std::vector<std::thread> readers;
+  std::atomic<int> failures(0);
+  std::atomic<int> successes(0);
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&]() {
+        // Keep going after the writer is done until a lookup succeeded, once the chain stops
+        // changing every lookup does
+        bool succeeded = false;
+        do {
+          // The writer may overwrite the samples a lookup settled on before it finishes, which
+          // is reported as extrapolation rather than a torn result
+          try {
+            geometry_msgs::msg::TransformStamped t =
+              reader.lookupTransform("root", "c", tf2::TimePointZero);
+            ++successes;
+            succeeded = true;
+            if (std::abs(t.transform.translation.x - 3.0) > 1e-9) {
+              ++failures;
+            }
+          } catch (const tf2::ExtrapolationException &) {
+          }
+        } while (!done || !succeeded);
+      });
+  }
+  writer_thread.join();
+  for (auto & thread : readers) {
+    thread.join();
+  }
+  EXPECT_EQ(failures, 0);
+  EXPECT_GE(successes, 4);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,205 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <string>
+
+#include "tf2/buffer_core.h"
+#include "tf2/exceptions.h"
+#include "tf2/static_chain.h"
+#include "tf2/time.h"
+
+namespace
+{
+
+TF2_STATIC_OFFSET(ShoulderMount, 0.1, 0.0, 0.3, 0.0, 0.0, 1.0, 1.0);
+TF2_STATIC_OFFSET(UpperArm, 0.4, 0.05, 0.0, 0.0, 0.0, 0.0, 1.0);
+TF2_STATIC_OFFSET(ElbowMount, 0.0, 0.0, 0.02, 0.5, 0.5, 0.5, 0.5);
+TF2_STATIC_OFFSET(ToolFlange, 0.0, 0.0, 0.08, 0.0, 0.0, 0.0, 1.0);
+
+using ArmChain = tf2::StaticChain<
+  tf2::StaticLink<ShoulderMount>, tf2::DynamicLink, tf2::StaticLink<UpperArm>,
+  tf2::StaticLink<ElbowMount>, tf2::DynamicLink, tf2::StaticLink<ToolFlange>>;
+
+template<typename Offset>
+void setStaticTransform(tf2::BufferCore & buffer, const std::string & parent,
+  const std::string & child)
+{
+  tf2::Quaternion q(Offset::qx, Offset::qy, Offset::qz, Offset::qw);
+  q.normalize();
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = parent;
+  st.child_frame_id = child;
+  st.transform.translation.x = Offset::x;
+  st.transform.translation.y = Offset::y;
+  st.transform.translation.z = Offset::z;
+  st.transform.rotation.x = q.x();
+  st.transform.rotation.y = q.y();
+  st.transform.rotation.z = q.z();
+  st.transform.rotation.w = q.w();
+  EXPECT_TRUE(buffer.setTransform(st, "authority1", true));
+}
+
+void setJoint(
+  tf2::BufferCore & buffer, const std::string & parent, const std::string & child,
+  int32_t sec, double angle)
+{
+  tf2::Quaternion q(tf2::Vector3(0, 1, 0), angle);
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = parent;
+  st.header.stamp.sec = sec;
+  st.child_frame_id = child;
+  st.transform.translation.x = 0.01;
+  st.transform.rotation.x = q.x();
+  st.transform.rotation.y = q.y();
+  st.transform.rotation.z = q.z();
+  st.transform.rotation.w = q.w();
+  EXPECT_TRUE(buffer.setTransform(st, "authority1"));
+}
+
+void fillBuffer(tf2::BufferCore & buffer)
+{
+  setStaticTransform<ShoulderMount>(buffer, "base_link", "shoulder");
+  setStaticTransform<UpperArm>(buffer, "upper_arm", "elbow_mount");
+  setStaticTransform<ElbowMount>(buffer, "elbow_mount", "elbow");
+  setStaticTransform<ToolFlange>(buffer, "forearm", "tool0");
+  for (int32_t sec = 1; sec <= 3; ++sec) {
+    setJoint(buffer, "shoulder", "upper_arm", sec, 0.3 * sec);
+    setJoint(buffer, "elbow", "forearm", sec, -0.2 * sec);
+  }
+}
+
+void expectNear(const tf2::Transform & expected, const tf2::Transform & actual)
+{
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_NEAR(expected.getOrigin()[i], actual.getOrigin()[i], 1e-9);
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_NEAR(expected.getBasis()[i][j], actual.getBasis()[i][j], 1e-9);
+    }
+  }
+}
+
+tf2::Transform lookup(
+  const tf2::BufferCore & buffer, const tf2::TimePoint & time, tf2::TimePoint & time_out)
+{
+  const tf2::FrameChainHandle chain = buffer.getFrameChain("base_link", "tool0");
+  tf2::Transform transform;
+  buffer.lookupTransform(chain, time, transform, time_out);
+  return transform;
+}
+
+}  // namespace
+
+TEST(StaticChain, NumDynamic)
+{
+  EXPECT_EQ(2u, ArmChain::num_dynamic);
+  EXPECT_EQ(0u, tf2::StaticChain<tf2::StaticLink<ToolFlange>>::num_dynamic);
+}
+
+TEST(StaticChain, Compose)
+{
+  tf2::BufferCore buffer;
+  fillBuffer(buffer);
+  tf2::TimePoint time_out;
+  const tf2::Transform expected = lookup(buffer, tf2::timeFromSec(2.5), time_out);
+
+  std::array<tf2::Transform, ArmChain::num_dynamic> dynamic;
+  tf2::TimePoint stamp;
+  buffer.lookupTransform(
+    buffer.getFrameChain("shoulder", "upper_arm"), tf2::timeFromSec(2.5), dynamic[0], stamp);
+  buffer.lookupTransform(
+    buffer.getFrameChain("elbow", "forearm"), tf2::timeFromSec(2.5), dynamic[1], stamp);
+  tf2::Transform transform;
+  ArmChain::compose(dynamic, transform);
+  expectNear(expected, transform);
+}
+
+TEST(StaticChain, OnlyStatic)
+{
+  tf2::Transform transform;
+  tf2::StaticChain<tf2::StaticLink<ShoulderMount>, tf2::StaticLink<UpperArm>>::compose(
+    {}, transform);
+  tf2::Transform expected(tf2::Quaternion(0, 0, 1, 1).normalized(), tf2::Vector3(0.1, 0, 0.3));
+  expected *= tf2::Transform(tf2::Quaternion::getIdentity(), tf2::Vector3(0.4, 0.05, 0));
+  expectNear(expected, transform);
+}
+
+TEST(StaticChain, LookupTransform)
+{
+  tf2::BufferCore buffer;
+  fillBuffer(buffer);
+  const ArmChain chain(buffer, {{{"shoulder", "upper_arm"}, {"elbow", "forearm"}}});
+
+  for (double sec : {1.0, 1.7, 3.0}) {
+    tf2::TimePoint expected_time;
+    const tf2::Transform expected = lookup(buffer, tf2::timeFromSec(sec), expected_time);
+    tf2::Transform transform;
+    tf2::TimePoint time_out;
+    chain.lookupTransform(tf2::timeFromSec(sec), transform, time_out);
+    expectNear(expected, transform);
+    EXPECT_EQ(expected_time, time_out);
+  }
+
+  tf2::Transform transform;
+  tf2::TimePoint time_out;
+  chain.lookupTransform(tf2::TimePointZero, transform, time_out);
+  EXPECT_EQ(tf2::timeFromSec(3), time_out);
+  EXPECT_THROW(
+    chain.lookupTransform(tf2::timeFromSec(5), transform, time_out),
+    tf2::ExtrapolationException);
+  EXPECT_THROW(ArmChain(buffer, {{{"shoulder", "upper_arm"}, {"elbow", "hand"}}}),
+    tf2::LookupException);
+}
+
+TEST(StaticChain, LookupTransformRealtime)
+{
+  tf2::BufferCore buffer;
+  fillBuffer(buffer);
+  const ArmChain chain(buffer, {{{"shoulder", "upper_arm"}, {"elbow", "forearm"}}});
+
+  tf2::TimePoint expected_time;
+  const tf2::Transform expected = lookup(buffer, tf2::timeFromSec(2.2), expected_time);
+  tf2::Transform transform;
+  tf2::TimePoint time_out;
+  EXPECT_EQ(
+    tf2::TF2Error::NO_ERROR,
+    chain.lookupTransformRealtime(tf2::timeFromSec(2.2), transform, time_out));
+  expectNear(expected, transform);
+  EXPECT_EQ(expected_time, time_out);
+  EXPECT_EQ(
+    tf2::TF2Error::EXTRAPOLATION_ERROR,
+    chain.lookupTransformRealtime(tf2::timeFromSec(5), transform, time_out));
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
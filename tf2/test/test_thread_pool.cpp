@@ -0,0 +1,112 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "tf2/thread_pool.h"
+
+TEST(ThreadPool, covers_range_once)
+{
+  tf2::ThreadPool pool(3);
+  EXPECT_EQ(3u, pool.getNumThreads());
+
+  for (size_t count : {0u, 1u, 5u, 1000u, 1001u}) {
+    std::vector<int> hits(count, 0);
+    pool.parallelFor(
+      count, 10, [&hits](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          ++hits[i];
+        }
+      });
+    EXPECT_EQ(std::vector<int>(count, 1), hits) << count;
+  }
+}
+
+TEST(ThreadPool, ranges_are_deterministic)
+{
+  tf2::ThreadPool pool(3);
+  auto ranges = [&pool]() {
+      std::vector<size_t> begins(1001, 0);
+      pool.parallelFor(
+        begins.size(), 1, [&begins](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            begins[i] = begin;
+          }
+        });
+      return begins;
+    };
+  const std::vector<size_t> first = ranges();
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_EQ(first, ranges());
+  }
+}
+
+TEST(ThreadPool, no_workers_runs_on_caller)
+{
+  tf2::ThreadPool pool(0);
+  std::vector<std::pair<size_t, size_t>> ranges;
+  pool.parallelFor(
+    100, 1, [&ranges](size_t begin, size_t end) {ranges.emplace_back(begin, end);});
+  ASSERT_EQ(1u, ranges.size());
+  EXPECT_EQ(0u, ranges[0].first);
+  EXPECT_EQ(100u, ranges[0].second);
+}
+
+TEST(ThreadPool, nested_and_exceptions)
+{
+  tf2::ThreadPool pool(2);
+  std::atomic<size_t> total(0);
+  pool.parallelFor(
+    8, 1, [&pool, &total](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        pool.parallelFor(
+          100, 1, [&total](size_t b, size_t e) {total += e - b;});
+      }
+    });
+  EXPECT_EQ(800u, total);
+
+  EXPECT_THROW(
+    pool.parallelFor(
+      100, 1, [](size_t begin, size_t) {
+        if (begin > 0) {
+          throw std::runtime_error("range failed");
+        }
+      }), std::runtime_error);
+
+  // The pool is still usable after a failure
+  total = 0;
+  pool.parallelFor(100, 1, [&total](size_t b, size_t e) {total += e - b;});
+  EXPECT_EQ(100u, total);
+}
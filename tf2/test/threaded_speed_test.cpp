@@ -0,0 +1,132 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Measures how lookupTransform throughput scales with the number of reader threads
+// while a single writer keeps inserting transforms, the way a TransformListener would.
+//
+// Usage: threaded_speed_test [num_levels] [max_threads] [lookups_per_thread] [chain]
+//
+// Pass "chain" to look up through a FrameChainHandle instead of by frame name.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "console_bridge/console.h"
+#include "tf2/buffer_core.h"
+#include "geometry_msgs/msg/transform_stamped.hpp"
+
+namespace
+{
+
+void setChain(tf2::BufferCore & bc, uint32_t num_levels, std::chrono::nanoseconds stamp)
+{
+  geometry_msgs::msg::TransformStamped t;
+  t.header.stamp.sec = static_cast<int32_t>(stamp.count() / 1000000000);
+  t.header.stamp.nanosec = static_cast<uint32_t>(stamp.count() % 1000000000);
+  t.transform.translation.x = 1;
+  t.transform.rotation.w = 1.0;
+  for (uint32_t i = 0; i < num_levels; ++i) {
+    t.header.frame_id = i == 0 ? "root" : std::to_string(i - 1);
+    t.child_frame_id = std::to_string(i);
+    bc.setTransform(t, "me");
+  }
+}
+
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  uint32_t num_levels = 10;
+  uint32_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  uint32_t count = 100000;
+  if (argc > 1) {
+    num_levels = std::stoi(argv[1]);
+  }
+  if (argc > 2) {
+    max_threads = std::stoi(argv[2]);
+  }
+  if (argc > 3) {
+    count = std::stoi(argv[3]);
+  }
+  bool use_chain = argc > 4 && std::string(argv[4]) == "chain";
+
+  tf2::BufferCore bc;
+  std::chrono::nanoseconds stamp = std::chrono::seconds(1);
+  setChain(bc, num_levels, stamp);
+
+  const std::string target = "root";
+  const std::string source = std::to_string(num_levels - 1);
+  tf2::FrameChainHandle chain = bc.getFrameChain(target, source);
+  CONSOLE_BRIDGE_logInform(
+    "Doing %u lookups per thread from %s to %s%s", count, source.c_str(), target.c_str(),
+    use_chain ? " through a FrameChainHandle" : "");
+
+  for (uint32_t num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+    std::atomic<bool> done(false);
+
+    // Keep a writer busy for the whole run so readers contend with inserts.
+    std::thread writer([&]() {
+        while (!done) {
+          stamp += std::chrono::milliseconds(1);
+          setChain(bc, num_levels, stamp);
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      });
+
+    std::vector<std::thread> readers;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < num_threads; ++i) {
+      readers.emplace_back([&]() {
+          for (uint32_t j = 0; j < count; ++j) {
+            if (use_chain) {
+              bc.lookupTransform(chain, tf2::TimePointZero);
+            } else {
+              bc.lookupTransform(target, source, tf2::TimePointZero);
+            }
+          }
+        });
+    }
+    for (auto & reader : readers) {
+      reader.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    done = true;
+    writer.join();
+
+    double secs = std::chrono::duration<double>(end - start).count();
+    CONSOLE_BRIDGE_logInform(
+      "%2u threads: %.3f s, %.0f lookups/s total, %.0f lookups/s per thread",
+      num_threads, secs, (num_threads * count) / secs, count / secs);
+  }
+
+  return 0;
+}
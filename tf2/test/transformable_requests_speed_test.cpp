@@ -0,0 +1,110 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Measures the cost of setTransform as the number of pending transformable requests grows.
+// The requests wait on sensor frames that are not touched by the inserts being timed, so with
+// indexed dispatch the insert cost should stay flat.  Inserts that add a frame recheck every
+// request and should grow no faster than linearly.
+//
+// Usage: transformable_requests_speed_test [max_requests] [inserts]
+
+#include <chrono>
+#include <string>
+
+#include "console_bridge/console.h"
+#include "tf2/buffer_core.h"
+#include "geometry_msgs/msg/transform_stamped.hpp"
+
+int main(int argc, char ** argv)
+{
+  uint32_t max_requests = 10000;
+  uint32_t count = 100000;
+  if (argc > 1) {
+    max_requests = std::stoi(argv[1]);
+  }
+  if (argc > 2) {
+    count = std::stoi(argv[2]);
+  }
+
+  auto cb = [](
+    tf2::TransformableRequestHandle, const std::string &, const std::string &,
+    tf2::TimePoint, tf2::TransformableResult) {};
+
+  for (uint32_t num_requests = 0; num_requests <= max_requests;
+    num_requests = num_requests == 0 ? 10 : num_requests * 10)
+  {
+    tf2::BufferCore bc;
+    geometry_msgs::msg::TransformStamped t;
+    t.header.stamp.sec = 1;
+    t.transform.rotation.w = 1.0;
+
+    // Sensors with data at 1s, and requests waiting for data at 2s
+    t.header.frame_id = "odom";
+    for (uint32_t i = 0; i < 30; ++i) {
+      t.child_frame_id = "sensor_" + std::to_string(i);
+      bc.setTransform(t, "me");
+    }
+    for (uint32_t i = 0; i < num_requests; ++i) {
+      bc.addTransformableRequest(
+        cb, "odom", "sensor_" + std::to_string(i % 30),
+        tf2::TimePoint(std::chrono::seconds(2) + std::chrono::microseconds(i)));
+    }
+
+    // Adding the frame changes the topology, which rechecks every request once
+    t.header.frame_id = "base_link";
+    t.child_frame_id = "arm";
+    bc.setTransform(t, "me");
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < count; ++i) {
+      t.header.stamp.nanosec = i + 1;
+      bc.setTransform(t, "me");
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double secs = std::chrono::duration<double>(end - start).count();
+    CONSOLE_BRIDGE_logInform(
+      "%6u pending requests: setTransform took %.9f on average", num_requests, secs / count);
+
+    // Every new frame changes the topology and rechecks and refiles all pending requests
+    const uint32_t topology_changes = 100;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < topology_changes; ++i) {
+      t.child_frame_id = "new_" + std::to_string(i);
+      bc.setTransform(t, "me");
+    }
+    end = std::chrono::steady_clock::now();
+
+    secs = std::chrono::duration<double>(end - start).count();
+    CONSOLE_BRIDGE_logInform(
+      "%6u pending requests: topology change took %.9f on average", num_requests,
+      secs / topology_changes);
+  }
+
+  return 0;
+}
@@ -38,6 +38,7 @@
 #include <tf2_ros/buffer_interface.h>
 
 #include <iostream>
+#include <vector>
 
 #if (BT_BULLET_VERSION <= 282)
 // Suppress compilation warning on older versions of Bullet.
@@ -139,6 +140,51 @@ namespace tf2
       tf2_ros::fromMsg(transform.header.stamp), transform.header.frame_id);
   }
 
+/** \brief Apply a geometry_msgs TransformStamped to a vector of timestamped Bullet Vector3s.
+ * The transform is converted to a btTransform once for the whole vector, instead of once per
+ * element.
+ * \param in The vectors to transform, all in the source frame of the transform.
+ * \param out The transformed vectors, resized to match in. May be the same vector as in.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+  inline
+  void doTransform(
+    const std::vector < tf2::Stamped < btVector3 >> & in,
+    std::vector < tf2::Stamped < btVector3 >> & out,
+    const geometry_msgs::msg::TransformStamped & transform)
+  {
+    const btTransform t = transformToBullet(transform);
+    const tf2::TimePoint stamp = tf2_ros::fromMsg(transform.header.stamp);
+    out.resize(in.size());
+    for (size_t i = 0; i < in.size(); ++i) {
+      static_cast < btVector3 & > (out[i]) = t * in[i];
+      out[i].stamp_ = stamp;
+      out[i].frame_id_ = transform.header.frame_id;
+    }
+  }
+
+/** \brief Apply a geometry_msgs TransformStamped to a vector of timestamped Bullet Transforms.
+ * The transform is converted to a btTransform once for the whole vector, instead of once per
+ * element.
+ * \param in The frames to transform, all in the source frame of the transform.
+ * \param out The transformed frames, resized to match in. May be the same vector as in.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+  inline
+  void doTransform(
+    const std::vector < tf2::Stamped < btTransform >> & in,
+    std::vector < tf2::Stamped < btTransform >> & out,
+    const geometry_msgs::msg::TransformStamped & transform)
+  {
+    const btTransform t = transformToBullet(transform);
+    const tf2::TimePoint stamp = tf2_ros::fromMsg(transform.header.stamp);
+    out.resize(in.size());
+    for (size_t i = 0; i < in.size(); ++i) {
+      static_cast < btTransform & > (out[i]) = t * in[i];
+      out[i].stamp_ = stamp;
+      out[i].frame_id_ = transform.header.frame_id;
+    }
+  }
 
 }  // namespace tf2
 
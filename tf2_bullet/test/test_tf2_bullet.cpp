@@ -51,6 +51,30 @@ TEST(TfBullet, ConvertVector)
   EXPECT_EQ(v1, v2);
 }
 
+TEST(TfBullet, Batch)
+{
+  geometry_msgs::msg::TransformStamped t;
+  t.header.frame_id = "B";
+  t.header.stamp.sec = 2;
+  t.transform.translation.x = 1;
+  t.transform.rotation.z = 1;
+
+  std::vector<tf2::Stamped<btVector3>> points;
+  for (int i = 0; i < 3; ++i) {
+    points.emplace_back(btVector3(1, 2, i), tf2::TimePoint(), "A");
+  }
+
+  std::vector<tf2::Stamped<btVector3>> points_out;
+  tf2::doTransform(points, points_out, t);
+  ASSERT_EQ(points.size(), points_out.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    tf2::Stamped<btVector3> expected;
+    tf2::doTransform(points[i], expected, t);
+    EXPECT_EQ(static_cast<const btVector3 &>(expected), static_cast<const btVector3 &>(points_out[i]));
+    EXPECT_EQ(expected.stamp_, points_out[i].stamp_);
+    EXPECT_EQ("B", points_out[i].frame_id_);
+  }
+}
 
 int main(int argc, char ** argv)
 {
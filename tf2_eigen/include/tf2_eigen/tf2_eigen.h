@@ -29,7 +29,9 @@
 #ifndef TF2_EIGEN__TF2_EIGEN_H_
 #define TF2_EIGEN__TF2_EIGEN_H_
 
+#include <tf2/buffer_core.h>
 #include <tf2/convert.h>
+#include <tf2/LinearMath/Transform.h>
 #include <tf2_ros/buffer_interface.h>
 #include <Eigen/Geometry>
 #include <geometry_msgs/msg/point_stamped.hpp>
@@ -40,6 +42,9 @@
 #include <geometry_msgs/msg/quaternion.hpp>
 #include <tf2_ros/buffer.h>
 
+#include <string>
+#include <vector>
+
 
 namespace tf2
 {
@@ -108,6 +113,105 @@ geometry_msgs::msg::TransformStamped eigenToTransform(const Eigen::Isometry3d &
   return t;
 }
 
+/** \brief Convert a tf2 Transform to the equivalent Eigen data type.
+ * \param t The transform to convert, as a tf2 Transform.
+ * \return The transform converted to an Eigen Isometry3d transform.
+ */
+inline
+Eigen::Isometry3d transformToEigen(const tf2::Transform & t)
+{
+  const tf2::Matrix3x3 & basis = t.getBasis();
+  const tf2::Vector3 & origin = t.getOrigin();
+  Eigen::Isometry3d out;
+  out.linear() <<
+    basis[0][0], basis[0][1], basis[0][2],
+    basis[1][0], basis[1][1], basis[1][2],
+    basis[2][0], basis[2][1], basis[2][2];
+  out.translation() << origin.x(), origin.y(), origin.z();
+  out.makeAffine();
+  return out;
+}
+
+/** \brief Get the transform between two frames directly as an Eigen Isometry3d.
+ * This skips the geometry_msgs TransformStamped that tf2::BufferCore::lookupTransform returns.
+ * \param buffer The buffer to look the transform up in.
+ * \param target_frame The frame to which data should be transformed.
+ * \param source_frame The frame where the data originated.
+ * \param time The time at which the value of the transform is desired. (0 will get the latest)
+ * \param transform The transform between the frames, as an Eigen Isometry3d transform.
+ * \param time_out The time stamp of the transform.
+ */
+inline
+void lookupTransform(
+  const tf2::BufferCore & buffer, const std::string & target_frame,
+  const std::string & source_frame, const tf2::TimePoint & time,
+  Eigen::Isometry3d & transform, tf2::TimePoint & time_out)
+{
+  tf2::Transform t;
+  buffer.lookupTransform(target_frame, source_frame, time, t, time_out);
+  transform = transformToEigen(t);
+}
+
+/** \brief Get the transform between two frames directly as an Eigen Isometry3d.
+ * \param buffer The buffer to look the transform up in.
+ * \param target_frame The frame to which data should be transformed.
+ * \param source_frame The frame where the data originated.
+ * \param time The time at which the value of the transform is desired. (0 will get the latest)
+ * \return The transform between the frames, as an Eigen Isometry3d transform.
+ */
+inline
+Eigen::Isometry3d lookupTransform(
+  const tf2::BufferCore & buffer, const std::string & target_frame,
+  const std::string & source_frame, const tf2::TimePoint & time)
+{
+  Eigen::Isometry3d transform;
+  tf2::TimePoint time_out;
+  lookupTransform(buffer, target_frame, source_frame, time, transform, time_out);
+  return transform;
+}
+
+/** \brief Get the transform along a chain compiled by tf2::BufferCore::getFrameChain() as an
+ * Eigen Isometry3d, for callers that repeatedly look up the same pair of frames.
+ * \param buffer The buffer the chain was compiled by.
+ * \param chain The chain between the frames.
+ * \param time The time at which the value of the transform is desired. (0 will get the latest)
+ * \param transform The transform between the frames, as an Eigen Isometry3d transform.
+ * \param time_out The time stamp of the transform.
+ */
+inline
+void lookupTransform(
+  const tf2::BufferCore & buffer, const tf2::FrameChainHandle & chain,
+  const tf2::TimePoint & time, Eigen::Isometry3d & transform, tf2::TimePoint & time_out)
+{
+  tf2::Transform t;
+  buffer.lookupTransform(chain, time, t, time_out);
+  transform = transformToEigen(t);
+}
+
+/** \brief Apply an Eigen Isometry3d to a set of points stored as the columns of a matrix.
+ * The points are transformed with one rotation matrix product and one broadcast translation,
+ * which Eigen vectorizes.
+ * \param transform The transform to apply.
+ * \param points_in The points to transform, one per column.
+ * \param points_out The transformed points, may be the same matrix as points_in.
+ */
+template<typename Scalar>
+inline
+void transformPoints(
+  const Eigen::Isometry3d & transform,
+  const Eigen::Matrix<Scalar, 3, Eigen::Dynamic> & points_in,
+  Eigen::Matrix<Scalar, 3, Eigen::Dynamic> & points_out)
+{
+  const Eigen::Matrix<Scalar, 3, 3> rotation = transform.linear().cast<Scalar>();
+  const Eigen::Matrix<Scalar, 3, 1> translation = transform.translation().cast<Scalar>();
+  if (&points_in == &points_out) {
+    points_out = rotation * points_in;
+  } else {
+    points_out.noalias() = rotation * points_in;
+  }
+  points_out.colwise() += translation;
+}
+
 /** \brief Apply a geometry_msgs TransformStamped to an Eigen-specific Vector3d type.
  * This function is a specialization of the doTransform template defined in tf2/convert.h,
  * although it can not be used in tf2_ros::BufferInterface::transform because this
@@ -127,6 +231,72 @@ void doTransform(
   t_out = Eigen::Vector3d(transformToEigen(transform) * t_in);
 }
 
+/** \brief Apply a geometry_msgs TransformStamped to points stored as the columns of an Eigen
+ * Matrix3Xd.
+ * This function is a specialization of the doTransform template defined in tf2/convert.h.
+ * The transform is converted once for all of the points, see transformPoints().
+ * \param t_in The points to transform, one per column.
+ * \param t_out The transformed points.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+template<>
+inline
+void doTransform(
+  const Eigen::Matrix3Xd & t_in,
+  Eigen::Matrix3Xd & t_out,
+  const geometry_msgs::msg::TransformStamped & transform)
+{
+  transformPoints(transformToEigen(transform), t_in, t_out);
+}
+
+/** \brief Apply a geometry_msgs TransformStamped to points stored as the columns of an Eigen
+ * Matrix3Xf.
+ * This function is a specialization of the doTransform template defined in tf2/convert.h.
+ * The transform is rounded to float once, the points are transformed in single precision.
+ * \param t_in The points to transform, one per column.
+ * \param t_out The transformed points.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+template<>
+inline
+void doTransform(
+  const Eigen::Matrix3Xf & t_in,
+  Eigen::Matrix3Xf & t_out,
+  const geometry_msgs::msg::TransformStamped & transform)
+{
+  transformPoints(transformToEigen(transform), t_in, t_out);
+}
+
+/** \brief Apply a geometry_msgs TransformStamped to a vector of Eigen Vector3d points.
+ * This function is a specialization of the doTransform template defined in tf2/convert.h.
+ * The points are transformed in place as one 3xN matrix, see transformPoints().
+ * \param t_in The points to transform.
+ * \param t_out The transformed points.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+template<>
+inline
+void doTransform(
+  const std::vector<Eigen::Vector3d> & t_in,
+  std::vector<Eigen::Vector3d> & t_out,
+  const geometry_msgs::msg::TransformStamped & transform)
+{
+  const Eigen::Isometry3d isometry = transformToEigen(transform);
+  t_out.resize(t_in.size());
+  if (t_in.empty()) {
+    return;
+  }
+  // Vector3d has no padding, so the points of a vector are the columns of a 3xN matrix
+  Eigen::Map<const Eigen::Matrix3Xd> in(t_in[0].data(), 3, t_in.size());
+  Eigen::Map<Eigen::Matrix3Xd> out(t_out[0].data(), 3, t_out.size());
+  if (&t_in == &t_out) {
+    out = isometry.linear() * in;
+  } else {
+    out.noalias() = isometry.linear() * in;
+  }
+  out.colwise() += isometry.translation();
+}
+
 /** \brief Convert a Eigen Vector3d type to a Point message.
  * This function is a specialization of the toMsg template defined in tf2/convert.h.
  * \param in The timestamped Eigen Vector3d to convert.
@@ -43,6 +43,7 @@
 
 #include <cmath>
 #include <memory>
+#include <vector>
 
 // TODO(clalancette) Re-enable these tests once we have tf2/convert.h:convert(A, B) implemented
 // TEST(TfEigen, ConvertVector3dStamped)
@@ -211,6 +212,73 @@ TEST_F(EigenBufferTransform, Isometry3d) {
   testEigenTransform<Eigen::Isometry>();
 }
 
+TEST_F(EigenBufferTransform, LookupTransform)
+{
+  Eigen::Isometry3d T;
+  tf2::TimePoint time_out;
+  tf2::lookupTransform(*tf_buffer, "A", "B", tf2::timeFromSec(2), T, time_out);
+
+  const Eigen::Isometry3d expected =
+    tf2::transformToEigen(tf_buffer->lookupTransform("A", "B", tf2::timeFromSec(2)));
+  EXPECT_TRUE(expected.isApprox(T));
+  EXPECT_EQ(tf2::timeFromSec(2), time_out);
+}
+
+TEST_F(EigenBufferTransform, LookupTransformReturned)
+{
+  const Eigen::Isometry3d expected =
+    tf2::transformToEigen(tf_buffer->lookupTransform("A", "B", tf2::timeFromSec(2)));
+  EXPECT_TRUE(expected.isApprox(tf2::lookupTransform(*tf_buffer, "A", "B", tf2::timeFromSec(2))));
+
+  Eigen::Isometry3d T;
+  tf2::TimePoint time_out;
+  tf2::lookupTransform(
+    *tf_buffer, tf_buffer->getFrameChain("A", "B"), tf2::timeFromSec(2), T, time_out);
+  EXPECT_TRUE(expected.isApprox(T));
+  EXPECT_EQ(tf2::timeFromSec(2), time_out);
+}
+
+TEST_F(EigenBufferTransform, PointBatches)
+{
+  const geometry_msgs::msg::TransformStamped t =
+    tf_buffer->lookupTransform("B", "A", tf2::timeFromSec(2));
+  const Eigen::Matrix3Xd points = Eigen::Matrix3Xd::Random(3, 17);
+
+  Eigen::Matrix3Xd expected(3, points.cols());
+  for (int i = 0; i < points.cols(); ++i) {
+    Eigen::Vector3d point;
+    tf2::doTransform(Eigen::Vector3d(points.col(i)), point, t);
+    expected.col(i) = point;
+  }
+
+  Eigen::Matrix3Xd out;
+  tf2::doTransform(points, out, t);
+  EXPECT_TRUE(expected.isApprox(out));
+
+  Eigen::Matrix3Xd in_place = points;
+  tf2::doTransform(in_place, in_place, t);
+  EXPECT_TRUE(expected.isApprox(in_place));
+
+  Eigen::Matrix3Xf out_f;
+  tf2::doTransform(Eigen::Matrix3Xf(points.cast<float>()), out_f, t);
+  EXPECT_TRUE(expected.cast<float>().isApprox(out_f, 1e-4f));
+
+  std::vector<Eigen::Vector3d> vector(points.cols());
+  for (int i = 0; i < points.cols(); ++i) {
+    vector[i] = points.col(i);
+  }
+  std::vector<Eigen::Vector3d> vector_out;
+  tf2::doTransform(vector, vector_out, t);
+  ASSERT_EQ(vector_out.size(), vector.size());
+  for (int i = 0; i < points.cols(); ++i) {
+    EXPECT_TRUE(expected.col(i).isApprox(vector_out[i]));
+  }
+
+  std::vector<Eigen::Vector3d> empty_out(3);
+  tf2::doTransform(std::vector<Eigen::Vector3d>(), empty_out, t);
+  EXPECT_TRUE(empty_out.empty());
+}
+
 TEST_F(EigenBufferTransform, Vector)
 {
   const tf2::Stamped<Eigen::Vector3d> v1{{1, 2, 3}, tf2::timeFromSec(2), "A"};
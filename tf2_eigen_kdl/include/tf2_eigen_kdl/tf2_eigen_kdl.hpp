@@ -37,6 +37,8 @@
 #ifndef TF2_EIGEN_KDL__TF2_EIGEN_KDL_HPP_
 #define TF2_EIGEN_KDL__TF2_EIGEN_KDL_HPP_
 
+#include <type_traits>
+
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
@@ -99,90 +101,113 @@ void wrenchEigenToKDL(const Eigen::Matrix<double, 6, 1> & e, KDL::Wrench & k);
 
 namespace impl
 {
-
 template<>
-template<>
-inline void Converter<false, false>::convert(const KDL::Rotation & a, Eigen::Quaterniond & b)
+struct DirectConverter<KDL::Rotation, Eigen::Quaterniond> : std::true_type
 {
-  quaternionKDLToEigen(a, b);
-}
+  static void convert(const KDL::Rotation & a, Eigen::Quaterniond & b)
+  {
+    quaternionKDLToEigen(a, b);
+  }
+};
 
 template<>
-template<>
-inline void Converter<false, false>::convert(const Eigen::Quaterniond & a, KDL::Rotation & b)
+struct DirectConverter<Eigen::Quaterniond, KDL::Rotation> : std::true_type
 {
-  quaternionEigenToKDL(a, b);
-}
+  static void convert(const Eigen::Quaterniond & a, KDL::Rotation & b)
+  {
+    quaternionEigenToKDL(a, b);
+  }
+};
 
 template<>
-template<>
-inline void Converter<false, false>::convert(const KDL::Frame & a, Eigen::Affine3d & b)
+struct DirectConverter<KDL::Frame, Eigen::Affine3d> : std::true_type
 {
-  transformKDLToEigen(a, b);
-}
+  static void convert(const KDL::Frame & a, Eigen::Affine3d & b)
+  {
+    transformKDLToEigen(a, b);
+  }
+};
 
 template<>
-template<>
-inline void Converter<false, false>::convert(const KDL::Frame & a, Eigen::Isometry3d & b)
+struct DirectConverter<KDL::Frame, Eigen::Isometry3d> : std::true_type
 {
-  transformKDLToEigen(a, b);
-}
+  static void convert(const KDL::Frame & a, Eigen::Isometry3d & b)
+  {
+    transformKDLToEigen(a, b);
+  }
+};
 
 template<>
-template<>
-inline void Converter<false, false>::convert(const Eigen::Affine3d & a, KDL::Frame & b)
+struct DirectConverter<Eigen::Affine3d, KDL::Frame> : std::true_type
 {
-  transformEigenToKDL(a, b);
-}
+  static void convert(const Eigen::Affine3d & a, KDL::Frame & b)
+  {
+    transformEigenToKDL(a, b);
+  }
+};
 
 template<>
-template<>
-inline void Converter<false, false>::convert(const Eigen::Isometry3d & a, KDL::Frame & b)
+struct DirectConverter<Eigen::Isometry3d, KDL::Frame> : std::true_type
 {
-  transformEigenToKDL(a, b);
-}
+  static void convert(const Eigen::Isometry3d & a, KDL::Frame & b)
+  {
+    transformEigenToKDL(a, b);
+  }
+};
 
 template<>
-template<>
-inline void Converter<false, false>::convert(const KDL::Twist & a, Eigen::Matrix<double, 6, 1> & b)
+struct DirectConverter<KDL::Twist, Eigen::Matrix<double, 6, 1>> : std::true_type
 {
-  twistKDLToEigen(a, b);
-}
+  static void convert(const KDL::Twist & a, Eigen::Matrix<double, 6, 1> & b)
+  {
+    twistKDLToEigen(a, b);
+  }
+};
 
 template<>
-template<>
-inline void Converter<false, false>::convert(const Eigen::Matrix<double, 6, 1> & a, KDL::Twist & b)
+struct DirectConverter<Eigen::Matrix<double, 6, 1>, KDL::Twist> : std::true_type
 {
-  twistEigenToKDL(a, b);
-}
+  static void convert(const Eigen::Matrix<double, 6, 1> & a, KDL::Twist & b)
+  {
+    twistEigenToKDL(a, b);
+  }
+};
 
 template<>
-template<>
-inline void Converter<false, false>::convert(const KDL::Vector & a, Eigen::Matrix<double, 3, 1> & b)
+struct DirectConverter<KDL::Vector, Eigen::Matrix<double, 3, 1>> : std::true_type
 {
-  vectorKDLToEigen(a, b);
-}
+  static void convert(const KDL::Vector & a, Eigen::Matrix<double, 3, 1> & b)
+  {
+    vectorKDLToEigen(a, b);
+  }
+};
 
 template<>
-template<>
-inline void Converter<false, false>::convert(const Eigen::Matrix<double, 3, 1> & a, KDL::Vector & b)
+struct DirectConverter<Eigen::Matrix<double, 3, 1>, KDL::Vector> : std::true_type
 {
-  vectorEigenToKDL(a, b);
-}
+  static void convert(const Eigen::Matrix<double, 3, 1> & a, KDL::Vector & b)
+  {
+    vectorEigenToKDL(a, b);
+  }
+};
 
 template<>
-template<>
-inline void Converter<false, false>::convert(const KDL::Wrench & a, Eigen::Matrix<double, 6, 1> & b)
+struct DirectConverter<KDL::Wrench, Eigen::Matrix<double, 6, 1>> : std::true_type
 {
-  wrenchKDLToEigen(a, b);
-}
+  static void convert(const KDL::Wrench & a, Eigen::Matrix<double, 6, 1> & b)
+  {
+    wrenchKDLToEigen(a, b);
+  }
+};
 
 template<>
-template<>
-inline void Converter<false, false>::convert(const Eigen::Matrix<double, 6, 1> & a, KDL::Wrench & b)
+struct DirectConverter<Eigen::Matrix<double, 6, 1>, KDL::Wrench> : std::true_type
 {
-  wrenchEigenToKDL(a, b);
-}
+  static void convert(const Eigen::Matrix<double, 6, 1> & a, KDL::Wrench & b)
+  {
+    wrenchEigenToKDL(a, b);
+  }
+};
 }  // namespace impl
 
 }  // namespace tf2
@@ -132,6 +132,22 @@ TEST(TfEigenKdl, TestVector3dVector)
   EXPECT_EQ(eigen_v, eigen_v1);
 }
 
+TEST(TfEigenKdl, TestStampedFrameIsometry3d)
+{
+  const tf2::Stamped<KDL::Frame> kdl_v(
+    KDL::Frame(KDL::Rotation::RPY(1.2, 0.2, 0), KDL::Vector(1, 2, 3)),
+    tf2::TimePoint(std::chrono::seconds(3)), "base");
+  tf2::Stamped<Eigen::Isometry3d> eigen_v;
+  tf2::convert(kdl_v, eigen_v);
+  EXPECT_EQ(kdl_v.stamp_, eigen_v.stamp_);
+  EXPECT_EQ("base", eigen_v.frame_id_);
+  tf2::Stamped<KDL::Frame> kdl_v1;
+  tf2::convert(eigen_v, kdl_v1);
+  EXPECT_EQ(static_cast<const KDL::Frame &>(kdl_v), static_cast<const KDL::Frame &>(kdl_v1));
+  EXPECT_EQ(kdl_v.stamp_, kdl_v1.stamp_);
+  EXPECT_EQ("base", kdl_v1.frame_id_);
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -43,8 +43,14 @@
 #include <geometry_msgs/msg/pose.hpp>
 #include <geometry_msgs/msg/pose_stamped.hpp>
 #include <geometry_msgs/msg/pose_with_covariance_stamped.hpp>
+#include <geometry_msgs/msg/pose_array.hpp>
+#include <geometry_msgs/msg/polygon_stamped.hpp>
 #include <kdl/frames.hpp>
 
+#include <array>
+#include <cstddef>
+#include <vector>
+
 namespace tf2
 {
 
@@ -259,6 +265,10 @@ void fromMsg(const geometry_msgs::msg::PoseStamped& msg, geometry_msgs::msg::Pos
 /** PoseWithCovarianceStamped **/
 /*******************************/
 
+// Defined with the other batch transforms below.
+inline
+void doTransform(const geometry_msgs::msg::PoseWithCovariance* in, geometry_msgs::msg::PoseWithCovariance* out, size_t count, const geometry_msgs::msg::TransformStamped& transform);
+
 /** \brief Extract a timestamp from the header of a Pose message.
  * This function is a specialization of the getTimestamp template defined in tf2/convert.h.
  * \param t PoseWithCovarianceStamped message to extract the timestamp from.
@@ -286,8 +296,43 @@ template <>
 inline
   std::array<std::array<double, 6>, 6> getCovarianceMatrix(const geometry_msgs::msg::PoseWithCovarianceStamped& t)  {return covarianceRowMajorToNested(t.pose.covariance);}
 
+/** \brief Rotate a row-major 6x6 pose covariance into another frame.
+ * The covariance of a pose is over its position and its rotation about the axes of the frame it
+ * is expressed in, so both halves turn with the frame. Each of the four 3x3 blocks becomes
+ * R * block * R^T, which costs two 3x3 products per block instead of two 6x6 products.
+ * \param cov_in The covariance to rotate.
+ * \param cov_out The rotated covariance, which may be the same array as cov_in.
+ * \param rotation The rotation from the frame of cov_in to the frame of cov_out.
+ */
+inline
+void transformCovariance(const std::array<double, 36>& cov_in, std::array<double, 36>& cov_out, const tf2::Matrix3x3& rotation)
+{
+  std::array<double, 36> result;
+  for (size_t block_row = 0; block_row < 6; block_row += 3) {
+    for (size_t block_col = 0; block_col < 6; block_col += 3) {
+      const double* block = &cov_in[block_row * 6 + block_col];
+      // R * block
+      double rb[3][3];
+      for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+          rb[i][j] = rotation[i][0] * block[j] + rotation[i][1] * block[6 + j] + rotation[i][2] * block[12 + j];
+        }
+      }
+      // (R * block) * R^T
+      for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+          result[(block_row + i) * 6 + block_col + j] =
+            rb[i][0] * rotation[j][0] + rb[i][1] * rotation[j][1] + rb[i][2] * rotation[j][2];
+        }
+      }
+    }
+  }
+  cov_out = result;
+}
+
 /** \brief Apply a geometry_msgs TransformStamped to an geometry_msgs Pose type.
  * This function is a specialization of the doTransform template defined in tf2/convert.h.
+ * The covariance is rotated into the target frame with transformCovariance().
  * \param t_in The pose to transform, as a timestamped Pose3 message with covariance.
  * \param t_out The transformed pose, as a timestamped Pose3 message with covariance.
  * \param transform The timestamped transform to apply, as a TransformStamped message.
@@ -296,17 +341,9 @@ template <>
 inline
   void doTransform(const geometry_msgs::msg::PoseWithCovarianceStamped& t_in, geometry_msgs::msg::PoseWithCovarianceStamped& t_out, const geometry_msgs::msg::TransformStamped& transform)
   {
-    KDL::Vector v(t_in.pose.pose.position.x, t_in.pose.pose.position.y, t_in.pose.pose.position.z);
-    KDL::Rotation r = KDL::Rotation::Quaternion(t_in.pose.pose.orientation.x, t_in.pose.pose.orientation.y, t_in.pose.pose.orientation.z, t_in.pose.pose.orientation.w);
-
-    KDL::Frame v_out = gmTransformToKDL(transform) * KDL::Frame(r, v);
-    t_out.pose.pose.position.x = v_out.p[0];
-    t_out.pose.pose.position.y = v_out.p[1];
-    t_out.pose.pose.position.z = v_out.p[2];
-    v_out.M.GetQuaternion(t_out.pose.pose.orientation.x, t_out.pose.pose.orientation.y, t_out.pose.pose.orientation.z, t_out.pose.pose.orientation.w);
+    doTransform(&t_in.pose, &t_out.pose, 1, transform);
     t_out.header.stamp = transform.header.stamp;
     t_out.header.frame_id = transform.header.frame_id;
-    t_out.pose.covariance = t_in.pose.covariance;
   }
 
 /** \brief Trivial "conversion" function for Pose message type.
@@ -666,6 +703,247 @@ void fromMsg(const geometry_msgs::msg::Pose& in, tf2::Transform& out)
   out.setRotation(tf2::Quaternion(in.orientation.x, in.orientation.y, in.orientation.z, in.orientation.w));
 }
 
+/***********/
+/** Batch **/
+/***********/
+
+/** \brief Apply a geometry_msgs TransformStamped to an array of geometry_msgs Points.
+ * The transform is converted once for the whole array, instead of once per point.
+ * \param in The first of the points to transform.
+ * \param out The first of the transformed points, which may be the same as in.
+ * \param count The number of points.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+inline
+void doTransform(const geometry_msgs::msg::Point* in, geometry_msgs::msg::Point* out, size_t count, const geometry_msgs::msg::TransformStamped& transform)
+{
+  tf2::Transform t;
+  fromMsg(transform.transform, t);
+  for (size_t i = 0; i < count; ++i) {
+    const tf2::Vector3 v = t * tf2::Vector3(in[i].x, in[i].y, in[i].z);
+    out[i].x = v.x();
+    out[i].y = v.y();
+    out[i].z = v.z();
+  }
+}
+
+/** \brief Apply a geometry_msgs TransformStamped to a vector of geometry_msgs Points.
+ * \param in The points to transform.
+ * \param out The transformed points, resized to match in. May be the same vector as in.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+inline
+void doTransform(const std::vector<geometry_msgs::msg::Point>& in, std::vector<geometry_msgs::msg::Point>& out, const geometry_msgs::msg::TransformStamped& transform)
+{
+  out.resize(in.size());
+  doTransform(in.data(), out.data(), in.size(), transform);
+}
+
+/** \brief Apply a geometry_msgs TransformStamped to an array of geometry_msgs Point32s.
+ * \param in The first of the points to transform.
+ * \param out The first of the transformed points, which may be the same as in.
+ * \param count The number of points.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+inline
+void doTransform(const geometry_msgs::msg::Point32* in, geometry_msgs::msg::Point32* out, size_t count, const geometry_msgs::msg::TransformStamped& transform)
+{
+  tf2::Transform t;
+  fromMsg(transform.transform, t);
+  for (size_t i = 0; i < count; ++i) {
+    const tf2::Vector3 v = t * tf2::Vector3(in[i].x, in[i].y, in[i].z);
+    out[i].x = static_cast<float>(v.x());
+    out[i].y = static_cast<float>(v.y());
+    out[i].z = static_cast<float>(v.z());
+  }
+}
+
+/** \brief Apply a geometry_msgs TransformStamped to an array of geometry_msgs Poses.
+ * The transform is converted once for the whole array, instead of once per pose.
+ * \param in The first of the poses to transform.
+ * \param out The first of the transformed poses, which may be the same as in.
+ * \param count The number of poses.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+inline
+void doTransform(const geometry_msgs::msg::Pose* in, geometry_msgs::msg::Pose* out, size_t count, const geometry_msgs::msg::TransformStamped& transform)
+{
+  tf2::Transform t;
+  fromMsg(transform.transform, t);
+  const tf2::Quaternion r = t.getRotation();
+  for (size_t i = 0; i < count; ++i) {
+    const tf2::Vector3 v = t * tf2::Vector3(in[i].position.x, in[i].position.y, in[i].position.z);
+    const tf2::Quaternion q = r * tf2::Quaternion(in[i].orientation.x, in[i].orientation.y, in[i].orientation.z, in[i].orientation.w);
+    out[i].position.x = v.x();
+    out[i].position.y = v.y();
+    out[i].position.z = v.z();
+    out[i].orientation = toMsg(q);
+  }
+}
+
+/** \brief Apply a geometry_msgs TransformStamped to a vector of geometry_msgs Poses.
+ * \param in The poses to transform.
+ * \param out The transformed poses, resized to match in. May be the same vector as in.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+inline
+void doTransform(const std::vector<geometry_msgs::msg::Pose>& in, std::vector<geometry_msgs::msg::Pose>& out, const geometry_msgs::msg::TransformStamped& transform)
+{
+  out.resize(in.size());
+  doTransform(in.data(), out.data(), in.size(), transform);
+}
+
+/** \brief Apply a geometry_msgs TransformStamped to an array of geometry_msgs PoseStampeds.
+ * All of the poses are expected to be in the source frame of the transform, as in the poses
+ * of a nav_msgs Path, and end up with the header of the transform.
+ * \param in The first of the poses to transform.
+ * \param out The first of the transformed poses, which may be the same as in.
+ * \param count The number of poses.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+inline
+void doTransform(const geometry_msgs::msg::PoseStamped* in, geometry_msgs::msg::PoseStamped* out, size_t count, const geometry_msgs::msg::TransformStamped& transform)
+{
+  tf2::Transform t;
+  fromMsg(transform.transform, t);
+  const tf2::Quaternion r = t.getRotation();
+  for (size_t i = 0; i < count; ++i) {
+    const geometry_msgs::msg::Pose & p = in[i].pose;
+    const tf2::Vector3 v = t * tf2::Vector3(p.position.x, p.position.y, p.position.z);
+    const tf2::Quaternion q = r * tf2::Quaternion(p.orientation.x, p.orientation.y, p.orientation.z, p.orientation.w);
+    out[i].pose.position.x = v.x();
+    out[i].pose.position.y = v.y();
+    out[i].pose.position.z = v.z();
+    out[i].pose.orientation = toMsg(q);
+    out[i].header = transform.header;
+  }
+}
+
+/** \brief Apply a geometry_msgs TransformStamped to a vector of geometry_msgs PoseStampeds.
+ * \param in The poses to transform, all in the source frame of the transform.
+ * \param out The transformed poses, resized to match in. May be the same vector as in.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+inline
+void doTransform(const std::vector<geometry_msgs::msg::PoseStamped>& in, std::vector<geometry_msgs::msg::PoseStamped>& out, const geometry_msgs::msg::TransformStamped& transform)
+{
+  out.resize(in.size());
+  doTransform(in.data(), out.data(), in.size(), transform);
+}
+
+/** \brief Apply a geometry_msgs TransformStamped to an array of geometry_msgs PoseWithCovariances.
+ * The transform and its rotation matrix are converted once for the whole array, and each
+ * covariance is rotated with transformCovariance().
+ * \param in The first of the poses to transform.
+ * \param out The first of the transformed poses, which may be the same as in.
+ * \param count The number of poses.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+inline
+void doTransform(const geometry_msgs::msg::PoseWithCovariance* in, geometry_msgs::msg::PoseWithCovariance* out, size_t count, const geometry_msgs::msg::TransformStamped& transform)
+{
+  tf2::Transform t;
+  fromMsg(transform.transform, t);
+  const tf2::Quaternion r = t.getRotation();
+  for (size_t i = 0; i < count; ++i) {
+    const geometry_msgs::msg::Pose & p = in[i].pose;
+    const tf2::Vector3 v = t * tf2::Vector3(p.position.x, p.position.y, p.position.z);
+    const tf2::Quaternion q = r * tf2::Quaternion(p.orientation.x, p.orientation.y, p.orientation.z, p.orientation.w);
+    out[i].pose.position.x = v.x();
+    out[i].pose.position.y = v.y();
+    out[i].pose.position.z = v.z();
+    out[i].pose.orientation = toMsg(q);
+    transformCovariance(in[i].covariance, out[i].covariance, t.getBasis());
+  }
+}
+
+/** \brief Apply a geometry_msgs TransformStamped to a vector of geometry_msgs PoseWithCovariances.
+ * \param in The poses to transform.
+ * \param out The transformed poses, resized to match in. May be the same vector as in.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+inline
+void doTransform(const std::vector<geometry_msgs::msg::PoseWithCovariance>& in, std::vector<geometry_msgs::msg::PoseWithCovariance>& out, const geometry_msgs::msg::TransformStamped& transform)
+{
+  out.resize(in.size());
+  doTransform(in.data(), out.data(), in.size(), transform);
+}
+
+/***************/
+/** PoseArray **/
+/***************/
+
+/** \brief Extract a timestamp from the header of a PoseArray message.
+ * This function is a specialization of the getTimestamp template defined in tf2/convert.h.
+ * \param t PoseArray message to extract the timestamp from.
+ * \return The timestamp of the message.
+ */
+template <>
+inline
+  tf2::TimePoint getTimestamp(const geometry_msgs::msg::PoseArray& t) {return tf2_ros::fromMsg(t.header.stamp);}
+
+/** \brief Extract a frame ID from the header of a PoseArray message.
+ * This function is a specialization of the getFrameId template defined in tf2/convert.h.
+ * \param t PoseArray message to extract the frame ID from.
+ * \return A string containing the frame ID of the message.
+ */
+template <>
+inline
+  std::string getFrameId(const geometry_msgs::msg::PoseArray& t) {return t.header.frame_id;}
+
+/** \brief Apply a geometry_msgs TransformStamped to a geometry_msgs PoseArray.
+ * This function is a specialization of the doTransform template defined in tf2/convert.h.
+ * \param t_in The poses to transform, as a PoseArray message.
+ * \param t_out The transformed poses, as a PoseArray message.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+template <>
+inline
+  void doTransform(const geometry_msgs::msg::PoseArray& t_in, geometry_msgs::msg::PoseArray& t_out, const geometry_msgs::msg::TransformStamped& transform)
+  {
+    doTransform(t_in.poses, t_out.poses, transform);
+    t_out.header.stamp = transform.header.stamp;
+    t_out.header.frame_id = transform.header.frame_id;
+  }
+
+/********************/
+/** PolygonStamped **/
+/********************/
+
+/** \brief Extract a timestamp from the header of a PolygonStamped message.
+ * This function is a specialization of the getTimestamp template defined in tf2/convert.h.
+ * \param t PolygonStamped message to extract the timestamp from.
+ * \return The timestamp of the message.
+ */
+template <>
+inline
+  tf2::TimePoint getTimestamp(const geometry_msgs::msg::PolygonStamped& t) {return tf2_ros::fromMsg(t.header.stamp);}
+
+/** \brief Extract a frame ID from the header of a PolygonStamped message.
+ * This function is a specialization of the getFrameId template defined in tf2/convert.h.
+ * \param t PolygonStamped message to extract the frame ID from.
+ * \return A string containing the frame ID of the message.
+ */
+template <>
+inline
+  std::string getFrameId(const geometry_msgs::msg::PolygonStamped& t) {return t.header.frame_id;}
+
+/** \brief Apply a geometry_msgs TransformStamped to a geometry_msgs PolygonStamped.
+ * This function is a specialization of the doTransform template defined in tf2/convert.h.
+ * \param t_in The polygon to transform, as a PolygonStamped message.
+ * \param t_out The transformed polygon, as a PolygonStamped message.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+template <>
+inline
+  void doTransform(const geometry_msgs::msg::PolygonStamped& t_in, geometry_msgs::msg::PolygonStamped& t_out, const geometry_msgs::msg::TransformStamped& transform)
+  {
+    t_out.polygon.points.resize(t_in.polygon.points.size());
+    doTransform(t_in.polygon.points.data(), t_out.polygon.points.data(), t_in.polygon.points.size(), transform);
+    t_out.header.stamp = transform.header.stamp;
+    t_out.header.frame_id = transform.header.frame_id;
+  }
+
 } // namespace
 
 #endif // TF2_GEOMETRY_MSGS_H
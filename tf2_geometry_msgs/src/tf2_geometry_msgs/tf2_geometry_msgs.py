@@ -28,6 +28,7 @@
 # author: Wim Meeussen
 
 from geometry_msgs.msg import PoseStamped, Vector3Stamped, PointStamped, PoseWithCovarianceStamped
+import numpy
 import PyKDL
 import tf2_ros
 
@@ -52,6 +53,38 @@ def transform_to_kdl(t):
                                     t.transform.translation.y,
                                     t.transform.translation.z))
 
+def transform_to_matrix(t):
+    """Return the rotation matrix and translation of a TransformStamped as NumPy arrays.
+
+    The rotation comes back as a 3x3 array and the translation as an array of 3, so that a
+    point p is transformed by rotation.dot(p) + translation.
+    """
+    q = t.transform.rotation
+    n = q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w
+    s = 2.0 / n if n > 0.0 else 0.0
+    xx, yy, zz = q.x * q.x * s, q.y * q.y * s, q.z * q.z * s
+    xy, xz, yz = q.x * q.y * s, q.x * q.z * s, q.y * q.z * s
+    wx, wy, wz = q.w * q.x * s, q.w * q.y * s, q.w * q.z * s
+    rotation = numpy.array([[1.0 - (yy + zz), xy - wz, xz + wy],
+                            [xy + wz, 1.0 - (xx + zz), yz - wx],
+                            [xz - wy, yz + wx, 1.0 - (xx + yy)]])
+    translation = numpy.array([t.transform.translation.x,
+                               t.transform.translation.y,
+                               t.transform.translation.z])
+    return rotation, translation
+
+
+# Points as an Nx3 array
+def do_transform_points(points, transform):
+    """Transform an Nx3 array of points with one matrix multiply.
+
+    Each row of points is an x, y, z point. The result is a new float64 array of the same
+    shape; no Python object is created per point.
+    """
+    rotation, translation = transform_to_matrix(transform)
+    points = numpy.asarray(points, dtype=numpy.float64).reshape(-1, 3)
+    return points.dot(rotation.T) + translation
+
 
 # PointStamped
 def do_transform_point(point, transform):
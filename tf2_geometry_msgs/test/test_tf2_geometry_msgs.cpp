@@ -165,6 +165,16 @@ TEST(TfGeometry, FrameWithCovariance)
     1.0, 2.0, 3.0, 4.0, 5.0, 6.0
   };
 
+  // The transform is a half turn about x, which flips the sign of the y and z rows and columns
+  // of both the position and rotation blocks.
+  const double sign[6] = {1.0, -1.0, -1.0, 1.0, -1.0, -1.0};
+  std::array<double, 36> expected_covariance;
+  for (size_t i = 0; i < 6; ++i) {
+    for (size_t j = 0; j < 6; ++j) {
+      expected_covariance[i * 6 + j] = sign[i] * sign[j] * v1.pose.covariance[i * 6 + j];
+    }
+  }
+
   // simple api
   geometry_msgs::msg::PoseWithCovarianceStamped v_simple = tf_buffer->transform(v1, "B", tf2::durationFromSec(2.0));
   EXPECT_NEAR(v_simple.pose.pose.position.x, -9, EPS);
@@ -174,7 +184,9 @@ TEST(TfGeometry, FrameWithCovariance)
   EXPECT_NEAR(v_simple.pose.pose.orientation.y, 0.0, EPS);
   EXPECT_NEAR(v_simple.pose.pose.orientation.z, 0.0, EPS);
   EXPECT_NEAR(v_simple.pose.pose.orientation.w, 1.0, EPS);
-  EXPECT_EQ(v_simple.pose.covariance, v1.pose.covariance);
+  for (size_t i = 0; i < 36; ++i) {
+    EXPECT_NEAR(v_simple.pose.covariance[i], expected_covariance[i], EPS);
+  }
 
 
   // advanced api
@@ -187,7 +199,9 @@ TEST(TfGeometry, FrameWithCovariance)
   EXPECT_NEAR(v_advanced.pose.pose.orientation.y, 0.0, EPS);
   EXPECT_NEAR(v_advanced.pose.pose.orientation.z, 0.0, EPS);
   EXPECT_NEAR(v_advanced.pose.pose.orientation.w, 1.0, EPS);
-  EXPECT_EQ(v_advanced.pose.covariance, v1.pose.covariance);
+  for (size_t i = 0; i < 36; ++i) {
+    EXPECT_NEAR(v_advanced.pose.covariance[i], expected_covariance[i], EPS);
+  }
 }
 
 
@@ -271,6 +285,120 @@ TEST(TfGeometry, Quaternion)
   EXPECT_NEAR(q_advanced.quaternion.w, 0, EPS);
 }
 
+TEST(TfGeometry, Batch)
+{
+  geometry_msgs::msg::TransformStamped t = tf_buffer->lookupTransform(
+    "B", "A", tf2::timeFromSec(2.0), tf2::durationFromSec(2.0));
+
+  std::vector<geometry_msgs::msg::PoseStamped> poses(3);
+  for (size_t i = 0; i < poses.size(); ++i) {
+    poses[i].header.frame_id = "A";
+    poses[i].header.stamp = tf2_ros::toMsg(tf2::timeFromSec(2));
+    poses[i].pose.position.x = 1.0 + i;
+    poses[i].pose.position.y = 2.0;
+    poses[i].pose.position.z = 3.0 - i;
+    poses[i].pose.orientation = tf2::toMsg(tf2::Quaternion(0.1 * i, 0.2, 0.3, 1.0).normalized());
+  }
+
+  geometry_msgs::msg::PoseArray array;
+  array.header = poses[0].header;
+  std::vector<geometry_msgs::msg::Point> points;
+  geometry_msgs::msg::PolygonStamped polygon;
+  polygon.header = poses[0].header;
+  for (const auto & pose : poses) {
+    array.poses.push_back(pose.pose);
+    points.push_back(pose.pose.position);
+    geometry_msgs::msg::Point32 corner;
+    corner.x = static_cast<float>(pose.pose.position.x);
+    corner.y = static_cast<float>(pose.pose.position.y);
+    corner.z = static_cast<float>(pose.pose.position.z);
+    polygon.polygon.points.push_back(corner);
+  }
+
+  std::vector<geometry_msgs::msg::PoseStamped> poses_out;
+  tf2::doTransform(poses, poses_out, t);
+  geometry_msgs::msg::PoseArray array_out = tf_buffer->transform(array, "B", tf2::durationFromSec(2.0));
+  geometry_msgs::msg::PolygonStamped polygon_out = tf_buffer->transform(polygon, "B", tf2::durationFromSec(2.0));
+  // In place
+  tf2::doTransform(points, points, t);
+
+  ASSERT_EQ(poses.size(), poses_out.size());
+  ASSERT_EQ(poses.size(), array_out.poses.size());
+  EXPECT_EQ("B", array_out.header.frame_id);
+  EXPECT_EQ("B", polygon_out.header.frame_id);
+  for (size_t i = 0; i < poses.size(); ++i) {
+    geometry_msgs::msg::PoseStamped expected;
+    tf2::doTransform(poses[i], expected, t);
+    EXPECT_EQ("B", poses_out[i].header.frame_id);
+    for (const auto * pose : {&poses_out[i].pose, &array_out.poses[i]}) {
+      EXPECT_NEAR(expected.pose.position.x, pose->position.x, EPS);
+      EXPECT_NEAR(expected.pose.position.y, pose->position.y, EPS);
+      EXPECT_NEAR(expected.pose.position.z, pose->position.z, EPS);
+      tf2::Quaternion q_expected, q;
+      tf2::fromMsg(expected.pose.orientation, q_expected);
+      tf2::fromMsg(pose->orientation, q);
+      EXPECT_NEAR(1.0, std::abs(q_expected.dot(q)), EPS);
+    }
+    EXPECT_NEAR(expected.pose.position.x, points[i].x, EPS);
+    EXPECT_NEAR(expected.pose.position.y, points[i].y, EPS);
+    EXPECT_NEAR(expected.pose.position.z, points[i].z, EPS);
+    EXPECT_NEAR(expected.pose.position.x, polygon_out.polygon.points[i].x, EPS);
+    EXPECT_NEAR(expected.pose.position.y, polygon_out.polygon.points[i].y, EPS);
+    EXPECT_NEAR(expected.pose.position.z, polygon_out.polygon.points[i].z, EPS);
+  }
+}
+
+TEST(TfGeometry, BatchWithCovariance)
+{
+  geometry_msgs::msg::TransformStamped t;
+  t.transform.translation.x = 1.0;
+  t.transform.translation.y = -2.0;
+  t.transform.rotation = tf2::toMsg(tf2::Quaternion(0.2, -0.4, 0.7, 1.0).normalized());
+  tf2::Matrix3x3 r(tf2::Quaternion(0.2, -0.4, 0.7, 1.0).normalized());
+
+  std::vector<geometry_msgs::msg::PoseWithCovariance> poses(2);
+  for (size_t i = 0; i < poses.size(); ++i) {
+    poses[i].pose.position.x = 1.0 + i;
+    poses[i].pose.orientation.w = 1.0;
+    for (size_t j = 0; j < 36; ++j) {
+      poses[i].covariance[j] = std::sin(j * 1.3 + i) + ((j % 7) ? 0.0 : 2.0);
+    }
+  }
+
+  std::vector<geometry_msgs::msg::PoseWithCovariance> poses_out;
+  tf2::doTransform(poses, poses_out, t);
+  ASSERT_EQ(poses.size(), poses_out.size());
+  for (size_t i = 0; i < poses.size(); ++i) {
+    // Compare against the full 6x6 product with the block diagonal rotation.
+    double r6[6][6] = {};
+    for (size_t j = 0; j < 3; ++j) {
+      for (size_t k = 0; k < 3; ++k) {
+        r6[j][k] = r6[j + 3][k + 3] = r[j][k];
+      }
+    }
+    for (size_t j = 0; j < 6; ++j) {
+      for (size_t k = 0; k < 6; ++k) {
+        double expected = 0.0;
+        for (size_t m = 0; m < 6; ++m) {
+          for (size_t n = 0; n < 6; ++n) {
+            expected += r6[j][m] * poses[i].covariance[m * 6 + n] * r6[k][n];
+          }
+        }
+        EXPECT_NEAR(expected, poses_out[i].covariance[j * 6 + k], EPS);
+      }
+    }
+    const tf2::Vector3 position = r * tf2::Vector3(1.0 + i, 0.0, 0.0) + tf2::Vector3(1.0, -2.0, 0.0);
+    EXPECT_NEAR(position.x(), poses_out[i].pose.position.x, EPS);
+    EXPECT_NEAR(position.y(), poses_out[i].pose.position.y, EPS);
+    EXPECT_NEAR(position.z(), poses_out[i].pose.position.z, EPS);
+  }
+
+  // In place
+  tf2::doTransform(poses, poses, t);
+  for (size_t i = 0; i < poses.size(); ++i) {
+    EXPECT_EQ(poses_out[i].covariance, poses[i].covariance);
+  }
+}
 
 int main(int argc, char **argv){
   testing::InitGoogleTest(&argc, argv);
@@ -32,7 +32,9 @@
 #ifndef TF2_KDL_H
 #define TF2_KDL_H
 
+#include <tf2/buffer_core.h>
 #include <tf2/convert.h>
+#include <tf2/LinearMath/Transform.h>
 #include <tf2_ros/buffer_interface.h>
 #include <kdl/frames.hpp>
 #include <geometry_msgs/msg/point_stamped.hpp>
@@ -43,6 +45,8 @@
 #include <builtin_interfaces/msg/time.hpp>
 #include <geometry_msgs/msg/transform_stamped.hpp>
 
+#include <vector>
+
 namespace tf2
 {
 /** \brief Convert a timestamped transform to the equivalent KDL data type.
@@ -72,6 +76,55 @@ geometry_msgs::msg::TransformStamped kdlToTransform(const KDL::Frame& k)
   return t;
 }
 
+/** \brief Convert a tf2 Transform to the equivalent KDL data type.
+ * \param t The transform to convert, as a tf2 Transform.
+ * \return The transform converted to a KDL Frame.
+ */
+inline
+KDL::Frame transformToKDL(const tf2::Transform& t)
+{
+  const tf2::Matrix3x3& basis = t.getBasis();
+  const tf2::Vector3& origin = t.getOrigin();
+  return KDL::Frame(KDL::Rotation(basis[0][0], basis[0][1], basis[0][2],
+                                  basis[1][0], basis[1][1], basis[1][2],
+                                  basis[2][0], basis[2][1], basis[2][2]),
+                    KDL::Vector(origin.x(), origin.y(), origin.z()));
+}
+
+namespace impl
+{
+/** \brief Lets tf2::convert() turn a tf2 Transform, or a tf2::Stamped one, straight into a
+ * KDL Frame without going through a geometry_msgs Transform.
+ */
+template<>
+struct DirectConverter<tf2::Transform, KDL::Frame> : std::true_type
+{
+  static void convert(const tf2::Transform & a, KDL::Frame & b)
+  {
+    b = transformToKDL(a);
+  }
+};
+}  // namespace impl
+
+/** \brief Get the transform between two frames directly as a KDL Frame.
+ * This skips the geometry_msgs TransformStamped that tf2::BufferCore::lookupTransform returns.
+ * \param buffer The buffer to look the transform up in.
+ * \param target_frame The frame to which data should be transformed.
+ * \param source_frame The frame where the data originated.
+ * \param time The time at which the value of the transform is desired. (0 will get the latest)
+ * \param transform The transform between the frames, as a KDL Frame.
+ * \param time_out The time stamp of the transform.
+ */
+inline
+void lookupTransform(const tf2::BufferCore& buffer, const std::string& target_frame,
+                     const std::string& source_frame, const tf2::TimePoint& time,
+                     KDL::Frame& transform, tf2::TimePoint& time_out)
+{
+  tf2::Transform t;
+  buffer.lookupTransform(target_frame, source_frame, time, t, time_out);
+  transform = transformToKDL(t);
+}
+
 // ---------------------
 // Vector
 // ---------------------
@@ -306,6 +359,76 @@ void fromMsg(const geometry_msgs::msg::PoseStamped& msg, tf2::Stamped<KDL::Frame
   fromMsg(msg.pose, static_cast<KDL::Frame&>(out));
 }
 
+
+/***********/
+/** Batch **/
+/***********/
+
+namespace impl
+{
+template <typename T>
+inline
+void doTransformKDL(const std::vector<tf2::Stamped<T>>& in, std::vector<tf2::Stamped<T>>& out, const geometry_msgs::msg::TransformStamped& transform)
+{
+  const KDL::Frame frame = transformToKDL(transform);
+  const tf2::TimePoint stamp = tf2_ros::fromMsg(transform.header.stamp);
+  out.resize(in.size());
+  for (size_t i = 0; i < in.size(); ++i) {
+    static_cast<T&>(out[i]) = frame * in[i];
+    out[i].stamp_ = stamp;
+    out[i].frame_id_ = transform.header.frame_id;
+  }
+}
+}  // namespace impl
+
+/** \brief Apply a geometry_msgs TransformStamped to a vector of timestamped KDL Vectors.
+ * The transform is converted to a KDL Frame once for the whole vector, instead of once per element.
+ * \param in The vectors to transform, all in the source frame of the transform.
+ * \param out The transformed vectors, resized to match in. May be the same vector as in.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+inline
+void doTransform(const std::vector<tf2::Stamped<KDL::Vector>>& in, std::vector<tf2::Stamped<KDL::Vector>>& out, const geometry_msgs::msg::TransformStamped& transform)
+{
+  impl::doTransformKDL(in, out, transform);
+}
+
+/** \brief Apply a geometry_msgs TransformStamped to a vector of timestamped KDL Twists.
+ * The transform is converted to a KDL Frame once for the whole vector, instead of once per element.
+ * \param in The twists to transform, all in the source frame of the transform.
+ * \param out The transformed twists, resized to match in. May be the same vector as in.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+inline
+void doTransform(const std::vector<tf2::Stamped<KDL::Twist>>& in, std::vector<tf2::Stamped<KDL::Twist>>& out, const geometry_msgs::msg::TransformStamped& transform)
+{
+  impl::doTransformKDL(in, out, transform);
+}
+
+/** \brief Apply a geometry_msgs TransformStamped to a vector of timestamped KDL Wrenches.
+ * The transform is converted to a KDL Frame once for the whole vector, instead of once per element.
+ * \param in The wrenches to transform, all in the source frame of the transform.
+ * \param out The transformed wrenches, resized to match in. May be the same vector as in.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+inline
+void doTransform(const std::vector<tf2::Stamped<KDL::Wrench>>& in, std::vector<tf2::Stamped<KDL::Wrench>>& out, const geometry_msgs::msg::TransformStamped& transform)
+{
+  impl::doTransformKDL(in, out, transform);
+}
+
+/** \brief Apply a geometry_msgs TransformStamped to a vector of timestamped KDL Frames.
+ * The transform is converted to a KDL Frame once for the whole vector, instead of once per element.
+ * \param in The frames to transform, all in the source frame of the transform.
+ * \param out The transformed frames, resized to match in. May be the same vector as in.
+ * \param transform The timestamped transform to apply, as a TransformStamped message.
+ */
+inline
+void doTransform(const std::vector<tf2::Stamped<KDL::Frame>>& in, std::vector<tf2::Stamped<KDL::Frame>>& out, const geometry_msgs::msg::TransformStamped& transform)
+{
+  impl::doTransformKDL(in, out, transform);
+}
+
 } // namespace
 
 #endif // TF2_KDL_H
@@ -214,6 +214,50 @@ TEST(TfKDL, ConvertFrame)
   EXPECT_EQ(f, f3);
 }
 
+TEST(TfKDL, LookupTransform)
+{
+  KDL::Frame f;
+  tf2::TimePoint time_out;
+  tf2::lookupTransform(*tf_buffer, "A", "B", tf2::timeFromSec(2.0), f, time_out);
+
+  KDL::Frame expected = tf2::transformToKDL(tf_buffer->lookupTransform("A", "B", tf2::timeFromSec(2.0)));
+  EXPECT_TRUE(KDL::Equal(expected, f, EPS));
+  EXPECT_EQ(tf2::timeFromSec(2.0), time_out);
+}
+
+TEST(TfKDL, Batch)
+{
+  geometry_msgs::msg::TransformStamped t = tf_buffer->lookupTransform("B", "A", tf2::timeFromSec(2.0));
+
+  std::vector<tf2::Stamped<KDL::Wrench>> wrenches;
+  std::vector<tf2::Stamped<KDL::Frame>> frames;
+  for (int i = 0; i < 3; ++i) {
+    wrenches.emplace_back(
+      KDL::Wrench(KDL::Vector(1, 2, i), KDL::Vector(i, 5, 6)), tf2::timeFromSec(2.0), "A");
+    frames.emplace_back(
+      KDL::Frame(KDL::Rotation::RPY(0.1 * i, 0.2, 0), KDL::Vector(i, 2, 3)), tf2::timeFromSec(2.0), "A");
+  }
+
+  std::vector<tf2::Stamped<KDL::Wrench>> wrenches_out;
+  tf2::doTransform(wrenches, wrenches_out, t);
+  // In place
+  std::vector<tf2::Stamped<KDL::Frame>> frames_out = frames;
+  tf2::doTransform(frames_out, frames_out, t);
+
+  ASSERT_EQ(wrenches.size(), wrenches_out.size());
+  ASSERT_EQ(frames.size(), frames_out.size());
+  for (size_t i = 0; i < wrenches.size(); ++i) {
+    tf2::Stamped<KDL::Wrench> wrench;
+    tf2::doTransform(wrenches[i], wrench, t);
+    EXPECT_EQ(wrench, wrenches_out[i]);
+    EXPECT_EQ("B", wrenches_out[i].frame_id_);
+    tf2::Stamped<KDL::Frame> frame;
+    tf2::doTransform(frames[i], frame, t);
+    EXPECT_EQ(frame, frames_out[i]);
+    EXPECT_EQ(tf2::timeFromSec(2.0), frames_out[i].stamp_);
+  }
+}
+
 int main(int argc, char **argv){
   testing::InitGoogleTest(&argc, argv);
 
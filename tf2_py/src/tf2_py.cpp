@@ -4,15 +4,49 @@
 #include <tf2/buffer_core.h>
 #include <tf2/exceptions.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <vector>
 
+// Releases the GIL for the lifetime of the object, so other Python threads keep running while
+// BufferCore takes its mutex and walks the tree. Nothing in its scope may touch Python objects.
+class ScopedGILRelease
+{
+public:
+  ScopedGILRelease()
+  : state_(PyEval_SaveThread()) {}
+
+  ~ScopedGILRelease()
+  {
+    PyEval_RestoreThread(state_);
+  }
+
+  ScopedGILRelease(const ScopedGILRelease &) = delete;
+  ScopedGILRelease & operator=(const ScopedGILRelease &) = delete;
+
+private:
+  PyThreadState * state_;
+};
+
+// Run x (pure C++ work that cannot throw) without holding the GIL
+//
+#define NOGIL(x) \
+  do { \
+    ScopedGILRelease release_gil; \
+    x; \
+  } while (0)
+
 // Run x (a tf method, catching TF's exceptions and reraising them as Python exceptions)
+// without holding the GIL. The GIL is reacquired before any Python exception is set.
 //
 #define WRAP(x) \
   do { \
     try \
     { \
+      ScopedGILRelease release_gil; \
       x; \
     } \
     catch (const tf2::ConnectivityException & e) \
@@ -51,6 +85,7 @@ static PyObject * pModulerclpy = nullptr;
 static PyObject * pModulerclpytime = nullptr;
 static PyObject * pModulebuiltininterfacesmsgs = nullptr;
 static PyObject * pModulegeometrymsgs = nullptr;
+static PyObject * pModulenumpy = nullptr;
 static PyObject * tf2_exception = nullptr;
 static PyObject * tf2_connectivityexception = nullptr, * tf2_lookupexception = nullptr,
   * tf2_extrapolationexception = nullptr,
@@ -344,14 +379,18 @@ static PyObject * allFramesAsYAML(PyObject * self, PyObject * args)
 {
   (void)args;
   tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
-  return stringToPython(bc->allFramesAsYAML());
+  std::string yaml;
+  NOGIL(yaml = bc->allFramesAsYAML());
+  return stringToPython(yaml);
 }
 
 static PyObject * allFramesAsString(PyObject * self, PyObject * args)
 {
   (void)args;
   tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
-  return stringToPython(bc->allFramesAsString());
+  std::string frames;
+  NOGIL(frames = bc->allFramesAsString());
+  return stringToPython(frames);
 }
 
 static PyObject * canTransformCore(PyObject * self, PyObject * args, PyObject * kw)
@@ -369,7 +408,8 @@ static PyObject * canTransformCore(PyObject * self, PyObject * args, PyObject *
     return nullptr;
   }
   std::string error_msg;
-  bool can_transform = bc->canTransform(target_frame, source_frame, time, &error_msg);
+  bool can_transform;
+  NOGIL(can_transform = bc->canTransform(target_frame, source_frame, time, &error_msg));
   // return PyBool_FromLong(t->canTransform(target_frame, source_frame, time));
   return Py_BuildValue("bs", can_transform, error_msg.c_str());
 }
@@ -396,9 +436,11 @@ static PyObject * canTransformFullCore(PyObject * self, PyObject * args, PyObjec
     return nullptr;
   }
   std::string error_msg;
-  bool can_transform = bc->canTransform(
-    target_frame, target_time, source_frame, source_time,
-    fixed_frame, &error_msg);
+  bool can_transform;
+  NOGIL(
+    can_transform = bc->canTransform(
+      target_frame, target_time, source_frame, source_time,
+      fixed_frame, &error_msg));
   // return PyBool_FromLong(t->canTransform(target_frame, target_time, source_frame,
   //                                        source_time, fixed_frame));
   return Py_BuildValue("bs", can_transform, error_msg.c_str());
@@ -455,9 +497,11 @@ static PyObject * getLatestCommonTime(PyObject * self, PyObject * args)
   if (!PyArg_ParseTuple(args, "ss", &target_frame, &source_frame)) {
     return nullptr;
   }
-  WRAP(target_id = bc->_validateFrameId("get_latest_common_time", target_frame));
-  WRAP(source_id = bc->_validateFrameId("get_latest_common_time", source_frame));
-  const tf2::TF2Error r = bc->_getLatestCommonTime(target_id, source_id, tf2_time, &error_string);
+  tf2::TF2Error r;
+  WRAP(
+    target_id = bc->_validateFrameId("get_latest_common_time", target_frame);
+    source_id = bc->_validateFrameId("get_latest_common_time", source_frame);
+    r = bc->_getLatestCommonTime(target_id, source_id, tf2_time, &error_string));
 
   if (r != tf2::TF2Error::NO_ERROR) {
     PyErr_SetString(tf2_exception, error_string.c_str());
@@ -566,51 +610,274 @@ static PyObject * lookupTransformFullCore(PyObject * self, PyObject * args, PyOb
   // TODO(anyone): Create a converter that will actually return a python message
   return Py_BuildValue("O&", transform_converter, &transform);
 }
-/*
-static PyObject *lookupTwistCore(PyObject *self, PyObject *args, PyObject *kw)
+
+// Creates a new, uninitialized float64 NumPy array of the given shape.
+// Only numpy.empty() is called through Python; the values are filled in directly through the
+// buffer protocol, so no per element Python objects are created and numpy is not needed at
+// build time. On success view holds the array memory and must be released by the caller.
+static PyObject * newDoubleArray(const std::vector<Py_ssize_t> & shape, Py_buffer * view)
 {
-  tf2::BufferCore *bc = ((buffer_core_t*)self)->bc;
-  char *tracking_frame, *observation_frame;
-  builtin_interfaces::msg::Time time;
-  tf2::Duration averaging_interval;
-  static const char *keywords[] = { "tracking_frame", "observation_frame", "time", "averaging_interval", nullptr };
+  if (!pModulenumpy) {
+    pModulenumpy = pythonImport("numpy");
+    if (!pModulenumpy) {
+      return nullptr;
+    }
+  }
+  PyObject * pshape = PyTuple_New(shape.size());
+  if (!pshape) {
+    return nullptr;
+  }
+  for (size_t i = 0; i < shape.size(); ++i) {
+    PyTuple_SET_ITEM(pshape, i, PyLong_FromSsize_t(shape[i]));
+  }
+  PyObject * array = PyObject_CallMethod(pModulenumpy, "empty", "Os", pshape, "float64");
+  Py_DECREF(pshape);
+  if (!array) {
+    return nullptr;
+  }
+  if (-1 == PyObject_GetBuffer(array, view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS)) {
+    Py_DECREF(array);
+    return nullptr;
+  }
+  return array;
+}
+
+// Writes t as a row major homogeneous 4x4 matrix.
+static void transformToMatrix(const tf2::Transform & t, double * out)
+{
+  const tf2::Matrix3x3 & basis = t.getBasis();
+  const tf2::Vector3 & origin = t.getOrigin();
+  for (int row = 0; row < 3; ++row) {
+    out[row * 4 + 0] = basis[row].x();
+    out[row * 4 + 1] = basis[row].y();
+    out[row * 4 + 2] = basis[row].z();
+    out[row * 4 + 3] = origin[row];
+  }
+  out[12] = 0.0;
+  out[13] = 0.0;
+  out[14] = 0.0;
+  out[15] = 1.0;
+}
+
+// Writes t as x, y, z, qx, qy, qz, qw.
+static void transformToVector(const tf2::Transform & t, double * out)
+{
+  const tf2::Vector3 & origin = t.getOrigin();
+  const tf2::Quaternion rotation = t.getRotation();
+  out[0] = origin.x();
+  out[1] = origin.y();
+  out[2] = origin.z();
+  out[3] = rotation.x();
+  out[4] = rotation.y();
+  out[5] = rotation.z();
+  out[6] = rotation.w();
+}
+
+// Converts either a buffer of int64 nanoseconds, such as a NumPy int64 array, or a sequence of
+// objects accepted by rostime_converter into a vector of time points.
+static int rostimes_converter(PyObject * obj, std::vector<tf2::TimePoint> * times)
+{
+  if (PyObject_CheckBuffer(obj)) {
+    Py_buffer view;
+    if (-1 == PyObject_GetBuffer(obj, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT)) {
+      return 0;
+    }
+    const std::string format = view.format ? view.format : "B";
+    if (view.itemsize != sizeof(int64_t) ||
+      (format != "q" && format != "l" && format != "<q" && format != "=q"))
+    {
+      PyBuffer_Release(&view);
+      PyErr_SetString(PyExc_TypeError, "times must be an array of int64 nanoseconds.");
+      return 0;
+    }
+    const int64_t * nanoseconds = static_cast<const int64_t *>(view.buf);
+    const size_t count = view.len / sizeof(int64_t);
+    times->resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      (*times)[i] = tf2::TimePoint(std::chrono::nanoseconds(nanoseconds[i]));
+    }
+    PyBuffer_Release(&view);
+    return 1;
+  }
+
+  PyObject * seq = PySequence_Fast(obj, "times must be a sequence or an int64 array.");
+  if (!seq) {
+    return 0;
+  }
+  const Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+  times->resize(count);
+  for (Py_ssize_t i = 0; i < count; ++i) {
+    if (!rostime_converter(PySequence_Fast_GET_ITEM(seq, i), &(*times)[i])) {
+      Py_DECREF(seq);
+      return 0;
+    }
+  }
+  Py_DECREF(seq);
+  return 1;
+}
+
+static PyObject * lookupTransformArray(
+  PyObject * self, PyObject * args, PyObject * kw, bool matrix)
+{
+  tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
+  char * target_frame, * source_frame;
+  tf2::TimePoint time;
+  static const char * keywords[] = {"target_frame", "source_frame", "time", nullptr};
 
-  if (!PyArg_ParseTupleAndKeywords(args, kw, "ssO&O&", (char**)keywords, &tracking_frame, &observation_frame, rostime_converter, &time, rosduration_converter, &averaging_interval))
+  if (!PyArg_ParseTupleAndKeywords(
+      args, kw, "ssO&",
+      const_cast<char **>(reinterpret_cast<const char **>(keywords)), &target_frame,
+      &source_frame, rostime_converter, &time))
+  {
     return nullptr;
-  geometry_msgs::msg::Twist twist;
-  WRAP(twist = bc->lookupTwist(tracking_frame, observation_frame, time, averaging_interval));
+  }
+  std::vector<tf2::Transform> transforms;
+  std::vector<tf2::TimePoint> times_out;
+  WRAP(bc->lookupTransforms(target_frame, source_frame, {time}, transforms, times_out));
 
-  return Py_BuildValue("(ddd)(ddd)",
-      twist.linear.x, twist.linear.y, twist.linear.z,
-      twist.angular.x, twist.angular.y, twist.angular.z);
+  Py_buffer view;
+  PyObject * array = newDoubleArray(
+    matrix ? std::vector<Py_ssize_t>{4, 4} : std::vector<Py_ssize_t>{7}, &view);
+  if (!array) {
+    return nullptr;
+  }
+  if (matrix) {
+    transformToMatrix(transforms[0], static_cast<double *>(view.buf));
+  } else {
+    transformToVector(transforms[0], static_cast<double *>(view.buf));
+  }
+  PyBuffer_Release(&view);
+  return array;
 }
 
-static PyObject *lookupTwistFullCore(PyObject *self, PyObject *args)
+static PyObject * lookupTransformCoreMatrix(PyObject * self, PyObject * args, PyObject * kw)
 {
-  tf2::BufferCore *bc = ((buffer_core_t*)self)->bc;
-  char *tracking_frame, *observation_frame, *reference_frame, *reference_point_frame;
-  builtin_interfaces::msg::Time time;
-  tf2::Duration averaging_interval;
-  double px, py, pz;
-
-  if (!PyArg_ParseTuple(args, "sss(ddd)sO&O&",
-                        &tracking_frame,
-                        &observation_frame,
-                        &reference_frame,
-                        &px, &py, &pz,
-                        &reference_point_frame,
-                        rostime_converter, &time,
-                        rosduration_converter, &averaging_interval))
+  return lookupTransformArray(self, args, kw, true);
+}
+
+static PyObject * lookupTransformCoreVector(PyObject * self, PyObject * args, PyObject * kw)
+{
+  return lookupTransformArray(self, args, kw, false);
+}
+
+static PyObject * lookupTransformsCoreMatrix(PyObject * self, PyObject * args, PyObject * kw)
+{
+  tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
+  char * target_frame, * source_frame;
+  std::vector<tf2::TimePoint> times;
+  static const char * keywords[] = {"target_frame", "source_frame", "times", nullptr};
+
+  if (!PyArg_ParseTupleAndKeywords(
+      args, kw, "ssO&",
+      const_cast<char **>(reinterpret_cast<const char **>(keywords)), &target_frame,
+      &source_frame, rostimes_converter, &times))
+  {
+    return nullptr;
+  }
+  std::vector<tf2::Transform> transforms;
+  std::vector<tf2::TimePoint> times_out;
+  WRAP(bc->lookupTransforms(target_frame, source_frame, times, transforms, times_out));
+
+  Py_buffer view;
+  PyObject * array = newDoubleArray(
+    {static_cast<Py_ssize_t>(transforms.size()), 4, 4}, &view);
+  if (!array) {
+    return nullptr;
+  }
+  double * out = static_cast<double *>(view.buf);
+  for (size_t i = 0; i < transforms.size(); ++i) {
+    transformToMatrix(transforms[i], out + i * 16);
+  }
+  PyBuffer_Release(&view);
+  return array;
+}
+
+static PyObject * transformPointsCore(PyObject * self, PyObject * args, PyObject * kw)
+{
+  tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
+  char * target_frame, * source_frame;
+  tf2::TimePoint time;
+  PyObject * points;
+  static const char * keywords[] =
+  {"target_frame", "source_frame", "time", "points", nullptr};
+
+  if (!PyArg_ParseTupleAndKeywords(
+      args, kw, "ssO&O",
+      const_cast<char **>(reinterpret_cast<const char **>(keywords)), &target_frame,
+      &source_frame, rostime_converter, &time, &points))
+  {
     return nullptr;
-  geometry_msgs::msg::Twist twist;
-  tf::Point pt(px, py, pz);
-  WRAP(twist = bc->lookupTwist(tracking_frame, observation_frame, reference_frame, pt, reference_point_frame, time, averaging_interval));
+  }
+
+  std::vector<tf2::Transform> transforms;
+  std::vector<tf2::TimePoint> times_out;
+  WRAP(bc->lookupTransforms(target_frame, source_frame, {time}, transforms, times_out));
+
+  Py_buffer in;
+  if (-1 == PyObject_GetBuffer(points, &in, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT)) {
+    return nullptr;
+  }
+  const std::string format = in.format ? in.format : "B";
+  if (in.itemsize != sizeof(double) || (format != "d" && format != "<d" && format != "=d") ||
+    in.ndim < 1 || in.shape[in.ndim - 1] != 3)
+  {
+    PyBuffer_Release(&in);
+    PyErr_SetString(PyExc_TypeError, "points must be a float64 array of shape (..., 3).");
+    return nullptr;
+  }
+
+  Py_buffer out;
+  PyObject * array = newDoubleArray(std::vector<Py_ssize_t>(in.shape, in.shape + in.ndim), &out);
+  if (!array) {
+    PyBuffer_Release(&in);
+    return nullptr;
+  }
+  const tf2::Transform & t = transforms[0];
+  const double * src = static_cast<const double *>(in.buf);
+  double * dst = static_cast<double *>(out.buf);
+  const size_t count = in.len / (3 * sizeof(double));
+  for (size_t i = 0; i < count; ++i) {
+    const tf2::Vector3 p = t * tf2::Vector3(src[i * 3], src[i * 3 + 1], src[i * 3 + 2]);
+    dst[i * 3] = p.x();
+    dst[i * 3 + 1] = p.y();
+    dst[i * 3 + 2] = p.z();
+  }
+  PyBuffer_Release(&out);
+  PyBuffer_Release(&in);
+  return array;
+}
+
+static PyObject * lookupVelocityCore(PyObject * self, PyObject * args, PyObject * kw)
+{
+  tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
+  char * tracking_frame, * observation_frame;
+  tf2::TimePoint time;
+  tf2::Duration averaging_interval;
+  static const char * keywords[] =
+  {"tracking_frame", "observation_frame", "time", "averaging_interval", nullptr};
 
-  return Py_BuildValue("(ddd)(ddd)",
-      twist.linear.x, twist.linear.y, twist.linear.z,
-      twist.angular.x, twist.angular.y, twist.angular.z);
+  if (!PyArg_ParseTupleAndKeywords(
+      args, kw, "ssO&O&",
+      const_cast<char **>(reinterpret_cast<const char **>(keywords)), &tracking_frame,
+      &observation_frame, rostime_converter, &time, rosduration_converter, &averaging_interval))
+  {
+    return nullptr;
+  }
+  tf2::Vector3 linear;
+  tf2::Vector3 angular;
+  tf2::TimePoint time_out;
+  WRAP(
+    bc->lookupVelocity(
+      tracking_frame, observation_frame, time, averaging_interval, linear, angular, time_out));
+
+  builtin_interfaces::msg::Time stamp = toMsg(time_out);
+  return Py_BuildValue(
+    "(ddd)(ddd)(iI)",
+    linear.x(), linear.y(), linear.z(),
+    angular.x(), angular.y(), angular.z(),
+    stamp.sec, stamp.nanosec);
 }
-*/
+
 static inline int checkTranslationType(PyObject * o)
 {
   PyTypeObject * translation_type =
@@ -653,19 +920,107 @@ static inline int checkRotationType(PyObject * o)
   return attr_check;
 }
 
-static PyObject * setTransform(PyObject * self, PyObject * args)
+// Reads a serialized tf2_msgs/TFMessage, as delivered by a raw rclpy subscription.
+// ROS 2 middlewares serialize it as plain CDR: a 4 byte encapsulation header naming the byte
+// order, then each field aligned to its own size, counted from the end of the header.
+class TFMessageReader
 {
-  PyObject * ret = nullptr;
-  tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
-  PyObject * py_transform;
-  char * authority;
-  tf2::TimePoint time;
+public:
+  TFMessageReader(const uint8_t * data, size_t size)
+  : data_(data), size_(size), offset_(4), swap_(false) {}
 
-  if (!PyArg_ParseTuple(args, "Os", &py_transform, &authority)) {
-    return nullptr;
+  // Returns true on success, or false with error set.
+  bool read(std::vector<geometry_msgs::msg::TransformStamped> & transforms, std::string & error)
+  {
+    if (size_ < 4 || data_[0] != 0 || data_[1] > 1) {
+      error = "data is not a CDR encapsulated TFMessage";
+      return false;
+    }
+    swap_ = (data_[1] == 1) != isLittleEndian();
+
+    uint32_t count;
+    if (!readPrimitive(count)) {
+      error = "TFMessage is truncated";
+      return false;
+    }
+    // Every transform needs at least 80 bytes, which also bounds the reservation below.
+    if (count > (size_ - offset_) / 80) {
+      error = "TFMessage is truncated";
+      return false;
+    }
+    transforms.resize(count);
+    for (auto & transform : transforms) {
+      if (!readPrimitive(transform.header.stamp.sec) ||
+        !readPrimitive(transform.header.stamp.nanosec) ||
+        !readString(transform.header.frame_id) ||
+        !readString(transform.child_frame_id) ||
+        !readPrimitive(transform.transform.translation.x) ||
+        !readPrimitive(transform.transform.translation.y) ||
+        !readPrimitive(transform.transform.translation.z) ||
+        !readPrimitive(transform.transform.rotation.x) ||
+        !readPrimitive(transform.transform.rotation.y) ||
+        !readPrimitive(transform.transform.rotation.z) ||
+        !readPrimitive(transform.transform.rotation.w))
+      {
+        error = "TFMessage is truncated";
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  static bool isLittleEndian()
+  {
+    const uint16_t one = 1;
+    uint8_t first;
+    std::memcpy(&first, &one, 1);
+    return first == 1;
   }
 
-  geometry_msgs::msg::TransformStamped transform;
+  template<class T>
+  bool readPrimitive(T & value)
+  {
+    // Alignment is relative to the end of the encapsulation header.
+    offset_ += (sizeof(T) - (offset_ - 4) % sizeof(T)) % sizeof(T);
+    if (offset_ > size_ || size_ - offset_ < sizeof(T)) {
+      return false;
+    }
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, data_ + offset_, sizeof(T));
+    if (swap_) {
+      std::reverse(bytes, bytes + sizeof(T));
+    }
+    std::memcpy(&value, bytes, sizeof(T));
+    offset_ += sizeof(T);
+    return true;
+  }
+
+  bool readString(std::string & value)
+  {
+    // The length counts the terminating null character.
+    uint32_t length;
+    if (!readPrimitive(length) || length == 0 || size_ - offset_ < length) {
+      return false;
+    }
+    value.assign(reinterpret_cast<const char *>(data_ + offset_), length - 1);
+    offset_ += length;
+    return true;
+  }
+
+  const uint8_t * data_;
+  size_t size_;
+  size_t offset_;
+  bool swap_;
+};
+
+// Fill transform from a Python TransformStamped. Returns 1 on success, or 0 with a Python
+// exception set.
+static int transformStampedFromPython(
+  PyObject * py_transform, geometry_msgs::msg::TransformStamped & transform)
+{
+  int ret = 0;
+  tf2::TimePoint time;
 
   PyObject * header = nullptr;
   PyObject * stamp = nullptr;
@@ -774,10 +1129,7 @@ static PyObject * setTransform(PyObject * self, PyObject * args)
   transform.transform.rotation.z = PyFloat_AsDouble(rz);
   transform.transform.rotation.w = PyFloat_AsDouble(rw);
 
-  bc->setTransform(transform, authority);
-
-  Py_INCREF(Py_None);
-  ret = Py_None;
+  ret = 1;
 
 cleanup:
   Py_XDECREF(rw);
@@ -798,149 +1150,218 @@ cleanup:
   return ret;
 }
 
-static PyObject * setTransformStatic(PyObject * self, PyObject * args)
+static PyObject * setTransform(PyObject * self, PyObject * args)
 {
-  PyObject * ret = nullptr;
   tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
   PyObject * py_transform;
   char * authority;
-  tf2::TimePoint time;
 
   if (!PyArg_ParseTuple(args, "Os", &py_transform, &authority)) {
     return nullptr;
   }
 
   geometry_msgs::msg::TransformStamped transform;
+  if (!transformStampedFromPython(py_transform, transform)) {
+    return nullptr;
+  }
 
-  PyObject * header = nullptr;
-  PyObject * stamp = nullptr;
-  PyObject * child_frame_id = nullptr;
-  PyObject * frame_id = nullptr;
-  PyObject * mtransform = nullptr;
-  PyObject * translation = nullptr;
-  PyObject * tx = nullptr;
-  PyObject * ty = nullptr;
-  PyObject * tz = nullptr;
-  PyObject * rotation = nullptr;
-  PyObject * rx = nullptr;
-  PyObject * ry = nullptr;
-  PyObject * rz = nullptr;
-  PyObject * rw = nullptr;
+  NOGIL(bc->setTransform(transform, authority));
 
-  header = PyObject_GetAttrString(py_transform, "header");
-  if (!header) {
-    goto cleanup;
-  }
-  stamp = PyObject_GetAttrString(header, "stamp");
-  if (!stamp) {
-    goto cleanup;
-  }
-  child_frame_id = PyObject_GetAttrString(py_transform, "child_frame_id");
-  if (!child_frame_id) {
-    goto cleanup;
-  }
-  frame_id = PyObject_GetAttrString(header, "frame_id");
-  if (!frame_id) {
-    goto cleanup;
-  }
-  mtransform = PyObject_GetAttrString(py_transform, "transform");
-  if (!mtransform) {
-    goto cleanup;
-  }
-  translation = PyObject_GetAttrString(mtransform, "translation");
-  if (!translation) {
-    goto cleanup;
-  }
-  tx = PyObject_GetAttrString(translation, "x");
-  if (!tx) {
-    goto cleanup;
+  Py_RETURN_NONE;
+}
+
+static PyObject * setTransformStatic(PyObject * self, PyObject * args)
+{
+  tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
+  PyObject * py_transform;
+  char * authority;
+
+  if (!PyArg_ParseTuple(args, "Os", &py_transform, &authority)) {
+    return nullptr;
   }
-  ty = PyObject_GetAttrString(translation, "y");
-  if (!ty) {
-    goto cleanup;
+
+  geometry_msgs::msg::TransformStamped transform;
+  if (!transformStampedFromPython(py_transform, transform)) {
+    return nullptr;
   }
-  tz = PyObject_GetAttrString(translation, "z");
-  if (!tz) {
-    goto cleanup;
+
+  // only difference to above is is_static == True
+  NOGIL(bc->setTransform(transform, authority, true));
+
+  Py_RETURN_NONE;
+}
+
+static PyObject * setTransformsImpl(PyObject * self, PyObject * args, bool is_static)
+{
+  tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
+  PyObject * py_transforms;
+  char * authority;
+
+  if (!PyArg_ParseTuple(args, "Os", &py_transforms, &authority)) {
+    return nullptr;
   }
-  rotation = PyObject_GetAttrString(mtransform, "rotation");
-  if (!rotation) {
-    goto cleanup;
+
+  PyObject * seq = PySequence_Fast(py_transforms, "transforms must be a sequence");
+  if (!seq) {
+    return nullptr;
   }
-  rx = PyObject_GetAttrString(rotation, "x");
-  if (!rx) {
-    goto cleanup;
+
+  Py_ssize_t size = PySequence_Fast_GET_SIZE(seq);
+  std::vector<geometry_msgs::msg::TransformStamped> transforms(size);
+  for (Py_ssize_t i = 0; i < size; ++i) {
+    if (!transformStampedFromPython(PySequence_Fast_GET_ITEM(seq, i), transforms[i])) {
+      Py_DECREF(seq);
+      return nullptr;
+    }
   }
-  ry = PyObject_GetAttrString(rotation, "y");
-  if (!ry) {
-    goto cleanup;
+  Py_DECREF(seq);
+
+  NOGIL(bc->setTransforms(transforms, authority, is_static));
+
+  Py_RETURN_NONE;
+}
+
+static PyObject * setTransforms(PyObject * self, PyObject * args)
+{
+  return setTransformsImpl(self, args, false);
+}
+
+static PyObject * setTransformsStatic(PyObject * self, PyObject * args)
+{
+  return setTransformsImpl(self, args, true);
+}
+
+static PyObject * setTransformsSerializedImpl(PyObject * self, PyObject * args, bool is_static)
+{
+  tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
+  Py_buffer data;
+  char * authority;
+
+  if (!PyArg_ParseTuple(args, "y*s", &data, &authority)) {
+    return nullptr;
   }
-  rz = PyObject_GetAttrString(rotation, "z");
-  if (!rz) {
-    goto cleanup;
+
+  // The message is decoded and inserted without creating any Python objects, so all of it
+  // runs without the GIL.
+  std::vector<geometry_msgs::msg::TransformStamped> transforms;
+  std::string error;
+  bool ok;
+  {
+    ScopedGILRelease release_gil;
+    ok = TFMessageReader(static_cast<const uint8_t *>(data.buf), data.len).read(transforms, error);
+    if (ok) {
+      bc->setTransforms(transforms, authority, is_static);
+    }
   }
-  rw = PyObject_GetAttrString(rotation, "w");
-  if (!rw) {
-    goto cleanup;
+  PyBuffer_Release(&data);
+
+  if (!ok) {
+    PyErr_SetString(PyExc_ValueError, error.c_str());
+    return nullptr;
   }
+  Py_RETURN_NONE;
+}
 
-  transform.child_frame_id = stringFromPython(child_frame_id);
-  transform.header.frame_id = stringFromPython(frame_id);
+static PyObject * setTransformsSerialized(PyObject * self, PyObject * args)
+{
+  return setTransformsSerializedImpl(self, args, false);
+}
 
-  if (rostime_converter(stamp, &time) != 1) {
-    goto cleanup;
+static PyObject * setTransformsStaticSerialized(PyObject * self, PyObject * args)
+{
+  return setTransformsSerializedImpl(self, args, true);
+}
+
+// Holds a Python callable for a BufferCore transformable request. BufferCore calls and
+// destroys its callbacks from whichever thread inserted the transform, which does not hold the
+// GIL, so both take it here.
+class PythonTransformableCallback
+{
+public:
+  explicit PythonTransformableCallback(PyObject * callable)
+  : callable_(callable)
+  {
+    Py_INCREF(callable_);
   }
-  transform.header.stamp = toMsg(time);
 
-  if (!checkTranslationType(translation)) {
-    PyErr_SetString(PyExc_TypeError, "transform.translation must be of type Vector3");
-    goto cleanup;
+  ~PythonTransformableCallback()
+  {
+    if (!Py_IsInitialized()) {
+      return;
+    }
+    PyGILState_STATE state = PyGILState_Ensure();
+    Py_DECREF(callable_);
+    PyGILState_Release(state);
   }
 
-  transform.transform.translation.x = PyFloat_AsDouble(tx);
-  transform.transform.translation.y = PyFloat_AsDouble(ty);
-  transform.transform.translation.z = PyFloat_AsDouble(tz);
+  PythonTransformableCallback(const PythonTransformableCallback &) = delete;
+  PythonTransformableCallback & operator=(const PythonTransformableCallback &) = delete;
 
-  if (!checkRotationType(rotation)) {
-    PyErr_SetString(PyExc_TypeError, "transform.rotation must be of type Quaternion");
-    goto cleanup;
-  }
+  void operator()(tf2::TransformableResult result) const
+  {
+    PyGILState_STATE state = PyGILState_Ensure();
+    PyObject * ret = PyObject_CallFunctionObjArgs(
+      callable_, result == tf2::TransformAvailable ? Py_True : Py_False, nullptr);
+    if (!ret) {
+      // There is no Python caller to raise into from the inserting thread.
+      PyErr_WriteUnraisable(callable_);
+    }
+    Py_XDECREF(ret);
+    PyGILState_Release(state);
+  }
+
+private:
+  PyObject * callable_;
+};
 
-  transform.transform.rotation.x = PyFloat_AsDouble(rx);
-  transform.transform.rotation.y = PyFloat_AsDouble(ry);
-  transform.transform.rotation.z = PyFloat_AsDouble(rz);
-  transform.transform.rotation.w = PyFloat_AsDouble(rw);
+static PyObject * addTransformableRequest(PyObject * self, PyObject * args, PyObject * kw)
+{
+  tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
+  PyObject * callback;
+  char * target_frame, * source_frame;
+  tf2::TimePoint time;
+  static const char * keywords[] =
+  {"callback", "target_frame", "source_frame", "time", nullptr};
 
-  // only difference to above is is_static == True
-  bc->setTransform(transform, authority, true);
+  if (!PyArg_ParseTupleAndKeywords(
+      args, kw, "OssO&",
+      const_cast<char **>(reinterpret_cast<const char **>(keywords)), &callback, &target_frame,
+      &source_frame, rostime_converter, &time))
+  {
+    return nullptr;
+  }
+  if (!PyCallable_Check(callback)) {
+    PyErr_SetString(PyExc_TypeError, "callback must be callable");
+    return nullptr;
+  }
 
-  Py_INCREF(Py_None);
-  ret = Py_None;
+  auto py_callback = std::make_shared<PythonTransformableCallback>(callback);
+  tf2::TransformableRequestHandle handle;
+  NOGIL(
+    handle = bc->addTransformableRequest(
+      [py_callback](tf2::TransformableRequestHandle, const std::string &, const std::string &,
+      tf2::TimePoint, tf2::TransformableResult result) {(*py_callback)(result);},
+      target_frame, source_frame, time));
+  return PyLong_FromUnsignedLongLong(handle);
+}
 
-cleanup:
-  Py_XDECREF(rw);
-  Py_XDECREF(rz);
-  Py_XDECREF(ry);
-  Py_XDECREF(rx);
-  Py_XDECREF(rotation);
-  Py_XDECREF(tz);
-  Py_XDECREF(ty);
-  Py_XDECREF(tx);
-  Py_XDECREF(translation);
-  Py_XDECREF(mtransform);
-  Py_XDECREF(frame_id);
-  Py_XDECREF(child_frame_id);
-  Py_XDECREF(stamp);
-  Py_XDECREF(header);
+static PyObject * cancelTransformableRequest(PyObject * self, PyObject * args)
+{
+  tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
+  unsigned long long handle;  // NOLINT(runtime/int)
 
-  return ret;
+  if (!PyArg_ParseTuple(args, "K", &handle)) {
+    return nullptr;
+  }
+  NOGIL(bc->cancelTransformableRequest(handle));
+  Py_RETURN_NONE;
 }
 
 static PyObject * clear(PyObject * self, PyObject * args)
 {
   (void)args;
   tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
-  bc->clear();
+  NOGIL(bc->clear());
   Py_RETURN_NONE;
 }
 
@@ -951,7 +1372,9 @@ static PyObject * _frameExists(PyObject * self, PyObject * args)
   if (!PyArg_ParseTuple(args, "s", &frame_id_str)) {
     return nullptr;
   }
-  return PyBool_FromLong(bc->_frameExists(frame_id_str));
+  bool exists;
+  NOGIL(exists = bc->_frameExists(frame_id_str));
+  return PyBool_FromLong(exists);
 }
 
 static PyObject * _getFrameStrings(PyObject * self, PyObject * args)
@@ -959,7 +1382,7 @@ static PyObject * _getFrameStrings(PyObject * self, PyObject * args)
   (void)args;
   tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
   std::vector<std::string> ids;
-  bc->_getFrameStrings(ids);
+  NOGIL(bc->_getFrameStrings(ids));
   return asListOfStrings(ids);
 }
 
@@ -974,7 +1397,9 @@ static PyObject * _allFramesAsDot(PyObject * self, PyObject * args, PyObject * k
   {
     return nullptr;
   }
-  return stringToPython(bc->_allFramesAsDot(time).c_str());
+  std::string dot;
+  NOGIL(dot = bc->_allFramesAsDot(time));
+  return stringToPython(dot);
 }
 
 
@@ -984,6 +1409,10 @@ static struct PyMethodDef buffer_core_methods[] =
   {"all_frames_as_string", allFramesAsString, METH_VARARGS, nullptr},
   {"set_transform", setTransform, METH_VARARGS, nullptr},
   {"set_transform_static", setTransformStatic, METH_VARARGS, nullptr},
+  {"set_transforms", setTransforms, METH_VARARGS, nullptr},
+  {"set_transforms_static", setTransformsStatic, METH_VARARGS, nullptr},
+  {"set_transforms_serialized", setTransformsSerialized, METH_VARARGS, nullptr},
+  {"set_transforms_static_serialized", setTransformsStaticSerialized, METH_VARARGS, nullptr},
   {"can_transform_core", (PyCFunction)canTransformCore, METH_VARARGS | METH_KEYWORDS, nullptr},
   {"can_transform_full_core", (PyCFunction)canTransformFullCore, METH_VARARGS | METH_KEYWORDS,
     nullptr},
@@ -993,12 +1422,23 @@ static struct PyMethodDef buffer_core_methods[] =
   {"_getFrameStrings", (PyCFunction)_getFrameStrings, METH_VARARGS, nullptr},
   {"_allFramesAsDot", (PyCFunction)_allFramesAsDot, METH_VARARGS | METH_KEYWORDS, nullptr},
   {"get_latest_common_time", (PyCFunction)getLatestCommonTime, METH_VARARGS, nullptr},
+  {"add_transformable_request", (PyCFunction)addTransformableRequest,
+    METH_VARARGS | METH_KEYWORDS, nullptr},
+  {"cancel_transformable_request", cancelTransformableRequest, METH_VARARGS, nullptr},
   {"lookup_transform_core", (PyCFunction)lookupTransformCore, METH_VARARGS | METH_KEYWORDS,
     nullptr},
   {"lookup_transform_full_core", (PyCFunction)lookupTransformFullCore, METH_VARARGS | METH_KEYWORDS,
     nullptr},
-  // {"lookupTwistCore", (PyCFunction)lookupTwistCore, METH_VARARGS | METH_KEYWORDS},
-  // {"lookupTwistFullCore", lookupTwistFullCore, METH_VARARGS},
+  {"lookup_transform_core_matrix", (PyCFunction)lookupTransformCoreMatrix,
+    METH_VARARGS | METH_KEYWORDS, nullptr},
+  {"lookup_transform_core_vector", (PyCFunction)lookupTransformCoreVector,
+    METH_VARARGS | METH_KEYWORDS, nullptr},
+  {"lookup_transforms_core_matrix", (PyCFunction)lookupTransformsCoreMatrix,
+    METH_VARARGS | METH_KEYWORDS, nullptr},
+  {"transform_points_core", (PyCFunction)transformPointsCore, METH_VARARGS | METH_KEYWORDS,
+    nullptr},
+  {"lookup_velocity_core", (PyCFunction)lookupVelocityCore, METH_VARARGS | METH_KEYWORDS,
+    nullptr},
   {nullptr, nullptr, 0, nullptr}
 };
 
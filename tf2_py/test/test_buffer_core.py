@@ -31,6 +31,7 @@
 import unittest
 
 from geometry_msgs.msg import TransformStamped
+import numpy
 import rclpy
 from rpyutils import add_dll_directories_from_env
 
@@ -119,6 +120,45 @@ class TestBufferClient(unittest.TestCase):
         )
         self.assertEqual(result, 1)
 
+    def test_set_transforms(self):
+        buffer_core = BufferCore()
+        transforms = [
+            build_transform('bar', 'foo', rclpy.time.Time().to_msg()),
+            build_transform('foo', 'baz', rclpy.time.Time().to_msg()),
+        ]
+
+        result = buffer_core.set_transforms(transforms, 'unittest')
+        self.assertEqual(result, None)
+
+        result, _ = buffer_core.can_transform_core(
+            target_frame='bar',
+            source_frame='baz',
+            time=rclpy.time.Time()
+        )
+        self.assertEqual(result, 1)
+
+    def test_set_transforms_static(self):
+        buffer_core = BufferCore()
+        transforms = [
+            build_transform('bar', 'foo', rclpy.time.Time().to_msg()),
+            build_transform('foo', 'baz', rclpy.time.Time().to_msg()),
+        ]
+
+        result = buffer_core.set_transforms_static(transforms, 'unittest')
+        self.assertEqual(result, None)
+
+        result, _ = buffer_core.can_transform_core(
+            target_frame='bar',
+            source_frame='baz',
+            time=rclpy.time.Time(seconds=0.5)
+        )
+        self.assertEqual(result, 1)
+
+    def test_set_transforms_invalid_sequence(self):
+        buffer_core = BufferCore()
+        with self.assertRaises(TypeError):
+            buffer_core.set_transforms(None, 'unittest')
+
     def test_can_transform_core_pass(self):
         buffer_core = BufferCore()
 
@@ -259,6 +299,111 @@ class TestBufferClient(unittest.TestCase):
 
         self.assertEqual(LookupException, type(ex.exception))
 
+    def test_lookup_transform_core_matrix(self):
+        buffer_core = BufferCore()
+
+        transform = build_transform(
+            'bar', 'foo', rclpy.time.Time(seconds=0).to_msg())
+        buffer_core.set_transform(transform, 'unittest')
+
+        matrix = buffer_core.lookup_transform_core_matrix(
+            target_frame='bar',
+            source_frame='foo',
+            time=rclpy.time.Time()
+        )
+
+        expected = numpy.identity(4)
+        expected[0, 3] = 2.0
+        self.assertEqual((4, 4), matrix.shape)
+        self.assertTrue(numpy.allclose(expected, matrix))
+
+    def test_lookup_transform_core_vector(self):
+        buffer_core = BufferCore()
+
+        transform = build_transform(
+            'bar', 'foo', rclpy.time.Time(seconds=0).to_msg())
+        buffer_core.set_transform(transform, 'unittest')
+
+        vector = buffer_core.lookup_transform_core_vector(
+            target_frame='bar',
+            source_frame='foo',
+            time=rclpy.time.Time()
+        )
+
+        self.assertTrue(numpy.allclose([2.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0], vector))
+
+    def test_lookup_transforms_core_matrix(self):
+        buffer_core = BufferCore()
+
+        for seconds in (1, 2):
+            transform = build_transform(
+                'bar', 'foo', rclpy.time.Time(seconds=seconds).to_msg())
+            transform.transform.translation.x = float(seconds)
+            buffer_core.set_transform(transform, 'unittest')
+
+        times = numpy.array([1000000000, 1500000000, 2000000000], dtype=numpy.int64)
+        matrices = buffer_core.lookup_transforms_core_matrix(
+            target_frame='bar',
+            source_frame='foo',
+            times=times
+        )
+
+        self.assertEqual((3, 4, 4), matrices.shape)
+        self.assertTrue(numpy.allclose([1.0, 1.5, 2.0], matrices[:, 0, 3]))
+
+        matrices = buffer_core.lookup_transforms_core_matrix(
+            target_frame='bar',
+            source_frame='foo',
+            times=[rclpy.time.Time(seconds=1), rclpy.time.Time(seconds=2)]
+        )
+        self.assertTrue(numpy.allclose([1.0, 2.0], matrices[:, 0, 3]))
+
+    def test_lookup_velocity_core(self):
+        buffer_core = BufferCore()
+
+        for seconds in (1, 2, 3):
+            transform = build_transform(
+                'bar', 'foo', rclpy.time.Time(seconds=seconds).to_msg())
+            transform.transform.translation.x = 2.0 * seconds
+            buffer_core.set_transform(transform, 'unittest')
+
+        linear, angular, stamp = buffer_core.lookup_velocity_core(
+            tracking_frame='foo',
+            observation_frame='bar',
+            time=rclpy.time.Time(seconds=2),
+            averaging_interval=rclpy.duration.Duration(seconds=1)
+        )
+
+        self.assertTrue(numpy.allclose([2.0, 0.0, 0.0], linear))
+        self.assertTrue(numpy.allclose([0.0, 0.0, 0.0], angular))
+        self.assertEqual((2, 0), stamp)
+
+    def test_transform_points_core(self):
+        buffer_core = BufferCore()
+
+        transform = build_transform(
+            'bar', 'foo', rclpy.time.Time(seconds=0).to_msg())
+        buffer_core.set_transform(transform, 'unittest')
+
+        points = numpy.array([[0.0, 0.0, 0.0], [1.0, 2.0, 3.0]])
+        transformed = buffer_core.transform_points_core(
+            target_frame='bar',
+            source_frame='foo',
+            time=rclpy.time.Time(),
+            points=points
+        )
+
+        self.assertEqual(points.shape, transformed.shape)
+        self.assertTrue(numpy.allclose([[2.0, 0.0, 0.0], [3.0, 2.0, 3.0]], transformed))
+
+        with self.assertRaises(TypeError):
+            buffer_core.transform_points_core(
+                target_frame='bar',
+                source_frame='foo',
+                time=rclpy.time.Time(),
+                points=numpy.zeros((2, 2))
+            )
+
 
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TF2_ROS__AGGREGATING_TRANSFORM_BROADCASTER_H_
+#define TF2_ROS__AGGREGATING_TRANSFORM_BROADCASTER_H_
+
+#include <tf2_ros/visibility_control.h>
+#include <tf2_ros/qos.hpp>
+#include <tf2_ros/transform_broadcaster.h>
+
+#include <rclcpp/create_timer.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <geometry_msgs/msg/transform_stamped.hpp>
+#include <tf2_msgs/msg/tf_message.hpp>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tf2_ros
+{
+
+/** \brief A TransformBroadcaster that coalesces the transforms sent during a window into one message
+ *
+ * Nodes that broadcast many frames from separate callbacks otherwise publish one TFMessage per
+ * call, and every listener pays the per-message overhead for each of them. This broadcaster
+ * holds the transforms back and publishes everything collected once per window, or whenever
+ * flush() is called. A child frame sent more than once within a window is only published with
+ * the value it was sent with last, so callers broadcasting above the window rate should expect
+ * listeners to see the lower rate.
+ */
+class AggregatingTransformBroadcaster
+{
+public:
+  /** \brief Constructor
+   * \param node The node to publish on, which also owns the flush timer
+   * \param window How long transforms are held back, measured on a steady clock.
+   *   Zero disables the timer, so transforms are only published by flush().
+   * \param qos The QoS of the /tf publisher
+   */
+  template<class NodePtr>
+  AggregatingTransformBroadcaster(
+    NodePtr node,
+    std::chrono::nanoseconds window,
+    const rclcpp::QoS & qos = DynamicBroadcasterQoS())
+  : broadcaster_(node, qos)
+  {
+    if (window > std::chrono::nanoseconds::zero()) {
+      flush_timer_ = rclcpp::create_timer(
+        node, std::make_shared<rclcpp::Clock>(RCL_STEADY_TIME),
+        rclcpp::Duration::from_nanoseconds(window.count()), [this]() {flush();});
+    }
+  }
+
+  /** \brief Publishes whatever is still pending */
+  TF2_ROS_PUBLIC
+  ~AggregatingTransformBroadcaster();
+
+  /** \brief Queue a TransformStamped to be sent with the next flush */
+  TF2_ROS_PUBLIC
+  void sendTransform(const geometry_msgs::msg::TransformStamped & transform);
+
+  /** \brief Queue several TransformStamped messages to be sent with the next flush */
+  TF2_ROS_PUBLIC
+  void sendTransform(const std::vector<geometry_msgs::msg::TransformStamped> & transforms);
+
+  /** \brief Publish all pending transforms as one TFMessage now
+   *
+   * Does nothing if no transform has been queued since the last flush.
+   */
+  TF2_ROS_PUBLIC
+  void flush();
+
+  /** \brief The number of distinct child frames waiting for the next flush */
+  TF2_ROS_PUBLIC
+  size_t getNumPending() const;
+
+private:
+  void queue(const geometry_msgs::msg::TransformStamped & transform);
+
+  TransformBroadcaster broadcaster_;
+  rclcpp::TimerBase::SharedPtr flush_timer_;
+
+  mutable std::mutex mutex_;
+  /// The message being collected, in the order child frames were first sent
+  tf2_msgs::msg::TFMessage pending_;
+  /// Position of each child frame in pending_.transforms
+  std::unordered_map<std::string, size_t> pending_index_;
+  /// The previously published message, kept so its storage is reused for the next window
+  tf2_msgs::msg::TFMessage sent_;
+};
+
+}  // namespace tf2_ros
+
+#endif  // TF2_ROS__AGGREGATING_TRANSFORM_BROADCASTER_H_
@@ -43,15 +43,86 @@
 #include <tf2_msgs/srv/frame_graph.hpp>
 #include <rclcpp/rclcpp.hpp>
 
+#include <atomic>
+#include <exception>
+#include <functional>
 #include <future>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
-#include <unordered_map>
+#include <utility>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+/// Defined when Buffer::transformAvailable() can be co_awaited
+#define TF2_ROS_HAS_COROUTINES 1
+#endif
+#endif
 
 namespace tf2_ros
 {
 
+/** \brief Receives the result of Buffer::waitForTransformResult()
+ *
+ * Called with the transform, or with a null transform and the exception the future of
+ * Buffer::waitForTransform() would hold.
+ */
+using TransformResultCallback = std::function<
+  void (const geometry_msgs::msg::TransformStamped *, std::exception_ptr)>;
+
+#ifdef TF2_ROS_HAS_COROUTINES
+class Buffer;
+
+/** \brief The awaitable returned by Buffer::transformAvailable()
+ *
+ * The coroutine is resumed on the thread that made the transform available or timed the wait
+ * out, or not suspended at all if the result is known right away. The result is kept in the
+ * awaiter, which lives in the coroutine frame, so no shared state is allocated for it.
+ */
+class TransformAwaiter
+{
+public:
+  TransformAwaiter(
+    Buffer & buffer, std::string target_frame, std::string source_frame, tf2::TimePoint time,
+    tf2::Duration timeout)
+  : buffer_(buffer), target_frame_(std::move(target_frame)),
+    source_frame_(std::move(source_frame)), time_(time), timeout_(timeout)
+  {
+  }
+
+  bool await_ready() const noexcept
+  {
+    return false;
+  }
+
+  /// Start the wait, returns false to carry on without suspending if it already completed
+  inline bool await_suspend(std::coroutine_handle<> handle);
+
+  /// The transform, or throws what waitForTransform() would have set on the future
+  geometry_msgs::msg::TransformStamped await_resume()
+  {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    return std::move(result_);
+  }
+
+private:
+  Buffer & buffer_;
+  std::string target_frame_;
+  std::string source_frame_;
+  tf2::TimePoint time_;
+  tf2::Duration timeout_;
+  std::coroutine_handle<> handle_;
+  geometry_msgs::msg::TransformStamped result_;
+  std::exception_ptr error_;
+  /// Set by whichever of await_suspend() and the result comes second resumes the coroutine
+  std::atomic<bool> second_{false};
+};
+#endif
+
 /** \brief Standard implementation of the tf2_ros::BufferInterface abstract data type.
  *
  * Inherits tf2_ros::BufferInterface and tf2::BufferCore.
@@ -62,6 +133,7 @@ class Buffer : public BufferInterface, public AsyncBufferInterface, public tf2::
 {
 public:
   using tf2::BufferCore::lookupTransform;
+  using tf2::BufferCore::lookupTransforms;
   using tf2::BufferCore::canTransform;
 
   /** \brief  Constructor for a Buffer object
@@ -142,6 +214,22 @@ public:
       fixed_frame, fromRclcpp(timeout));
   }
 
+  /** \brief Get the transforms from one frame into several target frames.
+   * \param target_frames The frames to which data should be transformed
+   * \param source_frame The frame where the data originated
+   * \param time The time at which the value of the transforms is desired. (0 will get the latest)
+   * \param timeout How long to block before failing, shared by all of the targets
+   * \return The transform into each of the target frames, in the same order
+   *
+   * Possible exceptions tf2::LookupException, tf2::ConnectivityException,
+   * tf2::ExtrapolationException, tf2::InvalidArgumentException
+   */
+  TF2_ROS_PUBLIC
+  std::vector<geometry_msgs::msg::TransformStamped>
+  lookupTransforms(
+    const std::vector<std::string> & target_frames, const std::string & source_frame,
+    const tf2::TimePoint & time, const tf2::Duration timeout) const override;
+
   /** \brief Test if a transform is possible
    * \param target_frame The frame into which to transform
    * \param source_frame The frame from which to transform
@@ -252,6 +340,35 @@ public:
       callback);
   }
 
+  /** \brief waitForTransform() without a future
+   *
+   * callback is called exactly once: from this call if the result is known right away, otherwise
+   * from the thread that inserted the transform or timed the wait out. Skipping the future saves
+   * allocating its shared state for every wait.
+   */
+  TF2_ROS_PUBLIC
+  void
+  waitForTransformResult(
+    const std::string & target_frame, const std::string & source_frame,
+    const tf2::TimePoint & time, const tf2::Duration & timeout,
+    TransformResultCallback callback);
+
+#ifdef TF2_ROS_HAS_COROUTINES
+  /** \brief Wait for a transform from a C++20 coroutine
+   *
+   * `co_await buffer.transformAvailable(target, source, time, timeout)` gives the transform or
+   * throws the exception the future of waitForTransform() would hold, without blocking a thread
+   * while waiting.
+   */
+  TransformAwaiter
+  transformAvailable(
+    const std::string & target_frame, const std::string & source_frame,
+    const tf2::TimePoint & time, const tf2::Duration & timeout)
+  {
+    return TransformAwaiter(*this, target_frame, source_frame, time, timeout);
+  }
+#endif
+
   TF2_ROS_PUBLIC
   inline void
   setCreateTimerInterface(CreateTimerInterface::SharedPtr create_timer_interface)
@@ -260,11 +377,31 @@ public:
   }
 
 private:
-  void timerCallback(
-    const TimerHandle & timer_handle,
-    std::shared_ptr<std::promise<geometry_msgs::msg::TransformStamped>> promise,
-    TransformStampedFuture future,
-    TransformReadyCallback callback);
+  struct PendingWait;
+  using WaitDeadlines = std::multimap<int64_t, std::shared_ptr<PendingWait>>;
+
+  /// \brief A waitForTransformResult() call that has not completed yet
+  struct PendingWait
+  {
+    TransformResultCallback callback;
+    /// Set by whichever of the transformable request and the timeout completes the wait first
+    std::atomic<bool> done{false};
+    /// The rest is guarded by wait_deadlines_mutex_
+    tf2::TransformableRequestHandle request_handle = 0;
+    bool queued = false;
+    WaitDeadlines::iterator deadline;
+  };
+
+  /// Fires when the earliest deadline in wait_deadlines_ passes
+  void deadlineTimerCallback(const TimerHandle & timer_handle);
+
+  /// Make sure deadline_timer_ fires for the earliest deadline, called with wait_deadlines_mutex_
+  void armDeadlineTimer();
+
+  /// Look the transform up if it is available and pass it or the error on to callback
+  void completeWait(
+    const TransformResultCallback & callback, const std::string & target_frame,
+    const std::string & source_frame, tf2::TimePoint time, bool available);
 
   bool getFrames(
     const tf2_msgs::srv::FrameGraph::Request::SharedPtr req,
@@ -290,11 +427,16 @@ private:
   /// \brief Interface for creating timers
   CreateTimerInterface::SharedPtr timer_interface_;
 
-  /// \brief A map from active timers to BufferCore request handles
-  std::unordered_map<TimerHandle, tf2::TransformableRequestHandle> timer_to_request_map_;
+  /// \brief Pending waitForTransform() calls ordered by deadline in nanoseconds of clock_
+  WaitDeadlines wait_deadlines_;
+
+  /// \brief The single timer serving wait_deadlines_, and the deadline it was armed for
+  TimerHandle deadline_timer_ = 0;
+  bool deadline_timer_active_ = false;
+  int64_t deadline_timer_deadline_ = 0;
 
-  /// \brief A mutex on the timer_to_request_map_ data
-  std::mutex timer_to_request_map_mutex_;
+  /// \brief A mutex on wait_deadlines_ and deadline_timer_, never held while calling BufferCore
+  std::mutex wait_deadlines_mutex_;
 
   /// \brief Reference to a jump handler registered to the clock
   rclcpp::JumpHandler::SharedPtr jump_handler_;
@@ -305,6 +447,27 @@ static const char threading_error[] = "Do not call canTransform or lookupTransfo
   "always timeout.  If you have a separate thread servicing tf messages, call "
   "setUsingDedicatedThread(true) on your Buffer instance.";
 
+#ifdef TF2_ROS_HAS_COROUTINES
+bool TransformAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+  handle_ = handle;
+  buffer_.waitForTransformResult(
+    target_frame_, source_frame_, time_, timeout_,
+    [this](const geometry_msgs::msg::TransformStamped * transform, std::exception_ptr error) {
+      if (transform) {
+        result_ = *transform;
+      } else {
+        error_ = error;
+      }
+      if (second_.exchange(true)) {
+        handle_.resume();
+      }
+    });
+  // The result may already be in, then there is no need to suspend
+  return !second_.exchange(true);
+}
+#endif
+
 }  // namespace tf2_ros
 
 #endif  // TF2_ROS__BUFFER_H_
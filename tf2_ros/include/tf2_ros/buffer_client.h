@@ -38,16 +38,32 @@
 #ifndef TF2_ROS__BUFFER_CLIENT_H_
 #define TF2_ROS__BUFFER_CLIENT_H_
 
+#include <tf2_ros/async_buffer_interface.h>
 #include <tf2_ros/buffer_interface.h>
 #include <tf2_ros/visibility_control.h>
+#include <tf2/buffer_core.h>
 #include <tf2/time.h>
 
 #include <geometry_msgs/msg/transform_stamped.hpp>
 #include <rclcpp_action/rclcpp_action.hpp>
 #include <tf2_msgs/action/lookup_transform.hpp>
+#include <tf2_msgs/action/lookup_transforms.hpp>
+#include <tf2_msgs/msg/tf2_error.hpp>
+#include <tf2_msgs/msg/tf_message.hpp>
+#include <tf2_msgs/msg/transform_request.hpp>
+#include <tf2_msgs/srv/stream_transforms.hpp>
 
+#include <cstdint>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 namespace tf2_ros
 {
@@ -104,33 +120,81 @@ public:
   }
 };
 
+/// How a BufferClient answers repeated lookups without asking the BufferServer
+struct BufferClientCacheOptions
+{
+  /// Keep the results of up to this many lookups at a non zero time, 0 disables the cache
+  size_t capacity = 0;
+  /** \brief Stream every frame pair looked up from the TransformStreamServer below the namespace
+   *   into a local buffer, and answer later lookups of the pair from it when it can.
+   *
+   * The local buffer only holds the transform of the whole pair sampled at rate, so lookups
+   * between samples interpolate the end to end transform, and latest time lookups may be up to a
+   * sample period old.
+   */
+  bool prefetch = false;
+  /// How often the server samples each prefetched pair, in Hz
+  double prefetch_rate = 10.0;
+  /// How much history the local buffers keep
+  tf2::Duration prefetch_cache_time = tf2::durationFromSec(10.0);
+};
+
+/// Counters of the lookups a BufferClient answered locally
+struct BufferClientCacheStats
+{
+  /// Lookups answered by the result cache
+  uint64_t hits = 0;
+  /// Lookups answered by a prefetched local buffer
+  uint64_t prefetch_hits = 0;
+  /// Lookups answered by the BufferServer
+  uint64_t misses = 0;
+};
+
 /** \brief Action client-based implementation of the tf2_ros::BufferInterface abstract data type.
  *
  * BufferClient uses actions to coordinate waiting for available transforms.
  *
  * You can use this class with a tf2_ros::BufferServer and tf2_ros::TransformListener in a separate process.
+ *
+ * As an AsyncBufferInterface it can back a tf2_ros::MessageFilter, which then relies on the
+ * answers to its waits alone.
  */
-class BufferClient : public BufferInterface
+class BufferClient : public BufferInterface, public AsyncBufferInterface
 {
 public:
   using LookupTransformAction = tf2_msgs::action::LookupTransform;
+  using LookupTransformsAction = tf2_msgs::action::LookupTransforms;
+  using TransformsFuture = std::shared_future<std::vector<geometry_msgs::msg::TransformStamped>>;
 
   /** \brief BufferClient constructor
    * \param node The node to add the buffer client to
    * \param ns The namespace in which to look for a BufferServer
    * \param check_frequency The frequency in Hz to check whether the BufferServer has completed a request
    * \param timeout_padding The amount of time to allow passed the desired timeout on the client side for communication lag
+   * \param cache_options Whether repeated lookups are answered locally, disabled by default
    */
   template<typename NodePtr>
   BufferClient(
     NodePtr node,
     const std::string ns,
     const double & check_frequency = 10.0,
-    const tf2::Duration & timeout_padding = tf2::durationFromSec(2.0))
+    const tf2::Duration & timeout_padding = tf2::durationFromSec(2.0),
+    const BufferClientCacheOptions & cache_options = BufferClientCacheOptions())
   : check_frequency_(check_frequency),
-    timeout_padding_(timeout_padding)
+    timeout_padding_(timeout_padding),
+    cache_options_(cache_options)
   {
     client_ = rclcpp_action::create_client<LookupTransformAction>(node, ns);
+    batch_client_ = rclcpp_action::create_client<LookupTransformsAction>(node, ns + "/batch");
+    if (cache_options_.prefetch) {
+      stream_client_ = rclcpp::create_client<tf2_msgs::srv::StreamTransforms>(
+        node->get_node_base_interface(), node->get_node_graph_interface(),
+        node->get_node_services_interface(), ns + "/stream", rmw_qos_profile_services_default,
+        nullptr);
+      node_topics_ = node->get_node_topics_interface();
+    }
+    node_base_ = node->get_node_base_interface();
+    node_timers_ = node->get_node_timers_interface();
   }
 
   virtual ~BufferClient() = default;
@@ -199,6 +263,98 @@ public:
     const std::string & fixed_frame,
     const tf2::Duration timeout = tf2::durationFromSec(0.0)) const override;
 
+  /** \brief Send a lookup without waiting for the answer.
+   *
+   * Any number of lookups can be in flight at once. The future is completed from the executor
+   * spinning the node the client was created with, so the BufferClient must outlive it.
+   *
+   * \param target_frame The frame to which data should be transformed
+   * \param source_frame The frame where the data originated
+   * \param time The time at which the value of the transform is desired. (0 will get the latest)
+   * \param timeout How long the server should wait for the transform. The future fails with a
+   *   tf2::TimeoutException if no result arrived within timeout plus the timeout padding.
+   * \return A future for the transform, which rethrows the exceptions lookupTransform() would
+   */
+  TF2_ROS_PUBLIC
+  TransformStampedFuture
+  lookupTransformAsync(
+    const std::string & target_frame,
+    const std::string & source_frame,
+    const tf2::TimePoint & time,
+    const tf2::Duration timeout = tf2::durationFromSec(0.0)) const;
+
+  /** \brief Send a lookup assuming a fixed frame without waiting for the answer.
+   * \sa lookupTransformAsync(const std::string &, const std::string &, const tf2::TimePoint &,
+   *                          const tf2::Duration)
+   */
+  TF2_ROS_PUBLIC
+  TransformStampedFuture
+  lookupTransformAsync(
+    const std::string & target_frame,
+    const tf2::TimePoint & target_time,
+    const std::string & source_frame,
+    const tf2::TimePoint & source_time,
+    const std::string & fixed_frame,
+    const tf2::Duration timeout = tf2::durationFromSec(0.0)) const;
+
+  /** \brief lookupTransformAsync() that also calls callback once the future is ready
+   *
+   * The server waits up to timeout for the transform, so unlike tf2_ros::Buffer no timer
+   * interface needs to be set.
+   */
+  TF2_ROS_PUBLIC
+  TransformStampedFuture
+  waitForTransform(
+    const std::string & target_frame,
+    const std::string & source_frame,
+    const tf2::TimePoint & time,
+    const tf2::Duration & timeout,
+    TransformReadyCallback callback) override;
+
+  /** \brief Get many transforms in a single round trip to the BufferServer.
+   *
+   * The server answers once all of the lookups can be done or the timeout expires.
+   *
+   * \param requests The lookups to do
+   * \param timeout How long the server should wait for the transforms
+   * \param[out] errors If not null, filled with the error of each lookup instead of throwing
+   * \return The transform for each of the requests, in the same order
+   *
+   * \throws tf2::TransformException The error of the first failed lookup, if errors is null
+   * \throws tf2_ros::LookupTransformGoalException If the batch goal itself failed
+   */
+  TF2_ROS_PUBLIC
+  std::vector<geometry_msgs::msg::TransformStamped>
+  lookupTransforms(
+    const std::vector<tf2_msgs::msg::TransformRequest> & requests,
+    const tf2::Duration timeout = tf2::durationFromSec(0.0),
+    std::vector<tf2_msgs::msg::TF2Error> * errors = nullptr) const;
+
+  /** \brief Send a batch of lookups without waiting for the answer.
+   *
+   * Several batches can be in flight at once, so a caller can pipeline the lookups it will
+   * need for the next cycles. The BufferClient must outlive the returned futures.
+   *
+   * \param requests The lookups to do
+   * \param timeout How long the server should wait for the transforms
+   * \return A future for the transforms, which rethrows the exceptions lookupTransforms() would
+   */
+  TF2_ROS_PUBLIC
+  TransformsFuture
+  lookupTransformsAsync(
+    const std::vector<tf2_msgs::msg::TransformRequest> & requests,
+    const tf2::Duration timeout = tf2::durationFromSec(0.0)) const;
+
+  /** \brief Get the transforms from one frame into several target frames in one round trip.
+   * \sa lookupTransforms(const std::vector<tf2_msgs::msg::TransformRequest>&, const tf2::Duration,
+   *                      std::vector<tf2_msgs::msg::TF2Error>*)
+   */
+  TF2_ROS_PUBLIC
+  std::vector<geometry_msgs::msg::TransformStamped>
+  lookupTransforms(
+    const std::vector<std::string> & target_frames, const std::string & source_frame,
+    const tf2::TimePoint & time, const tf2::Duration timeout) const override;
+
   /** \brief Test if a transform is possible
    * \param target_frame The frame into which to transform
    * \param source_frame The frame from which to transform
@@ -247,16 +403,70 @@ public:
     return client_->wait_for_action_server(timeout);
   }
 
+  /// Counters of the lookups answered locally, all zero unless the cache options enabled it
+  TF2_ROS_PUBLIC
+  BufferClientCacheStats getCacheStats() const;
+
+  /// Forget the cached results, the prefetched pairs keep streaming
+  TF2_ROS_PUBLIC
+  void clearCache();
+
 private:
+  using CacheKey = std::tuple<std::string, std::string, tf2::TimePoint>;
+
+  struct PrefetchedPair
+  {
+    std::shared_ptr<tf2::BufferCore> buffer;
+    rclcpp::Subscription<tf2_msgs::msg::TFMessage>::SharedPtr subscription;
+  };
+
+  /// A goal sent by lookupTransformAsync() that has not been answered yet
+  struct PendingGoal;
+
   geometry_msgs::msg::TransformStamped
   processGoal(const LookupTransformAction::Goal & goal) const;
 
+  TransformStampedFuture
+  processGoalAsync(
+    const LookupTransformAction::Goal & goal, TransformReadyCallback callback) const;
+
+  /// Answer goal from the result cache or a prefetched buffer, if the cache options allow it
+  bool lookupLocal(
+    const LookupTransformAction::Goal & goal,
+    geometry_msgs::msg::TransformStamped & transform) const;
+
+  /// Remember the result of goal, and start prefetching its frame pair
+  void storeLocal(
+    const LookupTransformAction::Goal & goal,
+    const geometry_msgs::msg::TransformStamped & transform) const;
+
+  /// Ask the server to stream the pair, called with cache_mutex_ held
+  void requestStream(const std::string & target_frame, const std::string & source_frame) const;
+
   geometry_msgs::msg::TransformStamped
   processResult(const LookupTransformAction::Result::SharedPtr & result) const;
 
+  void processError(const tf2_msgs::msg::TF2Error & error) const;
+
   rclcpp_action::Client<LookupTransformAction>::SharedPtr client_;
+  rclcpp_action::Client<LookupTransformsAction>::SharedPtr batch_client_;
   double check_frequency_;
   tf2::Duration timeout_padding_;
+
+  BufferClientCacheOptions cache_options_;
+  rclcpp::Client<tf2_msgs::srv::StreamTransforms>::SharedPtr stream_client_;
+  rclcpp::node_interfaces::NodeTopicsInterface::SharedPtr node_topics_;
+  /// Create the timeout timers of lookupTransformAsync()
+  rclcpp::node_interfaces::NodeBaseInterface::SharedPtr node_base_;
+  rclcpp::node_interfaces::NodeTimersInterface::SharedPtr node_timers_;
+  /// Guards everything below, lookups are const but may be called from several threads
+  mutable std::mutex cache_mutex_;
+  /// Cached results, the most recently used first
+  mutable std::list<std::pair<CacheKey, geometry_msgs::msg::TransformStamped>> cache_;
+  mutable std::map<CacheKey, decltype(cache_)::iterator> cache_index_;
+  /// The pairs streamed into local buffers, by target and source frame
+  mutable std::map<std::pair<std::string, std::string>, PrefetchedPair> prefetched_;
+  mutable BufferClientCacheStats cache_stats_;
 };
 }  // namespace tf2_ros
 
@@ -42,10 +42,14 @@
 #include <geometry_msgs/msg/transform_stamped.hpp>
 #include <rclcpp/rclcpp.hpp>
 
+#include <algorithm>
 #include <chrono>
 #include <functional>
 #include <future>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace tf2_ros
 {
@@ -162,6 +166,70 @@ public:
     const std::string & source_frame, const tf2::TimePoint & source_time,
     const std::string & fixed_frame, const tf2::Duration timeout) const = 0;
 
+  /** \brief Get the transforms from one frame into several target frames.
+   * \param target_frames The frames to which data should be transformed
+   * \param source_frame The frame where the data originated
+   * \param time The time at which the value of the transforms is desired. (0 will get the latest)
+   * \param timeout How long to block before failing
+   * \return The transform into each of the target frames, in the same order
+   *
+   * The default implementation looks up each target in turn, implementations that hold the
+   * tree share the part of the walk the targets have in common.
+   *
+   * Possible exceptions tf2::LookupException, tf2::ConnectivityException,
+   * tf2::ExtrapolationException, tf2::InvalidArgumentException
+   */
+  TF2_ROS_PUBLIC
+  virtual std::vector<geometry_msgs::msg::TransformStamped>
+  lookupTransforms(
+    const std::vector<std::string> & target_frames, const std::string & source_frame,
+    const tf2::TimePoint & time, const tf2::Duration timeout) const
+  {
+    std::vector<geometry_msgs::msg::TransformStamped> transforms;
+    transforms.reserve(target_frames.size());
+    for (const std::string & target_frame : target_frames) {
+      transforms.push_back(lookupTransform(target_frame, source_frame, time, timeout));
+    }
+    return transforms;
+  }
+
+  /** \brief Get the transforms from one frame at several times into a target frame (advanced).
+   * \param target_frame The frame to which data should be transformed
+   * \param target_time The time to which the data should be transformed. (0 will get the latest)
+   * \param source_frame The frame where the data originated
+   * \param source_times The times at which the source_frame should be evaluated
+   * \param fixed_frame The frame in which to assume the transform is constant in time.
+   * \param timeout How long to block for the newest of the source times, the others are looked
+   *   up without waiting once it is available
+   * \return The transform at each of the source times, in the same order
+   *
+   * Possible exceptions tf2::LookupException, tf2::ConnectivityException,
+   * tf2::ExtrapolationException, tf2::InvalidArgumentException
+   */
+  TF2_ROS_PUBLIC
+  virtual std::vector<geometry_msgs::msg::TransformStamped>
+  lookupTransformsAtTimes(
+    const std::string & target_frame, const tf2::TimePoint & target_time,
+    const std::string & source_frame, const std::vector<tf2::TimePoint> & source_times,
+    const std::string & fixed_frame, const tf2::Duration timeout) const
+  {
+    std::vector<geometry_msgs::msg::TransformStamped> transforms(source_times.size());
+    if (source_times.empty()) {
+      return transforms;
+    }
+    const size_t newest = static_cast<size_t>(
+      std::max_element(source_times.begin(), source_times.end()) - source_times.begin());
+    transforms[newest] = lookupTransform(
+      target_frame, target_time, source_frame, source_times[newest], fixed_frame, timeout);
+    for (size_t i = 0; i < source_times.size(); ++i) {
+      if (i != newest) {
+        transforms[i] = lookupTransform(
+          target_frame, target_time, source_frame, source_times[i], fixed_frame,
+          tf2::Duration::zero());
+      }
+    }
+    return transforms;
+  }
 
   /** \brief Test if a transform is possible
    * \param target_frame The frame into which to transform
@@ -238,6 +306,72 @@ public:
     return this->transform(in, out, target_frame, timeout);
   }
 
+  /** \brief Transform an input the caller no longer needs into the target frame.
+   * The input is transformed in place with the two argument tf2::doTransform() and moved into
+   * the result, so types that specialize it, such as point clouds, are never copied.
+   * \tparam T The type of the object to transform.
+   * \param in The object to transform, which is moved from.
+   * \param target_frame The string identifer for the frame to transform into.
+   * \param timeout How long to wait for the target frame. Default value is zero (no blocking).
+   * \return The transformed output.
+   */
+  template<class T, typename = typename std::enable_if<
+      !std::is_lvalue_reference<T>::value && !std::is_const<T>::value>::type>
+  T transform(
+    T && in,
+    const std::string & target_frame, tf2::Duration timeout = tf2::durationFromSec(0.0)) const
+  {
+    tf2::doTransform(
+      in, lookupTransform(target_frame, tf2::getFrameId(in), tf2::getTimestamp(in), timeout));
+    return std::move(in);
+  }
+
+  /** \brief Transform an input into several target frames.
+   * The transforms into all of the targets are looked up together with lookupTransforms(), so
+   * targets such as map, odom and base_link only walk the links they have in common once.
+   * \tparam T The type of the object to transform.
+   * \param in The object to transform.
+   * \param target_frames The string identifers for the frames to transform into.
+   * \param timeout How long to wait for the target frames. Default value is zero (no blocking).
+   * \param parallel Whether to apply the transforms on worker threads, one per target beyond
+   *   the first. Only worth it when doTransform() is expensive, such as for point clouds.
+   * \return The transformed outputs, in the order of target_frames.
+   */
+  template<class T>
+  std::vector<T> transform(
+    const T & in, const std::vector<std::string> & target_frames,
+    tf2::Duration timeout = tf2::durationFromSec(0.0), bool parallel = false) const
+  {
+    std::vector<geometry_msgs::msg::TransformStamped> transforms =
+      lookupTransforms(target_frames, tf2::getFrameId(in), tf2::getTimestamp(in), timeout);
+    std::vector<T> out(transforms.size());
+    if (!parallel || transforms.size() < 2) {
+      for (size_t i = 0; i < transforms.size(); ++i) {
+        tf2::doTransform(in, out[i], transforms[i]);
+      }
+      return out;
+    }
+
+    std::vector<std::future<void>> workers;
+    workers.reserve(transforms.size() - 1);
+    for (size_t i = 1; i < transforms.size(); ++i) {
+      workers.push_back(
+        std::async(
+          std::launch::async, [&in, &out, &transforms, i]() {
+            tf2::doTransform(in, out[i], transforms[i]);
+          }));
+    }
+    tf2::doTransform(in, out[0], transforms[0]);
+    // Rethrows the first failure, after all of the workers are done with the outputs
+    for (std::future<void> & worker : workers) {
+      worker.wait();
+    }
+    for (std::future<void> & worker : workers) {
+      worker.get();
+    }
+    return out;
+  }
+
   /** \brief Transform an input into the target frame and convert to a specified output type.
    * It is templated on two types: the type of the input object and the type of the
    * transformed output.
@@ -320,6 +454,32 @@ public:
     return this->transform(in, out, target_frame, target_time, fixed_frame, timeout);
   }
 
+  /** \brief Transform an input the caller no longer needs into the target frame (advanced).
+   * The input is transformed in place with the two argument tf2::doTransform() and moved into
+   * the result, so types that specialize it, such as point clouds, are never copied.
+   * \tparam T The type of the object to transform.
+   * \param in The object to transform, which is moved from.
+   * \param target_frame The string identifer for the frame to transform into.
+   * \param target_time The time into which to transform
+   * \param fixed_frame The frame in which to treat the transform as constant in time.
+   * \param timeout How long to wait for the target frame. Default value is zero (no blocking).
+   * \return The transformed output.
+   */
+  template<class T, typename = typename std::enable_if<
+      !std::is_lvalue_reference<T>::value && !std::is_const<T>::value>::type>
+  T transform(
+    T && in,
+    const std::string & target_frame, const tf2::TimePoint & target_time,
+    const std::string & fixed_frame, tf2::Duration timeout = tf2::durationFromSec(0.0)) const
+  {
+    tf2::doTransform(
+      in, lookupTransform(
+        target_frame, target_time,
+        tf2::getFrameId(in), tf2::getTimestamp(in),
+        fixed_frame, timeout));
+    return std::move(in);
+  }
+
   /** \brief Transform an input into the target frame and convert to a specified output type (advanced).
    * It is templated on two types: the type of the input object and the type of the
    * transformed output.
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TF2_ROS__BUFFER_METRICS_PUBLISHER_H_
+#define TF2_ROS__BUFFER_METRICS_PUBLISHER_H_
+
+#include <tf2/buffer_core.h>
+#include <tf2/time.h>
+#include <tf2_ros/visibility_control.h>
+
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
+#include <rclcpp/rclcpp.hpp>
+
+#include <string>
+
+namespace tf2_ros
+{
+/** \brief Publishes the metrics of a buffer as diagnostics.
+ *
+ * Enables the metrics of the buffer and periodically publishes them on /diagnostics as a single
+ * DiagnosticStatus: call counts, failures by cause and latencies of lookups, canTransform and
+ * inserts, how long inserts waited for and held the frame lock, the pending transformable
+ * requests, the history length of each dynamic frame, the memory taken up by the buffer and
+ * each frame, see tf2::BufferCore::memoryStats(), and the transforms rejected by frame,
+ * authority and reason. Counts are totals since the publisher was created.
+ */
+class BufferMetricsPublisher
+{
+public:
+  /** \brief Constructor
+   * \param buffer The buffer to report on, must outlive the publisher.
+   * \param node The node to add the publisher and timer to.
+   * \param name The name of the DiagnosticStatus, prefixed with the node name.
+   * \param period How often the metrics are published.
+   */
+  template<typename NodePtr>
+  BufferMetricsPublisher(
+    tf2::BufferCore & buffer,
+    NodePtr node,
+    const std::string & name = "tf2 buffer",
+    tf2::Duration period = tf2::durationFromSec(1.0))
+  : buffer_(buffer),
+    name_(std::string(node->get_name()) + ": " + name)
+  {
+    buffer_.setMetricsEnabled(true);
+    clock_ = node->get_clock();
+    publisher_ = rclcpp::create_publisher<diagnostic_msgs::msg::DiagnosticArray>(
+      node->get_node_topics_interface(), "/diagnostics", rclcpp::QoS(1));
+    timer_ = rclcpp::create_timer(
+      node->get_node_base_interface(), node->get_node_timers_interface(), clock_,
+      rclcpp::Duration(period), [this]() {publishMetrics();});
+  }
+
+  /** \brief Publish the current metrics right away */
+  TF2_ROS_PUBLIC
+  void publishMetrics();
+
+private:
+  tf2::BufferCore & buffer_;
+  std::string name_;
+  rclcpp::Clock::SharedPtr clock_;
+  rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr publisher_;
+  rclcpp::TimerBase::SharedPtr timer_;
+};
+
+}  // namespace tf2_ros
+
+#endif  // TF2_ROS__BUFFER_METRICS_PUBLISHER_H_
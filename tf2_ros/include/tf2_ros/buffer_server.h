@@ -39,6 +39,7 @@
 #define TF2_ROS__BUFFER_SERVER_H_
 
 #include <tf2/time.h>
+#include <tf2/buffer_core.h>
 #include <tf2/buffer_core_interface.h>
 #include <tf2_ros/visibility_control.h>
 
@@ -47,12 +48,19 @@
 #include <rclcpp/rclcpp.hpp>
 #include <rclcpp_action/rclcpp_action.hpp>
 #include <tf2_msgs/action/lookup_transform.hpp>
+#include <tf2_msgs/action/lookup_transforms.hpp>
+#include <tf2_msgs/msg/tf2_error.hpp>
+#include <tf2_msgs/msg/transform_request.hpp>
 
+#include <cstdint>
 #include <functional>
-#include <list>
 #include <memory>
 #include <mutex>
+#include <queue>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace tf2_ros
 {
@@ -65,13 +73,19 @@ class BufferServer
 {
   using LookupTransformAction = tf2_msgs::action::LookupTransform;
   using GoalHandle = std::shared_ptr<rclcpp_action::ServerGoalHandle<LookupTransformAction>>;
+  using LookupTransformsAction = tf2_msgs::action::LookupTransforms;
+  using BatchGoalHandle =
+    std::shared_ptr<rclcpp_action::ServerGoalHandle<LookupTransformsAction>>;
 
 public:
   /** \brief Constructor
    * \param buffer The Buffer that this BufferServer will wrap.
    * \param node The node to add the buffer server to.
-   * \param ns The namespace in which to look for action clients.
-   * \param check_period How often to check for changes to known transforms (via a timer event).
+   * \param ns The namespace in which to look for action clients. Batches of lookups are served
+   *   on the "batch" action below it.
+   * \param check_period How often to check for expired goals (via a timer event). Goals are
+   *   completed as soon as their transforms arrive when the buffer is a tf2::BufferCore, other
+   *   buffers are also checked for new transforms at this period.
    */
   template<typename NodePtr>
   BufferServer(
@@ -80,6 +94,8 @@ public:
     const std::string & ns,
     tf2::Duration check_period = tf2::durationFromSec(0.01))
   : buffer_(buffer),
+    // Registering transformable requests does not change the transforms held by the buffer
+    buffer_core_(const_cast<tf2::BufferCore *>(dynamic_cast<const tf2::BufferCore *>(&buffer))),
     logger_(node->get_logger())
   {
     server_ = rclcpp_action::create_server<LookupTransformAction>(
@@ -88,18 +104,34 @@ public:
       std::bind(&BufferServer::goalCB, this, std::placeholders::_1, std::placeholders::_2),
       std::bind(&BufferServer::cancelCB, this, std::placeholders::_1),
       std::bind(&BufferServer::acceptedCB, this, std::placeholders::_1));
+    batch_server_ = rclcpp_action::create_server<LookupTransformsAction>(
+      node,
+      ns + "/batch",
+      std::bind(&BufferServer::batchGoalCB, this, std::placeholders::_1, std::placeholders::_2),
+      std::bind(&BufferServer::batchCancelCB, this, std::placeholders::_1),
+      std::bind(&BufferServer::batchAcceptedCB, this, std::placeholders::_1));
 
     check_timer_ = rclcpp::create_timer(
       node, node->get_clock(), check_period, std::bind(&BufferServer::checkTransforms, this));
     RCLCPP_DEBUG(logger_, "Buffer server started");
   }
 
+  TF2_ROS_PUBLIC
+  ~BufferServer();
+
 private:
+  /// A goal of either action that is waiting for its transforms or its deadline
   struct GoalInfo
   {
-    GoalHandle handle;
+    GoalHandle handle;  ///< Set for LookupTransform goals
+    BatchGoalHandle batch_handle;  ///< Set for LookupTransforms goals
     tf2::TimePoint end_time;
+    /// Transformable requests that have not called back yet, plus one while they are added
+    size_t outstanding = 0;
+    std::vector<tf2::TransformableRequestHandle> requests;
   };
+  using GoalInfoPtr = std::shared_ptr<GoalInfo>;
+  using Deadline = std::pair<tf2::TimePoint, uint64_t>;
 
   TF2_ROS_PUBLIC
   rclcpp_action::GoalResponse goalCB(
@@ -111,19 +143,61 @@ private:
   TF2_ROS_PUBLIC
   rclcpp_action::CancelResponse cancelCB(GoalHandle gh);
 
+  TF2_ROS_PUBLIC
+  rclcpp_action::GoalResponse batchGoalCB(
+    const rclcpp_action::GoalUUID & uuid,
+    std::shared_ptr<const LookupTransformsAction::Goal> goal);
+
+  TF2_ROS_PUBLIC
+  void batchAcceptedCB(BatchGoalHandle gh);
+
+  TF2_ROS_PUBLIC
+  rclcpp_action::CancelResponse batchCancelCB(BatchGoalHandle gh);
+
+  /// Expire the goals whose deadline passed, and complete polled goals that became possible
   TF2_ROS_PUBLIC
   void checkTransforms();
 
+  /// Track a goal until all of the requests are transformable or its deadline passes
+  TF2_ROS_PUBLIC
+  void addGoal(
+    const GoalInfoPtr & info, const std::vector<tf2_msgs::msg::TransformRequest> & requests);
+
+  /// Called back by the buffer when one of the transformable requests of a goal is done
+  TF2_ROS_PUBLIC
+  void transformableCB(uint64_t goal_id);
+
+  TF2_ROS_PUBLIC
+  void cancelRequests(const GoalInfo & info);
+
+  TF2_ROS_PUBLIC
+  void finishGoal(const GoalInfo & info, bool timed_out);
+
+  TF2_ROS_PUBLIC
+  bool canTransformAll(const GoalInfo & info);
+
+  /// Look up every request of the batch, filling in an error for each one that fails
+  TF2_ROS_PUBLIC
+  void completeBatch(BatchGoalHandle gh);
+
   TF2_ROS_PUBLIC
-  bool canTransform(GoalHandle gh);
+  bool canTransform(const tf2_msgs::msg::TransformRequest & request);
 
   TF2_ROS_PUBLIC
-  geometry_msgs::msg::TransformStamped lookupTransform(GoalHandle gh);
+  void lookupTransform(
+    const tf2_msgs::msg::TransformRequest & request,
+    geometry_msgs::msg::TransformStamped & transform, tf2_msgs::msg::TF2Error & error);
 
   const tf2::BufferCoreInterface & buffer_;
+  /// Set when buffer_ is a tf2::BufferCore, which completes goals as soon as their data arrives
+  tf2::BufferCore * buffer_core_;
   rclcpp::Logger logger_;
   rclcpp_action::Server<LookupTransformAction>::SharedPtr server_;
-  std::list<GoalInfo> active_goals_;
+  rclcpp_action::Server<LookupTransformsAction>::SharedPtr batch_server_;
+  std::unordered_map<uint64_t, GoalInfoPtr> active_goals_;
+  /// Goal deadlines, entries of goals that already finished are skipped when they come up
+  std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines_;
+  uint64_t next_goal_id_ = 1;
   std::mutex mutex_;
   rclcpp::TimerBase::SharedPtr check_timer_;
 };
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TF2_ROS__COMPACT_TRANSFORM_LISTENER_H_
+#define TF2_ROS__COMPACT_TRANSFORM_LISTENER_H_
+
+#include <tf2/buffer_core.h>
+#include <tf2/compact_tf.h>
+#include <tf2_ros/buffer_interface.h>
+#include <tf2_ros/qos.hpp>
+#include <tf2_ros/visibility_control.h>
+
+#include <rclcpp/rclcpp.hpp>
+#include <tf2_msgs/msg/compact_tf_message.hpp>
+
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace tf2_ros
+{
+
+/** \brief Copy a packet of a tf2::CompactTFEncoder into the message that carries it */
+inline void toMsg(const tf2::CompactTFPacket & packet, tf2_msgs::msg::CompactTFMessage & msg)
+{
+  msg.dictionary_epoch = packet.dictionary_epoch;
+  msg.dictionary_offset = packet.dictionary_offset;
+  msg.new_frames = packet.new_frames;
+  msg.base_stamp = toMsg(packet.base_stamp);
+  msg.translation_resolution = packet.translation_resolution;
+  msg.data = packet.data;
+}
+
+/** \brief Copy a received message into a packet for a tf2::CompactTFDecoder */
+inline void fromMsg(const tf2_msgs::msg::CompactTFMessage & msg, tf2::CompactTFPacket & packet)
+{
+  packet.dictionary_epoch = msg.dictionary_epoch;
+  packet.dictionary_offset = msg.dictionary_offset;
+  packet.new_frames = msg.new_frames;
+  packet.base_stamp = fromMsg(msg.base_stamp);
+  packet.translation_resolution = msg.translation_resolution;
+  packet.data = msg.data;
+}
+
+/** \brief Fills a buffer from /tf_compact and /tf_static_compact
+ *
+ * The counterpart of TransformListener for links that carry tf2_msgs/CompactTFMessage, as
+ * published by the compact_tf_bridge node.  Records are decoded straight into the buffer, no
+ * TransformStamped is built for them.  The node is not spun by the listener.
+ */
+class CompactTransformListener
+{
+public:
+  template<class NodeT>
+  CompactTransformListener(
+    tf2::BufferCore & buffer,
+    NodeT && node,
+    const rclcpp::QoS & qos = DynamicListenerQoS(),
+    const rclcpp::QoS & static_qos = StaticListenerQoS())
+  : buffer_(buffer)
+  {
+    node_logging_interface_ = node->get_node_logging_interface();
+    subscription_ = rclcpp::create_subscription<tf2_msgs::msg::CompactTFMessage>(
+      node, "/tf_compact", qos,
+      [this](tf2_msgs::msg::CompactTFMessage::ConstSharedPtr msg) {
+        subscription_callback(*msg, false);
+      });
+    static_subscription_ = rclcpp::create_subscription<tf2_msgs::msg::CompactTFMessage>(
+      node, "/tf_static_compact", static_qos,
+      [this](tf2_msgs::msg::CompactTFMessage::ConstSharedPtr msg) {
+        subscription_callback(*msg, true);
+      });
+  }
+
+  /// Counters of the /tf_compact decoder
+  TF2_ROS_PUBLIC
+  tf2::CompactTFDecoderStats getStats() const;
+
+  /// Counters of the /tf_static_compact decoder
+  TF2_ROS_PUBLIC
+  tf2::CompactTFDecoderStats getStaticStats() const;
+
+private:
+  TF2_ROS_PUBLIC
+  void subscription_callback(const tf2_msgs::msg::CompactTFMessage & msg, bool is_static);
+
+  tf2::BufferCore & buffer_;
+  /// Guards the decoders and packet_, the two subscriptions may run on different threads
+  mutable std::mutex mutex_;
+  /// Each topic has an encoder of its own on the sending side
+  tf2::CompactTFDecoder decoder_;
+  tf2::CompactTFDecoder static_decoder_;
+  /// Reused between messages
+  tf2::CompactTFPacket packet_;
+  rclcpp::Subscription<tf2_msgs::msg::CompactTFMessage>::SharedPtr subscription_;
+  rclcpp::Subscription<tf2_msgs::msg::CompactTFMessage>::SharedPtr static_subscription_;
+  rclcpp::node_interfaces::NodeLoggingInterface::SharedPtr node_logging_interface_;
+};
+
+}  // namespace tf2_ros
+
+#endif  // TF2_ROS__COMPACT_TRANSFORM_LISTENER_H_
@@ -37,16 +37,20 @@
 #include <message_filters/simple_filter.h>
 #include <tf2/buffer_core_interface.h>
 #include <tf2/time.h>
+#include <tf2/tracing.h>
 #include <tf2_ros/async_buffer_interface.h>
 #include <tf2_ros/buffer.h>
 
 #include <builtin_interfaces/msg/time.hpp>
+#include <geometry_msgs/msg/transform_stamped.hpp>
 #include <rclcpp/rclcpp.hpp>
 
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
 #include <functional>
-#include <list>
+#include <limits>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <ratio>
@@ -54,6 +58,8 @@
 #include <string>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #define TF2_ROS_MESSAGEFILTER_DEBUG(fmt, ...) \
@@ -132,7 +138,12 @@ public:
  *
  * The callbacks used in this class are of the same form as those used by rclcpp's message callbacks.
  *
- * MessageFilter is templated on a message type.
+ * MessageFilter is templated on a message type and on the buffer, which by default is a
+ * tf2_ros::Buffer.  Buffers derived from tf2::BufferCore are checked by FrameHandle, other
+ * tf2::BufferCoreInterface buffers by frame name.  A buffer that only implements
+ * tf2_ros::AsyncBufferInterface, like tf2_ros::BufferClient, is not asked again: a message is
+ * ready once the waits for all of its transforms succeeded, with the transforms they returned.
+ * BufferClient sends buffer_timeout along with each goal, so pass a finite one.
  *
  * \section example_usage Example Usage
  *
@@ -149,6 +160,11 @@ class MessageFilter : public MessageFilterBase, public message_filters::SimpleFi
 public:
   using MConstPtr = std::shared_ptr<M const>;
   typedef message_filters::MessageEvent<M const> MEvent;
+  /// Receives a ready message with its transform into each target frame, in setTargetFrames() order
+  using TransformsCallback = std::function<
+    void (const MConstPtr &, const std::vector<geometry_msgs::msg::TransformStamped> &)>;
+  /// Runs a task of the filter, on any thread
+  using DispatchFunction = std::function<void (std::function<void ()>)>;
 
   /**
    * \brief Constructor
@@ -168,9 +184,6 @@ public:
   : MessageFilter(buffer, target_frame, queue_size, node->get_node_logging_interface(),
       node->get_node_clock_interface(), buffer_timeout)
   {
-    static_assert(
-      std::is_base_of<tf2::BufferCoreInterface, BufferT>::value,
-      "Buffer type must implement tf2::BufferCoreInterface");
     static_assert(
       std::is_base_of<tf2_ros::AsyncBufferInterface, BufferT>::value,
       "Buffer type must implement tf2_ros::AsyncBufferInterface");
@@ -270,6 +283,10 @@ public:
   {
     message_connection_.disconnect();
     clear();
+    {
+      std::unique_lock<std::mutex> lock(dispatch_mutex_);
+      dispatch_done_.wait(lock, [this]() {return dispatched_tasks_ == 0;});
+    }
 
     TF2_ROS_MESSAGEFILTER_DEBUG(
       "Successful Transforms: %llu, Discarded due to age: %llu, Transform messages received: %llu, "
@@ -302,6 +319,8 @@ public:
     std::transform(
       target_frames.begin(), target_frames.end(),
       target_frames_.begin(), this->stripSlash);
+    target_frame_handles_.assign(
+      IsBufferCore::value ? target_frames_.size() : 0, tf2::FrameHandle());
     expected_success_count_ = target_frames_.size() * (time_tolerance_.nanoseconds() ? 2 : 1);
 
     std::stringstream ss;
@@ -339,7 +358,10 @@ public:
 
     TF2_ROS_MESSAGEFILTER_DEBUG("%s", "Cleared");
 
-    messages_.clear();
+    for (; head_id_ != next_message_id_; ++head_id_) {
+      messages_[slot(head_id_)] = MessageInfo();
+    }
+    num_queued_ = 0;
 
     warned_about_empty_frame_id_ = false;
   }
@@ -354,16 +376,19 @@ public:
     const MConstPtr & message = evt.getMessage();
     std::string frame_id = stripSlash(mt::FrameId<M>::value(*message));
     rclcpp::Time stamp = mt::TimeStamp<M>::value(*message);
+    TF2_TRACEPOINT(message_filter_add, this, frame_id.c_str(), stamp.nanoseconds());
 
     if (frame_id.empty()) {
       messageDropped(evt, filter_failure_reasons::EmptyFrameID);
       return;
     }
 
-    std::vector<std::tuple<uint64_t, tf2::TimePoint, std::string>> wait_params;
-    // iterate through the target frames and add requests for each of them
-    MessageInfo info;
-    info.handles.reserve(expected_success_count_);
+    // iterate through the target frames and collect the transforms this message needs, along
+    // with the index of the target frame for those at the stamp and an index past any for those
+    // at the stamp plus the time tolerance
+    std::vector<std::tuple<std::string, tf2::TimePoint, size_t>> needed;
+    needed.reserve(expected_success_count_);
+    size_t num_targets;
     {
       V_string target_frames_copy;
       // Copy target_frames_ to avoid deadlock from #79
@@ -372,51 +397,82 @@ public:
         target_frames_copy = target_frames_;
       }
 
-      V_string::iterator it = target_frames_copy.begin();
-      V_string::iterator end = target_frames_copy.end();
-      for (; it != end; ++it) {
-        const std::string & target_frame = *it;
-        wait_params.emplace_back(
-          next_handle_index_, tf2::timeFromSec(stamp.seconds()), target_frame);
-        info.handles.push_back(next_handle_index_++);
+      num_targets = target_frames_copy.size();
+      for (size_t i = 0; i < num_targets; ++i) {
+        const std::string & target_frame = target_frames_copy[i];
+        needed.emplace_back(target_frame, tf2::timeFromSec(stamp.seconds()), i);
 
         if (time_tolerance_.nanoseconds()) {
-          wait_params.emplace_back(
-            next_handle_index_,
-            tf2::timeFromSec((stamp + time_tolerance_).seconds()),
-            target_frame);
-          info.handles.push_back(next_handle_index_++);
+          needed.emplace_back(
+            target_frame, tf2::timeFromSec((stamp + time_tolerance_).seconds()),
+            std::numeric_limits<size_t>::max());
         }
       }
     }
 
+    // Requests for waits that no queued message has asked for yet
+    std::vector<std::tuple<uint64_t, tf2::TimePoint, std::string>> wait_params;
+    const rclcpp::Time now = node_clock_->get_clock()->now();
     {
       // Keep a lock on the messages
       std::unique_lock<std::mutex> unique_lock(messages_mutex_);
 
-      // If this message is about to push us past our queue size, erase the oldest message
-      if (queue_size_ != 0 && messages_.size() + 1 > queue_size_) {
+      // If this message is about to push us past our queue size, erase the oldest message.
+      // That also happens when the oldest message is so far behind that the ring has no slot
+      // left for this one.
+      if ((queue_size_ != 0 && num_queued_ + 1 > queue_size_) || !reserveSlot()) {
         ++dropped_message_count_;
-        const MessageInfo & front = messages_.front();
+        MessageInfo & front = messages_[slot(head_id_)];
         TF2_ROS_MESSAGEFILTER_DEBUG(
           "Removed oldest message because buffer is full, count now %d (frame_id=%s, stamp=%f)",
-          messages_.size(),
+          num_queued_,
           (mt::FrameId<M>::value(*front.event.getMessage())).c_str(),
           mt::TimeStamp<M>::value(*front.event.getMessage()).seconds());
 
         messageDropped(front.event, filter_failure_reasons::QueueFull);
-
-        messages_.pop_front();
+        dequeue(front);
+        reserveSlot();
       }
 
-      // Add the message to our list
+      // Add the message to the ring
+      MessageInfo & info = messages_[slot(next_message_id_)];
       info.event = evt;
-      messages_.push_back(info);
+      info.id = next_message_id_++;
+      info.success_count = 0;
+      info.queued = true;
+      info.failed = false;
+      if (!HasLookups::value) {
+        info.transforms.assign(num_targets, geometry_msgs::msg::TransformStamped());
+      }
+      ++num_queued_;
+
+      // Messages that need the same transform share a single wait for it, as long as that
+      // leaves them about as long to wait as buffer_timeout_
+      for (const auto & need : needed) {
+        const std::string & target_frame = std::get<0>(need);
+        const tf2::TimePoint & time = std::get<1>(need);
+        WaitKey key(target_frame, frame_id, time);
+        auto key_it = wait_handles_.find(key);
+        if (key_it != wait_handles_.end() && !canJoin(waits_[key_it->second], now)) {
+          // The messages already waiting keep the old wait, later ones get the new one
+          waits_[key_it->second].key = wait_handles_.end();
+          wait_handles_.erase(key_it);
+          key_it = wait_handles_.end();
+        }
+        if (key_it == wait_handles_.end()) {
+          key_it = wait_handles_.emplace(key, next_handle_index_).first;
+          waits_[next_handle_index_].key = key_it;
+          waits_[next_handle_index_].started = now;
+          wait_params.emplace_back(next_handle_index_, time, target_frame);
+          ++next_handle_index_;
+        }
+        waits_[key_it->second].waiters.emplace_back(info.id, std::get<2>(need));
+      }
     }
 
     TF2_ROS_MESSAGEFILTER_DEBUG(
       "Added message in frame %s at time %.3f, count now %d",
-      frame_id.c_str(), stamp.seconds(), messages_.size());
+      frame_id.c_str(), stamp.seconds(), num_queued_);
     ++incoming_message_count_;
 
     for (const auto & param : wait_params) {
@@ -455,6 +511,33 @@ public:
   }
 #endif
 
+  /**
+   * \brief Register a callback that gets each ready message together with its transforms
+   *
+   * The filter looks the transforms up at the message stamp while checking that the message is
+   * ready, so the callback does not need to look them up again.
+   */
+  void registerTransformsCallback(const TransformsCallback & callback)
+  {
+    std::unique_lock<std::mutex> lock(transforms_callbacks_mutex_);
+    transforms_callbacks_.push_back(callback);
+  }
+
+  /** \brief Check and signal ready messages through dispatch instead of inline
+   *
+   * Messages otherwise become ready on the thread that made their transforms available, often
+   * the one a TransformListener inserts /tf on, so slow callbacks would hold up transform
+   * ingestion. dispatch is handed one task per batch of messages that became ready together and
+   * may run it on any thread, for example by posting it to a thread pool or an executor.
+   * Messages are only signalled in order if dispatch runs the tasks in order. The destructor
+   * waits for the tasks already handed out. Pass nullptr to signal inline again.
+   */
+  void setDispatcher(DispatchFunction dispatch)
+  {
+    std::unique_lock<std::mutex> lock(dispatch_mutex_);
+    dispatch_ = std::move(dispatch);
+  }
+
   virtual void setQueueSize(uint32_t new_queue_size)
   {
     queue_size_ = new_queue_size;
@@ -480,75 +563,125 @@ private:
 
   void transformReadyCallback(const tf2_ros::TransformStampedFuture & future, const uint64_t handle)
   {
-    namespace mt = message_filters::message_traits;
+    // The buffer hands over the transform it looked up for the request, keep it so the check
+    // below does not have to look that target frame up again
+    bool transform_available = true;
+    geometry_msgs::msg::TransformStamped staged;
+    try {
+      staged = future.get();
+    } catch (...) {
+      transform_available = false;
+    }
 
-    MEvent saved_event;
-    bool event_found = false;
+    std::vector<ReadyMessage> ready_messages;
 
     {
       // We will be accessing and mutating messages now, require unique lock
       std::unique_lock<std::mutex> lock(messages_mutex_);
 
-      // find the message this request is associated with
-      typename L_MessageInfo::iterator msg_it = messages_.begin();
-      typename L_MessageInfo::iterator msg_end = messages_.end();
-
-      for (; msg_it != msg_end; ++msg_it) {
-        MessageInfo & info = *msg_it;
-        auto handle_it = std::find(info.handles.begin(), info.handles.end(), handle);
-        if (handle_it != info.handles.end()) {
-          // found msg_it
-          ++info.success_count;
-          if (info.success_count >= expected_success_count_) {
-            saved_event = msg_it->event;
-            messages_.erase(msg_it);
-            event_found = true;
+      // find the messages waiting on this request
+      auto wait_it = waits_.find(handle);
+      if (wait_it == waits_.end()) {
+        return;
+      }
+      for (const auto & waiter : wait_it->second.waiters) {
+        MessageInfo * info = findQueued(waiter.first);
+        if (!info) {
+          // Dropped or cleared in the meantime
+          continue;
+        }
+        if (!HasLookups::value) {
+          // The waits are all there is to go by, keep what each of them found
+          if (!transform_available) {
+            info->failed = true;
+          } else if (waiter.second < info->transforms.size()) {
+            info->transforms[waiter.second] = staged;
           }
-          break;
+        }
+        ++info->success_count;
+        if (info->success_count >= expected_success_count_) {
+          ready_messages.emplace_back();
+          ready_messages.back().event = info->event;
+          ready_messages.back().transforms.swap(info->transforms);
+          ready_messages.back().failed = info->failed;
+          dequeue(*info);
         }
       }
+      if (wait_it->second.key != wait_handles_.end()) {
+        wait_handles_.erase(wait_it->second.key);
+      }
+      waits_.erase(wait_it);
+    }
+
+    if (ready_messages.empty()) {
+      return;
     }
 
-    if (!event_found) {
+    DispatchFunction dispatch;
+    {
+      std::unique_lock<std::mutex> lock(dispatch_mutex_);
+      dispatch = dispatch_;
+      if (dispatch) {
+        ++dispatched_tasks_;
+      }
+    }
+    if (!dispatch) {
+      for (const ReadyMessage & ready : ready_messages) {
+        checkAndSignal(ready, transform_available, &staged);
+      }
       return;
     }
+    dispatch(
+      [this, ready_messages, transform_available, staged]() {
+        for (const ReadyMessage & ready : ready_messages) {
+          checkAndSignal(ready, transform_available, &staged);
+        }
+        std::unique_lock<std::mutex> lock(dispatch_mutex_);
+        if (--dispatched_tasks_ == 0) {
+          dispatch_done_.notify_all();
+        }
+      });
+  }
+
+  /// A message whose waits are all done, taken out of the ring
+  struct ReadyMessage
+  {
+    MEvent event;
+    /// What the waits found, only kept unless HasLookups
+    std::vector<geometry_msgs::msg::TransformStamped> transforms;
+    bool failed = false;
+  };
 
+  /// Signal the message if all of its transforms are still possible, or drop it
+  /**
+   * \param staged A transform already looked up for one of the target frames, or NULL.
+   *   It stands in for the lookup of the target frame and stamp it was made for.
+   */
+  void checkAndSignal(
+    const ReadyMessage & ready, bool transform_available,
+    const geometry_msgs::msg::TransformStamped * staged = NULL)
+  {
+    namespace mt = message_filters::message_traits;
+
+    const MEvent & saved_event = ready.event;
     bool can_transform = true;
     const MConstPtr & message = saved_event.getMessage();
     std::string frame_id = stripSlash(mt::FrameId<M>::value(*message));
     rclcpp::Time stamp = mt::TimeStamp<M>::value(*message);
 
-    bool transform_available = true;
-    FilterFailureReason error = filter_failure_reasons::Unknown;
-    try {
-      future.get();
-    } catch (...) {
-      transform_available = false;
-      error = filter_failure_reasons::OutTheBack;
-    }
-
-    if (transform_available) {
-      std::unique_lock<std::mutex> frames_lock(target_frames_mutex_);
-      // make sure we can still perform all the necessary transforms
-      typename V_string::iterator it = target_frames_.begin();
-      typename V_string::iterator end = target_frames_.end();
-      for (; it != end; ++it) {
-        const std::string & target = *it;
-        if (!buffer_.canTransform(target, frame_id, tf2::timeFromSec(stamp.seconds()), NULL)) {
-          can_transform = false;
-          break;
-        }
+    FilterFailureReason error = transform_available ?
+      filter_failure_reasons::Unknown : filter_failure_reasons::OutTheBack;
 
-        if (time_tolerance_.nanoseconds()) {
-          if (!buffer_.canTransform(
-              target, frame_id,
-              tf2::timeFromSec((stamp + time_tolerance_).seconds()), NULL))
-          {
-            can_transform = false;
-            break;
-          }
-        }
-      }
+    bool want_transforms;
+    {
+      std::unique_lock<std::mutex> lock(transforms_callbacks_mutex_);
+      want_transforms = !transforms_callbacks_.empty();
+    }
+    std::vector<geometry_msgs::msg::TransformStamped> transforms;
+
+    if (transform_available && !ready.failed) {
+      can_transform = checkTransforms(
+        ready, frame_id, stamp, staged, want_transforms, transforms, HasLookups());
     } else {
       can_transform = false;
     }
@@ -556,20 +689,148 @@ private:
     if (can_transform) {
       TF2_ROS_MESSAGEFILTER_DEBUG(
         "Message ready in frame %s at time %.3f, count now %d",
-        frame_id.c_str(), stamp.seconds(), messages_.size());
+        frame_id.c_str(), stamp.seconds(), num_queued_);
 
       ++successful_transform_count_;
       messageReady(saved_event);
+      if (want_transforms) {
+        signalTransforms(saved_event, transforms);
+      }
     } else {
       ++dropped_message_count_;
 
       TF2_ROS_MESSAGEFILTER_DEBUG(
         "Discarding message in frame %s at time %.3f, count now %d",
-        frame_id.c_str(), stamp.seconds(), messages_.size());
+        frame_id.c_str(), stamp.seconds(), num_queued_);
       messageDropped(saved_event, error);
     }
   }
 
+  /** \brief Buffers that hold the tree themselves are looked up by FrameHandle
+   *
+   * The frame names are then only looked up once and not for every target frame and time.
+   * Any other buffer, a tf2::BufferCoreInterface wrapping one for example, is looked up by name.
+   * The overloads taking a std::true_type are only instantiated for tf2::BufferCore.
+   */
+  using IsBufferCore = std::is_base_of<tf2::BufferCore, BufferT>;
+  /// Buffers that can be asked synchronously, the others only through their waits
+  using HasLookups = std::is_base_of<tf2::BufferCoreInterface, BufferT>;
+
+  /// Make sure all the transforms of a message are still possible, looking them up if wanted
+  bool checkTransforms(
+    const ReadyMessage &, const std::string & frame_id, const rclcpp::Time & stamp,
+    const geometry_msgs::msg::TransformStamped * staged, bool want_transforms,
+    std::vector<geometry_msgs::msg::TransformStamped> & transforms, std::true_type)
+  {
+    std::unique_lock<std::mutex> frames_lock(target_frames_mutex_);
+    tf2::FrameHandle source;
+    for (size_t i = 0; i < target_frames_.size(); ++i) {
+      if (target_frames_[i] == frame_id) {
+        // Same as canTransform by name, no need for the frame to exist
+        if (want_transforms) {
+          transforms.emplace_back();
+          transforms.back().header.stamp = stamp;
+          transforms.back().header.frame_id = frame_id;
+          transforms.back().child_frame_id = frame_id;
+          transforms.back().transform.rotation.w = 1.0;
+        }
+        continue;
+      }
+
+      resolveFrames(i, frame_id, source, IsBufferCore());
+      if (staged && staged->header.frame_id == target_frames_[i] &&
+        staged->child_frame_id == frame_id &&
+        rclcpp::Time(staged->header.stamp).nanoseconds() == stamp.nanoseconds())
+      {
+        // Looked up by the buffer when the request for this target became transformable
+        if (want_transforms) {
+          transforms.push_back(*staged);
+        }
+      } else if (want_transforms) {
+        // Looking the transform up doubles as the check that it is possible
+        try {
+          transforms.push_back(
+            lookupTarget(
+              i, frame_id, source, tf2::timeFromSec(stamp.seconds()), IsBufferCore()));
+        } catch (const tf2::TransformException &) {
+          return false;
+        }
+      } else if (!canTransformTarget(
+          i, frame_id, source, tf2::timeFromSec(stamp.seconds()), IsBufferCore()))
+      {
+        return false;
+      }
+
+      if (time_tolerance_.nanoseconds()) {
+        if (!canTransformTarget(
+            i, frame_id, source, tf2::timeFromSec((stamp + time_tolerance_).seconds()),
+            IsBufferCore()))
+        {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  /// Without synchronous lookups the waits of the message, which all succeeded, are the check
+  bool checkTransforms(
+    const ReadyMessage & ready, const std::string &, const rclcpp::Time &,
+    const geometry_msgs::msg::TransformStamped *, bool want_transforms,
+    std::vector<geometry_msgs::msg::TransformStamped> & transforms, std::false_type)
+  {
+    if (want_transforms) {
+      transforms = ready.transforms;
+    }
+    return true;
+  }
+
+  /// Resolve the handles of frame_id and of target frame i, unless they already are.
+  /// target_frames_mutex_ must be held
+  void resolveFrames(
+    size_t i, const std::string & frame_id, tf2::FrameHandle & source, std::true_type)
+  {
+    if (!source) {
+      source = buffer_.resolveFrame(frame_id);
+    }
+    tf2::FrameHandle & target = target_frame_handles_[i];
+    if (!target) {
+      target = buffer_.resolveFrame(target_frames_[i]);
+    }
+  }
+
+  void resolveFrames(size_t, const std::string &, tf2::FrameHandle &, std::false_type) {}
+
+  /// Look up the transform from frame_id into target frame i, target_frames_mutex_ must be held
+  geometry_msgs::msg::TransformStamped lookupTarget(
+    size_t i, const std::string &, tf2::FrameHandle source, const tf2::TimePoint & time,
+    std::true_type)
+  {
+    return buffer_.lookupTransform(target_frame_handles_[i], source, time);
+  }
+
+  geometry_msgs::msg::TransformStamped lookupTarget(
+    size_t i, const std::string & frame_id, tf2::FrameHandle, const tf2::TimePoint & time,
+    std::false_type)
+  {
+    return buffer_.lookupTransform(target_frames_[i], frame_id, time);
+  }
+
+  /// Whether frame_id can be transformed into target frame i, target_frames_mutex_ must be held
+  bool canTransformTarget(
+    size_t i, const std::string &, tf2::FrameHandle source, const tf2::TimePoint & time,
+    std::true_type)
+  {
+    return buffer_.canTransform(target_frame_handles_[i], source, time, NULL);
+  }
+
+  bool canTransformTarget(
+    size_t i, const std::string & frame_id, tf2::FrameHandle, const tf2::TimePoint & time,
+    std::false_type)
+  {
+    return buffer_.canTransform(target_frames_[i], frame_id, time, NULL);
+  }
+
   /**
    * \brief Callback that happens when we receive a message on the message topic
    */
@@ -585,12 +846,12 @@ private:
     }
 
     if (node_clock_->get_clock()->now() >= next_failure_warning_) {
-      if (incoming_message_count_ - messages_.size() == 0) {
+      if (incoming_message_count_ - num_queued_ == 0) {
         return;
       }
 
       double dropped_pct = static_cast<double>(dropped_message_count_) /
-        static_cast<double>(incoming_message_count_ - messages_.size());
+        static_cast<double>(incoming_message_count_ - num_queued_);
       if (dropped_pct > 0.95) {
         TF2_ROS_MESSAGEFILTER_WARN(
           "Dropped %.2f%% of messages so far. Please turn the "
@@ -645,6 +906,11 @@ private:
 
   void messageDropped(const MEvent & evt, FilterFailureReason reason)
   {
+    TF2_TRACEPOINT(
+      message_filter_drop, this,
+      message_filters::message_traits::FrameId<M>::value(*evt.getMessage()).c_str(),
+      message_filters::message_traits::TimeStamp<M>::value(*evt.getMessage()).nanoseconds(),
+      static_cast<int>(reason));
     // TODO(clalancette): reenable this once we have underlying support for callback queues
 #if 0
     if (callback_queue_) {
@@ -659,6 +925,10 @@ private:
 
   void messageReady(const MEvent & evt)
   {
+    TF2_TRACEPOINT(
+      message_filter_dispatch, this,
+      message_filters::message_traits::FrameId<M>::value(*evt.getMessage()).c_str(),
+      message_filters::message_traits::TimeStamp<M>::value(*evt.getMessage()).nanoseconds());
     // TODO(clalancette): reenable this once we have underlying support for callback queues
 #if 0
     if (callback_queue_) {
@@ -672,6 +942,19 @@ private:
     }
   }
 
+  void signalTransforms(
+    const MEvent & evt, const std::vector<geometry_msgs::msg::TransformStamped> & transforms)
+  {
+    std::vector<TransformsCallback> callbacks;
+    {
+      std::unique_lock<std::mutex> lock(transforms_callbacks_mutex_);
+      callbacks = transforms_callbacks_;
+    }
+    for (const TransformsCallback & callback : callbacks) {
+      callback(evt.getMessage(), transforms);
+    }
+  }
+
   void signalFailure(const MEvent & evt, FilterFailureReason reason)
   {
     namespace mt = message_filters::message_traits;
@@ -703,6 +986,8 @@ private:
   BufferT & buffer_;
   ///< The frames we need to be able to transform to before a message is ready
   V_string target_frames_;
+  ///< The handles of target_frames_, resolved once the frames exist. Empty unless IsBufferCore
+  std::vector<tf2::FrameHandle> target_frame_handles_;
   std::string target_frames_string_;
   ///< A mutex to protect access to the target_frames_ list and target_frames_string.
   std::mutex target_frames_mutex_;
@@ -710,17 +995,115 @@ private:
   uint32_t queue_size_;
 
   uint64_t next_handle_index_ = 0;
+  uint64_t next_message_id_ = 0;
   struct MessageInfo
   {
     MessageInfo()
-    : success_count(0) {}
+    : id(0), success_count(0), queued(false), failed(false) {}
 
     MEvent event;
-    std::vector<uint64_t> handles;
+    uint64_t id;
     uint64_t success_count;
+    bool queued;
+    /// Unless HasLookups, whether a wait failed and the transforms the others found
+    bool failed;
+    std::vector<geometry_msgs::msg::TransformStamped> transforms;
   };
-  typedef std::list<MessageInfo> L_MessageInfo;
-  L_MessageInfo messages_;
+  ///< Ring of the queued messages, a power of two in size. The message with an id lives at
+  // slot(id) from when it is added until it is signalled or dropped.
+  std::vector<MessageInfo> messages_;
+  ///< The id of the oldest message still queued, or next_message_id_ if there is none
+  uint64_t head_id_ = 0;
+  size_t num_queued_ = 0;
+
+  /// The ring slot of the message with id
+  size_t slot(uint64_t id) const
+  {
+    return static_cast<size_t>(id & (messages_.size() - 1));
+  }
+
+  /// The queued message with id, nullptr if it is no longer queued
+  MessageInfo * findQueued(uint64_t id)
+  {
+    if (id < head_id_ || id >= next_message_id_) {
+      return nullptr;
+    }
+    MessageInfo & info = messages_[slot(id)];
+    return info.queued && info.id == id ? &info : nullptr;
+  }
+
+  /// Take info out of the ring, and move head_id_ on to the oldest message still queued
+  void dequeue(MessageInfo & info)
+  {
+    info.event = MEvent();
+    info.queued = false;
+    --num_queued_;
+    while (head_id_ != next_message_id_ && !messages_[slot(head_id_)].queued) {
+      ++head_id_;
+    }
+  }
+
+  /** \brief Make room in the ring for the message with id next_message_id_
+   *
+   * The ring holds every id from head_id_ on, including those of messages that are done, so
+   * it can fill up with fewer than queue_size_ messages queued when an old one is stuck. It
+   * grows to twice the queue size, or without a bound when the queue size is 0.
+   * \return False if the ring is full and the oldest message has to go first
+   */
+  bool reserveSlot()
+  {
+    const uint64_t span = next_message_id_ - head_id_;
+    if (span < messages_.size()) {
+      return true;
+    }
+    size_t capacity = std::max<size_t>(messages_.size() * 2, 16);
+    if (queue_size_ != 0) {
+      size_t limit = 16;
+      while (limit < 2 * static_cast<size_t>(queue_size_)) {
+        limit *= 2;
+      }
+      if (messages_.size() >= limit) {
+        return false;
+      }
+      capacity = std::min(capacity, limit);
+    }
+    std::vector<MessageInfo> ring(capacity);
+    for (uint64_t id = head_id_; id != next_message_id_; ++id) {
+      ring[id & (capacity - 1)] = std::move(messages_[slot(id)]);
+    }
+    messages_.swap(ring);
+    return true;
+  }
+
+  ///< A transform some queued messages wait for: target frame, source frame and time
+  typedef std::tuple<std::string, std::string, tf2::TimePoint> WaitKey;
+  ///< The handle of the outstanding wait for each needed transform
+  std::map<WaitKey, uint64_t> wait_handles_;
+  struct TransformWait
+  {
+    /// The entry of the wait in wait_handles_, end() once a newer wait took over the key
+    typename std::map<WaitKey, uint64_t>::iterator key;
+    /// When the wait was made, it times out buffer_timeout_ later
+    rclcpp::Time started;
+    /// The id of each waiting message, and the index of the transform the wait is for
+    std::vector<std::pair<uint64_t, size_t>> waiters;
+  };
+  ///< The messages waiting on each outstanding wait
+  std::unordered_map<uint64_t, TransformWait> waits_;
+
+  /** \brief Whether a message added at now may share the wait instead of making a new one
+   *
+   * The wait times out buffer_timeout_ after it was made, so joining it shortens the time the
+   * message gets.  Messages only join a wait made less than a tenth of buffer_timeout_ before,
+   * a burst of messages at the same stamp still shares one.
+   */
+  bool canJoin(const TransformWait & wait, const rclcpp::Time & now) const
+  {
+    if (buffer_timeout_ == tf2::Duration::max()) {
+      return true;
+    }
+    return (now - wait.started).nanoseconds() < buffer_timeout_.count() / 10;
+  }
 
   ///< The mutex used for locking message list operations
   std::mutex messages_mutex_;
@@ -746,8 +1129,18 @@ private:
   message_filters::Connection message_connection_;
   message_filters::Connection message_connection_failure;
 
+  ///< Callbacks that also receive the transforms of each ready message
+  std::vector<TransformsCallback> transforms_callbacks_;
+  std::mutex transforms_callbacks_mutex_;
+
   // Timeout duration when calling the buffer method 'waitForTransform'
   tf2::Duration buffer_timeout_;
+
+  ///< Set by setDispatcher(), and the tasks handed to it that have not finished yet
+  DispatchFunction dispatch_;
+  size_t dispatched_tasks_ = 0;
+  std::mutex dispatch_mutex_;
+  std::condition_variable dispatch_done_;
 };
 }  // namespace tf2_ros
 
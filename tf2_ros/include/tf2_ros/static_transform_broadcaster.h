@@ -41,6 +41,8 @@
 #include <tf2_ros/qos.hpp>
 
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace tf2_ros
@@ -81,10 +83,33 @@ public:
   TF2_ROS_PUBLIC
   void sendTransform(const std::vector<geometry_msgs::msg::TransformStamped> & transforms);
 
+  /** \brief Add or replace a static transform without publishing it
+   * The transform is keyed on its child_frame_id. Nothing is sent until commit() is called, so
+   * many frames can be registered with a single latched message.  */
+  TF2_ROS_PUBLIC
+  void stageTransform(const geometry_msgs::msg::TransformStamped & transform);
+
+  /** \brief Add or replace a vector of static transforms without publishing them */
+  TF2_ROS_PUBLIC
+  void stageTransform(const std::vector<geometry_msgs::msg::TransformStamped> & transforms);
+
+  /** \brief Publish the accumulated static transforms if any were changed since the last commit
+   * \return True if a message was published */
+  TF2_ROS_PUBLIC
+  bool commit();
+
+  /** \brief Get the number of distinct child frames held by this broadcaster */
+  TF2_ROS_PUBLIC
+  size_t getNumTransforms() const;
+
 private:
   /// Internal reference to ros::Node
   rclcpp::Publisher<tf2_msgs::msg::TFMessage>::SharedPtr publisher_;
   tf2_msgs::msg::TFMessage net_message_;
+  /// Position of each child_frame_id in net_message_.transforms
+  std::unordered_map<std::string, size_t> index_;
+  /// Whether net_message_ differs from what was last published
+  bool dirty_ = false;
 };
 
 }  // namespace tf2_ros
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TF2_ROS__STATIC_TRANSFORM_CACHE_H_
+#define TF2_ROS__STATIC_TRANSFORM_CACHE_H_
+
+#include <tf2/buffer_core.h>
+#include <tf2_ros/visibility_control.h>
+
+#include <geometry_msgs/msg/transform_stamped.hpp>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tf2_ros
+{
+
+/** \brief An on-disk copy of the static transforms last received on /tf_static
+ *
+ * Loading it lets a TransformListener answer static lookups before discovery has delivered the
+ * latched /tf_static messages. The file holds the transforms serialized as a TFMessage together
+ * with a hash of them and the version string given to the constructor. A file that is truncated,
+ * corrupt or written for another version is ignored, so bump the version whenever the static
+ * frames of the robot change, otherwise frames that are no longer published survive in the cache.
+ *
+ * The file is written in the native byte order and is meant to be read back on the same machine.
+ */
+class StaticTransformCache
+{
+public:
+  /// The authority transforms loaded from the cache are inserted with
+  TF2_ROS_PUBLIC
+  static const char * const authority;
+
+  TF2_ROS_PUBLIC
+  explicit StaticTransformCache(const std::string & path, const std::string & version = "");
+
+  /** \brief Read the cache file, replacing anything held
+   * \return False if the file is missing, unreadable, corrupt or of another version, in which
+   * case the cache is left empty
+   */
+  TF2_ROS_PUBLIC
+  bool load();
+
+  /// Insert the held transforms into buffer as static transforms
+  TF2_ROS_PUBLIC
+  void apply(tf2::BufferCore & buffer) const;
+
+  /** \brief Add or replace transforms by child frame and rewrite the file if any changed
+   * \return False if the file could not be written
+   */
+  TF2_ROS_PUBLIC
+  bool update(const std::vector<geometry_msgs::msg::TransformStamped> & transforms);
+
+  /// The held transforms, in the order their child frames were first seen
+  TF2_ROS_PUBLIC
+  std::vector<geometry_msgs::msg::TransformStamped> getTransforms() const;
+
+  TF2_ROS_PUBLIC
+  const std::string & getPath() const {return path_;}
+
+private:
+  bool write() const;
+
+  const std::string path_;
+  const std::string version_;
+  /// Guards transforms_ and index_
+  mutable std::mutex mutex_;
+  std::vector<geometry_msgs::msg::TransformStamped> transforms_;
+  /// Position of each child_frame_id in transforms_
+  std::unordered_map<std::string, size_t> index_;
+};
+
+}  // namespace tf2_ros
+
+#endif  // TF2_ROS__STATIC_TRANSFORM_CACHE_H_
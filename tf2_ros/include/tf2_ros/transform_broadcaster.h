@@ -41,6 +41,7 @@
 #include <tf2_ros/qos.hpp>
 
 #include <memory>
+#include <mutex>
 #include <vector>
 
 
@@ -92,8 +93,38 @@ public:
   TF2_ROS_PUBLIC
   void sendTransform(const std::vector<geometry_msgs::msg::TransformStamped> & transforms);
 
+  /** \brief Send a whole TFMessage
+   *
+   * The message is handed over to the publisher, so subscriptions in the same process that use
+   * intra-process communication receive it without a copy.
+   */
+  TF2_ROS_PUBLIC
+  void sendTransform(std::unique_ptr<tf2_msgs::msg::TFMessage> message);
+
+  /** \brief Send a whole TFMessage owned by the caller
+   *
+   * Nothing is copied on the way to the middleware, so a caller broadcasting the same frames
+   * over and over can keep one message and only update its transforms between calls.
+   */
+  TF2_ROS_PUBLIC
+  void sendTransform(const tf2_msgs::msg::TFMessage & message);
+
+  /** \brief Borrow a TFMessage from the middleware, to be filled in and sent with sendTransform()
+   *
+   * Middlewares that can't loan messages of this type fall back to allocating one.
+   */
+  TF2_ROS_PUBLIC
+  rclcpp::LoanedMessage<tf2_msgs::msg::TFMessage> borrowMessage();
+
+  /** \brief Send a TFMessage borrowed with borrowMessage() */
+  TF2_ROS_PUBLIC
+  void sendTransform(rclcpp::LoanedMessage<tf2_msgs::msg::TFMessage> && message);
+
 private:
   rclcpp::Publisher<tf2_msgs::msg::TFMessage>::SharedPtr publisher_;
+  /// Reused by the TransformStamped overloads so repeated broadcasts don't allocate
+  std::mutex message_mutex_;
+  tf2_msgs::msg::TFMessage message_;
 };
 
 }  // namespace tf2_ros
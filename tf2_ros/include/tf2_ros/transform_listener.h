@@ -40,11 +40,21 @@
 #include <rclcpp/rclcpp.hpp>
 
 #include <tf2_ros/qos.hpp>
+#include <tf2_ros/spsc_queue.h>
+#include <tf2_ros/static_transform_cache.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 
 namespace tf2_ros
@@ -74,11 +84,70 @@ get_default_transform_listener_static_sub_options()
     rclcpp::QosPolicyKind::Depth,
     rclcpp::QosPolicyKind::History,
     rclcpp::QosPolicyKind::Reliability};
+  // Intra-process communication only supports volatile durability, /tf_static is transient local
+  options.use_intra_process_comm = rclcpp::IntraProcessSetting::Disable;
   return options;
 }
 }  // namespace detail
 
+/// How a TransformListener runs its subscriptions
+struct TransformListenerThreadOptions
+{
+  /// Handle /tf_static in its own callback group and thread, so a large static burst does not
+  /// hold up /tf
+  bool separate_static_thread = false;
+  /// Pin the listener threads to this CPU, -1 leaves their affinity alone
+  int cpu_affinity = -1;
+  /// Run the listener threads with SCHED_FIFO at this priority, 0 keeps the default scheduler
+  int priority = 0;
+  /// Add the listener callback groups to this executor instead of starting threads. The caller
+  /// must spin it on a thread other than the ones waiting on the buffers
+  rclcpp::Executor::SharedPtr executor;
+  /// When not 0, the subscription callbacks only queue the messages they receive, up to this many
+  /// per topic, and an applier thread inserts them into the buffers in batches. This keeps lookups
+  /// contending for the buffers from holding up the middleware
+  size_t ingest_queue_size = 0;
+};
+
+/// Counters of the queue between the subscriptions and the applier thread of a TransformListener
+struct TransformListenerQueueStats
+{
+  /// Messages waiting to be inserted
+  size_t depth = 0;
+  /// The most messages that were ever waiting
+  size_t max_depth = 0;
+  /// /tf messages dropped because the queue was full, /tf_static messages are never dropped
+  uint64_t overflows = 0;
+  /// Batches the applier thread inserted
+  uint64_t batches = 0;
+};
+
+/** \brief Which /tf samples of a child frame a TransformListener inserts
+ *
+ * Static transforms are never dropped. When a single message holds several samples of the same
+ * child frame, only the newest of them is considered.
+ */
+struct TransformListenerIngestPolicy
+{
+  /// Drop samples stamped less than this after the last inserted one
+  std::chrono::nanoseconds min_period{0};
+  /// Insert only every keep_every-th sample that passed min_period
+  uint32_t keep_every = 1;
+};
+
+/// Counters of the samples a TransformListener received for one child frame
+struct TransformListenerIngestStats
+{
+  uint64_t received = 0;
+  uint64_t dropped = 0;
+};
+
 /** \brief This class provides an easy way to request and receive coordinate frame transform information.
+ *
+ * Messages are received as const shared pointers, so when the broadcaster lives in the same process
+ * and intra-process communication is enabled in the subscription options, /tf messages reach the
+ * buffers without being serialized or copied. Several buffers can be fed from one listener with
+ * addBuffer(), which lets the components of a container share a single /tf subscription.
  */
 class TransformListener
 {
@@ -98,15 +167,87 @@ public:
     detail::get_default_transform_listener_sub_options<AllocatorT>(),
     const rclcpp::SubscriptionOptionsWithAllocator<AllocatorT> & static_options =
     detail::get_default_transform_listener_static_sub_options<AllocatorT>())
-  : buffer_(buffer)
+  : buffers_{&buffer}
   {
     init(node, spin_thread, qos, static_qos, options, static_options);
     node_logging_interface_ = node->get_node_logging_interface();
   }
 
+  /** \brief Constructor that runs the subscriptions in callback groups of their own
+   *
+   * Unlike the other constructors this never spins node itself, only the listener callback
+   * groups are executed, either on threads configured by thread_options or by
+   * thread_options.executor.
+   */
+  template<class NodeT, class AllocatorT = std::allocator<void>>
+  TransformListener(
+    tf2::BufferCore & buffer,
+    NodeT && node,
+    const TransformListenerThreadOptions & thread_options,
+    const rclcpp::QoS & qos = DynamicListenerQoS(),
+    const rclcpp::QoS & static_qos = StaticListenerQoS(),
+    const rclcpp::SubscriptionOptionsWithAllocator<AllocatorT> & options =
+    detail::get_default_transform_listener_sub_options<AllocatorT>(),
+    const rclcpp::SubscriptionOptionsWithAllocator<AllocatorT> & static_options =
+    detail::get_default_transform_listener_static_sub_options<AllocatorT>())
+  : buffers_{&buffer}
+  {
+    auto node_base_interface = node->get_node_base_interface();
+    callback_group_ = node_base_interface->create_callback_group(
+      rclcpp::CallbackGroupType::MutuallyExclusive, false);
+    static_callback_group_ = !thread_options.separate_static_thread ? callback_group_ :
+      node_base_interface->create_callback_group(
+      rclcpp::CallbackGroupType::MutuallyExclusive, false);
+
+    rclcpp::SubscriptionOptionsWithAllocator<AllocatorT> group_options = options;
+    group_options.callback_group = callback_group_;
+    rclcpp::SubscriptionOptionsWithAllocator<AllocatorT> group_static_options = static_options;
+    group_static_options.callback_group = static_callback_group_;
+    init(node, false, qos, static_qos, group_options, group_static_options);
+    initThreads(node_base_interface, thread_options);
+  }
+
   TF2_ROS_PUBLIC
   virtual ~TransformListener();
 
+  /** \brief Also insert every received transform into buffer
+   *
+   * The buffer must outlive the listener or be removed with removeBuffer() first.
+   */
+  TF2_ROS_PUBLIC
+  void addBuffer(tf2::BufferCore & buffer);
+
+  /// Stop inserting received transforms into buffer
+  TF2_ROS_PUBLIC
+  void removeBuffer(tf2::BufferCore & buffer);
+
+  /// Apply policy to every child frame that has no policy of its own
+  TF2_ROS_PUBLIC
+  void setIngestPolicy(const TransformListenerIngestPolicy & policy);
+
+  /// Apply policy to the samples of child_frame_id
+  TF2_ROS_PUBLIC
+  void setIngestPolicy(
+    const std::string & child_frame_id, const TransformListenerIngestPolicy & policy);
+
+  /// Received and dropped sample counts for each child frame seen on /tf since a policy was set
+  TF2_ROS_PUBLIC
+  std::unordered_map<std::string, TransformListenerIngestStats> getIngestStats() const;
+
+  /// Counters of the ingest queue, all zero unless TransformListenerThreadOptions asked for one
+  TF2_ROS_PUBLIC
+  TransformListenerQueueStats getIngestQueueStats() const;
+
+  /** \brief Preload the buffers from cache and keep it up to date with /tf_static
+   *
+   * The transforms held by cache are inserted into every buffer, including ones added later
+   * with addBuffer(), and every static transform received afterwards is written back to it.
+   * Live transforms replace cached ones of the same child frame as they arrive.
+   * Call cache->load() first to start from the file, pass nullptr to stop updating the cache.
+   */
+  TF2_ROS_PUBLIC
+  void setStaticTransformCache(std::shared_ptr<StaticTransformCache> cache);
+
 private:
   template<class NodeT, class AllocatorT = std::allocator<void>>
   void init(
@@ -119,7 +260,7 @@ private:
   {
     node_logging_interface_ = node->get_node_logging_interface();
 
-    using callback_t = std::function<void (tf2_msgs::msg::TFMessage::SharedPtr)>;
+    using callback_t = std::function<void (tf2_msgs::msg::TFMessage::ConstSharedPtr)>;
     callback_t cb = std::bind(
       &TransformListener::subscription_callback, this, std::placeholders::_1, false);
     callback_t static_cb = std::bind(
@@ -147,19 +288,79 @@ private:
   void initThread(
     rclcpp::node_interfaces::NodeBaseInterface::SharedPtr node_base_interface);
 
+  TF2_ROS_PUBLIC
+  void initThreads(
+    rclcpp::node_interfaces::NodeBaseInterface::SharedPtr node_base_interface,
+    const TransformListenerThreadOptions & thread_options);
+
+  /// Pick the samples of msg that pass the ingest policies, called with ingest_mutex_ held
+  void filterTransforms(const tf2_msgs::msg::TFMessage & msg);
+
+  /// Insert transforms into every buffer
+  void insertTransforms(
+    const std::vector<geometry_msgs::msg::TransformStamped> & transforms, bool is_static);
+
+  /// Queue msg for the applier thread, from the subscription callback of its topic
+  void queueMessage(tf2_msgs::msg::TFMessage::ConstSharedPtr msg, bool is_static);
+
+  /// Body of the applier thread
+  void runApplier();
+
   /// Callback function for ros message subscriptoin
   TF2_ROS_PUBLIC
-  void subscription_callback(tf2_msgs::msg::TFMessage::SharedPtr msg, bool is_static);
+  void subscription_callback(tf2_msgs::msg::TFMessage::ConstSharedPtr msg, bool is_static);
 
   // ros::CallbackQueue tf_message_callback_queue_;
   using thread_ptr =
     std::unique_ptr<std::thread, std::function<void (std::thread *)>>;
   thread_ptr dedicated_listener_thread_;
+  /// Threads started by initThreads(), one per callback group
+  std::vector<thread_ptr> callback_group_threads_;
+  rclcpp::CallbackGroup::SharedPtr callback_group_;
+  rclcpp::CallbackGroup::SharedPtr static_callback_group_;
+  /// The executor given in TransformListenerThreadOptions, if any
+  rclcpp::Executor::SharedPtr user_executor_;
 
   rclcpp::Node::SharedPtr optional_default_node_ = nullptr;
   rclcpp::Subscription<tf2_msgs::msg::TFMessage>::SharedPtr message_subscription_tf_;
   rclcpp::Subscription<tf2_msgs::msg::TFMessage>::SharedPtr message_subscription_tf_static_;
-  tf2::BufferCore & buffer_;
+  /// Guards buffers_, which the listener thread reads while addBuffer() may change it
+  std::mutex buffers_mutex_;
+  std::vector<tf2::BufferCore *> buffers_;
+  /// Written with the received static transforms, guarded by buffers_mutex_
+  std::shared_ptr<StaticTransformCache> static_cache_;
+
+  struct IngestState
+  {
+    TransformListenerIngestStats stats;
+    tf2::TimePoint last_inserted;
+    uint32_t passed = 0;
+    /// The message this frame was last seen in, and its newest sample there
+    uint64_t message = 0;
+    size_t newest = 0;
+  };
+  /// Guards the ingest policies and counters
+  mutable std::mutex ingest_mutex_;
+  bool ingest_filtering_ = false;
+  uint64_t ingest_message_ = 0;
+  TransformListenerIngestPolicy default_ingest_policy_;
+  std::unordered_map<std::string, TransformListenerIngestPolicy> ingest_policies_;
+  std::unordered_map<std::string, IngestState> ingest_states_;
+  /// The samples of the current message that passed, reused between messages
+  std::vector<geometry_msgs::msg::TransformStamped> ingest_transforms_;
+
+  /// One queue per topic, so each has a single producer
+  std::unique_ptr<SPSCQueue<tf2_msgs::msg::TFMessage::ConstSharedPtr>> ingest_queue_;
+  std::unique_ptr<SPSCQueue<tf2_msgs::msg::TFMessage::ConstSharedPtr>> static_ingest_queue_;
+  std::atomic<size_t> ingest_queue_max_depth_{0};
+  std::atomic<uint64_t> ingest_queue_overflows_{0};
+  std::atomic<uint64_t> ingest_queue_batches_{0};
+  /// The applier sleeps on applier_cv_ when both queues are empty
+  std::mutex applier_mutex_;
+  std::condition_variable applier_cv_;
+  std::atomic<bool> applier_sleeping_{false};
+  std::atomic<bool> applier_done_{false};
+  thread_ptr applier_thread_;
   tf2::TimePoint last_update_;
   rclcpp::node_interfaces::NodeLoggingInterface::SharedPtr node_logging_interface_;
 };
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TF2_ROS__TRANSFORM_STREAM_SERVER_H_
+#define TF2_ROS__TRANSFORM_STREAM_SERVER_H_
+
+#include <tf2/buffer_core_interface.h>
+#include <tf2/time.h>
+#include <tf2_ros/visibility_control.h>
+
+#include <geometry_msgs/msg/transform_stamped.hpp>
+#include <rclcpp/create_service.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <tf2_msgs/msg/tf_message.hpp>
+#include <tf2_msgs/srv/stream_transforms.hpp>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tf2_ros
+{
+/** \brief Streams the transforms between chosen frame pairs to remote consumers.
+ *
+ * A client calls the "stream" service below the namespace with the frame pairs it is interested
+ * in and a rate. The server answers with a topic on which it then publishes, at that rate, the
+ * transforms of the pairs that moved further than the requested thresholds since they were
+ * last sent. The header frame of each transform is the target frame and the child frame is the
+ * source frame of its pair. Everything is sent again when a new subscriber joins, and a stream
+ * is closed once nobody has subscribed to it for the idle timeout.
+ *
+ * This saves consumers on slow links from subscribing to all of /tf or polling a BufferServer.
+ */
+class TransformStreamServer
+{
+  using StreamTransforms = tf2_msgs::srv::StreamTransforms;
+
+public:
+  /** \brief Constructor
+   * \param buffer The buffer the streamed transforms are looked up in.
+   * \param node The node to add the service and the stream topics to.
+   * \param ns The namespace of the service and the stream topics.
+   * \param idle_timeout How long a stream is kept without subscribers.
+   */
+  template<typename NodePtr>
+  TransformStreamServer(
+    const tf2::BufferCoreInterface & buffer,
+    NodePtr node,
+    const std::string & ns,
+    tf2::Duration idle_timeout = tf2::durationFromSec(10.0))
+  : buffer_(buffer),
+    ns_(ns),
+    idle_timeout_(idle_timeout),
+    logger_(node->get_logger()),
+    clock_(node->get_clock()),
+    node_base_(node->get_node_base_interface()),
+    node_topics_(node->get_node_topics_interface()),
+    node_timers_(node->get_node_timers_interface())
+  {
+    service_ = rclcpp::create_service<StreamTransforms>(
+      node_base_, node->get_node_services_interface(), ns + "/stream",
+      [this](
+        const std::shared_ptr<StreamTransforms::Request> request,
+        std::shared_ptr<StreamTransforms::Response> response)
+      {
+        streamCB(request, response);
+      },
+      rmw_qos_profile_services_default, nullptr);
+  }
+
+  /// \brief The number of streams currently open.
+  TF2_ROS_PUBLIC
+  size_t getNumStreams();
+
+private:
+  struct Stream
+  {
+    uint64_t id;
+    std::vector<std::pair<std::string, std::string>> pairs;
+    double translation_threshold;
+    double rotation_threshold;
+    /// The last transform sent for each pair, empty frame ids for those never sent
+    std::vector<geometry_msgs::msg::TransformStamped> sent;
+    size_t subscribers = 0;
+    rclcpp::Time last_subscribed;
+    rclcpp::Publisher<tf2_msgs::msg::TFMessage>::SharedPtr publisher;
+    rclcpp::TimerBase::SharedPtr timer;
+  };
+
+  TF2_ROS_PUBLIC
+  void streamCB(
+    const std::shared_ptr<StreamTransforms::Request> request,
+    std::shared_ptr<StreamTransforms::Response> response);
+
+  TF2_ROS_PUBLIC
+  void publishChanges(uint64_t id);
+
+  const tf2::BufferCoreInterface & buffer_;
+  std::string ns_;
+  tf2::Duration idle_timeout_;
+  rclcpp::Logger logger_;
+  rclcpp::Clock::SharedPtr clock_;
+  rclcpp::node_interfaces::NodeBaseInterface::SharedPtr node_base_;
+  rclcpp::node_interfaces::NodeTopicsInterface::SharedPtr node_topics_;
+  rclcpp::node_interfaces::NodeTimersInterface::SharedPtr node_timers_;
+  rclcpp::Service<StreamTransforms>::SharedPtr service_;
+  std::mutex mutex_;
+  std::map<uint64_t, std::shared_ptr<Stream>> streams_;
+  uint64_t next_id_ = 1;
+};
+
+}  // namespace tf2_ros
+
+#endif  // TF2_ROS__TRANSFORM_STREAM_SERVER_H_
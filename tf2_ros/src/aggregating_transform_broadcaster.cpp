@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tf2_ros/aggregating_transform_broadcaster.h"
+
+#include <geometry_msgs/msg/transform_stamped.hpp>
+#include <tf2_msgs/msg/tf_message.hpp>
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace tf2_ros
+{
+
+AggregatingTransformBroadcaster::~AggregatingTransformBroadcaster()
+{
+  if (flush_timer_) {
+    flush_timer_->cancel();
+  }
+  flush();
+}
+
+void AggregatingTransformBroadcaster::sendTransform(
+  const geometry_msgs::msg::TransformStamped & transform)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  queue(transform);
+}
+
+void AggregatingTransformBroadcaster::sendTransform(
+  const std::vector<geometry_msgs::msg::TransformStamped> & transforms)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto & transform : transforms) {
+    queue(transform);
+  }
+}
+
+void AggregatingTransformBroadcaster::flush()
+{
+  // Publishing under the lock keeps windows from overtaking each other
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (pending_.transforms.empty()) {
+    return;
+  }
+  std::swap(pending_, sent_);
+  pending_.transforms.clear();
+  pending_index_.clear();
+  broadcaster_.sendTransform(sent_);
+}
+
+size_t AggregatingTransformBroadcaster::getNumPending() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_.transforms.size();
+}
+
+void AggregatingTransformBroadcaster::queue(const geometry_msgs::msg::TransformStamped & transform)
+{
+  auto inserted = pending_index_.emplace(transform.child_frame_id, pending_.transforms.size());
+  if (inserted.second) {
+    pending_.transforms.push_back(transform);
+  } else {
+    pending_.transforms[inserted.first->second] = transform;
+  }
+}
+
+}  // namespace tf2_ros
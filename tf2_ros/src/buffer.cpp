@@ -32,17 +32,130 @@
 
 #include "tf2_ros/buffer.h"
 
+#include <tf2/tracing.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <exception>
+#include <functional>
 #include <limits>
 #include <memory>
 #include <mutex>
 #include <sstream>
 #include <string>
-#include <thread>
+#include <tuple>
+#include <vector>
 
 namespace tf2_ros
 {
 
+namespace
+{
+
+/** \brief Lets a thread blocked in Buffer::canTransform() sleep until BufferCore reports that one
+ * of its transformable requests completed, instead of polling
+ */
+class TransformableWaiter
+{
+public:
+  explicit TransformableWaiter(tf2::BufferCore & buffer)
+  : buffer_(buffer), state_(std::make_shared<State>())
+  {
+  }
+
+  ~TransformableWaiter()
+  {
+    cancel();
+  }
+
+  /// Also wake up when the transform from source_frame to target_frame at time becomes possible
+  void add(const std::string & target_frame, const std::string & source_frame, tf2::TimePoint time)
+  {
+    requests_.emplace_back(target_frame, source_frame, time);
+    arm(requests_.back());
+  }
+
+  /** \brief Sleep for up to timeout or until a request completes
+   *
+   * Completed requests are registered again, so the caller can keep waiting if the transform it
+   * checks for is still not possible.
+   */
+  void wait(std::chrono::nanoseconds timeout)
+  {
+    {
+      std::unique_lock<std::mutex> lock(state_->mutex);
+      if (!state_->cv.wait_for(lock, timeout, [this]() {return state_->completed != seen_;})) {
+        return;
+      }
+      seen_ = state_->completed;
+    }
+    cancel();
+    for (const auto & request : requests_) {
+      arm(request);
+    }
+  }
+
+private:
+  using Request = std::tuple<std::string, std::string, tf2::TimePoint>;
+
+  struct State
+  {
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint64_t completed = 0;
+  };
+
+  void arm(const Request & request)
+  {
+    // The callback may still run after the waiter is gone, so it only holds on to the state
+    std::shared_ptr<State> state = state_;
+    auto cb = [state](
+      tf2::TransformableRequestHandle, const std::string &, const std::string &, tf2::TimePoint,
+      tf2::TransformableResult)
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        ++state->completed;
+        state->cv.notify_all();
+      };
+    tf2::TransformableRequestHandle handle = buffer_.addTransformableRequest(
+      cb, std::get<0>(request), std::get<1>(request), std::get<2>(request));
+    // 0 means possible right away and all ones means never possible, neither will call back
+    if (handle != 0 && handle != 0xffffffffffffffffULL) {
+      handles_.push_back(handle);
+    }
+  }
+
+  void cancel()
+  {
+    for (tf2::TransformableRequestHandle handle : handles_) {
+      buffer_.cancelTransformableRequest(handle);
+    }
+    handles_.clear();
+  }
+
+  tf2::BufferCore & buffer_;
+  std::shared_ptr<State> state_;
+  uint64_t seen_ = 0;
+  std::vector<Request> requests_;
+  std::vector<tf2::TransformableRequestHandle> handles_;
+};
+
+/// How long canTransform() sleeps at most before checking its clock, which may be simulated
+constexpr std::chrono::milliseconds max_wait_slice(100);
+
+std::chrono::nanoseconds
+waitSlice(const rclcpp::Time & deadline, const rclcpp::Time & now)
+{
+  return std::max(
+    std::chrono::nanoseconds(0),
+    std::min<std::chrono::nanoseconds>(
+      std::chrono::nanoseconds((deadline - now).nanoseconds()), max_wait_slice));
+}
+
+}  // namespace
+
 Buffer::Buffer(
   rclcpp::Clock::SharedPtr clock, tf2::Duration cache_time,
   rclcpp::Node::SharedPtr node)
@@ -95,16 +208,33 @@ Buffer::lookupTransform(
   return lookupTransform(target_frame, source_frame, lookup_time);
 }
 
+std::vector<geometry_msgs::msg::TransformStamped>
+Buffer::lookupTransforms(
+  const std::vector<std::string> & target_frames, const std::string & source_frame,
+  const tf2::TimePoint & time, const tf2::Duration timeout) const
+{
+  const rclcpp::Time deadline = clock_->now() + to_rclcpp(timeout);
+  for (const std::string & target_frame : target_frames) {
+    tf2::Duration remaining = std::max(
+      tf2::Duration::zero(), fromRclcpp(deadline - clock_->now()));
+    if (!canTransform(target_frame, source_frame, time, remaining)) {
+      break;
+    }
+  }
+  return lookupTransforms(target_frames, source_frame, time);
+}
+
 void Buffer::onTimeJump(const rcl_time_jump_t & jump)
 {
   if (RCL_ROS_TIME_ACTIVATED == jump.clock_change ||
     RCL_ROS_TIME_DEACTIVATED == jump.clock_change)
   {
     RCLCPP_WARN(getLogger(), "Detected time source change. Clearing TF buffer.");
-    clear();
+    resetAfterTimeJump(true);
   } else if (jump.delta.nanoseconds < 0) {
     RCLCPP_WARN(getLogger(), "Detected jump back in time. Clearing TF buffer.");
-    clear();
+    // Waits for times on the old timeline would otherwise only end by timing out
+    resetAfterTimeJump(true);
   }
 }
 
@@ -143,15 +273,36 @@ Buffer::canTransform(
 
   rclcpp::Duration rclcpp_timeout(to_rclcpp(timeout));
 
-  // poll for transform if timeout is set
+  // Once both frames exist poll by handle rather than looking up their names every time
+  tf2::FrameHandle target_handle;
+  tf2::FrameHandle source_handle;
+  auto can_transform = [&]() {
+      if (target_handle && source_handle) {
+        return canTransform(target_handle, source_handle, time);
+      }
+      if (canTransform(target_frame, source_frame, time)) {
+        return true;
+      }
+      // Frames that do not exist yet are expected while waiting, so do not log them
+      std::string unused;
+      target_handle = resolveFrame(target_frame, &unused);
+      source_handle = resolveFrame(source_frame, &unused);
+      return false;
+    };
+
+  // wait for transform if timeout is set, waking up as soon as the listener inserts what we need
+  // Registering requests with BufferCore is bookkeeping that does not change the transforms
+  TransformableWaiter waiter(*const_cast<Buffer *>(this));
   rclcpp::Time start_time = clock_->now();
+  if (rclcpp_timeout > rclcpp::Duration(0, 0) && !can_transform()) {
+    waiter.add(target_frame, source_frame, time);
+  }
   while (clock_->now() < start_time + rclcpp_timeout &&
-    !canTransform(target_frame, source_frame, time) &&
+    !can_transform() &&
     (clock_->now() + rclcpp::Duration(3, 0) >= start_time) &&  // don't wait bag loop detected
     (rclcpp::ok()))  // Make sure we haven't been stopped (won't work for pytf)
   {
-    // TODO(sloretz) sleep using clock_->sleep_for when implemented
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    waiter.wait(waitSlice(start_time + rclcpp_timeout, clock_->now()));
   }
   bool retval = canTransform(target_frame, source_frame, time, errstr);
   rclcpp::Time current_time = clock_->now();
@@ -171,15 +322,38 @@ Buffer::canTransform(
 
   rclcpp::Duration rclcpp_timeout(to_rclcpp(timeout));
 
-  // poll for transform if timeout is set
+  // Once all frames exist poll by handle rather than looking up their names every time
+  tf2::FrameHandle target_handle;
+  tf2::FrameHandle source_handle;
+  tf2::FrameHandle fixed_handle;
+  auto can_transform = [&]() {
+      if (target_handle && source_handle && fixed_handle) {
+        return canTransform(target_handle, target_time, source_handle, source_time, fixed_handle);
+      }
+      if (canTransform(target_frame, target_time, source_frame, source_time, fixed_frame)) {
+        return true;
+      }
+      // Frames that do not exist yet are expected while waiting, so do not log them
+      std::string unused;
+      target_handle = resolveFrame(target_frame, &unused);
+      source_handle = resolveFrame(source_frame, &unused);
+      fixed_handle = resolveFrame(fixed_frame, &unused);
+      return false;
+    };
+
+  // wait for transform if timeout is set, the same way as without a fixed frame
+  TransformableWaiter waiter(*const_cast<Buffer *>(this));
   rclcpp::Time start_time = clock_->now();
+  if (rclcpp_timeout > rclcpp::Duration(0, 0) && !can_transform()) {
+    waiter.add(fixed_frame, source_frame, source_time);
+    waiter.add(target_frame, fixed_frame, target_time);
+  }
   while (clock_->now() < start_time + rclcpp_timeout &&
-    !canTransform(target_frame, target_time, source_frame, source_time, fixed_frame) &&
+    !can_transform() &&
     (clock_->now() + rclcpp::Duration(3, 0) >= start_time) &&  // don't wait bag loop detected
     (rclcpp::ok()))  // Make sure we haven't been stopped (won't work for pytf)
   {
-    // TODO(sloretz) sleep using clock_->sleep_for when implemented
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    waiter.wait(waitSlice(start_time + rclcpp_timeout, clock_->now()));
   }
   bool retval = canTransform(
     target_frame, target_time,
@@ -193,105 +367,162 @@ TransformStampedFuture
 Buffer::waitForTransform(
   const std::string & target_frame, const std::string & source_frame, const tf2::TimePoint & time,
   const tf2::Duration & timeout, TransformReadyCallback callback)
+{
+  auto promise = std::make_shared<std::promise<geometry_msgs::msg::TransformStamped>>();
+  TransformStampedFuture future(promise->get_future());
+  waitForTransformResult(
+    target_frame, source_frame, time, timeout,
+    [promise, future, callback](
+      const geometry_msgs::msg::TransformStamped * transform, std::exception_ptr error)
+    {
+      if (transform) {
+        promise->set_value(*transform);
+      } else {
+        promise->set_exception(error);
+      }
+      callback(future);
+    });
+  return future;
+}
+
+void
+Buffer::waitForTransformResult(
+  const std::string & target_frame, const std::string & source_frame, const tf2::TimePoint & time,
+  const tf2::Duration & timeout, TransformResultCallback callback)
 {
   if (nullptr == timer_interface_) {
     throw CreateTimerInterfaceException("timer interface not set before call to waitForTransform");
   }
 
-  auto promise = std::make_shared<std::promise<geometry_msgs::msg::TransformStamped>>();
-  TransformStampedFuture future(promise->get_future());
+  auto wait = std::make_shared<PendingWait>();
+  wait->callback = std::move(callback);
 
-  auto cb = [this, promise, callback, future](
+  // BufferCore calls back after releasing its mutexes, so the callback may call back into the
+  // buffer.  The transform it hands over was looked up when the request became transformable.
+  auto cb = [this, wait](
     tf2::TransformableRequestHandle request_handle, const std::string & target_frame,
-    const std::string & source_frame, tf2::TimePoint time, tf2::TransformableResult result)
+    const std::string & source_frame, tf2::TimePoint time, tf2::TransformableResult result,
+    const geometry_msgs::msg::TransformStamped * transform)
     {
       (void) request_handle;
-
-      bool timeout_occurred = true;
+      if (wait->done.exchange(true)) {
+        // A timeout already occurred
+        return;
+      }
       {
-        std::lock_guard<std::mutex> lock(this->timer_to_request_map_mutex_);
-        // Check if a timeout already occurred
-        for (auto it = timer_to_request_map_.begin(); it != timer_to_request_map_.end(); ++it) {
-          if (request_handle == it->second) {
-            // The request handle was found, so a timeout has not occurred
-            this->timer_interface_->remove(it->first);
-            this->timer_to_request_map_.erase(it->first);
-            timeout_occurred = false;
-            break;
-          }
+        std::lock_guard<std::mutex> lock(this->wait_deadlines_mutex_);
+        if (wait->queued) {
+          this->wait_deadlines_.erase(wait->deadline);
+          wait->queued = false;
         }
       }
-
-      if (timeout_occurred) {
-        return;
-      }
-
-      if (result == tf2::TransformAvailable) {
-        geometry_msgs::msg::TransformStamped msg_stamped = this->lookupTransform(
-          target_frame, source_frame, time);
-        promise->set_value(msg_stamped);
+      if (transform) {
+        wait->callback(transform, nullptr);
       } else {
-        promise->set_exception(
-          std::make_exception_ptr(
-            tf2::LookupException(
-              "Failed to transform from " + source_frame + " to " + target_frame)));
+        this->completeWait(
+          wait->callback, target_frame, source_frame, time, result == tf2::TransformAvailable);
       }
-      callback(future);
     };
 
-  auto handle = addTransformableRequest(cb, target_frame, source_frame, time);
-  if (0 == handle) {
-    // Immediately transformable
-    geometry_msgs::msg::TransformStamped msg_stamped = lookupTransform(
-      target_frame, source_frame, time);
-    promise->set_value(msg_stamped);
-    callback(future);
-  } else if (0xffffffffffffffffULL == handle) {
-    // Never transformable
-    promise->set_exception(
-      std::make_exception_ptr(
+  // Results that are known right away have already been passed to cb
+  auto handle = addTransformRequest(cb, target_frame, source_frame, time);
+  TF2_TRACEPOINT(
+    wait_for_transform, this, handle, target_frame.c_str(), source_frame.c_str(),
+    time.time_since_epoch().count());
+  if (0 != handle && 0xffffffffffffffffULL != handle) {
+    std::lock_guard<std::mutex> lock(wait_deadlines_mutex_);
+    wait->request_handle = handle;
+    // The request may have completed before we got here
+    if (!wait->done) {
+      int64_t deadline = clock_->now().nanoseconds() +
+        std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+      wait->deadline = wait_deadlines_.emplace(deadline, wait);
+      wait->queued = true;
+      armDeadlineTimer();
+    }
+  }
+}
+
+void
+Buffer::completeWait(
+  const TransformResultCallback & callback, const std::string & target_frame,
+  const std::string & source_frame, tf2::TimePoint time, bool available)
+{
+  if (available) {
+    geometry_msgs::msg::TransformStamped msg_stamped;
+    try {
+      msg_stamped = lookupTransform(target_frame, source_frame, time);
+    } catch (const tf2::TransformException &) {
+      callback(nullptr, std::current_exception());
+      return;
+    }
+    callback(&msg_stamped, nullptr);
+  } else {
+    callback(
+      nullptr, std::make_exception_ptr(
         tf2::LookupException(
           "Failed to transform from " + source_frame + " to " + target_frame)));
-    callback(future);
-  } else {
-    std::lock_guard<std::mutex> lock(timer_to_request_map_mutex_);
-    auto timer_handle = timer_interface_->createTimer(
-      clock_,
-      timeout,
-      std::bind(&Buffer::timerCallback, this, std::placeholders::_1, promise, future, callback));
-
-    // Save association between timer and request handle
-    timer_to_request_map_[timer_handle] = handle;
   }
-  return future;
 }
 
 void
-Buffer::timerCallback(
-  const TimerHandle & timer_handle,
-  std::shared_ptr<std::promise<geometry_msgs::msg::TransformStamped>> promise,
-  TransformStampedFuture future,
-  TransformReadyCallback callback)
+Buffer::armDeadlineTimer()
+{
+  if (deadline_timer_active_ &&
+    (wait_deadlines_.empty() || deadline_timer_deadline_ <= wait_deadlines_.begin()->first))
+  {
+    // Nothing is due before the timer fires, waits that completed in between are skipped then
+    return;
+  }
+  if (deadline_timer_active_) {
+    timer_interface_->remove(deadline_timer_);
+    deadline_timer_active_ = false;
+  }
+  if (wait_deadlines_.empty()) {
+    return;
+  }
+
+  deadline_timer_deadline_ = wait_deadlines_.begin()->first;
+  int64_t period = std::max<int64_t>(1, deadline_timer_deadline_ - clock_->now().nanoseconds());
+  deadline_timer_ = timer_interface_->createTimer(
+    clock_,
+    tf2::Duration(std::chrono::nanoseconds(period)),
+    std::bind(&Buffer::deadlineTimerCallback, this, std::placeholders::_1));
+  deadline_timer_active_ = true;
+}
+
+void
+Buffer::deadlineTimerCallback(const TimerHandle & timer_handle)
 {
-  bool timer_is_valid = false;
-  tf2::TransformableRequestHandle request_handle = 0u;
+  std::vector<std::shared_ptr<PendingWait>> expired;
   {
-    std::lock_guard<std::mutex> lock(timer_to_request_map_mutex_);
-    auto timer_and_request_it = timer_to_request_map_.find(timer_handle);
-    timer_is_valid = (timer_to_request_map_.end() != timer_and_request_it);
-    if (timer_is_valid) {
-      request_handle = timer_and_request_it->second;
+    std::lock_guard<std::mutex> lock(wait_deadlines_mutex_);
+    if (!deadline_timer_active_ || timer_handle != deadline_timer_) {
+      // A timer that was replaced by one for an earlier deadline
+      return;
+    }
+    timer_interface_->remove(deadline_timer_);
+    deadline_timer_active_ = false;
+
+    // The timer firing means its deadline passed, even if the clock reads slightly earlier
+    int64_t now = std::max(clock_->now().nanoseconds(), deadline_timer_deadline_);
+    while (!wait_deadlines_.empty() && wait_deadlines_.begin()->first <= now) {
+      expired.push_back(wait_deadlines_.begin()->second);
+      expired.back()->queued = false;
+      wait_deadlines_.erase(wait_deadlines_.begin());
     }
-    timer_to_request_map_.erase(timer_handle);
-    timer_interface_->remove(timer_handle);
+    armDeadlineTimer();
   }
 
-  if (timer_is_valid) {
-    cancelTransformableRequest(request_handle);
-    promise->set_exception(
-      std::make_exception_ptr(
+  for (const auto & wait : expired) {
+    if (wait->done.exchange(true)) {
+      continue;
+    }
+    TF2_TRACEPOINT(wait_for_transform_timeout, this, wait->request_handle);
+    cancelTransformableRequest(wait->request_handle);
+    wait->callback(
+      nullptr, std::make_exception_ptr(
         tf2::TimeoutException(std::string("Timed out waiting for transform"))));
-    callback(future);
   }
 }
 
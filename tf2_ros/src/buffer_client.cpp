@@ -40,11 +40,127 @@
 #include <geometry_msgs/msg/transform_stamped.hpp>
 
 #include <chrono>
+#include <exception>
 #include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace tf2_ros
 {
+namespace
+{
+using TransformPromise = std::promise<geometry_msgs::msg::TransformStamped>;
+
+// Throw the exception matching a result code other than success
+void checkResultCode(rclcpp_action::ResultCode code)
+{
+  switch (code) {
+    case rclcpp_action::ResultCode::SUCCEEDED:
+      break;
+    case rclcpp_action::ResultCode::ABORTED:
+      throw GoalAbortedException("LookupTransform action was aborted");
+    case rclcpp_action::ResultCode::CANCELED:
+      throw GoalCanceledException("LookupTransform action was canceled");
+    default:
+      throw UnexpectedResultCodeException("Unexpected result code returned from server");
+  }
+}
+
+// Send a goal and block until its result arrives, shared by the single and batch lookups
+template<typename ActionT>
+typename ActionT::Result::SharedPtr sendGoal(
+  rclcpp_action::Client<ActionT> & client, const typename ActionT::Goal & goal,
+  double check_frequency, const tf2::Duration & timeout_padding)
+{
+  if (!client.wait_for_action_server(tf2_ros::fromMsg(goal.timeout))) {
+    throw tf2::ConnectivityException("Failed find available action server");
+  }
+
+  auto goal_handle_future = client.async_send_goal(goal);
+
+  const std::chrono::milliseconds period(static_cast<int>((1.0 / check_frequency) * 1000));
+  bool ready = false;
+  bool timed_out = false;
+  tf2::TimePoint start_time = tf2::get_now();
+  while (rclcpp::ok() && !ready && !timed_out) {
+    ready = (std::future_status::ready == goal_handle_future.wait_for(period));
+    timed_out = tf2::get_now() > start_time + tf2_ros::fromMsg(goal.timeout) + timeout_padding;
+  }
+
+  if (timed_out) {
+    throw tf2::TimeoutException(
+            "Did not receive the goal response for the goal sent to "
+            "the action server. Something is likely wrong with the server.");
+  }
+
+  auto goal_handle = goal_handle_future.get();
+  if (!goal_handle) {
+    throw GoalRejectedException("Goal rejected by action server");
+  }
+
+  auto result_future = client.async_get_result(goal_handle);
+
+  ready = false;
+  while (rclcpp::ok() && !ready && !timed_out) {
+    ready = (std::future_status::ready == result_future.wait_for(period));
+    timed_out = tf2::get_now() > start_time + tf2_ros::fromMsg(goal.timeout) + timeout_padding;
+  }
+
+  if (timed_out) {
+    throw tf2::TimeoutException(
+            "Did not receive the result for the goal sent to "
+            "the action server. Something is likely wrong with the server.");
+  }
+
+  auto wrapped_result = result_future.get();
+  checkResultCode(wrapped_result.code);
+  return wrapped_result.result;
+}
+}  // namespace
+
+struct BufferClient::PendingGoal
+{
+  using GoalHandle = rclcpp_action::ClientGoalHandle<LookupTransformAction>;
+
+  /// Complete the future with set, unless that already happened, and run the callback
+  template<typename F>
+  void finish(F set)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (done) {
+        return;
+      }
+      done = true;
+      set(promise);
+      // The goal handle holds the callbacks that hold this
+      goal_handle.reset();
+      if (timer) {
+        timer->cancel();
+      }
+    }
+    if (callback) {
+      callback(future);
+    }
+  }
+
+  void fail(std::exception_ptr error)
+  {
+    finish([&error](TransformPromise & promise) {promise.set_exception(error);});
+  }
+
+  TransformPromise promise;
+  TransformStampedFuture future;
+  TransformReadyCallback callback;
+  std::mutex mutex;
+  bool done = false;
+  GoalHandle::SharedPtr goal_handle;
+  rclcpp::TimerBase::SharedPtr timer;
+};
+
 geometry_msgs::msg::TransformStamped BufferClient::lookupTransform(
   const std::string & target_frame,
   const std::string & source_frame,
@@ -86,93 +202,346 @@ geometry_msgs::msg::TransformStamped BufferClient::lookupTransform(
 geometry_msgs::msg::TransformStamped BufferClient::processGoal(
   const LookupTransformAction::Goal & goal) const
 {
-  if (!client_->wait_for_action_server(tf2_ros::fromMsg(goal.timeout))) {
-    throw tf2::ConnectivityException("Failed find available action server");
+  geometry_msgs::msg::TransformStamped transform;
+  if (lookupLocal(goal, transform)) {
+    return transform;
   }
+  // process the result for errors and return it
+  transform = processResult(sendGoal(*client_, goal, check_frequency_, timeout_padding_));
+  storeLocal(goal, transform);
+  return transform;
+}
 
-  auto goal_handle_future = client_->async_send_goal(goal);
+bool BufferClient::lookupLocal(
+  const LookupTransformAction::Goal & goal,
+  geometry_msgs::msg::TransformStamped & transform) const
+{
+  if (cache_options_.capacity == 0 && !cache_options_.prefetch) {
+    return false;
+  }
+  if (goal.advanced) {
+    return false;
+  }
+  std::unique_lock<std::mutex> lock(cache_mutex_);
+  const tf2::TimePoint time = tf2_ros::fromMsg(goal.source_time);
 
-  const std::chrono::milliseconds period(static_cast<int>((1.0 / check_frequency_) * 1000));
-  bool ready = false;
-  bool timed_out = false;
-  tf2::TimePoint start_time = tf2::get_now();
-  while (rclcpp::ok() && !ready && !timed_out) {
-    ready = (std::future_status::ready == goal_handle_future.wait_for(period));
-    timed_out = tf2::get_now() > start_time + tf2_ros::fromMsg(goal.timeout) + timeout_padding_;
+  if (time != tf2::TimePointZero) {
+    auto it = cache_index_.find(CacheKey(goal.target_frame, goal.source_frame, time));
+    if (it != cache_index_.end()) {
+      cache_.splice(cache_.begin(), cache_, it->second);
+      transform = it->second->second;
+      ++cache_stats_.hits;
+      return true;
+    }
   }
 
-  if (timed_out) {
-    throw tf2::TimeoutException(
-            "Did not receive the goal response for the goal sent to "
-            "the action server. Something is likely wrong with the server.");
+  auto pair_it = prefetched_.find(std::make_pair(goal.target_frame, goal.source_frame));
+  if (pair_it == prefetched_.end() || !pair_it->second.subscription) {
+    return false;
+  }
+  std::shared_ptr<tf2::BufferCore> buffer = pair_it->second.buffer;
+  lock.unlock();
+  if (!buffer->canTransform(goal.target_frame, goal.source_frame, time)) {
+    return false;
   }
+  try {
+    transform = buffer->lookupTransform(goal.target_frame, goal.source_frame, time);
+  } catch (const tf2::TransformException &) {
+    // The stream moved on between the two calls
+    return false;
+  }
+  lock.lock();
+  ++cache_stats_.prefetch_hits;
+  return true;
+}
 
-  auto goal_handle = goal_handle_future.get();
-  if (!goal_handle) {
-    throw GoalRejectedException("Goal rejected by action server");
+void BufferClient::storeLocal(
+  const LookupTransformAction::Goal & goal,
+  const geometry_msgs::msg::TransformStamped & transform) const
+{
+  if (cache_options_.capacity == 0 && !cache_options_.prefetch) {
+    return;
   }
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  ++cache_stats_.misses;
+  if (goal.advanced) {
+    return;
+  }
+  const tf2::TimePoint time = tf2_ros::fromMsg(goal.source_time);
+  if (cache_options_.capacity != 0 && time != tf2::TimePointZero) {
+    CacheKey key(goal.target_frame, goal.source_frame, time);
+    if (cache_index_.find(key) == cache_index_.end()) {
+      if (cache_.size() >= cache_options_.capacity) {
+        cache_index_.erase(cache_.back().first);
+        cache_.pop_back();
+      }
+      cache_.emplace_front(key, transform);
+      cache_index_.emplace(std::move(key), cache_.begin());
+    }
+  }
+  if (cache_options_.prefetch &&
+    prefetched_.find(std::make_pair(goal.target_frame, goal.source_frame)) == prefetched_.end())
+  {
+    requestStream(goal.target_frame, goal.source_frame);
+  }
+}
 
-  auto result_future = client_->async_get_result(goal_handle);
+void BufferClient::requestStream(
+  const std::string & target_frame, const std::string & source_frame) const
+{
+  // Each pair gets a buffer of its own, as two pairs with the same source frame would
+  // otherwise give it two parents
+  auto key = std::make_pair(target_frame, source_frame);
+  PrefetchedPair & pair = prefetched_[key];
+  pair.buffer = std::make_shared<tf2::BufferCore>(cache_options_.prefetch_cache_time);
 
-  ready = false;
-  while (rclcpp::ok() && !ready && !timed_out) {
-    ready = (std::future_status::ready == result_future.wait_for(period));
-    timed_out = tf2::get_now() > start_time + tf2_ros::fromMsg(goal.timeout) + timeout_padding_;
+  auto request = std::make_shared<tf2_msgs::srv::StreamTransforms::Request>();
+  request->target_frames.push_back(target_frame);
+  request->source_frames.push_back(source_frame);
+  request->rate = cache_options_.prefetch_rate;
+  stream_client_->async_send_request(
+    request,
+    [this, key](rclcpp::Client<tf2_msgs::srv::StreamTransforms>::SharedFuture future) {
+      std::lock_guard<std::mutex> lock(cache_mutex_);
+      auto pair_it = prefetched_.find(key);
+      if (pair_it == prefetched_.end()) {
+        return;
+      }
+      const std::string topic = future.get()->topic;
+      if (topic.empty()) {
+        // Let the next lookup of the pair try again
+        prefetched_.erase(pair_it);
+        return;
+      }
+      std::shared_ptr<tf2::BufferCore> buffer = pair_it->second.buffer;
+      pair_it->second.subscription = rclcpp::create_subscription<tf2_msgs::msg::TFMessage>(
+        node_topics_, topic, rclcpp::QoS(100),
+        [buffer](tf2_msgs::msg::TFMessage::ConstSharedPtr msg) {
+          buffer->setTransforms(msg->transforms, "tf2_buffer_server");
+        });
+    });
+}
+
+BufferClientCacheStats BufferClient::getCacheStats() const
+{
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  return cache_stats_;
+}
+
+void BufferClient::clearCache()
+{
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  cache_.clear();
+  cache_index_.clear();
+}
+
+TransformStampedFuture BufferClient::lookupTransformAsync(
+  const std::string & target_frame,
+  const std::string & source_frame,
+  const tf2::TimePoint & time,
+  const tf2::Duration timeout) const
+{
+  LookupTransformAction::Goal goal;
+  goal.target_frame = target_frame;
+  goal.source_frame = source_frame;
+  goal.source_time = tf2_ros::toMsg(time);
+  goal.timeout = tf2_ros::toMsg(timeout);
+  goal.advanced = false;
+
+  return processGoalAsync(goal, nullptr);
+}
+
+TransformStampedFuture BufferClient::lookupTransformAsync(
+  const std::string & target_frame,
+  const tf2::TimePoint & target_time,
+  const std::string & source_frame,
+  const tf2::TimePoint & source_time,
+  const std::string & fixed_frame,
+  const tf2::Duration timeout) const
+{
+  LookupTransformAction::Goal goal;
+  goal.target_frame = target_frame;
+  goal.source_frame = source_frame;
+  goal.source_time = tf2_ros::toMsg(source_time);
+  goal.timeout = tf2_ros::toMsg(timeout);
+  goal.target_time = tf2_ros::toMsg(target_time);
+  goal.fixed_frame = fixed_frame;
+  goal.advanced = true;
+
+  return processGoalAsync(goal, nullptr);
+}
+
+TransformStampedFuture BufferClient::waitForTransform(
+  const std::string & target_frame,
+  const std::string & source_frame,
+  const tf2::TimePoint & time,
+  const tf2::Duration & timeout,
+  TransformReadyCallback callback)
+{
+  LookupTransformAction::Goal goal;
+  goal.target_frame = target_frame;
+  goal.source_frame = source_frame;
+  goal.source_time = tf2_ros::toMsg(time);
+  goal.timeout = tf2_ros::toMsg(timeout);
+  goal.advanced = false;
+
+  return processGoalAsync(goal, std::move(callback));
+}
+
+TransformStampedFuture BufferClient::processGoalAsync(
+  const LookupTransformAction::Goal & goal, TransformReadyCallback callback) const
+{
+  auto pending = std::make_shared<PendingGoal>();
+  pending->future = pending->promise.get_future().share();
+  pending->callback = std::move(callback);
+
+  geometry_msgs::msg::TransformStamped transform;
+  if (lookupLocal(goal, transform)) {
+    pending->finish([&transform](TransformPromise & promise) {promise.set_value(transform);});
+    return pending->future;
+  }
+  if (!client_->action_server_is_ready()) {
+    pending->fail(
+      std::make_exception_ptr(
+        tf2::ConnectivityException("Failed find available action server")));
+    return pending->future;
   }
 
-  if (timed_out) {
-    throw tf2::TimeoutException(
+  // The timer only holds a weak pointer, the goal callbacks keep pending alive until it is done
+  std::weak_ptr<PendingGoal> weak_pending = pending;
+  pending->timer = rclcpp::create_wall_timer(
+    tf2_ros::fromMsg(goal.timeout) + timeout_padding_,
+    [this, weak_pending]() {
+      auto pending = weak_pending.lock();
+      if (!pending) {
+        return;
+      }
+      PendingGoal::GoalHandle::SharedPtr goal_handle;
+      {
+        std::lock_guard<std::mutex> lock(pending->mutex);
+        goal_handle = pending->goal_handle;
+      }
+      pending->fail(
+        std::make_exception_ptr(
+          tf2::TimeoutException(
             "Did not receive the result for the goal sent to "
-            "the action server. Something is likely wrong with the server.");
-  }
+            "the action server. Something is likely wrong with the server.")));
+      if (goal_handle) {
+        client_->async_cancel_goal(goal_handle);
+      }
+    },
+    nullptr, node_base_.get(), node_timers_.get());
 
-  auto wrapped_result = result_future.get();
+  rclcpp_action::Client<LookupTransformAction>::SendGoalOptions options;
+  options.goal_response_callback = [pending](PendingGoal::GoalHandle::SharedPtr goal_handle) {
+      if (!goal_handle) {
+        pending->fail(
+          std::make_exception_ptr(GoalRejectedException("Goal rejected by action server")));
+        return;
+      }
+      std::lock_guard<std::mutex> lock(pending->mutex);
+      if (!pending->done) {
+        pending->goal_handle = goal_handle;
+      }
+    };
+  options.result_callback =
+    [this, pending, goal](const PendingGoal::GoalHandle::WrappedResult & wrapped_result) {
+      geometry_msgs::msg::TransformStamped transform;
+      try {
+        checkResultCode(wrapped_result.code);
+        transform = processResult(wrapped_result.result);
+      } catch (...) {
+        pending->fail(std::current_exception());
+        return;
+      }
+      storeLocal(goal, transform);
+      pending->finish([&transform](TransformPromise & promise) {promise.set_value(transform);});
+    };
+  client_->async_send_goal(goal, options);
+  return pending->future;
+}
 
-  switch (wrapped_result.code) {
-    case rclcpp_action::ResultCode::SUCCEEDED:
-      break;
-    case rclcpp_action::ResultCode::ABORTED:
-      throw GoalAbortedException("LookupTransform action was aborted");
-    case rclcpp_action::ResultCode::CANCELED:
-      throw GoalCanceledException("LookupTransform action was canceled");
-    default:
-      throw UnexpectedResultCodeException("Unexpected result code returned from server");
+std::vector<geometry_msgs::msg::TransformStamped> BufferClient::lookupTransforms(
+  const std::vector<tf2_msgs::msg::TransformRequest> & requests,
+  const tf2::Duration timeout,
+  std::vector<tf2_msgs::msg::TF2Error> * errors) const
+{
+  LookupTransformsAction::Goal goal;
+  goal.requests = requests;
+  goal.timeout = tf2_ros::toMsg(timeout);
+
+  auto result = sendGoal(*batch_client_, goal, check_frequency_, timeout_padding_);
+  if (result->transforms.size() != requests.size() || result->errors.size() != requests.size()) {
+    throw UnexpectedResultCodeException("Batch result does not match the requests");
+  }
+  if (errors) {
+    *errors = result->errors;
+  } else {
+    for (const tf2_msgs::msg::TF2Error & error : result->errors) {
+      processError(error);
+    }
   }
+  return result->transforms;
+}
 
-  // process the result for errors and return it
-  return processResult(wrapped_result.result);
+BufferClient::TransformsFuture BufferClient::lookupTransformsAsync(
+  const std::vector<tf2_msgs::msg::TransformRequest> & requests,
+  const tf2::Duration timeout) const
+{
+  return std::async(
+    std::launch::async, [this, requests, timeout]() {
+      return lookupTransforms(requests, timeout);
+    }).share();
+}
+
+std::vector<geometry_msgs::msg::TransformStamped> BufferClient::lookupTransforms(
+  const std::vector<std::string> & target_frames, const std::string & source_frame,
+  const tf2::TimePoint & time, const tf2::Duration timeout) const
+{
+  std::vector<tf2_msgs::msg::TransformRequest> requests(target_frames.size());
+  for (size_t i = 0; i < target_frames.size(); ++i) {
+    requests[i].target_frame = target_frames[i];
+    requests[i].source_frame = source_frame;
+    requests[i].source_time = tf2_ros::toMsg(time);
+    requests[i].advanced = false;
+  }
+  return lookupTransforms(requests, timeout);
 }
 
 geometry_msgs::msg::TransformStamped BufferClient::processResult(
   const LookupTransformAction::Result::SharedPtr & result) const
 {
   // if there's no error, then we'll just return the transform
-  if (result->error.error != result->error.NO_ERROR) {
+  processError(result->error);
+  return result->transform;
+}
+
+void BufferClient::processError(const tf2_msgs::msg::TF2Error & error) const
+{
+  if (error.error != error.NO_ERROR) {
     // otherwise, we'll have to throw the appropriate exception
-    if (result->error.error == result->error.LOOKUP_ERROR) {
-      throw tf2::LookupException(result->error.error_string);
+    if (error.error == error.LOOKUP_ERROR) {
+      throw tf2::LookupException(error.error_string);
     }
 
-    if (result->error.error == result->error.CONNECTIVITY_ERROR) {
-      throw tf2::ConnectivityException(result->error.error_string);
+    if (error.error == error.CONNECTIVITY_ERROR) {
+      throw tf2::ConnectivityException(error.error_string);
     }
 
-    if (result->error.error == result->error.EXTRAPOLATION_ERROR) {
-      throw tf2::ExtrapolationException(result->error.error_string);
+    if (error.error == error.EXTRAPOLATION_ERROR) {
+      throw tf2::ExtrapolationException(error.error_string);
     }
 
-    if (result->error.error == result->error.INVALID_ARGUMENT_ERROR) {
-      throw tf2::InvalidArgumentException(result->error.error_string);
+    if (error.error == error.INVALID_ARGUMENT_ERROR) {
+      throw tf2::InvalidArgumentException(error.error_string);
     }
 
-    if (result->error.error == result->error.TIMEOUT_ERROR) {
-      throw tf2::TimeoutException(result->error.error_string);
+    if (error.error == error.TIMEOUT_ERROR) {
+      throw tf2::TimeoutException(error.error_string);
     }
 
-    throw tf2::TransformException(result->error.error_string);
+    throw tf2::TransformException(error.error_string);
   }
-
-  return result->transform;
 }
 
 bool BufferClient::canTransform(
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <tf2_ros/buffer_metrics_publisher.h>
+
+#include <diagnostic_msgs/msg/diagnostic_status.hpp>
+#include <diagnostic_msgs/msg/key_value.hpp>
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <utility>
+
+namespace tf2_ros
+{
+
+namespace
+{
+
+// Indexed by tf2::TF2Error
+const char * const FAILURE_NAMES[] = {
+  "", "lookup", "connectivity", "extrapolation", "invalid argument", "timeout", "transform"};
+
+void addValue(diagnostic_msgs::msg::DiagnosticStatus & status, std::string key, std::string value)
+{
+  diagnostic_msgs::msg::KeyValue key_value;
+  key_value.key = std::move(key);
+  key_value.value = std::move(value);
+  status.values.push_back(std::move(key_value));
+}
+
+std::string formatMicroseconds(double ns)
+{
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.3f", ns / 1e3);
+  return buffer;
+}
+
+void addCallValues(
+  diagnostic_msgs::msg::DiagnosticStatus & status, const std::string & call,
+  const tf2::BufferCoreCallMetrics & metrics)
+{
+  addValue(status, call + " calls", std::to_string(metrics.calls));
+  addValue(status, call + " failures", std::to_string(metrics.failureCount()));
+  for (size_t i = 1; i < metrics.failures.size(); ++i) {
+    if (metrics.failures[i] != 0) {
+      addValue(
+        status, call + " " + FAILURE_NAMES[i] + " failures", std::to_string(metrics.failures[i]));
+    }
+  }
+  addValue(status, call + " mean latency (us)", formatMicroseconds(metrics.latency.meanNs()));
+  addValue(
+    status, call + " 99% latency (us)",
+    formatMicroseconds(static_cast<double>(metrics.latency.percentileNs(0.99))));
+}
+
+}  // namespace
+
+void BufferMetricsPublisher::publishMetrics()
+{
+  tf2::BufferCoreMetrics metrics = buffer_.getMetrics();
+
+  diagnostic_msgs::msg::DiagnosticStatus status;
+  status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+  status.name = name_;
+  status.message = std::to_string(metrics.history_lengths.size()) + " dynamic frames";
+  addCallValues(status, "lookup", metrics.lookup);
+  addCallValues(status, "canTransform", metrics.can_transform);
+  addCallValues(status, "insert", metrics.insert);
+  addValue(status, "exclusive locks", std::to_string(metrics.exclusive_lock_count));
+  addValue(
+    status, "exclusive lock wait (us)",
+    formatMicroseconds(static_cast<double>(metrics.exclusive_lock_wait_ns)));
+  addValue(
+    status, "exclusive lock hold (us)",
+    formatMicroseconds(static_cast<double>(metrics.exclusive_lock_hold_ns)));
+  addValue(
+    status, "pending transformable requests",
+    std::to_string(metrics.pending_transformable_requests));
+  for (const auto & history : metrics.history_lengths) {
+    addValue(status, "history length " + history.first, std::to_string(history.second));
+  }
+
+  tf2::BufferCoreMemoryStats memory = buffer_.memoryStats();
+  addValue(status, "memory total (bytes)", std::to_string(memory.total()));
+  addValue(status, "memory frame history (bytes)", std::to_string(memory.frame_history_bytes));
+  addValue(status, "memory frame tables (bytes)", std::to_string(memory.frame_table_bytes));
+  addValue(
+    status, "memory transformable requests (bytes)",
+    std::to_string(memory.transformable_request_bytes));
+  addValue(status, "memory callbacks (bytes)", std::to_string(memory.callback_bytes));
+  addValue(status, "memory lookup cache (bytes)", std::to_string(memory.lookup_cache_bytes));
+  for (const tf2::FrameGraphEntry & frame : buffer_.getFrameGraph()) {
+    if (frame.allocated) {
+      addValue(status, "memory " + frame.frame_id + " (bytes)", std::to_string(frame.memory_bytes));
+    }
+  }
+  for (const tf2::InsertErrorCount & rejected : buffer_.getInsertErrors()) {
+    addValue(
+      status, std::string("rejected ") + tf2::insertErrorName(rejected.error) + " " +
+      rejected.child_frame_id + " from " + rejected.authority, std::to_string(rejected.count));
+  }
+
+  diagnostic_msgs::msg::DiagnosticArray array;
+  array.header.stamp = clock_->now();
+  array.status.push_back(std::move(status));
+  publisher_->publish(array);
+}
+
+}  // namespace tf2_ros
@@ -40,72 +40,223 @@
 #include <tf2_ros/buffer.h>  // Only needed for toMsg() and fromMsg()
 #include <tf2_ros/buffer_server.h>
 
-#include <list>
 #include <memory>
 #include <string>
+#include <tuple>
+#include <vector>
 
 namespace tf2_ros
 {
+namespace
+{
+tf2_msgs::msg::TransformRequest toRequest(const tf2_msgs::action::LookupTransform::Goal & goal)
+{
+  tf2_msgs::msg::TransformRequest request;
+  request.target_frame = goal.target_frame;
+  request.source_frame = goal.source_frame;
+  request.source_time = goal.source_time;
+  request.target_time = goal.target_time;
+  request.fixed_frame = goal.fixed_frame;
+  request.advanced = goal.advanced;
+  return request;
+}
+
+using TransformableWait = std::tuple<std::string, std::string, tf2::TimePoint>;
+
+/// The transforms a request needs, going through the fixed frame splits it in two
+std::vector<TransformableWait> transformableWaits(const tf2_msgs::msg::TransformRequest & request)
+{
+  tf2::TimePoint source_time = tf2_ros::fromMsg(request.source_time);
+  if (!request.advanced) {
+    return {TransformableWait(request.target_frame, request.source_frame, source_time)};
+  }
+  return {
+    TransformableWait(request.fixed_frame, request.source_frame, source_time),
+    TransformableWait(
+      request.target_frame, request.fixed_frame, tf2_ros::fromMsg(request.target_time))};
+}
+}  // namespace
+
+BufferServer::~BufferServer()
+{
+  std::vector<GoalInfoPtr> goals;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const auto & entry : active_goals_) {
+      goals.push_back(entry.second);
+    }
+    active_goals_.clear();
+  }
+  // The buffer must not call back into this server once it is gone
+  for (const GoalInfoPtr & info : goals) {
+    cancelRequests(*info);
+  }
+}
+
 void BufferServer::checkTransforms()
 {
-  std::unique_lock<std::mutex> lock(mutex_);
-  for (std::list<GoalInfo>::iterator it = active_goals_.begin(); it != active_goals_.end(); ) {
-    GoalInfo & info = *it;
-
-    // we want to lookup a transform if the time on the goal
-    // has expired, or a transform is available
-    if (canTransform(info.handle)) {
-      auto result = std::make_shared<LookupTransformAction::Result>();
-
-      // try to populate the result, catching exceptions if they occur
-      try {
-        result->transform = lookupTransform(info.handle);
-
-        RCLCPP_DEBUG(
-          logger_,
-          "Can transform for goal %s",
-          rclcpp_action::to_string(info.handle->get_goal_id()).c_str());
-
-        info.handle->succeed(result);
-      } catch (const tf2::ConnectivityException & ex) {
-        result->error.error = result->error.CONNECTIVITY_ERROR;
-        result->error.error_string = ex.what();
-        info.handle->abort(result);
-      } catch (const tf2::LookupException & ex) {
-        result->error.error = result->error.LOOKUP_ERROR;
-        result->error.error_string = ex.what();
-        info.handle->abort(result);
-      } catch (const tf2::ExtrapolationException & ex) {
-        result->error.error = result->error.EXTRAPOLATION_ERROR;
-        result->error.error_string = ex.what();
-        info.handle->abort(result);
-      } catch (const tf2::InvalidArgumentException & ex) {
-        result->error.error = result->error.INVALID_ARGUMENT_ERROR;
-        result->error.error_string = ex.what();
-        info.handle->abort(result);
-      } catch (const tf2::TimeoutException & ex) {
-        result->error.error = result->error.TIMEOUT_ERROR;
-        result->error.error_string = ex.what();
-        info.handle->abort(result);
-      } catch (const tf2::TransformException & ex) {
-        result->error.error = result->error.TRANSFORM_ERROR;
-        result->error.error_string = ex.what();
-        info.handle->abort(result);
+  std::vector<GoalInfoPtr> ready;
+  std::vector<GoalInfoPtr> expired;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!buffer_core_) {
+      // This buffer can't tell when transforms arrive, so poll every goal
+      for (auto it = active_goals_.begin(); it != active_goals_.end(); ) {
+        if (canTransformAll(*it->second)) {
+          ready.push_back(it->second);
+          it = active_goals_.erase(it);
+        } else {
+          ++it;
+        }
       }
+    }
 
-    } else if (info.end_time < tf2::get_now()) {
-      // Timeout
-      auto result = std::make_shared<LookupTransformAction::Result>();
-      info.handle->abort(result);
-    } else {
-      ++it;
+    const tf2::TimePoint now = tf2::get_now();
+    while (!deadlines_.empty() && deadlines_.top().first < now) {
+      auto it = active_goals_.find(deadlines_.top().second);
+      if (it != active_goals_.end()) {
+        expired.push_back(it->second);
+        active_goals_.erase(it);
+      }
+      deadlines_.pop();
+    }
+  }
+
+  for (const GoalInfoPtr & info : ready) {
+    finishGoal(*info, false);
+  }
+  for (const GoalInfoPtr & info : expired) {
+    cancelRequests(*info);
+    finishGoal(*info, true);
+  }
+}
+
+void BufferServer::addGoal(
+  const GoalInfoPtr & info, const std::vector<tf2_msgs::msg::TransformRequest> & requests)
+{
+  uint64_t goal_id;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    goal_id = next_goal_id_++;
+    // Holds the goal back until all of its requests are added
+    info->outstanding = 1;
+    active_goals_[goal_id] = info;
+    deadlines_.emplace(info->end_time, goal_id);
+  }
+  if (!buffer_core_) {
+    return;
+  }
+
+  // The callback takes mutex_ and may run on the thread that inserts, so mutex_ is only held
+  // between calls into the buffer
+  auto cb = [this, goal_id](
+    tf2::TransformableRequestHandle, const std::string &, const std::string &, tf2::TimePoint,
+    tf2::TransformableResult)
+    {
+      transformableCB(goal_id);
+    };
+  bool active = true;
+  for (const tf2_msgs::msg::TransformRequest & request : requests) {
+    for (const TransformableWait & wait : transformableWaits(request)) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        active = active_goals_.count(goal_id) != 0;
+        if (!active) {
+          break;
+        }
+        ++info->outstanding;
+      }
+      tf2::TransformableRequestHandle handle = buffer_core_->addTransformableRequest(
+        cb, std::get<0>(wait), std::get<1>(wait), std::get<2>(wait));
+      // 0 means possible right away and all ones means never possible, neither will call back.
+      // The lookup reports why the latter failed.
+      if (handle == 0 || handle == 0xffffffffffffffffULL) {
+        transformableCB(goal_id);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      active = active_goals_.count(goal_id) != 0;
+      if (active) {
+        info->requests.push_back(handle);
+      } else {
+        // The goal expired or was canceled meanwhile
+        lock.unlock();
+        buffer_core_->cancelTransformableRequest(handle);
+        break;
+      }
+    }
+    if (!active) {
+      return;
     }
+  }
+  transformableCB(goal_id);
+}
+
+void BufferServer::transformableCB(uint64_t goal_id)
+{
+  GoalInfoPtr info;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = active_goals_.find(goal_id);
+    if (it == active_goals_.end() || --it->second->outstanding != 0) {
+      return;
+    }
+    info = it->second;
+    active_goals_.erase(it);
+  }
+  finishGoal(*info, false);
+}
+
+void BufferServer::cancelRequests(const GoalInfo & info)
+{
+  if (!buffer_core_) {
+    return;
+  }
+  // Requests that already called back are no longer known to the buffer
+  for (tf2::TransformableRequestHandle handle : info.requests) {
+    buffer_core_->cancelTransformableRequest(handle);
+  }
+}
+
+void BufferServer::finishGoal(const GoalInfo & info, bool timed_out)
+{
+  if (info.batch_handle) {
+    completeBatch(info.batch_handle);
+    return;
+  }
+
+  auto result = std::make_shared<LookupTransformAction::Result>();
+  tf2_msgs::msg::TransformRequest request = toRequest(*info.handle->get_goal());
+  if (timed_out && !canTransform(request)) {
+    // Timeout
+    info.handle->abort(result);
+    return;
+  }
+
+  // try to populate the result, reporting the error if the lookup fails
+  lookupTransform(request, result->transform, result->error);
+  if (result->error.error == result->error.NO_ERROR) {
+    RCLCPP_DEBUG(
+      logger_,
+      "Can transform for goal %s",
+      rclcpp_action::to_string(info.handle->get_goal_id()).c_str());
+    info.handle->succeed(result);
+  } else {
+    info.handle->abort(result);
+  }
+}
 
-    // Remove goal if it has terminated
-    if (!info.handle->is_active()) {
-      it = active_goals_.erase(it);
+bool BufferServer::canTransformAll(const GoalInfo & info)
+{
+  if (info.handle) {
+    return canTransform(toRequest(*info.handle->get_goal()));
+  }
+  for (const tf2_msgs::msg::TransformRequest & request : info.batch_handle->get_goal()->requests) {
+    if (!canTransform(request)) {
+      return false;
     }
   }
+  return true;
 }
 
 rclcpp_action::CancelResponse BufferServer::cancelCB(GoalHandle gh)
@@ -115,32 +266,36 @@ rclcpp_action::CancelResponse BufferServer::cancelCB(GoalHandle gh)
     "Cancel request for goal %s",
     rclcpp_action::to_string(gh->get_goal_id()).c_str());
 
-  std::unique_lock<std::mutex> lock(mutex_);
-  // we need to find the goal in the list and remove it... also setting it as canceled
-  // if its not in the list, we won't do anything since it will have already been set
+  // we need to find the goal and remove it... also setting it as canceled
+  // if it's not there, we won't do anything since it will have already been set
   // as completed
-  for (std::list<GoalInfo>::iterator it = active_goals_.begin(); it != active_goals_.end(); ) {
-    GoalInfo & info = *it;
-    if (info.handle == gh) {
-      RCLCPP_DEBUG(
-        logger_,
-        "Accept cancel request for goal %s",
-        rclcpp_action::to_string(gh->get_goal_id()).c_str());
-      it = active_goals_.erase(it);
-      auto result = std::make_shared<LookupTransformAction::Result>();
-      info.handle->canceled(result);
-      return rclcpp_action::CancelResponse::ACCEPT;
-    } else {
-      ++it;
+  GoalInfoPtr info;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto it = active_goals_.begin(); it != active_goals_.end(); ++it) {
+      if (it->second->handle == gh) {
+        info = it->second;
+        active_goals_.erase(it);
+        break;
+      }
     }
   }
 
+  if (!info) {
+    RCLCPP_DEBUG(
+      logger_,
+      "Reject cancel request for goal %s",
+      rclcpp_action::to_string(gh->get_goal_id()).c_str());
+    return rclcpp_action::CancelResponse::REJECT;
+  }
+
   RCLCPP_DEBUG(
     logger_,
-    "Reject cancel request for goal %s",
+    "Accept cancel request for goal %s",
     rclcpp_action::to_string(gh->get_goal_id()).c_str());
-
-  return rclcpp_action::CancelResponse::REJECT;
+  cancelRequests(*info);
+  gh->canceled(std::make_shared<LookupTransformAction::Result>());
+  return rclcpp_action::CancelResponse::ACCEPT;
 }
 
 rclcpp_action::GoalResponse BufferServer::goalCB(
@@ -158,78 +313,140 @@ void BufferServer::acceptedCB(GoalHandle gh)
     logger_,
     "New goal accepted with ID %s",
     rclcpp_action::to_string(gh->get_goal_id()).c_str());
-  // if the transform isn't immediately available, we'll push it onto our list to check
-  // along with the time that the goal will end
-  GoalInfo goal_info;
-  goal_info.handle = gh;
-  goal_info.end_time = tf2::get_now() + tf2_ros::fromMsg(gh->get_goal()->timeout);
+  // if the transform isn't immediately available, we'll track it until it is
+  // or until the time that the goal will end
+  auto goal_info = std::make_shared<GoalInfo>();
+  goal_info->handle = gh;
+  goal_info->end_time = tf2::get_now() + tf2_ros::fromMsg(gh->get_goal()->timeout);
 
   // we can do a quick check here to see if the transform is valid
   // we'll also do this if the end time has been reached
-  if (canTransform(gh) || goal_info.end_time <= tf2::get_now()) {
+  tf2_msgs::msg::TransformRequest request = toRequest(*gh->get_goal());
+  if (canTransform(request) || goal_info->end_time <= tf2::get_now()) {
     auto result = std::make_shared<LookupTransformAction::Result>();
-    try {
-      result->transform = lookupTransform(gh);
-    } catch (const tf2::ConnectivityException & ex) {
-      result->error.error = result->error.CONNECTIVITY_ERROR;
-      result->error.error_string = ex.what();
-    } catch (const tf2::LookupException & ex) {
-      result->error.error = result->error.LOOKUP_ERROR;
-      result->error.error_string = ex.what();
-    } catch (const tf2::ExtrapolationException & ex) {
-      result->error.error = result->error.EXTRAPOLATION_ERROR;
-      result->error.error_string = ex.what();
-    } catch (const tf2::InvalidArgumentException & ex) {
-      result->error.error = result->error.INVALID_ARGUMENT_ERROR;
-      result->error.error_string = ex.what();
-    } catch (const tf2::TimeoutException & ex) {
-      result->error.error = result->error.TIMEOUT_ERROR;
-      result->error.error_string = ex.what();
-    } catch (const tf2::TransformException & ex) {
-      result->error.error = result->error.TRANSFORM_ERROR;
-      result->error.error_string = ex.what();
-    }
+    lookupTransform(request, result->transform, result->error);
 
     RCLCPP_DEBUG(logger_, "Transform available immediately for new goal");
     gh->succeed(result);
     return;
   }
 
-  std::unique_lock<std::mutex> lock(mutex_);
-  active_goals_.push_back(goal_info);
+  addGoal(goal_info, {request});
 }
 
-bool BufferServer::canTransform(GoalHandle gh)
+rclcpp_action::CancelResponse BufferServer::batchCancelCB(BatchGoalHandle gh)
 {
-  const auto goal = gh->get_goal();
+  RCLCPP_DEBUG(
+    logger_,
+    "Cancel request for batch goal %s",
+    rclcpp_action::to_string(gh->get_goal_id()).c_str());
 
-  tf2::TimePoint source_time_point = tf2_ros::fromMsg(goal->source_time);
+  GoalInfoPtr info;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto it = active_goals_.begin(); it != active_goals_.end(); ++it) {
+      if (it->second->batch_handle == gh) {
+        info = it->second;
+        active_goals_.erase(it);
+        break;
+      }
+    }
+  }
 
-  // check whether we need to used the advanced or simple api
-  if (!goal->advanced) {
-    return buffer_.canTransform(goal->target_frame, goal->source_frame, source_time_point, nullptr);
+  if (!info) {
+    return rclcpp_action::CancelResponse::REJECT;
   }
 
-  tf2::TimePoint target_time_point = tf2_ros::fromMsg(goal->target_time);
-  return buffer_.canTransform(
-    goal->target_frame, target_time_point,
-    goal->source_frame, source_time_point, goal->fixed_frame, nullptr);
+  cancelRequests(*info);
+  gh->canceled(std::make_shared<LookupTransformsAction::Result>());
+  return rclcpp_action::CancelResponse::ACCEPT;
+}
+
+rclcpp_action::GoalResponse BufferServer::batchGoalCB(
+  const rclcpp_action::GoalUUID & uuid, std::shared_ptr<const LookupTransformsAction::Goal> goal)
+{
+  (void)uuid;
+  (void)goal;
+  return rclcpp_action::GoalResponse::ACCEPT_AND_EXECUTE;
 }
 
-geometry_msgs::msg::TransformStamped BufferServer::lookupTransform(GoalHandle gh)
+void BufferServer::batchAcceptedCB(BatchGoalHandle gh)
+{
+  RCLCPP_DEBUG(
+    logger_,
+    "New batch goal of %zu lookups accepted with ID %s", gh->get_goal()->requests.size(),
+    rclcpp_action::to_string(gh->get_goal_id()).c_str());
+
+  auto goal_info = std::make_shared<GoalInfo>();
+  goal_info->batch_handle = gh;
+  goal_info->end_time = tf2::get_now() + tf2_ros::fromMsg(gh->get_goal()->timeout);
+
+  if (canTransformAll(*goal_info) || goal_info->end_time <= tf2::get_now()) {
+    completeBatch(gh);
+    return;
+  }
+
+  addGoal(goal_info, gh->get_goal()->requests);
+}
+
+void BufferServer::completeBatch(BatchGoalHandle gh)
 {
   const auto goal = gh->get_goal();
+  auto result = std::make_shared<LookupTransformsAction::Result>();
+  result->transforms.resize(goal->requests.size());
+  result->errors.resize(goal->requests.size());
+  for (size_t i = 0; i < goal->requests.size(); ++i) {
+    lookupTransform(goal->requests[i], result->transforms[i], result->errors[i]);
+  }
+  // The batch succeeds even if some of its lookups failed, their errors say why
+  gh->succeed(result);
+}
 
-  // check whether we need to used the advanced or simple api
-  if (!goal->advanced) {
-    return buffer_.lookupTransform(
-      goal->target_frame, goal->source_frame,
-      tf2_ros::fromMsg(goal->source_time));
+bool BufferServer::canTransform(const tf2_msgs::msg::TransformRequest & request)
+{
+  tf2::TimePoint source_time_point = tf2_ros::fromMsg(request.source_time);
+  if (!request.advanced) {
+    return buffer_.canTransform(
+      request.target_frame, request.source_frame, source_time_point, nullptr);
   }
 
-  return buffer_.lookupTransform(
-    goal->target_frame, tf2_ros::fromMsg(goal->target_time),
-    goal->source_frame, tf2_ros::fromMsg(goal->source_time), goal->fixed_frame);
+  return buffer_.canTransform(
+    request.target_frame, tf2_ros::fromMsg(request.target_time),
+    request.source_frame, source_time_point, request.fixed_frame, nullptr);
+}
+
+void BufferServer::lookupTransform(
+  const tf2_msgs::msg::TransformRequest & request,
+  geometry_msgs::msg::TransformStamped & transform, tf2_msgs::msg::TF2Error & error)
+{
+  try {
+    if (!request.advanced) {
+      transform = buffer_.lookupTransform(
+        request.target_frame, request.source_frame, tf2_ros::fromMsg(request.source_time));
+    } else {
+      transform = buffer_.lookupTransform(
+        request.target_frame, tf2_ros::fromMsg(request.target_time),
+        request.source_frame, tf2_ros::fromMsg(request.source_time), request.fixed_frame);
+    }
+  } catch (const tf2::ConnectivityException & ex) {
+    error.error = error.CONNECTIVITY_ERROR;
+    error.error_string = ex.what();
+  } catch (const tf2::LookupException & ex) {
+    error.error = error.LOOKUP_ERROR;
+    error.error_string = ex.what();
+  } catch (const tf2::ExtrapolationException & ex) {
+    error.error = error.EXTRAPOLATION_ERROR;
+    error.error_string = ex.what();
+  } catch (const tf2::InvalidArgumentException & ex) {
+    error.error = error.INVALID_ARGUMENT_ERROR;
+    error.error_string = ex.what();
+  } catch (const tf2::TimeoutException & ex) {
+    error.error = error.TIMEOUT_ERROR;
+    error.error_string = ex.what();
+  } catch (const tf2::TransformException & ex) {
+    error.error = error.TRANSFORM_ERROR;
+    error.error_string = ex.what();
+  }
 }
 
 }  // namespace tf2_ros
@@ -38,6 +38,7 @@
 #include <tf2_ros/buffer.h>
 #include <tf2_ros/buffer_server.h>
 #include <tf2_ros/transform_listener.h>
+#include <tf2_ros/transform_stream_server.h>
 
 #include <rclcpp/rclcpp.hpp>
 
@@ -52,6 +53,7 @@ int main(int argc, char ** argv)
   tf2_ros::Buffer buffer(node->get_clock(), tf2::durationFromSec(buffer_size));
   tf2_ros::TransformListener listener(buffer);
   tf2_ros::BufferServer buffer_server(buffer, node, "tf2_buffer_server");
+  tf2_ros::TransformStreamServer stream_server(buffer, node, "tf2_buffer_server");
 
   rclcpp::executors::SingleThreadedExecutor executor;
   executor.add_node(node);
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Republishes /tf and /tf_static as tf2_msgs/CompactTFMessage on /tf_compact and
+// /tf_static_compact, so only the compact topics need to cross a bandwidth constrained link.
+// Receivers fill their buffers with a tf2_ros::CompactTransformListener.
+
+#include <tf2/compact_tf.h>
+#include <tf2_msgs/msg/compact_tf_message.hpp>
+#include <tf2_msgs/msg/tf_message.hpp>
+#include <tf2_ros/compact_transform_listener.h>
+#include <tf2_ros/qos.hpp>
+
+#include <rclcpp/rclcpp.hpp>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+int main(int argc, char ** argv)
+{
+  rclcpp::init(argc, argv);
+  auto node = std::make_shared<rclcpp::Node>("compact_tf_bridge");
+  tf2::CompactTFEncoderOptions options;
+  options.translation_resolution = node->declare_parameter(
+    "translation_resolution", options.translation_resolution);
+  options.keyframe_interval = static_cast<uint32_t>(
+    node->declare_parameter("keyframe_interval", static_cast<int64_t>(options.keyframe_interval)));
+
+  tf2::CompactTFEncoder encoder(options);
+  // /tf_static_compact only latches the last message, so every message carries all static
+  // transforms heard so far and has to be decodable on its own
+  tf2::CompactTFEncoderOptions static_options = options;
+  static_options.keyframe_interval = 1;
+  tf2::CompactTFEncoder static_encoder(static_options);
+
+  auto publisher = node->create_publisher<tf2_msgs::msg::CompactTFMessage>(
+    "/tf_compact", tf2_ros::DynamicBroadcasterQoS());
+  auto static_publisher = node->create_publisher<tf2_msgs::msg::CompactTFMessage>(
+    "/tf_static_compact", tf2_ros::StaticBroadcasterQoS());
+
+  std::vector<geometry_msgs::msg::TransformStamped> static_transforms;
+  std::unordered_map<std::string, size_t> static_index;
+  tf2::CompactTFPacket packet;
+  tf2_msgs::msg::CompactTFMessage compact;
+  auto tf_sub = node->create_subscription<tf2_msgs::msg::TFMessage>(
+    "/tf", tf2_ros::DynamicListenerQoS(),
+    [&](const tf2_msgs::msg::TFMessage::SharedPtr msg) {
+      encoder.encode(msg->transforms, packet);
+      tf2_ros::toMsg(packet, compact);
+      publisher->publish(compact);
+    });
+  auto tf_static_sub = node->create_subscription<tf2_msgs::msg::TFMessage>(
+    "/tf_static", tf2_ros::StaticListenerQoS(),
+    [&](const tf2_msgs::msg::TFMessage::SharedPtr msg) {
+      for (const auto & transform : msg->transforms) {
+        auto inserted = static_index.emplace(transform.child_frame_id, static_transforms.size());
+        if (inserted.second) {
+          static_transforms.push_back(transform);
+        } else {
+          static_transforms[inserted.first->second] = transform;
+        }
+      }
+      static_encoder.encode(static_transforms, packet);
+      tf2_ros::toMsg(packet, compact);
+      static_publisher->publish(compact);
+    });
+
+  RCLCPP_INFO(
+    node->get_logger(), "Bridging /tf to /tf_compact with a translation resolution of %g m",
+    options.translation_resolution);
+
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(node);
+  executor.spin();
+
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tf2_ros/compact_transform_listener.h"
+
+#include <mutex>
+
+namespace tf2_ros
+{
+
+tf2::CompactTFDecoderStats CompactTransformListener::getStats() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return decoder_.getStats();
+}
+
+tf2::CompactTFDecoderStats CompactTransformListener::getStaticStats() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_decoder_.getStats();
+}
+
+void CompactTransformListener::subscription_callback(
+  const tf2_msgs::msg::CompactTFMessage & msg, bool is_static)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  fromMsg(msg, packet_);
+  tf2::CompactTFDecoder & decoder = is_static ? static_decoder_ : decoder_;
+  if (!decoder.decode(packet_, buffer_, "Authority undetectable", is_static)) {
+    RCLCPP_WARN(
+      node_logging_interface_->get_logger(), "Dropped the end of a truncated %s message",
+      is_static ? "/tf_static_compact" : "/tf_compact");
+  }
+}
+
+}  // namespace tf2_ros
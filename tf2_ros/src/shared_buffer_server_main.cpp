@@ -0,0 +1,76 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Listens to /tf and /tf_static and publishes everything it hears into a shared memory segment,
+// so processes on the same machine can look transforms up with a tf2::SharedBufferReader
+// instead of each running their own TransformListener.
+
+#include <tf2/shared_buffer.h>
+#include <tf2_msgs/msg/tf_message.hpp>
+#include <tf2_ros/qos.hpp>
+
+#include <rclcpp/rclcpp.hpp>
+
+#include <memory>
+#include <string>
+
+int main(int argc, char ** argv)
+{
+  rclcpp::init(argc, argv);
+  auto node = std::make_shared<rclcpp::Node>("tf_shared_buffer");
+  std::string segment_name = node->declare_parameter("segment_name", std::string("tf2_buffer"));
+  tf2::SharedBufferOptions options;
+  options.max_frames = static_cast<uint32_t>(
+    node->declare_parameter("max_frames", static_cast<int64_t>(options.max_frames)));
+  options.samples_per_frame = static_cast<uint32_t>(
+    node->declare_parameter("samples_per_frame", static_cast<int64_t>(options.samples_per_frame)));
+
+  tf2::SharedBufferWriter writer(segment_name, options);
+  RCLCPP_INFO(
+    node->get_logger(), "Sharing transforms in segment [%s] for up to %u frames",
+    segment_name.c_str(), options.max_frames);
+
+  auto callback = [&writer](const tf2_msgs::msg::TFMessage::SharedPtr msg, bool is_static) {
+      for (const auto & transform : msg->transforms) {
+        writer.setTransform(transform, "Authority undetectable", is_static);
+      }
+    };
+  auto tf_sub = node->create_subscription<tf2_msgs::msg::TFMessage>(
+    "/tf", tf2_ros::DynamicListenerQoS(),
+    [&callback](const tf2_msgs::msg::TFMessage::SharedPtr msg) {callback(msg, false);});
+  auto tf_static_sub = node->create_subscription<tf2_msgs::msg::TFMessage>(
+    "/tf_static", tf2_ros::StaticListenerQoS(),
+    [&callback](const tf2_msgs::msg::TFMessage::SharedPtr msg) {callback(msg, true);});
+
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(node);
+  executor.spin();
+
+  rclcpp::shutdown();
+  return 0;
+}
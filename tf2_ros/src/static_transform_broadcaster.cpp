@@ -44,31 +44,58 @@ namespace tf2_ros
 void StaticTransformBroadcaster::sendTransform(
   const geometry_msgs::msg::TransformStamped & msgtf)
 {
-  std::vector<geometry_msgs::msg::TransformStamped> v1;
-  v1.push_back(msgtf);
-  sendTransform(v1);
+  stageTransform(msgtf);
+  commit();
 }
 
 void StaticTransformBroadcaster::sendTransform(
   const std::vector<geometry_msgs::msg::TransformStamped> & msgtf)
 {
-  for (auto it_in = msgtf.begin(); it_in != msgtf.end(); ++it_in) {
-    bool match_found = false;
-    for (auto it_msg = net_message_.transforms.begin(); it_msg != net_message_.transforms.end();
-      ++it_msg)
-    {
-      if (it_in->child_frame_id == it_msg->child_frame_id) {
-        *it_msg = *it_in;
-        match_found = true;
-        break;
-      }
-    }
-    if (!match_found) {
-      net_message_.transforms.push_back(*it_in);
-    }
+  stageTransform(msgtf);
+  commit();
+}
+
+void StaticTransformBroadcaster::stageTransform(
+  const geometry_msgs::msg::TransformStamped & msgtf)
+{
+  auto inserted = index_.emplace(msgtf.child_frame_id, net_message_.transforms.size());
+  if (inserted.second) {
+    net_message_.transforms.push_back(msgtf);
+    dirty_ = true;
+    return;
   }
 
+  geometry_msgs::msg::TransformStamped & existing = net_message_.transforms[inserted.first->second];
+  if (existing != msgtf) {
+    existing = msgtf;
+    dirty_ = true;
+  }
+}
+
+void StaticTransformBroadcaster::stageTransform(
+  const std::vector<geometry_msgs::msg::TransformStamped> & msgtf)
+{
+  net_message_.transforms.reserve(net_message_.transforms.size() + msgtf.size());
+  for (const auto & transform : msgtf) {
+    stageTransform(transform);
+  }
+}
+
+bool StaticTransformBroadcaster::commit()
+{
+  // Late joiners get the whole set from the latched message anyway, so resending an unchanged
+  // set only costs every listener a redundant full update.
+  if (!dirty_) {
+    return false;
+  }
   publisher_->publish(net_message_);
+  dirty_ = false;
+  return true;
+}
+
+size_t StaticTransformBroadcaster::getNumTransforms() const
+{
+  return net_message_.transforms.size();
 }
 
 }  // namespace tf2_ros
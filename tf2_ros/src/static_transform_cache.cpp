@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <tf2_ros/static_transform_cache.h>
+
+#include <rclcpp/serialization.hpp>
+#include <rclcpp/serialized_message.hpp>
+#include <tf2_msgs/msg/tf_message.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace tf2_ros
+{
+
+namespace
+{
+
+constexpr char cache_magic[4] = {'T', 'F', '2', 'S'};
+constexpr uint32_t cache_format = 1;
+
+uint64_t hashBytes(const uint8_t * data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+  // 64 bit FNV-1a, enough to catch a truncated or damaged file
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+uint64_t hashContents(const std::string & version, const uint8_t * data, size_t size)
+{
+  uint64_t hash = hashBytes(reinterpret_cast<const uint8_t *>(version.data()), version.size());
+  return hashBytes(data, size, hash);
+}
+
+template<typename T>
+bool readValue(const std::string & contents, size_t & offset, T & value)
+{
+  if (contents.size() - offset < sizeof(T)) {
+    return false;
+  }
+  std::memcpy(&value, contents.data() + offset, sizeof(T));
+  offset += sizeof(T);
+  return true;
+}
+
+template<typename T>
+void writeValue(std::ofstream & out, const T & value)
+{
+  out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+}  // namespace
+
+const char * const StaticTransformCache::authority = "static_transform_cache";
+
+StaticTransformCache::StaticTransformCache(const std::string & path, const std::string & version)
+: path_(path), version_(version)
+{
+}
+
+bool StaticTransformCache::load()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  transforms_.clear();
+  index_.clear();
+
+  std::ifstream in(path_, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  size_t offset = 0;
+  char magic[sizeof(cache_magic)];
+  uint32_t format = 0;
+  uint32_t version_size = 0;
+  if (!readValue(contents, offset, magic) ||
+    std::memcmp(magic, cache_magic, sizeof(magic)) != 0 ||
+    !readValue(contents, offset, format) || format != cache_format ||
+    !readValue(contents, offset, version_size) || contents.size() - offset < version_size ||
+    contents.compare(offset, version_size, version_) != 0)
+  {
+    return false;
+  }
+  offset += version_size;
+
+  uint64_t hash = 0;
+  uint64_t payload_size = 0;
+  if (!readValue(contents, offset, hash) || !readValue(contents, offset, payload_size) ||
+    contents.size() - offset != payload_size)
+  {
+    return false;
+  }
+  const uint8_t * payload = reinterpret_cast<const uint8_t *>(contents.data() + offset);
+  if (hashContents(version_, payload, payload_size) != hash) {
+    return false;
+  }
+
+  tf2_msgs::msg::TFMessage message;
+  try {
+    rclcpp::SerializedMessage serialized(payload_size);
+    rcl_serialized_message_t & raw = serialized.get_rcl_serialized_message();
+    std::memcpy(raw.buffer, payload, payload_size);
+    raw.buffer_length = payload_size;
+    rclcpp::Serialization<tf2_msgs::msg::TFMessage>().deserialize_message(&serialized, &message);
+  } catch (const std::exception &) {
+    return false;
+  }
+
+  transforms_.reserve(message.transforms.size());
+  for (auto & transform : message.transforms) {
+    if (index_.emplace(transform.child_frame_id, transforms_.size()).second) {
+      transforms_.push_back(std::move(transform));
+    }
+  }
+  return true;
+}
+
+void StaticTransformCache::apply(tf2::BufferCore & buffer) const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!transforms_.empty()) {
+    buffer.setTransforms(transforms_, authority, true);
+  }
+}
+
+bool StaticTransformCache::update(
+  const std::vector<geometry_msgs::msg::TransformStamped> & transforms)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  bool changed = false;
+  for (const auto & transform : transforms) {
+    auto inserted = index_.emplace(transform.child_frame_id, transforms_.size());
+    if (inserted.second) {
+      transforms_.push_back(transform);
+      changed = true;
+    } else if (transforms_[inserted.first->second] != transform) {
+      transforms_[inserted.first->second] = transform;
+      changed = true;
+    }
+  }
+  return !changed || write();
+}
+
+std::vector<geometry_msgs::msg::TransformStamped> StaticTransformCache::getTransforms() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return transforms_;
+}
+
+bool StaticTransformCache::write() const
+{
+  tf2_msgs::msg::TFMessage message;
+  message.transforms = transforms_;
+  rclcpp::SerializedMessage serialized;
+  try {
+    rclcpp::Serialization<tf2_msgs::msg::TFMessage>().serialize_message(&message, &serialized);
+  } catch (const std::exception &) {
+    return false;
+  }
+  const rcl_serialized_message_t & raw = serialized.get_rcl_serialized_message();
+
+  // Write next to the cache and rename over it, so a reader never sees a partial file
+  const std::string tmp_path = path_ + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      return false;
+    }
+    out.write(cache_magic, sizeof(cache_magic));
+    writeValue(out, cache_format);
+    writeValue(out, static_cast<uint32_t>(version_.size()));
+    out.write(version_.data(), version_.size());
+    writeValue(out, hashContents(version_, raw.buffer, raw.buffer_length));
+    writeValue(out, static_cast<uint64_t>(raw.buffer_length));
+    out.write(reinterpret_cast<const char *>(raw.buffer), raw.buffer_length);
+    if (!out.flush()) {
+      return false;
+    }
+  }
+  return std::rename(tmp_path.c_str(), path_.c_str()) == 0;
+}
+
+}  // namespace tf2_ros
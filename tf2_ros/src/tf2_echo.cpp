@@ -29,15 +29,19 @@
  */
 
 #include <tf2_ros/buffer.h>
+#include <tf2_ros/qos.hpp>
 #include <tf2_ros/transform_listener.h>
 
+#include <tf2_msgs/msg/tf_message.hpp>
 #include <rclcpp/rclcpp.hpp>
 
 #include <cstdio>
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #define _USE_MATH_DEFINES
@@ -59,17 +63,115 @@ public:
   }
 };
 
+/** \brief Feeds a small buffer with the transforms of the frames on one chain only
+ *
+ * Used by --every-update, so the tool neither stores nor interpolates the rest of the tree,
+ * however busy /tf is.
+ */
+class ChainListener
+{
+public:
+  tf2::BufferCore buffer_;
+
+  ChainListener(
+    rclcpp::Node::SharedPtr node, const std::vector<std::string> & chain,
+    std::function<void()> on_update)
+  : chain_(chain.begin(), chain.end()),
+    on_update_(on_update)
+  {
+    sub_tf_ = node->create_subscription<tf2_msgs::msg::TFMessage>(
+      "/tf", tf2_ros::DynamicListenerQoS(),
+      [this](tf2_msgs::msg::TFMessage::ConstSharedPtr msg) {callback(*msg, false);});
+    sub_tf_static_ = node->create_subscription<tf2_msgs::msg::TFMessage>(
+      "/tf_static", tf2_ros::StaticListenerQoS(),
+      [this](tf2_msgs::msg::TFMessage::ConstSharedPtr msg) {callback(*msg, true);});
+  }
+
+private:
+  void callback(const tf2_msgs::msg::TFMessage & msg, bool is_static)
+  {
+    transforms_.clear();
+    for (const auto & transform : msg.transforms) {
+      const std::string & child = transform.child_frame_id;
+      if (chain_.count(!child.empty() && child[0] == '/' ? child.substr(1) : child)) {
+        transforms_.push_back(transform);
+      }
+    }
+    if (transforms_.empty()) {
+      return;
+    }
+    buffer_.setTransforms(transforms_, "default_authority", is_static);
+    on_update_();
+  }
+
+  std::unordered_set<std::string> chain_;
+  std::function<void()> on_update_;
+  /// The transforms of the current message that are on the chain, reused between messages
+  std::vector<geometry_msgs::msg::TransformStamped> transforms_;
+  rclcpp::Subscription<tf2_msgs::msg::TFMessage>::SharedPtr sub_tf_, sub_tf_static_;
+};
+
+/// Print one transform, as a single comma separated line of numbers if csv is set
+void printTransform(const geometry_msgs::msg::TransformStamped & echo_transform, bool csv)
+{
+  auto translation = echo_transform.transform.translation;
+  auto rotation = echo_transform.transform.rotation;
+  if (csv) {
+    // A single buffered write per record, stdout is only flushed when its buffer fills up
+    std::printf(
+      "%d.%09u,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g\n",
+      echo_transform.header.stamp.sec, echo_transform.header.stamp.nanosec,
+      translation.x, translation.y, translation.z,
+      rotation.x, rotation.y, rotation.z, rotation.w);
+    return;
+  }
+  std::cout.precision(3);
+  std::cout.setf(std::ios::fixed, std::ios::floatfield);
+  std::cout << "At time " << echo_transform.header.stamp.sec << "." <<
+    echo_transform.header.stamp.nanosec << std::endl;
+  // double yaw, pitch, roll;
+  // echo_transform.getBasis().getRPY(roll, pitch, yaw);
+  // tf::Quaternion q = echo_transform.getRotation();
+  // tf::Vector3 v = echo_transform.getOrigin();
+  std::cout << "- Translation: [" << translation.x << ", " << translation.y << ", " <<
+    translation.z << "]" << std::endl;
+  std::cout << "- Rotation: in Quaternion [" << rotation.x << ", " << rotation.y << ", " <<
+    rotation.z << ", " << rotation.w << "]" << std::endl;
+  // TODO(tfoote): restory rpy
+  // << "            in RPY (radian) [" <<  roll << ", " << pitch << ", " << yaw << "]" <<
+  // std::endl
+  // << "            in RPY (degree) [" <<  roll*180.0/M_PI << ", " << pitch*180.0/M_PI <<
+  // ", " << yaw*180.0/M_PI << "]" << std::endl;
+}
+
 
 int main(int argc, char ** argv)
 {
   // Initialize ROS
-  std::vector<std::string> args = rclcpp::init_and_remove_ros_arguments(argc, argv);
+  std::vector<std::string> all_args = rclcpp::init_and_remove_ros_arguments(argc, argv);
+
+  // Options may come anywhere, the remaining arguments are positional
+  bool every_update = false;
+  bool csv = false;
+  bool bad_option = false;
+  std::vector<std::string> args;
+  for (const std::string & arg : all_args) {
+    if (arg == "--every-update") {
+      every_update = true;
+    } else if (arg == "--csv") {
+      csv = true;
+    } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+      bad_option = true;
+    } else {
+      args.push_back(arg);
+    }
+  }
 
   double rate_hz;
   // Allow 2 or 3 command line arguments
-  if (args.size() == 3) {
+  if (!bad_option && args.size() == 3) {
     rate_hz = 1.0;
-  } else if (args.size() == 4) {
+  } else if (!bad_option && args.size() == 4) {
     size_t pos;
     try {
       rate_hz = std::stof(args[3], &pos);
@@ -90,11 +192,14 @@ int main(int argc, char ** argv)
       return 3;
     }
   } else {
-    printf("Usage: tf2_echo source_frame target_frame [echo_rate]\n\n");
+    printf("Usage: tf2_echo [--every-update] [--csv] source_frame target_frame [echo_rate]\n\n");
     printf("This will echo the transform from the coordinate frame of the source_frame\n");
     printf("to the coordinate frame of the target_frame. \n");
     printf("Note: This is the transform to get data from target_frame into the source_frame.\n");
     printf("Default echo rate is 1 if echo_rate is not given.\n");
+    printf("--every-update echoes every update of the frames between the two instead,\n");
+    printf("  only keeping the transforms of those frames.\n");
+    printf("--csv prints one line per transform: stamp,x,y,z,qx,qy,qz,qw\n");
     return 1;
   }
   // TODO(tfoote): restore parameter option
@@ -110,14 +215,14 @@ int main(int argc, char ** argv)
 
   rclcpp::Clock::SharedPtr clock = nh->get_clock();
   // Instantiate a local listener
-  echoListener echoListener(clock);
+  auto echo_listener = std::make_unique<echoListener>(clock);
 
   std::string source_frameid = args[1];
   std::string target_frameid = args[2];
 
   // Wait for the first transforms to become avaiable.
   std::string warning_msg;
-  while (rclcpp::ok() && !echoListener.buffer_.canTransform(
+  while (rclcpp::ok() && !echo_listener->buffer_.canTransform(
       source_frameid, target_frameid, tf2::TimePoint(), &warning_msg))
   {
     RCLCPP_INFO_THROTTLE(
@@ -126,38 +231,65 @@ int main(int argc, char ** argv)
     rate.sleep();
   }
 
+  if (csv) {
+    std::printf("# stamp,x,y,z,qx,qy,qz,qw\n");
+  }
+
+  if (every_update) {
+    // Only the frames between the two are needed from here on, the chain is the one found at
+    // startup
+    std::vector<std::string> chain;
+    try {
+      echo_listener->buffer_._chainAsVector(
+        source_frameid, tf2::TimePointZero, target_frameid, tf2::TimePointZero, source_frameid,
+        chain);
+    } catch (const tf2::TransformException & ex) {
+      std::cout << "Exception thrown:" << ex.what() << std::endl;
+      return 4;
+    }
+    echo_listener.reset();
+
+    ChainListener * chain_listener = nullptr;
+    builtin_interfaces::msg::Time last_stamp;
+    auto on_update = [&]() {
+        geometry_msgs::msg::TransformStamped echo_transform;
+        try {
+          echo_transform = chain_listener->buffer_.lookupTransform(
+            source_frameid, target_frameid, tf2::TimePointZero);
+        } catch (const tf2::TransformException &) {
+          // Not all frames of the chain have been received yet
+          return;
+        }
+        // Updates of one frame of the chain may leave the latest common time where it was
+        if (echo_transform.header.stamp != last_stamp) {
+          last_stamp = echo_transform.header.stamp;
+          printTransform(echo_transform, csv);
+        }
+      };
+    ChainListener listener(nh, chain, on_update);
+    chain_listener = &listener;
+    rclcpp::spin(nh);
+    std::fflush(stdout);
+    return 0;
+  }
+
   // Nothing needs to be done except wait for a quit
   // The callbacks within the listener class will take care of everything
   while (rclcpp::ok()) {
     try {
       geometry_msgs::msg::TransformStamped echo_transform;
-      echo_transform = echoListener.buffer_.lookupTransform(
+      echo_transform = echo_listener->buffer_.lookupTransform(
         source_frameid, target_frameid,
         tf2::TimePoint());
-      std::cout.precision(3);
-      std::cout.setf(std::ios::fixed, std::ios::floatfield);
-      std::cout << "At time " << echo_transform.header.stamp.sec << "." <<
-        echo_transform.header.stamp.nanosec << std::endl;
-      // double yaw, pitch, roll;
-      // echo_transform.getBasis().getRPY(roll, pitch, yaw);
-      // tf::Quaternion q = echo_transform.getRotation();
-      // tf::Vector3 v = echo_transform.getOrigin();
-      auto translation = echo_transform.transform.translation;
-      auto rotation = echo_transform.transform.rotation;
-      std::cout << "- Translation: [" << translation.x << ", " << translation.y << ", " <<
-        translation.z << "]" << std::endl;
-      std::cout << "- Rotation: in Quaternion [" << rotation.x << ", " << rotation.y << ", " <<
-        rotation.z << ", " << rotation.w << "]" << std::endl;
-      // TODO(tfoote): restory rpy
-      // << "            in RPY (radian) [" <<  roll << ", " << pitch << ", " << yaw << "]" <<
-      // std::endl
-      // << "            in RPY (degree) [" <<  roll*180.0/M_PI << ", " << pitch*180.0/M_PI <<
-      // ", " << yaw*180.0/M_PI << "]" << std::endl;
+      printTransform(echo_transform, csv);
+      if (csv) {
+        std::fflush(stdout);
+      }
     } catch (const tf2::TransformException & ex) {
       std::cout << "Failure at " << clock->now().seconds() << std::endl;
       std::cout << "Exception thrown:" << ex.what() << std::endl;
       std::cout << "The current list of frames is:" << std::endl;
-      std::cout << echoListener.buffer_.allFramesAsString() << std::endl;
+      std::cout << echo_listener->buffer_.allFramesAsString() << std::endl;
     }
     rate.sleep();
   }
@@ -38,101 +38,219 @@
 #include <rclcpp/rclcpp.hpp>
 
 #include <algorithm>
-#include <map>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
 #include <memory>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+/** \brief Statistics over the most recent samples of a stream.
+ *
+ * The samples live in a fixed size ring and their sum and maximum are updated as samples enter
+ * and leave it, so adding a sample takes constant time however long the monitor runs.
+ */
+class WindowStatistics
+{
+public:
+  explicit WindowStatistics(size_t capacity = 1000)
+  : samples_(capacity) {}
+
+  void add(double sample)
+  {
+    if (size_ == samples_.size()) {
+      sum_ -= samples_[head_];
+    } else {
+      ++size_;
+    }
+    samples_[head_] = sample;
+    sum_ += sample;
+
+    // The maxima deque holds samples in decreasing order, each newer than the one before it,
+    // so its front is the maximum of the window.
+    const uint64_t index = count_++;
+    while (!maxima_.empty() && maxima_.back().second <= sample) {
+      maxima_.pop_back();
+    }
+    maxima_.emplace_back(index, sample);
+    if (maxima_.front().first + samples_.size() <= index) {
+      maxima_.pop_front();
+    }
+
+    head_ = (head_ + 1) % samples_.size();
+    if (head_ == 0) {
+      // Resum once per lap so rounding errors from the subtractions can't accumulate.
+      sum_ = 0.0;
+      for (size_t i = 0; i < size_; ++i) {
+        sum_ += samples_[i];
+      }
+    }
+  }
+
+  size_t size() const
+  {
+    return size_;
+  }
+
+  double mean() const
+  {
+    return size_ ? sum_ / size_ : 0.0;
+  }
+
+  double max() const
+  {
+    return maxima_.empty() ? 0.0 : maxima_.front().second;
+  }
+
+  double oldest() const
+  {
+    return samples_[(head_ + samples_.size() - size_) % samples_.size()];
+  }
+
+  double newest() const
+  {
+    return samples_[(head_ + samples_.size() - 1) % samples_.size()];
+  }
+
+  /** \brief The sample below which the given fraction of the window falls.
+   *
+   * Only called when printing results, so it selects from a copy of the window.
+   */
+  double percentile(double fraction) const
+  {
+    if (size_ == 0) {
+      return 0.0;
+    }
+    std::vector<double> sorted(samples_.begin(), samples_.begin() + size_);
+    auto nth = sorted.begin() + std::min(
+      size_ - 1, static_cast<size_t>(fraction * static_cast<double>(size_)));
+    std::nth_element(sorted.begin(), nth, sorted.end());
+    return *nth;
+  }
+
+private:
+  std::vector<double> samples_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+  uint64_t count_ = 0;
+  double sum_ = 0.0;
+  std::deque<std::pair<uint64_t, double>> maxima_;
+};
+
 class TFMonitor
 {
 public:
   std::string framea_, frameb_;
   bool using_specific_chain_;
+  bool print_records_;
 
   rclcpp::Node::SharedPtr node_;
   rclcpp::Subscription<tf2_msgs::msg::TFMessage>::SharedPtr subscriber_tf_, subscriber_tf_message_;
   std::vector<std::string> chain_;
-  std::map<std::string, std::string> frame_authority_map;
-  std::map<std::string, std::vector<double>> delay_map;
-  std::map<std::string, std::vector<double>> authority_map;
-  std::map<std::string, std::vector<double>> authority_frequency_map;
+  /// The frames of chain_, messages are filtered down to these before anything else is done
+  std::unordered_set<std::string> chain_frames_;
+  std::unordered_map<std::string, std::string> frame_authority_map;
+  std::unordered_map<std::string, WindowStatistics> delay_map;
+  std::unordered_map<std::string, WindowStatistics> authority_map;
+  std::unordered_map<std::string, WindowStatistics> authority_frequency_map;
 
   rclcpp::Clock::SharedPtr clock_;
-  tf2_ros::Buffer buffer_;
-  std::shared_ptr<tf2_ros::TransformListener> tf_;
+  /// Only holds the transforms of the frames on chain_, to measure the delay of the whole chain
+  tf2::BufferCore chain_buffer_;
+  /// The transforms of the current message that are on the chain, reused between messages
+  std::vector<geometry_msgs::msg::TransformStamped> chain_transforms_;
+  double max_diff_ = 0;
+  double avg_diff_ = 0;
 
   tf2_msgs::msg::TFMessage message_;
   std::mutex map_mutex_;
 
-  void callback(const tf2_msgs::msg::TFMessage::SharedPtr msg)
+  void callback(const tf2_msgs::msg::TFMessage::SharedPtr msg, bool is_static)
   {
     const tf2_msgs::msg::TFMessage & message = *(msg);
     // TODO(tfoote): recover authority info
     std::string authority = "<no authority available>";
 
+    const double now = clock_->now().seconds();
     double average_offset = 0;
+    size_t count = 0;
     std::unique_lock<std::mutex> my_lock(map_mutex_);
-    for (size_t i = 0; i < message.transforms.size(); i++) {
-      frame_authority_map[message.transforms[i].child_frame_id] = authority;
+    chain_transforms_.clear();
+    for (const auto & transform : message.transforms) {
+      if (using_specific_chain_) {
+        if (!chain_frames_.count(transform.child_frame_id)) {
+          continue;
+        }
+        chain_transforms_.push_back(transform);
+      }
+      auto inserted = frame_authority_map.emplace(transform.child_frame_id, authority);
+      if (!inserted.second && inserted.first->second != authority) {
+        inserted.first->second = authority;
+      }
 
-      double offset = clock_->now().seconds() - tf2_ros::timeToSec(
-        message.transforms[i].header.stamp);
+      double offset = now - tf2_ros::timeToSec(transform.header.stamp);
       average_offset += offset;
-
-      std::map<std::string, std::vector<double>>::iterator it = delay_map.find(
-        message.transforms[i].child_frame_id);
-      if (it == delay_map.end()) {
-        delay_map[message.transforms[i].child_frame_id] = std::vector<double>(1, offset);
-      } else {
-        it->second.push_back(offset);
-        if (it->second.size() > 1000) {
-          it->second.erase(it->second.begin());
-        }
+      ++count;
+      delay_map[transform.child_frame_id].add(offset);
+      if (print_records_) {
+        // One compact line per sample: receive time, frame, stamp, delay
+        std::printf(
+          "%.6f,%s,%d.%09u,%.6f\n", now, transform.child_frame_id.c_str(),
+          transform.header.stamp.sec, transform.header.stamp.nanosec, offset);
       }
     }
+    if (count == 0) {
+      return;
+    }
 
-    average_offset /= std::max((size_t) 1, message.transforms.size());
+    average_offset /= count;
 
     // create the authority log
-    std::map<std::string, std::vector<double>>::iterator it2 = authority_map.find(authority);
-    if (it2 == authority_map.end()) {
-      authority_map[authority] = std::vector<double>(1, average_offset);
-    } else {
-      it2->second.push_back(average_offset);
-      if (it2->second.size() > 1000) {
-        it2->second.erase(it2->second.begin());
-      }
-    }
+    authority_map[authority].add(average_offset);
 
     // create the authority frequency log
-    std::map<std::string, std::vector<double>>::iterator it3 = authority_frequency_map.find(
-      authority);
-    if (it3 == authority_frequency_map.end()) {
-      authority_frequency_map[authority] = std::vector<double>(1, clock_->now().seconds());
-    } else {
-      it3->second.push_back(clock_->now().seconds());
-      if (it3->second.size() > 1000) {
-        it3->second.erase(it3->second.begin());
+    authority_frequency_map[authority].add(now);
+
+    if (using_specific_chain_ && !chain_transforms_.empty()) {
+      // Measure the delay of the whole chain on every update of it instead of polling
+      chain_buffer_.setTransforms(chain_transforms_, authority, is_static);
+      geometry_msgs::msg::TransformStamped tmp;
+      try {
+        tmp = chain_buffer_.lookupTransform(framea_, frameb_, tf2::TimePointZero);
+      } catch (const tf2::TransformException &) {
+        // Not all frames of the chain have been received yet
+        return;
+      }
+      double diff = now - tf2_ros::timeToSec(tmp.header.stamp);
+      const double lowpass = 0.01;
+      avg_diff_ = lowpass * diff + (1 - lowpass) * avg_diff_;
+      if (diff > max_diff_) {
+        max_diff_ = diff;
       }
     }
   }
 
   TFMonitor(
     rclcpp::Node::SharedPtr node, bool using_specific_chain,
-    std::string framea = "", std::string frameb = "")
+    std::string framea = "", std::string frameb = "", bool print_records = false)
   : framea_(framea),
     frameb_(frameb),
     using_specific_chain_(using_specific_chain),
+    print_records_(print_records),
     node_(node),
-    clock_(node->get_clock()),
-    buffer_(clock_, tf2::Duration(tf2::BUFFER_CORE_DEFAULT_CACHE_TIME), node)
+    clock_(node->get_clock())
   {
-    tf_ = std::make_shared<tf2_ros::TransformListener>(buffer_);
-
     if (using_specific_chain_) {
+      // A full buffer is only needed to find the chain, afterwards the frames on it are all
+      // that is kept
+      tf2_ros::Buffer buffer(clock_, tf2::Duration(tf2::BUFFER_CORE_DEFAULT_CACHE_TIME), node);
+      tf2_ros::TransformListener tf(buffer);
       std::string warning_msg;
-      while (rclcpp::ok() && !buffer_.canTransform(
+      while (rclcpp::ok() && !buffer.canTransform(
           framea_, frameb_, tf2::TimePoint(), &warning_msg))
       {
         RCLCPP_INFO_THROTTLE(
@@ -143,118 +261,104 @@ public:
       }
 
       try {
-        buffer_._chainAsVector(
+        buffer._chainAsVector(
           frameb_, tf2::TimePointZero, framea_, tf2::TimePointZero, frameb_,
           chain_);
       } catch (const tf2::TransformException & ex) {
         RCLCPP_WARN(node->get_logger(), "Transform Exception %s", ex.what());
         return;
       }
+      chain_frames_.insert(chain_.begin(), chain_.end());
+    }
+
+    if (print_records_) {
+      std::printf("# receive_time,frame,stamp,delay\n");
     }
 
     subscriber_tf_ = node_->create_subscription<tf2_msgs::msg::TFMessage>(
       "/tf", tf2_ros::DynamicListenerQoS(),
-      std::bind(&TFMonitor::callback, this, std::placeholders::_1));
+      std::bind(&TFMonitor::callback, this, std::placeholders::_1, false));
     subscriber_tf_message_ = node_->create_subscription<tf2_msgs::msg::TFMessage>(
       "/tf_static", tf2_ros::StaticListenerQoS(),
-      std::bind(&TFMonitor::callback, this, std::placeholders::_1));
+      std::bind(&TFMonitor::callback, this, std::placeholders::_1, true));
   }
 
   std::string outputFrameInfo(
-    const std::map<std::string, std::vector<double>>::iterator & it,
+    const std::string & frame, const WindowStatistics & delays,
     const std::string & frame_authority)
   {
     std::stringstream ss;
-    double average_delay = 0;
-    double max_delay = 0;
-    for (size_t i = 0; i < it->second.size(); i++) {
-      average_delay += it->second[i];
-      max_delay = std::max(max_delay, it->second[i]);
-    }
-    average_delay /= it->second.size();
-    ss << "Frame: " << it->first << ", published by " << frame_authority << ", Average Delay: " <<
-      average_delay << ", Max Delay: " << max_delay << std::endl;
+    ss << "Frame: " << frame << ", published by " << frame_authority << ", Average Delay: " <<
+      delays.mean() << ", 95% Delay: " << delays.percentile(0.95) << ", Max Delay: " <<
+      delays.max() << std::endl;
     return ss.str();
   }
 
   void spin()
   {
-    // create tf listener
-    double max_diff = 0;
-    double avg_diff = 0;
-    double lowpass = 0.01;
-    unsigned int counter = 0;
+    // With records going to stdout, the summaries go to stderr so the records stay parseable
+    std::ostream & out = print_records_ ? std::cerr : std::cout;
 
     if (using_specific_chain_) {
-      std::cout << "Gathering data on " << framea_ << " -> " << frameb_ << " for 10 seconds...\n";
+      out << "Gathering data on " << framea_ << " -> " << frameb_ << " for 10 seconds...\n";
     } else {
-      std::cout << "Gathering data on all frames for 10 seconds...\n";
+      out << "Gathering data on all frames for 10 seconds...\n";
     }
 
-
+    unsigned int counter = 0;
     while (rclcpp::ok()) {
-      counter++;
-      if (using_specific_chain_) {
-        auto tmp = buffer_.lookupTransform(framea_, frameb_, tf2::TimePointZero);
-        double diff = clock_->now().seconds() - tf2_ros::timeToSec(tmp.header.stamp);
-        avg_diff = lowpass * diff + (1 - lowpass) * avg_diff;
-        if (diff > max_diff) {
-          max_diff = diff;
-        }
-      }
+      // The chain delay is measured by callback(), this only prints the results now and then
       std::this_thread::sleep_for(std::chrono::milliseconds(500));
-      if (counter > 20) {
-        counter = 0;
-
-        if (using_specific_chain_) {
-          std::cout << std::endl << std::endl << std::endl << "RESULTS: for " << framea_ <<
-            " to " << frameb_ << std::endl;
-          std::cout << "Chain is: ";
-          for (size_t i = 0; i < chain_.size(); i++) {
-            std::cout << chain_[i];
-            if (i != chain_.size() - 1) {
-              std::cout << " -> ";
-            }
-          }
-          std::cout << std::endl;
-          std::cout << "Net delay " << "    avg = " << avg_diff << ": max = " << max_diff <<
-            std::endl;
-        } else {
-          std::cout << std::endl << std::endl << std::endl << "RESULTS: for all Frames" <<
-            std::endl;
-        }
-        std::unique_lock<std::mutex> lock(map_mutex_);
-        std::cout << std::endl << "Frames:" << std::endl;
-        std::map<std::string, std::vector<double>>::iterator it = delay_map.begin();
-        for ( ; it != delay_map.end(); ++it) {
-          if (using_specific_chain_) {
-            for (size_t i = 0; i < chain_.size(); i++) {
-              if (it->first != chain_[i]) {
-                continue;
-              }
-
-              std::cout << outputFrameInfo(it, frame_authority_map[it->first]);
-            }
-          } else {
-            std::cout << outputFrameInfo(it, frame_authority_map[it->first]);
-          }
-        }
-        std::cerr << std::endl << "All Broadcasters:" << std::endl;
-        std::map<std::string, std::vector<double>>::iterator it1 = authority_map.begin();
-        std::map<std::string, std::vector<double>>::iterator it2 = authority_frequency_map.begin();
-        for ( ; it1 != authority_map.end(); ++it1, ++it2) {
-          double average_delay = 0;
-          double max_delay = 0;
-          for (size_t i = 0; i < it1->second.size(); i++) {
-            average_delay += it1->second[i];
-            max_delay = std::max(max_delay, it1->second[i]);
+      if (++counter <= 20) {
+        continue;
+      }
+      counter = 0;
+
+      std::unique_lock<std::mutex> lock(map_mutex_);
+      if (print_records_) {
+        std::fflush(stdout);
+      }
+      if (using_specific_chain_) {
+        out << std::endl << std::endl << std::endl << "RESULTS: for " << framea_ <<
+          " to " << frameb_ << std::endl;
+        out << "Chain is: ";
+        for (size_t i = 0; i < chain_.size(); i++) {
+          out << chain_[i];
+          if (i != chain_.size() - 1) {
+            out << " -> ";
           }
-          average_delay /= it1->second.size();
-          double frequency_out = static_cast<double>(it2->second.size()) /
-            std::max(0.00000001, (it2->second.back() - it2->second.front()));
-          std::cout << "Node: " << it1->first << " " << frequency_out << " Hz, Average Delay: " <<
-            average_delay << " Max Delay: " << max_delay << std::endl;
         }
+        out << std::endl;
+        out << "Net delay " << "    avg = " << avg_diff_ << ": max = " << max_diff_ <<
+          std::endl;
+      } else {
+        out << std::endl << std::endl << std::endl << "RESULTS: for all Frames" <<
+          std::endl;
+      }
+      out << std::endl << "Frames:" << std::endl;
+      // Messages were filtered down to the chain already, so every frame here is on it
+      std::vector<std::string> frames;
+      frames.reserve(delay_map.size());
+      for (const auto & entry : delay_map) {
+        frames.push_back(entry.first);
+      }
+      std::sort(frames.begin(), frames.end());
+      for (const std::string & frame : frames) {
+        out << outputFrameInfo(frame, delay_map[frame], frame_authority_map[frame]);
+      }
+      out << std::endl << "All Broadcasters:" << std::endl;
+      std::vector<std::string> authorities;
+      for (const auto & entry : authority_map) {
+        authorities.push_back(entry.first);
+      }
+      std::sort(authorities.begin(), authorities.end());
+      for (const std::string & authority : authorities) {
+        const WindowStatistics & delays = authority_map[authority];
+        const WindowStatistics & stamps = authority_frequency_map[authority];
+        double frequency_out = static_cast<double>(stamps.size()) /
+          std::max(0.00000001, (stamps.newest() - stamps.oldest()));
+        out << "Node: " << authority << " " << frequency_out << " Hz, Average Delay: " <<
+          delays.mean() << " Max Delay: " << delays.max() << std::endl;
       }
     }
   }
@@ -269,6 +373,14 @@ int main(int argc, char ** argv)
   // TODO(tfoote): make anonymous
   rclcpp::Node::SharedPtr nh = rclcpp::Node::make_shared("tf2_monitor_main");
 
+  // --records prints every received sample as one line of comma separated values
+  bool print_records = false;
+  auto records = std::find(args.begin(), args.end(), "--records");
+  if (records != args.end()) {
+    print_records = true;
+    args.erase(records);
+  }
+
   std::string framea, frameb;
   bool using_specific_chain = true;
   if (args.size() == 3) {
@@ -277,7 +389,8 @@ int main(int argc, char ** argv)
   } else if (args.size() == 1) {
     using_specific_chain = false;
   } else {
-    RCLCPP_INFO(nh->get_logger(), "TF_Monitor: usage: tf2_monitor framea frameb");
+    RCLCPP_INFO(
+      nh->get_logger(), "TF_Monitor: usage: tf2_monitor [--records] [framea frameb]");
     return -1;
   }
 
@@ -301,7 +414,7 @@ int main(int argc, char ** argv)
   auto run_func = [](rclcpp::Node::SharedPtr node) {
       return rclcpp::spin(node);
     };
-  TFMonitor monitor(nh, using_specific_chain, framea, frameb);
+  TFMonitor monitor(nh, using_specific_chain, framea, frameb, print_records);
   std::thread spinner(run_func, nh);
 
   monitor.spin();
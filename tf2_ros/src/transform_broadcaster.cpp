@@ -36,6 +36,8 @@
 #include <rclcpp/rclcpp.hpp>
 #include <tf2_msgs/msg/tf_message.hpp>
 
+#include <memory>
+#include <utility>
 #include <vector>
 
 namespace tf2_ros
@@ -43,21 +45,40 @@ namespace tf2_ros
 
 void TransformBroadcaster::sendTransform(const geometry_msgs::msg::TransformStamped & msgtf)
 {
-  std::vector<geometry_msgs::msg::TransformStamped> v1;
-  v1.push_back(msgtf);
-  sendTransform(v1);
+  std::lock_guard<std::mutex> lock(message_mutex_);
+  message_.transforms.resize(1);
+  message_.transforms[0] = msgtf;
+  publisher_->publish(message_);
 }
 
 void TransformBroadcaster::sendTransform(
   const std::vector<geometry_msgs::msg::TransformStamped> & msgtf)
 {
-  tf2_msgs::msg::TFMessage message;
-  for (std::vector<geometry_msgs::msg::TransformStamped>::const_iterator it = msgtf.begin();
-    it != msgtf.end(); ++it)
-  {
-    message.transforms.push_back(*it);
-  }
+  // Assigning reuses the storage of the previous broadcast
+  std::lock_guard<std::mutex> lock(message_mutex_);
+  message_.transforms = msgtf;
+  publisher_->publish(message_);
+}
+
+void TransformBroadcaster::sendTransform(std::unique_ptr<tf2_msgs::msg::TFMessage> message)
+{
+  publisher_->publish(std::move(message));
+}
+
+void TransformBroadcaster::sendTransform(const tf2_msgs::msg::TFMessage & message)
+{
   publisher_->publish(message);
 }
 
+rclcpp::LoanedMessage<tf2_msgs::msg::TFMessage> TransformBroadcaster::borrowMessage()
+{
+  return publisher_->borrow_loaned_message();
+}
+
+void TransformBroadcaster::sendTransform(
+  rclcpp::LoanedMessage<tf2_msgs::msg::TFMessage> && message)
+{
+  publisher_->publish(std::move(message));
+}
+
 }  // namespace tf2_ros
@@ -29,19 +29,55 @@
 
 /** \author Tully Foote */
 
+#include <algorithm>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "tf2/tracing.h"
+#include "tf2_ros/buffer_interface.h"
 #include "tf2_ros/transform_listener.h"
 
 namespace tf2_ros
 {
 
+namespace
+{
+
+/// Apply the affinity and priority of thread_options to the calling thread
+bool configureCurrentThread(const TransformListenerThreadOptions & thread_options)
+{
+#ifdef __linux__
+  bool ok = true;
+  if (thread_options.cpu_affinity >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(thread_options.cpu_affinity, &cpus);
+    ok &= pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+  }
+  if (thread_options.priority > 0) {
+    sched_param param;
+    param.sched_priority = thread_options.priority;
+    ok &= pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+  }
+  return ok;
+#else
+  return thread_options.cpu_affinity < 0 && thread_options.priority <= 0;
+#endif
+}
+
+}  // namespace
+
 TransformListener::TransformListener(tf2::BufferCore & buffer, bool spin_thread)
-: buffer_(buffer)
+: buffers_{&buffer}
 {
   // create a unique name for the node
   std::stringstream sstream;
@@ -60,6 +96,121 @@ TransformListener::TransformListener(tf2::BufferCore & buffer, bool spin_thread)
 
 TransformListener::~TransformListener()
 {
+  // Stop the listener threads before the members their callbacks use go away
+  callback_group_threads_.clear();
+  dedicated_listener_thread_.reset();
+  if (user_executor_) {
+    user_executor_->remove_callback_group(callback_group_);
+    if (static_callback_group_ != callback_group_) {
+      user_executor_->remove_callback_group(static_callback_group_);
+    }
+  }
+  applier_thread_.reset();
+}
+
+void TransformListener::addBuffer(tf2::BufferCore & buffer)
+{
+  std::lock_guard<std::mutex> lock(buffers_mutex_);
+  if (std::find(buffers_.begin(), buffers_.end(), &buffer) != buffers_.end()) {
+    return;
+  }
+  if (dedicated_listener_thread_ || callback_group_) {
+    buffer.setUsingDedicatedThread(true);
+  }
+  buffers_.push_back(&buffer);
+  if (static_cache_) {
+    static_cache_->apply(buffer);
+  }
+}
+
+void TransformListener::removeBuffer(tf2::BufferCore & buffer)
+{
+  std::lock_guard<std::mutex> lock(buffers_mutex_);
+  buffers_.erase(std::remove(buffers_.begin(), buffers_.end(), &buffer), buffers_.end());
+}
+
+void TransformListener::setStaticTransformCache(std::shared_ptr<StaticTransformCache> cache)
+{
+  std::lock_guard<std::mutex> lock(buffers_mutex_);
+  static_cache_ = std::move(cache);
+  if (static_cache_) {
+    for (tf2::BufferCore * buffer : buffers_) {
+      static_cache_->apply(*buffer);
+    }
+  }
+}
+
+void TransformListener::setIngestPolicy(const TransformListenerIngestPolicy & policy)
+{
+  std::lock_guard<std::mutex> lock(ingest_mutex_);
+  default_ingest_policy_ = policy;
+  ingest_filtering_ = true;
+}
+
+void TransformListener::setIngestPolicy(
+  const std::string & child_frame_id, const TransformListenerIngestPolicy & policy)
+{
+  std::lock_guard<std::mutex> lock(ingest_mutex_);
+  ingest_policies_[child_frame_id] = policy;
+  ingest_filtering_ = true;
+}
+
+std::unordered_map<std::string, TransformListenerIngestStats>
+TransformListener::getIngestStats() const
+{
+  std::lock_guard<std::mutex> lock(ingest_mutex_);
+  std::unordered_map<std::string, TransformListenerIngestStats> stats;
+  for (const auto & state : ingest_states_) {
+    stats.emplace(state.first, state.second.stats);
+  }
+  return stats;
+}
+
+void TransformListener::filterTransforms(const tf2_msgs::msg::TFMessage & msg)
+{
+  ingest_transforms_.clear();
+  ++ingest_message_;
+
+  // Coalesce the samples of each child frame in this message down to the newest one
+  std::vector<IngestState *> states;
+  states.reserve(msg.transforms.size());
+  for (size_t i = 0; i < msg.transforms.size(); ++i) {
+    IngestState & state = ingest_states_[msg.transforms[i].child_frame_id];
+    ++state.stats.received;
+    if (state.message != ingest_message_ ||
+      fromMsg(msg.transforms[i].header.stamp) >=
+      fromMsg(msg.transforms[state.newest].header.stamp))
+    {
+      state.message = ingest_message_;
+      state.newest = i;
+    }
+    states.push_back(&state);
+  }
+
+  for (size_t i = 0; i < msg.transforms.size(); ++i) {
+    const geometry_msgs::msg::TransformStamped & transform = msg.transforms[i];
+    IngestState & state = *states[i];
+    if (state.newest != i) {
+      ++state.stats.dropped;
+      continue;
+    }
+
+    auto policy_it = ingest_policies_.find(transform.child_frame_id);
+    const TransformListenerIngestPolicy & policy =
+      policy_it == ingest_policies_.end() ? default_ingest_policy_ : policy_it->second;
+    tf2::TimePoint stamp = fromMsg(transform.header.stamp);
+    if (state.passed > 0 && stamp - state.last_inserted < policy.min_period) {
+      ++state.stats.dropped;
+      continue;
+    }
+    uint32_t index = state.passed++;
+    if (policy.keep_every > 1 && index % policy.keep_every != 0) {
+      ++state.stats.dropped;
+      continue;
+    }
+    state.last_inserted = stamp;
+    ingest_transforms_.push_back(transform);
+  }
 }
 
 void TransformListener::initThread(
@@ -86,30 +237,219 @@ void TransformListener::initThread(
       // TODO(tfoote) reenable callback queue processing
       // tf_message_callback_queue_.callAvailable(ros::WallDuration(0.01));
     });
-  // Tell the buffer we have a dedicated thread to enable timeouts
-  buffer_.setUsingDedicatedThread(true);
+  // Tell the buffers we have a dedicated thread to enable timeouts
+  std::lock_guard<std::mutex> lock(buffers_mutex_);
+  for (tf2::BufferCore * buffer : buffers_) {
+    buffer->setUsingDedicatedThread(true);
+  }
 }
 
-void TransformListener::subscription_callback(
-  const tf2_msgs::msg::TFMessage::SharedPtr msg,
-  bool is_static)
+void TransformListener::initThreads(
+  rclcpp::node_interfaces::NodeBaseInterface::SharedPtr node_base_interface,
+  const TransformListenerThreadOptions & thread_options)
+{
+  if (thread_options.ingest_queue_size > 0) {
+    ingest_queue_.reset(
+      new SPSCQueue<tf2_msgs::msg::TFMessage::ConstSharedPtr>(thread_options.ingest_queue_size));
+    static_ingest_queue_.reset(
+      new SPSCQueue<tf2_msgs::msg::TFMessage::ConstSharedPtr>(thread_options.ingest_queue_size));
+    auto logger = node_logging_interface_->get_logger();
+    applier_thread_ = thread_ptr(
+      new std::thread(
+        [this, thread_options, logger]() {
+          if (!configureCurrentThread(thread_options)) {
+            RCLCPP_WARN(
+              logger, "Could not set the affinity or priority of the transform applier thread");
+          }
+          runApplier();
+        }),
+      [this](std::thread * t) {
+        {
+          std::lock_guard<std::mutex> lock(applier_mutex_);
+          applier_done_ = true;
+        }
+        applier_cv_.notify_one();
+        t->join();
+        delete t;
+      });
+  }
+
+  std::vector<rclcpp::CallbackGroup::SharedPtr> groups{callback_group_};
+  if (static_callback_group_ != callback_group_) {
+    groups.push_back(static_callback_group_);
+  }
+
+  if (thread_options.executor) {
+    user_executor_ = thread_options.executor;
+    for (const auto & group : groups) {
+      user_executor_->add_callback_group(group, node_base_interface);
+    }
+  } else {
+    auto logger = node_logging_interface_->get_logger();
+    for (const auto & group : groups) {
+      auto executor = std::make_shared<rclcpp::executors::SingleThreadedExecutor>();
+      executor->add_callback_group(group, node_base_interface);
+      auto run_func = [executor, thread_options, logger]() {
+          if (!configureCurrentThread(thread_options)) {
+            RCLCPP_WARN(
+              logger, "Could not set the affinity or priority of the transform listener thread");
+          }
+          executor->spin();
+        };
+      callback_group_threads_.emplace_back(
+        new std::thread(run_func),
+        [executor](std::thread * t) {
+          executor->cancel();
+          t->join();
+          delete t;
+        });
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(buffers_mutex_);
+  for (tf2::BufferCore * buffer : buffers_) {
+    buffer->setUsingDedicatedThread(true);
+  }
+}
+
+void TransformListener::insertTransforms(
+  const std::vector<geometry_msgs::msg::TransformStamped> & transforms, bool is_static)
 {
-  const tf2_msgs::msg::TFMessage & msg_in = *msg;
   // TODO(tfoote) find a way to get the authority
   std::string authority = "Authority undetectable";
-  for (size_t i = 0u; i < msg_in.transforms.size(); i++) {
-    try {
-      buffer_.setTransform(msg_in.transforms[i], authority, is_static);
-    } catch (const tf2::TransformException & ex) {
-      // /\todo Use error reporting
-      std::string temp = ex.what();
-      RCLCPP_ERROR(
-        node_logging_interface_->get_logger(),
-        "Failure to set received transform from %s to %s with error: %s\n",
-        msg_in.transforms[i].child_frame_id.c_str(),
-        msg_in.transforms[i].header.frame_id.c_str(), temp.c_str());
+  std::shared_ptr<StaticTransformCache> static_cache;
+  try {
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    for (tf2::BufferCore * buffer : buffers_) {
+      buffer->setTransforms(transforms, authority, is_static);
+    }
+    if (is_static) {
+      static_cache = static_cache_;
+    }
+  } catch (const tf2::TransformException & ex) {
+    // /\todo Use error reporting
+    std::string temp = ex.what();
+    RCLCPP_ERROR(
+      node_logging_interface_->get_logger(),
+      "Failure to set %zu received transforms with error: %s\n",
+      transforms.size(), temp.c_str());
+  }
+
+  // Static transforms arrive rarely, so the file is written from here rather than a thread
+  if (static_cache && !static_cache->update(transforms)) {
+    RCLCPP_WARN(
+      node_logging_interface_->get_logger(), "Could not write the static transform cache %s",
+      static_cache->getPath().c_str());
+  }
+}
+
+void TransformListener::queueMessage(
+  tf2_msgs::msg::TFMessage::ConstSharedPtr msg, bool is_static)
+{
+  auto & queue = is_static ? *static_ingest_queue_ : *ingest_queue_;
+  while (!queue.push(std::move(msg))) {
+    if (!is_static) {
+      ++ingest_queue_overflows_;
+      return;
+    }
+    // Static transforms are only sent once, wait for room rather than lose them
+    std::this_thread::yield();
+  }
+
+  size_t depth = ingest_queue_->size() + static_ingest_queue_->size();
+  size_t max_depth = ingest_queue_max_depth_.load(std::memory_order_relaxed);
+  while (depth > max_depth &&
+    !ingest_queue_max_depth_.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed))
+  {
+  }
+
+  // Pairs with the fence in runApplier(), either the applier sees the message or we see it sleep
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (applier_sleeping_.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(applier_mutex_);
+    applier_cv_.notify_one();
+  }
+}
+
+void TransformListener::runApplier()
+{
+  static constexpr size_t max_batch = 64;
+  std::vector<geometry_msgs::msg::TransformStamped> batch;
+  std::vector<geometry_msgs::msg::TransformStamped> static_batch;
+  tf2_msgs::msg::TFMessage::ConstSharedPtr msg;
+
+  while (!applier_done_) {
+    batch.clear();
+    static_batch.clear();
+    size_t count = 0;
+    for (; count < max_batch && static_ingest_queue_->pop(msg); ++count) {
+      static_batch.insert(static_batch.end(), msg->transforms.begin(), msg->transforms.end());
+    }
+    {
+      std::lock_guard<std::mutex> ingest_lock(ingest_mutex_);
+      for (; count < max_batch && ingest_queue_->pop(msg); ++count) {
+        const std::vector<geometry_msgs::msg::TransformStamped> * transforms = &msg->transforms;
+        if (ingest_filtering_) {
+          filterTransforms(*msg);
+          transforms = &ingest_transforms_;
+        }
+        batch.insert(batch.end(), transforms->begin(), transforms->end());
+      }
+    }
+    msg.reset();
+
+    if (count == 0) {
+      std::unique_lock<std::mutex> lock(applier_mutex_);
+      applier_sleeping_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (ingest_queue_->size() == 0 && static_ingest_queue_->size() == 0 && !applier_done_) {
+        applier_cv_.wait_for(lock, std::chrono::milliseconds(100));
+      }
+      applier_sleeping_.store(false, std::memory_order_relaxed);
+      continue;
+    }
+
+    if (!static_batch.empty()) {
+      insertTransforms(static_batch, true);
+    }
+    if (!batch.empty()) {
+      insertTransforms(batch, false);
+    }
+    ++ingest_queue_batches_;
+  }
+}
+
+TransformListenerQueueStats TransformListener::getIngestQueueStats() const
+{
+  TransformListenerQueueStats stats;
+  if (ingest_queue_) {
+    stats.depth = ingest_queue_->size() + static_ingest_queue_->size();
+  }
+  stats.max_depth = ingest_queue_max_depth_;
+  stats.overflows = ingest_queue_overflows_;
+  stats.batches = ingest_queue_batches_;
+  return stats;
+}
+
+void TransformListener::subscription_callback(
+  const tf2_msgs::msg::TFMessage::ConstSharedPtr msg,
+  bool is_static)
+{
+  TF2_TRACEPOINT(listener_callback, this, msg->transforms.size(), is_static);
+  if (ingest_queue_) {
+    queueMessage(msg, is_static);
+    return;
+  }
+
+  if (!is_static) {
+    std::lock_guard<std::mutex> ingest_lock(ingest_mutex_);
+    if (ingest_filtering_) {
+      filterTransforms(*msg);
+      insertTransforms(ingest_transforms_, false);
+      return;
     }
   }
+  insertTransforms(msg->transforms, is_static);
 }
 
 }  // namespace tf2_ros
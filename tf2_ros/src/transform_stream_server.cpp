@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <tf2_ros/transform_stream_server.h>
+
+#include <tf2/exceptions.h>
+#include <tf2/LinearMath/Quaternion.h>
+#include <tf2/LinearMath/Vector3.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tf2_ros
+{
+namespace
+{
+bool movedBeyond(
+  const geometry_msgs::msg::TransformStamped & last,
+  const geometry_msgs::msg::TransformStamped & current,
+  double translation_threshold, double rotation_threshold)
+{
+  const auto & a = last.transform;
+  const auto & b = current.transform;
+  tf2::Vector3 translation(
+    b.translation.x - a.translation.x, b.translation.y - a.translation.y,
+    b.translation.z - a.translation.z);
+  if (translation.length() > translation_threshold) {
+    return true;
+  }
+  tf2::Quaternion qa(a.rotation.x, a.rotation.y, a.rotation.z, a.rotation.w);
+  tf2::Quaternion qb(b.rotation.x, b.rotation.y, b.rotation.z, b.rotation.w);
+  return qa.angleShortestPath(qb) > rotation_threshold;
+}
+}  // namespace
+
+size_t TransformStreamServer::getNumStreams()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return streams_.size();
+}
+
+void TransformStreamServer::streamCB(
+  const std::shared_ptr<StreamTransforms::Request> request,
+  std::shared_ptr<StreamTransforms::Response> response)
+{
+  if (request->target_frames.size() != request->source_frames.size()) {
+    response->error_string = "target_frames and source_frames must have the same size";
+    return;
+  }
+  if (request->target_frames.empty()) {
+    response->error_string = "No frame pairs to stream";
+    return;
+  }
+  if (!(request->rate > 0.0)) {
+    response->error_string = "The rate must be positive";
+    return;
+  }
+
+  auto stream = std::make_shared<Stream>();
+  for (size_t i = 0; i < request->target_frames.size(); ++i) {
+    stream->pairs.emplace_back(request->target_frames[i], request->source_frames[i]);
+  }
+  stream->translation_threshold = request->translation_threshold;
+  stream->rotation_threshold = request->rotation_threshold;
+  stream->sent.resize(stream->pairs.size());
+  stream->last_subscribed = clock_->now();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  stream->id = next_id_++;
+  response->topic = ns_ + "/stream_" + std::to_string(stream->id);
+  stream->publisher = rclcpp::create_publisher<tf2_msgs::msg::TFMessage>(
+    node_topics_, response->topic, rclcpp::QoS(100));
+  uint64_t id = stream->id;
+  stream->timer = rclcpp::create_timer(
+    node_base_, node_timers_, clock_,
+    rclcpp::Duration::from_nanoseconds(static_cast<int64_t>(1e9 / request->rate)),
+    [this, id]() {publishChanges(id);});
+  streams_[id] = stream;
+
+  RCLCPP_DEBUG(
+    logger_, "Streaming %zu frame pairs on %s", stream->pairs.size(), response->topic.c_str());
+}
+
+void TransformStreamServer::publishChanges(uint64_t id)
+{
+  std::shared_ptr<Stream> stream;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = streams_.find(id);
+    if (it == streams_.end()) {
+      return;
+    }
+    stream = it->second;
+
+    size_t subscribers = stream->publisher->get_subscription_count();
+    rclcpp::Time now = clock_->now();
+    if (subscribers == 0) {
+      if (now - stream->last_subscribed > rclcpp::Duration(idle_timeout_)) {
+        RCLCPP_DEBUG(
+          logger_, "Closing stream %s without subscribers", stream->publisher->get_topic_name());
+        // The executor keeps the timer alive until this callback returns
+        streams_.erase(it);
+      }
+      stream->subscribers = 0;
+      return;
+    }
+    stream->last_subscribed = now;
+    if (subscribers > stream->subscribers) {
+      // Bring the new subscribers up to date with everything
+      for (auto & sent : stream->sent) {
+        sent.header.frame_id.clear();
+      }
+    }
+    stream->subscribers = subscribers;
+  }
+
+  auto message = std::make_unique<tf2_msgs::msg::TFMessage>();
+  for (size_t i = 0; i < stream->pairs.size(); ++i) {
+    geometry_msgs::msg::TransformStamped transform;
+    try {
+      transform = buffer_.lookupTransform(
+        stream->pairs[i].first, stream->pairs[i].second, tf2::TimePointZero);
+    } catch (const tf2::TransformException &) {
+      // Not available yet, it is sent once it is
+      continue;
+    }
+    geometry_msgs::msg::TransformStamped & sent = stream->sent[i];
+    if (sent.header.frame_id.empty() ||
+      movedBeyond(sent, transform, stream->translation_threshold, stream->rotation_threshold))
+    {
+      sent = transform;
+      message->transforms.push_back(std::move(transform));
+    }
+  }
+  if (!message->transforms.empty()) {
+    stream->publisher->publish(std::move(message));
+  }
+}
+
+}  // namespace tf2_ros
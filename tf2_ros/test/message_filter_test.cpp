@@ -41,8 +41,11 @@
 #include <geometry_msgs/msg/point_stamped.hpp>
 #include <geometry_msgs/msg/transform_stamped.hpp>
 
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 uint8_t filter_callback_fired = 0;
@@ -117,6 +120,322 @@ TEST(tf2_ros_message_filter, construction_and_destruction)
   }
 }
 
+uint8_t shared_wait_callback_fired = 0;
+void shared_wait_callback(const geometry_msgs::msg::PointStamped & msg)
+{
+  (void)msg;
+  shared_wait_callback_fired++;
+}
+
+TEST(tf2_ros_message_filter, messages_share_waits)
+{
+  auto node = rclcpp::Node::make_shared("tf2_ros_message_filter_shared_waits");
+
+  auto create_timer_interface = std::make_shared<tf2_ros::CreateTimerROS>(
+    node->get_node_base_interface(),
+    node->get_node_timers_interface());
+
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  buffer.setCreateTimerInterface(create_timer_interface);
+  tf2_ros::MessageFilter<geometry_msgs::msg::PointStamped> filter(buffer, "map", 10, node);
+  filter.registerCallback(&shared_wait_callback);
+
+  // Several messages at the same stamp wait for the same transform
+  rclcpp::Time stamp(10, 0);
+  for (int i = 0; i < 3; ++i) {
+    auto point = std::make_shared<geometry_msgs::msg::PointStamped>();
+    point->header.stamp = stamp;
+    point->header.frame_id = "base";
+    filter.add(point);
+  }
+  auto other = std::make_shared<geometry_msgs::msg::PointStamped>();
+  other->header.stamp = rclcpp::Time(20, 0);
+  other->header.frame_id = "base";
+  filter.add(other);
+  EXPECT_EQ(0, shared_wait_callback_fired);
+
+  geometry_msgs::msg::TransformStamped map_to_base;
+  map_to_base.header.stamp = stamp;
+  map_to_base.header.frame_id = "map";
+  map_to_base.child_frame_id = "base";
+  map_to_base.transform.rotation.w = 1.0;
+  buffer.setTransform(map_to_base, "test");
+
+  // All the messages at the stamp are out, the later one still waits
+  EXPECT_EQ(3, shared_wait_callback_fired);
+  map_to_base.header.stamp = rclcpp::Time(20, 0);
+  buffer.setTransform(map_to_base, "test");
+  EXPECT_EQ(4, shared_wait_callback_fired);
+}
+
+uint8_t late_joiner_callback_fired = 0;
+void late_joiner_callback(const geometry_msgs::msg::PointStamped & msg)
+{
+  (void)msg;
+  late_joiner_callback_fired++;
+}
+
+TEST(tf2_ros_message_filter, later_messages_get_the_whole_timeout)
+{
+  auto node = rclcpp::Node::make_shared("tf2_ros_message_filter_late_joiner");
+
+  auto create_timer_interface = std::make_shared<tf2_ros::CreateTimerROS>(
+    node->get_node_base_interface(),
+    node->get_node_timers_interface());
+
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  buffer.setCreateTimerInterface(create_timer_interface);
+  const auto timeout = std::chrono::milliseconds(400);
+  tf2_ros::MessageFilter<geometry_msgs::msg::PointStamped> filter(
+    buffer, "map", 10, node, timeout);
+  filter.registerCallback(&late_joiner_callback);
+
+  auto spin_until = [&node](std::chrono::steady_clock::time_point end) {
+      while (std::chrono::steady_clock::now() < end) {
+        rclcpp::spin_some(node);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      }
+    };
+
+  // Two messages at the same stamp, half the timeout apart
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 2; ++i) {
+    auto point = std::make_shared<geometry_msgs::msg::PointStamped>();
+    point->header.stamp = rclcpp::Time(10, 0);
+    point->header.frame_id = "base";
+    filter.add(point);
+    spin_until(start + timeout / 2);
+  }
+
+  // The transform arrives after the first message timed out, but before the second does
+  spin_until(start + timeout * 5 / 4);
+  EXPECT_EQ(0, late_joiner_callback_fired);
+  geometry_msgs::msg::TransformStamped map_to_base;
+  map_to_base.header.stamp = rclcpp::Time(10, 0);
+  map_to_base.header.frame_id = "map";
+  map_to_base.child_frame_id = "base";
+  map_to_base.transform.rotation.w = 1.0;
+  buffer.setTransform(map_to_base, "test");
+  EXPECT_EQ(1, late_joiner_callback_fired);
+}
+
+TEST(tf2_ros_message_filter, transforms_callback)
+{
+  auto node = rclcpp::Node::make_shared("tf2_ros_message_filter_transforms");
+
+  auto create_timer_interface = std::make_shared<tf2_ros::CreateTimerROS>(
+    node->get_node_base_interface(),
+    node->get_node_timers_interface());
+
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  buffer.setCreateTimerInterface(create_timer_interface);
+  tf2_ros::MessageFilter<geometry_msgs::msg::PointStamped> filter(buffer, "", 10, node);
+  filter.setTargetFrames({"map", "base"});
+
+  std::vector<geometry_msgs::msg::TransformStamped> received;
+  filter.registerTransformsCallback(
+    [&received](
+      const std::shared_ptr<const geometry_msgs::msg::PointStamped> & msg,
+      const std::vector<geometry_msgs::msg::TransformStamped> & transforms)
+    {
+      EXPECT_EQ("base", msg->header.frame_id);
+      received = transforms;
+    });
+
+  geometry_msgs::msg::TransformStamped map_to_base;
+  map_to_base.header.stamp = rclcpp::Time(10, 0);
+  map_to_base.header.frame_id = "map";
+  map_to_base.child_frame_id = "base";
+  map_to_base.transform.translation.x = 2.0;
+  map_to_base.transform.rotation.w = 1.0;
+  buffer.setTransform(map_to_base, "test");
+
+  auto point = std::make_shared<geometry_msgs::msg::PointStamped>();
+  point->header.stamp = rclcpp::Time(10, 0);
+  point->header.frame_id = "base";
+  filter.add(point);
+
+  ASSERT_EQ(2u, received.size());
+  EXPECT_EQ("map", received[0].header.frame_id);
+  EXPECT_EQ("base", received[0].child_frame_id);
+  EXPECT_DOUBLE_EQ(2.0, received[0].transform.translation.x);
+  EXPECT_EQ("base", received[1].header.frame_id);
+  EXPECT_DOUBLE_EQ(1.0, received[1].transform.rotation.w);
+}
+
+/// Answers from a tf2_ros::Buffer without being a tf2::BufferCore, so the filter has to look
+/// the transforms up by frame name
+class ForwardingBuffer : public tf2::BufferCoreInterface, public tf2_ros::AsyncBufferInterface
+{
+public:
+  explicit ForwardingBuffer(tf2_ros::Buffer & buffer)
+  : buffer_(buffer) {}
+
+  void clear() override
+  {
+    buffer_.clear();
+  }
+
+  geometry_msgs::msg::TransformStamped lookupTransform(
+    const std::string & target_frame, const std::string & source_frame,
+    const tf2::TimePoint & time) const override
+  {
+    ++lookups;
+    return buffer_.lookupTransform(target_frame, source_frame, time);
+  }
+
+  geometry_msgs::msg::TransformStamped lookupTransform(
+    const std::string & target_frame, const tf2::TimePoint & target_time,
+    const std::string & source_frame, const tf2::TimePoint & source_time,
+    const std::string & fixed_frame) const override
+  {
+    ++lookups;
+    return buffer_.lookupTransform(
+      target_frame, target_time, source_frame, source_time, fixed_frame);
+  }
+
+  bool canTransform(
+    const std::string & target_frame, const std::string & source_frame,
+    const tf2::TimePoint & time, std::string * error_msg) const override
+  {
+    ++lookups;
+    return buffer_.canTransform(target_frame, source_frame, time, error_msg);
+  }
+
+  bool canTransform(
+    const std::string & target_frame, const tf2::TimePoint & target_time,
+    const std::string & source_frame, const tf2::TimePoint & source_time,
+    const std::string & fixed_frame, std::string * error_msg) const override
+  {
+    ++lookups;
+    return buffer_.canTransform(
+      target_frame, target_time, source_frame, source_time, fixed_frame, error_msg);
+  }
+
+  std::vector<std::string> getAllFrameNames() const override
+  {
+    return buffer_.getAllFrameNames();
+  }
+
+  tf2_ros::TransformStampedFuture waitForTransform(
+    const std::string & target_frame, const std::string & source_frame,
+    const tf2::TimePoint & time, const tf2::Duration & timeout,
+    tf2_ros::TransformReadyCallback callback) override
+  {
+    return buffer_.waitForTransform(target_frame, source_frame, time, timeout, callback);
+  }
+
+  mutable int lookups = 0;
+
+private:
+  tf2_ros::Buffer & buffer_;
+};
+
+TEST(tf2_ros_message_filter, buffer_that_is_not_a_buffer_core)
+{
+  auto node = rclcpp::Node::make_shared("tf2_ros_message_filter_forwarding_buffer");
+
+  auto create_timer_interface = std::make_shared<tf2_ros::CreateTimerROS>(
+    node->get_node_base_interface(),
+    node->get_node_timers_interface());
+
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  buffer.setCreateTimerInterface(create_timer_interface);
+  ForwardingBuffer forwarding(buffer);
+  tf2_ros::MessageFilter<geometry_msgs::msg::PointStamped, ForwardingBuffer> filter(
+    forwarding, "", 10, node);
+  filter.setTargetFrames({"map", "odom"});
+
+  std::vector<geometry_msgs::msg::TransformStamped> received;
+  filter.registerTransformsCallback(
+    [&received](
+      const std::shared_ptr<const geometry_msgs::msg::PointStamped> &,
+      const std::vector<geometry_msgs::msg::TransformStamped> & transforms)
+    {
+      received = transforms;
+    });
+
+  auto point = std::make_shared<geometry_msgs::msg::PointStamped>();
+  point->header.stamp = rclcpp::Time(10, 0);
+  point->header.frame_id = "base";
+  filter.add(point);
+
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.stamp = rclcpp::Time(10, 0);
+  transform.transform.rotation.w = 1.0;
+  transform.header.frame_id = "map";
+  transform.child_frame_id = "odom";
+  transform.transform.translation.x = 1.0;
+  buffer.setTransform(transform, "test");
+  EXPECT_TRUE(received.empty());
+  transform.header.frame_id = "odom";
+  transform.child_frame_id = "base";
+  transform.transform.translation.x = 2.0;
+  buffer.setTransform(transform, "test");
+
+  // Whichever target became transformable last is handed over, the other one is looked up by
+  // name through the forwarding buffer
+  ASSERT_EQ(2u, received.size());
+  EXPECT_EQ("map", received[0].header.frame_id);
+  EXPECT_DOUBLE_EQ(3.0, received[0].transform.translation.x);
+  EXPECT_EQ("odom", received[1].header.frame_id);
+  EXPECT_DOUBLE_EQ(2.0, received[1].transform.translation.x);
+  EXPECT_EQ(1, forwarding.lookups);
+}
+
+uint8_t dispatched_callback_fired = 0;
+void dispatched_callback(const geometry_msgs::msg::PointStamped & msg)
+{
+  (void)msg;
+  dispatched_callback_fired++;
+}
+
+TEST(tf2_ros_message_filter, dispatcher_and_queue_size)
+{
+  auto node = rclcpp::Node::make_shared("tf2_ros_message_filter_dispatcher");
+
+  auto create_timer_interface = std::make_shared<tf2_ros::CreateTimerROS>(
+    node->get_node_base_interface(),
+    node->get_node_timers_interface());
+
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  buffer.setCreateTimerInterface(create_timer_interface);
+  tf2_ros::MessageFilter<geometry_msgs::msg::PointStamped> filter(buffer, "map", 2, node);
+  filter.registerCallback(&dispatched_callback);
+  std::vector<std::function<void()>> tasks;
+  filter.setDispatcher([&tasks](std::function<void()> task) {tasks.push_back(std::move(task));});
+
+  // Only the newest two messages stay queued
+  for (int sec = 1; sec <= 40; ++sec) {
+    auto point = std::make_shared<geometry_msgs::msg::PointStamped>();
+    point->header.stamp = rclcpp::Time(sec, 0);
+    point->header.frame_id = "base";
+    filter.add(point);
+  }
+
+  geometry_msgs::msg::TransformStamped map_to_base;
+  map_to_base.header.frame_id = "map";
+  map_to_base.child_frame_id = "base";
+  map_to_base.transform.rotation.w = 1.0;
+  for (int sec : {1, 40}) {
+    map_to_base.header.stamp = rclcpp::Time(sec, 0);
+    buffer.setTransform(map_to_base, "test");
+  }
+
+  // The callbacks only run once the dispatched tasks are
+  EXPECT_EQ(0, dispatched_callback_fired);
+  ASSERT_FALSE(tasks.empty());
+  for (const auto & task : tasks) {
+    task();
+  }
+  EXPECT_EQ(2, dispatched_callback_fired);
+}
+
 TEST(tf2_ros_message_filter, multiple_frames_and_time_tolerance)
 {
   auto node = rclcpp::Node::make_shared("tf2_ros_message_filter");
@@ -29,6 +29,7 @@
 
 
 #include <gtest/gtest.h>
+#include <tf2/LinearMath/Transform.h>
 #include <tf2_ros/buffer.h>
 #include <tf2_ros/create_timer_interface.h>
 #include <tf2_ros/transform_listener.h>
@@ -37,8 +38,27 @@
 #include <chrono>
 #include <exception>
 #include <future>
+#include <functional>
 #include <memory>
+#include <thread>
 #include <unordered_map>
+#include <vector>
+
+namespace tf2
+{
+template<>
+void doTransform(
+  const tf2::Stamped<tf2::Vector3> & in, tf2::Stamped<tf2::Vector3> & out,
+  const geometry_msgs::msg::TransformStamped & transform)
+{
+  const auto & t = transform.transform;
+  tf2::Transform tf(
+    tf2::Quaternion(t.rotation.x, t.rotation.y, t.rotation.z, t.rotation.w),
+    tf2::Vector3(t.translation.x, t.translation.y, t.translation.z));
+  out = tf2::Stamped<tf2::Vector3>(
+    tf * in, tf2_ros::fromMsg(transform.header.stamp), transform.header.frame_id);
+}
+}  // namespace tf2
 
 class MockCreateTimer final : public tf2_ros::CreateTimerInterface
 {
@@ -137,6 +157,92 @@ TEST(test_buffer, can_transform_valid_transform)
   EXPECT_DOUBLE_EQ(transform.transform.translation.z, output_rclcpp.transform.translation.z);
 }
 
+TEST(test_buffer, can_transform_wakes_on_insert)
+{
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  buffer.setUsingDedicatedThread(true);
+
+  rclcpp::Time rclcpp_time = clock->now();
+  tf2::TimePoint tf2_time(std::chrono::nanoseconds(rclcpp_time.nanoseconds()));
+
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = "foo";
+  transform.header.stamp = builtin_interfaces::msg::Time(rclcpp_time);
+  transform.child_frame_id = "bar";
+  transform.transform.rotation.w = 1.0;
+
+  std::thread inserter([&]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      buffer.setTransform(transform, "unittest");
+    });
+
+  // The wait ends as soon as the transform is inserted, well before the timeout
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(buffer.canTransform("bar", "foo", tf2_time, tf2::durationFromSec(10.0)));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  inserter.join();
+
+  // Waiting for a transform that never arrives still times out
+  start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(buffer.canTransform("bar", "baz", tf2_time, tf2::durationFromSec(0.2)));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(200));
+}
+
+TEST(test_buffer, transform_into_multiple_frames)
+{
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  buffer.setUsingDedicatedThread(true);
+
+  rclcpp::Time rclcpp_time = clock->now();
+  tf2::TimePoint tf2_time(std::chrono::nanoseconds(rclcpp_time.nanoseconds()));
+
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.stamp = builtin_interfaces::msg::Time(rclcpp_time);
+  transform.transform.rotation.w = 1.0;
+  transform.header.frame_id = "map";
+  transform.child_frame_id = "odom";
+  transform.transform.translation.x = 1.0;
+  EXPECT_TRUE(buffer.setTransform(transform, "unittest"));
+  transform.header.frame_id = "odom";
+  transform.child_frame_id = "base_link";
+  transform.transform.translation.x = 2.0;
+  EXPECT_TRUE(buffer.setTransform(transform, "unittest"));
+  transform.header.frame_id = "base_link";
+  transform.child_frame_id = "lidar";
+  transform.transform.translation.x = 4.0;
+  EXPECT_TRUE(buffer.setTransform(transform, "unittest"));
+
+  const std::vector<std::string> targets = {"map", "odom", "base_link"};
+  std::vector<geometry_msgs::msg::TransformStamped> transforms =
+    buffer.lookupTransforms(targets, "lidar", tf2_time, tf2::durationFromSec(0.0));
+  ASSERT_EQ(3u, transforms.size());
+  EXPECT_DOUBLE_EQ(7.0, transforms[0].transform.translation.x);
+  EXPECT_DOUBLE_EQ(6.0, transforms[1].transform.translation.x);
+  EXPECT_DOUBLE_EQ(4.0, transforms[2].transform.translation.x);
+
+  tf2::Stamped<tf2::Vector3> point(tf2::Vector3(0.5, 0.0, 0.0), tf2_time, "lidar");
+  for (bool parallel : {false, true}) {
+    std::vector<tf2::Stamped<tf2::Vector3>> out =
+      buffer.transform(point, targets, tf2::durationFromSec(0.0), parallel);
+    ASSERT_EQ(3u, out.size());
+    EXPECT_EQ("map", out[0].frame_id_);
+    EXPECT_DOUBLE_EQ(7.5, out[0].x());
+    EXPECT_EQ("odom", out[1].frame_id_);
+    EXPECT_DOUBLE_EQ(6.5, out[1].x());
+    EXPECT_EQ("base_link", out[2].frame_id_);
+    EXPECT_DOUBLE_EQ(4.5, out[2].x());
+  }
+
+  // The timeout is shared by the targets and the lookup reports why a target failed
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_THROW(
+    buffer.lookupTransforms({"map", "missing"}, "lidar", tf2_time, tf2::durationFromSec(0.2)),
+    tf2::LookupException);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
 TEST(test_buffer, wait_for_transform_valid)
 {
   rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
@@ -295,6 +401,112 @@ TEST(test_buffer, wait_for_transform_race)
   EXPECT_FALSE(callback_timeout);
 }
 
+TEST(test_buffer, wait_for_transform_single_timer)
+{
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  // Silence error about dedicated thread's being necessary
+  buffer.setUsingDedicatedThread(true);
+  auto mock_create_timer = std::make_shared<MockCreateTimer>();
+  buffer.setCreateTimerInterface(mock_create_timer);
+
+  rclcpp::Time rclcpp_time = clock->now();
+  tf2::TimePoint tf2_time(std::chrono::nanoseconds(rclcpp_time.nanoseconds()));
+
+  int timeouts = 0;
+  auto on_ready = [&timeouts](const tf2_ros::TransformStampedFuture & future)
+    {
+      try {
+        future.get();
+      } catch (const tf2::TimeoutException &) {
+        ++timeouts;
+      }
+    };
+  auto future_3s = buffer.waitForTransform(
+    "foo", "bar", tf2_time, tf2::durationFromSec(3.0), on_ready);
+  auto future_5s = buffer.waitForTransform(
+    "foo", "baz", tf2_time, tf2::durationFromSec(5.0), on_ready);
+  // Only a wait due earlier than the armed timer replaces it
+  EXPECT_EQ(mock_create_timer->timer_to_callback_map_.size(), 1u);
+  auto future_1s = buffer.waitForTransform(
+    "foo", "qux", tf2_time, tf2::durationFromSec(1.0), on_ready);
+  EXPECT_EQ(mock_create_timer->timer_to_callback_map_.size(), 2u);
+
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = "foo";
+  transform.header.stamp = builtin_interfaces::msg::Time(rclcpp_time);
+  transform.child_frame_id = "baz";
+  transform.transform.rotation.w = 1.0;
+  EXPECT_TRUE(buffer.setTransform(transform, "unittest"));
+  EXPECT_EQ(future_5s.wait_for(std::chrono::milliseconds(1)), std::future_status::ready);
+
+  // Fire every timer created so far, the replaced one is ignored and the current one only
+  // expires the wait it was armed for before arming a new timer for the next deadline
+  auto timers = mock_create_timer->timer_to_callback_map_;
+  for (const auto & timer : timers) {
+    timer.second(timer.first);
+  }
+  EXPECT_EQ(future_1s.wait_for(std::chrono::milliseconds(1)), std::future_status::ready);
+  EXPECT_EQ(future_3s.wait_for(std::chrono::milliseconds(1)), std::future_status::timeout);
+  EXPECT_EQ(timeouts, 1);
+  EXPECT_EQ(mock_create_timer->timer_to_callback_map_.size(), 3u);
+}
+
+TEST(test_buffer, wait_for_transform_result)
+{
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  buffer.setUsingDedicatedThread(true);
+  auto mock_create_timer = std::make_shared<MockCreateTimer>();
+  buffer.setCreateTimerInterface(mock_create_timer);
+
+  rclcpp::Time rclcpp_time = clock->now();
+  tf2::TimePoint tf2_time(std::chrono::nanoseconds(rclcpp_time.nanoseconds()));
+
+  // Each result waits for the next transform from the callback, as an awaiting coroutine would
+  std::vector<double> received;
+  tf2_ros::TransformResultCallback on_result =
+    [&](const geometry_msgs::msg::TransformStamped * transform, std::exception_ptr error) {
+      ASSERT_NE(nullptr, transform);
+      EXPECT_FALSE(error);
+      received.push_back(transform->transform.translation.x);
+      if (received.size() < 3) {
+        buffer.waitForTransformResult(
+          "foo", "bar", tf2_time + std::chrono::seconds(received.size()),
+          tf2::durationFromSec(1.0), on_result);
+      }
+    };
+  buffer.waitForTransformResult("foo", "bar", tf2_time, tf2::durationFromSec(1.0), on_result);
+
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = "foo";
+  transform.child_frame_id = "bar";
+  transform.transform.rotation.w = 1.0;
+  for (int i = 0; i < 3; ++i) {
+    transform.header.stamp = builtin_interfaces::msg::Time(
+      rclcpp_time + rclcpp::Duration(std::chrono::seconds(i)));
+    transform.transform.translation.x = i;
+    EXPECT_TRUE(buffer.setTransform(transform, "unittest"));
+  }
+  EXPECT_EQ(std::vector<double>({0.0, 1.0, 2.0}), received);
+
+  // Timing out passes the error instead
+  std::exception_ptr timeout_error;
+  buffer.waitForTransformResult(
+    "foo", "baz", tf2_time, tf2::durationFromSec(1.0),
+    [&timeout_error](const geometry_msgs::msg::TransformStamped * transform,
+    std::exception_ptr error) {
+      EXPECT_EQ(nullptr, transform);
+      timeout_error = error;
+    });
+  auto timers = mock_create_timer->timer_to_callback_map_;
+  for (const auto & timer : timers) {
+    timer.second(timer.first);
+  }
+  ASSERT_TRUE(timeout_error);
+  EXPECT_THROW(std::rethrow_exception(timeout_error), tf2::TimeoutException);
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -29,18 +29,22 @@
 
 #include <gtest/gtest.h>
 
+#include <geometry_msgs/msg/point_stamped.hpp>
 #include <tf2_msgs/action/lookup_transform.hpp>
 #include <rclcpp/rclcpp.hpp>
 #include <rclcpp_action/rclcpp_action.hpp>
 
 #include <tf2_ros/buffer.h>
 #include <tf2_ros/buffer_client.h>
+#include <tf2_ros/message_filter.h>
 
+#include <atomic>
 #include <chrono>
 #include <future>
 #include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 static const char ACTION_NAME[] = "test_tf2_buffer_action";
 
@@ -78,6 +82,7 @@ public:
     // before the rclcpp_action interface ever has time to do any work.
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
+    ++num_goals_;
     auto result = std::make_shared<LookupTransformAction::Result>();
     if (transform_available_) {
       result->transform.transform = transform_;
@@ -93,9 +98,15 @@ public:
     transform_available_ = true;
   }
 
+  int getNumGoals() const
+  {
+    return num_goals_;
+  }
+
 private:
   geometry_msgs::msg::Transform transform_;
   bool transform_available_;
+  std::atomic<int> num_goals_{0};
 
   rclcpp_action::Server<LookupTransformAction>::SharedPtr action_server_;
 };
@@ -191,6 +202,102 @@ TEST_F(TestBufferClient, can_transform_unavailable)
   EXPECT_FALSE(client_->canTransform("test_target_frame", "test_source_frame", tf2::get_now()));
 }
 
+TEST_F(TestBufferClient, lookup_transform_async)
+{
+  geometry_msgs::msg::Transform transform_in;
+  transform_in.rotation.w = 1.0;
+  transform_in.translation.x = 42.0;
+  mock_server_->setTransform(transform_in);
+
+  // Both goals are in flight at once
+  auto first = client_->lookupTransformAsync(
+    "test_target_frame", "test_source_frame", tf2::get_now());
+  std::promise<void> called;
+  auto second = client_->waitForTransform(
+    "test_target_frame", "test_source_frame", tf2::get_now(), tf2::durationFromSec(0.0),
+    [&called](const tf2_ros::TransformStampedFuture &) {called.set_value();});
+
+  ASSERT_EQ(std::future_status::ready, first.wait_for(std::chrono::seconds(10)));
+  ASSERT_EQ(std::future_status::ready, second.wait_for(std::chrono::seconds(10)));
+  EXPECT_EQ(first.get().transform.translation.x, transform_in.translation.x);
+  EXPECT_EQ(second.get().transform.translation.x, transform_in.translation.x);
+  EXPECT_EQ(
+    std::future_status::ready, called.get_future().wait_for(std::chrono::seconds(10)));
+}
+
+TEST_F(TestBufferClient, lookup_transform_async_unavailable)
+{
+  auto future = client_->lookupTransformAsync(
+    "test_target_frame", "test_source_frame", tf2::get_now());
+  ASSERT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds(10)));
+  EXPECT_THROW(future.get(), tf2_ros::GoalAbortedException);
+}
+
+TEST_F(TestBufferClient, cached_lookup)
+{
+  tf2_ros::BufferClientCacheOptions cache_options;
+  cache_options.capacity = 2;
+  tf2_ros::BufferClient cached_client(
+    node_, ACTION_NAME, 10.0, tf2::durationFromSec(2.0), cache_options);
+  ASSERT_TRUE(cached_client.waitForServer(std::chrono::seconds(10)));
+
+  geometry_msgs::msg::Transform transform_in;
+  transform_in.rotation.w = 1.0;
+  transform_in.translation.x = 42.0;
+  mock_server_->setTransform(transform_in);
+
+  // Only lookups at the same non zero time are answered from the cache
+  tf2::TimePoint time = tf2::get_now();
+  cached_client.lookupTransform("test_target_frame", "test_source_frame", time);
+  auto transform_out = cached_client.lookupTransform(
+    "test_target_frame", "test_source_frame", time);
+  EXPECT_EQ(transform_out.transform.translation.x, transform_in.translation.x);
+  EXPECT_EQ(1, mock_server_->getNumGoals());
+  cached_client.lookupTransform("test_target_frame", "test_source_frame", tf2::TimePointZero);
+  cached_client.lookupTransform("test_target_frame", "test_source_frame", tf2::TimePointZero);
+  EXPECT_EQ(3, mock_server_->getNumGoals());
+
+  tf2_ros::BufferClientCacheStats stats = cached_client.getCacheStats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(3u, stats.misses);
+
+  cached_client.clearCache();
+  cached_client.lookupTransform("test_target_frame", "test_source_frame", time);
+  EXPECT_EQ(4, mock_server_->getNumGoals());
+}
+
+TEST_F(TestBufferClient, message_filter)
+{
+  geometry_msgs::msg::Transform transform_in;
+  transform_in.rotation.w = 1.0;
+  transform_in.translation.x = 42.0;
+  mock_server_->setTransform(transform_in);
+
+  // The client is only waited on, a message is ready with the transforms the waits returned
+  tf2_ros::MessageFilter<geometry_msgs::msg::PointStamped, tf2_ros::BufferClient> filter(
+    *client_, "test_target_frame", 10, node_, std::chrono::seconds(5));
+  std::promise<std::vector<geometry_msgs::msg::TransformStamped>> received;
+  filter.registerTransformsCallback(
+    [&received](
+      const std::shared_ptr<const geometry_msgs::msg::PointStamped> &,
+      const std::vector<geometry_msgs::msg::TransformStamped> & transforms)
+    {
+      received.set_value(transforms);
+    });
+
+  auto point = std::make_shared<geometry_msgs::msg::PointStamped>();
+  point->header.frame_id = "test_source_frame";
+  point->header.stamp = node_->now();
+  filter.add(point);
+
+  auto future = received.get_future();
+  ASSERT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds(10)));
+  std::vector<geometry_msgs::msg::TransformStamped> transforms = future.get();
+  ASSERT_EQ(1u, transforms.size());
+  EXPECT_EQ(transforms[0].transform.translation.x, transform_in.translation.x);
+  EXPECT_EQ(1, mock_server_->getNumGoals());
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2018, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Built as C++20, see CMakeLists.txt, so Buffer::transformAvailable() is available
+
+#include <gtest/gtest.h>
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/create_timer_interface.h>
+#include <rclcpp/rclcpp.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#ifdef TF2_ROS_HAS_COROUTINES
+
+class MockCreateTimer final : public tf2_ros::CreateTimerInterface
+{
+public:
+  tf2_ros::TimerHandle
+  createTimer(
+    rclcpp::Clock::SharedPtr,
+    const tf2::Duration &,
+    tf2_ros::TimerCallbackType callback)
+  {
+    const auto timer_handle = timer_handle_index_++;
+    timer_to_callback_map_[timer_handle] = callback;
+    return timer_handle;
+  }
+
+  void cancel(const tf2_ros::TimerHandle &) {}
+
+  void reset(const tf2_ros::TimerHandle &) {}
+
+  void remove(const tf2_ros::TimerHandle &) {}
+
+  void
+  execute_timers()
+  {
+    auto timers = timer_to_callback_map_;
+    for (const auto & elem : timers) {
+      elem.second(elem.first);
+    }
+  }
+
+  tf2_ros::TimerHandle timer_handle_index_ = 0;
+  std::unordered_map<tf2_ros::TimerHandle, tf2_ros::TimerCallbackType> timer_to_callback_map_;
+};
+
+/// A coroutine that runs as soon as it is called and is not awaited itself
+struct Detached
+{
+  struct promise_type
+  {
+    Detached get_return_object() {return {};}
+    std::suspend_never initial_suspend() noexcept {return {};}
+    std::suspend_never final_suspend() noexcept {return {};}
+    void return_void() {}
+    void unhandled_exception() {std::terminate();}
+  };
+};
+
+/// What an awaitTransform() coroutine got, and the thread it finished on
+struct AwaitResult
+{
+  std::atomic<bool> done{false};
+  std::thread::id thread;
+  geometry_msgs::msg::TransformStamped transform;
+  std::exception_ptr error;
+};
+
+Detached awaitTransform(
+  tf2_ros::Buffer & buffer, std::string source_frame, tf2::TimePoint time, AwaitResult & result)
+{
+  try {
+    result.transform = co_await buffer.transformAvailable(
+      "foo", source_frame, time, tf2::durationFromSec(1.0));
+  } catch (...) {
+    result.error = std::current_exception();
+  }
+  result.thread = std::this_thread::get_id();
+  result.done = true;
+}
+
+class TestBufferCoroutines : public ::testing::Test
+{
+protected:
+  void SetUp()
+  {
+    clock_ = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+    buffer_ = std::make_unique<tf2_ros::Buffer>(clock_);
+    buffer_->setUsingDedicatedThread(true);
+    mock_create_timer_ = std::make_shared<MockCreateTimer>();
+    buffer_->setCreateTimerInterface(mock_create_timer_);
+
+    rclcpp::Time now = clock_->now();
+    time_ = tf2::TimePoint(std::chrono::nanoseconds(now.nanoseconds()));
+    transform_.header.frame_id = "foo";
+    transform_.header.stamp = builtin_interfaces::msg::Time(now);
+    transform_.child_frame_id = "bar";
+    transform_.transform.translation.x = 42.0;
+    transform_.transform.rotation.w = 1.0;
+  }
+
+  rclcpp::Clock::SharedPtr clock_;
+  std::unique_ptr<tf2_ros::Buffer> buffer_;
+  std::shared_ptr<MockCreateTimer> mock_create_timer_;
+  tf2::TimePoint time_;
+  geometry_msgs::msg::TransformStamped transform_;
+};
+
+TEST_F(TestBufferCoroutines, transform_already_available)
+{
+  ASSERT_TRUE(buffer_->setTransform(transform_, "unittest"));
+
+  // The result is in before the coroutine would suspend, so it carries on right away
+  AwaitResult result;
+  awaitTransform(*buffer_, "bar", time_, result);
+  ASSERT_TRUE(result.done);
+  EXPECT_EQ(std::this_thread::get_id(), result.thread);
+  EXPECT_FALSE(result.error);
+  EXPECT_DOUBLE_EQ(42.0, result.transform.transform.translation.x);
+}
+
+TEST_F(TestBufferCoroutines, transform_arrives_later)
+{
+  AwaitResult result;
+  awaitTransform(*buffer_, "bar", time_, result);
+  EXPECT_FALSE(result.done);
+
+  // The coroutine is resumed by the insert that made the transform available
+  std::thread::id inserter_id;
+  std::thread inserter([&]() {
+      inserter_id = std::this_thread::get_id();
+      buffer_->setTransform(transform_, "unittest");
+    });
+  inserter.join();
+  ASSERT_TRUE(result.done);
+  EXPECT_EQ(inserter_id, result.thread);
+  EXPECT_FALSE(result.error);
+  EXPECT_DOUBLE_EQ(42.0, result.transform.transform.translation.x);
+}
+
+TEST_F(TestBufferCoroutines, transform_times_out)
+{
+  AwaitResult result;
+  awaitTransform(*buffer_, "baz", time_, result);
+  EXPECT_FALSE(result.done);
+
+  // The timeout is thrown from the co_await
+  mock_create_timer_->execute_timers();
+  ASSERT_TRUE(result.done);
+  ASSERT_TRUE(result.error);
+  EXPECT_THROW(std::rethrow_exception(result.error), tf2::TimeoutException);
+}
+
+#else
+
+TEST(TestBufferCoroutines, unsupported)
+{
+  GTEST_SKIP() << "The compiler does not support coroutines";
+}
+
+#endif
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
+#include <rclcpp/rclcpp.hpp>
+
+#include <tf2/buffer_core.h>
+#include <tf2/exceptions.h>
+#include <tf2_ros/buffer_metrics_publisher.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+
+TEST(TestBufferMetricsPublisher, publish)
+{
+  auto node = std::make_shared<rclcpp::Node>("tf_metrics");
+  tf2::BufferCore buffer;
+  tf2_ros::BufferMetricsPublisher publisher(buffer, node, "tf2 buffer", tf2::durationFromSec(0.05));
+
+  std::map<std::string, std::string> values;
+  auto subscription = node->create_subscription<diagnostic_msgs::msg::DiagnosticArray>(
+    "/diagnostics", rclcpp::QoS(10),
+    [&values](diagnostic_msgs::msg::DiagnosticArray::ConstSharedPtr msg) {
+      for (const auto & status : msg->status) {
+        if (status.name == "tf_metrics: tf2 buffer") {
+          values.clear();
+          for (const auto & value : status.values) {
+            values[value.key] = value.value;
+          }
+        }
+      }
+    });
+
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.stamp = node->get_clock()->now();
+  transform.header.frame_id = "root";
+  transform.child_frame_id = "child";
+  transform.transform.rotation.w = 1.0;
+  EXPECT_TRUE(buffer.setTransform(transform, "mock_tf_authority"));
+  buffer.lookupTransform("root", "child", tf2::TimePointZero);
+  EXPECT_THROW(
+    buffer.lookupTransform("root", "missing", tf2::TimePointZero), tf2::LookupException);
+
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(node);
+  auto end = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (values.empty() && std::chrono::steady_clock::now() < end) {
+    executor.spin_some(std::chrono::milliseconds(10));
+  }
+
+  ASSERT_FALSE(values.empty());
+  EXPECT_EQ(values["lookup calls"], "2");
+  EXPECT_EQ(values["lookup failures"], "1");
+  EXPECT_EQ(values["lookup lookup failures"], "1");
+  EXPECT_EQ(values["insert calls"], "1");
+  EXPECT_EQ(values["exclusive locks"], "1");
+  EXPECT_EQ(values["history length child"], "1");
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  rclcpp::init(argc, argv);
+  int ret = RUN_ALL_TESTS();
+  rclcpp::shutdown();
+  return ret;
+}
@@ -31,6 +31,7 @@
 #include <gtest/gtest.h>
 
 #include <tf2_msgs/action/lookup_transform.hpp>
+#include <tf2_msgs/action/lookup_transforms.hpp>
 #include <rclcpp/rclcpp.hpp>
 #include <rclcpp_action/rclcpp_action.hpp>
 
@@ -41,6 +42,7 @@
 #include <future>
 #include <memory>
 #include <string>
+#include <vector>
 
 static const char ACTION_NAME[] = "test_tf2_buffer_action";
 
@@ -48,9 +50,11 @@ class MockBufferClient : public rclcpp::Node
 {
   using LookupTransformAction = tf2_msgs::action::LookupTransform;
   using GoalHandle = rclcpp_action::ClientGoalHandle<LookupTransformAction>;
+  using LookupTransformsAction = tf2_msgs::action::LookupTransforms;
+  using BatchGoalHandle = rclcpp_action::ClientGoalHandle<LookupTransformsAction>;
 
 public:
-  MockBufferClient()
+  explicit MockBufferClient(const std::string & action_name = ACTION_NAME)
   : rclcpp::Node("mock_buffer_client"),
     accepted_(false)
   {
@@ -59,7 +63,13 @@ public:
       get_node_graph_interface(),
       get_node_logging_interface(),
       get_node_waitables_interface(),
-      ACTION_NAME);
+      action_name);
+    batch_action_client_ = rclcpp_action::create_client<LookupTransformsAction>(
+      get_node_base_interface(),
+      get_node_graph_interface(),
+      get_node_logging_interface(),
+      get_node_waitables_interface(),
+      action_name + "/batch");
   }
 
   std::shared_future<bool> send_goal(
@@ -101,9 +111,37 @@ public:
     return std::shared_future<bool>(promise->get_future());
   }
 
+  std::shared_future<bool> send_batch_goal(
+    const std::vector<std::string> & target_frames,
+    const std::string & source_frame,
+    const std::chrono::seconds timeout)
+  {
+    auto promise = std::make_shared<std::promise<bool>>();
+
+    auto goal = LookupTransformsAction::Goal();
+    for (const std::string & target_frame : target_frames) {
+      tf2_msgs::msg::TransformRequest request;
+      request.target_frame = target_frame;
+      request.source_frame = source_frame;
+      goal.requests.push_back(request);
+    }
+    goal.timeout.sec = static_cast<int32_t>(timeout.count());
+
+    auto send_goal_options = rclcpp_action::Client<LookupTransformsAction>::SendGoalOptions();
+    send_goal_options.result_callback =
+      [this, promise](const BatchGoalHandle::WrappedResult & result) {
+        this->batch_result_ = result;
+        promise->set_value(true);
+      };
+    batch_action_client_->async_send_goal(goal, send_goal_options);
+    return std::shared_future<bool>(promise->get_future());
+  }
+
   bool accepted_;
   GoalHandle::WrappedResult result_;
+  BatchGoalHandle::WrappedResult batch_result_;
   rclcpp_action::Client<LookupTransformAction>::SharedPtr action_client_;
+  rclcpp_action::Client<LookupTransformsAction>::SharedPtr batch_action_client_;
 };
 
 class TestBufferServer : public ::testing::Test
@@ -131,6 +169,8 @@ protected:
 
     // Wait for discovery
     ASSERT_TRUE(mock_client_->action_client_->wait_for_action_server(std::chrono::seconds(10)));
+    ASSERT_TRUE(
+      mock_client_->batch_action_client_->wait_for_action_server(std::chrono::seconds(10)));
   }
 
   void TearDown()
@@ -236,6 +276,89 @@ TEST_F(TestBufferServer, lookup_transform_delayed)
   EXPECT_EQ(mock_client_->result_.code, rclcpp_action::ResultCode::SUCCEEDED);
 }
 
+TEST_F(TestBufferServer, lookup_transform_completes_on_insert)
+{
+  // Goals complete when their transform arrives rather than on the next check
+  const std::string action_name = std::string(ACTION_NAME) + "_slow_check";
+  tf2_ros::BufferServer server(*buffer_, node_, action_name, tf2::durationFromSec(30.0));
+  auto client = std::make_shared<MockBufferClient>(action_name);
+  executor_.add_node(client);
+  ASSERT_TRUE(client->action_client_->wait_for_action_server(std::chrono::seconds(10)));
+
+  auto result_ready_future = client->send_goal(
+    "test_target_link", "test_source_link", std::chrono::seconds(20), "test_fixed_link", true);
+  auto spin_result = executor_.spin_until_future_complete(
+    result_ready_future, std::chrono::milliseconds(500));
+  EXPECT_EQ(spin_result, rclcpp::FutureReturnCode::TIMEOUT);
+  EXPECT_TRUE(client->accepted_);
+
+  geometry_msgs::msg::Transform transform;
+  transform.rotation.w = 1.0;
+  setTransform("test_fixed_link", "test_source_link", transform);
+  spin_result = executor_.spin_until_future_complete(
+    result_ready_future, std::chrono::milliseconds(500));
+  EXPECT_EQ(spin_result, rclcpp::FutureReturnCode::TIMEOUT);
+
+  auto start_time = std::chrono::steady_clock::now();
+  setTransform("test_fixed_link", "test_target_link", transform);
+  spin_result = executor_.spin_until_future_complete(
+    result_ready_future, std::chrono::seconds(3));
+  ASSERT_EQ(spin_result, rclcpp::FutureReturnCode::SUCCESS);
+  EXPECT_LT(std::chrono::steady_clock::now() - start_time, std::chrono::seconds(2));
+  EXPECT_EQ(client->result_.code, rclcpp_action::ResultCode::SUCCEEDED);
+  executor_.remove_node(client);
+}
+
+TEST_F(TestBufferServer, lookup_transforms_batch)
+{
+  geometry_msgs::msg::Transform transform;
+  transform.translation.x = 1.0;
+  transform.rotation.w = 1.0;
+  setTransform("test_target_link", "test_source_link", transform);
+
+  // The batch waits until all of its lookups can be done
+  auto result_ready_future = mock_client_->send_batch_goal(
+    {"test_target_link", "test_other_link"}, "test_source_link", std::chrono::seconds(5));
+  auto spin_result = executor_.spin_until_future_complete(
+    result_ready_future, std::chrono::milliseconds(500));
+  EXPECT_EQ(spin_result, rclcpp::FutureReturnCode::TIMEOUT);
+
+  transform.translation.x = 2.0;
+  setTransform("test_other_link", "test_target_link", transform);
+  spin_result = executor_.spin_until_future_complete(
+    result_ready_future, std::chrono::seconds(3));
+  ASSERT_EQ(spin_result, rclcpp::FutureReturnCode::SUCCESS);
+
+  const auto & result = mock_client_->batch_result_;
+  EXPECT_EQ(result.code, rclcpp_action::ResultCode::SUCCEEDED);
+  ASSERT_EQ(2u, result.result->transforms.size());
+  ASSERT_EQ(2u, result.result->errors.size());
+  EXPECT_EQ(result.result->errors[0].error, tf2_msgs::msg::TF2Error::NO_ERROR);
+  EXPECT_EQ(result.result->errors[1].error, tf2_msgs::msg::TF2Error::NO_ERROR);
+  EXPECT_DOUBLE_EQ(1.0, result.result->transforms[0].transform.translation.x);
+  EXPECT_DOUBLE_EQ(3.0, result.result->transforms[1].transform.translation.x);
+}
+
+TEST_F(TestBufferServer, lookup_transforms_batch_timeout)
+{
+  geometry_msgs::msg::Transform transform;
+  transform.rotation.w = 1.0;
+  setTransform("test_target_link", "test_source_link", transform);
+
+  // Lookups that cannot be done by the timeout report their errors in the result
+  auto result_ready_future = mock_client_->send_batch_goal(
+    {"test_target_link", "test_missing_link"}, "test_source_link", std::chrono::seconds(1));
+  auto spin_result = executor_.spin_until_future_complete(
+    result_ready_future, std::chrono::seconds(3));
+  ASSERT_EQ(spin_result, rclcpp::FutureReturnCode::SUCCESS);
+
+  const auto & result = mock_client_->batch_result_;
+  EXPECT_EQ(result.code, rclcpp_action::ResultCode::SUCCEEDED);
+  ASSERT_EQ(2u, result.result->errors.size());
+  EXPECT_EQ(result.result->errors[0].error, tf2_msgs::msg::TF2Error::NO_ERROR);
+  EXPECT_EQ(result.result->errors[1].error, tf2_msgs::msg::TF2Error::LOOKUP_ERROR);
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,87 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+#include <tf2_ros/spsc_queue.h>
+
+#include <memory>
+#include <thread>
+
+TEST(tf2_ros_spsc_queue, push_pop)
+{
+  tf2_ros::SPSCQueue<std::unique_ptr<int>> queue(3);
+  EXPECT_EQ(4u, queue.capacity());
+
+  std::unique_ptr<int> item;
+  EXPECT_FALSE(queue.pop(item));
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(queue.push(std::unique_ptr<int>(new int(i))));
+  }
+  item.reset(new int(4));
+  EXPECT_FALSE(queue.push(std::move(item)));
+  // A failed push leaves the item with the caller
+  ASSERT_TRUE(item != nullptr);
+  EXPECT_EQ(4u, queue.size());
+
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(queue.pop(item));
+    EXPECT_EQ(i, *item);
+  }
+  EXPECT_FALSE(queue.pop(item));
+  EXPECT_EQ(0u, queue.size());
+}
+
+TEST(tf2_ros_spsc_queue, threads)
+{
+  tf2_ros::SPSCQueue<int> queue(16);
+  const int count = 100000;
+  std::thread producer([&]() {
+      for (int i = 0; i < count; ++i) {
+        int item = i;
+        while (!queue.push(std::move(item))) {
+          std::this_thread::yield();
+        }
+      }
+    });
+
+  int expected = 0;
+  while (expected < count) {
+    int item;
+    if (queue.pop(item)) {
+      ASSERT_EQ(expected, item);
+      ++expected;
+    }
+  }
+  producer.join();
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -30,7 +30,10 @@
 #include <gtest/gtest.h>
 #include <tf2_ros/static_transform_broadcaster.h>
 
+#include <chrono>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "node_wrapper.hpp"
 
@@ -70,6 +73,56 @@ TEST(tf2_test_static_transform_broadcaster, transform_broadcaster_as_member)
   custom_node->init_tf_broadcaster();
 }
 
+TEST(tf2_test_static_transform_broadcaster, staged_transforms_publish_on_commit)
+{
+  auto node = rclcpp::Node::make_shared("tf2_ros_test_static_transform_broadcaster_commit");
+  tf2_ros::StaticTransformBroadcaster tfb(node);
+
+  std::vector<tf2_msgs::msg::TFMessage> received;
+  auto sub = node->create_subscription<tf2_msgs::msg::TFMessage>(
+    "/tf_static", tf2_ros::StaticListenerQoS(),
+    [&received](const tf2_msgs::msg::TFMessage::SharedPtr msg) {
+      received.push_back(*msg);
+    });
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(node);
+
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = "parent";
+  transform.transform.rotation.w = 1.0;
+  std::vector<geometry_msgs::msg::TransformStamped> rig;
+  for (int i = 0; i < 100; ++i) {
+    transform.child_frame_id = "sensor_" + std::to_string(i);
+    tfb.stageTransform(transform);
+    rig.push_back(transform);
+  }
+  // Restaging a frame replaces it in place
+  transform.child_frame_id = "sensor_0";
+  transform.transform.translation.x = 2.0;
+  tfb.stageTransform(transform);
+  EXPECT_EQ(100u, tfb.getNumTransforms());
+
+  executor.spin_some(std::chrono::milliseconds(100));
+  EXPECT_TRUE(received.empty());
+
+  EXPECT_TRUE(tfb.commit());
+  // Nothing changed since the last commit
+  EXPECT_FALSE(tfb.commit());
+  rig[0] = transform;
+  tfb.sendTransform(rig);
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (received.empty() && std::chrono::steady_clock::now() < deadline) {
+    executor.spin_some(std::chrono::milliseconds(10));
+  }
+  executor.spin_some(std::chrono::milliseconds(100));
+  ASSERT_EQ(1u, received.size());
+  ASSERT_EQ(100u, received[0].transforms.size());
+  EXPECT_EQ("sensor_0", received[0].transforms[0].child_frame_id);
+  EXPECT_EQ(2.0, received[0].transforms[0].transform.translation.x);
+  EXPECT_EQ("sensor_99", received[0].transforms[99].child_frame_id);
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
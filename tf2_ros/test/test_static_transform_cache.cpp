@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <tf2/buffer_core.h>
+#include <tf2_ros/static_transform_cache.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+geometry_msgs::msg::TransformStamped makeTransform(const std::string & child, double x)
+{
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = "base_link";
+  transform.child_frame_id = child;
+  transform.transform.translation.x = x;
+  transform.transform.rotation.w = 1.0;
+  return transform;
+}
+
+std::string cachePath(const std::string & name)
+{
+  std::string path = testing::TempDir() + "tf2_ros_" + name + ".cache";
+  std::remove(path.c_str());
+  return path;
+}
+
+}  // namespace
+
+TEST(tf2_test_static_transform_cache, round_trip)
+{
+  const std::string path = cachePath("round_trip");
+  tf2_ros::StaticTransformCache cache(path, "robot_v1");
+  EXPECT_FALSE(cache.load());
+
+  ASSERT_TRUE(cache.update({makeTransform("camera", 1.0), makeTransform("lidar", 2.0)}));
+  ASSERT_TRUE(cache.update({makeTransform("camera", 3.0)}));
+
+  tf2_ros::StaticTransformCache loaded(path, "robot_v1");
+  ASSERT_TRUE(loaded.load());
+  std::vector<geometry_msgs::msg::TransformStamped> transforms = loaded.getTransforms();
+  ASSERT_EQ(2u, transforms.size());
+  EXPECT_EQ("camera", transforms[0].child_frame_id);
+  EXPECT_EQ(3.0, transforms[0].transform.translation.x);
+  EXPECT_EQ("lidar", transforms[1].child_frame_id);
+
+  tf2::BufferCore buffer;
+  loaded.apply(buffer);
+  EXPECT_TRUE(buffer.canTransform("camera", "lidar", tf2::TimePointZero));
+  EXPECT_EQ(
+    -1.0, buffer.lookupTransform(
+      "camera", "lidar", tf2::TimePointZero).transform.translation.x);
+}
+
+TEST(tf2_test_static_transform_cache, rejects_other_version)
+{
+  const std::string path = cachePath("other_version");
+  ASSERT_TRUE(
+    tf2_ros::StaticTransformCache(path, "robot_v1").update({makeTransform("camera", 1.0)}));
+
+  tf2_ros::StaticTransformCache cache(path, "robot_v2");
+  EXPECT_FALSE(cache.load());
+  EXPECT_TRUE(cache.getTransforms().empty());
+}
+
+TEST(tf2_test_static_transform_cache, rejects_corrupt_file)
+{
+  const std::string path = cachePath("corrupt");
+  ASSERT_TRUE(tf2_ros::StaticTransformCache(path).update({makeTransform("camera", 1.0)}));
+
+  std::string contents;
+  {
+    std::ifstream in(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  ASSERT_FALSE(contents.empty());
+
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    std::string damaged = contents;
+    damaged.back() ^= 0x1;
+    out << damaged;
+  }
+  EXPECT_FALSE(tf2_ros::StaticTransformCache(path).load());
+
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << contents.substr(0, contents.size() / 2);
+  }
+  EXPECT_FALSE(tf2_ros::StaticTransformCache(path).load());
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -28,9 +28,14 @@
  */
 
 #include <gtest/gtest.h>
+#include <tf2_ros/aggregating_transform_broadcaster.h>
 #include <tf2_ros/transform_broadcaster.h>
 
+#include <chrono>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "node_wrapper.hpp"
 
@@ -70,6 +75,149 @@ TEST(tf2_test_transform_broadcaster, transform_broadcaster_as_member)
   custom_node->init_tf_broadcaster();
 }
 
+TEST(tf2_test_transform_broadcaster, send_transform_overloads)
+{
+  auto node = rclcpp::Node::make_shared("tf2_ros_test_send_transform_overloads");
+  tf2_ros::TransformBroadcaster tfb(node);
+
+  bool matched = false;
+  std::vector<std::string> received;
+  auto sub = node->create_subscription<tf2_msgs::msg::TFMessage>(
+    "/tf", tf2_ros::DynamicListenerQoS(),
+    [&matched, &received](const tf2_msgs::msg::TFMessage::SharedPtr msg) {
+      for (const auto & transform : msg->transforms) {
+        if (transform.child_frame_id == "probe") {
+          matched = true;
+        } else {
+          received.push_back(transform.child_frame_id);
+        }
+      }
+    });
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(node);
+
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = "parent";
+  transform.transform.rotation.w = 1.0;
+
+  // Wait for the subscription to be matched
+  transform.child_frame_id = "probe";
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!matched && std::chrono::steady_clock::now() < deadline) {
+    tfb.sendTransform(transform);
+    executor.spin_some(std::chrono::milliseconds(50));
+  }
+  ASSERT_TRUE(matched);
+
+  transform.child_frame_id = "single";
+  tfb.sendTransform(transform);
+  transform.child_frame_id = "vector";
+  tfb.sendTransform(std::vector<geometry_msgs::msg::TransformStamped>{transform, transform});
+
+  // A preallocated message is sent as is and can be reused
+  tf2_msgs::msg::TFMessage message;
+  message.transforms.push_back(transform);
+  message.transforms[0].child_frame_id = "preallocated";
+  tfb.sendTransform(message);
+  tfb.sendTransform(message);
+
+  auto loaned = tfb.borrowMessage();
+  loaned.get().transforms.push_back(transform);
+  loaned.get().transforms[0].child_frame_id = "loaned";
+  tfb.sendTransform(std::move(loaned));
+
+  const std::vector<std::string> expected = {
+    "single", "vector", "vector", "preallocated", "preallocated", "loaned"};
+  deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (received.size() < expected.size() && std::chrono::steady_clock::now() < deadline) {
+    executor.spin_some(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(expected, received);
+}
+
+TEST(tf2_test_transform_broadcaster, aggregating_broadcaster_coalesces)
+{
+  auto node = rclcpp::Node::make_shared("tf2_ros_test_aggregating_broadcaster");
+  tf2_ros::AggregatingTransformBroadcaster tfb(node, std::chrono::nanoseconds::zero());
+
+  bool matched = false;
+  std::vector<tf2_msgs::msg::TFMessage> received;
+  auto sub = node->create_subscription<tf2_msgs::msg::TFMessage>(
+    "/tf", tf2_ros::DynamicListenerQoS(),
+    [&matched, &received](const tf2_msgs::msg::TFMessage::SharedPtr msg) {
+      if (!msg->transforms.empty() && msg->transforms[0].child_frame_id == "probe") {
+        matched = true;
+      } else {
+        received.push_back(*msg);
+      }
+    });
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(node);
+
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = "parent";
+  transform.transform.rotation.w = 1.0;
+
+  transform.child_frame_id = "probe";
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!matched && std::chrono::steady_clock::now() < deadline) {
+    tfb.sendTransform(transform);
+    tfb.flush();
+    executor.spin_some(std::chrono::milliseconds(50));
+  }
+  ASSERT_TRUE(matched);
+
+  transform.child_frame_id = "a";
+  tfb.sendTransform(transform);
+  transform.child_frame_id = "b";
+  tfb.sendTransform(transform);
+  // A repeated child frame replaces the pending value instead of being sent twice
+  transform.child_frame_id = "a";
+  transform.transform.translation.x = 2.0;
+  tfb.sendTransform(std::vector<geometry_msgs::msg::TransformStamped>{transform});
+  EXPECT_EQ(2u, tfb.getNumPending());
+
+  // Nothing is published without a flush when the window is disabled
+  executor.spin_some(std::chrono::milliseconds(100));
+  EXPECT_TRUE(received.empty());
+
+  tfb.flush();
+  EXPECT_EQ(0u, tfb.getNumPending());
+  tfb.flush();
+
+  deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (received.empty() && std::chrono::steady_clock::now() < deadline) {
+    executor.spin_some(std::chrono::milliseconds(10));
+  }
+  executor.spin_some(std::chrono::milliseconds(100));
+  ASSERT_EQ(1u, received.size());
+  ASSERT_EQ(2u, received[0].transforms.size());
+  EXPECT_EQ("a", received[0].transforms[0].child_frame_id);
+  EXPECT_EQ(2.0, received[0].transforms[0].transform.translation.x);
+  EXPECT_EQ("b", received[0].transforms[1].child_frame_id);
+}
+
+TEST(tf2_test_transform_broadcaster, aggregating_broadcaster_flushes_on_window)
+{
+  auto node = rclcpp::Node::make_shared("tf2_ros_test_aggregating_broadcaster_window");
+  tf2_ros::AggregatingTransformBroadcaster tfb(node, std::chrono::milliseconds(10));
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(node);
+
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = "parent";
+  transform.child_frame_id = "child";
+  transform.transform.rotation.w = 1.0;
+  tfb.sendTransform(transform);
+  EXPECT_EQ(1u, tfb.getNumPending());
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (tfb.getNumPending() != 0 && std::chrono::steady_clock::now() < deadline) {
+    executor.spin_some(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(0u, tfb.getNumPending());
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
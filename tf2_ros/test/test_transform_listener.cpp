@@ -29,9 +29,16 @@
 
 #include <gtest/gtest.h>
 #include <tf2_ros/buffer.h>
+#include <tf2_ros/static_transform_broadcaster.h>
+#include <tf2_ros/transform_broadcaster.h>
 #include <tf2_ros/transform_listener.h>
 
+#include <chrono>
 #include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "node_wrapper.hpp"
 
@@ -77,6 +84,182 @@ TEST(tf2_test_transform_listener, transform_listener_as_member)
   custom_node->init_tf_listener();
 }
 
+TEST(tf2_test_transform_listener, transform_listener_intra_process_shared)
+{
+  auto node = rclcpp::Node::make_shared(
+    "tf2_ros_test_intra_process", rclcpp::NodeOptions().use_intra_process_comms(true));
+
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  tf2_ros::Buffer other_buffer(clock);
+  tf2_ros::TransformListener tfl(buffer, node, false);
+  tfl.addBuffer(other_buffer);
+  tf2_ros::TransformBroadcaster tfb(node);
+
+  auto message = std::make_unique<tf2_msgs::msg::TFMessage>();
+  message->transforms.resize(1);
+  message->transforms[0].header.stamp = clock->now();
+  message->transforms[0].header.frame_id = "a";
+  message->transforms[0].child_frame_id = "b";
+  message->transforms[0].transform.rotation.w = 1.0;
+  tfb.sendTransform(std::move(message));
+
+  auto start = std::chrono::steady_clock::now();
+  while (!other_buffer.canTransform("a", "b", tf2::TimePointZero) &&
+    std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+  {
+    rclcpp::spin_some(node);
+  }
+  EXPECT_TRUE(buffer.canTransform("a", "b", tf2::TimePointZero));
+  EXPECT_TRUE(other_buffer.canTransform("a", "b", tf2::TimePointZero));
+
+  tfl.removeBuffer(other_buffer);
+}
+
+namespace
+{
+
+geometry_msgs::msg::TransformStamped makeTransform(
+  rclcpp::Clock::SharedPtr clock, const std::string & parent, const std::string & child)
+{
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.stamp = clock->now();
+  transform.header.frame_id = parent;
+  transform.child_frame_id = child;
+  transform.transform.rotation.w = 1.0;
+  return transform;
+}
+
+bool waitForTransform(
+  const tf2_ros::Buffer & buffer, const std::string & target, const std::string & source)
+{
+  auto start = std::chrono::steady_clock::now();
+  while (!buffer.canTransform(target, source, tf2::TimePointZero)) {
+    if (std::chrono::steady_clock::now() - start > std::chrono::seconds(5)) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST(tf2_test_transform_listener, transform_listener_separate_static_thread)
+{
+  auto node = rclcpp::Node::make_shared("tf2_ros_test_listener_threads");
+
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  tf2_ros::TransformListenerThreadOptions thread_options;
+  thread_options.separate_static_thread = true;
+  tf2_ros::TransformListener tfl(buffer, node, thread_options);
+
+  tf2_ros::TransformBroadcaster tfb(node);
+  tf2_ros::StaticTransformBroadcaster stfb(node);
+  stfb.sendTransform(makeTransform(clock, "a", "b"));
+  EXPECT_TRUE(waitForTransform(buffer, "a", "b"));
+
+  auto start = std::chrono::steady_clock::now();
+  while (!buffer.canTransform("b", "c", tf2::TimePointZero) &&
+    std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+  {
+    tfb.sendTransform(makeTransform(clock, "b", "c"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_TRUE(buffer.canTransform("a", "c", tf2::TimePointZero));
+}
+
+TEST(tf2_test_transform_listener, transform_listener_user_executor)
+{
+  auto node = rclcpp::Node::make_shared("tf2_ros_test_listener_executor");
+
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  tf2_ros::TransformListenerThreadOptions thread_options;
+  thread_options.executor = std::make_shared<rclcpp::executors::SingleThreadedExecutor>();
+  tf2_ros::TransformListener tfl(buffer, node, thread_options);
+
+  tf2_ros::StaticTransformBroadcaster stfb(node);
+  stfb.sendTransform(makeTransform(clock, "a", "b"));
+
+  auto start = std::chrono::steady_clock::now();
+  while (!buffer.canTransform("a", "b", tf2::TimePointZero) &&
+    std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+  {
+    thread_options.executor->spin_some();
+  }
+  EXPECT_TRUE(buffer.canTransform("a", "b", tf2::TimePointZero));
+}
+
+TEST(tf2_test_transform_listener, transform_listener_ingest_policy)
+{
+  auto node = rclcpp::Node::make_shared("tf2_ros_test_listener_ingest");
+
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  tf2_ros::TransformListener tfl(buffer, node, false);
+  tf2_ros::TransformListenerIngestPolicy every_other;
+  every_other.keep_every = 2;
+  tfl.setIngestPolicy("b", every_other);
+  tf2_ros::TransformListenerIngestPolicy slow;
+  slow.min_period = std::chrono::seconds(3);
+  tfl.setIngestPolicy(slow);
+  tf2_ros::TransformBroadcaster tfb(node);
+
+  for (int32_t sec = 1; sec <= 10; ++sec) {
+    std::vector<geometry_msgs::msg::TransformStamped> transforms;
+    transforms.push_back(makeTransform(clock, "a", "b"));
+    transforms.back().header.stamp = rclcpp::Time(sec, 0);
+    transforms.push_back(makeTransform(clock, "a", "c"));
+    transforms.back().header.stamp = rclcpp::Time(sec, 0);
+    // An older sample of c in the same message is coalesced away
+    transforms.push_back(makeTransform(clock, "a", "c"));
+    transforms.back().header.stamp = rclcpp::Time(sec - 1, 0);
+    tfb.sendTransform(transforms);
+  }
+
+  auto received = [&tfl](const std::string & frame) {
+      auto stats = tfl.getIngestStats();
+      return stats.count(frame) ? stats[frame].received : 0u;
+    };
+  auto start = std::chrono::steady_clock::now();
+  while ((received("b") < 10 || received("c") < 20) &&
+    std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+  {
+    rclcpp::spin_some(node);
+  }
+
+  auto stats = tfl.getIngestStats();
+  EXPECT_EQ(10u, stats["b"].received);
+  EXPECT_EQ(5u, stats["b"].dropped);
+  // c is kept at 1, 4, 7 and 10 seconds
+  EXPECT_EQ(20u, stats["c"].received);
+  EXPECT_EQ(16u, stats["c"].dropped);
+  EXPECT_TRUE(buffer.canTransform("a", "c", tf2::timeFromSec(10)));
+  EXPECT_FALSE(buffer.canTransform("a", "c", tf2::timeFromSec(0.5)));
+}
+
+TEST(tf2_test_transform_listener, transform_listener_ingest_queue)
+{
+  auto node = rclcpp::Node::make_shared("tf2_ros_test_listener_queue");
+
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  tf2_ros::TransformListenerThreadOptions thread_options;
+  thread_options.ingest_queue_size = 16;
+  tf2_ros::TransformListener tfl(buffer, node, thread_options);
+
+  tf2_ros::StaticTransformBroadcaster stfb(node);
+  stfb.sendTransform(makeTransform(clock, "a", "b"));
+  EXPECT_TRUE(waitForTransform(buffer, "a", "b"));
+
+  tf2_ros::TransformListenerQueueStats stats = tfl.getIngestQueueStats();
+  EXPECT_GT(stats.batches, 0u);
+  EXPECT_GT(stats.max_depth, 0u);
+  EXPECT_EQ(0u, stats.overflows);
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
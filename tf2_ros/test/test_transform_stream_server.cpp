@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <rclcpp/rclcpp.hpp>
+#include <tf2_msgs/msg/tf_message.hpp>
+#include <tf2_msgs/srv/stream_transforms.hpp>
+
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_stream_server.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+static const char STREAM_NS[] = "test_tf2_stream";
+
+class TestTransformStreamServer : public ::testing::Test
+{
+protected:
+  static void SetUpTestCase()
+  {
+    rclcpp::init(0, nullptr);
+  }
+
+  static void TearDownTestCase()
+  {
+    rclcpp::shutdown();
+  }
+
+  void SetUp()
+  {
+    node_ = std::make_shared<rclcpp::Node>("tf_stream");
+    buffer_ = std::make_shared<tf2_ros::Buffer>(node_->get_clock());
+    server_ = std::make_unique<tf2_ros::TransformStreamServer>(
+      *buffer_, node_, STREAM_NS, tf2::durationFromSec(0.5));
+    client_ = node_->create_client<tf2_msgs::srv::StreamTransforms>(
+      std::string(STREAM_NS) + "/stream");
+    executor_.add_node(node_);
+    ASSERT_TRUE(client_->wait_for_service(std::chrono::seconds(10)));
+  }
+
+  void TearDown()
+  {
+    client_.reset();
+    server_.reset();
+    buffer_.reset();
+    node_.reset();
+  }
+
+  void setTransform(const std::string & parent, const std::string & child, double x)
+  {
+    geometry_msgs::msg::TransformStamped transform;
+    transform.header.stamp = node_->get_clock()->now();
+    transform.header.frame_id = parent;
+    transform.child_frame_id = child;
+    transform.transform.translation.x = x;
+    transform.transform.rotation.w = 1.0;
+    buffer_->setTransform(transform, "mock_tf_authority");
+  }
+
+  std::shared_ptr<tf2_msgs::srv::StreamTransforms::Response> stream(
+    const std::vector<std::string> & target_frames, const std::vector<std::string> & source_frames)
+  {
+    auto request = std::make_shared<tf2_msgs::srv::StreamTransforms::Request>();
+    request->target_frames = target_frames;
+    request->source_frames = source_frames;
+    request->rate = 50.0;
+    request->translation_threshold = 0.1;
+    request->rotation_threshold = 0.1;
+    auto future = client_->async_send_request(request);
+    EXPECT_EQ(
+      executor_.spin_until_future_complete(future, std::chrono::seconds(3)),
+      rclcpp::FutureReturnCode::SUCCESS);
+    return future.get();
+  }
+
+  void spinFor(std::chrono::milliseconds duration)
+  {
+    auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end) {
+      executor_.spin_some(std::chrono::milliseconds(10));
+    }
+  }
+
+  rclcpp::Node::SharedPtr node_;
+  std::shared_ptr<tf2_ros::Buffer> buffer_;
+  std::unique_ptr<tf2_ros::TransformStreamServer> server_;
+  rclcpp::Client<tf2_msgs::srv::StreamTransforms>::SharedPtr client_;
+  rclcpp::executors::SingleThreadedExecutor executor_;
+};
+
+TEST_F(TestTransformStreamServer, streams_changes_only)
+{
+  setTransform("map", "odom", 1.0);
+  setTransform("odom", "base_link", 2.0);
+
+  auto response = stream({"map", "odom"}, {"base_link", "base_link"});
+  ASSERT_FALSE(response->topic.empty()) << response->error_string;
+  EXPECT_EQ(1u, server_->getNumStreams());
+
+  std::vector<tf2_msgs::msg::TFMessage> received;
+  auto sub = node_->create_subscription<tf2_msgs::msg::TFMessage>(
+    response->topic, rclcpp::QoS(100),
+    [&received](const tf2_msgs::msg::TFMessage::SharedPtr msg) {received.push_back(*msg);});
+
+  // Everything is sent to a new subscriber once
+  spinFor(std::chrono::milliseconds(500));
+  ASSERT_EQ(1u, received.size());
+  ASSERT_EQ(2u, received[0].transforms.size());
+  EXPECT_EQ("map", received[0].transforms[0].header.frame_id);
+  EXPECT_EQ("base_link", received[0].transforms[0].child_frame_id);
+  EXPECT_DOUBLE_EQ(3.0, received[0].transforms[0].transform.translation.x);
+  EXPECT_DOUBLE_EQ(2.0, received[0].transforms[1].transform.translation.x);
+
+  // Small moves are not sent, larger ones only for the pairs they change
+  setTransform("map", "odom", 1.05);
+  spinFor(std::chrono::milliseconds(200));
+  EXPECT_EQ(1u, received.size());
+  setTransform("map", "odom", 1.5);
+  spinFor(std::chrono::milliseconds(200));
+  ASSERT_EQ(2u, received.size());
+  ASSERT_EQ(1u, received[1].transforms.size());
+  EXPECT_EQ("map", received[1].transforms[0].header.frame_id);
+  EXPECT_DOUBLE_EQ(3.5, received[1].transforms[0].transform.translation.x);
+
+  // The stream closes once nobody listens to it
+  sub.reset();
+  spinFor(std::chrono::milliseconds(1000));
+  EXPECT_EQ(0u, server_->getNumStreams());
+}
+
+TEST_F(TestTransformStreamServer, rejects_invalid_requests)
+{
+  auto response = stream({"map"}, {});
+  EXPECT_TRUE(response->topic.empty());
+  EXPECT_FALSE(response->error_string.empty());
+
+  response = stream({}, {});
+  EXPECT_TRUE(response->topic.empty());
+  EXPECT_EQ(0u, server_->getNumStreams());
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
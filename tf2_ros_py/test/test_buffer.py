@@ -28,11 +28,16 @@
 # ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 # POSSIBILITY OF SUCH DAMAGE.
 
+import threading
+import time
 import unittest
 import rclpy
 
 from tf2_ros.buffer import Buffer
+from tf2_ros import LookupException
 from geometry_msgs.msg import TransformStamped, PointStamped
+from rclpy.serialization import serialize_message
+from tf2_msgs.msg import TFMessage
 
 
 class TestBuffer(unittest.TestCase):
@@ -140,6 +145,49 @@ class TestBuffer(unittest.TestCase):
         self.assertEqual(transform, cm.exception.value)
         coro.close()
 
+    def test_await_transform_full_waits_for_both_frames(self):
+        buffer = Buffer()
+        clock = rclpy.clock.Clock()
+        rclpy_time = clock.now()
+
+        fut = buffer.wait_for_transform_full_async('foo', rclpy_time, 'bar', rclpy_time, 'fixed')
+        buffer.set_transform(self.build_transform('fixed', 'foo', rclpy_time), 'unittest')
+        self.assertFalse(fut.done())
+
+        buffer.set_transform(self.build_transform('fixed', 'bar', rclpy_time), 'unittest')
+        self.assertTrue(fut.done())
+        self.assertTrue(fut.result())
+
+    def test_await_transform_too_old(self):
+        # a transform older than the cache can never become available
+        buffer = Buffer()
+        clock = rclpy.clock.Clock()
+        rclpy_time = clock.now()
+        buffer.set_transform(self.build_transform('foo', 'bar', rclpy_time), 'unittest')
+
+        fut = buffer.wait_for_transform_async(
+            'foo', 'bar', rclpy_time - rclpy.duration.Duration(seconds=60.0))
+
+        self.assertTrue(fut.done())
+        self.assertEqual(LookupException, type(fut.exception()))
+
+    def test_can_transform_timeout_wakes_on_insert(self):
+        buffer = Buffer()
+        clock = rclpy.clock.Clock()
+        rclpy_time = clock.now()
+        transform = self.build_transform('foo', 'bar', rclpy_time)
+
+        timer = threading.Timer(0.1, lambda: buffer.set_transform(transform, 'unittest'))
+        timer.start()
+        start = time.monotonic()
+        self.assertTrue(
+            buffer.can_transform('foo', 'bar', rclpy_time, rclpy.duration.Duration(seconds=10.0)))
+        self.assertLess(time.monotonic() - start, 5.0)
+        timer.join()
+
+        self.assertFalse(
+            buffer.can_transform('foo', 'baz', rclpy_time, rclpy.duration.Duration(seconds=0.1)))
+
     def test_buffer_non_default_cache(self):
         buffer = Buffer(cache_time=rclpy.duration.Duration(seconds=10.0))
         clock = rclpy.clock.Clock()
@@ -156,6 +204,41 @@ class TestBuffer(unittest.TestCase):
         self.assertEqual(transform.transform.translation.y, output.transform.translation.y)
         self.assertEqual(transform.transform.translation.z, output.transform.translation.z)
 
+    def test_set_transforms_notifies_once(self):
+        buffer = Buffer()
+        clock = rclpy.clock.Clock()
+        rclpy_time = clock.now()
+        transforms = [
+            self.build_transform('foo', 'bar', rclpy_time),
+            self.build_transform('bar', 'baz', rclpy_time),
+        ]
+
+        calls = []
+        buffer._new_data_callbacks.append(lambda: calls.append(None))
+        self.assertEqual(buffer.set_transforms(transforms, 'unittest'), None)
+
+        self.assertEqual(len(calls), 1)
+        self.assertEqual(buffer.can_transform('foo', 'baz', rclpy_time), True)
+
+    def test_set_transforms_serialized(self):
+        buffer = Buffer()
+        clock = rclpy.clock.Clock()
+        rclpy_time = clock.now()
+        transform = self.build_transform('foo', 'bar', rclpy_time)
+        static_transform = self.build_transform('bar', 'baz', rclpy_time)
+
+        buffer.set_transforms_serialized(
+            serialize_message(TFMessage(transforms=[transform])), 'unittest')
+        buffer.set_transforms_static_serialized(
+            serialize_message(TFMessage(transforms=[static_transform])), 'unittest')
+
+        output = buffer.lookup_transform('foo', 'bar', rclpy_time)
+        self.assertEqual(transform, output)
+        self.assertEqual(buffer.can_transform('bar', 'baz', rclpy.time.Time()), True)
+
+        with self.assertRaises(ValueError):
+            buffer.set_transforms_serialized(b'\x00\x01\x00\x00\x01', 'unittest')
+
 
 if __name__ == '__main__':
     unittest.main()
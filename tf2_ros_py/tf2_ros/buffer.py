@@ -40,9 +40,11 @@ import tf2_py as tf2
 import tf2_ros
 from tf2_msgs.srv import FrameGraph
 from geometry_msgs.msg import TransformStamped
+from geometry_msgs.msg import TwistStamped
 # TODO(vinnamkim): It seems rosgraph is not ready
 # import rosgraph.masterapi
-from time import sleep
+from rclpy.clock import ClockType
+from rclpy.clock import JumpThreshold
 from rclpy.node import Node
 from rclpy.time import Time
 from rclpy.duration import Duration
@@ -63,6 +65,10 @@ class Buffer(tf2.BufferCore, tf2_ros.BufferInterface):
     known frames.
     """
 
+    # Handles returned by add_transformable_request() when it does not need to call back
+    _TRANSFORMABLE_NOW = 0
+    _TRANSFORMABLE_NEVER = 0xffffffffffffffff
+
     def __init__(
         self,
         cache_time: Optional[Duration] = None,
@@ -80,6 +86,9 @@ class Buffer(tf2.BufferCore, tf2_ros.BufferInterface):
             tf2.BufferCore.__init__(self)
         tf2_ros.BufferInterface.__init__(self)
 
+        # Timeouts follow the node clock, so they also work with simulated time
+        self._clock = node.get_clock() if node is not None else rclpy.clock.Clock()
+
         self._new_data_callbacks: List[Callable[[], None]] = []
         self._callbacks_to_remove: List[Callable[[], None]] = []
         self._callbacks_lock = threading.RLock()
@@ -102,6 +111,48 @@ class Buffer(tf2.BufferCore, tf2_ros.BufferInterface):
         super().set_transform_static(transform, authority)
         self._call_new_data_callbacks()
 
+    def set_transforms(self, transforms: List[TransformStamped], authority: str) -> None:
+        """
+        Insert many transforms with one call into the core, notifying waiters once.
+
+        :param transforms: The transforms to insert, such as the transforms of a TFMessage.
+        :param authority: The source of the transforms.
+        """
+        super().set_transforms(transforms, authority)
+        self._call_new_data_callbacks()
+
+    def set_transforms_static(self, transforms: List[TransformStamped], authority: str) -> None:
+        """
+        Insert many static transforms with one call into the core, notifying waiters once.
+
+        :param transforms: The transforms to insert, such as the transforms of a TFMessage.
+        :param authority: The source of the transforms.
+        """
+        super().set_transforms_static(transforms, authority)
+        self._call_new_data_callbacks()
+
+    def set_transforms_serialized(self, data: bytes, authority: str) -> None:
+        """
+        Insert the transforms of a serialized TFMessage, as received by a raw subscription.
+
+        The message is decoded in C++ without creating any Python objects.
+
+        :param data: The serialized tf2_msgs/TFMessage.
+        :param authority: The source of the transforms.
+        """
+        super().set_transforms_serialized(data, authority)
+        self._call_new_data_callbacks()
+
+    def set_transforms_static_serialized(self, data: bytes, authority: str) -> None:
+        """
+        Insert the static transforms of a serialized TFMessage, as received by a raw subscription.
+
+        :param data: The serialized tf2_msgs/TFMessage.
+        :param authority: The source of the transforms.
+        """
+        super().set_transforms_static_serialized(data, authority)
+        self._call_new_data_callbacks()
+
     def _call_new_data_callbacks(self) -> None:
         with self._callbacks_lock:
             for callback in self._new_data_callbacks:
@@ -196,6 +247,35 @@ class Buffer(tf2.BufferCore, tf2_ros.BufferInterface):
         await self.wait_for_transform_full_async(target_frame, target_time, source_frame, source_time, fixed_frame)
         return self.lookup_transform_full_core(target_frame, target_time, source_frame, source_time, fixed_frame)
 
+    def lookup_velocity(
+        self,
+        tracking_frame: str,
+        observation_frame: str,
+        time: Time,
+        averaging_interval: Duration,
+        timeout: Duration = Duration()
+    ) -> TwistStamped:
+        """
+        Get the velocity of one frame relative to another.
+
+        :param tracking_frame: Name of the frame whose motion is tracked.
+        :param observation_frame: Name of the frame the motion is observed from and expressed in.
+        :param time: The time at which to get the velocity (0 will get the latest).
+        :param averaging_interval: The span the poses are differenced over, centered on time.
+        :param timeout: Time to wait for the frames to become available.
+        :return: The linear and angular velocity of tracking_frame in observation_frame.
+        """
+        self.can_transform(observation_frame, tracking_frame, time, timeout)
+        linear, angular, (sec, nanosec) = self.lookup_velocity_core(
+            tracking_frame, observation_frame, time, averaging_interval)
+        twist = TwistStamped()
+        twist.header.frame_id = observation_frame
+        twist.header.stamp.sec = sec
+        twist.header.stamp.nanosec = nanosec
+        twist.twist.linear.x, twist.twist.linear.y, twist.twist.linear.z = linear
+        twist.twist.angular.x, twist.twist.angular.y, twist.twist.angular.z = angular
+        return twist
+
     def can_transform(
         self,
         target_frame: str,
@@ -214,17 +294,8 @@ class Buffer(tf2.BufferCore, tf2_ros.BufferInterface):
         :param return_debug_type: If true, return a tuple representing debug information.
         :return: True if the transform is possible, false otherwise.
         """
-        clock = rclpy.clock.Clock()
         if timeout != Duration():
-            start_time = clock.now()
-            while (clock.now() < start_time + timeout and
-                   not self.can_transform_core(target_frame, source_frame, time)[0] and
-                   (clock.now() + Duration(seconds=3.0)) >= start_time): # big jumps in time are likely bag loops, so break for them
-                # TODO(Anyone): We can't use Rate here because it would never expire
-                # with a single-threaded executor.
-                # See https://github.com/ros2/geometry2/issues/327 for ideas on
-                # how to timeout waiting for transforms that don't block the executor.
-                sleep(0.02)
+            self._wait_for_transformable([(target_frame, source_frame, time)], timeout)
 
         core_result = self.can_transform_core(target_frame, source_frame, time)
         if return_debug_tuple:
@@ -255,22 +326,71 @@ class Buffer(tf2.BufferCore, tf2_ros.BufferInterface):
         :param return_debug_type: If true, return a tuple representing debug information.
         :return: True if the transform is possible, false otherwise.
         """
-        clock = rclpy.clock.Clock()
         if timeout != Duration():
-            start_time = clock.now()
-            while (clock.now() < start_time + timeout and
-                   not self.can_transform_full_core(target_frame, target_time, source_frame, source_time, fixed_frame)[0] and
-                   (clock.now() + Duration(seconds=3.0)) >= start_time): # big jumps in time are likely bag loops, so break for them
-                # TODO(Anyone): We can't use Rate here because it would never expire
-                # with a single-threaded executor.
-                # See https://github.com/ros2/geometry2/issues/327 for ideas on
-                # how to timeout waiting for transforms that don't block the executor.
-                sleep(0.02)
+            self._wait_for_transformable(
+                [(fixed_frame, target_frame, target_time), (fixed_frame, source_frame, source_time)],
+                timeout)
         core_result = self.can_transform_full_core(target_frame, target_time, source_frame, source_time, fixed_frame)
         if return_debug_tuple:
             return core_result
         return core_result[0]
 
+    def _wait_for_transformable(
+        self,
+        requests: List[Tuple[str, str, Time]],
+        timeout: Duration
+    ) -> None:
+        """
+        Block until all of the requested transforms are available or timeout passes.
+
+        The thread sleeps until BufferCore reports that the requests were answered, the timeout
+        passes, or the clock jumps. The core is not polled.
+
+        :param requests: The (target_frame, source_frame, time) of each transform to wait for.
+        :param timeout: Time to wait, measured on the clock of the buffer.
+        """
+        wake_up = threading.Event()
+        fut = rclpy.task.Future()
+        fut.add_done_callback(lambda _: wake_up.set())
+        self._add_transformable_request(fut, requests)
+        if fut.done():
+            return
+
+        clock = self._clock
+        jump_handle = None
+        if clock.clock_type == ClockType.ROS_TIME:
+            # With simulated time the deadline is only reached as /clock advances, so wake up
+            # whenever it moves to recheck it
+            jump_handle = clock.create_jump_callback(
+                JumpThreshold(
+                    min_forward=Duration(nanoseconds=1),
+                    min_backward=Duration(nanoseconds=-1),
+                    on_clock_change=True),
+                post_callback=lambda _: wake_up.set())
+        try:
+            start_time = clock.now()
+            deadline = start_time + timeout
+            # TODO(Anyone): This still blocks the calling thread, so with a single-threaded
+            # executor nothing sets new data until it times out.
+            # See https://github.com/ros2/geometry2/issues/327 for ideas on
+            # how to timeout waiting for transforms that don't block the executor.
+            while True:
+                # Clear before checking, so a wake up that arrives meanwhile is not lost
+                wake_up.clear()
+                if fut.done():
+                    break
+                now = clock.now()
+                # big jumps back in time are likely bag loops, so break for them
+                if now >= deadline or now + Duration(seconds=3.0) < start_time:
+                    break
+                wake_up.wait((deadline - now).nanoseconds / 1e9)
+        finally:
+            if jump_handle is not None:
+                jump_handle.unregister()
+            if not fut.done():
+                # Drops the requests that have not been answered
+                fut.cancel()
+
     def wait_for_transform_async(
         self,
         target_frame: str,
@@ -286,21 +406,7 @@ class Buffer(tf2.BufferCore, tf2_ros.BufferInterface):
         :return: A future that becomes true when the transform is available.
         """
         fut = rclpy.task.Future()
-        if self.can_transform_core(target_frame, source_frame, time)[0]:
-            # Short cut, the transform is available
-            fut.set_result(True)
-            return fut
-
-        def _on_new_data():
-            try:
-                if self.can_transform_core(target_frame, source_frame, time)[0]:
-                    fut.set_result(True)
-            except BaseException as e:
-                fut.set_exception(e)
-
-        self._new_data_callbacks.append(_on_new_data)
-        fut.add_done_callback(lambda _: self._remove_callback(_on_new_data))
-
+        self._add_transformable_request(fut, [(target_frame, source_frame, time)])
         return fut
 
     def wait_for_transform_full_async(
@@ -322,19 +428,68 @@ class Buffer(tf2.BufferCore, tf2_ros.BufferInterface):
         :return: A future that becomes true when the transform is available.
         """
         fut = rclpy.task.Future()
-        if self.can_transform_full_core(target_frame, target_time, source_frame, source_time, fixed_frame)[0]:
-            # Short cut, the transform is available
-            fut.set_result(True)
-            return fut
+        # The full transform is available once both frames can be transformed into the fixed frame
+        # at their own times.
+        self._add_transformable_request(
+            fut, [(fixed_frame, target_frame, target_time), (fixed_frame, source_frame, source_time)])
+        return fut
 
-        def _on_new_data():
-            try:
-                if self.can_transform_full_core(target_frame, target_time, source_frame, source_time, fixed_frame)[0]:
-                    fut.set_result(True)
-            except BaseException as e:
-                fut.set_exception(e)
+    def _add_transformable_request(
+        self,
+        fut: Future,
+        requests: List[Tuple[str, str, Time]]
+    ) -> None:
+        """
+        Complete a future once all of the requested transforms are available.
 
-        self._new_data_callbacks.append(_on_new_data)
-        fut.add_done_callback(lambda _: self._remove_callback(_on_new_data))
+        The requests are tracked by BufferCore, which calls back only when the frames of a request
+        receive new data, so waiting futures cost nothing on unrelated transforms.
 
-        return fut
+        :param fut: The future to set to True, or to a LookupException if a request can never be
+            satisfied.
+        :param requests: The (target_frame, source_frame, time) of each transform to wait for.
+        """
+        lock = threading.Lock()
+        pending = {}
+
+        def _on_transformable(key, available):
+            with lock:
+                if key not in pending or fut.done():
+                    return
+                del pending[key]
+                finished = available and not pending
+            # BufferCore calls back without holding its locks, so the done callbacks of the future
+            # may cancel the other requests right away
+            if not available:
+                target_frame, source_frame, _ = requests[key]
+                fut.set_exception(tf2.LookupException(
+                    'Failed to transform from {} to {}'.format(source_frame, target_frame)))
+            elif finished:
+                fut.set_result(True)
+
+        # Mark every request pending before adding any, so one that is already available can't
+        # finish the future while the others are still being added
+        with lock:
+            for key in range(len(requests)):
+                pending[key] = None
+        for key, (target_frame, source_frame, time) in enumerate(requests):
+            handle = self.add_transformable_request(
+                lambda available, key=key: _on_transformable(key, available),
+                target_frame, source_frame, time)
+            if handle == self._TRANSFORMABLE_NOW:
+                _on_transformable(key, True)
+            elif handle == self._TRANSFORMABLE_NEVER:
+                _on_transformable(key, False)
+            else:
+                with lock:
+                    if key in pending:
+                        pending[key] = handle
+
+        def _cancel(_):
+            with lock:
+                handles = [handle for handle in pending.values() if handle is not None]
+                pending.clear()
+            for handle in handles:
+                self.cancel_transformable_request(handle)
+
+        fut.add_done_callback(_cancel)
@@ -82,10 +82,13 @@ class TransformListener:
         # Default callback group is mutually exclusive, which would prevent waiting for transforms
         # from another callback in the same group.
         self.group = ReentrantCallbackGroup()
+        # Subscribe to the serialized messages, so each TFMessage is decoded and inserted with a
+        # single call into C++ instead of building a Python object for every field.
         self.tf_sub = node.create_subscription(
-            TFMessage, '/tf', self.callback, qos, callback_group=self.group)
+            TFMessage, '/tf', self.serialized_callback, qos, callback_group=self.group, raw=True)
         self.tf_static_sub = node.create_subscription(
-            TFMessage, '/tf_static', self.static_callback, static_qos, callback_group=self.group)
+            TFMessage, '/tf_static', self.serialized_static_callback, static_qos,
+            callback_group=self.group, raw=True)
 
         if spin_thread:
             self.executor = SingleThreadedExecutor()
@@ -114,10 +117,16 @@ class TransformListener:
 
     def callback(self, data: TFMessage) -> None:
         who = 'default_authority'
-        for transform in data.transforms:
-            self.buffer.set_transform(transform, who)
+        self.buffer.set_transforms(data.transforms, who)
 
     def static_callback(self, data: TFMessage) -> None:
         who = 'default_authority'
-        for transform in data.transforms:
-            self.buffer.set_transform_static(transform, who)
+        self.buffer.set_transforms_static(data.transforms, who)
+
+    def serialized_callback(self, data: bytes) -> None:
+        who = 'default_authority'
+        self.buffer.set_transforms_serialized(data, who)
+
+    def serialized_static_callback(self, data: bytes) -> None:
+        who = 'default_authority'
+        self.buffer.set_transforms_static_serialized(data, who)
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TF2_SENSOR_MSGS__CUDA_H_
+#define TF2_SENSOR_MSGS__CUDA_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tf2_sensor_msgs/visibility_control.h"
+
+// Only available when tf2_sensor_msgs was built with TF2_SENSOR_MSGS_USE_CUDA, in the
+// tf2_sensor_msgs_cuda library.
+
+namespace tf2
+{
+namespace cuda
+{
+
+/** \brief Points stored as three consecutive float32 values, as in a PointCloud2 */
+struct PointArray
+{
+  /// Pointer to the x value of the first point, aligned to 4 bytes
+  uint8_t * x;
+  /// The number of points
+  size_t count;
+  /// The distance in bytes between two consecutive points, a multiple of 4
+  size_t point_step;
+};
+
+/** \brief Whether there is a CUDA device to transform points on */
+TF2_SENSOR_MSGS_PUBLIC
+bool available();
+
+/** \brief Transform points in place on the GPU
+ *
+ * The points are staged through a pinned host buffer that is kept from call to call. On devices
+ * that share memory with the CPU, like Jetson modules, the kernel works on that buffer directly
+ * instead of on a copy in device memory. Calls from several threads are serialized.
+ * \param points The points to transform
+ * \param matrix The transform as a row-major 3x4 matrix [R | t]
+ * \return False, with the points untouched, if there is no device, the points are not aligned
+ *   or a CUDA call failed
+ */
+TF2_SENSOR_MSGS_PUBLIC
+bool transformPoints(const PointArray & points, const float (&matrix)[12]);
+
+/** \brief Transform several arrays of points in place with one copy each way
+ *
+ * Like transformPoints(), but the arrays are staged together, so a batch of small clouds costs
+ * one round trip to the device instead of one per cloud.
+ */
+TF2_SENSOR_MSGS_PUBLIC
+bool transformPoints(const PointArray * arrays, size_t num_arrays, const float (&matrix)[12]);
+
+/** \brief Have tf2::doTransform() and tf2_ros::Buffer::transform() move PointCloud2s of packed
+ * float32 coordinates with at least min_points points to the GPU
+ *
+ * Smaller clouds, and any the GPU fails on, are still transformed on the CPU.
+ * \return False if there is no CUDA device, in which case nothing changes
+ */
+TF2_SENSOR_MSGS_PUBLIC
+bool enableOffload(size_t min_points = 1 << 16);
+
+/** \brief Transform every PointCloud2 on the CPU again */
+TF2_SENSOR_MSGS_PUBLIC
+void disableOffload();
+
+}  // namespace cuda
+}  // namespace tf2
+
+#endif  // TF2_SENSOR_MSGS__CUDA_H_
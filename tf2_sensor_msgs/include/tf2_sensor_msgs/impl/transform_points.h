@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TF2_SENSOR_MSGS__IMPL__TRANSFORM_POINTS_H_
+#define TF2_SENSOR_MSGS__IMPL__TRANSFORM_POINTS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TF2_SENSOR_MSGS_HAVE_AVX2_KERNEL
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TF2_SENSOR_MSGS_HAVE_NEON_KERNEL
+#endif
+
+namespace tf2
+{
+namespace impl
+{
+
+/** \brief A rigid transform as a row-major 3x4 matrix [R | t] in single precision */
+struct PointTransform
+{
+  float m[12];
+};
+
+/** \brief Transform points stored as three consecutive float32 values, one point at a time
+ * \param in Pointer to the x value of the first input point
+ * \param out Pointer to the x value of the first output point, which may be the same as in
+ * \param count The number of points
+ * \param point_step The distance in bytes between two consecutive points
+ * \param t The transform to apply
+ */
+inline
+void transformPointsScalar(
+  const uint8_t * in, uint8_t * out, size_t count, size_t point_step, const PointTransform & t)
+{
+  // Copied so the compiler doesn't reload them after every store through out
+  const PointTransform tc = t;
+  const float * m = tc.m;
+  for (size_t i = 0; i < count; ++i, in += point_step, out += point_step) {
+    float x, y, z;
+    std::memcpy(&x, in, sizeof(float));
+    std::memcpy(&y, in + sizeof(float), sizeof(float));
+    std::memcpy(&z, in + 2 * sizeof(float), sizeof(float));
+    const float qx = m[0] * x + m[1] * y + m[2] * z + m[3];
+    const float qy = m[4] * x + m[5] * y + m[6] * z + m[7];
+    const float qz = m[8] * x + m[9] * y + m[10] * z + m[11];
+    std::memcpy(out, &qx, sizeof(float));
+    std::memcpy(out + sizeof(float), &qy, sizeof(float));
+    std::memcpy(out + 2 * sizeof(float), &qz, sizeof(float));
+  }
+}
+
+#if defined(TF2_SENSOR_MSGS_HAVE_AVX2_KERNEL)
+
+/** \brief Store the first three lanes of q without touching the bytes that follow
+ *
+ * Two plain stores rather than a masked one, so loading the next point isn't stalled waiting
+ * for a store that overlaps it.
+ */
+__attribute__((target("avx2,fma")))
+inline
+void storeXYZ(uint8_t * out, __m128 q)
+{
+  _mm_storel_pi(reinterpret_cast<__m64 *>(out), q);
+  _mm_store_ss(reinterpret_cast<float *>(out + 2 * sizeof(float)), _mm_movehl_ps(q, q));
+}
+
+/** \brief AVX2 version of transformPointsScalar(), two points per iteration
+ *
+ * Every point is read as four floats, so 16 bytes must be readable from the x value of each
+ * point. Only the coordinates are written.
+ */
+__attribute__((target("avx2,fma")))
+inline
+void transformPointsAVX2(
+  const uint8_t * in, uint8_t * out, size_t count, size_t point_step, const PointTransform & t)
+{
+  const float * m = t.m;
+  // Columns of [R | t], duplicated into both 128 bit lanes, with 0 in the fourth slot
+  const __m256 c0 = _mm256_setr_ps(m[0], m[4], m[8], 0, m[0], m[4], m[8], 0);
+  const __m256 c1 = _mm256_setr_ps(m[1], m[5], m[9], 0, m[1], m[5], m[9], 0);
+  const __m256 c2 = _mm256_setr_ps(m[2], m[6], m[10], 0, m[2], m[6], m[10], 0);
+  const __m256 c3 = _mm256_setr_ps(m[3], m[7], m[11], 0, m[3], m[7], m[11], 0);
+
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2, in += 2 * point_step, out += 2 * point_step) {
+    const __m256 p = _mm256_insertf128_ps(
+      _mm256_castps128_ps256(_mm_loadu_ps(reinterpret_cast<const float *>(in))),
+      _mm_loadu_ps(reinterpret_cast<const float *>(in + point_step)), 1);
+    __m256 q = _mm256_fmadd_ps(c0, _mm256_permute_ps(p, 0x00), c3);
+    q = _mm256_fmadd_ps(c1, _mm256_permute_ps(p, 0x55), q);
+    q = _mm256_fmadd_ps(c2, _mm256_permute_ps(p, 0xAA), q);
+    storeXYZ(out, _mm256_castps256_ps128(q));
+    storeXYZ(out + point_step, _mm256_extractf128_ps(q, 1));
+  }
+  transformPointsScalar(in, out, count - i, point_step, t);
+}
+
+#elif defined(TF2_SENSOR_MSGS_HAVE_NEON_KERNEL)
+
+/** \brief NEON version of transformPointsScalar()
+ *
+ * Every point is read as four floats, so 16 bytes must be readable from the x value of each
+ * point. Only the coordinates are written.
+ */
+inline
+void transformPointsNEON(
+  const uint8_t * in, uint8_t * out, size_t count, size_t point_step, const PointTransform & t)
+{
+  const float * m = t.m;
+  const float c[4][4] = {
+    {m[0], m[4], m[8], 0}, {m[1], m[5], m[9], 0}, {m[2], m[6], m[10], 0}, {m[3], m[7], m[11], 0}};
+  const float32x4_t c0 = vld1q_f32(c[0]);
+  const float32x4_t c1 = vld1q_f32(c[1]);
+  const float32x4_t c2 = vld1q_f32(c[2]);
+  const float32x4_t c3 = vld1q_f32(c[3]);
+
+  for (size_t i = 0; i < count; ++i, in += point_step, out += point_step) {
+    const float32x4_t p = vld1q_f32(reinterpret_cast<const float *>(in));
+    float32x4_t q = vfmaq_laneq_f32(c3, c0, p, 0);
+    q = vfmaq_laneq_f32(q, c1, p, 1);
+    q = vfmaq_laneq_f32(q, c2, p, 2);
+    vst1_f32(reinterpret_cast<float *>(out), vget_low_f32(q));
+    vst1q_lane_f32(reinterpret_cast<float *>(out + 2 * sizeof(float)), q, 2);
+  }
+}
+
+#endif
+
+/** \brief Transform points stored as three consecutive float32 values with the fastest kernel
+ *
+ * Uses a vector kernel when the CPU supports one, and transformPointsScalar() otherwise.
+ * The vector kernels load four floats per point, so unless the points are wide enough to hold
+ * them, like the common xyz + intensity layout, the last point is left to the scalar kernel.
+ * Only the coordinates of `out` are written.
+ *
+ * \param in Pointer to the x value of the first input point
+ * \param out Pointer to the x value of the first output point, which may be the same as in
+ * \param count The number of points
+ * \param point_step The distance in bytes between two consecutive points
+ * \param x_offset The offset of the x value in a point, used to check how much of the point
+ *   follows it
+ * \param t The transform to apply
+ */
+inline
+void transformPoints(
+  const uint8_t * in, uint8_t * out, size_t count, size_t point_step, size_t x_offset,
+  const PointTransform & t)
+{
+  size_t vector_count = 0;
+#if defined(TF2_SENSOR_MSGS_HAVE_AVX2_KERNEL) || defined(TF2_SENSOR_MSGS_HAVE_NEON_KERNEL)
+  const bool wide_points = x_offset + 4 * sizeof(float) <= point_step;
+  vector_count = wide_points || count == 0 ? count : count - 1;
+#else
+  (void)x_offset;
+#endif
+#if defined(TF2_SENSOR_MSGS_HAVE_AVX2_KERNEL)
+  static const bool have_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  if (have_avx2) {
+    transformPointsAVX2(in, out, vector_count, point_step, t);
+  } else {
+    vector_count = 0;
+  }
+#elif defined(TF2_SENSOR_MSGS_HAVE_NEON_KERNEL)
+  transformPointsNEON(in, out, vector_count, point_step, t);
+#endif
+  transformPointsScalar(
+    in + vector_count * point_step, out + vector_count * point_step, count - vector_count,
+    point_step, t);
+}
+
+/** \brief Transforms points laid out as for transformPoints() in place somewhere other than the
+ * CPU, such as a GPU, returning false to leave them to the CPU kernels
+ * \param x Pointer to the x value of the first point
+ * \param count The number of points
+ * \param point_step The distance in bytes between two consecutive points
+ * \param t The transform to apply
+ */
+typedef bool (* PointTransformOffloadFunction)(
+  uint8_t * x, size_t count, size_t point_step, const PointTransform & t);
+
+/** \brief Where doTransform() hands large PointCloud2s off to */
+struct PointTransformOffload
+{
+  /// Called for clouds of packed float32 coordinates, nullptr to always use the CPU
+  std::atomic<PointTransformOffloadFunction> function{nullptr};
+  /// Clouds with fewer points than this stay on the CPU, where they are done sooner than the
+  /// copies to and from the device would be
+  std::atomic<size_t> min_points{0};
+};
+
+/** \brief The offload shared by every PointCloud2 transform in the process
+ *
+ * Empty unless something like tf2::cuda::enableOffload() installs a function.
+ */
+inline
+PointTransformOffload & pointTransformOffload()
+{
+  static PointTransformOffload offload;
+  return offload;
+}
+
+}  // namespace impl
+}  // namespace tf2
+
+#endif  // TF2_SENSOR_MSGS__IMPL__TRANSFORM_POINTS_H_
@@ -31,12 +31,24 @@
 #define TF2_SENSOR_MSGS_H
 
 #include <tf2/convert.h>
+#include <tf2/thread_pool.h>
 #include <tf2/time.h>
+#include <sensor_msgs/msg/laser_scan.hpp>
 #include <sensor_msgs/msg/point_cloud2.hpp>
 #include <sensor_msgs/point_cloud2_iterator.hpp>
 #include <Eigen/Eigen>
 #include <Eigen/Geometry>
 #include <tf2_ros/buffer_interface.h>
+#include <tf2_sensor_msgs/impl/transform_points.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace tf2
 {
@@ -55,34 +67,709 @@ template <>
 inline
 std::string getFrameId(const sensor_msgs::msg::PointCloud2 &p) {return p.header.frame_id;}
 
+namespace impl
+{
+
+/** \brief Find the x, y and z fields if they are float32 values stored next to each other
+ * \param p The cloud to inspect
+ * \param x_offset Set to the offset of the x field within a point when found
+ * \return True if the points can be handed to transformPoints()
+ */
+inline
+bool findPackedXYZ(const sensor_msgs::msg::PointCloud2 & p, size_t & x_offset)
+{
+  static const char * const names[3] = {"x", "y", "z"};
+  const sensor_msgs::msg::PointField * fields[3] = {nullptr, nullptr, nullptr};
+  for (const auto & field : p.fields) {
+    for (size_t i = 0; i < 3; ++i) {
+      if (field.name == names[i]) {
+        fields[i] = &field;
+      }
+    }
+  }
+  for (size_t i = 0; i < 3; ++i) {
+    if (!fields[i] || fields[i]->datatype != sensor_msgs::msg::PointField::FLOAT32 ||
+      fields[i]->count != 1 || fields[i]->offset != fields[0]->offset + i * sizeof(float))
+    {
+      return false;
+    }
+  }
+  x_offset = fields[0]->offset;
+  return p.point_step > 0 && x_offset + 3 * sizeof(float) <= p.point_step;
+}
+
+/** \brief Convert a TransformStamped into the single precision form points are transformed with */
+inline
+Eigen::Transform<float,3,Eigen::Affine> toAffine(const geometry_msgs::msg::TransformStamped& t_in)
+{
+  return Eigen::Translation3f(t_in.transform.translation.x, t_in.transform.translation.y,
+                              t_in.transform.translation.z) * Eigen::Quaternion<float>(
+                                t_in.transform.rotation.w, t_in.transform.rotation.x,
+                                t_in.transform.rotation.y, t_in.transform.rotation.z);
+}
+
+/** \brief Copy an affine transform into the matrix form used by transformPoints() */
+inline
+PointTransform toPointTransform(const Eigen::Transform<float, 3, Eigen::Affine> & t)
+{
+  PointTransform m;
+  for (int row = 0; row < 3; ++row) {
+    for (int col = 0; col < 4; ++col) {
+      m.m[row * 4 + col] = t(row, col);
+    }
+  }
+  return m;
+}
+
+}  // namespace impl
+
+namespace impl
+{
+
+/** \brief Transform the cloud in place, splitting packed clouds across pool if there is one */
+inline
+void transformCloud(sensor_msgs::msg::PointCloud2 &p, const geometry_msgs::msg::TransformStamped& t_in, tf2::ThreadPool * pool)
+{
+  p.header = t_in.header;
+  const Eigen::Transform<float,3,Eigen::Affine> t = toAffine(t_in);
+
+  // Clouds with packed float32 coordinates, which is nearly all of them, go through the
+  // vectorized kernel instead of three field iterators
+  size_t x_offset;
+  if (findPackedXYZ(p, x_offset)) {
+    const size_t point_step = p.point_step;
+    const size_t num_points = p.data.size() / point_step;
+    if (num_points == 0) {
+      return;
+    }
+    uint8_t * data = p.data.data() + x_offset;
+    const PointTransform m = toPointTransform(t);
+    const PointTransformOffload & offload = pointTransformOffload();
+    const PointTransformOffloadFunction offload_function = offload.function.load();
+    if (offload_function && num_points >= offload.min_points.load() &&
+      offload_function(data, num_points, point_step, m))
+    {
+      return;
+    }
+    auto transform_range = [data, point_step, x_offset, &m](size_t begin, size_t end) {
+        transformPoints(
+          data + begin * point_step, data + begin * point_step, end - begin, point_step, x_offset, m);
+      };
+    if (pool) {
+      // Each range only writes its own points, so the result doesn't depend on the split
+      pool->parallelFor(num_points, 1 << 14, transform_range);
+    } else {
+      transform_range(0, num_points);
+    }
+    return;
+  }
+
+  sensor_msgs::PointCloud2Iterator<float> x(p, std::string("x"));
+  sensor_msgs::PointCloud2Iterator<float> y(p, std::string("y"));
+  sensor_msgs::PointCloud2Iterator<float> z(p, std::string("z"));
+
+  Eigen::Vector3f point;
+  for(; x != x.end(); ++x, ++y, ++z) {
+    point = t * Eigen::Vector3f(*x, *y, *z);
+    *x = point.x();
+    *y = point.y();
+    *z = point.z();
+  }
+}
+
+}  // namespace impl
+
+// transforms the cloud in place, without copying its data
+template <>
+inline
+void doTransform(sensor_msgs::msg::PointCloud2 &p, const geometry_msgs::msg::TransformStamped& t_in)
+{
+  impl::transformCloud(p, t_in, nullptr);
+}
+
+/** \brief Transform the cloud in place on the threads of pool as well as the calling one
+ *
+ * Clouds whose coordinates are not packed float32 values are transformed on the calling
+ * thread only.
+ */
+inline
+void doTransform(sensor_msgs::msg::PointCloud2 &p, const geometry_msgs::msg::TransformStamped& t_in, tf2::ThreadPool & pool)
+{
+  impl::transformCloud(p, t_in, &pool);
+}
+
+/** \brief Transform a copy of the cloud on the threads of pool as well as the calling one */
+inline
+void doTransform(const sensor_msgs::msg::PointCloud2 &p_in, sensor_msgs::msg::PointCloud2 &p_out, const geometry_msgs::msg::TransformStamped& t_in, tf2::ThreadPool & pool)
+{
+  p_out = p_in;
+  impl::transformCloud(p_out, t_in, &pool);
+}
+
 // this method needs to be implemented by client library developers
 template <>
 inline
 void doTransform(const sensor_msgs::msg::PointCloud2 &p_in, sensor_msgs::msg::PointCloud2 &p_out, const geometry_msgs::msg::TransformStamped& t_in)
 {
   p_out = p_in;
-  p_out.header = t_in.header;
-  Eigen::Transform<float,3,Eigen::Affine> t = Eigen::Translation3f(t_in.transform.translation.x, t_in.transform.translation.y,
-                                                                   t_in.transform.translation.z) * Eigen::Quaternion<float>(
-                                                                     t_in.transform.rotation.w, t_in.transform.rotation.x,
-                                                                     t_in.transform.rotation.y, t_in.transform.rotation.z);
+  doTransform(p_out, t_in);
+}
 
-  sensor_msgs::PointCloud2ConstIterator<float> x_in(p_in, std::string("x"));
-  sensor_msgs::PointCloud2ConstIterator<float> y_in(p_in, std::string("y"));
-  sensor_msgs::PointCloud2ConstIterator<float> z_in(p_in, std::string("z"));
+/** \brief The fields of a PointCloud2 that PointCloud2Transformer transforms, as triples of
+ * float32 field names
+ */
+struct CloudVectorFields
+{
+  /// Fields holding positions, which are rotated and translated
+  std::vector<std::array<std::string, 3>> positions{{{"x", "y", "z"}}};
+  /// Fields holding directions, such as normals, which are only rotated
+  std::vector<std::array<std::string, 3>> directions{{{"normal_x", "normal_y", "normal_z"}}};
+};
 
-  sensor_msgs::PointCloud2Iterator<float> x_out(p_out, std::string("x"));
-  sensor_msgs::PointCloud2Iterator<float> y_out(p_out, std::string("y"));
-  sensor_msgs::PointCloud2Iterator<float> z_out(p_out, std::string("z"));
+namespace impl
+{
 
-  Eigen::Vector3f point;
-  for(; x_in != x_in.end(); ++x_in, ++y_in, ++z_in, ++x_out, ++y_out, ++z_out) {
-    point = t * Eigen::Vector3f(*x_in, *y_in, *z_in);
-    *x_out = point.x();
-    *y_out = point.y();
-    *z_out = point.z();
+/** \brief Transform a triple of float32 fields that aren't stored next to each other */
+inline
+void transformFieldsScalar(
+  uint8_t * points, size_t count, size_t point_step, const size_t (&offsets)[3],
+  const PointTransform & t)
+{
+  const PointTransform tc = t;
+  const float * m = tc.m;
+  for (size_t i = 0; i < count; ++i, points += point_step) {
+    float p[3];
+    for (size_t j = 0; j < 3; ++j) {
+      std::memcpy(&p[j], points + offsets[j], sizeof(float));
+    }
+    for (size_t j = 0; j < 3; ++j) {
+      const float q = m[j * 4] * p[0] + m[j * 4 + 1] * p[1] + m[j * 4 + 2] * p[2] + m[j * 4 + 3];
+      std::memcpy(points + offsets[j], &q, sizeof(float));
+    }
+  }
+}
+
+}  // namespace impl
+
+/** \brief Transforms the positions and directions of PointCloud2s in a single pass
+ *
+ * doTransform() only moves x, y and z, leaving normals and other vectors in the frame the
+ * cloud came from. This transforms every field triple listed in a CloudVectorFields: position
+ * triples are rotated and translated, direction triples only rotated. The cloud is walked in
+ * blocks small enough to stay in the L1 cache while each triple goes through the vectorized
+ * kernel, so the point data is only streamed from memory once.
+ *
+ * Where the triples sit in a point is worked out once per cloud layout and reused for as long
+ * as the fields and point_step of the clouds stay the same, so keep one transformer per
+ * stream of clouds. Triples whose fields are all missing from a cloud are skipped.
+ */
+class PointCloud2Transformer
+{
+public:
+  explicit PointCloud2Transformer(CloudVectorFields fields = CloudVectorFields())
+  : fields_(std::move(fields))
+  {
+  }
+
+  /** \brief Transform cloud in place, giving it the header of t
+   * \throws tf2::InvalidArgumentException if only some fields of a triple are in the cloud, or
+   *   any of them isn't a single float32 value
+   */
+  void transform(
+    sensor_msgs::msg::PointCloud2 & cloud, const geometry_msgs::msg::TransformStamped & t)
+  {
+    updateLayout(cloud);
+    cloud.header = t.header;
+    const size_t point_step = cloud.point_step;
+    const size_t num_points = point_step ? cloud.data.size() / point_step : 0;
+    if (num_points == 0 || groups_.empty()) {
+      return;
+    }
+    const impl::PointTransform position = impl::toPointTransform(impl::toAffine(t));
+    impl::PointTransform direction = position;
+    direction.m[3] = direction.m[7] = direction.m[11] = 0.0f;
+
+    const size_t block_size = std::max<size_t>(1, 16384 / point_step);
+    for (size_t begin = 0; begin < num_points; begin += block_size) {
+      const size_t count = std::min(block_size, num_points - begin);
+      uint8_t * points = cloud.data.data() + begin * point_step;
+      for (const Group & group : groups_) {
+        const impl::PointTransform & m = group.direction ? direction : position;
+        if (group.packed) {
+          uint8_t * x = points + group.offsets[0];
+          impl::transformPoints(x, x, count, point_step, group.offsets[0], m);
+        } else {
+          impl::transformFieldsScalar(points, count, point_step, group.offsets, m);
+        }
+      }
+    }
+  }
+
+private:
+  struct Group
+  {
+    size_t offsets[3];
+    bool packed;
+    bool direction;
+  };
+
+  void updateLayout(const sensor_msgs::msg::PointCloud2 & cloud)
+  {
+    if (layout_valid_ && cloud.point_step == point_step_ && cloud.fields == schema_) {
+      return;
+    }
+    layout_valid_ = false;
+    groups_.clear();
+    addGroups(cloud, fields_.positions, false);
+    addGroups(cloud, fields_.directions, true);
+    schema_ = cloud.fields;
+    point_step_ = cloud.point_step;
+    layout_valid_ = true;
+  }
+
+  void addGroups(
+    const sensor_msgs::msg::PointCloud2 & cloud,
+    const std::vector<std::array<std::string, 3>> & triples, bool direction)
+  {
+    for (const auto & names : triples) {
+      const sensor_msgs::msg::PointField * fields[3] = {nullptr, nullptr, nullptr};
+      for (const auto & field : cloud.fields) {
+        for (size_t i = 0; i < 3; ++i) {
+          if (field.name == names[i]) {
+            fields[i] = &field;
+          }
+        }
+      }
+      if (!fields[0] && !fields[1] && !fields[2]) {
+        continue;
+      }
+      Group group;
+      for (size_t i = 0; i < 3; ++i) {
+        if (!fields[i] || fields[i]->datatype != sensor_msgs::msg::PointField::FLOAT32 ||
+          fields[i]->count != 1 || fields[i]->offset + sizeof(float) > cloud.point_step)
+        {
+          throw tf2::InvalidArgumentException(
+                  "PointCloud2 fields " + names[0] + ", " + names[1] + " and " + names[2] +
+                  " must all be single float32 values");
+        }
+        group.offsets[i] = fields[i]->offset;
+      }
+      group.packed = group.offsets[1] == group.offsets[0] + sizeof(float) &&
+        group.offsets[2] == group.offsets[0] + 2 * sizeof(float);
+      group.direction = direction;
+      groups_.push_back(group);
+    }
+  }
+
+  CloudVectorFields fields_;
+  std::vector<Group> groups_;
+  std::vector<sensor_msgs::msg::PointField> schema_;
+  uint32_t point_step_ = 0;
+  bool layout_valid_ = false;
+};
+
+/** \brief How deskew() reads the time of each point */
+struct DeskewOptions
+{
+  /// The per point time field, empty for the first of "t", "time" and "timestamp" in the cloud
+  std::string time_field;
+  /// Seconds per unit of the time field, 0 for nanoseconds in integer fields and seconds in
+  /// floating point ones
+  double time_scale = 0.0;
+  /// Whether the time field holds absolute times rather than offsets from header.stamp
+  bool absolute_time = false;
+  /// The scan is split into this many equal time slices, each transformed with the transform
+  /// at its middle
+  size_t num_slices = 64;
+};
+
+namespace impl
+{
+
+inline
+double readPointTime(const uint8_t * point, uint8_t datatype)
+{
+  switch (datatype) {
+    case sensor_msgs::msg::PointField::UINT32: {
+        uint32_t value;
+        std::memcpy(&value, point, sizeof(value));
+        return value;
+      }
+    case sensor_msgs::msg::PointField::INT32: {
+        int32_t value;
+        std::memcpy(&value, point, sizeof(value));
+        return value;
+      }
+    case sensor_msgs::msg::PointField::FLOAT32: {
+        float value;
+        std::memcpy(&value, point, sizeof(value));
+        return value;
+      }
+    default: {
+        double value;
+        std::memcpy(&value, point, sizeof(value));
+        return value;
+      }
+  }
+}
+
+}  // namespace impl
+
+/** \brief Transform every point of a spinning lidar scan with the transform at the time it was
+ * measured, so the motion of the sensor during the scan doesn't smear the cloud.
+ *
+ * The time span of the scan is split into DeskewOptions::num_slices slices, the transforms at
+ * their middles are looked up together with BufferInterface::lookupTransformsAtTimes(), and
+ * runs of points falling into the same slice are handed to the vectorized kernel. The cloud
+ * ends up in target_frame at target_time, as with the advanced transform API.
+ * \param buffer The buffer to look the transforms up in
+ * \param cloud The cloud to transform in place, in the frame of the sensor
+ * \param target_frame The frame to transform the points into
+ * \param target_time The time to transform the points to, typically the scan's header.stamp
+ * \param fixed_frame The frame in which to treat the transform as constant in time, such as odom
+ * \param timeout How long to wait for the transforms of the newest points
+ * \param options Where the time of each point is read from
+ * \throws tf2::InvalidArgumentException if the cloud doesn't have float32 coordinates or a
+ *   time field of a supported type, and the exceptions of lookupTransform() if the transforms
+ *   are not available
+ */
+inline
+void deskew(
+  const tf2_ros::BufferInterface & buffer, sensor_msgs::msg::PointCloud2 & cloud,
+  const std::string & target_frame, const tf2::TimePoint & target_time,
+  const std::string & fixed_frame, tf2::Duration timeout = tf2::Duration::zero(),
+  const DeskewOptions & options = DeskewOptions())
+{
+  const sensor_msgs::msg::PointField * time_field = nullptr;
+  const sensor_msgs::msg::PointField * xyz_fields[3] = {nullptr, nullptr, nullptr};
+  static const char * const xyz_names[3] = {"x", "y", "z"};
+  static const char * const time_names[3] = {"t", "time", "timestamp"};
+  size_t time_rank = 3;
+  for (const auto & field : cloud.fields) {
+    for (size_t i = 0; i < 3; ++i) {
+      if (field.name == xyz_names[i]) {
+        xyz_fields[i] = &field;
+      }
+      if (options.time_field.empty() && field.name == time_names[i] && i < time_rank) {
+        time_field = &field;
+        time_rank = i;
+      }
+    }
+    if (!options.time_field.empty() && field.name == options.time_field) {
+      time_field = &field;
+    }
+  }
+  for (const auto * field : xyz_fields) {
+    if (!field || field->datatype != sensor_msgs::msg::PointField::FLOAT32 ||
+      field->offset + sizeof(float) > cloud.point_step)
+    {
+      throw tf2::InvalidArgumentException("deskew needs float32 x, y and z fields");
+    }
+  }
+  if (!time_field || (time_field->datatype != sensor_msgs::msg::PointField::UINT32 &&
+    time_field->datatype != sensor_msgs::msg::PointField::INT32 &&
+    time_field->datatype != sensor_msgs::msg::PointField::FLOAT32 &&
+    time_field->datatype != sensor_msgs::msg::PointField::FLOAT64) ||
+    time_field->offset + (time_field->datatype == sensor_msgs::msg::PointField::FLOAT64 ?
+    sizeof(double) : sizeof(float)) > cloud.point_step)
+  {
+    throw tf2::InvalidArgumentException(
+      "deskew needs a per point time field of type uint32, int32, float32 or float64");
+  }
+  const bool integer_time = time_field->datatype == sensor_msgs::msg::PointField::UINT32 ||
+    time_field->datatype == sensor_msgs::msg::PointField::INT32;
+  const double time_scale =
+    options.time_scale > 0.0 ? options.time_scale : (integer_time ? 1e-9 : 1.0);
+
+  const std::string source_frame = cloud.header.frame_id;
+  const tf2::TimePoint time_base =
+    options.absolute_time ? tf2::TimePoint() : tf2_ros::fromMsg(cloud.header.stamp);
+  const size_t point_step = cloud.point_step;
+  const size_t num_points = point_step ? cloud.data.size() / point_step : 0;
+  cloud.header.frame_id = target_frame;
+  cloud.header.stamp = tf2_ros::toMsg(target_time);
+  if (num_points == 0) {
+    return;
+  }
+
+  // Point times in seconds, relative to the stamp unless they are absolute
+  std::vector<double> times(num_points);
+  double first = std::numeric_limits<double>::infinity();
+  double last = -first;
+  for (size_t i = 0; i < num_points; ++i) {
+    times[i] = time_scale * impl::readPointTime(
+      cloud.data.data() + i * point_step + time_field->offset, time_field->datatype);
+    if (std::isfinite(times[i])) {
+      first = std::min(first, times[i]);
+      last = std::max(last, times[i]);
+    }
+  }
+  if (first > last) {
+    first = last = 0.0;
+  }
+
+  const size_t num_slices = last > first ? std::max<size_t>(options.num_slices, 1) : 1;
+  const double slice_width = (last - first) / num_slices;
+  std::vector<tf2::TimePoint> slice_times(num_slices);
+  for (size_t k = 0; k < num_slices; ++k) {
+    slice_times[k] = time_base + tf2::durationFromSec(first + (k + 0.5) * slice_width);
+  }
+  std::vector<geometry_msgs::msg::TransformStamped> transforms = buffer.lookupTransformsAtTimes(
+    target_frame, target_time, source_frame, slice_times, fixed_frame, timeout);
+  std::vector<impl::PointTransform> matrices(num_slices);
+  for (size_t k = 0; k < num_slices; ++k) {
+    matrices[k] = impl::toPointTransform(impl::toAffine(transforms[k]));
+  }
+
+  auto slice_of = [first, slice_width, num_slices](double time) -> size_t {
+      if (!(time > first) || slice_width <= 0.0) {
+        return 0;
+      }
+      return std::min(static_cast<size_t>((time - first) / slice_width), num_slices - 1);
+    };
+
+  size_t x_offset;
+  const bool packed = impl::findPackedXYZ(cloud, x_offset);
+  uint8_t * data = cloud.data.data();
+  for (size_t begin = 0; begin < num_points; ) {
+    // Lidars emit points in time order, so runs in the same slice are long
+    const size_t slice = slice_of(times[begin]);
+    size_t end = begin + 1;
+    while (end < num_points && slice_of(times[end]) == slice) {
+      ++end;
+    }
+    const impl::PointTransform & m = matrices[slice];
+    if (packed) {
+      impl::transformPoints(
+        data + begin * point_step + x_offset, data + begin * point_step + x_offset, end - begin,
+        point_step, x_offset, m);
+    } else {
+      for (size_t i = begin; i < end; ++i) {
+        float p[3];
+        for (size_t j = 0; j < 3; ++j) {
+          std::memcpy(&p[j], data + i * point_step + xyz_fields[j]->offset, sizeof(float));
+        }
+        for (size_t j = 0; j < 3; ++j) {
+          const float q = m.m[j * 4] * p[0] + m.m[j * 4 + 1] * p[1] + m.m[j * 4 + 2] * p[2] +
+            m.m[j * 4 + 3];
+          std::memcpy(data + i * point_step + xyz_fields[j]->offset, &q, sizeof(float));
+        }
+      }
+    }
+    begin = end;
+  }
+}
+
+/********************/
+/** LaserScan      **/
+/********************/
+
+/** \brief Caches the direction of every beam of a LaserScan configuration
+ *
+ * Keep one per laser and pass it to every call of transformLaserScan(), so the sines and
+ * cosines are only computed again when angle_min, angle_increment or the number of beams
+ * change.
+ */
+class LaserScanProjection
+{
+public:
+  /** \brief Make the tables match scan, recomputing them only if its configuration changed */
+  void update(const sensor_msgs::msg::LaserScan & scan)
+  {
+    if (scan.ranges.size() == cos_.size() && scan.angle_min == angle_min_ &&
+      scan.angle_increment == angle_increment_)
+    {
+      return;
+    }
+    angle_min_ = scan.angle_min;
+    angle_increment_ = scan.angle_increment;
+    cos_.resize(scan.ranges.size());
+    sin_.resize(scan.ranges.size());
+    for (size_t i = 0; i < scan.ranges.size(); ++i) {
+      const double angle =
+        static_cast<double>(angle_min_) + i * static_cast<double>(angle_increment_);
+      cos_[i] = static_cast<float>(std::cos(angle));
+      sin_[i] = static_cast<float>(std::sin(angle));
+    }
+  }
+
+  /// The cosine of the angle of each beam
+  const std::vector<float> & cos() const {return cos_;}
+  /// The sine of the angle of each beam
+  const std::vector<float> & sin() const {return sin_;}
+
+private:
+  std::vector<float> cos_;
+  std::vector<float> sin_;
+  float angle_min_ = 0.0f;
+  float angle_increment_ = 0.0f;
+};
+
+namespace impl
+{
+
+/** \brief Set up cloud to hold up to num_points x, y, z, intensity points
+ *
+ * The fields are only rebuilt if they don't match already, so a cloud reused from scan to scan
+ * doesn't allocate again.
+ */
+inline
+void prepareScanCloud(sensor_msgs::msg::PointCloud2 & cloud, size_t num_points)
+{
+  static const char * const names[4] = {"x", "y", "z", "intensity"};
+  bool fields_match = cloud.fields.size() == 4;
+  for (size_t i = 0; fields_match && i < 4; ++i) {
+    const sensor_msgs::msg::PointField & field = cloud.fields[i];
+    fields_match = field.name == names[i] && field.offset == i * sizeof(float) &&
+      field.datatype == sensor_msgs::msg::PointField::FLOAT32 && field.count == 1;
+  }
+  if (!fields_match) {
+    cloud.fields.resize(4);
+    for (size_t i = 0; i < 4; ++i) {
+      cloud.fields[i].name = names[i];
+      cloud.fields[i].offset = static_cast<uint32_t>(i * sizeof(float));
+      cloud.fields[i].datatype = sensor_msgs::msg::PointField::FLOAT32;
+      cloud.fields[i].count = 1;
+    }
+  }
+  cloud.is_bigendian = false;
+  cloud.is_dense = true;
+  cloud.point_step = 4 * sizeof(float);
+  cloud.data.resize(num_points * cloud.point_step);
+}
+
+/** \brief Project beams [begin, end) of scan, transform them with m and append them to out
+ *
+ * Beams whose range is outside [range_min, range_max], or not a number, are skipped.
+ * \return The number of points written, each 16 bytes long
+ */
+inline
+size_t projectScan(
+  const sensor_msgs::msg::LaserScan & scan, const LaserScanProjection & projection,
+  size_t begin, size_t end, const PointTransform & t, uint8_t * out)
+{
+  const PointTransform tc = t;
+  const float * m = tc.m;
+  const float * cos_table = projection.cos().data();
+  const float * sin_table = projection.sin().data();
+  const float range_min = scan.range_min;
+  const float range_max = scan.range_max;
+  const size_t num_intensities = scan.intensities.size();
+  size_t count = 0;
+  for (size_t i = begin; i < end; ++i) {
+    const float range = scan.ranges[i];
+    if (!(range >= range_min && range <= range_max)) {
+      continue;
+    }
+    const float x = range * cos_table[i];
+    const float y = range * sin_table[i];
+    const float p[4] = {
+      m[0] * x + m[1] * y + m[3],
+      m[4] * x + m[5] * y + m[7],
+      m[8] * x + m[9] * y + m[11],
+      i < num_intensities ? scan.intensities[i] : 0.0f};
+    std::memcpy(out + count * sizeof(p), p, sizeof(p));
+    ++count;
+  }
+  return count;
+}
+
+/** \brief Fill in the size and header of a cloud written by projectScan() */
+inline
+void finishScanCloud(
+  sensor_msgs::msg::PointCloud2 & cloud, size_t num_points, const std::string & frame_id,
+  const builtin_interfaces::msg::Time & stamp)
+{
+  cloud.data.resize(num_points * cloud.point_step);
+  cloud.height = 1;
+  cloud.width = static_cast<uint32_t>(num_points);
+  cloud.row_step = static_cast<uint32_t>(num_points * cloud.point_step);
+  cloud.header.frame_id = frame_id;
+  cloud.header.stamp = stamp;
+}
+
+}  // namespace impl
+
+/** \brief Project a LaserScan into a PointCloud2 and transform it in a single pass
+ *
+ * This does what building a cloud with laser_geometry and then calling doTransform() on it
+ * does, without the intermediate cloud. The points are written straight into cloud, whose buffer
+ * is reused when the cloud is passed in again for the next scan. The cloud has float32 x, y, z
+ * and intensity fields, with intensity 0 if the scan has none, and only holds the beams whose
+ * range is within [range_min, range_max].
+ * \param scan The scan to project
+ * \param cloud The cloud to write the transformed points to, ending up with the header of
+ *   the transform
+ * \param transform The transform from the frame of the scan to the target frame
+ * \param projection The cached beam directions of the laser, updated for scan if needed
+ */
+inline
+void transformLaserScan(
+  const sensor_msgs::msg::LaserScan & scan, sensor_msgs::msg::PointCloud2 & cloud,
+  const geometry_msgs::msg::TransformStamped & transform, LaserScanProjection & projection)
+{
+  projection.update(scan);
+  impl::prepareScanCloud(cloud, scan.ranges.size());
+  const size_t count = impl::projectScan(
+    scan, projection, 0, scan.ranges.size(), impl::toPointTransform(impl::toAffine(transform)),
+    cloud.data.data());
+  impl::finishScanCloud(cloud, count, transform.header.frame_id, transform.header.stamp);
+}
+
+/** \brief Project a LaserScan into a PointCloud2 in target_frame, correcting for the motion of
+ * the laser while it swept the scan
+ *
+ * Beam i of the scan was measured at header.stamp + i * time_increment. The beams are split
+ * into num_slices runs of equal length, the transforms at the middle of each run are looked up
+ * together with BufferInterface::lookupTransformsAtTimes(), and every run is projected with
+ * its own transform. The cloud ends up in target_frame at the stamp of the scan. Scans without
+ * a time_increment are projected with a single transform.
+ * \param buffer The buffer to look the transforms up in
+ * \param scan The scan to project
+ * \param cloud The cloud to write the transformed points to, laid out as for the other
+ *   overload
+ * \param target_frame The frame to transform the points into
+ * \param fixed_frame The frame in which to treat the transform as constant in time, such as odom
+ * \param projection The cached beam directions of the laser, updated for scan if needed
+ * \param timeout How long to wait for the transform of the last beam
+ * \param num_slices How many transforms to spread over the duration of the scan
+ * \throws The exceptions of lookupTransform() if the transforms are not available
+ */
+inline
+void transformLaserScan(
+  const tf2_ros::BufferInterface & buffer, const sensor_msgs::msg::LaserScan & scan,
+  sensor_msgs::msg::PointCloud2 & cloud, const std::string & target_frame,
+  const std::string & fixed_frame, LaserScanProjection & projection,
+  tf2::Duration timeout = tf2::Duration::zero(), size_t num_slices = 16)
+{
+  const size_t num_beams = scan.ranges.size();
+  if (scan.time_increment == 0.0f || num_beams < 2) {
+    num_slices = 1;
   }
+  num_slices = std::max<size_t>(std::min(num_slices, num_beams), 1);
+
+  const tf2::TimePoint stamp = tf2_ros::fromMsg(scan.header.stamp);
+  std::vector<tf2::TimePoint> slice_times(num_slices);
+  for (size_t k = 0; k < num_slices; ++k) {
+    const double middle_beam = (k + 0.5) * num_beams / num_slices;
+    slice_times[k] = stamp + tf2::durationFromSec(middle_beam * scan.time_increment);
+  }
+  const std::vector<geometry_msgs::msg::TransformStamped> transforms =
+    buffer.lookupTransformsAtTimes(
+    target_frame, stamp, scan.header.frame_id, slice_times, fixed_frame, timeout);
+
+  projection.update(scan);
+  impl::prepareScanCloud(cloud, num_beams);
+  size_t count = 0;
+  for (size_t k = 0; k < num_slices; ++k) {
+    count += impl::projectScan(
+      scan, projection, k * num_beams / num_slices, (k + 1) * num_beams / num_slices,
+      impl::toPointTransform(impl::toAffine(transforms[k])),
+      cloud.data.data() + count * cloud.point_step);
+  }
+  impl::finishScanCloud(cloud, count, target_frame, scan.header.stamp);
 }
+
 inline
 sensor_msgs::msg::PointCloud2 toMsg(const sensor_msgs::msg::PointCloud2 &in)
 {
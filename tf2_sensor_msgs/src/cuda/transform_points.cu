@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cuda_runtime.h>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#include "tf2_sensor_msgs/cuda.h"
+
+namespace tf2
+{
+namespace cuda
+{
+
+namespace
+{
+
+struct Matrix
+{
+  float m[12];
+};
+
+__global__ void transformPointsKernel(uint8_t * x, size_t count, size_t point_step, Matrix t)
+{
+  const size_t i = blockIdx.x * static_cast<size_t>(blockDim.x) + threadIdx.x;
+  if (i >= count) {
+    return;
+  }
+  float * p = reinterpret_cast<float *>(x + i * point_step);
+  const float px = p[0];
+  const float py = p[1];
+  const float pz = p[2];
+  p[0] = t.m[0] * px + t.m[1] * py + t.m[2] * pz + t.m[3];
+  p[1] = t.m[4] * px + t.m[5] * py + t.m[6] * pz + t.m[7];
+  p[2] = t.m[8] * px + t.m[9] * py + t.m[10] * pz + t.m[11];
+}
+
+/** \brief The stream and buffers kept between calls */
+class Context
+{
+public:
+  Context()
+  {
+    int device;
+    cudaDeviceProp properties;
+    if (cudaGetDevice(&device) != cudaSuccess ||
+      cudaGetDeviceProperties(&properties, device) != cudaSuccess ||
+      cudaStreamCreateWithFlags(&stream_, cudaStreamNonBlocking) != cudaSuccess)
+    {
+      cudaGetLastError();
+      return;
+    }
+    integrated_ = properties.integrated != 0;
+    valid_ = true;
+  }
+
+  ~Context()
+  {
+    if (host_) {
+      cudaFreeHost(host_);
+    }
+    if (device_ && !integrated_) {
+      cudaFree(device_);
+    }
+    if (valid_) {
+      cudaStreamDestroy(stream_);
+    }
+  }
+
+  bool valid() const {return valid_;}
+
+  bool transform(const PointArray * arrays, size_t num_arrays, const Matrix & t)
+  {
+    size_t bytes = 0;
+    for (size_t i = 0; i < num_arrays; ++i) {
+      const PointArray & a = arrays[i];
+      if (a.count == 0) {
+        continue;
+      }
+      if (reinterpret_cast<uintptr_t>(a.x) % sizeof(float) != 0 ||
+        a.point_step % sizeof(float) != 0 || a.point_step < 3 * sizeof(float))
+      {
+        return false;
+      }
+      bytes += span(a);
+    }
+    if (bytes == 0) {
+      return true;
+    }
+    if (!reserve(bytes)) {
+      return false;
+    }
+
+    size_t offset = 0;
+    for (size_t i = 0; i < num_arrays; ++i) {
+      if (arrays[i].count) {
+        std::memcpy(host_ + offset, arrays[i].x, span(arrays[i]));
+        offset += span(arrays[i]);
+      }
+    }
+    if (!integrated_ &&
+      cudaMemcpyAsync(device_, host_, bytes, cudaMemcpyHostToDevice, stream_) != cudaSuccess)
+    {
+      return fail();
+    }
+    offset = 0;
+    for (size_t i = 0; i < num_arrays; ++i) {
+      const PointArray & a = arrays[i];
+      if (a.count) {
+        const unsigned int threads = 256;
+        const unsigned int blocks = static_cast<unsigned int>((a.count + threads - 1) / threads);
+        transformPointsKernel<<<blocks, threads, 0, stream_>>>(
+          device_ + offset, a.count, a.point_step, t);
+        offset += span(a);
+      }
+    }
+    if (!integrated_ &&
+      cudaMemcpyAsync(host_, device_, bytes, cudaMemcpyDeviceToHost, stream_) != cudaSuccess)
+    {
+      return fail();
+    }
+    if (cudaStreamSynchronize(stream_) != cudaSuccess || cudaGetLastError() != cudaSuccess) {
+      return fail();
+    }
+    offset = 0;
+    for (size_t i = 0; i < num_arrays; ++i) {
+      if (arrays[i].count) {
+        std::memcpy(arrays[i].x, host_ + offset, span(arrays[i]));
+        offset += span(arrays[i]);
+      }
+    }
+    return true;
+  }
+
+private:
+  /// The bytes from the first x to the last z of a
+  static size_t span(const PointArray & a)
+  {
+    return (a.count - 1) * a.point_step + 3 * sizeof(float);
+  }
+
+  bool reserve(size_t bytes)
+  {
+    if (bytes <= capacity_) {
+      return true;
+    }
+    const size_t capacity = std::max(bytes, 2 * capacity_);
+    if (host_) {
+      cudaFreeHost(host_);
+      host_ = nullptr;
+    }
+    if (device_ && !integrated_) {
+      cudaFree(device_);
+    }
+    device_ = nullptr;
+    capacity_ = 0;
+    // Memory shared with the CPU is mapped into the device, so the kernel can use it in place
+    if (cudaHostAlloc(
+        reinterpret_cast<void **>(&host_), capacity,
+        integrated_ ? cudaHostAllocMapped : cudaHostAllocDefault) != cudaSuccess)
+    {
+      host_ = nullptr;
+      return fail();
+    }
+    const cudaError_t result = integrated_ ?
+      cudaHostGetDevicePointer(reinterpret_cast<void **>(&device_), host_, 0) :
+      cudaMalloc(reinterpret_cast<void **>(&device_), capacity);
+    if (result != cudaSuccess) {
+      device_ = nullptr;
+      return fail();
+    }
+    capacity_ = capacity;
+    return true;
+  }
+
+  bool fail()
+  {
+    // Clear the error so the next call can try again
+    cudaGetLastError();
+    return false;
+  }
+
+  bool valid_ = false;
+  bool integrated_ = false;
+  cudaStream_t stream_;
+  uint8_t * host_ = nullptr;
+  uint8_t * device_ = nullptr;
+  size_t capacity_ = 0;
+};
+
+std::mutex & contextMutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+
+Context & context()
+{
+  static Context context;
+  return context;
+}
+
+}  // namespace
+
+bool available()
+{
+  std::lock_guard<std::mutex> lock(contextMutex());
+  return context().valid();
+}
+
+bool transformPoints(const PointArray & points, const float (&matrix)[12])
+{
+  return transformPoints(&points, 1, matrix);
+}
+
+bool transformPoints(const PointArray * arrays, size_t num_arrays, const float (&matrix)[12])
+{
+  Matrix t;
+  std::copy(matrix, matrix + 12, t.m);
+  std::lock_guard<std::mutex> lock(contextMutex());
+  return context().valid() && context().transform(arrays, num_arrays, t);
+}
+
+}  // namespace cuda
+}  // namespace tf2
@@ -25,8 +25,8 @@
 # ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 # POSSIBILITY OF SUCH DAMAGE.
 
-from sensor_msgs.msg import PointCloud2
-from sensor_msgs.point_cloud2 import read_points, create_cloud
+from sensor_msgs.msg import PointCloud2, PointField
+import numpy
 import PyKDL
 import rospy
 import tf2_ros
@@ -48,13 +48,71 @@ def transform_to_kdl(t):
                                     t.transform.translation.y, 
                                     t.transform.translation.z))
 
-# PointStamped
+def transform_to_matrix(t):
+    """Return the rotation matrix and translation of a TransformStamped as NumPy arrays."""
+    q = t.transform.rotation
+    n = q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w
+    s = 2.0 / n if n > 0.0 else 0.0
+    xx, yy, zz = q.x * q.x * s, q.y * q.y * s, q.z * q.z * s
+    xy, xz, yz = q.x * q.y * s, q.x * q.z * s, q.y * q.z * s
+    wx, wy, wz = q.w * q.x * s, q.w * q.y * s, q.w * q.z * s
+    rotation = numpy.array([[1.0 - (yy + zz), xy - wz, xz + wy],
+                            [xy + wz, 1.0 - (xx + zz), yz - wx],
+                            [xz - wy, yz + wx, 1.0 - (xx + yy)]])
+    translation = numpy.array([t.transform.translation.x,
+                               t.transform.translation.y,
+                               t.transform.translation.z])
+    return rotation, translation
+
+_DATATYPES = {
+    PointField.INT8: 'i1',
+    PointField.UINT8: 'u1',
+    PointField.INT16: 'i2',
+    PointField.UINT16: 'u2',
+    PointField.INT32: 'i4',
+    PointField.UINT32: 'u4',
+    PointField.FLOAT32: 'f4',
+    PointField.FLOAT64: 'f8',
+}
+
+def xyz_view(cloud, data):
+    """Return a structured NumPy view of the x, y and z fields of cloud over data.
+
+    data is a writable uint8 array holding the cloud's data. The view has one element per
+    point, shaped height x width, and skips any padding at the end of each row.
+    """
+    fields = dict((f.name, f) for f in cloud.fields)
+    if not all(name in fields for name in ('x', 'y', 'z')):
+        raise ValueError('PointCloud2 has no x, y and z fields')
+    order = '>' if cloud.is_bigendian else '<'
+    dtype = numpy.dtype({
+        'names': ['x', 'y', 'z'],
+        'formats': [order + _DATATYPES[fields[name].datatype] for name in ('x', 'y', 'z')],
+        'offsets': [fields[name].offset for name in ('x', 'y', 'z')],
+        'itemsize': cloud.point_step})
+    return numpy.ndarray(shape=(cloud.height, cloud.width), dtype=dtype, buffer=data,
+                         strides=(cloud.row_step, cloud.point_step))
+
+# PointCloud2
 def do_transform_cloud(cloud, transform):
-    t_kdl = transform_to_kdl(transform)
-    points_out = []
-    for p_in in read_points(cloud):
-        p_out = t_kdl * PyKDL.Vector(p_in[0], p_in[1], p_in[2])
-        points_out.append(p_out)
-    res = create_cloud(transform.header, cloud.fields, points_out)
+    """Transform the points of a PointCloud2, keeping all of its other fields.
+
+    The x, y and z fields are read through a structured NumPy view of the data and moved with
+    a single matrix multiply, without building a Python object per point.
+    """
+    rotation, translation = transform_to_matrix(transform)
+    data = numpy.frombuffer(bytearray(cloud.data), dtype=numpy.uint8)
+    view = xyz_view(cloud, data)
+    points = numpy.stack([view['x'].astype(numpy.float64),
+                          view['y'].astype(numpy.float64),
+                          view['z'].astype(numpy.float64)], axis=-1)
+    points = points.dot(rotation.T) + translation
+    view['x'] = points[..., 0]
+    view['y'] = points[..., 1]
+    view['z'] = points[..., 2]
+    res = PointCloud2(header=transform.header, height=cloud.height, width=cloud.width,
+                      fields=cloud.fields, is_bigendian=cloud.is_bigendian,
+                      point_step=cloud.point_step, row_step=cloud.row_step,
+                      data=data.tobytes(), is_dense=cloud.is_dense)
     return res
 tf2_ros.TransformRegistration().add(PointCloud2, do_transform_cloud)
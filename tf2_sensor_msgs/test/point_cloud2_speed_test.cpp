@@ -0,0 +1,134 @@
+// Copyright 2020, Open Source Robotics Foundation, Inc. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the Willow Garage nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// Measures how long transforming a PointCloud2 takes with the scalar and the vectorized
+// kernels, and through the copying, in place and thread pool doTransform(), for the common lidar
+// layouts.
+//
+// Usage: point_cloud2_speed_test [num_points] [iterations] [num_threads]
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "tf2_sensor_msgs/tf2_sensor_msgs.h"
+
+namespace
+{
+
+sensor_msgs::msg::PointCloud2 makeCloud(size_t num_points, const std::vector<std::string> & names)
+{
+  sensor_msgs::msg::PointCloud2 cloud;
+  cloud.header.frame_id = "lidar";
+  for (const auto & name : names) {
+    sensor_msgs::msg::PointField field;
+    field.name = name;
+    field.offset = cloud.point_step;
+    field.datatype = sensor_msgs::msg::PointField::FLOAT32;
+    field.count = 1;
+    cloud.fields.push_back(field);
+    cloud.point_step += sizeof(float);
+  }
+  cloud.height = 1;
+  cloud.width = static_cast<uint32_t>(num_points);
+  cloud.row_step = cloud.width * cloud.point_step;
+  cloud.data.resize(cloud.row_step);
+  float * values = reinterpret_cast<float *>(cloud.data.data());
+  for (size_t i = 0; i < cloud.data.size() / sizeof(float); ++i) {
+    values[i] = static_cast<float>(i % 1000) * 0.01f;
+  }
+  return cloud;
+}
+
+template<typename F>
+double timeIt(size_t iterations, F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    f();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  size_t num_points = 2000000;
+  size_t iterations = 20;
+  if (argc > 1) {
+    num_points = std::stoul(argv[1]);
+  }
+  if (argc > 2) {
+    iterations = std::stoul(argv[2]);
+  }
+  tf2::ThreadPool pool(argc > 3 ? std::stoul(argv[3]) : tf2::ThreadPool::defaultNumThreads());
+
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = "base_link";
+  transform.transform.translation.x = 1.0;
+  transform.transform.translation.y = 2.0;
+  transform.transform.translation.z = 3.0;
+  transform.transform.rotation.x = 0.1;
+  transform.transform.rotation.y = 0.2;
+  transform.transform.rotation.z = 0.3;
+  transform.transform.rotation.w = 0.927361849549570;
+  const tf2::impl::PointTransform matrix = tf2::impl::toPointTransform(
+    Eigen::Translation3f(1.0f, 2.0f, 3.0f) *
+    Eigen::Quaternionf(0.927361849549570f, 0.1f, 0.2f, 0.3f));
+
+  const std::vector<std::vector<std::string>> layouts = {
+    {"x", "y", "z"}, {"x", "y", "z", "intensity"}, {"x", "y", "z", "intensity", "ring", "t"}};
+  for (const auto & layout : layouts) {
+    sensor_msgs::msg::PointCloud2 cloud = makeCloud(num_points, layout);
+    sensor_msgs::msg::PointCloud2 out = cloud;
+    uint8_t * data = out.data.data();
+
+    double scalar = timeIt(
+      iterations, [&]() {
+        tf2::impl::transformPointsScalar(data, data, num_points, out.point_step, matrix);
+      });
+    double vectorized = timeIt(
+      iterations, [&]() {
+        tf2::impl::transformPoints(data, data, num_points, out.point_step, 0, matrix);
+      });
+    double full = timeIt(iterations, [&]() {tf2::doTransform(cloud, out, transform);});
+    double in_place = timeIt(iterations, [&]() {tf2::doTransform(out, transform);});
+    double pooled = timeIt(iterations, [&]() {tf2::doTransform(out, transform, pool);});
+
+    std::printf(
+      "%zu points with %zu fields: scalar %.2f ms, vectorized %.2f ms, doTransform %.2f ms, "
+      "in place %.2f ms, in place on %zu threads %.2f ms\n", num_points, layout.size(), scalar,
+      vectorized, full, in_place, pool.getNumThreads() + 1, pooled);
+  }
+
+  return 0;
+}
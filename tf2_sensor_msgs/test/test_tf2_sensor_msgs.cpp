@@ -75,6 +75,91 @@ TEST(Tf2Sensor, PointCloud2)
   EXPECT_NEAR(*iter_x_advanced, -9, EPS);
   EXPECT_NEAR(*iter_y_advanced, 18, EPS);
   EXPECT_NEAR(*iter_z_advanced, 27, EPS);
+
+  // moved api, which transforms the cloud in place
+  sensor_msgs::msg::PointCloud2 cloud_moved = tf_buffer->transform(
+    sensor_msgs::msg::PointCloud2(cloud), "B", tf2::durationFromSec(2.0));
+  sensor_msgs::msg::PointCloud2Iterator<float> iter_x_moved(cloud_moved, "x");
+  sensor_msgs::msg::PointCloud2Iterator<float> iter_y_moved(cloud_moved, "y");
+  sensor_msgs::msg::PointCloud2Iterator<float> iter_z_moved(cloud_moved, "z");
+  EXPECT_NEAR(*iter_x_moved, -9, EPS);
+  EXPECT_NEAR(*iter_y_moved, 18, EPS);
+  EXPECT_NEAR(*iter_z_moved, 27, EPS);
+  EXPECT_EQ("B", cloud_moved.header.frame_id);
+}
+
+TEST(Tf2Sensor, PointCloud2Normals)
+{
+  sensor_msgs::msg::PointCloud2 cloud;
+  sensor_msgs::msg::PointCloud2Modifier modifier(cloud);
+  modifier.setPointCloud2Fields(
+    6, "x", 1, sensor_msgs::msg::PointField::FLOAT32,
+    "y", 1, sensor_msgs::msg::PointField::FLOAT32,
+    "z", 1, sensor_msgs::msg::PointField::FLOAT32,
+    "normal_x", 1, sensor_msgs::msg::PointField::FLOAT32,
+    "normal_y", 1, sensor_msgs::msg::PointField::FLOAT32,
+    "normal_z", 1, sensor_msgs::msg::PointField::FLOAT32);
+  modifier.resize(1);
+  const float point[6] = {1, 2, 3, 0, 1, 0};
+  std::memcpy(cloud.data.data(), point, sizeof(point));
+  cloud.header.frame_id = "A";
+
+  geometry_msgs::msg::TransformStamped t = tf_buffer->lookupTransform(
+    "B", "A", tf2::timeFromSec(2.0), tf2::durationFromSec(2.0));
+  tf2::PointCloud2Transformer transformer;
+  // Twice, the second time with the cached layout
+  for (int pass = 0; pass < 2; ++pass) {
+    sensor_msgs::msg::PointCloud2 cloud_out = cloud;
+    transformer.transform(cloud_out, t);
+    EXPECT_EQ("B", cloud_out.header.frame_id);
+    float out[6];
+    std::memcpy(out, cloud_out.data.data(), sizeof(out));
+    EXPECT_NEAR(out[0], -9, EPS);
+    EXPECT_NEAR(out[1], 18, EPS);
+    EXPECT_NEAR(out[2], 27, EPS);
+    // The normal is only rotated
+    EXPECT_NEAR(out[3], 0, EPS);
+    EXPECT_NEAR(out[4], -1, EPS);
+    EXPECT_NEAR(out[5], 0, EPS);
+  }
+}
+
+TEST(Tf2Sensor, LaserScan)
+{
+  sensor_msgs::msg::LaserScan scan;
+  scan.header.stamp = builtin_interfaces::msg::Time(2);
+  scan.header.frame_id = "A";
+  scan.angle_min = -1.0f;
+  scan.angle_increment = 0.5f;
+  scan.range_min = 0.1f;
+  scan.range_max = 10.0f;
+  scan.ranges = {1.0f, 2.0f, std::numeric_limits<float>::quiet_NaN(), 20.0f, 3.0f};
+  scan.intensities = {5.0f, 6.0f, 7.0f, 8.0f, 9.0f};
+
+  geometry_msgs::msg::TransformStamped t = tf_buffer->lookupTransform(
+    "B", "A", tf2::timeFromSec(2.0), tf2::durationFromSec(2.0));
+  tf2::LaserScanProjection projection;
+  sensor_msgs::msg::PointCloud2 cloud;
+  // Twice, the second time reusing the tables and the cloud
+  for (int pass = 0; pass < 2; ++pass) {
+    tf2::transformLaserScan(scan, cloud, t, projection);
+    EXPECT_EQ("B", cloud.header.frame_id);
+    // The out of range beams are dropped
+    ASSERT_EQ(3u, cloud.width);
+    sensor_msgs::msg::PointCloud2Iterator<float> x(cloud, "x");
+    sensor_msgs::msg::PointCloud2Iterator<float> y(cloud, "y");
+    sensor_msgs::msg::PointCloud2Iterator<float> z(cloud, "z");
+    sensor_msgs::msg::PointCloud2Iterator<float> intensity(cloud, "intensity");
+    for (size_t i : {0, 1, 4}) {
+      const double angle = scan.angle_min + i * scan.angle_increment;
+      // Moved by -10, -20, -30 and then turned half way around x
+      EXPECT_NEAR(*x, scan.ranges[i] * std::cos(angle) - 10, EPS);
+      EXPECT_NEAR(*y, -scan.ranges[i] * std::sin(angle) + 20, EPS);
+      EXPECT_NEAR(*z, 30, EPS);
+      EXPECT_EQ(*intensity, scan.intensities[i]);
+      ++x, ++y, ++z, ++intensity;
+    }
+  }
 }
 
 int main(int argc, char **argv){
@@ -44,6 +44,31 @@ class PointCloudConversions(unittest.TestCase):
         print("new_points are %s" % new_points)
         assert(expected_coordinates == new_points)
         assert(old_data == self.point_cloud_in.data)  # checking no modification in input cloud
+    def test_rotation_keeps_other_fields(self):
+        cloud = point_cloud2.PointCloud2()
+        cloud.fields = [PointField('x', 0, PointField.FLOAT32, 1),
+                        PointField('y', 4, PointField.FLOAT32, 1),
+                        PointField('z', 8, PointField.FLOAT32, 1),
+                        PointField('intensity', 12, PointField.FLOAT32, 1)]
+        cloud.point_step = 4 * 4
+        cloud.height = 1
+        cloud.width = 2
+        cloud.row_step = cloud.point_step * cloud.width
+        points = [1, 2, 0, 5, 10, 20, 30, 7]
+        cloud.data = struct.pack('%sf' % len(points), *points)
+
+        # A quarter turn about z
+        transform = TransformStamped()
+        transform.transform.translation.x = 1
+        transform.transform.rotation.z = 0.5 ** 0.5
+        transform.transform.rotation.w = 0.5 ** 0.5
+
+        point_cloud_transformed = tf2_sensor_msgs.do_transform_cloud(cloud, transform)
+        expected = [(-1, 1, 0, 5), (-19, 10, 30, 7)]
+        new_points = list(point_cloud2.read_points(point_cloud_transformed))
+        assert(len(expected) == len(new_points))
+        for e, n in zip(expected, new_points):
+            assert(all(abs(a - b) < 1e-5 for a, b in zip(e, n)))
 
 if __name__ == '__main__':
     import rosunit